@@ -0,0 +1,213 @@
+#include "AutoInversion.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include "AutoInvert.h"
+#include "BenchChecks.h"
+#include "EffectController.h"
+#include "EffectTransition.h"
+#include "FramePipeline.h"
+#include "PixelImage.h"
+#include "SyntheticDesktop.h"
+
+namespace {
+
+const int64_t frameMs = 16; // timerInterval in ScreenInversion.cpp
+
+// The thinned histogram counted directly
+LuminanceHistogram ReferenceHistogram(const PixelImage& image, int step) {
+    LuminanceHistogram histogram;
+    memset(&histogram, 0, sizeof(histogram));
+    for (int y = 0; y < image.height; y += step) {
+        for (int x = 0; x < image.width; x += step) {
+            histogram.bins[PixelLuma(image.At(x, y)) / 16]++;
+            histogram.samples++;
+        }
+    }
+    return histogram;
+}
+
+// White columns on the left making up 'share' of the width, black ones on the right
+PixelImage ShareImage(float share) {
+    PixelImage image(640, 360);
+    for (int y = 0; y < image.height; y++) {
+        for (int x = 0; x < image.width; x++)
+            image.At(x, y) = x < static_cast<int>(share * image.width) ? 0xFFFFFFFFu : 0xFF000000u;
+    }
+    return image;
+}
+
+// Mean luminance of an image
+double MeanLuma(const PixelImage& image) {
+    double sum = 0.0;
+    for (uint32_t pixel : image.pixels)
+        sum += PixelLuma(pixel);
+    return sum / static_cast<double>(image.pixels.size());
+}
+
+}
+
+void RegisterAutoInvertBenchmarks(BenchSuite& suite) {
+    for (int index = 0; index < PIXEL_KERNEL_COUNT; index++) {
+        PixelKernel kernel = static_cast<PixelKernel>(index);
+        if (!IsPixelKernelAvailable(kernel) || kernel == PIXEL_KERNEL_LUT)
+            continue;
+        for (int step : { 1, 4, 32 }) {
+            double samples = static_cast<double>((3840 + step - 1) / step) * ((2160 + step - 1) / step);
+            suite.Add(std::string("luma_histogram/") + PixelKernelName(kernel) + "/3840x2160/s" + std::to_string(step), samples,
+                [kernel, step] {
+                std::shared_ptr<PixelImage> source = std::make_shared<PixelImage>(TestImage(3840, 2160, 1));
+                return BenchBody([kernel, step, source](uint64_t iterations) {
+                    LuminanceHistogram histogram;
+                    for (uint64_t i = 0; i < iterations; i++) {
+                        ComputeLuminanceHistogram(kernel, source->pixels.data(), source->width, source->height, step, histogram);
+                        BenchDoNotOptimize(histogram.bins[0]);
+                    }
+                });
+            });
+        }
+    }
+}
+
+int RunAutoInvertChecks(const std::vector<std::string>& arguments) {
+    double maxShare = 1.0;
+
+    for (const std::string& argument : arguments) {
+        size_t equals = argument.find('=');
+        std::string name = argument.substr(0, equals);
+        std::string value = equals == std::string::npos ? "" : argument.substr(equals + 1);
+
+        bool valid = true;
+        if (name == "--auto-invert")
+            continue;
+        else if (name == "--max-share")
+            valid = sscanf(value.c_str(), "%lf", &maxShare) == 1 && maxShare > 0.0;
+        else
+            valid = false;
+
+        if (!valid) {
+            fprintf(stderr, "Invalid argument: %s\n", argument.c_str());
+            return 2;
+        }
+    }
+
+    ResetChecks();
+    char detail[200];
+
+    // Steps of 1 and 3 leave partial vectors at the ends of rows; the small sizes hold less than
+    // one vector
+    {
+        const struct { int width; int height; } sizes[] = { { 517, 300 }, { 3, 2 }, { 1, 7 }, { 300, 1 } };
+        MismatchList mismatches;
+        for (const auto& size : sizes) {
+            PixelImage source = TestImage(size.width, size.height, 2);
+            for (int step : { 1, 3, 8, 32 }) {
+                LuminanceHistogram expected = ReferenceHistogram(source, step);
+                for (int kernel = 0; kernel < PIXEL_KERNEL_COUNT; kernel++) {
+                    if (!IsPixelKernelAvailable(static_cast<PixelKernel>(kernel)))
+                        continue;
+                    LuminanceHistogram actual;
+                    ComputeLuminanceHistogram(static_cast<PixelKernel>(kernel), source.pixels.data(), size.width, size.height, step, actual);
+                    mismatches.Compare(memcmp(&actual, &expected, sizeof(actual)) == 0, "%s/s%d/%dx%d",
+                        PixelKernelName(static_cast<PixelKernel>(kernel)), step, size.width, size.height);
+                }
+            }
+        }
+        Check("histogram_matches_reference", mismatches.Empty(), mismatches.Describe("runs"));
+    }
+
+    // The whole loop as the app runs it, one sample per frame: the detector sees the captured
+    // page, its verdict is queued and flushed, and the transition fades the matrix the pipeline
+    // renders with. The page switches every 120 frames.
+    {
+        SyntheticDesktop desktop(1280, 720, SCENARIO_THEME_SWITCH);
+        SyntheticFrameSource source(desktop);
+        FramePipeline pipeline(source, BestPixelKernel());
+        EffectController effects;
+        EffectTransition transition;
+        AutoInvertDetector detector;
+        ColorEffectSettings settings;
+        settings.autoInvert = true;
+        effects.SetSettings(settings);
+
+        std::vector<int> flipFrames;
+        double brightestShown = 0.0;
+        for (int frame = 0; frame < 720; frame++) {
+            int64_t nowMs = frame * frameMs;
+            pipeline.RenderFrame();
+            const PixelImage& captured = pipeline.GetCaptured();
+            if (detector.Update(BestPixelKernel(), captured.pixels.data(), captured.width, captured.height)) {
+                effects.QueueInversion(detector.IsBright());
+                if (frame > 0)
+                    flipFrames.push_back(frame);
+            }
+            if (effects.Flush())
+                transition.Start(effects.GetMatrix(), nowMs, 200);
+            transition.Step(nowMs);
+            pipeline.SetColorMatrix(transition.GetMatrix());
+
+            // Once a switch has been followed and faded, what is shown should be dark
+            if (frame % 120 == 60)
+                brightestShown = (std::max)(brightestShown, MeanLuma(pipeline.GetOutput()));
+        }
+
+        bool passed = flipFrames.size() == 5;
+        std::string lags;
+        for (size_t i = 0; i < flipFrames.size(); i++) {
+            int lag = flipFrames[i] - 120 * static_cast<int>(i + 1);
+            passed = passed && lag >= 0 && lag <= AUTO_INVERT_HOLD_SAMPLES;
+            lags += " " + std::to_string(lag);
+        }
+        passed = passed && brightestShown < 64.0;
+        snprintf(detail, sizeof(detail), "%d flips for 5 switches, frames behind:%s; brightest settled frame luma %.0f",
+            static_cast<int>(flipFrames.size()), lags.c_str(), brightestShown);
+        Check("follows_theme_switch", passed, detail);
+    }
+
+    // Shares inside the band and runs shorter than the hold leave the verdict alone
+    {
+        const struct { float share; int samples; } sequence[] = {
+            { 0.1f, 1 },                                // Decides dark
+            { 0.55f, 20 },                              // Inside the band
+            { 0.9f, 2 }, { 0.1f, 1 },                   // A flash
+            { 0.9f, AUTO_INVERT_HOLD_SAMPLES - 1 },     // A run one short
+            { 0.1f, 1 },
+            { 0.65f, AUTO_INVERT_HOLD_SAMPLES },        // Flips to bright
+            { 0.45f, 20 },                              // Inside the band
+            { 0.3f, AUTO_INVERT_HOLD_SAMPLES },         // Flips to dark
+        };
+        AutoInvertDetector detector;
+        std::string flips;
+        int sample = 0;
+        for (const auto& step : sequence) {
+            PixelImage image = ShareImage(step.share);
+            for (int i = 0; i < step.samples; i++, sample++) {
+                if (detector.Update(BestPixelKernel(), image.pixels.data(), image.width, image.height) && sample > 0)
+                    flips += " " + std::to_string(sample) + (detector.IsBright() ? "=bright" : "=dark");
+            }
+        }
+        const int brightAt = 1 + 20 + 2 + 1 + (AUTO_INVERT_HOLD_SAMPLES - 1) + 1 + AUTO_INVERT_HOLD_SAMPLES - 1;
+        const int darkAt = brightAt + 20 + AUTO_INVERT_HOLD_SAMPLES;
+        std::string expected = " " + std::to_string(brightAt) + "=bright " + std::to_string(darkAt) + "=dark";
+        snprintf(detail, sizeof(detail), "flips at sample:%s", flips.empty() ? " none" : flips.c_str());
+        Check("hysteresis", flips == expected, detail);
+    }
+
+    // What the mode adds to a frame: one detector sample of a 4K capture
+    {
+        SyntheticDesktop desktop(3840, 2160, SCENARIO_STATIC_DOCUMENT);
+        PixelImage frame;
+        desktop.Render(0, frame);
+        AutoInvertDetector detector;
+        double sampleMs = MedianMs([&] {
+            detector.Update(BestPixelKernel(), frame.pixels.data(), frame.width, frame.height);
+        }, 101);
+        double share = sampleMs / (1000.0 / 60.0) * 100.0;
+        snprintf(detail, sizeof(detail), "%s, %d samples in %.1f us, %.3f%% of a 60 Hz frame", PixelKernelName(BestPixelKernel()),
+            static_cast<int>(detector.GetHistogram().samples), sampleMs * 1000.0, share);
+        Check("frame_share", share < maxShare, detail);
+    }
+
+    return FinishChecks("auto-invert");
+}
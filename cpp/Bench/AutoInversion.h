@@ -0,0 +1,19 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "BenchHarness.h"
+
+// luma_histogram/<kernel>/3840x2160/s<N>: ComputeLuminanceHistogram over a 4K frame, every
+// N-th pixel of every N-th row; s32 is what the auto-invert detector samples
+void RegisterAutoInvertBenchmarks(BenchSuite& suite);
+
+// screenfilter_bench --auto-invert [--max-share=X]: checks the auto-invert mode. Every kernel's
+// histogram must count exactly what a direct loop does, at sample steps that leave partial
+// vectors and on images smaller than one; a page switching between light and dark must be
+// inverted while light and shown as it is while dark, following each switch within
+// AUTO_INVERT_HOLD_SAMPLES frames through an effect transition; brightness inside the hysteresis
+// band and runs shorter than the hold must not flip it; and sampling a 4K frame must cost less
+// than X percent (default 1) of a 60 Hz frame. Returns the process exit code: 0 if every check
+// passes.
+int RunAutoInvertChecks(const std::vector<std::string>& arguments);
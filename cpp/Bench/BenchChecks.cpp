@@ -0,0 +1,73 @@
+#include "BenchChecks.h"
+#include <cstdarg>
+#include <cstdio>
+#include <random>
+
+namespace {
+
+int failures = 0;
+
+}
+
+void ResetChecks() {
+    failures = 0;
+}
+
+int FinishChecks(const char* what) {
+    if (failures > 0) {
+        printf("%d %s check(s) failed\n", failures, what);
+        return 1;
+    }
+    return 0;
+}
+
+void Check(const char* name, bool passed) {
+    printf("%-40s %s\n", name, passed ? "ok" : "FAIL");
+    if (!passed)
+        failures++;
+}
+
+void Check(const char* name, bool passed, const char* detail) {
+    printf("%-40s %s  %s\n", name, passed ? "ok" : "FAIL", detail);
+    if (!passed)
+        failures++;
+}
+
+void Check(const char* name, bool passed, const std::string& detail) {
+    Check(name, passed, detail.c_str());
+}
+
+// Count one comparison; the run is named by 'format' if it differs
+void MismatchList::Compare(bool same, const char* format, ...) {
+    compared++;
+    if (same)
+        return;
+
+    char name[96];
+    va_list arguments;
+    va_start(arguments, format);
+    vsnprintf(name, sizeof(name), format, arguments);
+    va_end(arguments);
+    names += " ";
+    names += name;
+}
+
+std::string MismatchList::Describe(const char* things) const {
+    return std::to_string(compared) + " " + things + " compared;" + (names.empty() ? " all identical" : names);
+}
+
+// Random pixels with some hard edges, so both flat and detailed areas are covered
+PixelImage TestImage(int width, int height, unsigned seed) {
+    std::mt19937 random(seed);
+    PixelImage image(width, height);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++)
+            image.At(x, y) = ((x / 7 + y / 5) % 3 == 0) ? (random() | 0xFF000000u) : (random() & 0x80FFFFFFu);
+    }
+    return image;
+}
+
+double Median(std::vector<double> values) {
+    std::sort(values.begin(), values.end());
+    return values[values.size() / 2];
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "PixelImage.h"
+
+// Pass/fail checks shared by the check modes. A mode calls ResetChecks() before its checks and
+// returns FinishChecks(), which prints how many failed and gives the exit code.
+void ResetChecks();
+int FinishChecks(const char* what);
+
+// Print "name  ok|FAIL  detail" and count a failure
+void Check(const char* name, bool passed);
+void Check(const char* name, bool passed, const char* detail);
+void Check(const char* name, bool passed, const std::string& detail);
+
+// Runs compared against a reference, naming the ones that differ
+class MismatchList {
+private:
+    int compared;
+    std::string names;
+
+public:
+    MismatchList() : compared(0) {}
+
+    // Count one comparison; the run is named by 'format' if it differs
+    void Compare(bool same, const char* format, ...);
+
+    bool Empty() const { return names.empty(); }
+
+    // "<count> <things> compared; all identical" or the runs that differ
+    std::string Describe(const char* things) const;
+};
+
+// Random pixels with some hard edges, so both flat and detailed areas are covered
+PixelImage TestImage(int width, int height, unsigned seed);
+
+double Median(std::vector<double> values);
+
+// Median time of one call, in ms
+template <typename Work>
+double MedianMs(Work work, int repetitions) {
+    std::vector<double> times;
+    for (int repetition = 0; repetition < repetitions; repetition++) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        work();
+        times.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+    return Median(times);
+}
+
+// Median time of 'run' over several repetitions, divided by the operations it did
+template <typename Run>
+double MedianNsPerOperation(Run run) {
+    std::vector<double> times;
+    for (int repetition = 0; repetition < 9; repetition++) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        uint64_t operations = run();
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        times.push_back(ns / static_cast<double>(operations));
+    }
+    return Median(times);
+}
+
+// Medians over pairs of a stage's cost and the baseline it is compared with
+struct PairedCost {
+    double baselineMs;
+    double measuredMs;
+    double addedMs; // Median of measured - baseline
+    double ratio;   // Median of measured / baseline
+};
+
+// Times 'baseline' then 'measured', alternating so both see the same machine state; the first
+// pair only warms up. The per-pair differences and ratios move far less with a slow moment on
+// a shared machine than either median alone.
+template <typename Baseline, typename Measured>
+PairedCost MeasurePairs(Baseline baseline, Measured measured, int pairs) {
+    std::vector<double> baselineMs, measuredMs, addedMs, ratios;
+    for (int pair = -1; pair < pairs; pair++) {
+        double before = MedianMs(baseline, 1);
+        double after = MedianMs(measured, 1);
+        if (pair < 0)
+            continue;
+        baselineMs.push_back(before);
+        measuredMs.push_back(after);
+        addedMs.push_back(after - before);
+        ratios.push_back(after / before);
+    }
+    PairedCost cost = { Median(baselineMs), Median(measuredMs), Median(addedMs), Median(ratios) };
+    return cost;
+}
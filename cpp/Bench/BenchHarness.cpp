@@ -0,0 +1,236 @@
+#include "BenchHarness.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#ifndef SCREENFILTER_BUILD_TYPE
+#define SCREENFILTER_BUILD_TYPE "unknown"
+#endif
+
+namespace {
+
+double TimeSampleNs(const BenchBody& body, uint64_t iterations) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    body(iterations);
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Smallest iteration count whose sample lasts at least minSampleMs
+uint64_t CalibrateIterations(const BenchBody& body, double minSampleMs) {
+    double targetNs = minSampleMs * 1e6;
+    uint64_t iterations = 1;
+    for (;;) {
+        double elapsed = TimeSampleNs(body, iterations);
+        if (elapsed >= targetNs || iterations >= (1ull << 40))
+            return iterations;
+
+        // Aim 20% past the target, growing at most 100x per step
+        double scale = elapsed > 0.0 ? targetNs * 1.2 / elapsed : 100.0;
+        scale = (std::min)((std::max)(scale, 2.0), 100.0);
+        iterations = static_cast<uint64_t>(std::ceil(iterations * scale));
+    }
+}
+
+void Summarize(BenchResult& result, double itemsPerIteration) {
+    std::vector<double> sorted = result.samplesNs;
+    std::sort(sorted.begin(), sorted.end());
+    size_t count = sorted.size();
+
+    result.minNs = sorted.front();
+    result.maxNs = sorted.back();
+    result.medianNs = (count % 2 == 1) ? sorted[count / 2] : (sorted[count / 2 - 1] + sorted[count / 2]) / 2.0;
+
+    double sum = 0.0;
+    for (double sample : sorted)
+        sum += sample;
+    result.meanNs = sum / count;
+
+    double squares = 0.0;
+    for (double sample : sorted)
+        squares += (sample - result.meanNs) * (sample - result.meanNs);
+    result.stddevNs = count > 1 ? std::sqrt(squares / (count - 1)) : 0.0;
+
+    result.itemsPerSecond = (itemsPerIteration > 0.0 && result.medianNs > 0.0) ? itemsPerIteration * 1e9 / result.medianNs : 0.0;
+}
+
+void WriteJsonString(std::ostream& out, const std::string& text) {
+    out << '"';
+    for (char c : text) {
+        if (c == '"' || c == '\\')
+            out << '\\';
+        out << c;
+    }
+    out << '"';
+}
+
+std::string CompilerDescription() {
+    char text[64];
+#if defined(__clang__)
+    snprintf(text, sizeof(text), "clang %d.%d.%d", __clang_major__, __clang_minor__, __clang_patchlevel__);
+#elif defined(__GNUC__)
+    snprintf(text, sizeof(text), "gcc %d.%d.%d", __GNUC__, __GNUC_MINOR__, __GNUC_PATCHLEVEL__);
+#elif defined(_MSC_VER)
+    snprintf(text, sizeof(text), "msvc %d", _MSC_VER);
+#else
+    snprintf(text, sizeof(text), "unknown");
+#endif
+    return text;
+}
+
+}
+
+void BenchSuite::Add(const std::string& name, double itemsPerIteration, std::function<BenchBody()> setup) {
+    BenchDefinition definition;
+    definition.name = name;
+    definition.itemsPerIteration = itemsPerIteration;
+    definition.setup = setup;
+    benchmarks.push_back(definition);
+}
+
+// Run the selected benchmarks, printing a line per benchmark to 'log'
+std::vector<BenchResult> BenchSuite::Run(const BenchOptions& options, std::ostream& log) const {
+    std::vector<BenchResult> results;
+    char line[256];
+
+    for (const BenchDefinition& definition : benchmarks) {
+        if (!options.filter.empty() && definition.name.find(options.filter) == std::string::npos)
+            continue;
+
+        BenchBody body = definition.setup();
+        BenchResult result;
+        result.name = definition.name;
+        result.iterationsPerSample = CalibrateIterations(body, options.minSampleMs);
+
+        for (int i = 0; i < options.warmupSamples; i++)
+            TimeSampleNs(body, result.iterationsPerSample);
+
+        for (int i = 0; i < (std::max)(options.repetitions, 1); i++)
+            result.samplesNs.push_back(TimeSampleNs(body, result.iterationsPerSample) / result.iterationsPerSample);
+
+        Summarize(result, definition.itemsPerIteration);
+
+        snprintf(line, sizeof(line), "%-48s %14.1f ns  (min %.1f, stddev %.1f%%)",
+            result.name.c_str(), result.medianNs, result.minNs,
+            result.meanNs > 0.0 ? 100.0 * result.stddevNs / result.meanNs : 0.0);
+        log << line;
+        if (result.itemsPerSecond > 0.0) {
+            snprintf(line, sizeof(line), "  %10.2f M items/s", result.itemsPerSecond / 1e6);
+            log << line;
+        }
+        log << "\n";
+        log.flush();
+
+        results.push_back(result);
+    }
+    return results;
+}
+
+// Parse the common options; unknown arguments are returned in 'remaining'
+bool ParseBenchOptions(int argc, char** argv, BenchOptions& options, std::vector<std::string>& remaining, std::string& error) {
+    for (int i = 1; i < argc; i++) {
+        std::string argument = argv[i];
+        size_t equals = argument.find('=');
+        std::string name = argument.substr(0, equals);
+        std::string value = equals == std::string::npos ? "" : argument.substr(equals + 1);
+
+        char* end = NULL;
+        if (name == "--warmup") {
+            options.warmupSamples = static_cast<int>(strtol(value.c_str(), &end, 10));
+        } else if (name == "--repetitions") {
+            options.repetitions = static_cast<int>(strtol(value.c_str(), &end, 10));
+        } else if (name == "--min-time-ms") {
+            options.minSampleMs = strtod(value.c_str(), &end);
+        } else if (name == "--cpu") {
+            options.pinCpu = static_cast<int>(strtol(value.c_str(), &end, 10));
+        } else if (name == "--filter") {
+            options.filter = value;
+            continue;
+        } else if (name == "--json") {
+            options.jsonPath = value;
+            continue;
+        } else if (argument == "--list") {
+            options.list = true;
+            continue;
+        } else {
+            remaining.push_back(argument);
+            continue;
+        }
+
+        if (value.empty() || *end != '\0') {
+            error = "Invalid value for " + name + ": '" + value + "'";
+            return false;
+        }
+    }
+    return true;
+}
+
+// Pin the calling thread to one CPU and raise its priority
+bool PinCurrentThread(int cpu) {
+#ifdef _WIN32
+    if (cpu < 0 || cpu >= 64 || SetThreadAffinityMask(GetCurrentThread(), 1ull << cpu) == 0)
+        return false;
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_HIGHEST);
+    return true;
+#else
+    if (cpu < 0 || cpu >= CPU_SETSIZE)
+        return false;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#endif
+}
+
+// Results plus the build and machine context needed to compare runs
+void WriteBenchJson(std::ostream& out, const BenchOptions& options, const std::vector<BenchResult>& results) {
+    char timestamp[32];
+    time_t now = time(NULL);
+    strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+
+    out << "{\n  \"context\": {\n";
+    out << "    \"timestamp\": \"" << timestamp << "\",\n";
+    out << "    \"compiler\": \"" << CompilerDescription() << "\",\n";
+    out << "    \"build_type\": \"" << SCREENFILTER_BUILD_TYPE << "\",\n";
+    out << "    \"hardware_concurrency\": " << std::thread::hardware_concurrency() << ",\n";
+    out << "    \"pinned_cpu\": " << options.pinCpu << ",\n";
+    out << "    \"warmup_samples\": " << options.warmupSamples << ",\n";
+    out << "    \"repetitions\": " << options.repetitions << ",\n";
+    out << "    \"min_sample_ms\": " << options.minSampleMs << "\n";
+    out << "  },\n  \"benchmarks\": [";
+
+    char number[64];
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchResult& result = results[i];
+        out << (i == 0 ? "\n" : ",\n") << "    {\"name\": ";
+        WriteJsonString(out, result.name);
+        out << ", \"iterations_per_sample\": " << result.iterationsPerSample;
+
+        const std::pair<const char*, double> fields[] = {
+            { "min_ns", result.minNs }, { "median_ns", result.medianNs }, { "mean_ns", result.meanNs },
+            { "stddev_ns", result.stddevNs }, { "max_ns", result.maxNs }, { "items_per_second", result.itemsPerSecond }
+        };
+        for (const std::pair<const char*, double>& field : fields) {
+            snprintf(number, sizeof(number), "%.6g", field.second);
+            out << ", \"" << field.first << "\": " << number;
+        }
+
+        out << ", \"samples_ns\": [";
+        for (size_t s = 0; s < result.samplesNs.size(); s++) {
+            snprintf(number, sizeof(number), "%.6g", result.samplesNs[s]);
+            out << (s == 0 ? "" : ", ") << number;
+        }
+        out << "]}";
+    }
+    out << "\n  ]\n}\n";
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Runs 'iterations' repetitions of the measured operation
+typedef std::function<void(uint64_t iterations)> BenchBody;
+
+// A named benchmark. Setup builds the fixtures outside the timed region and returns the body.
+struct BenchDefinition {
+    std::string name;
+    double itemsPerIteration; // Pixels, lines, lookups... per iteration; 0 if throughput is meaningless
+    std::function<BenchBody()> setup;
+};
+
+struct BenchOptions {
+    int warmupSamples = 2;
+    int repetitions = 10;
+    double minSampleMs = 20.0; // Each sample runs enough iterations to last at least this long
+    int pinCpu = -1;           // Pin the benchmark thread to this CPU; -1 leaves scheduling alone
+    std::string filter;        // Only run benchmarks whose name contains this
+    std::string jsonPath;      // Write results here as JSON; empty for none
+    bool list = false;         // Print benchmark names and exit
+};
+
+struct BenchResult {
+    std::string name;
+    uint64_t iterationsPerSample;
+    std::vector<double> samplesNs; // Per-iteration time of each sample
+    double minNs;
+    double medianNs;
+    double meanNs;
+    double stddevNs;
+    double maxNs;
+    double itemsPerSecond; // From the median; 0 if not meaningful
+};
+
+class BenchSuite {
+private:
+    std::vector<BenchDefinition> benchmarks;
+
+public:
+    void Add(const std::string& name, double itemsPerIteration, std::function<BenchBody()> setup);
+
+    const std::vector<BenchDefinition>& GetBenchmarks() const { return benchmarks; }
+
+    // Run the selected benchmarks, printing a line per benchmark to 'log'
+    std::vector<BenchResult> Run(const BenchOptions& options, std::ostream& log) const;
+};
+
+// Parse --warmup=N --repetitions=N --min-time-ms=N --cpu=N --filter=S --json=PATH --list.
+// Unknown arguments are returned in 'remaining' for the caller's own modes.
+bool ParseBenchOptions(int argc, char** argv, BenchOptions& options, std::vector<std::string>& remaining, std::string& error);
+
+// Pin the calling thread to one CPU and raise its priority
+bool PinCurrentThread(int cpu);
+
+// Results plus the build and machine context needed to compare runs
+void WriteBenchJson(std::ostream& out, const BenchOptions& options, const std::vector<BenchResult>& results);
+
+// Keep the compiler from discarding a computed value or the stores leading to it
+template <typename T>
+inline void BenchDoNotOptimize(const T& value) {
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static volatile const void* sink;
+    sink = &value;
+#endif
+}
@@ -0,0 +1,247 @@
+#include "Binarization.h"
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include "BenchChecks.h"
+#include "Binarize.h"
+#include "ColorEffects.h"
+#include "PixelImage.h"
+#include "WorkerPool.h"
+
+namespace {
+
+// Threads a 4K frame has to fit its budget on; a smaller pool gets their share of the work
+const int budgetThreads = 2;
+
+// Sauvola's rule with each window summed directly, clipped at the edges
+PixelImage ReferenceBinarize(const PixelImage& source, int window) {
+    int half = window / 2;
+    PixelImage result(source.width, source.height);
+    for (int y = 0; y < source.height; y++) {
+        for (int x = 0; x < source.width; x++) {
+            int32_t sum = 0, squares = 0, count = 0;
+            for (int wy = (std::max)(y - half, 0); wy <= (std::min)(y + half, source.height - 1); wy++) {
+                for (int wx = (std::max)(x - half, 0); wx <= (std::min)(x + half, source.width - 1); wx++) {
+                    int luma = PixelLuma(source.At(wx, wy));
+                    sum += luma;
+                    squares += luma * luma;
+                    count++;
+                }
+            }
+            bool white = SauvolaWhite(PixelLuma(source.At(x, y)), sum, squares, count);
+            result.At(x, y) = (source.At(x, y) & 0xFF000000u) | (white ? 0x00FFFFFFu : 0u);
+        }
+    }
+    return result;
+}
+
+// Lines of dark "words", strokes two pixels wide, on a background that fades from dark grey on
+// the left to near white on the right. 'text' marks the stroke pixels, which should turn black.
+PixelImage TextOnGradient(int width, int height, std::vector<bool>& text) {
+    std::mt19937 random(7);
+    PixelImage image(width, height);
+    text.assign(static_cast<size_t>(width) * height, false);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            uint32_t level = 70 + 170 * static_cast<uint32_t>(x) / static_cast<uint32_t>(width - 1);
+            image.At(x, y) = 0xFF000000u | (level << 16) | (level << 8) | level;
+        }
+    }
+
+    // 16-pixel glyph cells on 24-pixel lines; each glyph is a few random strokes
+    for (int line = 4; line + 16 < height; line += 24) {
+        for (int cell = 4; cell + 12 < width; cell += 12) {
+            if (random() % 6 == 0)
+                continue;
+            for (int stroke = 0; stroke < 3; stroke++) {
+                bool vertical = random() % 2 == 0;
+                int x0 = cell + static_cast<int>(random() % 8), y0 = line + static_cast<int>(random() % 12);
+                for (int step = 0; step < (vertical ? 16 - (y0 - line) : 10 - (x0 - cell)); step++) {
+                    for (int thickness = 0; thickness < 2; thickness++) {
+                        int x = vertical ? x0 + thickness : x0 + step, y = vertical ? y0 + step : y0 + thickness;
+                        uint32_t level = (image.At(x, y) & 0xFF) * 2 / 5;
+                        image.At(x, y) = 0xFF000000u | (level << 16) | (level << 8) | level;
+                        text[static_cast<size_t>(y) * width + x] = true;
+                    }
+                }
+            }
+        }
+    }
+    return image;
+}
+
+// Share of pixels that are black exactly where 'text' says
+double Accuracy(const PixelImage& binary, const std::vector<bool>& text) {
+    size_t correct = 0;
+    for (size_t i = 0; i < text.size(); i++) {
+        if (((binary.pixels[i] & 0x00FFFFFFu) == 0) == text[i])
+            correct++;
+    }
+    return static_cast<double>(correct) / static_cast<double>(text.size());
+}
+
+}
+
+void RegisterBinarizeBenchmarks(BenchSuite& suite) {
+    std::shared_ptr<WorkerPool> pool = std::make_shared<WorkerPool>(0);
+    for (int index = 0; index < PIXEL_KERNEL_COUNT; index++) {
+        PixelKernel kernel = static_cast<PixelKernel>(index);
+        if (!IsPixelKernelAvailable(kernel) || kernel == PIXEL_KERNEL_LUT)
+            continue;
+        for (int window : { 15, 31, 127 }) {
+            suite.Add(std::string("binarize/") + PixelKernelName(kernel) + "/3840x2160/w" + std::to_string(window), 3840.0 * 2160.0,
+                [kernel, window, pool] {
+                std::shared_ptr<PixelImage> source = std::make_shared<PixelImage>(TestImage(3840, 2160, 1));
+                std::shared_ptr<PixelImage> target = std::make_shared<PixelImage>(3840, 2160);
+                return BenchBody([kernel, window, source, target, pool](uint64_t iterations) {
+                    for (uint64_t i = 0; i < iterations; i++) {
+                        BinarizeImage(kernel, source->pixels.data(), target->pixels.data(), source->width, source->height, window, pool.get());
+                        BenchDoNotOptimize(target->pixels[0]);
+                    }
+                });
+            });
+        }
+    }
+}
+
+int RunBinarizeChecks(const std::vector<std::string>& arguments) {
+    double maxRatio = 3.5;
+    double budgetMs = 16.0;
+    int threads = 0;
+
+    for (const std::string& argument : arguments) {
+        size_t equals = argument.find('=');
+        std::string name = argument.substr(0, equals);
+        std::string value = equals == std::string::npos ? "" : argument.substr(equals + 1);
+
+        bool valid = true;
+        if (name == "--binarize")
+            continue;
+        else if (name == "--max-ratio")
+            valid = sscanf(value.c_str(), "%lf", &maxRatio) == 1 && maxRatio > 0.0;
+        else if (name == "--budget-ms")
+            valid = sscanf(value.c_str(), "%lf", &budgetMs) == 1 && budgetMs > 0.0;
+        else if (name == "--threads")
+            valid = sscanf(value.c_str(), "%d", &threads) == 1 && threads > 0;
+        else
+            valid = false;
+
+        if (!valid) {
+            fprintf(stderr, "Invalid argument: %s\n", argument.c_str());
+            return 2;
+        }
+    }
+
+    ResetChecks();
+    char detail[200];
+    WorkerPool pool(threads);
+
+    // 517 x 300 leaves columns over after the vector loops; the small sizes are narrower than
+    // every window, so no column has a full one
+    {
+        const struct { int width; int height; } sizes[] = { { 517, 300 }, { 3, 2 }, { 1, 7 }, { 300, 1 } };
+        MismatchList mismatches;
+        for (const auto& size : sizes) {
+            PixelImage source = TestImage(size.width, size.height, 2);
+            for (int window : { 3, 31, 127 }) {
+                PixelImage expected = ReferenceBinarize(source, window);
+                for (int kernel = 0; kernel < PIXEL_KERNEL_COUNT; kernel++) {
+                    if (!IsPixelKernelAvailable(static_cast<PixelKernel>(kernel)))
+                        continue;
+                    PixelImage actual(size.width, size.height);
+                    BinarizeImage(static_cast<PixelKernel>(kernel), source.pixels.data(), actual.pixels.data(), size.width, size.height, window, NULL);
+                    mismatches.Compare(actual.pixels == expected.pixels, "%s/w%d/%dx%d", PixelKernelName(static_cast<PixelKernel>(kernel)),
+                        window, size.width, size.height);
+                }
+            }
+        }
+        Check("matches_reference", mismatches.Empty(), mismatches.Describe("runs"));
+    }
+
+    // Strips are independent, so the threads cannot change the result
+    {
+        PixelImage source = TestImage(1920, 1080, 4);
+        PixelImage single(source.width, source.height), pooled(source.width, source.height);
+        BinarizeImage(BestPixelKernel(), source.pixels.data(), single.pixels.data(), source.width, source.height, BINARIZE_WINDOW_DEFAULT, NULL);
+        BinarizeImage(BestPixelKernel(), source.pixels.data(), pooled.pixels.data(), source.width, source.height, BINARIZE_WINDOW_DEFAULT, &pool);
+        snprintf(detail, sizeof(detail), "%d thread(s)", pool.GetThreads());
+        Check("pool_agrees", single.pixels == pooled.pixels, detail);
+    }
+
+    // Text has to survive a background no single threshold separates it from: the strokes on the
+    // light side are brighter than the background on the dark side
+    {
+        std::vector<bool> text;
+        PixelImage source = TextOnGradient(1280, 720, text);
+        PixelImage adaptive(source.width, source.height), global(source.width, source.height);
+        BinarizeImage(BestPixelKernel(), source.pixels.data(), adaptive.pixels.data(), source.width, source.height, BINARIZE_WINDOW_DEFAULT, &pool);
+
+        // The best global threshold, for comparison
+        double globalAccuracy = 0.0;
+        int globalThreshold = 0;
+        for (int threshold = 0; threshold < 256; threshold++) {
+            for (size_t i = 0; i < source.pixels.size(); i++)
+                global.pixels[i] = PixelLuma(source.pixels[i]) > threshold ? 0xFFFFFFFFu : 0xFF000000u;
+            double accuracy = Accuracy(global, text);
+            if (accuracy > globalAccuracy) {
+                globalAccuracy = accuracy;
+                globalThreshold = threshold;
+            }
+        }
+
+        size_t textPixels = static_cast<size_t>(std::count(text.begin(), text.end(), true));
+        size_t textMissed = 0;
+        for (size_t i = 0; i < text.size(); i++) {
+            if (text[i] && (adaptive.pixels[i] & 0x00FFFFFFu) != 0)
+                textMissed++;
+        }
+        double accuracy = Accuracy(adaptive, text);
+        snprintf(detail, sizeof(detail), "w%d %.2f%% right, %.2f%% of text lost; best global threshold (%d) %.2f%%", BINARIZE_WINDOW_DEFAULT,
+            accuracy * 100.0, 100.0 * textMissed / textPixels, globalThreshold, globalAccuracy * 100.0);
+        Check("text_on_gradient", accuracy > 0.99 && accuracy > globalAccuracy, detail);
+    }
+
+    // A full 4K frame at each window the shortcut cycles through. Sliding sums cost the same at
+    // any window. The frame has to fit a 60 Hz frame on the pool, scaled up as Binarize.h
+    // describes when the pool has fewer than budgetThreads threads, and is also measured
+    // against the colour matrix pass every CPU frame already pays, which follows the memory
+    // speed of the machine rather than its cores.
+    {
+        PixelImage source = TestImage(3840, 2160, 6);
+        PixelImage target(source.width, source.height);
+        ColorEffectSettings settings;
+        settings.inversionEnabled = true;
+        ColorMatrix matrix;
+        CalculateColorMatrix(settings, matrix);
+        auto matrixPass = [&] {
+            ApplyColorMatrix(BestPixelKernel(), matrix, source.pixels.data(), target.pixels.data(), source.pixels.size());
+        };
+
+        std::string times;
+        double fastest = 0.0, slowest = 0.0, slowestRatio = 0.0;
+        for (int window : { 15, 31, 63, 127 }) {
+            PairedCost cost = MeasurePairs(matrixPass, [&] {
+                BinarizeImage(BestPixelKernel(), source.pixels.data(), target.pixels.data(), source.width, source.height, window, &pool);
+            }, 9);
+            double ms = cost.measuredMs;
+            fastest = fastest == 0.0 ? ms : (std::min)(fastest, ms);
+            slowest = (std::max)(slowest, ms);
+            slowestRatio = (std::max)(slowestRatio, cost.ratio);
+            char time[32];
+            snprintf(time, sizeof(time), " w%d %.1f", window, ms);
+            times += time;
+        }
+        snprintf(detail, sizeof(detail), "%s, %d thread(s), 4K ms:%s (x%.2f)", PixelKernelName(BestPixelKernel()), pool.GetThreads(),
+            times.c_str(), slowest / fastest);
+        Check("window_independent", slowest <= fastest * 1.5, detail);
+
+        snprintf(detail, sizeof(detail), "%.2f matrix passes at the slowest window, at most %.1f", slowestRatio, maxRatio);
+        Check("frame_cost", slowestRatio <= maxRatio, detail);
+        double frameBudget = budgetMs * budgetThreads / (std::min)(pool.GetThreads(), budgetThreads);
+        snprintf(detail, sizeof(detail), "slowest %.1f ms on %d thread(s), budget %.1f ms", slowest, pool.GetThreads(), frameBudget);
+        Check("frame_budget", slowest < frameBudget, detail);
+    }
+
+    return FinishChecks("binarization");
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "BenchHarness.h"
+
+// binarize/<kernel>/3840x2160/w<N>: BinarizeImage on a 4K frame at windows from 15 to 127,
+// on one thread per hardware thread
+void RegisterBinarizeBenchmarks(BenchSuite& suite);
+
+// screenfilter_bench --binarize [--max-ratio=X] [--budget-ms=N] [--threads=N]: checks the
+// binarization stage. Every kernel must match Sauvola's rule applied to window sums taken
+// directly, on sizes that leave columns over after the vector loops and on images smaller than
+// the window; a pool must not change the result; dark text on a background that fades from dark
+// to light must come out as black on white, more accurately than one global threshold manages;
+// a 4K frame must cost about the same at every window, and at most X (default 3.5) times a colour
+// matrix pass over it, on a pool of N threads (default: one per hardware thread). With
+// --budget-ms it must also take under N ms. Returns the process exit code: 0 if every check passes.
+int RunBinarizeChecks(const std::vector<std::string>& arguments);
@@ -0,0 +1,245 @@
+#include "ColorTemperature.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include "BenchChecks.h"
+#include "ColorEffects.h"
+#include "EffectController.h"
+#include "PixelKernels.h"
+
+namespace {
+
+// Points on the Planckian locus from the CIE tables (CIE 15:2004; 2856 K is illuminant A)
+const struct { int kelvin; double x; double y; } publishedLocus[] = {
+    { 2000, 0.5267, 0.4133 },
+    { 2856, 0.44757, 0.40745 },
+    { 3000, 0.4369, 0.4041 },
+    { 4000, 0.3805, 0.3768 },
+    { 5000, 0.3451, 0.3516 },
+    { 6500, 0.3135, 0.3237 },
+    { 10000, 0.2807, 0.2884 },
+};
+
+ColorEffectSettings InvertedAt(int kelvin) {
+    ColorEffectSettings settings;
+    settings.inversionEnabled = true;
+    settings.colorTemperature = kelvin;
+    return settings;
+}
+
+}
+
+void RegisterColorTemperatureBenchmarks(BenchSuite& suite) {
+    const int steps = (COLOR_TEMPERATURE_MAX - COLOR_TEMPERATURE_MIN) / 10 + 1;
+    suite.Add("color_matrix/temperature_drag", steps, [steps] {
+        return BenchBody([steps](uint64_t iterations) {
+            ColorMatrix matrix;
+            for (uint64_t i = 0; i < iterations; i++) {
+                for (int step = 0; step < steps; step++) {
+                    CalculateColorMatrix(InvertedAt(COLOR_TEMPERATURE_MIN + step * 10), matrix);
+                    BenchDoNotOptimize(matrix);
+                }
+            }
+        });
+    });
+}
+
+int RunColorTemperatureChecks(const std::vector<std::string>& arguments) {
+    double maxFrameRatio = 1.15;
+
+    for (const std::string& argument : arguments) {
+        size_t equals = argument.find('=');
+        std::string name = argument.substr(0, equals);
+        std::string value = equals == std::string::npos ? "" : argument.substr(equals + 1);
+
+        bool valid = true;
+        if (name == "--temperature")
+            continue;
+        else if (name == "--max-frame-ratio")
+            valid = sscanf(value.c_str(), "%lf", &maxFrameRatio) == 1 && maxFrameRatio >= 1.0;
+        else
+            valid = false;
+
+        if (!valid) {
+            fprintf(stderr, "Invalid argument: %s\n", argument.c_str());
+            return 2;
+        }
+    }
+
+    ResetChecks();
+    char detail[160];
+
+    // The approximation of the black-body colors against the CIE tables
+    {
+        double worst = 0.0;
+        int worstKelvin = 0;
+        for (const auto& point : publishedLocus) {
+            double x, y;
+            PlanckianChromaticity(point.kelvin, x, y);
+            double error = (std::max)(std::fabs(x - point.x), std::fabs(y - point.y));
+            if (error > worst) {
+                worst = error;
+                worstKelvin = point.kelvin;
+            }
+        }
+        snprintf(detail, sizeof(detail), "largest xy difference %.5f at %d K", worst, worstKelvin);
+        Check("planckian_locus", worst < 0.001, detail);
+    }
+
+    // Neutral is the identity, so the effect costs nothing until it is used
+    {
+        float gains[3];
+        ColorTemperatureGains(COLOR_TEMPERATURE_NEUTRAL, gains);
+        ColorMatrix plain, neutral;
+        CalculateColorMatrix(InvertedAt(COLOR_TEMPERATURE_NEUTRAL), neutral);
+        ColorEffectSettings settings;
+        settings.inversionEnabled = true;
+        CalculateColorMatrix(settings, plain);
+        bool same = gains[0] == 1.0f && gains[1] == 1.0f && gains[2] == 1.0f;
+        for (int i = 0; i < 25; i++)
+            same = same && plain.transform[i / 5][i % 5] == neutral.transform[i / 5][i % 5];
+        Check("neutral_is_identity", same, "");
+    }
+
+    // Warmer only takes away blue, then green; cooler only takes away red, then green
+    {
+        const char* problem = NULL;
+        float previous[3] = { 1.0f, 1.0f, 1.0f };
+        for (int kelvin = COLOR_TEMPERATURE_NEUTRAL; kelvin >= COLOR_TEMPERATURE_MIN && problem == NULL; kelvin -= 10) {
+            float gains[3];
+            ColorTemperatureGains(kelvin, gains);
+            if (gains[0] != 1.0f)
+                problem = "red changes below neutral";
+            else if (gains[1] > previous[1] || gains[2] > previous[2] || gains[2] > gains[1])
+                problem = "blue or green rises when warming";
+            memcpy(previous, gains, sizeof(previous));
+        }
+        float warmest[3];
+        ColorTemperatureGains(COLOR_TEMPERATURE_MIN, warmest);
+        previous[0] = previous[1] = previous[2] = 1.0f;
+        for (int kelvin = COLOR_TEMPERATURE_NEUTRAL; kelvin <= COLOR_TEMPERATURE_MAX && problem == NULL; kelvin += 10) {
+            float gains[3];
+            ColorTemperatureGains(kelvin, gains);
+            if (gains[2] != 1.0f)
+                problem = "blue changes above neutral";
+            else if (gains[0] > previous[0] || gains[1] > previous[1])
+                problem = "red or green rises when cooling";
+            memcpy(previous, gains, sizeof(previous));
+        }
+        snprintf(detail, sizeof(detail), "%s; %d K gains %.3f %.3f %.3f", problem != NULL ? problem : "monotonic",
+            COLOR_TEMPERATURE_MIN, warmest[0], warmest[1], warmest[2]);
+        Check("gains_monotonic", problem == NULL, detail);
+    }
+
+    // Every Kelvin, not just the table steps, is close to the direct calculation
+    {
+        double worst = 0.0;
+        int worstKelvin = 0;
+        for (int kelvin = COLOR_TEMPERATURE_MIN; kelvin <= COLOR_TEMPERATURE_MAX; kelvin++) {
+            float gains[3];
+            double exact[3];
+            ColorTemperatureGains(kelvin, gains);
+            ComputeColorTemperatureGains(kelvin, exact);
+            for (int channel = 0; channel < 3; channel++) {
+                if (std::fabs(gains[channel] - exact[channel]) > worst) {
+                    worst = std::fabs(gains[channel] - exact[channel]);
+                    worstKelvin = kelvin;
+                }
+            }
+        }
+        // Under one output level; the largest differences are where blue reaches 0 and its
+        // encoded gain is steepest
+        snprintf(detail, sizeof(detail), "largest difference %.5f (%.2f levels) at %d K", worst, worst * 255.0, worstKelvin);
+        Check("table_interpolation", worst * 255.0 < 1.0, detail);
+    }
+
+    // The gains scale the finished matrix, offsets included, whatever the other effects are
+    {
+        double worst = 0.0;
+        for (int state = 0; state < 2 * 2 * NUM_GRAY_LEVELS; state++) {
+            ColorEffectSettings settings;
+            settings.inversionEnabled = (state & 1) != 0;
+            settings.grayscaleEnabled = (state & 2) != 0;
+            settings.grayLevel = state >> 2;
+            settings.visionMode = state % VISION_MODE_COUNT;
+            ColorMatrix base, warm;
+            CalculateColorMatrix(settings, base);
+            settings.colorTemperature = 3400;
+            CalculateColorMatrix(settings, warm);
+            float gains[3];
+            ColorTemperatureGains(3400, gains);
+            for (int row = 0; row < 5; row++) {
+                for (int column = 0; column < 5; column++) {
+                    float expected = base.transform[row][column] * (column < 3 ? gains[column] : 1.0f);
+                    worst = (std::max)(worst, static_cast<double>(std::fabs(warm.transform[row][column] - expected)));
+                }
+            }
+        }
+        snprintf(detail, sizeof(detail), "largest difference %.2e", worst);
+        Check("composes_with_effects", worst == 0.0, detail);
+    }
+
+    // A drag: many temperatures queued between frames, one build per frame
+    {
+        EffectController effects;
+        const int updates = 4096, updatesPerFrame = 16;
+        uint64_t buildsBefore = effects.GetMatrixBuilds();
+        int frames = 0;
+        for (int update = 0; update < updates; update++) {
+            effects.QueueTemperature(COLOR_TEMPERATURE_MIN + (update * 7) % (COLOR_TEMPERATURE_MAX - COLOR_TEMPERATURE_MIN));
+            if ((update + 1) % updatesPerFrame == 0) {
+                effects.Flush();
+                frames++;
+            }
+        }
+        uint64_t builds = effects.GetMatrixBuilds() - buildsBefore;
+        double buildNs = MedianNsPerOperation([&]() {
+            ColorMatrix matrix;
+            for (int kelvin = COLOR_TEMPERATURE_MIN; kelvin <= COLOR_TEMPERATURE_MAX; kelvin += 7) {
+                CalculateColorMatrix(InvertedAt(kelvin), matrix);
+                BenchDoNotOptimize(matrix);
+            }
+            return static_cast<uint64_t>((COLOR_TEMPERATURE_MAX - COLOR_TEMPERATURE_MIN) / 7 + 1);
+        });
+        snprintf(detail, sizeof(detail), "%d updates over %d frames: %llu matrix builds, %.1f ns each", updates, frames,
+            static_cast<unsigned long long>(builds), buildNs);
+        Check("drag_one_build_per_frame", builds <= static_cast<uint64_t>(frames), detail);
+    }
+
+    // A frame costs what the plain invert path costs: the effect only changes matrix entries
+    {
+        const size_t count = 1920 * 1080;
+        std::mt19937 random(3);
+        std::vector<uint32_t> source(count), target(count);
+        for (uint32_t& pixel : source)
+            pixel = random() | 0xFF000000u;
+
+        ColorMatrix plain, warm;
+        CalculateColorMatrix(InvertedAt(COLOR_TEMPERATURE_NEUTRAL), plain);
+        CalculateColorMatrix(InvertedAt(3400), warm);
+        PixelKernel kernel = BestPixelKernel();
+
+        // Alternating, so both see the same machine state
+        std::vector<double> plainMs, warmMs;
+        for (int repetition = 0; repetition < 15; repetition++) {
+            for (int pass = 0; pass < 2; pass++) {
+                std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+                ApplyColorMatrix(kernel, pass == 0 ? plain : warm, source.data(), target.data(), count);
+                BenchDoNotOptimize(target[0]);
+                double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+                (pass == 0 ? plainMs : warmMs).push_back(ms);
+            }
+        }
+        std::sort(plainMs.begin(), plainMs.end());
+        std::sort(warmMs.begin(), warmMs.end());
+        double ratio = warmMs[warmMs.size() / 2] / plainMs[plainMs.size() / 2];
+        snprintf(detail, sizeof(detail), "%s 1920x1080: %.3f ms invert, %.3f ms invert at 3400 K (x%.2f)", PixelKernelName(kernel),
+            plainMs[plainMs.size() / 2], warmMs[warmMs.size() / 2], ratio);
+        Check("frame_cost_unchanged", ratio <= maxFrameRatio, detail);
+    }
+
+    return FinishChecks("color temperature");
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "BenchHarness.h"
+
+// color_matrix/temperature_drag: CalculateColorMatrix for an inverted window while its color
+// temperature is dragged across the whole range in 10 K steps
+void RegisterColorTemperatureBenchmarks(BenchSuite& suite);
+
+// screenfilter_bench --temperature [--max-frame-ratio=X]: checks the color temperature effect.
+// The black-body chromaticities must match published CIE values; 6500 K must leave the matrix
+// alone; warming must only ever take away blue and green; the table must interpolate the direct
+// calculation within an output level at every Kelvin; the gains must compose with inversion and
+// the white level; a drag of queued temperatures must cost one matrix build per frame; and
+// filtering a 1080p frame must cost no more than X (default 1.15) times the plain invert path.
+// Returns the process exit code: 0 if every check passes.
+int RunColorTemperatureChecks(const std::vector<std::string>& arguments);
@@ -0,0 +1,242 @@
+#include "Conformance.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <random>
+#include "ColorEffects.h"
+#include "PixelKernels.h"
+#include "PpmImage.h"
+
+namespace {
+
+struct ConformanceOptions {
+    int maxError = 1;
+    double meanError = 0.01;
+    std::string kernel;
+    std::string goldenDir;
+    std::string diffDir = "conformance_diffs";
+};
+
+struct NamedImage {
+    std::string name;
+    PixelImage image;
+};
+
+// What the kernels approximate: the matrix applied in double precision, rounded half up
+void ApplyReference(const ColorMatrix& matrix, const PixelImage& source, PixelImage& result) {
+    result = PixelImage(source.width, source.height);
+    for (size_t i = 0; i < source.pixels.size(); i++) {
+        uint32_t pixel = source.pixels[i];
+        double b = pixel & 0xFF;
+        double g = (pixel >> 8) & 0xFF;
+        double r = (pixel >> 16) & 0xFF;
+
+        uint32_t out[3];
+        for (int channel = 0; channel < 3; channel++) {
+            double value = r * matrix.transform[0][channel] + g * matrix.transform[1][channel] +
+                b * matrix.transform[2][channel] + 255.0 * matrix.transform[4][channel];
+            value = value < 0.0 ? 0.0 : (value > 255.0 ? 255.0 : value);
+            out[channel] = static_cast<uint32_t>(std::floor(value + 0.5));
+        }
+        result.pixels[i] = (pixel & 0xFF000000u) | (out[0] << 16) | (out[1] << 8) | out[2];
+    }
+}
+
+// Every 8-bit RGB color once, as 16x16 tiles of 256x256 (red across, green down, one blue per tile).
+// Alpha varies too, to check it is passed through.
+PixelImage RgbCube() {
+    PixelImage image(4096, 4096);
+    for (uint32_t b = 0; b < 256; b++) {
+        for (uint32_t g = 0; g < 256; g++) {
+            for (uint32_t r = 0; r < 256; r++) {
+                uint32_t alpha = (r ^ g ^ b) & 0xFF;
+                image.At((b % 16) * 256 + r, (b / 16) * 256 + g) = (alpha << 24) | (r << 16) | (g << 8) | b;
+            }
+        }
+    }
+    return image;
+}
+
+// Built-in stand-ins for screenshots: gradients, antialiased text-like strokes on a page, and noise
+std::vector<NamedImage> BuiltInGoldenImages() {
+    std::vector<NamedImage> images;
+
+    NamedImage gradient = { "gradient", PixelImage(512, 512) };
+    for (int y = 0; y < 512; y++) {
+        for (int x = 0; x < 512; x++)
+            gradient.image.At(x, y) = 0xFF000000u | ((x / 2) << 16) | ((y / 2) << 8) | ((x + y) / 4);
+    }
+    images.push_back(gradient);
+
+    NamedImage document = { "document", PixelImage(640, 400) };
+    for (int y = 0; y < 400; y++) {
+        for (int x = 0; x < 640; x++) {
+            // Rows of glyph-sized strokes with a soft edge, black on off-white
+            int row = y % 20, column = x % 9;
+            int ink = (row >= 4 && row < 16 && column >= 1 && column < 7 && ((x / 9 + y / 20) % 7) != 0) ? 255 : 0;
+            if (ink && (row == 4 || row == 15 || column == 1 || column == 6))
+                ink = 128;
+            uint32_t level = static_cast<uint32_t>(250 - ink * 230 / 255);
+            document.image.At(x, y) = 0xFF000000u | (level << 16) | (level << 8) | (level > 8 ? level - 8 : 0);
+        }
+    }
+    images.push_back(document);
+
+    NamedImage noise = { "noise", PixelImage(512, 512) };
+    std::mt19937 random(2024);
+    for (uint32_t& pixel : noise.image.pixels)
+        pixel = 0xFF000000u | (random() & 0xFFFFFF);
+    images.push_back(noise);
+
+    return images;
+}
+
+bool LoadGoldenDirectory(const std::string& directory, std::vector<NamedImage>& images) {
+    std::error_code error;
+    std::filesystem::directory_iterator entries(directory, error);
+    if (error) {
+        fprintf(stderr, "Could not read %s\n", directory.c_str());
+        return false;
+    }
+    for (const std::filesystem::directory_entry& entry : entries) {
+        if (entry.path().extension() != ".ppm")
+            continue;
+        NamedImage golden;
+        golden.name = entry.path().stem().string();
+        if (!ReadPpm(entry.path().string(), golden.image)) {
+            fprintf(stderr, "Could not read %s (binary PPM, maxval 255)\n", entry.path().string().c_str());
+            return false;
+        }
+        images.push_back(golden);
+    }
+    return true;
+}
+
+// Per-channel differences, amplified so single-level errors are visible; red where over the limit
+PixelImage DiffImage(const PixelImage& expected, const PixelImage& actual, int maxError) {
+    PixelImage diff(expected.width, expected.height);
+    for (size_t i = 0; i < expected.pixels.size(); i++) {
+        int worst = 0;
+        for (int shift = 0; shift <= 24; shift += 8) {
+            int difference = std::abs(static_cast<int>((expected.pixels[i] >> shift) & 0xFF) - static_cast<int>((actual.pixels[i] >> shift) & 0xFF));
+            worst = difference > worst ? difference : worst;
+        }
+        uint32_t level = static_cast<uint32_t>(worst * 64 > 255 ? 255 : worst * 64);
+        diff.pixels[i] = 0xFF000000u | (worst > maxError ? 0xFF0000u : (level << 16) | (level << 8) | level);
+    }
+    return diff;
+}
+
+bool ParseOptions(const std::vector<std::string>& arguments, ConformanceOptions& options) {
+    for (const std::string& argument : arguments) {
+        size_t equals = argument.find('=');
+        std::string name = argument.substr(0, equals);
+        std::string value = equals == std::string::npos ? "" : argument.substr(equals + 1);
+
+        char* end = NULL;
+        if (argument == "--conformance") {
+            continue;
+        } else if (name == "--max-error") {
+            options.maxError = static_cast<int>(strtol(value.c_str(), &end, 10));
+        } else if (name == "--mean-error") {
+            options.meanError = strtod(value.c_str(), &end);
+        } else if (name == "--kernel") {
+            options.kernel = value;
+            continue;
+        } else if (name == "--golden-dir") {
+            options.goldenDir = value;
+            continue;
+        } else if (name == "--diff-dir") {
+            options.diffDir = value;
+            continue;
+        } else {
+            fprintf(stderr, "Unknown argument: %s\n", argument.c_str());
+            return false;
+        }
+
+        if (value.empty() || *end != '\0') {
+            fprintf(stderr, "Invalid value for %s: '%s'\n", name.c_str(), value.c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
+}
+
+int RunConformance(const std::vector<std::string>& arguments) {
+    ConformanceOptions options;
+    if (!ParseOptions(arguments, options))
+        return 2;
+
+    std::vector<NamedImage> inputs;
+    inputs.push_back({ "rgb_cube", RgbCube() });
+    std::vector<NamedImage> golden = BuiltInGoldenImages();
+    inputs.insert(inputs.end(), golden.begin(), golden.end());
+    if (!options.goldenDir.empty() && !LoadGoldenDirectory(options.goldenDir, inputs))
+        return 2;
+
+    printf("%-8s %-10s %-24s %9s %11s  %s\n", "kernel", "input", "settings", "max_err", "mean_err", "result");
+
+    int failures = 0;
+    for (int combination = 0; combination < 2 * 2 * NUM_GRAY_LEVELS; combination++) {
+        ColorEffectSettings settings;
+        settings.inversionEnabled = (combination & 1) != 0;
+        settings.grayscaleEnabled = (combination & 2) != 0;
+        settings.grayLevel = combination >> 2;
+        ColorMatrix matrix;
+        CalculateColorMatrix(settings, matrix);
+
+        char settingsName[32];
+        snprintf(settingsName, sizeof(settingsName), "%s%s_level%d", settings.inversionEnabled ? "invert_" : "",
+            settings.grayscaleEnabled ? "gray" : "color", settings.grayLevel);
+
+        for (const NamedImage& input : inputs) {
+            PixelImage expected;
+            ApplyReference(matrix, input.image, expected);
+
+            for (int kernel = 0; kernel < PIXEL_KERNEL_COUNT; kernel++) {
+                const char* kernelName = PixelKernelName(static_cast<PixelKernel>(kernel));
+                if (!IsPixelKernelAvailable(static_cast<PixelKernel>(kernel)) || (!options.kernel.empty() && options.kernel != kernelName))
+                    continue;
+
+                PixelImage actual(input.image.width, input.image.height);
+                ApplyColorMatrix(static_cast<PixelKernel>(kernel), matrix, input.image.pixels.data(), actual.pixels.data(), actual.pixels.size());
+
+                // Alpha must pass through untouched, so it counts toward the error like a color channel
+                int maxError = 0;
+                uint64_t totalError = 0;
+                for (size_t i = 0; i < expected.pixels.size(); i++) {
+                    for (int shift = 0; shift <= 24; shift += 8) {
+                        int difference = std::abs(static_cast<int>((expected.pixels[i] >> shift) & 0xFF) - static_cast<int>((actual.pixels[i] >> shift) & 0xFF));
+                        maxError = difference > maxError ? difference : maxError;
+                        totalError += difference;
+                    }
+                }
+                double meanError = static_cast<double>(totalError) / (expected.pixels.size() * 3.0);
+
+                bool passed = maxError <= options.maxError && meanError <= options.meanError;
+                printf("%-8s %-10s %-24s %9d %11.6f  %s\n", kernelName, input.name.c_str(), settingsName, maxError, meanError, passed ? "ok" : "FAIL");
+                if (passed)
+                    continue;
+
+                failures++;
+                std::error_code error;
+                std::filesystem::create_directories(options.diffDir, error);
+                std::string prefix = options.diffDir + "/" + kernelName + "_" + input.name + "_" + settingsName;
+                WritePpm(prefix + "_expected.ppm", expected);
+                WritePpm(prefix + "_actual.ppm", actual);
+                WritePpm(prefix + "_diff.ppm", DiffImage(expected, actual, options.maxError));
+            }
+        }
+    }
+
+    if (failures > 0) {
+        printf("\n%d kernel run(s) outside max error %d / mean error %g; images in %s\n",
+            failures, options.maxError, options.meanError, options.diffDir.c_str());
+        return 1;
+    }
+    printf("\nAll kernels within max error %d / mean error %g\n", options.maxError, options.meanError);
+    return 0;
+}
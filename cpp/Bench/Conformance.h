@@ -0,0 +1,17 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// screenfilter_bench --conformance: checks every available pixel kernel against a
+// double-precision reference over the full 8-bit RGB cube and a set of golden images,
+// for every color effect setting.
+//
+//   --max-error=N     largest allowed per-channel difference, in levels (default 1)
+//   --mean-error=X    largest allowed mean per-channel difference (default 0.01)
+//   --kernel=NAME     only check this kernel
+//   --golden-dir=DIR  also check every .ppm image in DIR
+//   --diff-dir=DIR    where expected/actual/diff images of failures go (default conformance_diffs)
+//
+// Returns the process exit code: 0 if every kernel is within the thresholds.
+int RunConformance(const std::vector<std::string>& arguments);
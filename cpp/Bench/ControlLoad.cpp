@@ -0,0 +1,353 @@
+#include "ControlLoad.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <mutex>
+#include <random>
+#include <thread>
+#include "ControlChannel.h"
+#include "EffectController.h"
+#include "SavedRectanglesManager.h"
+
+namespace {
+
+struct LoadOptions {
+    std::string connect;
+    int connections = 1;
+    int depth = 32;
+    int commands = 100000;
+    std::string mix = "effects";
+};
+
+// Headless model of the filter window's side of the channel
+class HeadlessControlTarget : public ControlTarget {
+private:
+    std::mutex lock;
+    EffectController effects;
+    SavedRectanglesManager slots; // In memory only
+    RECT windowRect;
+    int cycleSlot; // Last slot loaded through slot 0
+
+public:
+    HeadlessControlTarget() : cycleSlot(0) {
+        windowRect = { 100, 100, 740, 580 };
+        for (int slot = 1; slot <= 2; slot++) {
+            SavedRectEntry entry;
+            entry.rect = { slot * 200, 150, slot * 200 + 800, 750 };
+            entry.inversionEnabled = true;
+            entry.grayLevel = slot;
+            entry.isValid = true;
+            slots.SetEntry(slot, entry);
+        }
+    }
+
+    ControlStatus LoadSlot(int slot) override {
+        // Slot 0 cycles through the saved slots like the 0 key
+        for (int attempts = 0; slot == 0 && attempts < NUM_SAVED_RECTS - 1; attempts++) {
+            cycleSlot = cycleSlot % (NUM_SAVED_RECTS - 1) + 1;
+            if (slots.IsValid(cycleSlot))
+                slot = cycleSlot;
+        }
+        if (!slots.IsValid(slot))
+            return CONTROL_FAILED;
+        const SavedRectEntry& entry = slots.GetEntry(slot);
+        ColorEffectSettings settings;
+        settings.inversionEnabled = entry.inversionEnabled;
+        settings.grayscaleEnabled = entry.grayscaleEnabled;
+        settings.grayLevel = entry.grayLevel;
+        effects.SetSettings(settings);
+        windowRect = entry.rect;
+        return CONTROL_OK;
+    }
+
+    ControlStatus SaveSlot(int slot) override {
+        SavedRectEntry entry;
+        entry.rect = windowRect;
+        entry.inversionEnabled = effects.GetSettings().inversionEnabled;
+        entry.grayscaleEnabled = effects.GetSettings().grayscaleEnabled;
+        entry.grayLevel = effects.GetSettings().grayLevel;
+        entry.isValid = true;
+        slots.SetEntry(slot, entry);
+        return CONTROL_OK;
+    }
+
+    ControlStatus ApplyEffect(EffectAction action) override {
+        effects.Queue(action);
+        return CONTROL_OK;
+    }
+
+    ControlStatus SetEffects(const ColorEffectSettings& settings) override {
+        effects.SetSettings(settings);
+        return CONTROL_OK;
+    }
+
+    void GetEffects(ColorEffectSettings& settings) override {
+        settings = effects.GetPendingSettings();
+    }
+
+    ControlStatus MoveRegion(const RECT& rect) override {
+        windowRect = rect;
+        return CONTROL_OK;
+    }
+
+    ControlStatus SetTemperature(int kelvin) override {
+        effects.QueueTemperature(kelvin);
+        return CONTROL_OK;
+    }
+
+    void GetState(ControlState& state) override {
+        state.flags = (effects.GetSettings().inversionEnabled ? CONTROL_STATE_INVERTED : 0) |
+            (effects.GetSettings().grayscaleEnabled ? CONTROL_STATE_GRAYSCALE : 0);
+        state.grayLevel = static_cast<uint8_t>(effects.GetSettings().grayLevel);
+        state.left = windowRect.left;
+        state.top = windowRect.top;
+        state.right = windowRect.right;
+        state.bottom = windowRect.bottom;
+    }
+
+    // One batch, as the window runs it on its UI thread; the frame after it applies queued toggles
+    void Execute(const std::vector<ControlRequest>& requests, std::vector<ControlResponse>& responses) {
+        std::lock_guard<std::mutex> guard(lock);
+        responses.resize(requests.size());
+        for (size_t i = 0; i < requests.size(); i++)
+            ExecuteControlRequest(*this, requests[i], responses[i]);
+        effects.Flush();
+    }
+};
+
+// The i-th request of a connection under the given mix
+ControlRequest MakeRequest(const std::string& mix, uint32_t sequence) {
+    static const uint8_t effectCommands[] = {
+        CONTROL_TOGGLE_INVERT, CONTROL_CYCLE_WHITE_LEVEL, CONTROL_GET_STATE, CONTROL_TOGGLE_GRAYSCALE, CONTROL_GET_STATE
+    };
+    int pick = static_cast<int>(sequence % 5);
+    ControlRequest request(sequence, CONTROL_PING);
+    if (mix == "effects" || (mix == "all" && sequence % 3 == 0)) {
+        request.code = effectCommands[pick];
+    } else if (mix == "regions" || mix == "all") {
+        if (mix == "all" && pick == 4) {
+            request.code = CONTROL_SAVE_SLOT;
+            PutUint8(request, 3);
+        } else if (pick % 2 == 0) {
+            request.code = CONTROL_LOAD_SLOT;
+            PutUint8(request, static_cast<uint8_t>(1 + sequence % 2));
+        } else {
+            int32_t offset = static_cast<int32_t>(sequence % 64) * 4;
+            request.code = CONTROL_MOVE_REGION;
+            PutInt32(request, 200 + offset);
+            PutInt32(request, 150);
+            PutInt32(request, 1000 + offset);
+            PutInt32(request, 750);
+        }
+    }
+    return request;
+}
+
+// CONTROL_SET_EFFECTS names only inversion, grayscale and the white level, CONTROL_SET_SHARPEN
+// only the sharpening level; everything else, including a temperature queued earlier in the
+// same batch, has to survive them
+bool CheckSetEffectsKeepsOtherEffects() {
+    HeadlessControlTarget target;
+    ColorEffectSettings initial;
+    initial.visionMode = VISION_CORRECT_DEUTAN;
+    initial.sharpenLevel = 2;
+    initial.privacyEffect = PRIVACY_BLUR;
+    initial.blurRadius = 12;
+    initial.binarizeEnabled = true;
+    initial.binarizeWindow = 63;
+    initial.autoInvert = true;
+    initial.smartInvert = true;
+    target.SetEffects(initial);
+
+    std::vector<ControlRequest> requests(3);
+    requests[0] = ControlRequest(0, CONTROL_SET_TEMPERATURE);
+    PutInt32(requests[0], 4500);
+    requests[1] = ControlRequest(1, CONTROL_SET_EFFECTS);
+    PutUint8(requests[1], CONTROL_STATE_INVERTED | CONTROL_STATE_GRAYSCALE);
+    PutUint8(requests[1], 3);
+    requests[2] = ControlRequest(2, CONTROL_SET_SHARPEN);
+    PutUint8(requests[2], NUM_SHARPEN_LEVELS - 1);
+    std::vector<ControlResponse> responses;
+    target.Execute(requests, responses);
+
+    ColorEffectSettings expected = initial;
+    expected.inversionEnabled = true;
+    expected.grayscaleEnabled = true;
+    expected.grayLevel = 3;
+    expected.colorTemperature = 4500;
+    expected.sharpenLevel = NUM_SHARPEN_LEVELS - 1;
+    ColorEffectSettings actual;
+    target.GetEffects(actual);
+
+    bool passed = responses[0].code == CONTROL_OK && responses[1].code == CONTROL_OK && responses[2].code == CONTROL_OK &&
+        actual == expected;
+    printf("set_effects_keeps_other_effects %s\n\n", passed ? "ok" : "FAIL");
+    return passed;
+}
+
+struct ConnectionResult {
+    bool ok;
+    std::string error;
+    std::vector<double> roundTripUs;
+    uint64_t failedCommands; // Answered with CONTROL_FAILED (e.g. loading an empty slot)
+};
+
+// Keep 'depth' requests in flight on one connection until all have been answered
+void RunConnection(const std::string& endpoint, const LoadOptions& options, ConnectionResult& result) {
+    result.ok = false;
+    result.failedCommands = 0;
+    ControlClient client;
+    if (!client.Connect(endpoint)) {
+        result.error = "could not connect to " + endpoint;
+        return;
+    }
+
+    typedef std::chrono::steady_clock Clock;
+    std::vector<Clock::time_point> sentAt(options.commands);
+    result.roundTripUs.reserve(options.commands);
+    std::vector<uint8_t> output;
+    std::vector<ControlResponse> responses;
+    uint32_t sent = 0, answered = 0;
+
+    while (answered < static_cast<uint32_t>(options.commands)) {
+        // Top up to the pipeline depth with a single write
+        output.clear();
+        Clock::time_point now = Clock::now();
+        while (sent < static_cast<uint32_t>(options.commands) && sent - answered < static_cast<uint32_t>(options.depth)) {
+            EncodeControlMessage(MakeRequest(options.mix, sent), output);
+            sentAt[sent++] = now;
+        }
+        if (!output.empty() && !client.Send(output)) {
+            result.error = "send failed";
+            return;
+        }
+
+        responses.clear();
+        if (!client.Receive(responses, 5000)) {
+            result.error = "connection closed";
+            return;
+        }
+        if (responses.empty()) {
+            result.error = "no response within 5 s";
+            return;
+        }
+
+        Clock::time_point received = Clock::now();
+        for (const ControlResponse& response : responses) {
+            if (response.sequence != answered) {
+                result.error = "response out of order";
+                return;
+            }
+            if (response.code == CONTROL_FAILED) {
+                result.failedCommands++;
+            } else if (response.code != CONTROL_OK) {
+                result.error = "request " + std::to_string(answered) + " answered with status " + std::to_string(response.code);
+                return;
+            }
+            result.roundTripUs.push_back(std::chrono::duration<double, std::micro>(received - sentAt[answered]).count());
+            answered++;
+        }
+    }
+    result.ok = true;
+}
+
+bool ParseOptions(const std::vector<std::string>& arguments, LoadOptions& options) {
+    for (const std::string& argument : arguments) {
+        size_t equals = argument.find('=');
+        std::string name = argument.substr(0, equals);
+        std::string value = equals == std::string::npos ? "" : argument.substr(equals + 1);
+
+        bool valid = true;
+        if (name == "--control-load")
+            continue;
+        else if (name == "--connect")
+            valid = !(options.connect = value).empty();
+        else if (name == "--connections")
+            valid = sscanf(value.c_str(), "%d", &options.connections) == 1 && options.connections > 0;
+        else if (name == "--depth")
+            valid = sscanf(value.c_str(), "%d", &options.depth) == 1 && options.depth > 0;
+        else if (name == "--commands")
+            valid = sscanf(value.c_str(), "%d", &options.commands) == 1 && options.commands > 0;
+        else if (name == "--mix")
+            valid = (options.mix = value) == "ping" || value == "effects" || value == "regions" || value == "all";
+        else
+            valid = false;
+
+        if (!valid) {
+            fprintf(stderr, "Invalid argument: %s\n", argument.c_str());
+            return false;
+        }
+    }
+    if (!options.connect.empty() && options.mix == "all") {
+        fprintf(stderr, "--mix=all overwrites saved slots and is only allowed in-process\n");
+        return false;
+    }
+    return true;
+}
+
+}
+
+int RunControlLoad(const std::vector<std::string>& arguments) {
+    LoadOptions options;
+    if (!ParseOptions(arguments, options))
+        return 2;
+
+    if (!CheckSetEffectsKeepsOtherEffects())
+        return 1;
+
+    HeadlessControlTarget target;
+    ControlServer server([&target](const std::vector<ControlRequest>& requests, std::vector<ControlResponse>& responses) {
+        target.Execute(requests, responses);
+    });
+
+    std::string endpoint = options.connect;
+    if (endpoint.empty()) {
+        std::string name = "screenfilter_control_" + std::to_string(std::random_device()());
+#ifdef _WIN32
+        endpoint = name;
+#else
+        endpoint = (std::filesystem::temp_directory_path() / name).string();
+#endif
+        if (!server.Start(endpoint)) {
+            fprintf(stderr, "Could not listen on %s\n", endpoint.c_str());
+            return 1;
+        }
+    }
+
+    printf("Control channel load: %s, %d connection(s), %d in flight each, %d %s commands each\n\n",
+        options.connect.empty() ? "in-process server" : endpoint.c_str(), options.connections, options.depth,
+        options.commands, options.mix.c_str());
+
+    std::vector<ConnectionResult> results(options.connections);
+    std::vector<std::thread> threads;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < options.connections; i++)
+        threads.emplace_back(RunConnection, std::cref(endpoint), std::cref(options), std::ref(results[i]));
+    for (std::thread& thread : threads)
+        thread.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    server.Stop();
+
+    std::vector<double> roundTrips;
+    uint64_t failedCommands = 0;
+    for (const ConnectionResult& result : results) {
+        if (!result.ok) {
+            fprintf(stderr, "Connection failed: %s\n", result.error.c_str());
+            return 1;
+        }
+        roundTrips.insert(roundTrips.end(), result.roundTripUs.begin(), result.roundTripUs.end());
+        failedCommands += result.failedCommands;
+    }
+    std::sort(roundTrips.begin(), roundTrips.end());
+    auto percentile = [&roundTrips](double p) {
+        size_t index = static_cast<size_t>(p / 100.0 * (roundTrips.size() - 1) + 0.5);
+        return roundTrips[index];
+    };
+
+    printf("commands       %zu in %.3f s (%llu answered FAILED)\n", roundTrips.size(), seconds, static_cast<unsigned long long>(failedCommands));
+    printf("throughput     %.0f commands/s\n", roundTrips.size() / seconds);
+    printf("round trip us  min %.1f  p50 %.1f  p90 %.1f  p99 %.1f  max %.1f\n",
+        roundTrips.front(), percentile(50.0), percentile(90.0), percentile(99.0), roundTrips.back());
+    return 0;
+}
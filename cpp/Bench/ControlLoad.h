@@ -0,0 +1,21 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// screenfilter_bench --control-load: load test for the control channel. Each connection keeps
+// a number of requests in flight, topping them up as responses arrive, and the run reports
+// commands per second and the distribution of request round-trip times.
+//
+//   --connect=NAME      test a running filter started with /control=NAME; without it an
+//                       in-process server with a headless model of the window is used
+//   --connections=N     concurrent connections (default 1)
+//   --depth=N           requests in flight per connection; 1 disables pipelining (default 32)
+//   --commands=N        requests per connection (default 100000)
+//   --mix=NAME          ping, effects (toggles and state queries, the default), regions
+//                       (slot loads and moves) or all (adds slot saves; in-process only)
+//
+// First checks in-process that CONTROL_SET_EFFECTS and CONTROL_SET_SHARPEN leave the effects
+// they do not name alone.
+// Returns the process exit code: 0 if that check passes and every request was answered in order.
+int RunControlLoad(const std::vector<std::string>& arguments);
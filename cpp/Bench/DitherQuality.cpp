@@ -0,0 +1,278 @@
+#include "DitherQuality.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include "BenchChecks.h"
+#include "BlueNoise.h"
+#include "PixelImage.h"
+#include "PixelKernels.h"
+
+namespace {
+
+const int blurRadius = 4;
+
+ColorMatrix SettingsMatrix(bool inversion, bool grayscale, int grayLevel) {
+    ColorEffectSettings settings;
+    settings.inversionEnabled = inversion;
+    settings.grayscaleEnabled = grayscale;
+    settings.grayLevel = grayLevel;
+    ColorMatrix matrix;
+    CalculateColorMatrix(settings, matrix);
+    return matrix;
+}
+
+// Gray from 'low' at the left edge to 'high' at the right, the same on every row
+PixelImage GrayRamp(int width, int height, int low, int high) {
+    PixelImage image(width, height);
+    for (int x = 0; x < width; x++) {
+        uint32_t level = static_cast<uint32_t>(low + (high - low) * x / (width - 1));
+        for (int y = 0; y < height; y++)
+            image.At(x, y) = 0xFF000000u | (level << 16) | (level << 8) | level;
+    }
+    return image;
+}
+
+// Unrounded green channel of the filtered image, as the reference in Conformance.cpp computes it
+std::vector<double> IdealGreen(const ColorMatrix& matrix, const PixelImage& source) {
+    std::vector<double> ideal(source.pixels.size());
+    for (size_t i = 0; i < source.pixels.size(); i++) {
+        uint32_t pixel = source.pixels[i];
+        double value = ((pixel >> 16) & 0xFF) * static_cast<double>(matrix.transform[0][1]) +
+            ((pixel >> 8) & 0xFF) * static_cast<double>(matrix.transform[1][1]) +
+            (pixel & 0xFF) * static_cast<double>(matrix.transform[2][1]) + 255.0 * matrix.transform[4][1];
+        ideal[i] = (std::min)(255.0, (std::max)(0.0, value));
+    }
+    return ideal;
+}
+
+// Box blur of a width x height field, skipping the border where the box does not fit
+std::vector<double> BoxBlur(const std::vector<double>& field, int width, int height, int radius) {
+    std::vector<double> blurred;
+    for (int y = radius; y < height - radius; y++) {
+        for (int x = radius; x < width - radius; x++) {
+            double sum = 0.0;
+            for (int dy = -radius; dy <= radius; dy++) {
+                for (int dx = -radius; dx <= radius; dx++)
+                    sum += field[static_cast<size_t>(y + dy) * width + x + dx];
+            }
+            blurred.push_back(sum / ((2 * radius + 1) * (2 * radius + 1)));
+        }
+    }
+    return blurred;
+}
+
+struct Banding {
+    double blurredRms;    // RMS of the blurred error against the unrounded output, in levels
+    double largestStep;   // Largest difference between neighbouring column means, in levels
+};
+
+Banding MeasureBanding(const PixelImage& output, const std::vector<double>& ideal) {
+    int width = output.width, height = output.height;
+    std::vector<double> error(ideal.size());
+    for (size_t i = 0; i < ideal.size(); i++)
+        error[i] = static_cast<double>((output.pixels[i] >> 8) & 0xFF) - ideal[i];
+
+    Banding banding;
+    std::vector<double> blurred = BoxBlur(error, width, height, blurRadius);
+    double sum = 0.0;
+    for (double value : blurred)
+        sum += value * value;
+    banding.blurredRms = std::sqrt(sum / blurred.size());
+
+    banding.largestStep = 0.0;
+    double previous = 0.0;
+    for (int x = 0; x < width; x++) {
+        double mean = 0.0;
+        for (int y = 0; y < height; y++)
+            mean += static_cast<double>((output.pixels[static_cast<size_t>(y) * width + x] >> 8) & 0xFF);
+        mean /= height;
+        if (x > 0)
+            banding.largestStep = (std::max)(banding.largestStep, std::fabs(mean - previous));
+        previous = mean;
+    }
+    return banding;
+}
+
+// Variance of the thresholds after a 3x3 box blur over the wrapping tile
+double LowPassVariance(const float* thresholds) {
+    const int size = BLUE_NOISE_SIZE;
+    double sum = 0.0, sumSquares = 0.0;
+    for (int y = 0; y < size; y++) {
+        for (int x = 0; x < size; x++) {
+            double mean = 0.0;
+            for (int dy = -1; dy <= 1; dy++) {
+                for (int dx = -1; dx <= 1; dx++)
+                    mean += thresholds[((y + dy) & (size - 1)) * size + ((x + dx) & (size - 1))];
+            }
+            mean /= 9.0;
+            sum += mean;
+            sumSquares += mean * mean;
+        }
+    }
+    double count = static_cast<double>(size * size);
+    return sumSquares / count - (sum / count) * (sum / count);
+}
+
+}
+
+void RegisterDitherBenchmarks(BenchSuite& suite) {
+    const struct { const char* name; int width; int height; } sizes[] = {
+        { "1920x1080", 1920, 1080 }, { "3840x2160", 3840, 2160 }
+    };
+    for (int kernel = 0; kernel < PIXEL_KERNEL_COUNT; kernel++) {
+        if (!IsPixelKernelAvailable(static_cast<PixelKernel>(kernel)))
+            continue;
+        for (const auto& size : sizes) {
+            int width = size.width, height = size.height;
+            suite.Add(std::string("pixel_kernel/") + PixelKernelName(static_cast<PixelKernel>(kernel)) + "/" + size.name + "/dither",
+                static_cast<double>(width) * height, [kernel, width, height] {
+                std::shared_ptr<PixelImage> source = std::make_shared<PixelImage>(GrayRamp(width, height, 0, 255));
+                std::shared_ptr<PixelImage> target = std::make_shared<PixelImage>(width, height);
+                ColorMatrix matrix = SettingsMatrix(true, true, 2);
+                BlueNoiseThresholds(); // Generated outside the timed loop
+
+                return BenchBody([kernel, source, target, matrix](uint64_t iterations) {
+                    for (uint64_t i = 0; i < iterations; i++) {
+                        ApplyColorMatrixDithered(static_cast<PixelKernel>(kernel), matrix, source->pixels.data(), target->pixels.data(),
+                            source->width, source->height);
+                        BenchDoNotOptimize(target->pixels[0]);
+                    }
+                });
+            });
+        }
+    }
+
+    suite.Add("blue_noise/generate", 1, [] {
+        return BenchBody([](uint64_t iterations) {
+            std::vector<float> thresholds(BLUE_NOISE_SIZE * BLUE_NOISE_SIZE);
+            for (uint64_t i = 0; i < iterations; i++) {
+                GenerateBlueNoise(thresholds.data());
+                BenchDoNotOptimize(thresholds[0]);
+            }
+        });
+    });
+}
+
+int RunDitherQuality(const std::vector<std::string>& arguments) {
+    double minImprovement = 2.0;
+
+    for (const std::string& argument : arguments) {
+        size_t equals = argument.find('=');
+        std::string name = argument.substr(0, equals);
+        std::string value = equals == std::string::npos ? "" : argument.substr(equals + 1);
+
+        bool valid = true;
+        if (name == "--dither-quality")
+            continue;
+        else if (name == "--min-improvement")
+            valid = sscanf(value.c_str(), "%lf", &minImprovement) == 1 && minImprovement > 0.0;
+        else
+            valid = false;
+
+        if (!valid) {
+            fprintf(stderr, "Invalid argument: %s\n", argument.c_str());
+            return 2;
+        }
+    }
+
+    ResetChecks();
+    char detail[160];
+    const int darkest = NUM_GRAY_LEVELS - 1;
+    PixelKernel best = BestPixelKernel();
+
+    // Gradients at the darkest white level, where the fewest output levels cover them
+    const struct { const char* name; int low; int high; bool inversion; bool grayscale; } ramps[] = {
+        { "banding/dark_ramp", 0, 64, false, true },
+        { "banding/full_ramp", 0, 255, false, true },
+        { "banding/inverted_ramp", 0, 255, true, false },
+        { "banding/inverted_light_ramp", 192, 255, true, true },
+    };
+    for (const auto& ramp : ramps) {
+        PixelImage source = GrayRamp(1920, 256, ramp.low, ramp.high);
+        ColorMatrix matrix = SettingsMatrix(ramp.inversion, ramp.grayscale, darkest);
+        std::vector<double> ideal = IdealGreen(matrix, source);
+
+        PixelImage rounded(source.width, source.height), dithered(source.width, source.height);
+        ApplyColorMatrix(best, matrix, source.pixels.data(), rounded.pixels.data(), source.pixels.size());
+        ApplyColorMatrixDithered(best, matrix, source.pixels.data(), dithered.pixels.data(), source.width, source.height);
+
+        Banding before = MeasureBanding(rounded, ideal), after = MeasureBanding(dithered, ideal);
+        snprintf(detail, sizeof(detail), "blurred error %.3f -> %.3f levels, largest column step %.3f -> %.3f",
+            before.blurredRms, after.blurredRms, before.largestStep, after.largestStep);
+        Check(ramp.name, after.blurredRms * minImprovement <= before.blurredRms && after.largestStep < before.largestStep, detail);
+    }
+
+    // A flat area averages to the unrounded value, for every input level
+    {
+        double worst = 0.0;
+        ColorMatrix matrix = SettingsMatrix(false, false, darkest);
+        PixelImage source(BLUE_NOISE_SIZE, BLUE_NOISE_SIZE), dithered(BLUE_NOISE_SIZE, BLUE_NOISE_SIZE);
+        for (uint32_t level = 0; level < 256; level++) {
+            std::fill(source.pixels.begin(), source.pixels.end(), 0xFF000000u | (level << 16) | (level << 8) | level);
+            ApplyColorMatrixDithered(best, matrix, source.pixels.data(), dithered.pixels.data(), source.width, source.height);
+            double mean = 0.0;
+            for (uint32_t pixel : dithered.pixels)
+                mean += static_cast<double>((pixel >> 8) & 0xFF);
+            mean /= dithered.pixels.size();
+            worst = (std::max)(worst, std::fabs(mean - IdealGreen(matrix, source)[0]));
+        }
+        snprintf(detail, sizeof(detail), "largest difference of a tile's mean %.5f levels", worst);
+        Check("flat_mean_preserved", worst <= 1.0 / 64.0, detail);
+    }
+
+    // The tile: every rank once, and little low-frequency energy next to a shuffled tile
+    {
+        const int area = BLUE_NOISE_SIZE * BLUE_NOISE_SIZE;
+        const float* thresholds = BlueNoiseThresholds();
+        std::vector<int> seen(area, 0);
+        bool permutation = true;
+        for (int i = 0; i < area; i++) {
+            int rank = static_cast<int>(thresholds[i] * area);
+            permutation = permutation && rank >= 0 && rank < area && seen[rank]++ == 0;
+        }
+        Check("tile_is_permutation", permutation, "");
+
+        std::vector<float> white(thresholds, thresholds + area);
+        std::shuffle(white.begin(), white.end(), std::mt19937(7));
+        double blue = LowPassVariance(thresholds), noise = LowPassVariance(white.data());
+        snprintf(detail, sizeof(detail), "3x3 blurred variance %.6f, white noise %.6f", blue, noise);
+        Check("tile_low_frequency", blue * 4.0 < noise, detail);
+    }
+
+    // Kernels agree; widths that are not a multiple of the vector width exercise the scalar tails
+    {
+        std::mt19937 random(42);
+        PixelImage source(1001, 67);
+        for (uint32_t& pixel : source.pixels)
+            pixel = random();
+        int exactDifferences = 0, lutLargest = 0;
+        for (int state = 0; state < 2 * 2 * NUM_GRAY_LEVELS; state++) {
+            ColorMatrix matrix = SettingsMatrix((state & 1) != 0, (state & 2) != 0, state >> 2);
+            PixelImage expected(source.width, source.height);
+            ApplyColorMatrixDithered(PIXEL_KERNEL_SCALAR, matrix, source.pixels.data(), expected.pixels.data(), source.width, source.height);
+            for (int kernel = 0; kernel < PIXEL_KERNEL_COUNT; kernel++) {
+                if (!IsPixelKernelAvailable(static_cast<PixelKernel>(kernel)))
+                    continue;
+                PixelImage actual(source.width, source.height);
+                ApplyColorMatrixDithered(static_cast<PixelKernel>(kernel), matrix, source.pixels.data(), actual.pixels.data(),
+                    source.width, source.height);
+                for (size_t i = 0; i < actual.pixels.size(); i++) {
+                    for (int shift = 0; shift <= 24; shift += 8) {
+                        int difference = std::abs(static_cast<int>((expected.pixels[i] >> shift) & 0xFF) -
+                            static_cast<int>((actual.pixels[i] >> shift) & 0xFF));
+                        if (kernel == PIXEL_KERNEL_LUT)
+                            lutLargest = (std::max)(lutLargest, difference);
+                        else if (difference != 0)
+                            exactDifferences++;
+                    }
+                }
+            }
+        }
+        snprintf(detail, sizeof(detail), "%d differing channels, lut within %d", exactDifferences, lutLargest);
+        Check("kernels_agree", exactDifferences == 0 && lutLargest <= 1, detail);
+    }
+
+    return FinishChecks("dither");
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "BenchHarness.h"
+
+// pixel_kernel/<kernel>/<size>/dither: ApplyColorMatrixDithered with every available kernel on
+// a 1080p and a 4K frame, to compare with the pixel_kernel benchmarks that round to nearest;
+// blue_noise/generate: building the threshold tile
+void RegisterDitherBenchmarks(BenchSuite& suite);
+
+// screenfilter_bench --dither-quality [--min-improvement=X]: renders smooth gradients at the
+// darkest white level with and without dithering and measures banding as the RMS error of the
+// output against the unrounded result after a 9x9 box blur (what the eye averages over), and as
+// the largest jump between neighbouring column means. Checks that dithering cuts the blurred
+// error by at least X (default 2), that flat areas keep their mean, that the threshold tile is a
+// permutation with far less low-frequency energy than white noise, and that every kernel
+// dithers alike. Returns the process exit code: 0 if every check passes.
+int RunDitherQuality(const std::vector<std::string>& arguments);
@@ -0,0 +1,217 @@
+#include "EffectTransitions.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include "BenchChecks.h"
+#include "EffectTransition.h"
+
+namespace {
+
+const int64_t frameMs = 16; // timerInterval in ScreenInversion.cpp
+const int stateCount = 2 * 2 * NUM_GRAY_LEVELS;
+
+// Inversion in bit 0, grayscale in bit 1, the white level above
+ColorMatrix StateMatrix(int state) {
+    ColorEffectSettings settings;
+    settings.inversionEnabled = (state & 1) != 0;
+    settings.grayscaleEnabled = (state & 2) != 0;
+    settings.grayLevel = state >> 2;
+    ColorMatrix matrix;
+    CalculateColorMatrix(settings, matrix);
+    return matrix;
+}
+
+float Entry(const ColorMatrix& matrix, int i) {
+    return matrix.transform[i / 5][i % 5];
+}
+
+// Equal entries; inversion turns zeros into negative zeros, which the magnifier treats alike
+bool SameMatrix(const ColorMatrix& a, const ColorMatrix& b) {
+    for (int i = 0; i < 25; i++) {
+        if (Entry(a, i) != Entry(b, i))
+            return false;
+    }
+    return true;
+}
+
+// Fade 'from' to 'to' frame by frame, checking every step; returns a description of the first
+// problem, or NULL
+const char* CheckFade(const ColorMatrix& from, const ColorMatrix& to, int64_t durationMs) {
+    EffectTransition transition;
+    transition.Start(from, 0, 0);
+    int differing = 0;
+    for (int i = 0; i < 25; i++)
+        differing += Entry(from, i) != Entry(to, i) ? 1 : 0;
+
+    uint64_t stepsBefore = transition.GetStepCount();
+    uint64_t writtenBefore = transition.GetEntriesWritten();
+    transition.Start(to, 0, durationMs);
+    if (transition.GetChangedCount() != differing)
+        return "blends entries that do not differ";
+
+    ColorMatrix previous = from;
+    int64_t nowMs = 0;
+    while (transition.IsActive()) {
+        nowMs += frameMs;
+        if (!transition.Step(nowMs))
+            return "a frame step left the matrix unchanged";
+        const ColorMatrix& shown = transition.GetMatrix();
+        for (int i = 0; i < 25; i++) {
+            float start = Entry(from, i), end = Entry(to, i), before = Entry(previous, i), now = Entry(shown, i);
+            if (start == end && now != start)
+                return "an entry that does not differ changed";
+            if ((end - start) * (now - before) < 0.0f)
+                return "an entry moved backwards";
+            // Smoothstep is steepest halfway, at 1.5 times the linear rate
+            float limit = 1.5f * std::fabs(end - start) * frameMs / durationMs + 1e-5f;
+            if (std::fabs(now - before) > limit)
+                return "an entry moved faster than the curve allows";
+        }
+        previous = shown;
+    }
+
+    if (!SameMatrix(transition.GetMatrix(), to))
+        return "did not end exactly on the target";
+    uint64_t frames = static_cast<uint64_t>((durationMs + frameMs - 1) / frameMs);
+    if (differing > 0 && transition.GetStepCount() - stepsBefore != (durationMs > 0 ? frames : 1))
+        return "took another number of steps than frames in the duration";
+    if (transition.GetEntriesWritten() - writtenBefore != (transition.GetStepCount() - stepsBefore) * differing)
+        return "wrote more entries than differ";
+    return NULL;
+}
+
+}
+
+void RegisterEffectTransitionBenchmarks(BenchSuite& suite) {
+    suite.Add("effect_transition/step", 1, [] {
+        return BenchBody([](uint64_t iterations) {
+            ColorMatrix ends[2] = { StateMatrix(0), StateMatrix(1 | 2 | ((NUM_GRAY_LEVELS - 1) << 2)) };
+            EffectTransition transition;
+            int64_t nowMs = 0;
+            for (uint64_t i = 0; i < iterations; i++) {
+                if (!transition.IsActive())
+                    transition.Start(ends[(i / 16) % 2], nowMs, 16 * frameMs);
+                nowMs += frameMs;
+                BenchDoNotOptimize(transition.Step(nowMs));
+            }
+            BenchDoNotOptimize(transition.GetMatrix());
+        });
+    });
+}
+
+int RunEffectTransitions(const std::vector<std::string>& arguments) {
+    int durationMs = 200;
+    double budgetNs = 1000.0;
+
+    for (const std::string& argument : arguments) {
+        size_t equals = argument.find('=');
+        std::string name = argument.substr(0, equals);
+        std::string value = equals == std::string::npos ? "" : argument.substr(equals + 1);
+
+        bool valid = true;
+        if (name == "--transitions")
+            continue;
+        else if (name == "--duration-ms")
+            valid = sscanf(value.c_str(), "%d", &durationMs) == 1 && durationMs >= 0;
+        else if (name == "--budget-ns")
+            valid = sscanf(value.c_str(), "%lf", &budgetNs) == 1 && budgetNs > 0.0;
+        else
+            valid = false;
+
+        if (!valid) {
+            fprintf(stderr, "Invalid argument: %s\n", argument.c_str());
+            return 2;
+        }
+    }
+
+    ColorMatrix matrices[stateCount];
+    for (int state = 0; state < stateCount; state++)
+        matrices[state] = StateMatrix(state);
+
+    ResetChecks();
+    char detail[128];
+
+    // Every change between two effect states
+    const char* problem = NULL;
+    int pairs = 0;
+    for (int from = 0; from < stateCount && problem == NULL; from++) {
+        for (int to = 0; to < stateCount && problem == NULL; to++) {
+            if (from != to) {
+                problem = CheckFade(matrices[from], matrices[to], durationMs);
+                snprintf(detail, sizeof(detail), "state %d to %d: %s", from, to, problem != NULL ? problem : "");
+                pairs++;
+            }
+        }
+    }
+    if (problem == NULL)
+        snprintf(detail, sizeof(detail), "%d pairs, %d ms", pairs, durationMs);
+    Check("all_state_pairs", problem == NULL, detail);
+
+    // Pressing invert again halfway fades back from the blend on screen
+    if (durationMs > 0) {
+        EffectTransition transition;
+        transition.Start(matrices[1], 0, durationMs);
+        int64_t nowMs = 0;
+        for (; nowMs + frameMs <= durationMs / 2; nowMs += frameMs)
+            transition.Step(nowMs + frameMs);
+        ColorMatrix halfway = transition.GetMatrix();
+        transition.Start(matrices[0], nowMs, durationMs);
+        bool unchanged = SameMatrix(halfway, transition.GetMatrix());
+        transition.Step(nowMs + frameMs);
+        float largest = 0.0f;
+        for (int i = 0; i < 25; i++)
+            largest = (std::max)(largest, std::fabs(Entry(transition.GetMatrix(), i) - Entry(halfway, i)));
+        float limit = 1.5f * 2.0f * frameMs / durationMs; // Inversion moves entries by up to 2
+        snprintf(detail, sizeof(detail), "largest change in the first frame back %.4f, limit %.4f", largest, limit);
+        Check("reverse_halfway", unchanged && largest <= limit + 1e-5f, detail);
+    }
+
+    // A duration of 0 switches at once
+    {
+        EffectTransition transition;
+        transition.Start(matrices[1], 0, 0);
+        bool passed = !transition.IsActive() && SameMatrix(transition.GetMatrix(), matrices[1]);
+        Check("zero_duration", passed, "");
+    }
+
+    // Per-frame cost: a step against rebuilding the matrix from the settings and blending all of it
+    const int sweeps = 50;
+    double stepNs = MedianNsPerOperation([&]() {
+        EffectTransition transition;
+        uint64_t steps = 0;
+        int64_t nowMs = 0;
+        for (int sweep = 0; sweep < sweeps; sweep++) {
+            for (int to = 0; to < stateCount; to++) {
+                transition.Start(matrices[to], nowMs, 10 * frameMs);
+                while (transition.IsActive()) {
+                    nowMs += frameMs;
+                    transition.Step(nowMs);
+                    steps++;
+                }
+            }
+        }
+        BenchDoNotOptimize(transition.GetMatrix());
+        return steps;
+    });
+    double rebuildNs = MedianNsPerOperation([&]() {
+        ColorMatrix blended;
+        uint64_t frames = 0;
+        for (int sweep = 0; sweep < sweeps; sweep++) {
+            for (int to = 0; to < stateCount; to++) {
+                for (int frame = 1; frame <= 10; frame++) {
+                    ColorMatrix from = StateMatrix((to + stateCount - 1) % stateCount), target = StateMatrix(to);
+                    float t = frame / 10.0f;
+                    for (int i = 0; i < 25; i++)
+                        blended.transform[i / 5][i % 5] = Entry(from, i) + (Entry(target, i) - Entry(from, i)) * t;
+                    BenchDoNotOptimize(blended);
+                    frames++;
+                }
+            }
+        }
+        return frames;
+    });
+    snprintf(detail, sizeof(detail), "%.1f ns per frame (rebuilding: %.1f ns), budget %.0f ns", stepNs, rebuildNs, budgetNs);
+    Check("step_within_budget", stepNs < budgetNs, detail);
+
+    return FinishChecks("effect transition");
+}
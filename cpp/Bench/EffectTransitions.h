@@ -0,0 +1,17 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "BenchHarness.h"
+
+// effect_transition/step: one frame's Step() of a fade between the identity and inverted
+// grayscale at the lowest white level, where the most entries differ
+void RegisterEffectTransitionBenchmarks(BenchSuite& suite);
+
+// screenfilter_bench --transitions [--duration-ms=N] [--budget-ns=N]: fades between every pair
+// of the 16 effect states on a fake 16 ms frame clock (default duration 200 ms) and checks that
+// each step blends only the entries that differ, moves every entry monotonically and no faster
+// than the smoothstep slope allows, and ends exactly on the target; that reversing mid-way does
+// not jump; and that a step costs less than the per-frame budget (default 1000 ns).
+// Returns the process exit code: 0 if every check passes.
+int RunEffectTransitions(const std::vector<std::string>& arguments);
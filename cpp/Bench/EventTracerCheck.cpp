@@ -0,0 +1,330 @@
+#include "EventTracerCheck.h"
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <thread>
+#include "BenchChecks.h"
+#include "EventTracer.h"
+
+namespace {
+
+const int maxThreads = 16;
+const int eventsPerThread = 20000; // Below TRACE_BUFFER_EVENTS: the writer may read while they record
+
+// Thread names must be string literals, like event names
+const char* const threadNames[maxThreads] = {
+    "worker 0", "worker 1", "worker 2", "worker 3", "worker 4", "worker 5", "worker 6", "worker 7",
+    "worker 8", "worker 9", "worker 10", "worker 11", "worker 12", "worker 13", "worker 14", "worker 15"
+};
+
+// A complete ("X") event as read back from the written trace
+struct WrittenEvent {
+    std::string name;
+    double startUs;
+    double durationUs;
+    int threadId;
+    bool hasArg;
+    long long arg;
+};
+
+struct WrittenTrace {
+    std::vector<WrittenEvent> events;
+    std::map<int, std::string> threadNames;
+    size_t reportedCount; // What WriteChromeTrace() returned
+};
+
+// Text between "key": and the next character of 'stop', or an empty string
+std::string FieldText(const std::string& line, const char* key, const char* stop) {
+    size_t at = line.find(key);
+    if (at == std::string::npos)
+        return std::string();
+    at += strlen(key);
+    return line.substr(at, line.find_first_of(stop, at) - at);
+}
+
+// The tracer writes one event per line, so this needs no JSON parser
+WrittenTrace WriteAndRead(const EventTracer& tracer) {
+    std::ostringstream out;
+    WrittenTrace trace;
+    trace.reportedCount = tracer.WriteChromeTrace(out);
+
+    std::istringstream in(out.str());
+    std::string line;
+    while (std::getline(in, line)) {
+        int threadId = atoi(FieldText(line, "\"tid\":", ",}").c_str());
+        if (line.find("\"ph\":\"M\"") != std::string::npos) {
+            trace.threadNames[threadId] = FieldText(line, "\"args\":{\"name\":\"", "\"");
+        } else if (line.find("\"ph\":\"X\"") != std::string::npos) {
+            WrittenEvent event;
+            event.name = FieldText(line, "{\"name\":\"", "\"");
+            event.startUs = atof(FieldText(line, "\"ts\":", ",").c_str());
+            event.durationUs = atof(FieldText(line, "\"dur\":", ",").c_str());
+            event.threadId = threadId;
+            size_t args = line.find("\"args\":{");
+            event.hasArg = args != std::string::npos;
+            event.arg = event.hasArg ? atoll(line.c_str() + line.find("\":", args + 9) + 2) : 0;
+            trace.events.push_back(event);
+        }
+    }
+    return trace;
+}
+
+// Whether 'inner' lies within 'outer'; timestamps are written to the nanosecond
+bool Contains(const WrittenEvent& outer, const WrittenEvent& inner) {
+    const double slackUs = 0.0005;
+    return inner.startUs >= outer.startUs - slackUs &&
+        inner.startUs + inner.durationUs <= outer.startUs + outer.durationUs + slackUs;
+}
+
+void CheckNesting() {
+    EventTracer tracer;
+    tracer.Start();
+    {
+        TraceScope outer(tracer, "outer", "check");
+        {
+            TraceScope inner(tracer, "inner", "check", "depth", 2);
+            TraceScope innermost(tracer, "innermost", "check", "depth", 3);
+        }
+        TraceScope sibling(tracer, "sibling", "check");
+    }
+    tracer.Stop();
+    {
+        TraceScope stopped(tracer, "stopped", "check");
+    }
+
+    // Scopes are recorded as they end: innermost first
+    WrittenTrace trace = WriteAndRead(tracer);
+    const std::vector<WrittenEvent>& events = trace.events;
+    bool ordered = events.size() == 4 && trace.reportedCount == 4 && events[0].name == "innermost" &&
+        events[1].name == "inner" && events[2].name == "sibling" && events[3].name == "outer";
+    Check("scopes_recorded_as_they_end", ordered, std::to_string(events.size()) + " events");
+    if (!ordered)
+        return;
+
+    bool nested = Contains(events[1], events[0]) && Contains(events[3], events[1]) && Contains(events[3], events[2]) &&
+        events[2].startUs >= events[1].startUs + events[1].durationUs - 0.0005;
+    Check("scopes_nest", nested, "");
+    Check("scope_arguments", events[0].hasArg && events[0].arg == 3 && events[1].hasArg && events[1].arg == 2 &&
+        !events[2].hasArg, "");
+}
+
+void CheckWrap() {
+    EventTracer tracer;
+    tracer.Start();
+    const int64_t overflow = 1000;
+    const int64_t total = TRACE_BUFFER_EVENTS + overflow;
+    std::chrono::steady_clock::time_point origin = std::chrono::steady_clock::now();
+    for (int64_t i = 0; i < total; i++)
+        tracer.Record("event", "check", origin + std::chrono::nanoseconds(i * 1000), origin + std::chrono::nanoseconds(i * 1000 + 500), "i", i);
+    tracer.Stop();
+
+    WrittenTrace trace = WriteAndRead(tracer);
+    bool newest = trace.events.size() == TRACE_BUFFER_EVENTS && trace.reportedCount == TRACE_BUFFER_EVENTS;
+    for (size_t i = 0; newest && i < trace.events.size(); i++)
+        newest = trace.events[i].arg == overflow + static_cast<int64_t>(i);
+    Check("wrap_keeps_newest_in_order", newest, std::to_string(trace.events.size()) + " of " + std::to_string(total) + " events kept");
+
+    // Start() discards what the ring holds
+    tracer.Start();
+    tracer.Record("after_restart", "check", origin, origin);
+    tracer.Stop();
+    trace = WriteAndRead(tracer);
+    Check("restart_discards", trace.events.size() == 1 && trace.events[0].name == "after_restart",
+        std::to_string(trace.events.size()) + " events");
+}
+
+void CheckRecreatedTracer() {
+    // The calling thread caches its buffer; a new tracer must not inherit the old one's, even
+    // when it is allocated where the old one was
+    std::unique_ptr<EventTracer> first(new EventTracer());
+    first->Start();
+    {
+        TraceScope scope(*first, "first", "check");
+    }
+    const void* firstAddress = first.get();
+    first.reset();
+
+    std::unique_ptr<EventTracer> second(new EventTracer());
+    second->Start();
+    {
+        TraceScope scope(*second, "second", "check");
+    }
+    second->Stop();
+    WrittenTrace trace = WriteAndRead(*second);
+    Check("recreated_tracer", trace.events.size() == 1 && trace.events[0].name == "second",
+        std::to_string(trace.events.size()) + " events, " + (second.get() == firstAddress ? "same address" : "new address"));
+
+    // Two live tracers used in turn from one thread
+    EventTracer a, b;
+    a.Start();
+    b.Start();
+    { TraceScope scope(a, "a1", "check"); }
+    { TraceScope scope(b, "b1", "check"); }
+    { TraceScope scope(a, "a2", "check"); }
+    a.Stop();
+    b.Stop();
+    WrittenTrace traceA = WriteAndRead(a), traceB = WriteAndRead(b);
+    Check("alternating_tracers", traceA.events.size() == 2 && traceA.events[0].name == "a1" && traceA.events[1].name == "a2" &&
+        traceB.events.size() == 1 && traceB.events[0].name == "b1", "");
+}
+
+void CheckThreads(int threadCount) {
+    EventTracer tracer;
+    tracer.Start();
+
+    // Workers record in rounds and wait for a snapshot between them, so snapshots overlap
+    // recording even on a single core
+    const int rounds = 10;
+    std::atomic<int> named(0), finished(0), snapshots(0);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threadCount; t++) {
+        workers.emplace_back([&tracer, &named, &finished, &snapshots, t] {
+            tracer.SetThreadName(threadNames[t]);
+            named.fetch_add(1);
+            for (int64_t i = 0; i < eventsPerThread; i++) {
+                while (i % (eventsPerThread / rounds) == 0 && snapshots.load() < i / (eventsPerThread / rounds))
+                    std::this_thread::yield();
+                TraceScope scope(tracer, "work", "check", "i", i);
+            }
+            finished.fetch_add(1);
+        });
+    }
+    while (named.load() < threadCount)
+        std::this_thread::yield();
+
+    // Writing while they record: every snapshot must hold a prefix of each thread's events
+    bool prefixes = true;
+    std::map<int, size_t> lastCounts;
+    do {
+        WrittenTrace trace = WriteAndRead(tracer);
+        std::map<int, size_t> counts;
+        for (const WrittenEvent& event : trace.events) {
+            size_t& count = counts[event.threadId];
+            prefixes = prefixes && event.arg == static_cast<long long>(count);
+            count++;
+        }
+        for (const std::pair<const int, size_t>& count : counts)
+            prefixes = prefixes && count.second >= lastCounts[count.first];
+        lastCounts = counts;
+        snapshots.fetch_add(1);
+    } while (finished.load() < threadCount);
+    for (std::thread& worker : workers)
+        worker.join();
+    tracer.Stop();
+
+    WrittenTrace trace = WriteAndRead(tracer);
+    std::map<int, size_t> counts;
+    bool complete = trace.events.size() == static_cast<size_t>(threadCount) * eventsPerThread;
+    for (const WrittenEvent& event : trace.events) {
+        size_t& count = counts[event.threadId];
+        complete = complete && event.arg == static_cast<long long>(count);
+        count++;
+    }
+    bool namedTracks = counts.size() == static_cast<size_t>(threadCount);
+    for (const std::pair<const int, size_t>& count : counts) {
+        std::map<int, std::string>::const_iterator name = trace.threadNames.find(count.first);
+        namedTracks = namedTracks && name != trace.threadNames.end() && name->second.compare(0, 7, "worker ") == 0;
+    }
+
+    Check("threads_flush_while_recording", prefixes, std::to_string(snapshots.load()) + " snapshots");
+    Check("threads_all_events", complete, std::to_string(trace.events.size()) + " events from " +
+        std::to_string(counts.size()) + " threads");
+    Check("threads_named_tracks", namedTracks, "");
+}
+
+void CheckRestartWhileRecording(int threadCount) {
+    EventTracer tracer;
+    tracer.Start();
+
+    // Workers number their events and keep recording through each restart
+    const int restarts = 5;
+    const int64_t eventsBetween = 2000;
+    std::atomic<bool> stop(false);
+    std::unique_ptr<std::atomic<int64_t>[]> recorded(new std::atomic<int64_t>[threadCount]);
+    for (int t = 0; t < threadCount; t++)
+        recorded[t].store(0);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threadCount; t++) {
+        workers.emplace_back([&tracer, &stop, &recorded, t] {
+            tracer.SetThreadName(threadNames[t]);
+            for (int64_t i = 0; !stop.load(); i++) {
+                { TraceScope scope(tracer, "work", "check", "i", i); }
+                recorded[t].store(i + 1);
+            }
+        });
+    }
+
+    // Events finished before the last Start() must be gone; one in flight may land either side
+    std::vector<int64_t> before(threadCount, 0);
+    for (int restart = 0; restart < restarts; restart++) {
+        for (int t = 0; t < threadCount; t++) {
+            while (recorded[t].load() < before[t] + eventsBetween)
+                std::this_thread::yield();
+        }
+        for (int t = 0; t < threadCount; t++)
+            before[t] = recorded[t].load();
+        tracer.Start();
+    }
+    for (int t = 0; t < threadCount; t++) {
+        while (recorded[t].load() < before[t] + eventsBetween)
+            std::this_thread::yield();
+    }
+    stop.store(true);
+    for (std::thread& worker : workers)
+        worker.join();
+    tracer.Stop();
+
+    WrittenTrace trace = WriteAndRead(tracer);
+    std::map<int, long long> next;
+    size_t stale = 0, gaps = 0;
+    for (const WrittenEvent& event : trace.events) {
+        int worker = atoi(trace.threadNames[event.threadId].c_str() + 7);
+        if (event.arg < before[worker])
+            stale++;
+        std::map<int, long long>::iterator expected = next.find(event.threadId);
+        if (expected != next.end() && event.arg != expected->second)
+            gaps++;
+        next[event.threadId] = event.arg + 1;
+    }
+    Check("restart_while_recording", stale == 0 && gaps == 0 && next.size() == static_cast<size_t>(threadCount),
+        std::to_string(trace.events.size()) + " events after " + std::to_string(restarts) + " restarts, " +
+        std::to_string(stale) + " stale, " + std::to_string(gaps) + " gap(s)");
+}
+
+}
+
+int RunEventTracerChecks(const std::vector<std::string>& arguments) {
+    int threads = 8;
+
+    for (const std::string& argument : arguments) {
+        size_t equals = argument.find('=');
+        std::string name = argument.substr(0, equals);
+        std::string value = equals == std::string::npos ? "" : argument.substr(equals + 1);
+
+        bool valid = true;
+        if (name == "--event-tracer")
+            continue;
+        else if (name == "--threads")
+            valid = sscanf(value.c_str(), "%d", &threads) == 1 && threads > 0 && threads <= maxThreads;
+        else
+            valid = false;
+
+        if (!valid) {
+            fprintf(stderr, "Invalid argument: %s\n", argument.c_str());
+            return 2;
+        }
+    }
+
+    ResetChecks();
+    CheckNesting();
+    CheckWrap();
+    CheckRecreatedTracer();
+    CheckThreads(threads);
+    CheckRestartWhileRecording(threads);
+
+    return FinishChecks("event tracer");
+}
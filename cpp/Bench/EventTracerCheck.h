@@ -0,0 +1,13 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// screenfilter_bench --event-tracer [--threads=N]: checks EventTracer through the Chrome trace
+// it writes. Nested scopes must come out innermost first and inside their parent; a full ring
+// buffer must keep exactly the newest events in order; a tracer created after another was
+// destroyed (usually at the same address) and two tracers used in turn on one thread must each
+// get only their own events; and N threads (default 8) recording while another thread writes
+// the trace must lose nothing and never show an event before the ones recorded ahead of it.
+// Returns the process exit code: 0 if every check passes.
+int RunEventTracerChecks(const std::vector<std::string>& arguments);
@@ -0,0 +1,211 @@
+#include "InputBurst.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include "EffectController.h"
+#include "RateLimiter.h"
+#include "ShortcutConfig.h"
+
+namespace {
+
+// timerInterval and titleUpdateInterval in ScreenInversion.cpp
+const int64_t frameIntervalUs = 16000;
+const int64_t titleIntervalUs = 100000;
+
+// The status title as WriteStatusTitle() formats it
+void FormatStatusTitle(const ColorEffectSettings& settings, const ShortcutConfig& shortcuts, char* text, size_t size) {
+    char modeText[64] = "";
+    if (settings.visionMode != VISION_NORMAL) {
+        snprintf(modeText, sizeof(modeText), "%s %d%% ", VisionModeName(settings.visionMode),
+            settings.visionSeverity * 100 / (NUM_VISION_SEVERITIES - 1));
+    }
+    if (settings.colorTemperature != COLOR_TEMPERATURE_NEUTRAL) {
+        size_t length = strlen(modeText);
+        snprintf(modeText + length, sizeof(modeText) - length, "%dK ", settings.colorTemperature);
+    }
+    if (settings.sharpenLevel > 0) {
+        size_t length = strlen(modeText);
+        snprintf(modeText + length, sizeof(modeText) - length, "Sharp %.0f%% ", SharpenStrengths[settings.sharpenLevel] * 100.0f);
+    }
+    if (settings.privacyEffect != PRIVACY_NONE) {
+        size_t length = strlen(modeText);
+        snprintf(modeText + length, sizeof(modeText) - length, "%s %dpx ", PrivacyEffectName(settings.privacyEffect),
+            settings.privacyEffect == PRIVACY_BLUR ? settings.blurRadius : settings.pixelateBlock);
+    }
+    if (settings.binarizeEnabled) {
+        size_t length = strlen(modeText);
+        snprintf(modeText + length, sizeof(modeText) - length, "Binary %dpx ", settings.binarizeWindow);
+    }
+    if (settings.autoInvert) {
+        size_t length = strlen(modeText);
+        snprintf(modeText + length, sizeof(modeText) - length, "Auto ");
+    }
+    if (settings.smartInvert) {
+        size_t length = strlen(modeText);
+        snprintf(modeText + length, sizeof(modeText) - length, "Smart ");
+    }
+    snprintf(text, size, "Filter - %s%s%sGray:%.0f%% (%s=Invert, %s=Colour, %s=White level, %s=Vision, Ctrl+1-9=Save)",
+        settings.inversionEnabled ? "Inverted " : "",
+        settings.grayscaleEnabled ? "Grayscale " : "Color ",
+        modeText,
+        GrayLevelScales[settings.grayLevel] * 100.0f,
+        FormatKeyChord(shortcuts.toggleInvert).c_str(), FormatKeyChord(shortcuts.toggleGrayscale).c_str(),
+        FormatKeyChord(shortcuts.cycleWhiteLevel).c_str(), FormatKeyChord(shortcuts.cycleVisionMode).c_str());
+}
+
+}
+
+// Replay a burst of effect key presses under the given policy
+BurstWork RunInputBurst(BurstPolicy policy, int events, double spacingUs, uint32_t seed) {
+    ShortcutConfig shortcuts;
+    EffectController effects;
+    RateLimiter titleLimiter(titleIntervalUs);
+    ColorMatrix magnifierMatrix = effects.GetMatrix(); // Stands in for the magnifier's color effect
+    std::string windowTitle;                           // Stands in for the window title
+    char title[320];
+    BurstWork work = {};
+    int64_t now = 0;
+
+    auto writeTitle = [&]() {
+        FormatStatusTitle(effects.GetSettings(), shortcuts, title, sizeof(title));
+        work.titleFormats++;
+        windowTitle = title;
+        work.titleWrites++;
+    };
+    // ApplyColorEffects()
+    auto applyEffects = [&]() {
+        magnifierMatrix = effects.GetMatrix();
+        work.effectApplies++;
+        if (policy == BURST_IMMEDIATE || titleLimiter.Request(now))
+            writeTitle();
+    };
+    // UpdateMagWindow()
+    auto frame = [&]() {
+        work.frames++;
+        if (policy == BURST_COALESCED) {
+            if (effects.Flush())
+                applyEffects();
+            if (titleLimiter.TakeDue(now))
+                writeTitle();
+        }
+    };
+
+    // Mostly a held white-level key, with invert and grayscale mashed in between
+    std::mt19937 random(seed);
+    std::uniform_int_distribution<int> choice(0, 9);
+    int64_t nextFrameUs = frameIntervalUs;
+    for (int i = 0; i < events; i++) {
+        now = static_cast<int64_t>(i * spacingUs);
+        for (; nextFrameUs <= now; nextFrameUs += frameIntervalUs) {
+            int64_t eventTime = now;
+            now = nextFrameUs;
+            frame();
+            now = eventTime;
+        }
+
+        int pick = choice(random);
+        const KeyChord& chord = pick < 6 ? shortcuts.cycleWhiteLevel : (pick < 8 ? shortcuts.toggleInvert : shortcuts.toggleGrayscale);
+        EffectAction action = EffectActionForKey(shortcuts, chord.key, chord.modifiers);
+        work.events++;
+        if (policy == BURST_IMMEDIATE) {
+            effects.Apply(action);
+            applyEffects();
+        } else {
+            effects.Queue(action);
+        }
+    }
+
+    // Run the frame timer until everything queued or deferred has reached the screen
+    do {
+        now = nextFrameUs;
+        nextFrameUs += frameIntervalUs;
+        frame();
+    } while (effects.HasPending() || titleLimiter.IsPending());
+
+    work.matrixBuilds = effects.GetMatrixBuilds();
+    work.finalSettings = effects.GetSettings();
+    BenchDoNotOptimize(magnifierMatrix);
+    BenchDoNotOptimize(windowTitle);
+    return work;
+}
+
+void RegisterInputBurstBenchmarks(BenchSuite& suite) {
+    static const int events = 1000;
+    suite.Add("input_burst/immediate", events, [] {
+        return BenchBody([](uint64_t iterations) {
+            for (uint64_t i = 0; i < iterations; i++)
+                BenchDoNotOptimize(RunInputBurst(BURST_IMMEDIATE, events, 1000.0, 1));
+        });
+    });
+    suite.Add("input_burst/coalesced", events, [] {
+        return BenchBody([](uint64_t iterations) {
+            for (uint64_t i = 0; i < iterations; i++)
+                BenchDoNotOptimize(RunInputBurst(BURST_COALESCED, events, 1000.0, 1));
+        });
+    });
+}
+
+int RunInputBurstReport(const std::vector<std::string>& arguments) {
+    int events = 1000;
+    double spacingUs = 1000.0;
+    uint32_t seed = 1;
+
+    for (const std::string& argument : arguments) {
+        size_t equals = argument.find('=');
+        std::string name = argument.substr(0, equals);
+        std::string value = equals == std::string::npos ? "" : argument.substr(equals + 1);
+
+        bool valid = true;
+        if (name == "--input-burst")
+            continue;
+        else if (name == "--events")
+            valid = sscanf(value.c_str(), "%d", &events) == 1 && events > 0;
+        else if (name == "--spacing-us")
+            valid = sscanf(value.c_str(), "%lf", &spacingUs) == 1 && spacingUs >= 0.0;
+        else if (name == "--seed")
+            valid = sscanf(value.c_str(), "%u", &seed) == 1;
+        else
+            valid = false;
+
+        if (!valid) {
+            fprintf(stderr, "Invalid argument: %s\n", argument.c_str());
+            return 2;
+        }
+    }
+
+    BurstWork work[2];
+    double medianUs[2];
+    const int runs = 21;
+    for (int policy = 0; policy < 2; policy++) {
+        std::vector<double> times;
+        for (int run = 0; run < runs; run++) {
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            work[policy] = RunInputBurst(static_cast<BurstPolicy>(policy), events, spacingUs, seed);
+            times.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+        }
+        std::sort(times.begin(), times.end());
+        medianUs[policy] = times[runs / 2];
+    }
+
+    printf("%d effect key presses, %.0f us apart, against a 16 ms frame timer\n\n", events, spacingUs);
+    printf("%-36s %12s %12s\n", "", "immediate", "coalesced");
+    const struct { const char* name; uint64_t BurstWork::* field; } rows[] = {
+        { "frames", &BurstWork::frames },
+        { "matrix builds", &BurstWork::matrixBuilds },
+        { "effect applies (MagSetColorEffect)", &BurstWork::effectApplies },
+        { "title formats", &BurstWork::titleFormats },
+        { "title writes (SetWindowText)", &BurstWork::titleWrites },
+    };
+    for (const auto& row : rows)
+        printf("%-36s %12llu %12llu\n", row.name, static_cast<unsigned long long>(work[0].*row.field), static_cast<unsigned long long>(work[1].*row.field));
+    printf("%-36s %12.1f %12.1f\n", "handling time (us, median)", medianUs[0], medianUs[1]);
+
+    // Coalescing may skip intermediate states but must end where the presses lead
+    if (work[0].finalSettings != work[1].finalSettings) {
+        fprintf(stderr, "Final effect settings differ between policies\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "BenchHarness.h"
+#include "ColorEffects.h"
+
+// How effect key presses reach the magnifier
+enum BurstPolicy {
+    BURST_IMMEDIATE, // Every press rebuilds the matrix, applies it and rewrites the title
+    BURST_COALESCED  // Presses are queued and applied once per frame; title rewrites are rate-limited
+};
+
+// Work done while handling a burst
+struct BurstWork {
+    uint64_t events;
+    uint64_t frames;
+    uint64_t matrixBuilds;
+    uint64_t effectApplies; // MagSetColorEffect calls in the application
+    uint64_t titleFormats;
+    uint64_t titleWrites;   // SetWindowText calls in the application
+    ColorEffectSettings finalSettings;
+};
+
+// Replay a burst of effect key presses, 'spacingUs' apart in simulated time, against a 16 ms
+// frame timer, handling them as the application does under the given policy
+BurstWork RunInputBurst(BurstPolicy policy, int events, double spacingUs, uint32_t seed);
+
+// input_burst/immediate and input_burst/coalesced: time to handle a 1000-event burst
+void RegisterInputBurstBenchmarks(BenchSuite& suite);
+
+// screenfilter_bench --input-burst [--events=N] [--spacing-us=N] [--seed=N]: prints the work
+// each policy does for one burst and how long it takes. Returns the process exit code.
+int RunInputBurstReport(const std::vector<std::string>& arguments);
@@ -0,0 +1,820 @@
+#include "InputReplay.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include "Clock.h"
+#include "ControlProtocol.h"
+#include "EffectController.h"
+#include "InputLog.h"
+#include "RateLimiter.h"
+#include "RegionEffects.h"
+#include "SavedRectanglesManager.h"
+#include "TimerWheel.h"
+
+namespace {
+
+// Constants of ScreenInversion.cpp
+const UINT hotkeyTogglePin = 1;         // HOTKEY_TOGGLE_PIN
+const int64_t titleIntervalMs = 100;    // titleUpdateInterval
+const int64_t overlayIntervalMs = 1000; // metricsOverlayInterval
+const int64_t messageTimeoutMs = 2000;  // Slot messages before the title is restored
+const int64_t frameIntervalUs = 16000;  // timerInterval
+const int64_t frameIntervalMs = 16;
+
+// Work an input caused, counted where the application makes the call
+struct ReplayWork {
+    uint64_t matrixBuilds;
+    uint64_t effectApplies; // MagSetColorEffect
+    uint64_t fileReads;     // Saved rectangle file loads
+    uint64_t fileWrites;
+    uint64_t showStates;    // ShowWindow
+    uint64_t windowMoves;   // SetWindowPos
+    uint64_t styleChanges;  // SetWindowLong
+    uint64_t opacityChanges; // SetLayeredWindowAttributes
+    uint64_t themeUpdates;  // ApplyDarkModeToWindow
+    uint64_t titleWrites;   // SetWindowText
+    uint64_t timersSet;     // Timer wheel schedules
+};
+
+const struct { const char* name; uint64_t ReplayWork::* field; } workColumns[] = {
+    { "matrix_builds", &ReplayWork::matrixBuilds },
+    { "effect_applies", &ReplayWork::effectApplies },
+    { "file_reads", &ReplayWork::fileReads },
+    { "file_writes", &ReplayWork::fileWrites },
+    { "show_states", &ReplayWork::showStates },
+    { "window_moves", &ReplayWork::windowMoves },
+    { "style_changes", &ReplayWork::styleChanges },
+    { "opacity_changes", &ReplayWork::opacityChanges },
+    { "theme_updates", &ReplayWork::themeUpdates },
+    { "title_writes", &ReplayWork::titleWrites },
+    { "timers_set", &ReplayWork::timersSet },
+};
+
+// Add the work done between two readings of the counters
+void AddWork(ReplayWork& total, const ReplayWork& after, const ReplayWork& before) {
+    for (const auto& column : workColumns)
+        total.*column.field += after.*column.field - before.*column.field;
+}
+
+// Headless model of the filter window: the handlers of ScreenInversion.cpp with the platform
+// calls replaced by counters and the window rectangle they would produce. The region state
+// machine is the application's own.
+class HeadlessWindow : public ControlTarget {
+private:
+    InputLogHeader header;
+    ShortcutConfig shortcuts;
+    EffectController effects;
+    HeadlessRegionPlatform platform; // Holds where the window is
+    RegionStateMachine region;
+    InputLogSlot slots[NUM_SAVED_RECTS]; // What a saved rectangle file read returns
+    RateLimiter titleLimiter;
+
+    int currentCycleSlot;
+    bool metricsOverlayEnabled;
+    int64_t overlaySampleMs;
+    bool deferredInitDone;
+    bool statusShown;    // The title shows the status rather than a message
+    TimerWheel timers;   // Advanced by the frame timer
+    TimerHandle titleResetTimer;
+    int64_t nowMs;
+    uint64_t frameMoves; // SetWindowPos reclaiming topmost each frame
+
+    ReplayWork work;
+
+    // SetHostTitle() with a message rather than the status
+    void ShowMessage() {
+        work.titleWrites++;
+        statusShown = false;
+        titleLimiter.Cancel();
+    }
+
+    void ShowTemporaryTitle() {
+        ShowMessage();
+        timers.Reschedule(titleResetTimer, nowMs, messageTimeoutMs, RestoreTitle, this);
+        work.timersSet++;
+    }
+
+    static void RestoreTitle(void* context) {
+        HeadlessWindow* window = static_cast<HeadlessWindow*>(context);
+        if (window->region.IsSelectionComplete())
+            window->UpdateTitle();
+        else if (window->region.GetState().selection == SELECTION_NONE)
+            window->ShowMessage(); // The selection prompt
+    }
+
+    void WriteStatusTitle() {
+        work.titleWrites++;
+        statusShown = true;
+    }
+
+    void UpdateTitle() {
+        if (titleLimiter.Request(nowMs))
+            WriteStatusTitle();
+    }
+
+    void ApplyColorEffects() {
+        if (region.SyncEffects(effects.GetGeneration()))
+            UpdateTitle();
+    }
+
+    void ApplyLoadedRectangle(const RECT& rect) {
+        region.Dispatch(RegionEvent::Load(rect));
+        ApplyColorEffects();
+        ShowMessage();
+    }
+
+    void ApplySlotEffects(const InputLogSlot& slot) {
+        ColorEffectSettings settings;
+        settings.inversionEnabled = slot.inversionEnabled;
+        settings.grayscaleEnabled = slot.grayscaleEnabled;
+        settings.grayLevel = slot.grayLevel;
+        slot.effects.ApplyTo(settings);
+        effects.SetSettings(settings);
+    }
+
+    void HandleRectangleSelection(POINT clickPoint) {
+        RegionAction action = region.Dispatch(RegionEvent::Click(clickPoint));
+        if (action == REGION_ACTION_FIRST_POINT) {
+            ShowMessage();
+        } else if (action == REGION_ACTION_SELECT) {
+            ColorEffectSettings initialSettings = effects.GetSettings();
+            initialSettings.inversionEnabled = true;
+            effects.SetSettings(initialSettings);
+            ApplyColorEffects();
+            ShowMessage();
+        }
+    }
+
+    bool LoadRectangle(int slot) {
+        work.fileReads++;
+        if (!slots[slot].isValid) {
+            ShowTemporaryTitle();
+            return false;
+        }
+        ApplySlotEffects(slots[slot]);
+        ApplyLoadedRectangle(slots[slot].windowRect);
+        return true;
+    }
+
+    bool CycleToNextSavedRectangle() {
+        work.fileReads++;
+        int attempts = 0;
+        do {
+            currentCycleSlot++;
+            if (currentCycleSlot >= NUM_SAVED_RECTS)
+                currentCycleSlot = 1;
+            attempts++;
+        } while (!slots[currentCycleSlot].isValid && attempts < NUM_SAVED_RECTS);
+
+        if (slots[currentCycleSlot].isValid) {
+            ApplySlotEffects(slots[currentCycleSlot]);
+            ApplyLoadedRectangle(slots[currentCycleSlot].windowRect);
+            ShowTemporaryTitle();
+            return true;
+        }
+        ShowTemporaryTitle();
+        return false;
+    }
+
+    void SaveCurrentRectangle(int slot) {
+        if (slot <= 0 || slot >= NUM_SAVED_RECTS || !region.IsSelectionComplete())
+            return;
+        InputLogSlot& entry = slots[slot];
+        entry.isValid = true;
+        entry.inversionEnabled = effects.GetSettings().inversionEnabled;
+        entry.grayscaleEnabled = effects.GetSettings().grayscaleEnabled;
+        entry.grayLevel = static_cast<uint8_t>(effects.GetSettings().grayLevel);
+        entry.windowRect = platform.windowRect;
+        entry.effects.Capture(effects.GetSettings());
+
+        // SavePreservingExisting() merges into what is on disk
+        work.fileReads++;
+        work.fileWrites++;
+        ShowTemporaryTitle();
+    }
+
+    bool HandleEffectShortcut(UINT key, UINT modifiers) {
+        if (effects.Queue(EffectActionForKey(shortcuts, key, modifiers)))
+            return true;
+
+        KeyChord pressed = { key, modifiers };
+        if (pressed == shortcuts.toggleMetricsOverlay) {
+            metricsOverlayEnabled = !metricsOverlayEnabled;
+            overlaySampleMs = nowMs;
+            UpdateTitle();
+            return true;
+        }
+        return pressed == shortcuts.toggleTrace;
+    }
+
+    void HandleKey(UINT key, UINT modifiers) {
+        bool ctrlPressed = (modifiers & MOD_CONTROL) != 0;
+        if (key == shortcuts.escapeKey) {
+            region.Dispatch(RegionEvent(REGION_RESTORE));
+        } else if (key == '0') {
+            CycleToNextSavedRectangle();
+        } else if (key > '0' && key <= '9') {
+            int slot = static_cast<int>(key) - '0';
+            if (ctrlPressed && region.IsSelectionComplete())
+                SaveCurrentRectangle(slot);
+            else if (!ctrlPressed && region.GetState().selection != SELECTION_FIRST_POINT)
+                LoadRectangle(slot);
+        } else if (region.IsSelectionComplete()) {
+            HandleEffectShortcut(key, modifiers);
+        }
+    }
+
+    void HandleHotkey(UINT id) {
+        if (id == hotkeyTogglePin && region.Dispatch(RegionEvent(REGION_TOGGLE_PIN)) != REGION_ACTION_NONE)
+            UpdateTitle();
+    }
+
+    void HandleFrame() {
+        frameMoves++;
+        if (effects.Flush())
+            ApplyColorEffects();
+        if (metricsOverlayEnabled && nowMs - overlaySampleMs >= overlayIntervalMs) {
+            overlaySampleMs = nowMs;
+            if (region.IsSelectionComplete() && statusShown)
+                UpdateTitle();
+        }
+        if (titleLimiter.TakeDue(nowMs))
+            WriteStatusTitle();
+        if (!deferredInitDone) {
+            deferredInitDone = true;
+            region.Dispatch(RegionEvent(REGION_ENABLE_THEME));
+        }
+    }
+
+public:
+    explicit HeadlessWindow(const InputLogHeader& logHeader)
+        : header(logHeader), platform(logHeader.frame, logHeader.screenWidth, logHeader.screenHeight), region(platform),
+          slots(), titleLimiter(titleIntervalMs), currentCycleSlot(1), metricsOverlayEnabled(false), overlaySampleMs(0),
+          deferredInitDone(false), statusShown(false), timers(frameIntervalMs), titleResetTimer(0), nowMs(0), frameMoves(0),
+          work() {
+        region.Dispatch(RegionEvent(REGION_SHOW)); // As WinMain() shows the window before recording starts
+        for (int i = 0; i < NUM_SAVED_RECTS; i++)
+            slots[i].slot = static_cast<uint8_t>(i);
+    }
+
+    const ReplayWork& GetWork() {
+        work.matrixBuilds = effects.GetMatrixBuilds();
+        work.effectApplies = region.GetSideEffectCount(REGION_EFFECT_COLOR_EFFECT);
+        work.showStates = region.GetSideEffectCount(REGION_EFFECT_SHOW_STATE);
+        work.windowMoves = region.GetSideEffectCount(REGION_EFFECT_POSITION) + frameMoves;
+        work.styleChanges = region.GetSideEffectCount(REGION_EFFECT_STYLE) + region.GetSideEffectCount(REGION_EFFECT_EX_STYLE);
+        work.opacityChanges = region.GetSideEffectCount(REGION_EFFECT_OPACITY);
+        work.themeUpdates = region.GetSideEffectCount(REGION_EFFECT_THEME);
+        return work;
+    }
+
+    void SetTimeUs(int64_t timeUs) { nowMs = timeUs / 1000; }
+
+    // As the frame timer does before anything else: fire the timers due by now. Returns the number fired.
+    size_t AdvanceTimers() { return timers.Advance(nowMs); }
+
+    // Take over a recorded state, e.g. the one the window started in
+    void SetState(const InputLogState& state) {
+        ColorEffectSettings settings;
+        settings.inversionEnabled = (state.flags & INPUT_STATE_INVERTED) != 0;
+        settings.grayscaleEnabled = (state.flags & INPUT_STATE_GRAYSCALE) != 0;
+        settings.grayLevel = state.grayLevel;
+        state.effects.ApplyTo(settings);
+        effects.SetSettings(settings);
+        currentCycleSlot = state.cycleSlot;
+        platform.windowRect = state.windowRect;
+
+        // The window as the region state machine would have left it in that state
+        RegionState recorded = region.GetState();
+        recorded.selection = state.selection;
+        recorded.fullScreen = (state.flags & INPUT_STATE_FULL_SCREEN) != 0;
+        recorded.pinned = (state.flags & INPUT_STATE_PINNED) != 0;
+        recorded.effectsApplied = (state.flags & INPUT_STATE_EFFECTS_APPLIED) != 0;
+        recorded.effectsGeneration = effects.GetGeneration();
+        recorded.hostWindowRect = state.windowRect;
+        recorded.selectedRect.left = state.windowRect.left + header.frame.borderWidth;
+        recorded.selectedRect.top = state.windowRect.top + header.frame.titleBarHeight + header.frame.borderHeight;
+        recorded.selectedRect.right = state.windowRect.right - header.frame.borderWidth;
+        recorded.selectedRect.bottom = state.windowRect.bottom - header.frame.borderHeight;
+
+        RegionPresentation& applied = recorded.applied;
+        bool complete = recorded.selection == SELECTION_COMPLETE;
+        applied.visible = true;
+        applied.maximized = !complete;
+        applied.style = complete && recorded.fullScreen ? REGION_STYLE_FULL_SCREEN : REGION_STYLE_RESTORED;
+        applied.exStyle = static_cast<uint8_t>(REGION_EX_TOPMOST | REGION_EX_LAYERED |
+            (complete && (recorded.fullScreen || recorded.pinned) ? REGION_EX_TRANSPARENT : 0));
+        applied.opaque = complete;
+        applied.themed = recorded.themeEnabled && applied.style == REGION_STYLE_RESTORED;
+        applied.windowRect = state.windowRect;
+        region.SetState(recorded);
+        statusShown = complete;
+    }
+
+    InputLogState CaptureState() const {
+        InputLogState state;
+        const ColorEffectSettings& settings = effects.GetSettings();
+        const RegionState& regionState = region.GetState();
+        state.selection = regionState.selection;
+        state.flags = static_cast<uint8_t>((regionState.fullScreen ? INPUT_STATE_FULL_SCREEN : 0) |
+            (regionState.pinned ? INPUT_STATE_PINNED : 0) | (settings.inversionEnabled ? INPUT_STATE_INVERTED : 0) |
+            (settings.grayscaleEnabled ? INPUT_STATE_GRAYSCALE : 0) | (regionState.effectsApplied ? INPUT_STATE_EFFECTS_APPLIED : 0));
+        state.grayLevel = static_cast<uint8_t>(settings.grayLevel);
+        state.cycleSlot = static_cast<uint8_t>(currentCycleSlot);
+        state.windowRect = platform.windowRect;
+        state.effects.Capture(settings);
+        return state;
+    }
+
+    const ShortcutConfig& GetShortcuts() const { return shortcuts; }
+    const InputLogSlot& GetSlot(int slot) const { return slots[slot]; }
+
+    // Context records
+    void Apply(const InputLogRecord& record) {
+        if (record.type == INPUT_LOG_MOVED)
+            platform.windowRect = record.windowRect;
+        else if (record.type == INPUT_LOG_SLOT && record.slot.slot < NUM_SAVED_RECTS)
+            slots[record.slot.slot] = record.slot;
+        else if (record.type == INPUT_LOG_SHORTCUTS)
+            shortcuts = record.shortcuts;
+    }
+
+    // Input records, as HostWndProc() and UpdateMagWindow() handle them
+    void Handle(const InputLogRecord& record) {
+        switch (record.type) {
+        case INPUT_LOG_CLICK:
+            if (!region.IsSelectionComplete())
+                HandleRectangleSelection(record.point);
+            break;
+        case INPUT_LOG_KEY:
+            HandleKey(record.key, record.modifiers);
+            break;
+        case INPUT_LOG_SYSKEY:
+            if (region.IsSelectionComplete())
+                HandleEffectShortcut(record.key, record.modifiers);
+            break;
+        case INPUT_LOG_HOTKEY:
+            HandleHotkey(record.key);
+            break;
+        case INPUT_LOG_MAXIMIZE:
+            region.Dispatch(RegionEvent(REGION_MAXIMIZE));
+            break;
+        case INPUT_LOG_FRAME:
+            HandleFrame();
+            break;
+        case INPUT_LOG_CONTROL: {
+            ControlResponse response;
+            ExecuteControlRequest(*this, record.control, response);
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    // ControlTarget, as WindowControlTarget in ScreenInversion.cpp
+    ControlStatus LoadSlot(int slot) override {
+        bool loaded = slot == 0 ? CycleToNextSavedRectangle() : LoadRectangle(slot);
+        return loaded ? CONTROL_OK : CONTROL_FAILED;
+    }
+
+    ControlStatus SaveSlot(int slot) override {
+        if (!region.IsSelectionComplete())
+            return CONTROL_FAILED;
+        SaveCurrentRectangle(slot);
+        return CONTROL_OK;
+    }
+
+    ControlStatus ApplyEffect(EffectAction action) override {
+        effects.Queue(action);
+        return CONTROL_OK;
+    }
+
+    ControlStatus SetEffects(const ColorEffectSettings& settings) override {
+        effects.SetSettings(settings);
+        ApplyColorEffects();
+        return CONTROL_OK;
+    }
+
+    void GetEffects(ColorEffectSettings& settings) override {
+        settings = effects.GetPendingSettings();
+    }
+
+    ControlStatus MoveRegion(const RECT& rect) override {
+        ApplyLoadedRectangle(rect);
+        return CONTROL_OK;
+    }
+
+    ControlStatus SetTemperature(int kelvin) override {
+        effects.QueueTemperature(kelvin);
+        return CONTROL_OK;
+    }
+
+    void GetState(ControlState& state) override {
+        const ColorEffectSettings& settings = effects.GetSettings();
+        state.flags = (settings.inversionEnabled ? CONTROL_STATE_INVERTED : 0) |
+            (settings.grayscaleEnabled ? CONTROL_STATE_GRAYSCALE : 0) | (region.GetState().pinned ? CONTROL_STATE_PINNED : 0);
+        state.grayLevel = static_cast<uint8_t>(settings.grayLevel);
+        state.left = platform.windowRect.left;
+        state.top = platform.windowRect.top;
+        state.right = platform.windowRect.right;
+        state.bottom = platform.windowRect.bottom;
+    }
+};
+
+struct ReplayOptions {
+    std::string logPath;
+    bool realTime = false;
+    int events = 2000;
+    uint32_t seed = 1;
+    std::string savePath;
+    std::string jsonPath;
+};
+
+// Work and time per kind of input; index 0 holds the title reset timers
+struct InputCost {
+    uint64_t count;
+    ReplayWork work;
+    double totalNs;
+};
+
+const int costKinds = INPUT_LOG_CONTROL + 1;
+
+const char* CostName(int kind) {
+    return kind == 0 ? "timer" : InputLogRecordName(static_cast<InputLogRecordType>(kind));
+}
+
+std::string DescribeEffects(const InputLogEffects& effects) {
+    char text[160];
+    snprintf(text, sizeof(text), "flags 0x%02x vision %d/%d %dK sharpen %d privacy %d (%d, %d) binarize %dpx",
+        effects.flags, effects.visionMode, effects.visionSeverity, effects.colorTemperature, effects.sharpenLevel,
+        effects.privacyEffect, effects.blurRadius, effects.pixelateBlock, effects.binarizeWindow);
+    return text;
+}
+
+RECT MakeRect(LONG left, LONG top, LONG right, LONG bottom) {
+    RECT rect = { left, top, right, bottom };
+    return rect;
+}
+
+// A session on a 1920x1080 screen: select an area, then a mix of effect keys (some held down),
+// slot loads, saves and cycling, pinning, full screen, window drags and control commands.
+// Picks use the generator's raw output, so every standard library produces the same session.
+void GenerateSession(const ReplayOptions& options, InputLogHeader& header, std::vector<InputLogRecord>& records) {
+    header.frame.titleBarHeight = 23;
+    header.frame.borderWidth = 8;
+    header.frame.borderHeight = 8;
+    header.screenWidth = 1920;
+    header.screenHeight = 1080;
+
+    std::mt19937 random(options.seed);
+    auto pick = [&random](uint32_t count) { return static_cast<int>(random() % count); };
+
+    InputLogRecord shortcuts(INPUT_LOG_SHORTCUTS, 0);
+    records.push_back(shortcuts);
+    for (int slot = 1; slot <= 3; slot++) {
+        InputLogRecord record(INPUT_LOG_SLOT, 0);
+        record.slot.slot = static_cast<uint8_t>(slot);
+        record.slot.isValid = true;
+        record.slot.inversionEnabled = slot != 2;
+        record.slot.grayscaleEnabled = slot == 3;
+        record.slot.grayLevel = static_cast<uint8_t>(slot - 1);
+        record.slot.windowRect = MakeRect(slot * 300, 100 + slot * 50, slot * 300 + 640, 580 + slot * 50);
+        records.push_back(record);
+    }
+    InputLogRecord initial(INPUT_LOG_STATE, 0);
+    initial.state.cycleSlot = 1;
+    initial.state.windowRect = MakeRect(-8, -8, 1928, 1048); // Maximized for selection
+    records.push_back(initial);
+
+    int64_t timeUs = 0;
+    int64_t nextFrameUs = frameIntervalUs;
+    auto add = [&](InputLogRecord record) {
+        for (; nextFrameUs <= record.timeUs; nextFrameUs += frameIntervalUs)
+            records.push_back(InputLogRecord(INPUT_LOG_FRAME, nextFrameUs));
+        records.push_back(record);
+    };
+    auto key = [&](UINT code, UINT modifiers) {
+        InputLogRecord record(INPUT_LOG_KEY, timeUs);
+        record.key = code;
+        record.modifiers = modifiers;
+        add(record);
+    };
+
+    for (int i = 0; i < options.events; i++) {
+        timeUs += 30000 + pick(370) * 1000;
+        if (i < 2) {
+            InputLogRecord click(INPUT_LOG_CLICK, timeUs);
+            click.point.x = i == 0 ? 400 : 1200;
+            click.point.y = i == 0 ? 300 : 800;
+            add(click);
+            continue;
+        }
+
+        int choice = pick(100);
+        if (choice < 35) {
+            // Mostly the original three, then the other effects with their default bindings
+            static const KeyChord effectKeys[] = {
+                { 'I', 0 }, { 'C', 0 }, { 'W', 0 }, { 'I', 0 }, { 'C', 0 }, { 'W', 0 },
+                { 'V', 0 }, { 'V', MOD_SHIFT }, { 'K', 0 }, { 'K', MOD_SHIFT }, { 'B', 0 }, { 'H', 0 },
+                { 'H', MOD_SHIFT }, { 'A', 0 }, { 'A', MOD_SHIFT }
+            };
+            const KeyChord& chord = effectKeys[pick(sizeof(effectKeys) / sizeof(effectKeys[0]))];
+            key(chord.key, chord.modifiers);
+        } else if (choice < 42) {
+            // Held white level key: autorepeat every 33 ms
+            for (int repeat = 0; repeat < 10; repeat++, timeUs += 33000)
+                key('W', 0);
+        } else if (choice < 54) {
+            key('1' + pick(5), 0);
+        } else if (choice < 62) {
+            key('0', 0);
+        } else if (choice < 68) {
+            key('1' + pick(9), MOD_CONTROL);
+        } else if (choice < 75) {
+            InputLogRecord hotkey(INPUT_LOG_HOTKEY, timeUs);
+            hotkey.key = hotkeyTogglePin;
+            add(hotkey);
+        } else if (choice < 79) {
+            add(InputLogRecord(INPUT_LOG_MAXIMIZE, timeUs));
+        } else if (choice < 83) {
+            key(VK_ESCAPE, 0);
+        } else if (choice < 87) {
+            InputLogRecord moved(INPUT_LOG_MOVED, timeUs);
+            LONG left = pick(1200), top = pick(600);
+            moved.windowRect = MakeRect(left, top, left + 320 + pick(400), top + 240 + pick(300));
+            add(moved);
+        } else {
+            static const uint8_t commands[] = {
+                CONTROL_TOGGLE_INVERT, CONTROL_CYCLE_WHITE_LEVEL, CONTROL_GET_STATE, CONTROL_SET_EFFECTS,
+                CONTROL_LOAD_SLOT, CONTROL_MOVE_REGION
+            };
+            InputLogRecord control(INPUT_LOG_CONTROL, timeUs);
+            control.control.code = commands[pick(6)];
+            if (control.control.code == CONTROL_SET_EFFECTS) {
+                PutUint8(control.control, static_cast<uint8_t>(pick(4)));
+                PutUint8(control.control, static_cast<uint8_t>(pick(NUM_GRAY_LEVELS)));
+            } else if (control.control.code == CONTROL_LOAD_SLOT) {
+                PutUint8(control.control, static_cast<uint8_t>(pick(6))); // 0 cycles
+            } else if (control.control.code == CONTROL_MOVE_REGION) {
+                LONG left = pick(1200), top = pick(600);
+                PutInt32(control.control, left);
+                PutInt32(control.control, top);
+                PutInt32(control.control, left + 640);
+                PutInt32(control.control, top + 480);
+            }
+            add(control);
+        }
+    }
+
+    // Let the last presses and title resets play out
+    InputLogRecord last(INPUT_LOG_FRAME, timeUs + messageTimeoutMs * 1000);
+    add(last);
+}
+
+bool ParseOptions(const std::vector<std::string>& arguments, ReplayOptions& options) {
+    for (const std::string& argument : arguments) {
+        size_t equals = argument.find('=');
+        std::string name = argument.substr(0, equals);
+        std::string value = equals == std::string::npos ? "" : argument.substr(equals + 1);
+
+        bool valid = true;
+        if (name == "--replay")
+            options.logPath = value;
+        else if (name == "--speed")
+            valid = (options.realTime = value == "real") || value == "max";
+        else if (name == "--events")
+            valid = sscanf(value.c_str(), "%d", &options.events) == 1 && options.events > 0;
+        else if (name == "--seed")
+            valid = sscanf(value.c_str(), "%u", &options.seed) == 1;
+        else if (name == "--save")
+            valid = !(options.savePath = value).empty();
+        else if (name == "--json")
+            valid = !(options.jsonPath = value).empty();
+        else
+            valid = false;
+
+        if (!valid) {
+            fprintf(stderr, "Invalid argument: %s\n", argument.c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
+bool WriteReplayJson(const std::string& path, const ReplayOptions& options, const InputCost* costs, uint64_t mismatches) {
+    std::ofstream out(path, std::ios::trunc);
+    if (!out.is_open())
+        return false;
+
+    out << "{\n  \"context\": {\"log\": \"" << (options.logPath.empty() ? "synthetic" : options.logPath) << "\"";
+    if (options.logPath.empty())
+        out << ", \"events\": " << options.events << ", \"seed\": " << options.seed;
+    out << ", \"state_mismatches\": " << mismatches << "},\n  \"benchmarks\": [";
+
+    // One entry per input kind and counter, in the layout compare_bench.py reads
+    const char* separator = "\n";
+    for (int kind = 0; kind < costKinds; kind++) {
+        if (costs[kind].count == 0)
+            continue;
+        for (const auto& column : workColumns) {
+            uint64_t total = costs[kind].work.*column.field;
+            out << separator << "    {\"name\": \"replay/" << CostName(kind) << "/" << column.name << "\", \"per_event\": "
+                << static_cast<double>(total) / costs[kind].count << ", \"total\": " << total << "}";
+            separator = ",\n";
+        }
+    }
+    out << "\n  ],\n  \"timing\": [";
+    separator = "\n";
+    for (int kind = 0; kind < costKinds; kind++) {
+        if (costs[kind].count == 0)
+            continue;
+        out << separator << "    {\"name\": \"replay/" << CostName(kind) << "\", \"count\": " << costs[kind].count
+            << ", \"mean_ns\": " << costs[kind].totalNs / costs[kind].count << "}";
+        separator = ",\n";
+    }
+    out << "\n  ]\n}\n";
+    return true;
+}
+
+}
+
+int RunReplay(const std::vector<std::string>& arguments) {
+    ReplayOptions options;
+    if (!ParseOptions(arguments, options))
+        return 2;
+
+    InputLogHeader header;
+    std::vector<InputLogRecord> records;
+    if (options.logPath.empty()) {
+        GenerateSession(options, header, records);
+    } else {
+        std::string error;
+        if (!ReadInputLogFile(options.logPath.c_str(), header, records, error)) {
+            fprintf(stderr, "%s: %s\n", options.logPath.c_str(), error.c_str());
+            return 1;
+        }
+    }
+
+    InputLogWriter saved;
+    if (!options.savePath.empty() && !saved.Open(options.savePath.c_str(), header)) {
+        fprintf(stderr, "Could not write %s\n", options.savePath.c_str());
+        return 1;
+    }
+
+    HeadlessWindow window(header);
+    size_t next = 0;
+
+    // Context recorded before the first input sets the window up
+    bool hasInitialState = false;
+    for (; next < records.size() && !IsInputLogEvent(records[next].type); next++) {
+        if (records[next].type == INPUT_LOG_STATE) {
+            window.SetState(records[next].state);
+            hasInitialState = true;
+        } else {
+            window.Apply(records[next]);
+        }
+    }
+    InputLogRecord shortcutsRecord(INPUT_LOG_SHORTCUTS, 0);
+    shortcutsRecord.shortcuts = window.GetShortcuts();
+    saved.Write(shortcutsRecord);
+    for (int slot = 0; slot < NUM_SAVED_RECTS; slot++) {
+        if (window.GetSlot(slot).isValid) {
+            InputLogRecord slotRecord(INPUT_LOG_SLOT, 0);
+            slotRecord.slot = window.GetSlot(slot);
+            saved.Write(slotRecord);
+        }
+    }
+    InputLogState savedState = window.CaptureState();
+    InputLogRecord stateRecord(INPUT_LOG_STATE, 0);
+    stateRecord.state = savedState;
+    saved.Write(stateRecord);
+
+    // States are only checked against logs that record them after inputs
+    bool checkStates = hasInitialState && std::any_of(records.begin() + next, records.end(),
+        [](const InputLogRecord& record) { return record.type == INPUT_LOG_STATE; });
+    InputLogState expected = savedState;
+    uint64_t statesChecked = 0, mismatches = 0;
+
+    InputCost costs[costKinds] = {};
+    uint64_t inputs = 0;
+    SteadyClock clock;
+    // 'handle' returns how many inputs or timers it handled; frames with no timer due add nothing
+    auto measure = [&](int kind, auto handle) {
+        ReplayWork before = window.GetWork();
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        uint64_t count = handle();
+        if (count == 0)
+            return;
+        costs[kind].totalNs += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        AddWork(costs[kind].work, window.GetWork(), before);
+        costs[kind].count += count;
+    };
+
+    std::chrono::steady_clock::time_point replayStart = std::chrono::steady_clock::now();
+    while (next < records.size()) {
+        const InputLogRecord& record = records[next++];
+        if (options.realTime)
+            clock.SleepUntilNs(record.timeUs * 1000);
+        window.SetTimeUs(record.timeUs);
+
+        if (record.type == INPUT_LOG_FRAME)
+            measure(0, [&] { return window.AdvanceTimers(); });
+
+        if (!IsInputLogEvent(record.type)) {
+            // States outside an input's group (e.g. in an edited log) are left out: the saved
+            // log gets the replayed states instead
+            window.Apply(record);
+            if (record.type != INPUT_LOG_STATE)
+                saved.Write(record);
+            continue;
+        }
+
+        // The saved rectangles the window read while handling the input come right after it
+        saved.Write(record);
+        for (; next < records.size() && records[next].type == INPUT_LOG_SLOT; next++) {
+            window.Apply(records[next]);
+            saved.Write(records[next]);
+        }
+        inputs++;
+        measure(record.type, [&] { window.Handle(record); return 1; });
+
+        if (next < records.size() && records[next].type == INPUT_LOG_STATE)
+            expected = records[next++].state;
+        InputLogState reached = window.CaptureState();
+        if (checkStates) {
+            // Version 1 logs do not record the newer effects, so only the rest is compared
+            bool differs = header.version >= 2 ? reached != expected : !reached.SameVersion1State(expected);
+            statesChecked++;
+            if (differs && mismatches++ < 5) {
+                fprintf(stderr, "State differs after %s at %.3f s: recorded selection %d flags 0x%02x gray %d slot %d window (%ld,%ld)-(%ld,%ld), "
+                    "replayed selection %d flags 0x%02x gray %d slot %d window (%ld,%ld)-(%ld,%ld)\n",
+                    InputLogRecordName(record.type), record.timeUs / 1e6,
+                    expected.selection, expected.flags, expected.grayLevel, expected.cycleSlot,
+                    static_cast<long>(expected.windowRect.left), static_cast<long>(expected.windowRect.top),
+                    static_cast<long>(expected.windowRect.right), static_cast<long>(expected.windowRect.bottom),
+                    reached.selection, reached.flags, reached.grayLevel, reached.cycleSlot,
+                    static_cast<long>(reached.windowRect.left), static_cast<long>(reached.windowRect.top),
+                    static_cast<long>(reached.windowRect.right), static_cast<long>(reached.windowRect.bottom));
+                if (reached.effects != expected.effects)
+                    fprintf(stderr, "  effects: recorded %s, replayed %s\n", DescribeEffects(expected.effects).c_str(),
+                        DescribeEffects(reached.effects).c_str());
+            }
+            // Carry on from the recorded state so one divergence is reported once
+            if (differs)
+                window.SetState(expected);
+        }
+        if (reached != savedState) {
+            stateRecord.timeUs = record.timeUs;
+            stateRecord.state = savedState = reached;
+            saved.Write(stateRecord);
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - replayStart).count();
+    saved.Close();
+
+    printf("Replayed %s: %llu inputs over %.1f s of recording in %.3f s (%s speed)\n",
+        options.logPath.empty() ? ("synthetic session, seed " + std::to_string(options.seed)).c_str() : options.logPath.c_str(),
+        static_cast<unsigned long long>(inputs), records.empty() ? 0.0 : records.back().timeUs / 1e6, seconds,
+        options.realTime ? "real" : "maximum");
+    if (checkStates)
+        printf("States: %llu checked, %llu differed from the recording\n", static_cast<unsigned long long>(statesChecked),
+            static_cast<unsigned long long>(mismatches));
+    else
+        printf("States: not recorded in this log, not checked\n");
+
+    printf("\nWork per input (averages)\n%-9s %8s", "input", "count");
+    static const char* headings[] = { "matrix", "effect", "file rd", "file wr", "show", "move", "style", "opacity", "theme", "title", "timer" };
+    for (const char* heading : headings)
+        printf(" %8s", heading);
+    printf(" %10s\n", options.realTime ? "" : "ns");
+
+    InputCost total = {};
+    for (int kind = 1; kind <= costKinds; kind++) {
+        const InputCost& cost = costs[kind % costKinds]; // Timers last
+        if (cost.count == 0)
+            continue;
+        printf("%-9s %8llu", CostName(kind % costKinds), static_cast<unsigned long long>(cost.count));
+        for (const auto& column : workColumns)
+            printf(" %8.2f", static_cast<double>(cost.work.*column.field) / cost.count);
+        if (options.realTime)
+            printf("\n");
+        else
+            printf(" %10.0f\n", cost.totalNs / cost.count);
+        total.count += cost.count;
+        AddWork(total.work, cost.work, ReplayWork());
+        total.totalNs += cost.totalNs;
+    }
+    printf("%-9s %8llu", "total", static_cast<unsigned long long>(total.count));
+    for (const auto& column : workColumns)
+        printf(" %8llu", static_cast<unsigned long long>(total.work.*column.field));
+    printf("\n");
+
+    if (!options.jsonPath.empty() && !WriteReplayJson(options.jsonPath, options, costs, mismatches)) {
+        fprintf(stderr, "Could not write %s\n", options.jsonPath.c_str());
+        return 1;
+    }
+    return mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// screenfilter_bench --replay: drives a headless model of the filter window's input handling
+// (two-click selection, slot loading, saving and cycling, pinning, full screen, effect keys,
+// control commands and the frame timer) from an input log, and reports the work each kind of
+// input caused: matrix rebuilds, MagSetColorEffect calls, saved rectangle file reads and
+// writes, ShowWindow, SetWindowPos, SetWindowLong and SetLayeredWindowAttributes calls, dark
+// mode updates, title writes and timers scheduled. Timers fire on frame ticks, as they do
+// in the application.
+//
+//   --replay=PATH       log recorded by the application with /record=PATH. Without a path, a
+//                       synthetic session is generated from --events and --seed.
+//   --speed=NAME        max (default) replays back to back and times each input;
+//                       real waits out the recorded gaps between inputs
+//   --events=N          synthetic session: inputs besides frame ticks (default 2000)
+//   --seed=N            synthetic session: random seed (default 1)
+//   --save=PATH         write the replayed log with the states the replay reached, e.g. to
+//                       keep a synthetic session as a fixture
+//   --json=PATH         also write the per-input work; compare two of these with
+//                       compare_bench.py --metric=per_event --threshold=0
+//
+// Recorded logs carry the state the window reached after each input, and the replay checks
+// that the model reaches the same states; in version 1 logs, which do not record the effects
+// beyond inversion, grayscale and the white level, those are left out. Returns the process exit code: 0 on success, 1 if
+// the log could not be read or the replay diverged from it.
+int RunReplay(const std::vector<std::string>& arguments);
@@ -0,0 +1,341 @@
+#include "LatencyHarness.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+#include <random>
+#include "Clock.h"
+#include "EffectController.h"
+#include "FramePipeline.h"
+#include "PixelKernels.h"
+#include "ShortcutConfig.h"
+#include "SyntheticDesktop.h"
+
+namespace {
+
+struct LatencyOptions {
+    bool realtime = false;
+    int events = 500;
+    double frameIntervalMs = 16.0;
+    double minGapMs = 40.0;
+    double maxGapMs = 160.0;
+    double frameCostUs = 0.0;
+    double keyCostUs = 0.0;
+    SyntheticScenario scenario = SCENARIO_MIXED;
+    int width = 1280;
+    int height = 720;
+    PixelKernel kernel = BestPixelKernel();
+    uint32_t seed = 1;
+    std::string jsonPath;
+};
+
+// One injected key press and the times it passed each stage, in nanoseconds
+struct KeyPress {
+    KeyChord chord;
+    int64_t injectedNs;   // Key event posted
+    int64_t handledNs;    // Message loop got to it
+    int64_t queuedNs;     // Change queued for the next frame
+    int64_t frameStartNs; // Start of the first frame showing the change
+    int64_t presentedNs;  // That frame finished
+};
+
+// Stages of the keypress-to-effect path
+enum LatencyStage {
+    STAGE_QUEUE,  // Waiting behind a frame in progress
+    STAGE_HANDLE, // Key handling, up to queueing the change
+    STAGE_WAIT,   // Waiting for the next frame timer tick
+    STAGE_RENDER, // Matrix rebuild, capturing and filtering the frame
+    STAGE_TOTAL,
+    STAGE_COUNT
+};
+
+const char* const stageNames[STAGE_COUNT] = { "queue", "handle", "wait_for_frame", "render", "total" };
+
+double StageMs(const KeyPress& press, int stage) {
+    int64_t ns = 0;
+    switch (stage) {
+    case STAGE_QUEUE: ns = press.handledNs - press.injectedNs; break;
+    case STAGE_HANDLE: ns = press.queuedNs - press.handledNs; break;
+    case STAGE_WAIT: ns = press.frameStartNs - press.queuedNs; break;
+    case STAGE_RENDER: ns = press.presentedNs - press.frameStartNs; break;
+    default: ns = press.presentedNs - press.injectedNs; break;
+    }
+    return ns / 1e6;
+}
+
+struct Distribution {
+    double minMs, p50Ms, p90Ms, p99Ms, maxMs, meanMs;
+};
+
+// Nearest-rank percentiles of the samples
+Distribution Summarize(std::vector<double> samples) {
+    Distribution result = {};
+    if (samples.empty())
+        return result;
+    std::sort(samples.begin(), samples.end());
+    auto percentile = [&samples](double p) {
+        size_t rank = static_cast<size_t>(p / 100.0 * samples.size() + 0.999999);
+        return samples[(std::min)((std::max)(rank, static_cast<size_t>(1)), samples.size()) - 1];
+    };
+    double sum = 0.0;
+    for (double sample : samples)
+        sum += sample;
+    result.minMs = samples.front();
+    result.p50Ms = percentile(50.0);
+    result.p90Ms = percentile(90.0);
+    result.p99Ms = percentile(99.0);
+    result.maxMs = samples.back();
+    result.meanMs = sum / samples.size();
+    return result;
+}
+
+bool ParseOptions(const std::vector<std::string>& arguments, LatencyOptions& options) {
+    for (const std::string& argument : arguments) {
+        size_t equals = argument.find('=');
+        std::string name = argument.substr(0, equals);
+        std::string value = equals == std::string::npos ? "" : argument.substr(equals + 1);
+
+        bool valid = true;
+        if (name == "--latency") {
+            valid = value.empty() || value == "virtual" || value == "realtime";
+            options.realtime = value == "realtime";
+        } else if (name == "--events") {
+            valid = sscanf(value.c_str(), "%d", &options.events) == 1 && options.events > 0;
+        } else if (name == "--frame-interval-ms") {
+            valid = sscanf(value.c_str(), "%lf", &options.frameIntervalMs) == 1 && options.frameIntervalMs > 0.0;
+        } else if (name == "--gap-ms") {
+            valid = sscanf(value.c_str(), "%lf-%lf", &options.minGapMs, &options.maxGapMs) == 2 &&
+                options.minGapMs > 0.0 && options.maxGapMs >= options.minGapMs;
+        } else if (name == "--frame-cost-us") {
+            valid = sscanf(value.c_str(), "%lf", &options.frameCostUs) == 1 && options.frameCostUs >= 0.0;
+        } else if (name == "--key-cost-us") {
+            valid = sscanf(value.c_str(), "%lf", &options.keyCostUs) == 1 && options.keyCostUs >= 0.0;
+        } else if (name == "--scenario") {
+            valid = ParseSyntheticScenario(value, options.scenario);
+        } else if (name == "--size") {
+            valid = sscanf(value.c_str(), "%dx%d", &options.width, &options.height) == 2 && options.width > 0 && options.height > 0;
+        } else if (name == "--kernel") {
+            valid = false;
+            for (int kernel = 0; kernel < PIXEL_KERNEL_COUNT; kernel++) {
+                if (value == PixelKernelName(static_cast<PixelKernel>(kernel)) && IsPixelKernelAvailable(static_cast<PixelKernel>(kernel))) {
+                    options.kernel = static_cast<PixelKernel>(kernel);
+                    valid = true;
+                }
+            }
+        } else if (name == "--seed") {
+            valid = sscanf(value.c_str(), "%u", &options.seed) == 1;
+        } else if (name == "--json") {
+            options.jsonPath = value;
+        } else {
+            valid = false;
+        }
+
+        if (!valid) {
+            fprintf(stderr, "Invalid argument: %s\n", argument.c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
+// Key presses at random intervals, each bound to one of the effect shortcuts
+std::vector<KeyPress> ScheduleKeyPresses(const LatencyOptions& options, const ShortcutConfig& shortcuts, int64_t startNs) {
+    std::mt19937 random(options.seed);
+    std::uniform_real_distribution<double> gapMs(options.minGapMs, options.maxGapMs);
+    const KeyChord chords[] = { shortcuts.toggleInvert, shortcuts.toggleGrayscale, shortcuts.cycleWhiteLevel };
+    std::uniform_int_distribution<int> chord(0, 2);
+
+    std::vector<KeyPress> presses(options.events);
+    int64_t time = startNs;
+    for (KeyPress& press : presses) {
+        time += static_cast<int64_t>(gapMs(random) * 1e6);
+        press = KeyPress();
+        press.chord = chords[chord(random)];
+        press.injectedNs = time;
+    }
+    return presses;
+}
+
+// Whether the last frame's output is its captured input filtered with 'matrix', checked at a
+// spread of probe pixels so the check costs little next to the frame itself
+bool FrameShowsMatrix(const FramePipeline& pipeline, PixelKernel kernel, const ColorMatrix& matrix) {
+    const PixelImage& captured = pipeline.GetCaptured();
+    const PixelImage& output = pipeline.GetOutput();
+    if (captured.pixels.empty() || captured.pixels.size() != output.pixels.size())
+        return false;
+
+    const size_t probeCount = 256;
+    size_t step = (std::max)(captured.pixels.size() / probeCount, static_cast<size_t>(1));
+    uint32_t source[probeCount], expected[probeCount];
+    size_t count = 0;
+    for (size_t i = step / 2; i < captured.pixels.size() && count < probeCount; i += step)
+        source[count++] = captured.pixels[i];
+
+    ApplyColorMatrix(kernel, matrix, source, expected, count);
+    count = 0;
+    for (size_t i = step / 2; i < captured.pixels.size() && count < probeCount; i += step) {
+        if (output.pixels[i] != expected[count++])
+            return false;
+    }
+    return true;
+}
+
+void PrintDistributions(const std::vector<KeyPress>& presses) {
+    printf("%-16s %9s %9s %9s %9s %9s %9s\n", "stage (ms)", "min", "p50", "p90", "p99", "max", "mean");
+    for (int stage = 0; stage < STAGE_COUNT; stage++) {
+        std::vector<double> samples;
+        for (const KeyPress& press : presses)
+            samples.push_back(StageMs(press, stage));
+        Distribution d = Summarize(samples);
+        printf("%-16s %9.3f %9.3f %9.3f %9.3f %9.3f %9.3f\n", stageNames[stage], d.minMs, d.p50Ms, d.p90Ms, d.p99Ms, d.maxMs, d.meanMs);
+    }
+}
+
+// Histogram of total latency in 2 ms buckets
+void PrintHistogram(const std::vector<KeyPress>& presses) {
+    const double bucketMs = 2.0;
+    std::vector<int> buckets;
+    for (const KeyPress& press : presses) {
+        size_t bucket = static_cast<size_t>(StageMs(press, STAGE_TOTAL) / bucketMs);
+        if (bucket >= buckets.size())
+            buckets.resize(bucket + 1, 0);
+        buckets[bucket]++;
+    }
+
+    int largest = buckets.empty() ? 0 : *std::max_element(buckets.begin(), buckets.end());
+    printf("\ntotal latency\n");
+    for (size_t i = 0; i < buckets.size(); i++) {
+        std::string bar(largest > 0 ? static_cast<size_t>(buckets[i]) * 50 / largest : 0, '#');
+        printf("%6.0f-%-4.0f ms %6d %s\n", i * bucketMs, (i + 1) * bucketMs, buckets[i], bar.c_str());
+    }
+}
+
+bool WriteLatencyJson(const std::string& path, const LatencyOptions& options, const std::vector<KeyPress>& presses, uint64_t frames) {
+    std::ofstream out(path, std::ios::trunc);
+    if (!out.is_open())
+        return false;
+
+    char number[64];
+    out << "{\n  \"mode\": \"" << (options.realtime ? "realtime" : "virtual") << "\",\n";
+    out << "  \"scenario\": \"" << SyntheticScenarioName(options.scenario) << "\",\n";
+    out << "  \"kernel\": \"" << PixelKernelName(options.kernel) << "\",\n";
+    out << "  \"size\": \"" << options.width << "x" << options.height << "\",\n";
+    snprintf(number, sizeof(number), "%.9g", options.frameIntervalMs);
+    out << "  \"frame_interval_ms\": " << number << ",\n";
+    out << "  \"events\": " << presses.size() << ",\n";
+    out << "  \"frames\": " << frames << ",\n";
+    out << "  \"stages\": {\n";
+    for (int stage = 0; stage < STAGE_COUNT; stage++) {
+        std::vector<double> samples;
+        for (const KeyPress& press : presses)
+            samples.push_back(StageMs(press, stage));
+        Distribution d = Summarize(samples);
+        char line[256];
+        snprintf(line, sizeof(line), "    \"%s\": {\"min_ms\": %.6f, \"p50_ms\": %.6f, \"p90_ms\": %.6f, \"p99_ms\": %.6f, \"max_ms\": %.6f, \"mean_ms\": %.6f}%s\n",
+            stageNames[stage], d.minMs, d.p50Ms, d.p90Ms, d.p99Ms, d.maxMs, d.meanMs, stage + 1 < STAGE_COUNT ? "," : "");
+        out << line;
+    }
+    out << "  },\n  \"total_ms\": [";
+    for (size_t i = 0; i < presses.size(); i++) {
+        snprintf(number, sizeof(number), "%s%.6f", i ? ", " : "", StageMs(presses[i], STAGE_TOTAL));
+        out << number;
+    }
+    out << "]\n}\n";
+    return out.good();
+}
+
+}
+
+int RunLatency(const std::vector<std::string>& arguments) {
+    LatencyOptions options;
+    if (!ParseOptions(arguments, options))
+        return 2;
+
+    SteadyClock steadyClock;
+    VirtualClock virtualClock;
+    Clock& clock = options.realtime ? static_cast<Clock&>(steadyClock) : static_cast<Clock&>(virtualClock);
+    auto charge = [&options, &virtualClock](double costUs) {
+        if (!options.realtime)
+            virtualClock.AdvanceNs(static_cast<int64_t>(costUs * 1e3));
+    };
+
+    // The filter window sits in the middle of a desktop with room around it
+    SyntheticDesktop desktop(options.width * 3 / 2, options.height * 3 / 2, options.scenario, options.seed);
+    SyntheticFrameSource source(desktop);
+    FramePipeline pipeline(source, options.kernel);
+    WindowFrameMetrics metrics = { 23, 4, 4 };
+    RECT clientRect = { 0, 0, options.width, options.height };
+    RECT windowRect;
+    windowRect.left = options.width / 4;
+    windowRect.top = options.height / 4;
+    windowRect.right = windowRect.left + options.width + 2 * metrics.borderWidth;
+    windowRect.bottom = windowRect.top + options.height + metrics.titleBarHeight + 2 * metrics.borderHeight;
+    pipeline.SetSource(ComputeMagnifierSource(windowRect, clientRect, metrics, 1.0f));
+
+    ShortcutConfig shortcuts;
+    EffectController effects;
+    pipeline.SetColorMatrix(effects.GetMatrix());
+
+    // Leave a few frames for caches and allocations to settle before the first press
+    const int64_t intervalNs = static_cast<int64_t>(options.frameIntervalMs * 1e6);
+    std::vector<KeyPress> presses = ScheduleKeyPresses(options, shortcuts, clock.NowNs() + 10 * intervalNs);
+
+    printf("Keypress-to-effect latency: %s clock, %d presses, %s %dx%d, %s kernel, %.1f ms frames\n\n",
+        options.realtime ? "real-time" : "virtual", options.events, SyntheticScenarioName(options.scenario),
+        options.width, options.height, PixelKernelName(options.kernel), options.frameIntervalMs);
+
+    // One thread, like the window's message loop: input is dispatched ahead of the frame timer,
+    // and a timer that falls behind fires once rather than catching up. As in HostWndProc(),
+    // key presses only queue their change; each frame applies what was queued before it.
+    size_t nextPress = 0, firstPending = 0;
+    int64_t nextTickNs = clock.NowNs() + intervalNs;
+    uint64_t frames = 0;
+    while (firstPending < presses.size()) {
+        int64_t pressNs = nextPress < presses.size() ? presses[nextPress].injectedNs : (std::numeric_limits<int64_t>::max)();
+        clock.SleepUntilNs((std::min)(pressNs, nextTickNs));
+        int64_t now = clock.NowNs();
+
+        if (nextPress < presses.size() && presses[nextPress].injectedNs <= now) {
+            KeyPress& press = presses[nextPress++];
+            press.handledNs = now;
+            effects.Queue(EffectActionForKey(shortcuts, press.chord.key, press.chord.modifiers));
+            charge(options.keyCostUs);
+            press.queuedNs = clock.NowNs();
+            continue;
+        }
+
+        // Frame timer tick, showing every press handled before it. Presses that cancel out
+        // (invert twice) count as shown by the frame that shows the state they leave.
+        size_t shownPresses = nextPress;
+        if (effects.Flush())
+            pipeline.SetColorMatrix(effects.GetMatrix());
+        ColorMatrix frameMatrix = effects.GetMatrix();
+        bool rendered = pipeline.RenderFrame();
+        charge(options.frameCostUs);
+        int64_t presentedNs = clock.NowNs();
+        frames++;
+
+        if (!rendered || !FrameShowsMatrix(pipeline, options.kernel, frameMatrix)) {
+            fprintf(stderr, "Frame %llu does not show the matrix applied before it\n", static_cast<unsigned long long>(frames));
+            return 1;
+        }
+        for (; firstPending < shownPresses; firstPending++) {
+            presses[firstPending].frameStartNs = now;
+            presses[firstPending].presentedNs = presentedNs;
+        }
+
+        while (nextTickNs <= presentedNs)
+            nextTickNs += intervalNs;
+    }
+
+    PrintDistributions(presses);
+    PrintHistogram(presses);
+    printf("\n%llu frames rendered\n", static_cast<unsigned long long>(frames));
+
+    if (!options.jsonPath.empty() && !WriteLatencyJson(options.jsonPath, options, presses, frames)) {
+        fprintf(stderr, "Could not write %s\n", options.jsonPath.c_str());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// screenfilter_bench --latency: keypress-to-effect latency. Injects synthetic effect key presses
+// into a single-threaded model of the filter window's message loop (key handling through
+// EffectController, frames through a FramePipeline on a synthetic desktop, ticking like the
+// magnifier timer) and measures how long each press takes to reach the first frame whose
+// pixels carry the new effect.
+//
+//   --latency[=virtual|realtime]  virtual (default) runs on a simulated clock, so results are
+//                                 deterministic and only the simulated costs below count;
+//                                 frames are still rendered and checked. realtime sleeps
+//                                 between events and measures the real work.
+//   --events=N              key presses to inject (default 500)
+//   --frame-interval-ms=N   frame timer interval (default 16, as in the application)
+//   --gap-ms=MIN-MAX        time between key presses, uniformly distributed (default 40-160)
+//   --frame-cost-us=N       virtual mode: simulated time charged per frame (default 0)
+//   --key-cost-us=N         virtual mode: simulated time charged per key press (default 0)
+//   --scenario=NAME         synthetic desktop scenario (default mixed)
+//   --size=WxH              filter window client area (default 1280x720)
+//   --kernel=NAME           pixel kernel (default the fastest exact one)
+//   --seed=N                key press schedule and desktop seed (default 1)
+//   --json=PATH             also write the distributions and raw samples as JSON
+//
+// Returns the process exit code: 0 on success, 1 if a frame did not show the matrix applied before it.
+int RunLatency(const std::vector<std::string>& arguments);
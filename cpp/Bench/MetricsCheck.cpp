@@ -0,0 +1,185 @@
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#define INVALID_SOCKET (-1)
+#define closesocket close
+#endif
+
+#include "MetricsCheck.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include "BenchChecks.h"
+#include "Metrics.h"
+#include "MetricsExporter.h"
+
+namespace {
+
+double MsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// A connected loopback socket, or INVALID_SOCKET
+intptr_t ConnectLoopback(int port) {
+    intptr_t sock = static_cast<intptr_t>(socket(AF_INET, SOCK_STREAM, IPPROTO_TCP));
+    if (sock == static_cast<intptr_t>(INVALID_SOCKET))
+        return sock;
+
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(static_cast<unsigned short>(port));
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(sock, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        closesocket(sock);
+        return INVALID_SOCKET;
+    }
+    return sock;
+}
+
+// What an HTTP GET returns, read until the server closes or 'timeoutMs' passes without data
+std::string Fetch(int port, int timeoutMs) {
+    intptr_t sock = ConnectLoopback(port);
+    if (sock == static_cast<intptr_t>(INVALID_SOCKET))
+        return "";
+
+    const char request[] = "GET /metrics HTTP/1.0\r\n\r\n";
+    send(sock, request, static_cast<int>(sizeof(request) - 1), 0);
+
+    std::string response;
+    for (;;) {
+        fd_set readSet;
+        FD_ZERO(&readSet);
+        FD_SET(sock, &readSet);
+        timeval timeout = { timeoutMs / 1000, (timeoutMs % 1000) * 1000 };
+        if (select(static_cast<int>(sock + 1), &readSet, NULL, NULL, &timeout) <= 0)
+            break;
+        char buffer[4096];
+        int received = recv(sock, buffer, sizeof(buffer), 0);
+        if (received <= 0)
+            break;
+        response.append(buffer, static_cast<size_t>(received));
+    }
+    closesocket(sock);
+    return response;
+}
+
+void CheckTypeMismatch() {
+    MetricsRegistry registry;
+    registry.Counter("frames_total", "Frames rendered").Increment();
+    MetricGauge& gauge = registry.Gauge("frames_total", "Frames rendered, as a gauge");
+    gauge.Set(42.0);
+    MetricHistogram& histogram = registry.Histogram("frames_total", "Frames rendered, as a histogram", DefaultLatencyBuckets());
+    histogram.Observe(0.001);
+
+    std::string text = registry.FormatPrometheus();
+    bool passed = gauge.Value() == 42.0 && histogram.Count() == 1 && text.find("# TYPE frames_total counter\n") != std::string::npos &&
+        text.find("gauge") == std::string::npos && text.find("histogram") == std::string::npos &&
+        text.find("frames_total 1\n") != std::string::npos && &registry.Counter("frames_total", "") == &registry.Counter("frames_total", "");
+    Check("type_mismatch", passed, passed ? "counter exported, gauge and histogram detached" : text);
+}
+
+// Stop() on another thread, so a hang is reported instead of hanging the check; the silent
+// client is disconnected after 'limitMs' to let a stuck worker go
+double TimeStop(MetricsExporter& exporter, intptr_t& silent, double limitMs) {
+    std::atomic<bool> stopped(false);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::thread stopper([&exporter, &stopped] {
+        exporter.Stop();
+        stopped.store(true);
+    });
+    while (!stopped.load() && MsSince(start) < limitMs)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    double elapsedMs = MsSince(start);
+    if (silent != static_cast<intptr_t>(INVALID_SOCKET)) {
+        closesocket(silent);
+        silent = INVALID_SOCKET;
+    }
+    stopper.join();
+    return elapsedMs;
+}
+
+void CheckExporter(int firstPort) {
+    MetricsRegistry registry;
+    registry.Counter("bench_requests_total", "Requests served").Increment();
+    MetricsExporter exporter(registry);
+
+    int port = 0;
+    for (int candidate = firstPort; candidate < firstPort + 20 && port == 0; candidate++) {
+        if (exporter.Start("", candidate, std::chrono::milliseconds(1000)))
+            port = candidate;
+    }
+    if (port == 0) {
+        Check("exporter_start", false, "no free port from " + std::to_string(firstPort));
+        return;
+    }
+
+    std::string response = Fetch(port, 2000);
+    Check("http_response", response.compare(0, 15, "HTTP/1.0 200 OK") == 0 && response.find("bench_requests_total 1\n") != std::string::npos,
+        std::to_string(response.size()) + " bytes from port " + std::to_string(port));
+
+    // A client that never sends its request, then a well-behaved one behind it
+    intptr_t silent = ConnectLoopback(port);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    response = Fetch(port, 2000);
+    double fetchMs = MsSince(start);
+    char detail[200];
+    snprintf(detail, sizeof(detail), "served in %.0f ms", fetchMs);
+    Check("silent_client_queue", silent != static_cast<intptr_t>(INVALID_SOCKET) &&
+        response.find("bench_requests_total 1\n") != std::string::npos && fetchMs < 1000.0, detail);
+
+    // Stop() while the worker holds a silent connection
+    closesocket(silent);
+    silent = ConnectLoopback(port);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    double stopMs = TimeStop(exporter, silent, 2000.0);
+    snprintf(detail, sizeof(detail), "Stop() took %.0f ms", stopMs);
+    Check("silent_client_stop", stopMs < 1000.0, detail);
+}
+
+}
+
+int RunMetricsChecks(const std::vector<std::string>& arguments) {
+    int port = 39400;
+
+    for (const std::string& argument : arguments) {
+        size_t equals = argument.find('=');
+        std::string name = argument.substr(0, equals);
+        std::string value = equals == std::string::npos ? "" : argument.substr(equals + 1);
+
+        bool valid = true;
+        if (name == "--metrics")
+            continue;
+        else if (name == "--port")
+            valid = sscanf(value.c_str(), "%d", &port) == 1 && port > 0 && port < 65536 - 20;
+        else
+            valid = false;
+
+        if (!valid) {
+            fprintf(stderr, "Invalid argument: %s\n", argument.c_str());
+            return 2;
+        }
+    }
+
+#ifdef _WIN32
+    WSADATA wsaData;
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
+        return 1;
+#endif
+
+    ResetChecks();
+    CheckTypeMismatch();
+    CheckExporter(port);
+
+#ifdef _WIN32
+    WSACleanup();
+#endif
+
+    return FinishChecks("metrics");
+}
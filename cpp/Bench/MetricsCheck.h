@@ -0,0 +1,12 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// screenfilter_bench --metrics [--port=N]: checks the metrics registry and exporter. Asking for
+// a name already registered as another type must return a metric that can be updated and is
+// left out of the export; an HTTP client must get the registry in Prometheus text format from
+// the exporter's port (the first free one from N, default 39400); and a client that connects
+// and never sends a request must neither stall the export nor keep Stop() from returning
+// within a second. Returns the process exit code: 0 if every check passes.
+int RunMetricsChecks(const std::vector<std::string>& arguments);
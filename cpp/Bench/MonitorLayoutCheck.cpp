@@ -0,0 +1,188 @@
+#include "MonitorLayoutCheck.h"
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include "BenchChecks.h"
+#include "MonitorLayout.h"
+
+namespace {
+
+MonitorDesc MakeMonitor(const char* name, LONG left, LONG top, LONG width, LONG height, bool primary) {
+    MonitorDesc monitor;
+    monitor.deviceName = name;
+    monitor.bounds.left = left;
+    monitor.bounds.top = top;
+    monitor.bounds.right = left + width;
+    monitor.bounds.bottom = top + height;
+    monitor.isPrimary = primary;
+    return monitor;
+}
+
+RECT MakeRect(LONG left, LONG top, LONG right, LONG bottom) {
+    RECT rect = { left, top, right, bottom };
+    return rect;
+}
+
+bool SameRect(const RECT& a, const RECT& b) {
+    return a.left == b.left && a.top == b.top && a.right == b.right && a.bottom == b.bottom;
+}
+
+// A laptop docked to two externals: the primary at the origin, one to its left and higher up,
+// so both coordinates go negative, and a portrait one to its right
+std::vector<MonitorDesc> DockedLayout() {
+    return {
+        MakeMonitor("\\\\.\\DISPLAY1", 0, 0, 1920, 1080, true),
+        MakeMonitor("\\\\.\\DISPLAY2", -2560, -360, 2560, 1440, false),
+        MakeMonitor("\\\\.\\DISPLAY3", 1920, -420, 1080, 1920, false),
+    };
+}
+
+}
+
+int RunMonitorLayoutChecks(const std::vector<std::string>& arguments) {
+    for (const std::string& argument : arguments) {
+        if (argument != "--monitor-layout") {
+            fprintf(stderr, "Invalid argument: %s\n", argument.c_str());
+            return 2;
+        }
+    }
+
+    ResetChecks();
+    char detail[200];
+    MonitorLayout docked;
+    docked.SetMonitors(DockedLayout());
+
+    // Random rectangles inside every monitor come back to the pixel, on the monitor holding
+    // their centre
+    {
+        std::mt19937 random(7);
+        int tried = 0;
+        int wrong = 0;
+        int wrongMonitor = 0;
+        for (const MonitorDesc& monitor : docked.GetMonitors()) {
+            LONG width = monitor.bounds.right - monitor.bounds.left;
+            LONG height = monitor.bounds.bottom - monitor.bounds.top;
+            for (int i = 0; i < 1000; i++) {
+                LONG left = monitor.bounds.left + static_cast<LONG>(random() % (width - 1));
+                LONG top = monitor.bounds.top + static_cast<LONG>(random() % (height - 1));
+                LONG right = left + 1 + static_cast<LONG>(random() % (monitor.bounds.right - left));
+                LONG bottom = top + 1 + static_cast<LONG>(random() % (monitor.bounds.bottom - top));
+                RECT rect = MakeRect(left, top, right, bottom);
+                NormalizedRect normalized;
+                RECT resolved;
+                tried++;
+                if (!docked.Normalize(rect, normalized) || !docked.Resolve(normalized, NULL, resolved) || !SameRect(rect, resolved))
+                    wrong++;
+                else if (normalized.monitor != monitor.deviceName)
+                    wrongMonitor++;
+            }
+        }
+        snprintf(detail, sizeof(detail), "%d rectangles, %d changed, %d on the wrong monitor", tried, wrong, wrongMonitor);
+        Check("round_trip", wrong == 0 && wrongMonitor == 0, detail);
+    }
+
+    // On the monitor left of and above the primary the fractions are still within 0..1
+    {
+        RECT rect = MakeRect(-2000, -300, -1000, 500);
+        NormalizedRect normalized;
+        RECT resolved;
+        bool passed = docked.Normalize(rect, normalized) && normalized.monitor == "\\\\.\\DISPLAY2" &&
+            normalized.left >= 0.0 && normalized.top >= 0.0 && normalized.right <= 1.0 && normalized.bottom <= 1.0 &&
+            docked.Resolve(normalized, NULL, resolved) && SameRect(rect, resolved);
+        snprintf(detail, sizeof(detail), "%s %.4f,%.4f,%.4f,%.4f", normalized.monitor.c_str(), normalized.left, normalized.top,
+            normalized.right, normalized.bottom);
+        Check("negative_origin", passed, detail);
+    }
+
+    // Undocked: the portrait monitor is gone. With the saved pixels as a hint the rectangle goes
+    // to the monitor nearest to them, keeping its fractions; without one, to the primary.
+    {
+        RECT rect = MakeRect(2100, 100, 2700, 900);
+        NormalizedRect normalized;
+        docked.Normalize(rect, normalized);
+
+        MonitorLayout undocked;
+        undocked.SetMonitors({ MakeMonitor("\\\\.\\DISPLAY2", -2560, -360, 2560, 1440, false),
+            MakeMonitor("\\\\.\\DISPLAY1", 0, 0, 1920, 1080, true) });
+        RECT nearest;
+        RECT primary;
+        bool resolvedNearest = undocked.Resolve(normalized, &rect, nearest);
+        bool resolvedPrimary = undocked.Resolve(normalized, NULL, primary);
+
+        // The nearest to (2400, 500) is DISPLAY1 too, so the hint is told apart from the
+        // primary fallback by a layout whose nearest monitor is not the primary
+        MonitorLayout swapped;
+        swapped.SetMonitors({ MakeMonitor("\\\\.\\DISPLAY2", 0, 0, 1920, 1080, false),
+            MakeMonitor("\\\\.\\DISPLAY1", -1920, 0, 1920, 1080, true) });
+        RECT hinted;
+        bool resolvedHinted = swapped.Resolve(normalized, &rect, hinted);
+
+        RECT expected = MakeRect(static_cast<LONG>(std::lround(normalized.left * 1920)), static_cast<LONG>(std::lround(normalized.top * 1080)),
+            static_cast<LONG>(std::lround(normalized.right * 1920)), static_cast<LONG>(std::lround(normalized.bottom * 1080)));
+        RECT expectedPrimary = MakeRect(expected.left - 1920, expected.top, expected.right - 1920, expected.bottom);
+        bool passed = normalized.monitor == "\\\\.\\DISPLAY3" && resolvedNearest && SameRect(nearest, expected) && resolvedPrimary &&
+            SameRect(primary, expected) && resolvedHinted && SameRect(hinted, expected);
+
+        // Without the hint the swapped layout falls back to its primary
+        RECT unhinted;
+        passed = passed && swapped.Resolve(normalized, NULL, unhinted) && SameRect(unhinted, expectedPrimary);
+        snprintf(detail, sizeof(detail), "hinted %ld,%ld,%ld,%ld; unhinted %ld,%ld,%ld,%ld", static_cast<long>(hinted.left),
+            static_cast<long>(hinted.top), static_cast<long>(hinted.right), static_cast<long>(hinted.bottom),
+            static_cast<long>(unhinted.left), static_cast<long>(unhinted.top), static_cast<long>(unhinted.right),
+            static_cast<long>(unhinted.bottom));
+        Check("removed_monitor_fallback", passed, detail);
+    }
+
+    // The primary goes from 1080p to 4K: the rectangle keeps its share of the screen
+    {
+        RECT rect = MakeRect(480, 270, 1440, 810);
+        NormalizedRect normalized;
+        docked.Normalize(rect, normalized);
+        std::vector<MonitorDesc> monitors = DockedLayout();
+        monitors[0] = MakeMonitor("\\\\.\\DISPLAY1", 0, 0, 3840, 2160, true);
+        monitors[2] = MakeMonitor("\\\\.\\DISPLAY3", 3840, -420, 1080, 1920, false);
+        MonitorLayout scaled;
+        scaled.SetMonitors(monitors);
+        RECT resolved;
+        bool passed = scaled.Resolve(normalized, NULL, resolved) && SameRect(resolved, MakeRect(960, 540, 2880, 1620));
+        snprintf(detail, sizeof(detail), "%ld,%ld,%ld,%ld", static_cast<long>(resolved.left), static_cast<long>(resolved.top),
+            static_cast<long>(resolved.right), static_cast<long>(resolved.bottom));
+        Check("resolution_change", passed, detail);
+    }
+
+    // Partly off the monitor is pulled onto it; entirely off leaves nothing to show
+    {
+        NormalizedRect partly;
+        partly.monitor = "\\\\.\\DISPLAY1";
+        partly.left = -0.25;
+        partly.top = 0.5;
+        partly.right = 0.5;
+        partly.bottom = 1.5;
+        RECT clamped;
+        bool passed = docked.Resolve(partly, NULL, clamped) && SameRect(clamped, MakeRect(0, 540, 960, 1080));
+
+        NormalizedRect entirely = partly;
+        entirely.left = 1.1;
+        entirely.right = 1.4;
+        RECT ignored;
+        passed = passed && !docked.Resolve(entirely, NULL, ignored);
+        snprintf(detail, sizeof(detail), "partly off: %ld,%ld,%ld,%ld", static_cast<long>(clamped.left), static_cast<long>(clamped.top),
+            static_cast<long>(clamped.right), static_cast<long>(clamped.bottom));
+        Check("clamping", passed, detail);
+    }
+
+    // Nothing to normalize against or resolve onto
+    {
+        MonitorLayout empty;
+        NormalizedRect normalized;
+        normalized.monitor = "\\\\.\\DISPLAY1";
+        normalized.right = 1.0;
+        normalized.bottom = 1.0;
+        RECT rect = MakeRect(0, 0, 100, 100);
+        RECT resolved;
+        bool passed = !empty.Normalize(rect, normalized) && !empty.Resolve(normalized, &rect, resolved);
+        Check("empty_layout", passed, passed ? "both refused" : "accepted");
+    }
+
+    return FinishChecks("monitor layout");
+}
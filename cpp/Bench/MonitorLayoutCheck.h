@@ -0,0 +1,12 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// screenfilter_bench --monitor-layout: checks how saved rectangles survive re-docking.
+// Rectangles on every monitor of a layout with negative origins must normalize and resolve
+// back to themselves; a rectangle whose monitor was removed must land on the monitor nearest
+// to where it was, or on the primary one without a hint; a resolution change must scale it
+// with its monitor; fractions outside the monitor must be clamped onto it; and an empty layout
+// must refuse both. Returns the process exit code: 0 if every check passes.
+int RunMonitorLayoutChecks(const std::vector<std::string>& arguments);
@@ -0,0 +1,68 @@
+#include "PpmImage.h"
+#include <cctype>
+#include <fstream>
+
+namespace {
+
+// Next header number, skipping whitespace and # comments
+bool ReadHeaderNumber(std::istream& in, int& value) {
+    int c = in.get();
+    while (c != EOF && (isspace(c) || c == '#')) {
+        if (c == '#') {
+            while (c != EOF && c != '\n')
+                c = in.get();
+        }
+        c = in.get();
+    }
+    if (c == EOF || !isdigit(c))
+        return false;
+
+    value = 0;
+    while (c != EOF && isdigit(c)) {
+        value = value * 10 + (c - '0');
+        c = in.get();
+    }
+    // c is the single whitespace byte that ends the header field
+    return true;
+}
+
+}
+
+bool ReadPpm(const std::string& path, PixelImage& image) {
+    std::ifstream in(path, std::ios::binary);
+    char magic[2];
+    if (!in.read(magic, 2) || magic[0] != 'P' || magic[1] != '6')
+        return false;
+
+    int width, height, maxValue;
+    if (!ReadHeaderNumber(in, width) || !ReadHeaderNumber(in, height) || !ReadHeaderNumber(in, maxValue))
+        return false;
+    if (width <= 0 || height <= 0 || maxValue != 255)
+        return false;
+
+    std::vector<unsigned char> rgb(static_cast<size_t>(width) * height * 3);
+    if (!in.read(reinterpret_cast<char*>(rgb.data()), rgb.size()))
+        return false;
+
+    image = PixelImage(width, height);
+    for (size_t i = 0; i < image.pixels.size(); i++)
+        image.pixels[i] = 0xFF000000u | (rgb[i * 3] << 16) | (rgb[i * 3 + 1] << 8) | rgb[i * 3 + 2];
+    return true;
+}
+
+bool WritePpm(const std::string& path, const PixelImage& image) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out.is_open())
+        return false;
+
+    out << "P6\n" << image.width << " " << image.height << "\n255\n";
+    std::vector<unsigned char> rgb(image.pixels.size() * 3);
+    for (size_t i = 0; i < image.pixels.size(); i++) {
+        uint32_t pixel = image.pixels[i];
+        rgb[i * 3] = static_cast<unsigned char>(pixel >> 16);
+        rgb[i * 3 + 1] = static_cast<unsigned char>(pixel >> 8);
+        rgb[i * 3 + 2] = static_cast<unsigned char>(pixel);
+    }
+    out.write(reinterpret_cast<const char*>(rgb.data()), rgb.size());
+    return out.good();
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+#include <string>
+#include "PixelImage.h"
+
+// Binary PPM (P6, maxval 255). Alpha is set to opaque on read and dropped on write.
+bool ReadPpm(const std::string& path, PixelImage& image);
+bool WritePpm(const std::string& path, const PixelImage& image);
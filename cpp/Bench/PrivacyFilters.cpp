@@ -0,0 +1,257 @@
+#include "PrivacyFilters.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include "BenchChecks.h"
+#include "FramePipeline.h"
+#include "PixelImage.h"
+#include "PrivacyEffects.h"
+#include "SyntheticDesktop.h"
+#include "WorkerPool.h"
+
+namespace {
+
+// The two box passes written out directly, rounding as BoxBlurImage() does
+PixelImage ReferenceBlur(const PixelImage& source, int radius) {
+    float scale = 1.0f / static_cast<float>(2 * radius + 1);
+    PixelImage vertical(source.width, source.height), result(source.width, source.height);
+    for (int pass = 0; pass < 2; pass++) {
+        const PixelImage& in = pass == 0 ? source : vertical;
+        PixelImage& out = pass == 0 ? vertical : result;
+        for (int y = 0; y < source.height; y++) {
+            for (int x = 0; x < source.width; x++) {
+                uint32_t pixel = 0;
+                for (int channel = 0; channel < 4; channel++) {
+                    int sum = 0;
+                    for (int offset = -radius; offset <= radius; offset++) {
+                        int sx = pass == 0 ? x : (std::min)((std::max)(x + offset, 0), source.width - 1);
+                        int sy = pass == 0 ? (std::min)((std::max)(y + offset, 0), source.height - 1) : y;
+                        sum += static_cast<int>((in.At(sx, sy) >> (8 * channel)) & 0xFF);
+                    }
+                    pixel |= static_cast<uint32_t>(static_cast<int>(static_cast<float>(sum) * scale + 0.5f)) << (8 * channel);
+                }
+                out.At(x, y) = pixel;
+            }
+        }
+    }
+    for (size_t i = 0; i < result.pixels.size(); i++)
+        result.pixels[i] = (result.pixels[i] & 0x00FFFFFFu) | (source.pixels[i] & 0xFF000000u);
+    return result;
+}
+
+// Each block filled with the rounded average of its pixels
+PixelImage ReferencePixelate(const PixelImage& source, int block) {
+    PixelImage result(source.width, source.height);
+    for (int y0 = 0; y0 < source.height; y0 += block) {
+        for (int x0 = 0; x0 < source.width; x0 += block) {
+            int x1 = (std::min)(x0 + block, source.width), y1 = (std::min)(y0 + block, source.height);
+            unsigned pixels = static_cast<unsigned>((x1 - x0) * (y1 - y0));
+            uint32_t color = 0;
+            for (int channel = 0; channel < 3; channel++) {
+                unsigned sum = 0;
+                for (int y = y0; y < y1; y++) {
+                    for (int x = x0; x < x1; x++)
+                        sum += (source.At(x, y) >> (8 * channel)) & 0xFF;
+                }
+                color |= ((sum + pixels / 2) / pixels) << (8 * channel);
+            }
+            for (int y = y0; y < y1; y++) {
+                for (int x = x0; x < x1; x++)
+                    result.At(x, y) = (source.At(x, y) & 0xFF000000u) | color;
+            }
+        }
+    }
+    return result;
+}
+
+// Sum of the differences between horizontally and vertically neighboring channel values: what
+// is left of text and edges
+double Detail(const PixelImage& image) {
+    double detail = 0.0;
+    for (int y = 1; y < image.height; y++) {
+        for (int x = 1; x < image.width; x++) {
+            for (int channel = 0; channel < 3; channel++) {
+                int shift = 8 * channel;
+                int value = static_cast<int>((image.At(x, y) >> shift) & 0xFF);
+                detail += std::abs(value - static_cast<int>((image.At(x - 1, y) >> shift) & 0xFF)) +
+                    std::abs(value - static_cast<int>((image.At(x, y - 1) >> shift) & 0xFF));
+            }
+        }
+    }
+    return detail;
+}
+
+}
+
+void RegisterPrivacyBenchmarks(BenchSuite& suite) {
+    std::shared_ptr<WorkerPool> pool = std::make_shared<WorkerPool>(0);
+    for (int radius : { 4, 32, 128, 256 }) {
+        suite.Add("box_blur/3840x2160/r" + std::to_string(radius), 3840.0 * 2160.0, [radius, pool] {
+            std::shared_ptr<PixelImage> source = std::make_shared<PixelImage>(TestImage(3840, 2160, 1));
+            std::shared_ptr<PixelImage> target = std::make_shared<PixelImage>(3840, 2160);
+            return BenchBody([radius, source, target, pool](uint64_t iterations) {
+                for (uint64_t i = 0; i < iterations; i++) {
+                    BoxBlurImage(source->pixels.data(), target->pixels.data(), source->width, source->height, radius, pool.get());
+                    BenchDoNotOptimize(target->pixels[0]);
+                }
+            });
+        });
+    }
+    for (int block : { 8, 32, 256 }) {
+        suite.Add("pixelate/3840x2160/b" + std::to_string(block), 3840.0 * 2160.0, [block, pool] {
+            std::shared_ptr<PixelImage> source = std::make_shared<PixelImage>(TestImage(3840, 2160, 1));
+            std::shared_ptr<PixelImage> target = std::make_shared<PixelImage>(3840, 2160);
+            return BenchBody([block, source, target, pool](uint64_t iterations) {
+                for (uint64_t i = 0; i < iterations; i++) {
+                    PixelateImage(source->pixels.data(), target->pixels.data(), source->width, source->height, block, pool.get());
+                    BenchDoNotOptimize(target->pixels[0]);
+                }
+            });
+        });
+    }
+}
+
+int RunPrivacyChecks(const std::vector<std::string>& arguments) {
+    double maxRatio = 1.5;
+    int threads = 0;
+
+    for (const std::string& argument : arguments) {
+        size_t equals = argument.find('=');
+        std::string name = argument.substr(0, equals);
+        std::string value = equals == std::string::npos ? "" : argument.substr(equals + 1);
+
+        bool valid = true;
+        if (name == "--privacy")
+            continue;
+        else if (name == "--max-ratio")
+            valid = sscanf(value.c_str(), "%lf", &maxRatio) == 1 && maxRatio >= 1.0;
+        else if (name == "--threads")
+            valid = sscanf(value.c_str(), "%d", &threads) == 1 && threads > 0;
+        else
+            valid = false;
+
+        if (!valid) {
+            fprintf(stderr, "Invalid argument: %s\n", argument.c_str());
+            return 2;
+        }
+    }
+
+    ResetChecks();
+    char detail[200];
+    WorkerPool pool(threads);
+
+    // 517 x 131 leaves a partial strip, row task and block; the small sizes are narrower than
+    // the box and the blocks
+    const struct { int width; int height; } sizes[] = { { 517, 131 }, { 3, 2 }, { 1, 7 }, { 6, 1 } };
+    {
+        MismatchList mismatches;
+        for (const auto& size : sizes) {
+            PixelImage source = TestImage(size.width, size.height, 2);
+            for (int radius : { 1, 5, 40 }) {
+                PixelImage actual(size.width, size.height);
+                BoxBlurImage(source.pixels.data(), actual.pixels.data(), size.width, size.height, radius, NULL);
+                mismatches.Compare(actual.pixels == ReferenceBlur(source, radius).pixels, "r%d/%dx%d", radius, size.width, size.height);
+            }
+        }
+        Check("blur_matches_reference", mismatches.Empty(), mismatches.Describe("runs"));
+    }
+
+    {
+        MismatchList mismatches;
+        for (const auto& size : sizes) {
+            PixelImage source = TestImage(size.width, size.height, 3);
+            for (int block : { 2, 7, 16 }) {
+                PixelImage actual(size.width, size.height);
+                PixelateImage(source.pixels.data(), actual.pixels.data(), size.width, size.height, block, NULL);
+                mismatches.Compare(actual.pixels == ReferencePixelate(source, block).pixels, "b%d/%dx%d", block, size.width, size.height);
+            }
+        }
+        Check("pixelate_matches_reference", mismatches.Empty(), mismatches.Describe("runs"));
+    }
+
+    // Strips, row groups and block rows are independent, so the threads cannot change the result
+    {
+        PixelImage source = TestImage(1920, 1080, 4);
+        PixelImage single(source.width, source.height), pooled(source.width, source.height);
+        BoxBlurImage(source.pixels.data(), single.pixels.data(), source.width, source.height, PRIVACY_BLUR_RADIUS_DEFAULT, NULL);
+        BoxBlurImage(source.pixels.data(), pooled.pixels.data(), source.width, source.height, PRIVACY_BLUR_RADIUS_DEFAULT, &pool);
+        bool passed = single.pixels == pooled.pixels;
+        PixelateImage(source.pixels.data(), single.pixels.data(), source.width, source.height, PRIVACY_PIXELATE_BLOCK_DEFAULT, NULL);
+        PixelateImage(source.pixels.data(), pooled.pixels.data(), source.width, source.height, PRIVACY_PIXELATE_BLOCK_DEFAULT, &pool);
+        passed = passed && single.pixels == pooled.pixels;
+        snprintf(detail, sizeof(detail), "%d thread(s)", pool.GetThreads());
+        Check("pool_agrees", passed, detail);
+    }
+
+    // Averages of a flat area are the area, and radius 0 is a copy
+    {
+        PixelImage flat(300, 70);
+        for (uint32_t& pixel : flat.pixels)
+            pixel = 0xFF3C8AD2u;
+        PixelImage detailed = TestImage(300, 70, 5);
+        PixelImage blurred(300, 70), pixelated(300, 70), copied(300, 70);
+        BoxBlurImage(flat.pixels.data(), blurred.pixels.data(), 300, 70, PRIVACY_BLUR_RADIUS_MAX, &pool);
+        PixelateImage(flat.pixels.data(), pixelated.pixels.data(), 300, 70, 9, &pool);
+        BoxBlurImage(detailed.pixels.data(), copied.pixels.data(), 300, 70, 0, &pool);
+        bool passed = blurred.pixels == flat.pixels && pixelated.pixels == flat.pixels && copied.pixels == detailed.pixels;
+        Check("pass_through", passed, passed ? "flat area and radius 0 unchanged" : "changed");
+    }
+
+    // What is left of a text document, through FramePipeline as the CPU path renders it
+    {
+        SyntheticDesktop desktop(1920, 1080, SCENARIO_STATIC_DOCUMENT);
+        SyntheticFrameSource source(desktop);
+        FramePipeline pipeline(source, BestPixelKernel());
+        pipeline.SetWorkerPool(&pool);
+        ColorEffectSettings settings;
+        settings.inversionEnabled = true;
+        settings.privacyEffect = PRIVACY_BLUR;
+        bool cpuRender = NeedsCpuRender(settings);
+        pipeline.SetEffects(settings);
+        pipeline.RenderFrame();
+        double original = Detail(pipeline.GetCaptured());
+        double blurred = Detail(pipeline.GetOutput()) / original;
+        settings.privacyEffect = PRIVACY_PIXELATE;
+        cpuRender = cpuRender && NeedsCpuRender(settings);
+        pipeline.SetEffects(settings);
+        pipeline.RenderFrame();
+        double pixelated = Detail(pipeline.GetOutput()) / original;
+        snprintf(detail, sizeof(detail), "detail left: blur r%d %.1f%%, pixelate %dpx %.1f%%%s", settings.blurRadius, blurred * 100.0,
+            settings.pixelateBlock, pixelated * 100.0, cpuRender ? "" : "; not sent to the CPU path");
+        Check("hides_text", cpuRender && blurred < 0.15 && pixelated < 0.15, detail);
+    }
+
+    // Running sums cost the same per pixel at any radius, so a 4K frame should too
+    {
+        PixelImage source = TestImage(3840, 2160, 6);
+        PixelImage target(source.width, source.height);
+        std::string times;
+        double fastest = 0.0, slowest = 0.0;
+        for (int radius : { 4, 32, 128, 256 }) {
+            double ms = MedianMs([&] {
+                BoxBlurImage(source.pixels.data(), target.pixels.data(), source.width, source.height, radius, &pool);
+            }, 9);
+            fastest = fastest == 0.0 ? ms : (std::min)(fastest, ms);
+            slowest = (std::max)(slowest, ms);
+            char time[32];
+            snprintf(time, sizeof(time), " r%d %.1f", radius, ms);
+            times += time;
+        }
+        snprintf(detail, sizeof(detail), "%d thread(s), 4K ms:%s (x%.2f)", pool.GetThreads(), times.c_str(), slowest / fastest);
+        Check("blur_radius_independent", slowest <= fastest * maxRatio, detail);
+
+        std::string blocks;
+        for (int block : { 8, 64, 256 }) {
+            double ms = MedianMs([&] {
+                PixelateImage(source.pixels.data(), target.pixels.data(), source.width, source.height, block, &pool);
+            }, 9);
+            char time[32];
+            snprintf(time, sizeof(time), " b%d %.1f", block, ms);
+            blocks += time;
+        }
+        printf("%-40s     4K pixelate ms:%s\n", "", blocks.c_str());
+    }
+
+    return FinishChecks("privacy");
+}
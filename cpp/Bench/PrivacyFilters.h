@@ -0,0 +1,18 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "BenchHarness.h"
+
+// box_blur/3840x2160/r<N>: BoxBlurImage on a 4K frame at radii from 4 to 256, on one thread per
+// hardware thread; pixelate/3840x2160/b<N>: PixelateImage at block sizes from 8 to 256
+void RegisterPrivacyBenchmarks(BenchSuite& suite);
+
+// screenfilter_bench --privacy [--max-ratio=X] [--threads=N]: checks the privacy effects. The
+// blur must match the two box passes written out directly and the pixelation a direct block
+// average, on sizes that cut strips and blocks short and on images smaller than the box; a pool
+// must not change either; flat areas must pass through; both must remove most of the detail of a
+// text document; and a 4K blur must cost at most X times (default 1.5) as much at its slowest
+// radius as at its fastest, on a pool of N threads (default: one per hardware thread). Returns
+// the process exit code: 0 if every check passes.
+int RunPrivacyChecks(const std::vector<std::string>& arguments);
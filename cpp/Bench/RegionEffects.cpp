@@ -0,0 +1,153 @@
+#include "RegionEffects.h"
+#include <cstdio>
+
+HeadlessRegionPlatform::HeadlessRegionPlatform(const WindowFrameMetrics& frameMetrics, LONG width, LONG height)
+    : frame(frameMetrics), screenWidth(width), screenHeight(height), windowRect() {
+    windowRect.right = width;
+    windowRect.bottom = height;
+}
+
+// As WindowRegionPlatform::GetFullScreenRect(): the frame and caption just outside the screen
+void HeadlessRegionPlatform::GetFullScreenRect(RECT& rect) {
+    rect.left = -frame.borderWidth;
+    rect.top = -frame.borderHeight - frame.titleBarHeight;
+    rect.right = screenWidth + frame.borderWidth;
+    rect.bottom = screenHeight + frame.borderHeight;
+}
+
+namespace {
+
+enum StepType {
+    STEP_EVENT,   // Dispatch an event
+    STEP_EFFECTS, // SyncEffects() with a generation
+    STEP_DRAG     // The user moves the window; no region call
+};
+
+struct RegionStep {
+    const char* name;
+    StepType type;
+    RegionEventType event;
+    LONG values[4];  // Click point, or the window rectangle to load or drag to; the generation for STEP_EFFECTS
+    uint8_t expected[REGION_SIDE_EFFECT_COUNT]; // Show state, style, ex style, position, theme, opacity, color effect
+};
+
+struct RegionScript {
+    const char* name;
+    const RegionStep* steps;
+    size_t count;
+};
+
+// A selection on a 1920x1080 screen with a 23 pixel caption and 8 pixel borders. The selected
+// client area (100,100)-(700,500) puts the window at (92,69)-(708,508).
+const RegionStep selectionSteps[] = {
+    { "show", STEP_EVENT, REGION_SHOW, {}, { 1, 0, 0, 0, 0, 0, 0 } },
+    { "show_again", STEP_EVENT, REGION_SHOW, {}, { 0, 0, 0, 0, 0, 0, 0 } },
+    { "effects_during_selection", STEP_EFFECTS, REGION_SHOW, { 1 }, { 0, 0, 0, 0, 0, 0, 0 } },
+    { "enable_theme", STEP_EVENT, REGION_ENABLE_THEME, {}, { 0, 0, 0, 0, 1, 0, 0 } },
+    { "first_point", STEP_EVENT, REGION_CLICK, { 100, 100 }, { 0, 0, 0, 0, 0, 0, 0 } },
+    { "second_point", STEP_EVENT, REGION_CLICK, { 700, 500 }, { 1, 0, 0, 1, 0, 1, 0 } },
+    { "click_after_selection", STEP_EVENT, REGION_CLICK, { 300, 300 }, { 0, 0, 0, 0, 0, 0, 0 } },
+    { "apply_effects", STEP_EFFECTS, REGION_SHOW, { 1 }, { 0, 0, 0, 0, 0, 0, 1 } },
+    { "apply_same_effects", STEP_EFFECTS, REGION_SHOW, { 1 }, { 0, 0, 0, 0, 0, 0, 0 } },
+    { "load_current_rect", STEP_EVENT, REGION_LOAD, { 92, 69, 708, 508 }, { 0, 0, 0, 0, 0, 0, 0 } },
+    { "drag", STEP_DRAG, REGION_SHOW, { 200, 200, 816, 639 }, { 0, 0, 0, 0, 0, 0, 0 } },
+    { "pin_after_drag", STEP_EVENT, REGION_TOGGLE_PIN, {}, { 0, 0, 1, 0, 0, 0, 0 } },
+    { "load_after_drag", STEP_EVENT, REGION_LOAD, { 92, 69, 708, 508 }, { 0, 0, 0, 1, 0, 0, 0 } },
+    { "maximize_pinned", STEP_EVENT, REGION_MAXIMIZE, {}, { 0, 1, 0, 1, 0, 0, 0 } },
+    { "maximize_again", STEP_EVENT, REGION_MAXIMIZE, {}, { 0, 0, 0, 0, 0, 0, 0 } },
+    { "restore_pinned", STEP_EVENT, REGION_RESTORE, {}, { 0, 1, 0, 1, 1, 0, 0 } },
+    { "restore_again", STEP_EVENT, REGION_RESTORE, {}, { 0, 0, 0, 0, 0, 0, 0 } },
+    { "unpin", STEP_EVENT, REGION_TOGGLE_PIN, {}, { 0, 0, 1, 0, 0, 0, 0 } },
+    { "maximize", STEP_EVENT, REGION_MAXIMIZE, {}, { 0, 1, 1, 1, 0, 0, 0 } },
+    { "load_from_full_screen", STEP_EVENT, REGION_LOAD, { 300, 300, 940, 780 }, { 0, 1, 1, 1, 1, 0, 0 } },
+    { "apply_new_effects", STEP_EFFECTS, REGION_SHOW, { 2 }, { 0, 0, 0, 0, 0, 0, 1 } },
+};
+
+// A region from the last session: loaded straight into the hidden window, themed on the first tick
+const RegionStep restoreSteps[] = {
+    { "load_hidden", STEP_EVENT, REGION_LOAD, { 92, 69, 708, 508 }, { 0, 0, 0, 1, 0, 1, 0 } },
+    { "pin", STEP_EVENT, REGION_TOGGLE_PIN, {}, { 0, 0, 1, 0, 0, 0, 0 } },
+    { "apply_effects", STEP_EFFECTS, REGION_SHOW, { 1 }, { 0, 0, 0, 0, 0, 0, 1 } },
+    { "enable_theme", STEP_EVENT, REGION_ENABLE_THEME, {}, { 0, 0, 0, 0, 1, 0, 0 } },
+    { "show", STEP_EVENT, REGION_SHOW, {}, { 0, 0, 0, 0, 0, 0, 0 } },
+};
+
+const RegionScript scripts[] = {
+    { "selection", selectionSteps, sizeof(selectionSteps) / sizeof(selectionSteps[0]) },
+    { "restore", restoreSteps, sizeof(restoreSteps) / sizeof(restoreSteps[0]) },
+};
+
+const char* const effectNames[REGION_SIDE_EFFECT_COUNT] = {
+    "show", "style", "ex_style", "position", "theme", "opacity", "color_effect"
+};
+
+RECT StepRect(const RegionStep& step) {
+    RECT rect = { step.values[0], step.values[1], step.values[2], step.values[3] };
+    return rect;
+}
+
+}
+
+int RunRegionEffects(const std::vector<std::string>& arguments) {
+    for (const std::string& argument : arguments) {
+        if (argument != "--region-effects") {
+            fprintf(stderr, "Invalid argument: %s\n", argument.c_str());
+            return 2;
+        }
+    }
+
+    WindowFrameMetrics frame;
+    frame.titleBarHeight = 23;
+    frame.borderWidth = 8;
+    frame.borderHeight = 8;
+
+    printf("%-40s", "step");
+    for (const char* name : effectNames)
+        printf(" %8s", name);
+    printf("\n");
+
+    int failures = 0;
+    for (const RegionScript& script : scripts) {
+        HeadlessRegionPlatform platform(frame, 1920, 1080);
+        RegionStateMachine region(platform);
+
+        for (size_t i = 0; i < script.count; i++) {
+            const RegionStep& step = script.steps[i];
+            uint64_t before[REGION_SIDE_EFFECT_COUNT];
+            for (int effect = 0; effect < REGION_SIDE_EFFECT_COUNT; effect++)
+                before[effect] = region.GetSideEffectCount(static_cast<RegionSideEffect>(effect));
+
+            if (step.type == STEP_DRAG) {
+                platform.windowRect = StepRect(step);
+            } else if (step.type == STEP_EFFECTS) {
+                region.SyncEffects(static_cast<uint64_t>(step.values[0]));
+            } else if (step.event == REGION_CLICK) {
+                POINT point = { step.values[0], step.values[1] };
+                region.Dispatch(RegionEvent::Click(point));
+            } else if (step.event == REGION_LOAD) {
+                region.Dispatch(RegionEvent::Load(StepRect(step)));
+            } else {
+                region.Dispatch(RegionEvent(step.event));
+            }
+
+            bool passed = true;
+            char name[64];
+            snprintf(name, sizeof(name), "%s/%s", script.name, step.name);
+            printf("%-40s", name);
+            for (int effect = 0; effect < REGION_SIDE_EFFECT_COUNT; effect++) {
+                uint64_t made = region.GetSideEffectCount(static_cast<RegionSideEffect>(effect)) - before[effect];
+                passed = passed && made == step.expected[effect];
+                printf(" %8llu", static_cast<unsigned long long>(made));
+            }
+            printf("  %s\n", passed ? "ok" : "FAIL");
+            if (!passed)
+                failures++;
+        }
+    }
+
+    if (failures > 0) {
+        printf("%d step(s) made other window calls than expected\n", failures);
+        return 1;
+    }
+    return 0;
+}
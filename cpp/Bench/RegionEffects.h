@@ -0,0 +1,35 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "RegionStateMachine.h"
+
+// RegionPlatform without a window: keeps the window rectangle the calls would produce, so the
+// region state machine can run in the replay and the checks below
+class HeadlessRegionPlatform : public RegionPlatform {
+public:
+    WindowFrameMetrics frame;
+    LONG screenWidth;
+    LONG screenHeight;
+    RECT windowRect; // Where the window is; set directly to model the user dragging it
+
+    HeadlessRegionPlatform(const WindowFrameMetrics& frameMetrics, LONG width, LONG height);
+
+    WindowFrameMetrics GetFrameMetrics() override { return frame; }
+    void GetFullScreenRect(RECT& rect) override;
+    void GetWindowRect(RECT& rect) override { rect = windowRect; }
+
+    void SetShowState(bool) override {}
+    void SetStyle(RegionStyle) override {}
+    void SetExStyle(uint8_t) override {}
+    void SetPosition(const RECT& rect, bool) override { windowRect = rect; }
+    void ApplyTheme() override {}
+    void SetOpaque(bool) override {}
+    bool ApplyColorEffect() override { return true; }
+};
+
+// screenfilter_bench --region-effects: runs the region state machine through selection, slot
+// loads, dragging, full screen and pinning, and checks the window calls each step makes
+// against the minimal set (e.g. none for loading the rectangle the window is already at).
+// Prints one row per step. Returns the process exit code: 0 if every count matches.
+int RunRegionEffects(const std::vector<std::string>& arguments);
@@ -0,0 +1,524 @@
+// screenfilter_bench: times the platform-independent hot paths of the screen filter.
+//
+//   screenfilter_bench [--filter=S] [--warmup=N] [--repetitions=N] [--min-time-ms=N]
+//                      [--cpu=N] [--json=PATH] [--list]
+//   screenfilter_bench --conformance [options, see Conformance.h]
+//   screenfilter_bench --dump-synthetic=SCENARIO [--frames=N] [--size=WxH] [--out=DIR]
+//   screenfilter_bench --latency[=virtual|realtime] [options, see LatencyHarness.h]
+//   screenfilter_bench --input-burst [--events=N] [--spacing-us=N] [--seed=N]
+//   screenfilter_bench --control-load [options, see ControlLoad.h]
+//   screenfilter_bench --dither-quality [--min-improvement=X]
+//   screenfilter_bench --replay[=PATH] [options, see InputReplay.h]
+//   screenfilter_bench --region-effects
+//   screenfilter_bench --metrics [--port=N]
+//   screenfilter_bench --event-tracer [--threads=N]
+//   screenfilter_bench --monitor-layout
+//   screenfilter_bench --shortcut-config [--writes=N]
+//   screenfilter_bench --startup [--regions=N] [--repetitions=N] [--main-ms=N] [--write=PATH]
+//   screenfilter_bench --timer-wheel [--operations=N] [--seed=N]
+//   screenfilter_bench --tone-curve [--min-speedup=X]
+//   screenfilter_bench --sharpen [--budget-ms=N] [--repetitions=N] [--threads=N]
+//   screenfilter_bench --privacy [--max-ratio=X] [--threads=N]
+//   screenfilter_bench --binarize [--max-ratio=X] [--budget-ms=N] [--threads=N]
+//   screenfilter_bench --auto-invert [--max-share=X]
+//   screenfilter_bench --smart-invert [--max-error=X] [--max-ratio=X] [--budget-ms=N] [--threads=N]
+//   screenfilter_bench --temperature [--max-frame-ratio=X]
+//   screenfilter_bench --transitions [--duration-ms=N] [--budget-ns=N]
+//   screenfilter_bench --vision [--budget-ns=N]
+//
+// Compare two JSON results with compare_bench.py.
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include "AutoInversion.h"
+#include "BenchHarness.h"
+#include "Binarization.h"
+#include "Conformance.h"
+#include "ControlLoad.h"
+#include "ColorEffects.h"
+#include "ColorTemperature.h"
+#include "DitherQuality.h"
+#include "EffectTransitions.h"
+#include "EventTracer.h"
+#include "EventTracerCheck.h"
+#include "FramePipeline.h"
+#include "InputBurst.h"
+#include "InputReplay.h"
+#include "LatencyHarness.h"
+#include "Metrics.h"
+#include "MetricsCheck.h"
+#include "MonitorLayout.h"
+#include "MonitorLayoutCheck.h"
+#include "PixelKernels.h"
+#include "RegionEffects.h"
+#include "PpmImage.h"
+#include "PrivacyFilters.h"
+#include "SavedRectanglesManager.h"
+#include "Sharpening.h"
+#include "ShortcutConfig.h"
+#include "ShortcutConfigCheck.h"
+#include "SmartInversion.h"
+#include "StartupPhases.h"
+#include "SyntheticDesktop.h"
+#include "TimerWheelCheck.h"
+#include "ToneCurves.h"
+#include "VisionEffects.h"
+
+namespace {
+
+MonitorDesc MakeMonitor(const char* name, LONG left, LONG top, LONG width, LONG height, bool primary) {
+    MonitorDesc monitor;
+    monitor.deviceName = name;
+    monitor.bounds.left = left;
+    monitor.bounds.top = top;
+    monitor.bounds.right = left + width;
+    monitor.bounds.bottom = top + height;
+    monitor.isPrimary = primary;
+    return monitor;
+}
+
+// Six mixed-resolution monitors, including a portrait one and negative coordinates
+std::vector<MonitorDesc> SixMonitorLayout() {
+    return {
+        MakeMonitor("\\\\.\\DISPLAY1", 0, 0, 2560, 1440, true),
+        MakeMonitor("\\\\.\\DISPLAY2", 2560, 0, 1920, 1080, false),
+        MakeMonitor("\\\\.\\DISPLAY3", -1080, -480, 1080, 1920, false),
+        MakeMonitor("\\\\.\\DISPLAY4", 0, 1440, 1920, 1080, false),
+        MakeMonitor("\\\\.\\DISPLAY5", 1920, 1440, 3840, 2160, false),
+        MakeMonitor("\\\\.\\DISPLAY6", 4480, -600, 1280, 1024, false),
+    };
+}
+
+std::vector<uint32_t> RandomPixels(size_t count) {
+    std::mt19937 random(12345);
+    std::vector<uint32_t> pixels(count);
+    for (uint32_t& pixel : pixels)
+        pixel = random() | 0xFF000000u;
+    return pixels;
+}
+
+// Representative shortcuts.txt contents
+const char* SampleShortcutConfig() {
+    return
+        "# Screen Filter Shortcut Configuration\n"
+        "# Edit these values to customize keyboard shortcuts\n\n"
+        "# Toggle color inversion on/off\n"
+        "ToggleInvertKey=Ctrl+I\n\n"
+        "# Toggle between grayscale and color\n"
+        "ToggleGrayscaleKey=C\n\n"
+        "# Cycle through white/brightness levels\n"
+        "CycleWhiteLevelKey=Shift+F5\n\n"
+        "ToggleMetricsOverlayKey=M\n"
+        "ToggleTraceKey=T\n\n"
+        "# Global hotkey to toggle pin/click-through mode\n"
+        "GlobalHotkeyKey=P\n"
+        "GlobalHotkeyModifiers=CTRL+SHIFT\n";
+}
+
+void RegisterColorBenchmarks(BenchSuite& suite) {
+    suite.Add("color_matrix/calculate_all_settings", 2 * 2 * NUM_GRAY_LEVELS, [] {
+        return BenchBody([](uint64_t iterations) {
+            ColorMatrix matrix;
+            for (uint64_t i = 0; i < iterations; i++) {
+                for (int combination = 0; combination < 2 * 2 * NUM_GRAY_LEVELS; combination++) {
+                    ColorEffectSettings settings;
+                    settings.inversionEnabled = (combination & 1) != 0;
+                    settings.grayscaleEnabled = (combination & 2) != 0;
+                    settings.grayLevel = combination >> 2;
+                    CalculateColorMatrix(settings, matrix);
+                    BenchDoNotOptimize(matrix);
+                }
+            }
+        });
+    });
+
+    // A typical filtered region, a full 1080p frame and a full 4K frame
+    const struct { const char* name; size_t width; size_t height; } sizes[] = {
+        { "640x480", 640, 480 }, { "1920x1080", 1920, 1080 }, { "3840x2160", 3840, 2160 }
+    };
+    for (int kernel = 0; kernel < PIXEL_KERNEL_COUNT; kernel++) {
+        if (!IsPixelKernelAvailable(static_cast<PixelKernel>(kernel)))
+            continue;
+        for (const auto& size : sizes) {
+            size_t count = size.width * size.height;
+            suite.Add(std::string("pixel_kernel/") + PixelKernelName(static_cast<PixelKernel>(kernel)) + "/" + size.name,
+                static_cast<double>(count), [kernel, count] {
+                std::shared_ptr<std::vector<uint32_t>> source = std::make_shared<std::vector<uint32_t>>(RandomPixels(count));
+                std::shared_ptr<std::vector<uint32_t>> target = std::make_shared<std::vector<uint32_t>>(count);
+                ColorEffectSettings settings;
+                settings.inversionEnabled = true;
+                settings.grayscaleEnabled = true;
+                settings.grayLevel = 2;
+                ColorMatrix matrix;
+                CalculateColorMatrix(settings, matrix);
+
+                return BenchBody([kernel, source, target, matrix](uint64_t iterations) {
+                    for (uint64_t i = 0; i < iterations; i++) {
+                        ApplyColorMatrix(static_cast<PixelKernel>(kernel), matrix, source->data(), target->data(), source->size());
+                        BenchDoNotOptimize(target->data()[0]);
+                    }
+                });
+            });
+        }
+    }
+}
+
+void RegisterGeometryBenchmarks(BenchSuite& suite) {
+    const size_t pointCount = 4096;
+    suite.Add("monitor_layout/monitor_from_point", pointCount, [pointCount] {
+        std::shared_ptr<MonitorLayout> layout = std::make_shared<MonitorLayout>();
+        layout->SetMonitors(SixMonitorLayout());
+
+        std::mt19937 random(7);
+        std::uniform_int_distribution<LONG> x(-1200, 5900), y(-700, 3700);
+        std::shared_ptr<std::vector<std::pair<LONG, LONG>>> points = std::make_shared<std::vector<std::pair<LONG, LONG>>>();
+        for (size_t i = 0; i < pointCount; i++)
+            points->push_back(std::make_pair(x(random), y(random)));
+
+        return BenchBody([layout, points](uint64_t iterations) {
+            for (uint64_t i = 0; i < iterations; i++) {
+                int hits = 0;
+                for (const std::pair<LONG, LONG>& point : *points)
+                    hits += layout->MonitorFromPoint(point.first, point.second);
+                BenchDoNotOptimize(hits);
+            }
+        });
+    });
+
+    // 1000 saved rectangles resolved against six monitors; one in ten names a monitor that is gone
+    const size_t rectCount = 1000;
+    suite.Add("monitor_layout/resolve_1k", rectCount, [rectCount] {
+        std::shared_ptr<MonitorLayout> layout = std::make_shared<MonitorLayout>();
+        layout->SetMonitors(SixMonitorLayout());
+
+        std::mt19937 random(11);
+        std::uniform_real_distribution<double> fraction(0.0, 0.5);
+        std::shared_ptr<std::vector<NormalizedRect>> rects = std::make_shared<std::vector<NormalizedRect>>();
+        for (size_t i = 0; i < rectCount; i++) {
+            NormalizedRect rect;
+            rect.monitor = (i % 10 == 9) ? std::string("\\\\.\\DISPLAY9") : layout->GetMonitors()[i % 6].deviceName;
+            rect.left = fraction(random);
+            rect.top = fraction(random);
+            rect.right = rect.left + 0.1 + fraction(random);
+            rect.bottom = rect.top + 0.1 + fraction(random);
+            rects->push_back(rect);
+        }
+        RECT fallback = { 3000, 200, 3400, 600 };
+
+        return BenchBody([layout, rects, fallback](uint64_t iterations) {
+            RECT result;
+            for (uint64_t i = 0; i < iterations; i++) {
+                for (const NormalizedRect& rect : *rects) {
+                    layout->Resolve(rect, &fallback, result);
+                    BenchDoNotOptimize(result);
+                }
+            }
+        });
+    });
+
+    suite.Add("monitor_layout/set_monitors", 1, [] {
+        std::shared_ptr<std::vector<MonitorDesc>> monitors = std::make_shared<std::vector<MonitorDesc>>(SixMonitorLayout());
+        return BenchBody([monitors](uint64_t iterations) {
+            MonitorLayout layout;
+            for (uint64_t i = 0; i < iterations; i++) {
+                layout.SetMonitors(*monitors);
+                BenchDoNotOptimize(layout);
+            }
+        });
+    });
+}
+
+void RegisterParsingBenchmarks(BenchSuite& suite) {
+    const size_t lineCount = 1000;
+    suite.Add("saved_rects/parse_entry", lineCount, [lineCount] {
+        std::shared_ptr<std::vector<std::string>> lines = std::make_shared<std::vector<std::string>>();
+        for (size_t i = 0; i < lineCount; i++) {
+            SavedRectEntry entry;
+            entry.rect = { static_cast<LONG>(i), 100, static_cast<LONG>(i) + 640, 580 };
+            entry.inversionEnabled = (i % 2) == 0;
+            entry.grayLevel = static_cast<int>(i % NUM_GRAY_LEVELS);
+            entry.isValid = true;
+            entry.hasPlacement = (i % 4) != 0;
+            entry.placement.monitor = "\\\\.\\DISPLAY1";
+            entry.placement.left = 0.125;
+            entry.placement.top = 0.25;
+            entry.placement.right = 0.5;
+            entry.placement.bottom = 0.75;
+
+            std::ostringstream line;
+            SavedRectanglesManager::WriteEntry(line, entry);
+            lines->push_back(line.str());
+        }
+
+        return BenchBody([lines](uint64_t iterations) {
+            SavedRectEntry entry;
+            for (uint64_t i = 0; i < iterations; i++) {
+                for (const std::string& line : *lines) {
+                    SavedRectanglesManager::ParseEntry(line, entry);
+                    BenchDoNotOptimize(entry);
+                }
+            }
+        });
+    });
+
+    suite.Add("saved_rects/write_entry", lineCount, [lineCount] {
+        SavedRectEntry entry;
+        entry.rect = { 10, 100, 650, 580 };
+        entry.isValid = true;
+        entry.hasPlacement = true;
+        entry.placement.monitor = "\\\\.\\DISPLAY1";
+        entry.placement.right = 0.5;
+        entry.placement.bottom = 0.75;
+
+        return BenchBody([entry, lineCount](uint64_t iterations) {
+            for (uint64_t i = 0; i < iterations; i++) {
+                std::ostringstream out;
+                for (size_t line = 0; line < lineCount; line++)
+                    SavedRectanglesManager::WriteEntry(out, entry);
+                BenchDoNotOptimize(out);
+            }
+        });
+    });
+
+    suite.Add("shortcut_config/parse", 1, [] {
+        return BenchBody([](uint64_t iterations) {
+            std::vector<ConfigError> errors;
+            for (uint64_t i = 0; i < iterations; i++) {
+                std::istringstream input(SampleShortcutConfig());
+                ShortcutConfig config;
+                errors.clear();
+                ParseShortcutConfig(input, config, errors);
+                BenchDoNotOptimize(config);
+            }
+        });
+    });
+}
+
+void RegisterPipelineBenchmarks(BenchSuite& suite) {
+    static const int desktopWidth = 1920, desktopHeight = 1080;
+    for (int scenario = 0; scenario < SCENARIO_COUNT; scenario++) {
+        std::string scenarioName = SyntheticScenarioName(static_cast<SyntheticScenario>(scenario));
+
+        suite.Add("synthetic_desktop/" + scenarioName + "/1920x1080", desktopWidth * desktopHeight, [scenario] {
+            std::shared_ptr<SyntheticDesktop> desktop = std::make_shared<SyntheticDesktop>(desktopWidth, desktopHeight, static_cast<SyntheticScenario>(scenario));
+            std::shared_ptr<PixelImage> frame = std::make_shared<PixelImage>();
+            std::shared_ptr<uint64_t> frameIndex = std::make_shared<uint64_t>(0);
+            return BenchBody([desktop, frame, frameIndex](uint64_t iterations) {
+                for (uint64_t i = 0; i < iterations; i++) {
+                    desktop->Render((*frameIndex)++, *frame);
+                    BenchDoNotOptimize(frame->pixels[0]);
+                }
+            });
+        });
+
+        // A 1280x720 filter window in the middle of the desktop, as UpdateMagWindow() would drive it
+        suite.Add("frame_pipeline/" + scenarioName + "/1280x720", 1280 * 720, [scenario] {
+            std::shared_ptr<SyntheticDesktop> desktop = std::make_shared<SyntheticDesktop>(desktopWidth, desktopHeight, static_cast<SyntheticScenario>(scenario));
+            std::shared_ptr<SyntheticFrameSource> source = std::make_shared<SyntheticFrameSource>(*desktop);
+            std::shared_ptr<FramePipeline> pipeline = std::make_shared<FramePipeline>(*source, BestPixelKernel());
+
+            RECT windowRect = { 300, 150, 300 + 1296, 150 + 759 };
+            RECT clientRect = { 0, 0, 1280, 720 };
+            WindowFrameMetrics metrics = { 23, 4, 4 };
+            pipeline->SetSource(ComputeMagnifierSource(windowRect, clientRect, metrics, 1.0f));
+
+            ColorEffectSettings settings;
+            settings.inversionEnabled = true;
+            ColorMatrix matrix;
+            CalculateColorMatrix(settings, matrix);
+            pipeline->SetColorMatrix(matrix);
+
+            return BenchBody([desktop, source, pipeline](uint64_t iterations) {
+                for (uint64_t i = 0; i < iterations; i++) {
+                    pipeline->RenderFrame();
+                    BenchDoNotOptimize(pipeline->GetOutput().pixels[0]);
+                }
+            });
+        });
+    }
+}
+
+// Write frames of a synthetic scenario as PPM images, to see what the benchmarks run on
+int RunDumpSynthetic(const std::vector<std::string>& arguments) {
+    SyntheticScenario scenario = SCENARIO_MIXED;
+    int frames = 120, width = 1920, height = 1080;
+    std::string directory = "synthetic_frames";
+
+    for (const std::string& argument : arguments) {
+        size_t equals = argument.find('=');
+        std::string name = argument.substr(0, equals);
+        std::string value = equals == std::string::npos ? "" : argument.substr(equals + 1);
+
+        bool valid = true;
+        if (name == "--dump-synthetic")
+            valid = ParseSyntheticScenario(value, scenario);
+        else if (name == "--frames")
+            valid = sscanf(value.c_str(), "%d", &frames) == 1 && frames > 0;
+        else if (name == "--size")
+            valid = sscanf(value.c_str(), "%dx%d", &width, &height) == 2 && width > 0 && height > 0;
+        else if (name == "--out")
+            directory = value;
+        else
+            valid = false;
+
+        if (!valid) {
+            fprintf(stderr, "Invalid argument: %s\n", argument.c_str());
+            return 2;
+        }
+    }
+
+    SyntheticDesktop desktop(width, height, scenario);
+    PixelImage frame;
+    char path[512];
+    for (int i = 0; i < frames; i++) {
+        desktop.Render(static_cast<uint64_t>(i), frame);
+        snprintf(path, sizeof(path), "%s/%s_%04d.ppm", directory.c_str(), SyntheticScenarioName(scenario), i);
+        if (!WritePpm(path, frame)) {
+            fprintf(stderr, "Could not write %s\n", path);
+            return 1;
+        }
+    }
+    printf("Wrote %d frames to %s\n", frames, directory.c_str());
+    return 0;
+}
+
+void RegisterInstrumentationBenchmarks(BenchSuite& suite) {
+    const size_t operations = 1000;
+    suite.Add("metrics/counter_increment", operations, [operations] {
+        std::shared_ptr<MetricsRegistry> registry = std::make_shared<MetricsRegistry>();
+        MetricCounter* counter = &registry->Counter("bench_total", "Benchmark counter");
+        return BenchBody([registry, counter, operations](uint64_t iterations) {
+            for (uint64_t i = 0; i < iterations; i++) {
+                for (size_t op = 0; op < operations; op++)
+                    counter->Increment();
+            }
+            BenchDoNotOptimize(counter);
+        });
+    });
+
+    for (int enabled = 0; enabled < 2; enabled++) {
+        suite.Add(enabled ? "event_tracer/scope_enabled" : "event_tracer/scope_disabled", operations, [enabled, operations] {
+            std::shared_ptr<EventTracer> tracer = std::make_shared<EventTracer>();
+            if (enabled)
+                tracer->Start();
+            return BenchBody([tracer, operations](uint64_t iterations) {
+                for (uint64_t i = 0; i < iterations; i++) {
+                    for (size_t op = 0; op < operations; op++) {
+                        TraceScope scope(*tracer, "bench", "bench");
+                    }
+                }
+            });
+        });
+    }
+}
+
+}
+
+int main(int argc, char** argv) {
+    // Kernels are only worth timing once they are known to be correct
+    for (int i = 1; i < argc; i++) {
+        if (std::string(argv[i]) == "--conformance")
+            return RunConformance(std::vector<std::string>(argv + 1, argv + argc));
+        if (std::string(argv[i]).compare(0, 16, "--dump-synthetic") == 0)
+            return RunDumpSynthetic(std::vector<std::string>(argv + 1, argv + argc));
+        if (std::string(argv[i]).compare(0, 9, "--latency") == 0)
+            return RunLatency(std::vector<std::string>(argv + 1, argv + argc));
+        if (std::string(argv[i]) == "--input-burst")
+            return RunInputBurstReport(std::vector<std::string>(argv + 1, argv + argc));
+        if (std::string(argv[i]) == "--control-load")
+            return RunControlLoad(std::vector<std::string>(argv + 1, argv + argc));
+        if (std::string(argv[i]).compare(0, 8, "--replay") == 0)
+            return RunReplay(std::vector<std::string>(argv + 1, argv + argc));
+        if (std::string(argv[i]) == "--region-effects")
+            return RunRegionEffects(std::vector<std::string>(argv + 1, argv + argc));
+        if (std::string(argv[i]) == "--metrics")
+            return RunMetricsChecks(std::vector<std::string>(argv + 1, argv + argc));
+        if (std::string(argv[i]) == "--event-tracer")
+            return RunEventTracerChecks(std::vector<std::string>(argv + 1, argv + argc));
+        if (std::string(argv[i]) == "--monitor-layout")
+            return RunMonitorLayoutChecks(std::vector<std::string>(argv + 1, argv + argc));
+        if (std::string(argv[i]) == "--shortcut-config")
+            return RunShortcutConfigChecks(std::vector<std::string>(argv + 1, argv + argc));
+        if (std::string(argv[i]) == "--startup")
+            return RunStartupPhases(std::vector<std::string>(argv + 1, argv + argc));
+        if (std::string(argv[i]) == "--timer-wheel")
+            return RunTimerWheelChecks(std::vector<std::string>(argv + 1, argv + argc));
+        if (std::string(argv[i]) == "--transitions")
+            return RunEffectTransitions(std::vector<std::string>(argv + 1, argv + argc));
+        if (std::string(argv[i]) == "--dither-quality")
+            return RunDitherQuality(std::vector<std::string>(argv + 1, argv + argc));
+        if (std::string(argv[i]) == "--vision")
+            return RunVisionChecks(std::vector<std::string>(argv + 1, argv + argc));
+        if (std::string(argv[i]) == "--temperature")
+            return RunColorTemperatureChecks(std::vector<std::string>(argv + 1, argv + argc));
+        if (std::string(argv[i]) == "--tone-curve")
+            return RunToneCurveChecks(std::vector<std::string>(argv + 1, argv + argc));
+        if (std::string(argv[i]) == "--sharpen")
+            return RunSharpenChecks(std::vector<std::string>(argv + 1, argv + argc));
+        if (std::string(argv[i]) == "--privacy")
+            return RunPrivacyChecks(std::vector<std::string>(argv + 1, argv + argc));
+        if (std::string(argv[i]) == "--binarize")
+            return RunBinarizeChecks(std::vector<std::string>(argv + 1, argv + argc));
+        if (std::string(argv[i]) == "--auto-invert")
+            return RunAutoInvertChecks(std::vector<std::string>(argv + 1, argv + argc));
+        if (std::string(argv[i]) == "--smart-invert")
+            return RunSmartInvertChecks(std::vector<std::string>(argv + 1, argv + argc));
+    }
+
+    BenchOptions options;
+    std::vector<std::string> remaining;
+    std::string error;
+    if (!ParseBenchOptions(argc, argv, options, remaining, error)) {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 2;
+    }
+    if (!remaining.empty()) {
+        fprintf(stderr, "Unknown argument: %s\n", remaining.front().c_str());
+        return 2;
+    }
+
+    BenchSuite suite;
+    RegisterColorBenchmarks(suite);
+    RegisterGeometryBenchmarks(suite);
+    RegisterParsingBenchmarks(suite);
+    RegisterPipelineBenchmarks(suite);
+    RegisterInstrumentationBenchmarks(suite);
+    RegisterInputBurstBenchmarks(suite);
+    RegisterTimerWheelBenchmarks(suite);
+    RegisterEffectTransitionBenchmarks(suite);
+    RegisterDitherBenchmarks(suite);
+    RegisterVisionBenchmarks(suite);
+    RegisterColorTemperatureBenchmarks(suite);
+    RegisterToneCurveBenchmarks(suite);
+    RegisterSharpenBenchmarks(suite);
+    RegisterPrivacyBenchmarks(suite);
+    RegisterBinarizeBenchmarks(suite);
+    RegisterAutoInvertBenchmarks(suite);
+    RegisterSmartInvertBenchmarks(suite);
+
+    if (options.list) {
+        for (const BenchDefinition& definition : suite.GetBenchmarks())
+            printf("%s\n", definition.name.c_str());
+        return 0;
+    }
+
+    if (options.pinCpu >= 0 && !PinCurrentThread(options.pinCpu)) {
+        fprintf(stderr, "Could not pin to CPU %d\n", options.pinCpu);
+        return 2;
+    }
+
+    std::vector<BenchResult> results = suite.Run(options, std::cout);
+
+    if (!options.jsonPath.empty()) {
+        std::ofstream json(options.jsonPath, std::ios::trunc);
+        if (!json.is_open()) {
+            fprintf(stderr, "Could not write %s\n", options.jsonPath.c_str());
+            return 1;
+        }
+        WriteBenchJson(json, options, results);
+    }
+    return 0;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "BenchHarness.h"
+
+// sharpen/<kernel>/<size>: SharpenImage at 100% on a 1080p and a 4K frame on one thread;
+// sharpen/<kernel>/<size>/pool: the same tiles shared out over one thread per hardware thread
+void RegisterSharpenBenchmarks(BenchSuite& suite);
+
+// screenfilter_bench --sharpen [--budget-ms=N] [--repetitions=N] [--threads=N]: checks the
+// sharpening stage. Every kernel must match an unsharp mask written out per pixel exactly, on
+// sizes that cut tiles short and on images smaller than the filter; a pool must not change the
+// result; flat areas and strength 0 must pass through; an inverted anti-aliased stroke must
+// gain contrast; and over N pairs of frames (default 31), the median of what sharpening adds to
+// a 1080p FramePipeline frame of the static document must be under N ms (default 6, about a
+// third of a 60 Hz frame), using a pool of N threads (default: one per hardware thread). 4K is
+// reported without a budget. Returns the process exit code: 0 if every check passes.
+int RunSharpenChecks(const std::vector<std::string>& arguments);
@@ -0,0 +1,296 @@
+#include "ShortcutConfigCheck.h"
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include "BenchChecks.h"
+#include "FileWatcher.h"
+#include "ShortcutConfig.h"
+
+namespace {
+
+// As in ScreenInversion.cpp
+const int64_t watchIntervalMs = 500;
+const std::chrono::milliseconds settleTime(300);
+
+// Defaults with 'text' parsed on top
+ShortcutConfig Parse(const char* text, std::vector<ConfigError>& errors) {
+    ShortcutConfig config;
+    std::istringstream input(text);
+    ParseShortcutConfig(input, config, errors);
+    return config;
+}
+
+// Whether an error on 'line' mentions 'fragment'
+bool Reported(const std::vector<ConfigError>& errors, int line, const char* fragment) {
+    for (const ConfigError& error : errors) {
+        if (error.line == line && error.message.find(fragment) != std::string::npos)
+            return true;
+    }
+    return false;
+}
+
+std::string Describe(const std::vector<ConfigError>& errors) {
+    std::string text = std::to_string(errors.size()) + " error(s)";
+    for (const ConfigError& error : errors)
+        text += "; " + std::to_string(error.line) + ": " + error.message;
+    return text;
+}
+
+KeyChord Chord(const char* text) {
+    KeyChord chord = { 0, 0 };
+    std::string error;
+    ParseKeyChord(text, chord, error);
+    return chord;
+}
+
+void CheckParsing() {
+    const ShortcutConfig defaults;
+
+    {
+        std::vector<ConfigError> errors;
+        ShortcutConfig config = Parse("ToggleInvertKey\n# comment\n\nToggleGrayscaleKey=G\n", errors);
+        bool passed = errors.size() == 1 && Reported(errors, 1, "Expected Name=Value") &&
+            config.toggleInvert == defaults.toggleInvert && config.toggleGrayscale == Chord("G");
+        Check("malformed_line", passed, Describe(errors));
+    }
+
+    {
+        std::vector<ConfigError> errors;
+        ShortcutConfig config = Parse("ToggleInvertKey=Ctrl+\nWarmerKey=Ctrl+Hyper+K\nCoolerKey=\nCycleWhiteLevelKey=Ctrl++\n", errors);
+        bool passed = errors.size() == 3 && Reported(errors, 1, "Missing key") && Reported(errors, 2, "Unknown modifier 'Hyper'") &&
+            Reported(errors, 3, "Missing key") && config.toggleInvert == defaults.toggleInvert && config.warmer == defaults.warmer &&
+            config.cooler == defaults.cooler && config.cycleWhiteLevel == KeyChord({ VK_OEM_PLUS, MOD_CONTROL });
+        Check("malformed_chords", passed, Describe(errors));
+    }
+
+    {
+        std::vector<ConfigError> errors;
+        ShortcutConfig config = Parse("ToggleInvertKey=Banana\nToggleTraceKey=F25\nGlobalHotkeyKey=Numpad10\n"
+            "GlobalHotkeyModifiers=Ctrl+Hyper\nTurboKey=X\n", errors);
+        bool passed = errors.size() == 5 && Reported(errors, 1, "Unknown key 'Banana'") && Reported(errors, 2, "Unknown key 'F25'") &&
+            Reported(errors, 3, "Unknown key 'Numpad10'") && Reported(errors, 4, "Unknown modifier 'Hyper'") &&
+            Reported(errors, 5, "Unknown setting 'TurboKey'") && config.toggleInvert == defaults.toggleInvert &&
+            config.toggleTrace == defaults.toggleTrace && config.globalHotkey == defaults.globalHotkey;
+        Check("unknown_keys", passed, Describe(errors));
+    }
+
+    {
+        std::vector<ConfigError> errors;
+        ShortcutConfig config = Parse("ToggleInvertKey=J\nToggleGrayscaleKey=G\nToggleInvertKey=L\n", errors);
+        bool passed = errors.size() == 1 && Reported(errors, 3, "already set on line 1") && config.toggleInvert == Chord("J") &&
+            config.toggleGrayscale == Chord("G");
+        Check("duplicate_setting", passed, Describe(errors));
+    }
+
+    {
+        std::vector<ConfigError> errors;
+        ShortcutConfig config = Parse("ToggleInvertKey=5\nToggleGrayscaleKey=Ctrl+3\nCycleWhiteLevelKey=Escape\n"
+            "ToggleTraceKey=Shift+5\nGlobalHotkey=Ctrl+Alt+5\n", errors);
+        bool passed = errors.size() == 3 && Reported(errors, 1, "reserved") && Reported(errors, 2, "reserved") &&
+            Reported(errors, 3, "reserved") && config.toggleInvert == defaults.toggleInvert &&
+            config.toggleGrayscale == defaults.toggleGrayscale && config.cycleWhiteLevel == defaults.cycleWhiteLevel &&
+            config.toggleTrace == Chord("Shift+5") && config.globalHotkey == Chord("Ctrl+Alt+5");
+        Check("reserved_chords", passed, Describe(errors));
+    }
+
+    {
+        std::vector<ConfigError> errors;
+        ShortcutConfig config = Parse("GlobalHotkeyKey=F8\nGlobalHotkeyModifiers=None\n", errors);
+        bool passed = errors.size() == 1 && Reported(errors, 0, "at least one modifier") && config.globalHotkey == defaults.globalHotkey;
+        Check("global_hotkey_needs_modifier", passed, Describe(errors));
+    }
+
+    // Both sides of a conflict go back, the rest of the file still applies
+    {
+        std::vector<ConfigError> errors;
+        ShortcutConfig config = Parse("ToggleInvertKey=C\nToggleTraceKey=Shift+F2\nWarmerKey=Shift+A\n", errors);
+        bool passed = errors.size() == 2 && Reported(errors, 0, "C is bound to more than one action") &&
+            Reported(errors, 0, "Shift+A is bound to more than one action") && config.toggleInvert == defaults.toggleInvert &&
+            config.toggleGrayscale == defaults.toggleGrayscale && config.warmer == defaults.warmer &&
+            config.toggleSmartInvert == defaults.toggleSmartInvert && config.toggleTrace == Chord("Shift+F2");
+        Check("conflicting_bindings", passed, Describe(errors));
+    }
+
+    // The registered global hotkey never reaches the window, and the escape key is checked first
+    {
+        std::vector<ConfigError> errors;
+        ShortcutConfig config = Parse("ToggleInvertKey=Ctrl+Shift+F7\nGlobalHotkey=Ctrl+Shift+F7\nToggleTraceKey=Shift+Escape\n"
+            "WarmerKey=Alt+Escape\n", errors);
+        bool passed = errors.size() == 2 && Reported(errors, 0, "Ctrl+Shift+F7 is bound to more than one action") &&
+            Reported(errors, 0, "Shift+Escape is taken by the escape key") && config.toggleInvert == defaults.toggleInvert &&
+            config.globalHotkey == defaults.globalHotkey && config.toggleTrace == defaults.toggleTrace &&
+            config.warmer == Chord("Alt+Escape");
+        Check("global_and_escape_conflicts", passed, Describe(errors));
+    }
+
+    {
+        const KeyChord chords[] = {
+            { 'Q', 0 }, { VK_OEM_PLUS, MOD_CONTROL }, { VK_F1 + 23, MOD_SHIFT }, { VK_NUMPAD0 + 7, MOD_ALT },
+            { VK_NEXT, MOD_SHIFT }, { VK_SPACE, MOD_WIN | MOD_ALT }, { VK_ESCAPE, MOD_CONTROL | MOD_SHIFT | MOD_ALT | MOD_WIN },
+        };
+        int wrong = 0;
+        std::string detail;
+        for (const KeyChord& chord : chords) {
+            KeyChord parsed = { 0, 0 };
+            std::string error;
+            if (!ParseKeyChord(FormatKeyChord(chord), parsed, error) || parsed != chord) {
+                wrong++;
+                detail += " " + FormatKeyChord(chord);
+            }
+        }
+        Check("format_round_trip", wrong == 0, std::to_string(sizeof(chords) / sizeof(chords[0])) + " chords, " +
+            std::to_string(wrong) + " changed" + detail);
+    }
+}
+
+void SaveFile(const std::string& path, const char* text) {
+    std::ofstream file(path, std::ios::trunc);
+    file << text;
+}
+
+// CheckShortcutConfig() and ReloadShortcutConfig() from ScreenInversion.cpp on a fake clock,
+// counting reloads and global hotkey registrations instead of making them
+class ReloadLoop {
+private:
+    std::string path;
+    std::filesystem::file_time_type writeTime;
+    FileWatcher watcher;
+    ShortcutConfig shortcuts;
+    int64_t nowMs;
+    int64_t nextPollMs;
+
+    void Reload() {
+        ShortcutConfig updated;
+        std::vector<ConfigError> errors;
+        if (!ReloadShortcutConfigFile(path.c_str(), shortcuts, updated, errors))
+            return;
+
+        reloads++;
+        if (DiffShortcutConfig(shortcuts, updated) & SHORTCUT_CHANGE_GLOBAL_HOTKEY)
+            registrations++;
+        shortcuts = updated;
+    }
+
+public:
+    int reloads;
+    int registrations;
+
+    // The file must already exist, as shortcuts.txt does after startup
+    explicit ReloadLoop(const std::string& filePath)
+        : path(filePath), writeTime(std::filesystem::last_write_time(filePath)), watcher(filePath, settleTime), nowMs(0),
+          nextPollMs(watchIntervalMs), reloads(0), registrations(0) {
+        std::vector<ConfigError> errors;
+        LoadShortcutConfigFile(path.c_str(), shortcuts, errors);
+    }
+
+    // Rewrite the file; every save gets a later write time, however coarse the file system's clock
+    void Write(const char* text) {
+        SaveFile(path, text);
+        writeTime += std::chrono::seconds(1);
+        std::filesystem::last_write_time(path, writeTime);
+    }
+
+    // Run the watch timer up to 'ms'
+    void AdvanceTo(int64_t ms) {
+        for (; nextPollMs <= ms; nextPollMs += watchIntervalMs) {
+            nowMs = nextPollMs;
+            if (watcher.Poll(std::chrono::steady_clock::time_point(std::chrono::milliseconds(nowMs))))
+                Reload();
+        }
+        nowMs = ms;
+    }
+
+    int64_t Now() const { return nowMs; }
+    const ShortcutConfig& Shortcuts() const { return shortcuts; }
+};
+
+void CheckReloadStorm(int writes) {
+    std::string path = (std::filesystem::temp_directory_path() / "screenfilter_shortcuts.txt").string();
+    SaveFile(path, "GlobalHotkey=Ctrl+Shift+P\n");
+    ReloadLoop loop(path);
+
+    // An editor saving every 100 ms, some saves caught half written
+    const char* const storm[] = {
+        "GlobalHotkey=Ctrl+Alt+F5\n", "GlobalHotkey=Ctrl+\n", "GlobalHotkey=Ctrl+Shift+F6\nToggleInvertKey=J\n", "Glob",
+    };
+    int64_t start = loop.Now();
+    for (int i = 0; i < writes; i++) {
+        loop.AdvanceTo(start + i * 100);
+        loop.Write(i + 1 == writes ? "GlobalHotkey=Ctrl+Alt+F9\nToggleInvertKey=J\n" : storm[i % 4]);
+    }
+    int duringStorm = loop.reloads;
+    loop.AdvanceTo(loop.Now() + 3000);
+    bool passed = duringStorm == 0 && loop.reloads == 1 && loop.registrations == 1 &&
+        loop.Shortcuts().globalHotkey == Chord("Ctrl+Alt+F9") && loop.Shortcuts().toggleInvert == Chord("J");
+    Check("reload_storm", passed, std::to_string(writes) + " saves, " + std::to_string(loop.reloads) + " reload(s), " +
+        std::to_string(loop.registrations) + " registration(s), hotkey " + FormatKeyChord(loop.Shortcuts().globalHotkey));
+
+    // Back where it started: reloaded, but the hotkey is left registered
+    start = loop.Now();
+    for (int i = 0; i < writes; i++) {
+        loop.AdvanceTo(start + i * 100);
+        loop.Write(i + 1 == writes ? "GlobalHotkey=Ctrl+Alt+F9\nToggleInvertKey=J\n" : storm[i % 4]);
+    }
+    loop.AdvanceTo(loop.Now() + 3000);
+    passed = loop.reloads == 2 && loop.registrations == 1;
+    Check("reload_storm_unchanged", passed, std::to_string(loop.reloads - 1) + " reload(s), " +
+        std::to_string(loop.registrations - 1) + " registration(s)");
+
+    // Saves a few seconds apart are separate edits
+    const char* const spaced[] = { "GlobalHotkey=Ctrl+Alt+F1\n", "GlobalHotkey=Ctrl+Alt+F2\n", "GlobalHotkey=Ctrl+Alt+F3\n" };
+    for (const char* text : spaced) {
+        loop.Write(text);
+        loop.AdvanceTo(loop.Now() + 2000);
+    }
+    passed = loop.reloads == 5 && loop.registrations == 4 && loop.Shortcuts().globalHotkey == Chord("Ctrl+Alt+F3");
+    Check("spaced_saves", passed, std::to_string(loop.reloads - 2) + " reload(s), " + std::to_string(loop.registrations - 1) +
+        " registration(s)");
+
+    // A bad edit keeps the binding in use rather than the default; a missing setting goes back to its default
+    loop.Write("GlobalHotkey=Ctrl+Alt+F3\nToggleInvertKey=J\nWarmerKey=Shift+F4\n");
+    loop.AdvanceTo(loop.Now() + 2000);
+    loop.Write("GlobalHotkey=Ctrl+Alt+\nToggleInvertKey=Banana\nToggleGrayscaleKey=J\n");
+    loop.AdvanceTo(loop.Now() + 2000);
+    passed = loop.reloads == 7 && loop.registrations == 4 && loop.Shortcuts().globalHotkey == Chord("Ctrl+Alt+F3") &&
+        loop.Shortcuts().toggleInvert == Chord("J") && loop.Shortcuts().toggleGrayscale == ShortcutConfig().toggleGrayscale &&
+        loop.Shortcuts().warmer == ShortcutConfig().warmer;
+    Check("reload_keeps_current_binding", passed, "hotkey " + FormatKeyChord(loop.Shortcuts().globalHotkey) + ", invert " +
+        FormatKeyChord(loop.Shortcuts().toggleInvert) + ", grayscale " + FormatKeyChord(loop.Shortcuts().toggleGrayscale) +
+        ", warmer " + FormatKeyChord(loop.Shortcuts().warmer));
+
+    std::error_code error;
+    std::filesystem::remove(path, error);
+}
+
+}
+
+int RunShortcutConfigChecks(const std::vector<std::string>& arguments) {
+    int writes = 30;
+
+    for (const std::string& argument : arguments) {
+        size_t equals = argument.find('=');
+        std::string name = argument.substr(0, equals);
+        std::string value = equals == std::string::npos ? "" : argument.substr(equals + 1);
+
+        bool valid = true;
+        if (name == "--shortcut-config")
+            continue;
+        else if (name == "--writes")
+            valid = sscanf(value.c_str(), "%d", &writes) == 1 && writes > 0;
+        else
+            valid = false;
+
+        if (!valid) {
+            fprintf(stderr, "Invalid argument: %s\n", argument.c_str());
+            return 2;
+        }
+    }
+
+    ResetChecks();
+    CheckParsing();
+    CheckReloadStorm(writes);
+
+    return FinishChecks("shortcut config");
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// screenfilter_bench --shortcut-config [--writes=N]: checks the shortcut configuration. Malformed
+// lines, malformed chords, unknown keys, modifiers and settings, settings given twice, chords
+// reserved for saved rectangles, a global hotkey without modifiers and two actions bound to the
+// same chord must each be reported with their line and leave the previous binding in place,
+// while everything else in the file still applies. With the watcher polled on a fake clock as
+// the application does, N rapid saves of shortcuts.txt (default 30) must collapse into one
+// reload and one re-registration of the global hotkey; a storm that ends where it started must
+// reload without re-registering; and saves further apart than the settle time must each reload.
+// Returns the process exit code: 0 if every check passes.
+int RunShortcutConfigChecks(const std::vector<std::string>& arguments);
@@ -0,0 +1,405 @@
+#include "SmartInversion.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <random>
+#include "BenchChecks.h"
+#include "ColorEffects.h"
+#include "PixelImage.h"
+#include "SmartInvert.h"
+#include "SyntheticDesktop.h"
+#include "WorkerPool.h"
+
+namespace {
+
+// What a region of a labeled screenshot holds; only pages should be inverted
+enum Content {
+    CONTENT_PAGE,
+    CONTENT_PHOTO,
+    CONTENT_GRAY_PHOTO,
+    CONTENT_VIDEO,
+    CONTENT_DARK_PANEL,
+    CONTENT_COUNT
+};
+
+const char* const contentNames[CONTENT_COUNT] = { "page", "photo", "gray photo", "video", "dark panel" };
+
+// A synthetic screenshot and the content of each tile, row by row; -1 where a tile holds more
+// than one kind
+struct LabeledScreenshot {
+    PixelImage image;
+    std::vector<int> tiles;
+};
+
+uint32_t Hash(uint32_t a, uint32_t b, uint32_t c) {
+    uint32_t h = a * 0x9E3779B1u ^ b * 0x85EBCA77u ^ c * 0xC2B2AE3Du;
+    h ^= h >> 15;
+    h *= 0x2C1B3C6Du;
+    h ^= h >> 12;
+    return h;
+}
+
+uint32_t PackPixel(double red, double green, double blue) {
+    auto channel = [](double value) { return static_cast<uint32_t>((std::min)((std::max)(value, 0.0), 255.0)); };
+    return 0xFF000000u | (channel(red) << 16) | (channel(green) << 8) | channel(blue);
+}
+
+// Stand-in for a photo: soft waves of light and color over fine grain, so tiles hold continuous
+// tone at every scale. The seed also sets the exposure, from dark to washed out.
+uint32_t PhotoPixel(int x, int y, uint32_t seed, bool color) {
+    double phase = seed * 1.7;
+    double shade = 105.0 + 25.0 * (seed % 4) + 55.0 * std::sin(x / 41.0 + phase) * std::cos(y / 29.0 - phase) +
+        35.0 * std::sin((x + 2 * y) / 13.0 + phase) + static_cast<double>(Hash(static_cast<uint32_t>(x), static_cast<uint32_t>(y), seed) % 33) - 16.0;
+    if (!color)
+        return PackPixel(shade, shade, shade);
+    double hue = x / 83.0 + y / 97.0 + phase;
+    return PackPixel(shade + 70.0 * std::sin(hue), shade + 70.0 * std::sin(hue + 2.1), shade + 70.0 * std::sin(hue + 4.2));
+}
+
+// Moving gradients plus noise, like SyntheticDesktop's video
+uint32_t VideoPixel(int x, int y, uint32_t seed) {
+    return 0xFF000000u | ((static_cast<uint32_t>(x) & 0xFF) << 16) | ((static_cast<uint32_t>(y) & 0xFF) << 8) |
+        (96 + (Hash(static_cast<uint32_t>(x), static_cast<uint32_t>(y), seed) & 0x3F));
+}
+
+// [1 2 1] / 4 across and down, the gray edges anti-aliasing gives text
+void SoftenImage(PixelImage& image) {
+    PixelImage source = image;
+    for (int y = 0; y < image.height; y++) {
+        for (int x = 0; x < image.width; x++) {
+            uint32_t result = 0xFF000000u;
+            for (int shift = 0; shift < 24; shift += 8) {
+                int sum = 0;
+                for (int dy = -1; dy <= 1; dy++) {
+                    for (int dx = -1; dx <= 1; dx++) {
+                        int sx = (std::min)((std::max)(x + dx, 0), image.width - 1);
+                        int sy = (std::min)((std::max)(y + dy, 0), image.height - 1);
+                        sum += static_cast<int>((source.At(sx, sy) >> shift) & 0xFF) * (2 - (dx != 0)) * (2 - (dy != 0));
+                    }
+                }
+                result |= static_cast<uint32_t>((sum + 8) / 16) << shift;
+            }
+            image.At(x, y) = result;
+        }
+    }
+}
+
+// A page of text, anti-aliased for odd seeds, with a photo, a gray photo, video and a dark-mode
+// panel of text laid over it at random
+LabeledScreenshot MakeScreenshot(int width, int height, uint32_t seed) {
+    std::mt19937 random(seed);
+    LabeledScreenshot screenshot;
+    SyntheticDesktop(width, height, SCENARIO_STATIC_DOCUMENT, seed).Render(0, screenshot.image);
+    if (seed % 2 == 1)
+        SoftenImage(screenshot.image);
+    PixelImage darkPage;
+    SyntheticDesktop(width, height, SCENARIO_THEME_SWITCH, seed).Render(120, darkPage);
+
+    std::vector<uint8_t> contents(screenshot.image.pixels.size(), CONTENT_PAGE);
+    for (int content = CONTENT_PHOTO; content < CONTENT_COUNT; content++) {
+        int regionWidth = width / 8 + static_cast<int>(random() % (width / 4));
+        int regionHeight = height / 8 + static_cast<int>(random() % (height / 4));
+        int left = static_cast<int>(random() % (width - regionWidth));
+        int top = static_cast<int>(random() % (height - regionHeight));
+        for (int y = top; y < top + regionHeight; y++) {
+            for (int x = left; x < left + regionWidth; x++) {
+                uint32_t& pixel = screenshot.image.At(x, y);
+                if (content == CONTENT_PHOTO || content == CONTENT_GRAY_PHOTO)
+                    pixel = PhotoPixel(x, y, seed, content == CONTENT_PHOTO);
+                else if (content == CONTENT_VIDEO)
+                    pixel = VideoPixel(x, y, seed);
+                else
+                    pixel = darkPage.At(x, y);
+                contents[static_cast<size_t>(y) * width + x] = static_cast<uint8_t>(content);
+            }
+        }
+    }
+
+    int tilesAcross = (width + SMART_INVERT_TILE - 1) / SMART_INVERT_TILE;
+    int tilesDown = (height + SMART_INVERT_TILE - 1) / SMART_INVERT_TILE;
+    for (int tileY = 0; tileY < tilesDown; tileY++) {
+        for (int tileX = 0; tileX < tilesAcross; tileX++) {
+            int label = contents[static_cast<size_t>(tileY * SMART_INVERT_TILE) * width + tileX * SMART_INVERT_TILE];
+            for (int y = tileY * SMART_INVERT_TILE; y < (std::min)((tileY + 1) * SMART_INVERT_TILE, height); y++) {
+                for (int x = tileX * SMART_INVERT_TILE; x < (std::min)((tileX + 1) * SMART_INVERT_TILE, width); x++) {
+                    if (contents[static_cast<size_t>(y) * width + x] != label)
+                        label = -1;
+                }
+            }
+            screenshot.tiles.push_back(label);
+        }
+    }
+    return screenshot;
+}
+
+// The statistics summed directly
+TileStatistics ReferenceStatistics(const PixelImage& image, int x0, int y0, int columns, int rows) {
+    TileStatistics stats;
+    memset(&stats, 0, sizeof(stats));
+    for (int y = y0; y < y0 + rows; y++) {
+        for (int x = x0; x < x0 + columns; x++) {
+            uint32_t pixel = image.At(x, y);
+            int channels[3] = { static_cast<int>(pixel & 0xFF), static_cast<int>((pixel >> 8) & 0xFF), static_cast<int>((pixel >> 16) & 0xFF) };
+            int luma = PixelLuma(pixel);
+            stats.pixels++;
+            stats.lumaSum += luma;
+            stats.lumaSquares += luma * luma;
+            stats.saturationSum += *std::max_element(channels, channels + 3) - *std::min_element(channels, channels + 3);
+            stats.midtones += luma >= SMART_INVERT_MIDTONE_LOW && luma < SMART_INVERT_MIDTONE_HIGH;
+        }
+    }
+    return stats;
+}
+
+// Weight of a tile boundary interpolated to 'position' half pixels past the first center, as
+// SmartInvertImage() does it, but one pixel at a time
+void InterpolationPoint(int position, int tiles, int& first, int& second, int& along) {
+    first = position < 0 ? 0 : (std::min)(position / (2 * SMART_INVERT_TILE), tiles - 1);
+    second = (std::min)(first + 1, tiles - 1);
+    along = position < 0 || first == second ? 0 : position - first * 2 * SMART_INVERT_TILE;
+}
+
+int Interpolate(int from, int to, int along) {
+    return (from * 2 * SMART_INVERT_TILE + (to - from) * along + SMART_INVERT_TILE) / (2 * SMART_INVERT_TILE);
+}
+
+// SmartInvertImage() pixel by pixel from the tile classes
+PixelImage ReferenceSmartInvert(const PixelImage& source) {
+    std::vector<uint8_t> classes;
+    ClassifyTiles(PIXEL_KERNEL_SCALAR, source.pixels.data(), source.width, source.height, classes, NULL);
+    int tilesAcross = (source.width + SMART_INVERT_TILE - 1) / SMART_INVERT_TILE;
+    int tilesDown = (source.height + SMART_INVERT_TILE - 1) / SMART_INVERT_TILE;
+    auto weight = [&](int tileX, int tileY) { return classes[static_cast<size_t>(tileY) * tilesAcross + tileX] == TILE_TEXT ? 256 : 0; };
+
+    PixelImage result(source.width, source.height);
+    for (int y = 0; y < source.height; y++) {
+        int above, below, down;
+        InterpolationPoint(2 * y + 1 - SMART_INVERT_TILE, tilesDown, above, below, down);
+        for (int x = 0; x < source.width; x++) {
+            int left, right, across;
+            InterpolationPoint(2 * x + 1 - SMART_INVERT_TILE, tilesAcross, left, right, across);
+            int w = Interpolate(Interpolate(weight(left, above), weight(left, below), down),
+                Interpolate(weight(right, above), weight(right, below), down), across);
+            uint32_t pixel = source.At(x, y);
+            uint32_t blended = pixel & 0xFF000000u;
+            for (int shift = 0; shift < 24; shift += 8) {
+                int value = (pixel >> shift) & 0xFF;
+                blended |= static_cast<uint32_t>((value * (256 - w) + (255 - value) * w + 128) / 256) << shift;
+            }
+            result.At(x, y) = blended;
+        }
+    }
+    return result;
+}
+
+}
+
+void RegisterSmartInvertBenchmarks(BenchSuite& suite) {
+    for (int index = 0; index < PIXEL_KERNEL_COUNT; index++) {
+        PixelKernel kernel = static_cast<PixelKernel>(index);
+        if (!IsPixelKernelAvailable(kernel) || kernel == PIXEL_KERNEL_LUT)
+            continue;
+        suite.Add(std::string("tile_classify/") + PixelKernelName(kernel) + "/3840x2160", 3840.0 * 2160.0, [kernel] {
+            std::shared_ptr<PixelImage> source = std::make_shared<PixelImage>(MakeScreenshot(3840, 2160, 2).image);
+            return BenchBody([kernel, source](uint64_t iterations) {
+                std::vector<uint8_t> classes;
+                for (uint64_t i = 0; i < iterations; i++) {
+                    ClassifyTiles(kernel, source->pixels.data(), source->width, source->height, classes, NULL);
+                    BenchDoNotOptimize(classes[0]);
+                }
+            });
+        });
+        suite.Add(std::string("smart_invert/") + PixelKernelName(kernel) + "/3840x2160", 3840.0 * 2160.0, [kernel] {
+            std::shared_ptr<PixelImage> source = std::make_shared<PixelImage>(MakeScreenshot(3840, 2160, 2).image);
+            std::shared_ptr<PixelImage> target = std::make_shared<PixelImage>(3840, 2160);
+            return BenchBody([kernel, source, target](uint64_t iterations) {
+                for (uint64_t i = 0; i < iterations; i++) {
+                    SmartInvertImage(kernel, source->pixels.data(), target->pixels.data(), source->width, source->height, NULL);
+                    BenchDoNotOptimize(target->pixels[0]);
+                }
+            });
+        });
+    }
+}
+
+int RunSmartInvertChecks(const std::vector<std::string>& arguments) {
+    double maxError = 5.0;
+    double maxRatio = 2.5;
+    double budgetMs = 0.0;
+    int threads = 0;
+
+    for (const std::string& argument : arguments) {
+        size_t equals = argument.find('=');
+        std::string name = argument.substr(0, equals);
+        std::string value = equals == std::string::npos ? "" : argument.substr(equals + 1);
+
+        bool valid = true;
+        if (name == "--smart-invert")
+            continue;
+        else if (name == "--max-error")
+            valid = sscanf(value.c_str(), "%lf", &maxError) == 1 && maxError >= 0.0;
+        else if (name == "--max-ratio")
+            valid = sscanf(value.c_str(), "%lf", &maxRatio) == 1 && maxRatio > 0.0;
+        else if (name == "--budget-ms")
+            valid = sscanf(value.c_str(), "%lf", &budgetMs) == 1 && budgetMs > 0.0;
+        else if (name == "--threads")
+            valid = sscanf(value.c_str(), "%d", &threads) == 1 && threads > 0;
+        else
+            valid = false;
+
+        if (!valid) {
+            fprintf(stderr, "Invalid argument: %s\n", argument.c_str());
+            return 2;
+        }
+    }
+
+    ResetChecks();
+    char detail[300];
+    WorkerPool pool(threads);
+
+    // Widths that leave partial vectors, down to single pixels
+    {
+        PixelImage source = TestImage(100, 80, 1);
+        const struct { int x0; int y0; int columns; int rows; } tiles[] = {
+            { 0, 0, 32, 32 }, { 3, 5, 31, 32 }, { 50, 40, 13, 7 }, { 99, 79, 1, 1 }, { 1, 1, 8, 3 }, { 60, 10, 5, 32 }, { 20, 70, 32, 10 }
+        };
+        MismatchList mismatches;
+        for (const auto& tile : tiles) {
+            TileStatistics expected = ReferenceStatistics(source, tile.x0, tile.y0, tile.columns, tile.rows);
+            for (int kernel = 0; kernel < PIXEL_KERNEL_COUNT; kernel++) {
+                if (!IsPixelKernelAvailable(static_cast<PixelKernel>(kernel)))
+                    continue;
+                TileStatistics actual;
+                ComputeTileStatistics(static_cast<PixelKernel>(kernel), source.pixels.data(), source.width, tile.x0, tile.y0, tile.columns,
+                    tile.rows, actual);
+                mismatches.Compare(memcmp(&actual, &expected, sizeof(actual)) == 0, "%s/%dx%d", PixelKernelName(static_cast<PixelKernel>(kernel)),
+                    tile.columns, tile.rows);
+            }
+        }
+        Check("statistics_match_reference", mismatches.Empty(), mismatches.Describe("tiles"));
+    }
+
+    // A screenshot cut to sizes that leave partial tiles, and smaller than one tile; the fades
+    // against a per-pixel reference, in place, and on the pool
+    {
+        LabeledScreenshot screenshot = MakeScreenshot(1280, 720, 3);
+        const struct { int width; int height; } sizes[] = { { 517, 301 }, { 1280, 720 }, { 20, 9 }, { 1, 1 } };
+        MismatchList mismatches;
+        for (const auto& size : sizes) {
+            PixelImage source(size.width, size.height);
+            for (int y = 0; y < size.height; y++) {
+                for (int x = 0; x < size.width; x++)
+                    source.At(x, y) = screenshot.image.At(x + 200, y + 100);
+            }
+            PixelImage expected = ReferenceSmartInvert(source);
+            for (int kernel = 0; kernel < PIXEL_KERNEL_COUNT; kernel++) {
+                if (!IsPixelKernelAvailable(static_cast<PixelKernel>(kernel)))
+                    continue;
+                for (int variant = 0; variant < 3; variant++) {
+                    PixelImage actual = variant == 1 ? source : PixelImage(size.width, size.height);
+                    const uint32_t* input = variant == 1 ? actual.pixels.data() : source.pixels.data();
+                    SmartInvertImage(static_cast<PixelKernel>(kernel), input, actual.pixels.data(), size.width, size.height,
+                        variant == 2 ? &pool : NULL);
+                    static const char* const variants[] = { "", "/in-place", "/pool" };
+                    mismatches.Compare(actual.pixels == expected.pixels, "%s%s/%dx%d", PixelKernelName(static_cast<PixelKernel>(kernel)),
+                        variants[variant], size.width, size.height);
+                }
+            }
+        }
+        Check("matches_reference", mismatches.Empty(), std::to_string(pool.GetThreads()) + " thread(s), " + mismatches.Describe("runs"));
+    }
+
+    // Only pages should be inverted: a wrong decision is a page left bright or anything else turned
+    // inside out. Tiles on the border of two kinds of content are not counted.
+    {
+        int counted[CONTENT_COUNT] = {};
+        int wrong[CONTENT_COUNT] = {};
+        for (uint32_t seed = 1; seed <= 8; seed++) {
+            LabeledScreenshot screenshot = MakeScreenshot(1280, 720, seed);
+            std::vector<uint8_t> classes;
+            ClassifyTiles(BestPixelKernel(), screenshot.image.pixels.data(), screenshot.image.width, screenshot.image.height, classes, &pool);
+            for (size_t tile = 0; tile < classes.size(); tile++) {
+                int content = screenshot.tiles[tile];
+                if (content < 0)
+                    continue;
+                counted[content]++;
+                if ((classes[tile] == TILE_TEXT) != (content == CONTENT_PAGE))
+                    wrong[content]++;
+            }
+        }
+
+        std::string rates;
+        int totalCounted = 0;
+        int totalWrong = 0;
+        for (int content = 0; content < CONTENT_COUNT; content++) {
+            char rate[64];
+            snprintf(rate, sizeof(rate), "%s%s %.1f%% of %d", content == 0 ? "" : ", ", contentNames[content],
+                counted[content] == 0 ? 0.0 : 100.0 * wrong[content] / counted[content], counted[content]);
+            rates += rate;
+            totalCounted += counted[content];
+            totalWrong += wrong[content];
+        }
+        double errorRate = 100.0 * totalWrong / (std::max)(totalCounted, 1);
+        snprintf(detail, sizeof(detail), "%.2f%% wrong; %s", errorRate, rates.c_str());
+        Check("labeled_screenshots", errorRate < maxError, detail);
+    }
+
+    // A white page beside a flat blue panel: inverted, the page turns black, and the fade to the
+    // panel spreads over a tile
+    {
+        PixelImage source(8 * SMART_INVERT_TILE, 2 * SMART_INVERT_TILE);
+        for (int y = 0; y < source.height; y++) {
+            for (int x = 0; x < source.width; x++)
+                source.At(x, y) = x < source.width / 2 ? 0xFFFFFFFFu : 0xFF2080E0u;
+        }
+        PixelImage result(source.width, source.height);
+        SmartInvertImage(BestPixelKernel(), source.pixels.data(), result.pixels.data(), source.width, source.height, NULL);
+        int largestStep = 0;
+        for (int x = 1; x < result.width; x++) {
+            for (int shift = 0; shift < 24; shift += 8) {
+                int step = std::abs(static_cast<int>((result.At(x, 0) >> shift) & 0xFF) - static_cast<int>((result.At(x - 1, 0) >> shift) & 0xFF));
+                largestStep = (std::max)(largestStep, step);
+            }
+        }
+        int hardEdge = 0;
+        for (int shift = 0; shift < 24; shift += 8)
+            hardEdge = (std::max)(hardEdge, std::abs(static_cast<int>((0xFF2080E0u >> shift) & 0xFF) - 0));
+        int allowed = (255 + SMART_INVERT_TILE - 1) / SMART_INVERT_TILE + 1;
+        bool inverted = result.At(0, 0) == 0xFF000000u && result.At(result.width - 1, 0) == 0xFF2080E0u;
+        snprintf(detail, sizeof(detail), "largest step between neighbors %d (at most %d; a hard edge would be %d)%s", largestStep, allowed,
+            hardEdge, inverted ? "" : "; the page or the panel is wrong");
+        Check("no_seams", inverted && largestStep <= allowed, detail);
+    }
+
+    // What the stage adds to a 4K frame on the pool, measured against the colour matrix pass
+    // every CPU frame already pays. Both stream the whole frame through memory, so the ratio
+    // holds from machine to machine where a time does not; the absolute budget is only checked
+    // when one is given.
+    {
+        LabeledScreenshot screenshot = MakeScreenshot(3840, 2160, 2);
+        PixelImage result(screenshot.image.width, screenshot.image.height);
+        ColorEffectSettings settings;
+        settings.grayscaleEnabled = true;
+        ColorMatrix matrix;
+        CalculateColorMatrix(settings, matrix);
+
+        PairedCost cost = MeasurePairs([&] {
+            ApplyColorMatrix(BestPixelKernel(), matrix, screenshot.image.pixels.data(), result.pixels.data(), result.pixels.size());
+        }, [&] {
+            SmartInvertImage(BestPixelKernel(), screenshot.image.pixels.data(), result.pixels.data(), result.width, result.height, &pool);
+        }, 21);
+        double ms = cost.measuredMs, ratio = cost.ratio;
+
+        snprintf(detail, sizeof(detail), "%s, %d thread(s): %.2f ms for 3840x2160, %.2f matrix passes, at most %.1f",
+            PixelKernelName(BestPixelKernel()), pool.GetThreads(), ms, ratio, maxRatio);
+        Check("frame_cost", ratio <= maxRatio, detail);
+        if (budgetMs > 0.0) {
+            snprintf(detail, sizeof(detail), "%.2f ms, budget %.1f ms", ms, budgetMs);
+            Check("frame_budget", ms < budgetMs, detail);
+        }
+    }
+
+    return FinishChecks("smart invert");
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "BenchHarness.h"
+
+// tile_classify/<kernel>/3840x2160: ClassifyTiles over a 4K screenshot of text, photos, video
+// and dark panels. smart_invert/<kernel>/3840x2160: SmartInvertImage over the same, with the
+// fades, on one thread.
+void RegisterSmartInvertBenchmarks(BenchSuite& suite);
+
+// screenfilter_bench --smart-invert [--max-error=X] [--max-ratio=X] [--budget-ms=N] [--threads=N]:
+// checks the smart inversion. Every kernel's tile statistics must be exactly the direct sums, at tile
+// sizes that leave partial vectors, and every kernel and thread count must invert a screenshot
+// to the same pixels; over a labeled set of synthetic screenshots, pages of text (some
+// anti-aliased) with color and gray photos, video and dark panels on them, the share of tiles
+// whose inversion is decided wrongly must be under X percent (default 5), reported per label;
+// the fade between an inverted and a spared tile must have no step larger than a tile's share
+// of the full range; and a 4K frame on the pool must cost at most X (default 2.5) times a
+// colour matrix pass over it, and with --budget-ms take under N ms. Returns the process exit
+// code: 0 if every check passes.
+int RunSmartInvertChecks(const std::vector<std::string>& arguments);
@@ -0,0 +1,278 @@
+#include "StartupPhases.h"
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <random>
+#include <thread>
+#include "BenchChecks.h"
+#include "MonitorLayout.h"
+#include "SavedRectanglesManager.h"
+#include "SessionSnapshot.h"
+#include "ShortcutConfig.h"
+#include "StartupProfiler.h"
+
+namespace {
+
+struct StartupOptions {
+    int regions = 8;
+    int repetitions = 20;
+    int mainMs = 10;
+    std::string writePath;
+};
+
+// Phase names of ScreenInversion.cpp, in the order a serial startup runs them
+const char* const phaseNames[] = {
+    "LoadShortcutConfig", "LoadSavedRectangles", "LoadSession", "MainThreadSetup", "WaitForBackgroundInit", "ResolveLayout"
+};
+
+MonitorDesc MakeMonitor(const char* name, LONG left, LONG top, LONG width, LONG height, bool primary) {
+    MonitorDesc monitor;
+    monitor.deviceName = name;
+    monitor.bounds = { left, top, left + width, top + height };
+    monitor.isPrimary = primary;
+    return monitor;
+}
+
+std::vector<MonitorDesc> Monitors() {
+    return {
+        MakeMonitor("\\\\.\\DISPLAY1", 0, 0, 2560, 1440, true),
+        MakeMonitor("\\\\.\\DISPLAY2", 2560, 0, 1920, 1080, false),
+        MakeMonitor("\\\\.\\DISPLAY3", -1080, -480, 1080, 1920, false),
+        MakeMonitor("\\\\.\\DISPLAY4", 0, 1440, 1920, 1080, false),
+        MakeMonitor("\\\\.\\DISPLAY5", 1920, 1440, 3840, 2160, false),
+        MakeMonitor("\\\\.\\DISPLAY6", 4480, -600, 1280, 1024, false),
+    };
+}
+
+// A rectangle on one of the monitors, with effects set so every field is written
+SavedRectEntry MakeEntry(const MonitorLayout& layout, int index) {
+    const MonitorDesc& monitor = layout.GetMonitors()[index % layout.GetMonitors().size()];
+    SavedRectEntry entry;
+    entry.rect = { monitor.bounds.left + 40 * index, monitor.bounds.top + 30 * index,
+        monitor.bounds.left + 40 * index + 640, monitor.bounds.top + 30 * index + 480 };
+    entry.inversionEnabled = index % 2 == 0;
+    entry.grayscaleEnabled = index % 3 == 0;
+    entry.grayLevel = index % NUM_GRAY_LEVELS;
+    entry.visionMode = index % VISION_MODE_COUNT;
+    entry.colorTemperature = 4500 + 100 * index;
+    entry.binarizeEnabled = index % 4 == 0;
+    entry.isValid = true;
+    entry.hasPlacement = layout.Normalize(entry.rect, entry.placement);
+    return entry;
+}
+
+// The files the application reads at startup, in the current directory
+bool WriteStartupFiles(const StartupOptions& options, const MonitorLayout& layout) {
+    if (!SaveDefaultShortcutConfigFile(ShortcutConfig::CONFIG_FILE))
+        return false;
+
+    SavedRectanglesManager rects;
+    for (int slot = 1; slot < NUM_SAVED_RECTS; slot++)
+        rects.SetEntry(slot, MakeEntry(layout, slot));
+    if (!rects.Save())
+        return false;
+
+    SessionSnapshot session;
+    for (int id = 0; id < options.regions; id++) {
+        SessionRegion region;
+        region.id = id;
+        region.isPinned = id % 2 == 1;
+        region.entry = MakeEntry(layout, id + 3);
+        session.Set(region);
+    }
+    return session.Save();
+}
+
+// What one startup read back, to check against what was written
+struct StartupResult {
+    size_t configErrors;
+    int validSlots;
+    size_t regions;
+    int resolved;
+};
+
+// The startup phases of WinMain() and LoadStartupFiles() that do not need Windows. Overlapped,
+// the files load on a background thread while the main thread sets up, as WinMain() does it;
+// serially they load first. MagInitialize() and SetupScreenFilter() are stood in for by a
+// wait of 'mainMs', much of their time being spent waiting on the system too.
+void RunStartup(StartupProfiler& profiler, bool overlapped, int mainMs, StartupResult& result) {
+    ShortcutConfig shortcuts;
+    std::vector<ConfigError> errors;
+    SavedRectanglesManager rects;
+    SessionSnapshot session;
+    MonitorLayout layout;
+
+    auto loadFiles = [&](bool background) {
+        {
+            StartupPhase phase(profiler, "LoadShortcutConfig", background);
+            LoadShortcutConfigFile(ShortcutConfig::CONFIG_FILE, shortcuts, errors);
+        }
+        {
+            StartupPhase phase(profiler, "LoadSavedRectangles", background);
+            rects.Load();
+        }
+        {
+            StartupPhase phase(profiler, "LoadSession", background);
+            session.Load();
+        }
+    };
+    auto setUp = [&] {
+        StartupPhase phase(profiler, "MainThreadSetup");
+        std::this_thread::sleep_for(std::chrono::milliseconds(mainMs));
+    };
+
+    if (overlapped) {
+        std::thread backgroundInit(loadFiles, true);
+        setUp();
+        StartupPhase phase(profiler, "WaitForBackgroundInit");
+        backgroundInit.join();
+    } else {
+        loadFiles(false);
+        setUp();
+    }
+
+    // The restored region and the slots, as ClaimSessionRegion() and ResolveSavedRectangle() place them
+    result.resolved = 0;
+    {
+        StartupPhase phase(profiler, "ResolveLayout");
+        layout.SetMonitors(Monitors());
+        RECT windowRect;
+        if (!session.GetRegions().empty())
+            result.resolved += layout.Resolve(session.GetRegions().front().entry.placement, &session.GetRegions().front().entry.rect, windowRect);
+        for (int slot = 0; slot < NUM_SAVED_RECTS; slot++) {
+            if (rects.IsValid(slot))
+                result.resolved += layout.Resolve(rects.GetEntry(slot).placement, &rects.GetEntry(slot).rect, windowRect);
+        }
+    }
+    profiler.Mark("Ready");
+
+    result.configErrors = errors.size();
+    result.validSlots = 0;
+    for (int slot = 0; slot < NUM_SAVED_RECTS; slot++)
+        result.validSlots += rects.IsValid(slot);
+    result.regions = session.GetRegions().size();
+}
+
+bool ParseOptions(const std::vector<std::string>& arguments, StartupOptions& options) {
+    for (const std::string& argument : arguments) {
+        size_t equals = argument.find('=');
+        std::string name = argument.substr(0, equals);
+        std::string value = equals == std::string::npos ? "" : argument.substr(equals + 1);
+
+        bool valid = true;
+        if (name == "--startup")
+            continue;
+        else if (name == "--regions")
+            valid = sscanf(value.c_str(), "%d", &options.regions) == 1 && options.regions >= 0 && options.regions <= MAX_SESSION_REGIONS;
+        else if (name == "--repetitions")
+            valid = sscanf(value.c_str(), "%d", &options.repetitions) == 1 && options.repetitions > 0;
+        else if (name == "--main-ms")
+            valid = sscanf(value.c_str(), "%d", &options.mainMs) == 1 && options.mainMs >= 0;
+        else if (name == "--write")
+            valid = !(options.writePath = value).empty();
+        else
+            valid = false;
+
+        if (!valid) {
+            fprintf(stderr, "Invalid argument: %s\n", argument.c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
+}
+
+int RunStartupPhases(const std::vector<std::string>& arguments) {
+    StartupOptions options;
+    if (!ParseOptions(arguments, options))
+        return 2;
+
+    // The application reads its files from the working directory
+    std::error_code error;
+    std::filesystem::path writePath = options.writePath.empty() ? std::filesystem::path() : std::filesystem::absolute(options.writePath);
+    std::filesystem::path previous = std::filesystem::current_path();
+    std::filesystem::path directory = std::filesystem::temp_directory_path() /
+        ("screenfilter_startup_" + std::to_string(std::random_device()()));
+    std::filesystem::create_directories(directory, error);
+    std::filesystem::current_path(directory, error);
+    if (error) {
+        fprintf(stderr, "Could not use %s\n", directory.string().c_str());
+        return 1;
+    }
+
+    MonitorLayout layout;
+    layout.SetMonitors(Monitors());
+    bool written = WriteStartupFiles(options, layout);
+
+    // Serial and overlapped runs alternate, so both see the same file cache and machine load
+    std::map<std::string, std::vector<double>> durations[2];
+    std::vector<double> totals[2];
+    int wrongReads = 0, notOverlapped = 0;
+    for (int run = 0; written && run < 2 * options.repetitions; run++) {
+        bool overlapped = run % 2 == 1;
+        StartupProfiler profiler;
+        StartupResult result;
+        RunStartup(profiler, overlapped, options.mainMs, result);
+        if (result.configErrors != 0 || result.validSlots != NUM_SAVED_RECTS - 1 ||
+            result.regions != static_cast<size_t>(options.regions) || result.resolved != NUM_SAVED_RECTS - 1 + (options.regions > 0))
+            wrongReads++;
+
+        double firstLoadMs = 0.0, setupEndMs = 0.0;
+        for (const StartupProfiler::Phase& phase : profiler.GetPhases()) {
+            if (phase.name == "Ready")
+                totals[overlapped].push_back(phase.startMs);
+            else
+                durations[overlapped][phase.name].push_back(phase.durationMs);
+            if (phase.name == "LoadShortcutConfig")
+                firstLoadMs = phase.startMs;
+            else if (phase.name == "MainThreadSetup")
+                setupEndMs = phase.startMs + phase.durationMs;
+        }
+        // The loading has to start before the main thread is done, or nothing was overlapped
+        if (overlapped && options.mainMs > 0 && firstLoadMs >= setupEndMs)
+            notOverlapped++;
+
+        if (run == 2 * options.repetitions - 1 && !options.writePath.empty()) {
+            std::ofstream file(writePath, std::ios::app);
+            file << "# run restored=" << (options.regions > 0 ? 1 : 0) << "\n";
+            profiler.Write(file);
+        }
+    }
+
+    std::filesystem::current_path(previous, error);
+    std::filesystem::remove_all(directory, error);
+    if (!written) {
+        fprintf(stderr, "Could not write the startup files to %s\n", directory.string().c_str());
+        return 1;
+    }
+
+    printf("Startup phases: %d session region(s), %d saved rectangles, %d ms main thread setup, median of %d runs\n\n",
+        options.regions, NUM_SAVED_RECTS - 1, options.mainMs, options.repetitions);
+    printf("%-24s %10s %10s\n", "phase", "serial ms", "overlap ms");
+    for (const char* name : phaseNames) {
+        printf("%-24s", name);
+        for (int overlapped = 0; overlapped < 2; overlapped++) {
+            if (durations[overlapped].count(name) != 0)
+                printf(" %10.3f", Median(durations[overlapped][name]));
+            else
+                printf(" %10s", "-");
+        }
+        printf("\n");
+    }
+    double serialMs = Median(totals[0]), overlappedMs = Median(totals[1]);
+    printf("%-24s %10.3f %10.3f\n", "total (to Ready)", serialMs, overlappedMs);
+    printf("\nOverlapping saves %.3f ms (%.1f%%)\n", serialMs - overlappedMs, 100.0 * (serialMs - overlappedMs) / serialMs);
+
+    int result = 0;
+    if (wrongReads > 0) {
+        printf("%d run(s) did not read back what was written\n", wrongReads);
+        result = 1;
+    }
+    if (notOverlapped > 0) {
+        printf("%d overlapped run(s) loaded the files only after the main thread setup\n", notOverlapped);
+        result = 1;
+    }
+    return result;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// screenfilter_bench --startup [--regions=N] [--repetitions=N] [--main-ms=N] [--write=PATH]:
+// runs the portable startup phases of the application against files written to a temporary
+// directory: the shortcut config parse, the saved rectangles load, the session snapshot load
+// with N regions (default 8, at most MAX_SESSION_REGIONS) and resolving the restored region
+// and every saved rectangle against a six-monitor layout. Each run is done twice, once loading
+// the files serially and once on a background thread overlapping the main thread's setup, as
+// WinMain() does; MagInitialize and window creation need Windows and are stood in for by a
+// wait of --main-ms (default 10). Reports the median time of each phase over the runs
+// (default 20) and what overlapping saves. --write appends the phases of the last run to
+// PATH in the format of startup_benchmark.txt. Returns the process exit code: 0 if every run
+// read back what was written and every overlapped run started loading before the setup ended.
+int RunStartupPhases(const std::vector<std::string>& arguments);
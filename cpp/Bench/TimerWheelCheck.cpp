@@ -0,0 +1,316 @@
+#include "TimerWheelCheck.h"
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <random>
+#include <utility>
+#include "BenchChecks.h"
+#include "TimerWheel.h"
+
+namespace {
+
+const int64_t frameMs = 16; // timerInterval in ScreenInversion.cpp
+
+// Where a timer's firing is written down
+struct Probe {
+    std::vector<int>* fired;
+    const int64_t* nowMs;
+    std::vector<int64_t>* firedAtMs;
+    int id;
+};
+
+void RecordFire(void* context) {
+    Probe* probe = static_cast<Probe*>(context);
+    probe->fired->push_back(probe->id);
+    if (probe->firedAtMs != NULL)
+        probe->firedAtMs->push_back(*probe->nowMs);
+}
+
+// Fixed cases share a wheel-per-case setup: a clock, the fire log and a pool of probes
+struct Case {
+    TimerWheel wheel;
+    int64_t nowMs;
+    std::vector<int> fired;
+    std::vector<int64_t> firedAtMs;
+    Probe probes[8];
+
+    Case() : wheel(frameMs), nowMs(0) {
+        for (int i = 0; i < 8; i++)
+            probes[i] = { &fired, &nowMs, &firedAtMs, i };
+    }
+
+    TimerHandle Schedule(int probe, int64_t delayMs) { return wheel.Schedule(nowMs, delayMs, RecordFire, &probes[probe]); }
+
+    // Run frames until 'untilMs'; returns how many timers fired
+    size_t RunFrames(int64_t untilMs) {
+        size_t count = 0;
+        while (nowMs + frameMs <= untilMs) {
+            nowMs += frameMs;
+            count += wheel.Advance(nowMs);
+        }
+        return count;
+    }
+};
+
+// A callback that schedules another timer for now
+struct Chain {
+    TimerWheel* wheel;
+    int64_t* nowMs;
+    Probe* next;
+};
+
+void ScheduleNext(void* context) {
+    Chain* chain = static_cast<Chain*>(context);
+    chain->wheel->Schedule(*chain->nowMs, 0, RecordFire, chain->next);
+}
+
+void CheckFixedCases() {
+    {
+        // 2000 ms is a whole number of frames: fires on exactly that frame
+        Case c;
+        c.Schedule(0, 2000);
+        c.RunFrames(5000);
+        Check("due_on_frame", c.firedAtMs.size() == 1 && c.firedAtMs[0] == 2000);
+    }
+    {
+        // Due at 15 ms: rounded up to the 16 ms frame, never down to 0
+        Case c;
+        c.nowMs = 5;
+        c.Schedule(0, 10);
+        c.nowMs = 0;
+        size_t early = c.wheel.Advance(15);
+        c.RunFrames(100);
+        Check("rounded_up_not_early", early == 0 && c.firedAtMs.size() == 1 && c.firedAtMs[0] == 16);
+    }
+    {
+        // Due anywhere within one frame: one Advance() fires them all
+        Case c;
+        for (int i = 0; i < 8; i++)
+            c.Schedule(i, 993 + i * 2);
+        size_t before = c.RunFrames(992);
+        c.nowMs += frameMs;
+        size_t together = c.wheel.Advance(c.nowMs);
+        Check("coalesced_in_one_frame", before == 0 && together == 8 && c.nowMs == 1008);
+    }
+    {
+        // A late frame fires everything due by then, in due order
+        Case c;
+        c.Schedule(0, 3000);
+        c.Schedule(1, 1000);
+        c.Schedule(2, 2000);
+        c.Schedule(3, 9000);
+        size_t fired = c.wheel.Advance(5000);
+        Check("late_frame_in_due_order", fired == 3 && c.fired == std::vector<int>({ 1, 2, 0 }) && c.wheel.GetPendingCount() == 1);
+    }
+    {
+        Case c;
+        TimerHandle handle = c.Schedule(0, 500);
+        bool cancelled = c.wheel.Cancel(handle);
+        bool again = c.wheel.Cancel(handle);
+        c.RunFrames(2000);
+        Check("cancel", cancelled && !again && c.fired.empty() && c.wheel.GetPendingCount() == 0);
+    }
+    {
+        // The cancelled timer's node is reused; its old handle must not reach the new timer
+        Case c;
+        TimerHandle stale = c.Schedule(0, 500);
+        c.wheel.Cancel(stale);
+        TimerHandle current = c.Schedule(1, 500);
+        bool cancelledStale = c.wheel.Cancel(stale);
+        c.RunFrames(1000);
+        Check("stale_handle", !cancelledStale && stale != current && c.fired == std::vector<int>({ 1 }) &&
+            !c.wheel.IsPending(current) && !c.wheel.Cancel(current));
+    }
+    {
+        // Three title messages 500 ms apart: only the last one's reset runs, 2 s after it
+        Case c;
+        TimerHandle reset = 0;
+        for (int message = 0; message < 3; message++) {
+            c.wheel.Reschedule(reset, c.nowMs, 2000, RecordFire, &c.probes[message]);
+            c.RunFrames(c.nowMs + 496);
+        }
+        c.RunFrames(10000);
+        Check("superseded", c.fired == std::vector<int>({ 2 }) && c.firedAtMs[0] == 2992 && c.wheel.GetCancelledCount() == 2);
+    }
+    {
+        // A callback scheduling for now: fires on the next frame, not in the same Advance()
+        Case c;
+        Chain chain = { &c.wheel, &c.nowMs, &c.probes[1] };
+        c.wheel.Schedule(0, 100, ScheduleNext, &chain);
+        c.RunFrames(112);
+        size_t sameFrame = c.fired.size();
+        c.RunFrames(128);
+        Check("callback_schedules", sameFrame == 0 && c.firedAtMs.size() == 1 && c.firedAtMs[0] == 128);
+    }
+    {
+        // An hour reaches the top level and cascades down: fires on its frame, moved at most three times
+        Case c;
+        c.Schedule(0, 3600000);
+        size_t early = c.wheel.Advance(3600000 - frameMs);
+        c.nowMs = 3600000 - frameMs;
+        c.RunFrames(3600000);
+        Check("one_hour", early == 0 && c.firedAtMs.size() == 1 && c.firedAtMs[0] == 3600000 && c.wheel.GetCascadedCount() <= 3);
+    }
+    {
+        // 100 hours is beyond the top level (about 74 hours): parked and re-placed until due
+        Case c;
+        const int64_t dueMs = 100ll * 3600000;
+        c.Schedule(0, dueMs);
+        size_t early = c.wheel.Advance(dueMs - frameMs);
+        c.nowMs = dueMs - frameMs;
+        c.RunFrames(dueMs);
+        Check("beyond_top_level", early == 0 && c.firedAtMs.size() == 1 && c.firedAtMs[0] == dueMs);
+    }
+    {
+        // Nothing pending: a long idle gap costs one step, and new timers count from the present
+        Case c;
+        c.wheel.Advance(1000000);
+        c.nowMs = 1000000;
+        c.Schedule(0, 32);
+        c.RunFrames(1000032);
+        Check("idle_gap", c.firedAtMs.size() == 1 && c.firedAtMs[0] == 1000032);
+    }
+}
+
+// Random schedule, cancel and frame operations against a map of expiry frames. Timers due by a
+// frame must all fire on it, in due order, and no others.
+void CheckRandomOperations(int operations, uint32_t seed) {
+    std::mt19937 random(seed);
+    auto pick = [&random](uint32_t count) { return random() % count; };
+
+    TimerWheel wheel(frameMs);
+    int64_t nowMs = 0;
+    std::vector<int> fired;
+    std::vector<Probe> probes(operations);
+    std::vector<uint64_t> expiryOf(operations);
+    std::vector<std::pair<TimerHandle, int>> handles; // Every timer scheduled, and its id
+    std::map<int, uint64_t> expected;                 // Pending timer ids and their expiry frames
+    uint64_t mismatches = 0, fires = 0;
+
+    for (int i = 0; i < operations; i++) {
+        uint32_t choice = pick(100);
+        if (choice < 45) {
+            // Mostly title-message lengths, some minutes, a few past the second level
+            uint32_t range = pick(20);
+            int64_t delayMs = range < 14 ? pick(1000) : range < 19 ? pick(60000) : pick(5000000);
+            probes[i] = { &fired, &nowMs, NULL, i };
+            handles.push_back(std::make_pair(wheel.Schedule(nowMs, delayMs, RecordFire, &probes[i]), i));
+
+            uint64_t expiry = static_cast<uint64_t>((nowMs + delayMs + frameMs - 1) / frameMs);
+            expiryOf[i] = (std::max)(expiry, static_cast<uint64_t>(nowMs / frameMs) + 1);
+            expected[i] = expiryOf[i];
+        } else if (choice < 65 && !handles.empty()) {
+            // Mostly a recent timer, else any ever scheduled; many have fired or were cancelled already
+            uint32_t count = static_cast<uint32_t>(handles.size());
+            uint32_t back = pick(4) == 0 ? pick(count) : pick((std::min)(count, 64u));
+            const std::pair<TimerHandle, int>& handle = handles[count - 1 - back];
+            bool cancelled = wheel.Cancel(handle.first);
+            if (cancelled != (expected.erase(handle.second) == 1))
+                mismatches++;
+        } else {
+            int frames = 1 + static_cast<int>(pick(10) == 0 ? pick(20000) : pick(100));
+            nowMs += frames * frameMs;
+            fired.clear();
+            wheel.Advance(nowMs);
+            fires += fired.size();
+
+            uint64_t nowFrame = static_cast<uint64_t>(nowMs / frameMs);
+            std::vector<int> due;
+            for (auto entry = expected.begin(); entry != expected.end();) {
+                if (entry->second <= nowFrame) {
+                    due.push_back(entry->first);
+                    entry = expected.erase(entry);
+                } else {
+                    ++entry;
+                }
+            }
+
+            for (size_t j = 1; j < fired.size(); j++) {
+                if (expiryOf[fired[j - 1]] > expiryOf[fired[j]])
+                    mismatches++;
+            }
+            std::sort(fired.begin(), fired.end());
+            if (fired != due)
+                mismatches++;
+        }
+    }
+
+    char name[64];
+    snprintf(name, sizeof(name), "random_%d_operations", operations);
+    Check(name, mismatches == 0 && wheel.GetPendingCount() == expected.size());
+    printf("  %llu fired, %llu cancelled, %llu cascaded, %zu pending, %llu mismatches\n",
+        static_cast<unsigned long long>(fires), static_cast<unsigned long long>(wheel.GetCancelledCount()),
+        static_cast<unsigned long long>(wheel.GetCascadedCount()), wheel.GetPendingCount(),
+        static_cast<unsigned long long>(mismatches));
+}
+
+void CountFire(void* context) {
+    (*static_cast<uint64_t*>(context))++;
+}
+
+}
+
+void RegisterTimerWheelBenchmarks(BenchSuite& suite) {
+    static const int timers = 1000;
+    suite.Add("timer_wheel/schedule_cancel", timers, [] {
+        return BenchBody([](uint64_t iterations) {
+            TimerWheel wheel(frameMs, timers);
+            uint64_t count = 0;
+            TimerHandle handle = 0;
+            for (uint64_t i = 0; i < iterations; i++) {
+                for (int j = 0; j < timers; j++)
+                    wheel.Reschedule(handle, j, 2000, CountFire, &count);
+            }
+            BenchDoNotOptimize(handle);
+        });
+    });
+    suite.Add("timer_wheel/frames", timers, [] {
+        return BenchBody([](uint64_t iterations) {
+            TimerWheel wheel(frameMs, timers);
+            std::mt19937 random(1);
+            uint64_t count = 0;
+            int64_t nowMs = 0;
+            for (uint64_t i = 0; i < iterations; i++) {
+                for (int j = 0; j < timers; j++)
+                    wheel.Schedule(nowMs, random() % 10000, CountFire, &count);
+                while (wheel.GetPendingCount() > 0) {
+                    nowMs += frameMs;
+                    wheel.Advance(nowMs);
+                }
+            }
+            BenchDoNotOptimize(count);
+        });
+    });
+}
+
+int RunTimerWheelChecks(const std::vector<std::string>& arguments) {
+    int operations = 100000;
+    uint32_t seed = 1;
+
+    for (const std::string& argument : arguments) {
+        size_t equals = argument.find('=');
+        std::string name = argument.substr(0, equals);
+        std::string value = equals == std::string::npos ? "" : argument.substr(equals + 1);
+
+        bool valid = true;
+        if (name == "--timer-wheel")
+            continue;
+        else if (name == "--operations")
+            valid = sscanf(value.c_str(), "%d", &operations) == 1 && operations > 0;
+        else if (name == "--seed")
+            valid = sscanf(value.c_str(), "%u", &seed) == 1;
+        else
+            valid = false;
+
+        if (!valid) {
+            fprintf(stderr, "Invalid argument: %s\n", argument.c_str());
+            return 2;
+        }
+    }
+
+    ResetChecks();
+    CheckFixedCases();
+    CheckRandomOperations(operations, seed);
+
+    return FinishChecks("timer wheel");
+}
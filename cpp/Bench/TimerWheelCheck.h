@@ -0,0 +1,16 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "BenchHarness.h"
+
+// timer_wheel/schedule_cancel: 1000 timers scheduled and cancelled again (title messages
+// superseding each other); timer_wheel/frames: 1000 timers over up to 10 s of 16 ms frames
+void RegisterTimerWheelBenchmarks(BenchSuite& suite);
+
+// screenfilter_bench --timer-wheel [--operations=N] [--seed=N]: checks TimerWheel on a fake
+// clock. Fixed cases cover due times, rounding, coalescing, cancelling, superseding, stale
+// handles, callbacks that schedule and delays beyond the top level; then N random schedule,
+// cancel and frame operations (default 100000) are checked against a sorted reference.
+// Returns the process exit code: 0 if every check passes.
+int RunTimerWheelChecks(const std::vector<std::string>& arguments);
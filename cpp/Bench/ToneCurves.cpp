@@ -0,0 +1,300 @@
+#include "ToneCurves.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <random>
+#include <sstream>
+#include "BenchChecks.h"
+#include "PixelImage.h"
+#include "PixelKernels.h"
+#include "ToneCurve.h"
+
+namespace {
+
+// A curve of the kind low-vision users ask for: black and white points pulled in, mid tones
+// adjusted and contrast raised, slightly different per channel so the channels cannot be mixed up
+void TestParameters(ToneCurveParameters parameters[3]) {
+    parameters[0].blackPoint = 0.05f;
+    parameters[0].whitePoint = 0.95f;
+    parameters[0].gamma = 1.2f;
+    parameters[0].contrast = 2.0f;
+    parameters[1].blackPoint = 0.1f;
+    parameters[1].whitePoint = 0.9f;
+    parameters[1].gamma = 0.8f;
+    parameters[1].contrast = 2.5f;
+    parameters[2].gamma = 0.9f;
+    parameters[2].contrast = 1.5f;
+}
+
+ToneCurve TestCurve() {
+    ToneCurveParameters parameters[3];
+    TestParameters(parameters);
+    ToneCurve curve;
+    GenerateToneCurve(parameters[0], parameters[1], parameters[2], curve);
+    return curve;
+}
+
+ColorMatrix InvertedMatrix() {
+    ColorEffectSettings settings;
+    settings.inversionEnabled = true;
+    settings.grayLevel = 1;
+    ColorMatrix matrix;
+    CalculateColorMatrix(settings, matrix);
+    return matrix;
+}
+
+PixelImage RandomImage(int width, int height, unsigned seed) {
+    std::mt19937 random(seed);
+    PixelImage image(width, height);
+    for (uint32_t& pixel : image.pixels)
+        pixel = random() | 0xFF000000u;
+    return image;
+}
+
+// Largest difference from the exact curve over the matrix output in double precision, in levels
+double LargestCurveError(const ColorMatrix& matrix, const ToneCurveParameters parameters[3], const PixelImage& source, const PixelImage& output) {
+    double worst = 0.0;
+    for (size_t i = 0; i < source.pixels.size(); i++) {
+        uint32_t pixel = source.pixels[i];
+        for (int channel = 0; channel < 3; channel++) {
+            double value = ((pixel >> 16) & 0xFF) * static_cast<double>(matrix.transform[0][channel]) +
+                ((pixel >> 8) & 0xFF) * static_cast<double>(matrix.transform[1][channel]) +
+                (pixel & 0xFF) * static_cast<double>(matrix.transform[2][channel]) + 255.0 * matrix.transform[4][channel];
+            value = (std::min)(255.0, (std::max)(0.0, value));
+            double exact = 255.0 * EvaluateToneCurve(parameters[channel], value / 255.0);
+            double actual = static_cast<double>((output.pixels[i] >> (16 - 8 * channel)) & 0xFF);
+            worst = (std::max)(worst, std::fabs(actual - exact));
+        }
+    }
+    return worst;
+}
+
+}
+
+void RegisterToneCurveBenchmarks(BenchSuite& suite) {
+    const struct { const char* name; int width; int height; } sizes[] = {
+        { "1920x1080", 1920, 1080 }, { "3840x2160", 3840, 2160 }
+    };
+    for (int kernel = 0; kernel < PIXEL_KERNEL_COUNT; kernel++) {
+        // LUT runs the scalar kernel when fused
+        if (!IsPixelKernelAvailable(static_cast<PixelKernel>(kernel)) || kernel == PIXEL_KERNEL_LUT)
+            continue;
+        for (const auto& size : sizes) {
+            for (int fused = 1; fused >= 0; fused--) {
+                int width = size.width, height = size.height;
+                suite.Add(std::string("tone_curve/") + PixelKernelName(static_cast<PixelKernel>(kernel)) + "/" + size.name +
+                    (fused ? "/fused" : "/two_pass"), static_cast<double>(width) * height, [kernel, width, height, fused] {
+                    std::shared_ptr<PixelImage> source = std::make_shared<PixelImage>(RandomImage(width, height, 1));
+                    std::shared_ptr<PixelImage> target = std::make_shared<PixelImage>(width, height);
+                    std::shared_ptr<ToneCurve> curve = std::make_shared<ToneCurve>(TestCurve());
+                    ColorMatrix matrix = InvertedMatrix();
+
+                    return BenchBody([kernel, source, target, curve, matrix, fused](uint64_t iterations) {
+                        for (uint64_t i = 0; i < iterations; i++) {
+                            if (fused) {
+                                ApplyColorMatrixAndCurve(static_cast<PixelKernel>(kernel), matrix, *curve, source->pixels.data(),
+                                    target->pixels.data(), source->width, source->height, false);
+                            } else {
+                                ApplyColorMatrix(static_cast<PixelKernel>(kernel), matrix, source->pixels.data(), target->pixels.data(),
+                                    source->pixels.size());
+                                ApplyToneCurve(*curve, target->pixels.data(), target->pixels.data(), target->pixels.size());
+                            }
+                            BenchDoNotOptimize(target->pixels[0]);
+                        }
+                    });
+                });
+            }
+        }
+    }
+}
+
+int RunToneCurveChecks(const std::vector<std::string>& arguments) {
+    double minSpeedup = 1.0;
+
+    for (const std::string& argument : arguments) {
+        size_t equals = argument.find('=');
+        std::string name = argument.substr(0, equals);
+        std::string value = equals == std::string::npos ? "" : argument.substr(equals + 1);
+
+        bool valid = true;
+        if (name == "--tone-curve")
+            continue;
+        else if (name == "--min-speedup")
+            valid = sscanf(value.c_str(), "%lf", &minSpeedup) == 1 && minSpeedup > 0.0;
+        else
+            valid = false;
+
+        if (!valid) {
+            fprintf(stderr, "Invalid argument: %s\n", argument.c_str());
+            return 2;
+        }
+    }
+
+    ResetChecks();
+    char detail[160];
+    ToneCurveParameters parameters[3];
+    TestParameters(parameters);
+    ToneCurve curve = TestCurve();
+    ColorMatrix matrix = InvertedMatrix();
+
+    // Each parameter does what its comment says
+    {
+        const char* problem = NULL;
+        ToneCurveParameters levels, gamma, contrast;
+        levels.blackPoint = 0.2f;
+        levels.whitePoint = 0.8f;
+        gamma.gamma = 2.0f;
+        contrast.contrast = 3.0f;
+        double slope = (EvaluateToneCurve(contrast, 0.5001) - EvaluateToneCurve(contrast, 0.4999)) / 0.0002;
+        if (EvaluateToneCurve(ToneCurveParameters(), 0.3) != 0.3)
+            problem = "default parameters change the input";
+        else if (EvaluateToneCurve(levels, 0.1) != 0.0 || EvaluateToneCurve(levels, 0.9) != 1.0 || std::fabs(EvaluateToneCurve(levels, 0.5) - 0.5) > 1e-6)
+            problem = "levels do not map the black and white points";
+        else if (std::fabs(EvaluateToneCurve(gamma, 0.25) - 0.5) > 1e-6)
+            problem = "gamma 2 does not brighten 0.25 to 0.5";
+        else if (EvaluateToneCurve(contrast, 0.0) != 0.0 || EvaluateToneCurve(contrast, 1.0) != 1.0 || std::fabs(EvaluateToneCurve(contrast, 0.5) - 0.5) > 1e-9)
+            problem = "contrast moves black, white or mid gray";
+        else if (std::fabs(slope - 3.0) > 0.01)
+            problem = "contrast slope at mid gray is not the parameter";
+        snprintf(detail, sizeof(detail), "%s", problem != NULL ? problem : "levels, gamma and contrast as documented");
+        Check("curve_parameters", problem == NULL, detail);
+    }
+
+    // Gathers and lane-by-lane lookups pick the same entries as the scalar kernel; an odd width
+    // covers the scalar tail
+    {
+        PixelImage source = RandomImage(1021, 67, 2);
+        PixelImage expected(source.width, source.height), actual(source.width, source.height);
+        MismatchList mismatches;
+        for (int dither = 0; dither < 2; dither++) {
+            ApplyColorMatrixAndCurve(PIXEL_KERNEL_SCALAR, matrix, curve, source.pixels.data(), expected.pixels.data(), source.width,
+                source.height, dither != 0);
+            for (int kernel = PIXEL_KERNEL_SSE2; kernel < PIXEL_KERNEL_COUNT; kernel++) {
+                if (!IsPixelKernelAvailable(static_cast<PixelKernel>(kernel)))
+                    continue;
+                ApplyColorMatrixAndCurve(static_cast<PixelKernel>(kernel), matrix, curve, source.pixels.data(), actual.pixels.data(),
+                    source.width, source.height, dither != 0);
+                mismatches.Compare(actual.pixels == expected.pixels, "%s%s", PixelKernelName(static_cast<PixelKernel>(kernel)),
+                    dither ? "/dither" : "");
+            }
+        }
+        Check("kernels_agree", mismatches.Empty(), mismatches.Describe("kernel runs"));
+    }
+
+    // The fused pass indexes the curve with the unrounded matrix output; two passes round first,
+    // and the curve's slope multiplies that rounding error
+    {
+        PixelImage source = RandomImage(512, 512, 3);
+        PixelImage fused(source.width, source.height), twoPass(source.width, source.height);
+        ApplyColorMatrixAndCurve(BestPixelKernel(), matrix, curve, source.pixels.data(), fused.pixels.data(), source.width, source.height, false);
+        ApplyColorMatrix(BestPixelKernel(), matrix, source.pixels.data(), twoPass.pixels.data(), source.pixels.size());
+        ApplyToneCurve(curve, twoPass.pixels.data(), twoPass.pixels.data(), twoPass.pixels.size());
+        double fusedError = LargestCurveError(matrix, parameters, source, fused);
+        double twoPassError = LargestCurveError(matrix, parameters, source, twoPass);
+        snprintf(detail, sizeof(detail), "largest error %.3f levels fused, %.3f levels in two passes", fusedError, twoPassError);
+        Check("fused_accuracy", fusedError <= 1.0 && fusedError < twoPassError, detail);
+    }
+
+    // The identity curve moves a value by at most half a curve step before rounding
+    {
+        PixelImage source = RandomImage(512, 512, 4);
+        PixelImage plain(source.width, source.height), curved(source.width, source.height);
+        ApplyColorMatrix(BestPixelKernel(), matrix, source.pixels.data(), plain.pixels.data(), source.pixels.size());
+        ApplyColorMatrixAndCurve(BestPixelKernel(), matrix, ToneCurve(), source.pixels.data(), curved.pixels.data(), source.width,
+            source.height, false);
+        int worst = 0;
+        size_t changed = 0;
+        for (size_t i = 0; i < source.pixels.size(); i++) {
+            for (int shift = 0; shift < 24; shift += 8) {
+                int difference = std::abs(static_cast<int>((plain.pixels[i] >> shift) & 0xFF) - static_cast<int>((curved.pixels[i] >> shift) & 0xFF));
+                worst = (std::max)(worst, difference);
+                changed += difference != 0;
+            }
+        }
+        snprintf(detail, sizeof(detail), "largest difference %d level(s), %.3f%% of channels changed", worst,
+            100.0 * changed / (3.0 * source.pixels.size()));
+        Check("identity_curve", worst <= 1, detail);
+    }
+
+    // What SaveToneCurveFile writes, LoadToneCurveFile reads back; a two-entry table is resampled
+    {
+        std::string path = (std::filesystem::temp_directory_path() / "screenfilter_tone_curve.cube").string();
+        ToneCurve loaded;
+        std::string error;
+        bool saved = SaveToneCurveFile(path.c_str(), curve);
+        bool read = saved && LoadToneCurveFile(path.c_str(), loaded, error);
+        std::remove(path.c_str());
+        double worst = 0.0;
+        for (size_t i = 0; read && i < curve.levels.size(); i++)
+            worst = (std::max)(worst, static_cast<double>(std::fabs(loaded.levels[i] - curve.levels[i])));
+
+        std::istringstream inverse("TITLE \"invert\"\nLUT_1D_SIZE 2\n1 1 1\n0 0 0 # black\n");
+        ToneCurve inverted;
+        bool parsed = ParseToneCurve(inverse, inverted, error);
+        double inverseError = 0.0;
+        for (int i = 0; parsed && i < TONE_CURVE_SIZE; i++)
+            inverseError = (std::max)(inverseError, std::fabs(inverted.Channel(1)[i] - (255.0 - 255.0 * i / (TONE_CURVE_SIZE - 1))));
+
+        snprintf(detail, sizeof(detail), "%s; largest difference %.5f levels, two-entry inverse %.5f", read && parsed ? "read back" : error.c_str(),
+            worst, inverseError);
+        Check("cube_round_trip", read && parsed && worst < 0.001 && inverseError < 0.001, detail);
+    }
+
+    // Malformed files are rejected and leave the curve alone
+    {
+        const char* malformed[] = {
+            "0 0 0\n1 1 1\n",
+            "LUT_3D_SIZE 2\n",
+            "LUT_1D_SIZE 1\n0 0 0\n",
+            "LUT_1D_SIZE 3\n0 0 0\n1 1 1\n",
+            "LUT_1D_SIZE 2\n0 0 0\n0.5 0.5 0.5\n1 1 1\n",
+            "LUT_1D_SIZE 2\n0 0\n1 1 1\n",
+            "LUT_1D_SIZE 2\nDOMAIN_MIN 1 1 1\nDOMAIN_MAX 0 0 0\n0 0 0\n1 1 1\n",
+        };
+        int accepted = 0;
+        bool unchanged = true;
+        for (const char* text : malformed) {
+            std::istringstream input(text);
+            ToneCurve target = curve;
+            std::string error;
+            if (ParseToneCurve(input, target, error) || error.empty())
+                accepted++;
+            unchanged = unchanged && target.levels == curve.levels;
+        }
+        snprintf(detail, sizeof(detail), "%d of %d malformed files accepted", accepted, static_cast<int>(sizeof(malformed) / sizeof(malformed[0])));
+        Check("cube_errors", accepted == 0 && unchanged, detail);
+    }
+
+    // One traversal against two at 1080p, alternating so both see the same machine state
+    {
+        PixelImage source = RandomImage(1920, 1080, 5);
+        PixelImage target(source.width, source.height);
+        PixelKernel kernel = BestPixelKernel();
+        std::vector<double> fusedMs, twoPassMs;
+        for (int repetition = 0; repetition < 15; repetition++) {
+            for (int pass = 0; pass < 2; pass++) {
+                std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+                if (pass == 0) {
+                    ApplyColorMatrixAndCurve(kernel, matrix, curve, source.pixels.data(), target.pixels.data(), source.width, source.height, false);
+                } else {
+                    ApplyColorMatrix(kernel, matrix, source.pixels.data(), target.pixels.data(), source.pixels.size());
+                    ApplyToneCurve(curve, target.pixels.data(), target.pixels.data(), target.pixels.size());
+                }
+                BenchDoNotOptimize(target.pixels[0]);
+                double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+                (pass == 0 ? fusedMs : twoPassMs).push_back(ms);
+            }
+        }
+        std::sort(fusedMs.begin(), fusedMs.end());
+        std::sort(twoPassMs.begin(), twoPassMs.end());
+        double speedup = twoPassMs[twoPassMs.size() / 2] / fusedMs[fusedMs.size() / 2];
+        snprintf(detail, sizeof(detail), "%s 1920x1080: %.3f ms fused, %.3f ms two passes (x%.2f)", PixelKernelName(kernel),
+            fusedMs[fusedMs.size() / 2], twoPassMs[twoPassMs.size() / 2], speedup);
+        Check("fused_faster", speedup >= minSpeedup, detail);
+    }
+
+    return FinishChecks("tone curve");
+}
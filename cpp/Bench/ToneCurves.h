@@ -0,0 +1,20 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "BenchHarness.h"
+
+// tone_curve/<kernel>/<size>/fused: ApplyColorMatrixAndCurve on a 1080p and a 4K frame;
+// tone_curve/<kernel>/<size>/two_pass: ApplyColorMatrix and then ApplyToneCurve over the result,
+// the same work with a second traversal of the image
+void RegisterToneCurveBenchmarks(BenchSuite& suite);
+
+// screenfilter_bench --tone-curve [--min-speedup=X]: checks the tone curve stage. Generated
+// curves must keep black, white and mid gray where their parameters say; every vector kernel
+// must produce the scalar kernel's pixels, dithered or not; the fused stage must stay within a
+// level of the exact curve and beat the two-pass result, whose 8-bit intermediate the curve
+// magnifies; the identity curve must leave the matrix output within a level; .cube files must
+// round-trip and malformed ones be rejected; and at 1080p the fused pass must be at least X
+// (default 1.0) times as fast as two passes. Returns the process exit code: 0 if every check
+// passes.
+int RunToneCurveChecks(const std::vector<std::string>& arguments);
@@ -0,0 +1,276 @@
+#include "VisionEffects.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include "BenchChecks.h"
+#include "ColorEffects.h"
+#include "PixelKernels.h"
+
+namespace {
+
+// Weights of the remaining cones published with the Vienot et al. LMS matrix (Fidaner, Lin and
+// Ozguven, "Analysis of Color Blindness", 2005), the basis of most daltonization filters
+const struct { VisionMode mode; double a; double b; } publishedWeights[] = {
+    { VISION_SIMULATE_PROTAN, 2.02344, -2.52581 },
+    { VISION_SIMULATE_DEUTAN, 0.494207, 1.24827 },
+};
+
+const char* const deficiencyNames[3] = { "protan", "deutan", "tritan" };
+
+struct Color {
+    double channel[3];
+};
+
+// pixel * matrix with channels in 0..1, unclamped
+Color Transform(const ColorMatrix& matrix, const Color& color) {
+    Color result;
+    for (int column = 0; column < 3; column++) {
+        result.channel[column] = color.channel[0] * matrix.transform[0][column] + color.channel[1] * matrix.transform[1][column] +
+            color.channel[2] * matrix.transform[2][column] + matrix.transform[4][column];
+    }
+    return result;
+}
+
+double Distance(const Color& a, const Color& b) {
+    double sum = 0.0;
+    for (int channel = 0; channel < 3; channel++)
+        sum += (a.channel[channel] - b.channel[channel]) * (a.channel[channel] - b.channel[channel]);
+    return std::sqrt(sum);
+}
+
+Color MakeColor(double r, double g, double b) {
+    Color color = { { r, g, b } };
+    return color;
+}
+
+// Direction in RGB along which only the missing cone's response changes: colors on such a line
+// look the same to the dichromat. Column 'cone' of the inverse of the LMS matrix in
+// ColorEffects.cpp, solved here with Cramer's rule so the check does not reuse that code.
+Color ConfusionDirection(int cone) {
+    const double m[3][3] = {
+        { 17.8824, 43.5161, 4.11935 },
+        { 3.45565, 27.1554, 3.86714 },
+        { 0.0299566, 0.184309, 1.46709 },
+    };
+    double determinant = m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1]) -
+        m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0]) +
+        m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+    Color direction;
+    for (int column = 0; column < 3; column++) {
+        double replaced[3][3];
+        for (int row = 0; row < 3; row++) {
+            for (int k = 0; k < 3; k++)
+                replaced[row][k] = k == column ? (row == cone ? 1.0 : 0.0) : m[row][k];
+        }
+        direction.channel[column] = (replaced[0][0] * (replaced[1][1] * replaced[2][2] - replaced[1][2] * replaced[2][1]) -
+            replaced[0][1] * (replaced[1][0] * replaced[2][2] - replaced[1][2] * replaced[2][0]) +
+            replaced[0][2] * (replaced[1][0] * replaced[2][1] - replaced[1][1] * replaced[2][0])) / determinant;
+    }
+
+    // Scaled to a length of 0.2, a clearly visible difference
+    double length = Distance(direction, MakeColor(0.0, 0.0, 0.0));
+    for (int channel = 0; channel < 3; channel++)
+        direction.channel[channel] *= 0.2 / length;
+    return direction;
+}
+
+}
+
+void RegisterVisionBenchmarks(BenchSuite& suite) {
+    suite.Add("color_matrix/calculate_vision_modes", VISION_MODE_COUNT * NUM_VISION_SEVERITIES, [] {
+        return BenchBody([](uint64_t iterations) {
+            ColorEffectSettings settings;
+            settings.inversionEnabled = true;
+            settings.grayLevel = NUM_GRAY_LEVELS - 1;
+            ColorMatrix matrix;
+            for (uint64_t i = 0; i < iterations; i++) {
+                for (int mode = 0; mode < VISION_MODE_COUNT; mode++) {
+                    for (int severity = 0; severity < NUM_VISION_SEVERITIES; severity++) {
+                        settings.visionMode = mode;
+                        settings.visionSeverity = severity;
+                        CalculateColorMatrix(settings, matrix);
+                        BenchDoNotOptimize(matrix);
+                    }
+                }
+            }
+        });
+    });
+}
+
+int RunVisionChecks(const std::vector<std::string>& arguments) {
+    double budgetNs = 1000.0;
+
+    for (const std::string& argument : arguments) {
+        size_t equals = argument.find('=');
+        std::string name = argument.substr(0, equals);
+        std::string value = equals == std::string::npos ? "" : argument.substr(equals + 1);
+
+        bool valid = true;
+        if (name == "--vision")
+            continue;
+        else if (name == "--budget-ns")
+            valid = sscanf(value.c_str(), "%lf", &budgetNs) == 1 && budgetNs > 0.0;
+        else
+            valid = false;
+
+        if (!valid) {
+            fprintf(stderr, "Invalid argument: %s\n", argument.c_str());
+            return 2;
+        }
+    }
+
+    ResetChecks();
+    char name[64], detail[160];
+    const int full = NUM_VISION_SEVERITIES - 1;
+
+    // The model's published cone weights
+    for (const auto& published : publishedWeights) {
+        double a, b;
+        DichromatProjection(published.mode, a, b);
+        bool passed = std::fabs(a - published.a) < 1e-4 && std::fabs(b - published.b) < 1e-4;
+        snprintf(name, sizeof(name), "published_weights/%s", deficiencyNames[published.mode - VISION_SIMULATE_PROTAN]);
+        snprintf(detail, sizeof(detail), "%.6f, %.6f (published %.6f, %.6f)", a, b, published.a, published.b);
+        Check(name, passed, detail);
+    }
+
+    // Each dichromat sees white, black and the anchor primary as everyone does, and cannot tell
+    // colors apart along its confusion lines
+    for (int mode = VISION_SIMULATE_PROTAN; mode <= VISION_SIMULATE_TRITAN; mode++) {
+        const ColorMatrix& simulation = VisionMatrix(mode, full);
+        int missing = mode - VISION_SIMULATE_PROTAN;
+        Color anchor = missing == 2 ? MakeColor(1.0, 0.0, 0.0) : MakeColor(0.0, 0.0, 1.0);
+        double kept = (std::max)(Distance(Transform(simulation, MakeColor(1.0, 1.0, 1.0)), MakeColor(1.0, 1.0, 1.0)),
+            (std::max)(Distance(Transform(simulation, MakeColor(0.0, 0.0, 0.0)), MakeColor(0.0, 0.0, 0.0)),
+                Distance(Transform(simulation, anchor), anchor)));
+
+        Color direction = ConfusionDirection(missing);
+        double collapsed = 0.0;
+        for (double gray = 0.3; gray <= 0.7; gray += 0.1) {
+            Color a = MakeColor(gray - direction.channel[0] / 2, gray - direction.channel[1] / 2, gray - direction.channel[2] / 2);
+            Color b = MakeColor(gray + direction.channel[0] / 2, gray + direction.channel[1] / 2, gray + direction.channel[2] / 2);
+            collapsed = (std::max)(collapsed, Distance(Transform(simulation, a), Transform(simulation, b)));
+        }
+
+        snprintf(name, sizeof(name), "simulation/%s", deficiencyNames[missing]);
+        snprintf(detail, sizeof(detail), "fixed colors move %.6f, confusion pairs 0.2 apart end %.6f apart", kept, collapsed);
+        Check(name, kept < 1e-4 && collapsed < 1e-4, detail);
+    }
+
+    // Correction makes a confusion pair distinguishable again for the dichromat
+    for (int mode = VISION_CORRECT_PROTAN; mode < VISION_MODE_COUNT; mode++) {
+        int simulationMode = mode - (VISION_CORRECT_PROTAN - VISION_SIMULATE_PROTAN);
+        Color direction = ConfusionDirection(mode - VISION_CORRECT_PROTAN);
+        Color a = MakeColor(0.5 - direction.channel[0] / 2, 0.5 - direction.channel[1] / 2, 0.5 - direction.channel[2] / 2);
+        Color b = MakeColor(0.5 + direction.channel[0] / 2, 0.5 + direction.channel[1] / 2, 0.5 + direction.channel[2] / 2);
+        const ColorMatrix& correction = VisionMatrix(mode, full);
+        const ColorMatrix& simulation = VisionMatrix(simulationMode, full);
+        double restored = Distance(Transform(simulation, Transform(correction, a)), Transform(simulation, Transform(correction, b)));
+
+        snprintf(name, sizeof(name), "correction/%s", deficiencyNames[mode - VISION_CORRECT_PROTAN]);
+        snprintf(detail, sizeof(detail), "confusion pair 0.2 apart seen %.4f apart after correction", restored);
+        Check(name, restored > 0.05, detail);
+    }
+
+    // The table holds what ComputeVisionMatrix builds, starting from the identity
+    {
+        int mismatches = 0;
+        ColorMatrix identity;
+        CalculateColorMatrix(ColorEffectSettings(), identity);
+        for (int mode = 0; mode < VISION_MODE_COUNT; mode++) {
+            for (int step = 0; step < NUM_VISION_SEVERITIES; step++) {
+                ColorMatrix computed;
+                ComputeVisionMatrix(static_cast<VisionMode>(mode), static_cast<double>(step) / full, computed);
+                for (int i = 0; i < 25; i++) {
+                    float entry = VisionMatrix(mode, step).transform[i / 5][i % 5];
+                    if (entry != computed.transform[i / 5][i % 5] || (step == 0 && entry != identity.transform[i / 5][i % 5]))
+                        mismatches++;
+                }
+            }
+        }
+        snprintf(detail, sizeof(detail), "%d of %d entries differ", mismatches, VISION_MODE_COUNT * NUM_VISION_SEVERITIES * 25);
+        Check("severity_table", mismatches == 0, detail);
+    }
+
+    // Vision effects come first and compose with the other effects into one matrix, which the
+    // pixel kernels apply like any other
+    {
+        std::mt19937 random(5);
+        double worstMatrix = 0.0;
+        int worstLevels = 0;
+        std::vector<uint32_t> pixels(4096), filtered(4096);
+        for (uint32_t& pixel : pixels)
+            pixel = random() | 0xFF000000u;
+
+        for (int mode = 1; mode < VISION_MODE_COUNT; mode++) {
+            for (int state = 0; state < 2 * 2 * NUM_GRAY_LEVELS; state++) {
+                ColorEffectSettings base;
+                base.inversionEnabled = (state & 1) != 0;
+                base.grayscaleEnabled = (state & 2) != 0;
+                base.grayLevel = state >> 2;
+                ColorEffectSettings combined = base;
+                combined.visionMode = mode;
+                combined.visionSeverity = state % NUM_VISION_SEVERITIES;
+
+                ColorMatrix baseMatrix, combinedMatrix;
+                CalculateColorMatrix(base, baseMatrix);
+                CalculateColorMatrix(combined, combinedMatrix);
+                const ColorMatrix& vision = VisionMatrix(combined.visionMode, combined.visionSeverity);
+
+                ApplyColorMatrix(BestPixelKernel(), combinedMatrix, pixels.data(), filtered.data(), pixels.size());
+                for (size_t i = 0; i < pixels.size(); i++) {
+                    Color color = MakeColor(((pixels[i] >> 16) & 0xFF) / 255.0, ((pixels[i] >> 8) & 0xFF) / 255.0, (pixels[i] & 0xFF) / 255.0);
+                    Color expected = Transform(baseMatrix, Transform(vision, color));
+                    worstMatrix = (std::max)(worstMatrix, Distance(Transform(combinedMatrix, color), expected));
+
+                    for (int channel = 0; channel < 3; channel++) {
+                        double level = (std::min)(255.0, (std::max)(0.0, expected.channel[channel] * 255.0));
+                        int actual = static_cast<int>((filtered[i] >> (16 - 8 * channel)) & 0xFF);
+                        worstLevels = (std::max)(worstLevels, static_cast<int>(std::fabs(actual - std::floor(level + 0.5))));
+                    }
+                }
+            }
+        }
+        snprintf(detail, sizeof(detail), "composed matrix within %.2e, kernel output within %d level(s)", worstMatrix, worstLevels);
+        Check("composes_with_effects", worstMatrix < 1e-5 && worstLevels <= 1, detail);
+    }
+
+    // Switching modes is a table lookup and a 3x3 product on top of the usual matrix build
+    {
+        const int sweeps = 200;
+        double visionNs = MedianNsPerOperation([&]() {
+            ColorEffectSettings settings;
+            settings.inversionEnabled = true;
+            ColorMatrix matrix;
+            uint64_t builds = 0;
+            for (int sweep = 0; sweep < sweeps; sweep++) {
+                for (int mode = 1; mode < VISION_MODE_COUNT; mode++) {
+                    settings.visionMode = mode;
+                    settings.visionSeverity = (sweep + mode) % NUM_VISION_SEVERITIES;
+                    CalculateColorMatrix(settings, matrix);
+                    BenchDoNotOptimize(matrix);
+                    builds++;
+                }
+            }
+            return builds;
+        });
+        double plainNs = MedianNsPerOperation([&]() {
+            ColorEffectSettings settings;
+            ColorMatrix matrix;
+            uint64_t builds = 0;
+            for (int sweep = 0; sweep < sweeps; sweep++) {
+                for (int mode = 1; mode < VISION_MODE_COUNT; mode++) {
+                    settings.inversionEnabled = (mode & 1) != 0;
+                    CalculateColorMatrix(settings, matrix);
+                    BenchDoNotOptimize(matrix);
+                    builds++;
+                }
+            }
+            return builds;
+        });
+        snprintf(detail, sizeof(detail), "%.1f ns per switch (without a vision effect: %.1f ns), budget %.0f ns", visionNs, plainNs, budgetNs);
+        Check("switch_within_budget", visionNs < budgetNs, detail);
+    }
+
+    return FinishChecks("vision");
+}
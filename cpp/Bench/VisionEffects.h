@@ -0,0 +1,18 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "BenchHarness.h"
+
+// color_matrix/calculate_vision_modes: CalculateColorMatrix for every vision mode and severity
+// step, inverted at the lowest white level, i.e. the cost of switching between them
+void RegisterVisionBenchmarks(BenchSuite& suite);
+
+// screenfilter_bench --vision [--budget-ns=N]: checks the color vision deficiency effects. The
+// protan and deutan cone projections must match the weights published with the Vienot et al.
+// model; simulations must keep white, black and the anchor primary, and collapse colors on a
+// confusion line; correction must restore some of the difference simulation takes away; the
+// severity table must hold exactly what ComputeVisionMatrix builds; vision effects must compose
+// with inversion and the white level, also through the pixel kernels; and a switch must cost
+// less than the budget (default 1000 ns). Returns the process exit code: 0 if every check passes.
+int RunVisionChecks(const std::vector<std::string>& arguments);
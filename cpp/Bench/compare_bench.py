@@ -0,0 +1,72 @@
+#!/usr/bin/env python3
+"""Compare two screenfilter_bench JSON results and flag regressions.
+
+    compare_bench.py baseline.json candidate.json [--threshold=5] [--metric=median_ns]
+
+Exits with status 1 if any benchmark got slower than the threshold (percent),
+so it can gate a dependency or compiler upgrade. Input replay reports
+(screenfilter_bench --replay --json) compare with --metric=per_event --threshold=0:
+their counts are exact, so any extra work per input is a regression.
+"""
+
+import argparse
+import json
+import sys
+
+
+def load(path):
+    with open(path) as f:
+        data = json.load(f)
+    return data.get("context", {}), {b["name"]: b for b in data["benchmarks"]}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("baseline")
+    parser.add_argument("candidate")
+    parser.add_argument("--threshold", type=float, default=5.0,
+                        help="percent slowdown that counts as a regression (default 5)")
+    parser.add_argument("--metric", default="median_ns",
+                        help="per-iteration time field to compare (default median_ns)")
+    args = parser.parse_args()
+
+    base_context, baseline = load(args.baseline)
+    new_context, candidate = load(args.candidate)
+
+    for key in ("compiler", "build_type", "pinned_cpu"):
+        if base_context.get(key) != new_context.get(key):
+            print("note: %s differs: %s -> %s" % (key, base_context.get(key), new_context.get(key)))
+
+    regressions = 0
+    print("%-48s %14s %14s %9s  %s" % ("benchmark", "baseline", "candidate", "change", "status"))
+    for name in sorted(set(baseline) | set(candidate)):
+        if name not in candidate:
+            print("%-48s %14.1f %14s %9s  missing" % (name, baseline[name][args.metric], "-", "-"))
+            continue
+        if name not in baseline:
+            print("%-48s %14s %14.1f %9s  new" % (name, "-", candidate[name][args.metric], "-"))
+            continue
+
+        before = baseline[name][args.metric]
+        after = candidate[name][args.metric]
+        if before > 0:
+            change = (after - before) / before * 100.0
+        else:
+            change = float("inf") if after > 0 else 0.0
+        if change > args.threshold:
+            status = "REGRESSION"
+            regressions += 1
+        elif change < -args.threshold:
+            status = "improved"
+        else:
+            status = "ok"
+        print("%-48s %14.1f %14.1f %+8.1f%%  %s" % (name, before, after, change, status))
+
+    if regressions:
+        print("\n%d benchmark(s) regressed by more than %.1f%%" % (regressions, args.threshold))
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,171 @@
+#include "AutoInvert.h"
+
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define AUTO_INVERT_SSE2 1
+#include <emmintrin.h>
+#endif
+
+// As in PixelKernels.cpp: compiled for every x86 build, used when the CPU supports it
+#if defined(AUTO_INVERT_SSE2) && (defined(__GNUC__) || defined(__clang__) || defined(_MSC_VER))
+#define AUTO_INVERT_AVX2 1
+#include <immintrin.h>
+#if defined(__GNUC__) || defined(__clang__)
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_AVX2
+#endif
+#endif
+
+namespace {
+
+// Samples i, i + step, ... of one row into the histogram; returns the first sample left
+int HistogramRowScalar(const uint32_t* row, int i, int count, int step, uint32_t bins[LUMINANCE_HISTOGRAM_BINS]) {
+    for (; i < count; i++)
+        bins[PixelLuma(row[static_cast<size_t>(i) * step]) >> 4]++;
+    return i;
+}
+
+#ifdef AUTO_INVERT_SSE2
+// PixelLuma() of four pixels in 32-bit lanes. Every product and the sum fit in 16 bits, so
+// 16-bit multiplies do, with the lanes' upper halves zero.
+inline __m128i LumaSSE2(__m128i pixels) {
+    __m128i byteMask = _mm_set1_epi32(0xFF);
+    __m128i blue = _mm_and_si128(pixels, byteMask);
+    __m128i green = _mm_and_si128(_mm_srli_epi32(pixels, 8), byteMask);
+    __m128i red = _mm_and_si128(_mm_srli_epi32(pixels, 16), byteMask);
+    __m128i sum = _mm_add_epi32(_mm_add_epi32(_mm_mullo_epi16(blue, _mm_set1_epi32(29)), _mm_mullo_epi16(green, _mm_set1_epi32(150))),
+        _mm_add_epi32(_mm_mullo_epi16(red, _mm_set1_epi32(77)), _mm_set1_epi32(128)));
+    return _mm_srli_epi32(sum, 8);
+}
+
+// Four samples' bins at a time, each counted into its own copy of the histogram so consecutive
+// increments do not wait on one another. Returns the first sample left.
+int HistogramRowSSE2(const uint32_t* row, int i, int count, int step, uint32_t bins[LUMINANCE_HISTOGRAM_BINS]) {
+    uint32_t sub[4][LUMINANCE_HISTOGRAM_BINS] = {};
+
+    for (; i + 4 <= count; i += 4) {
+        const uint32_t* sample = row + static_cast<size_t>(i) * step;
+        __m128i pixels = step == 1 ? _mm_loadu_si128(reinterpret_cast<const __m128i*>(sample)) :
+            _mm_set_epi32(static_cast<int>(sample[3 * step]), static_cast<int>(sample[2 * step]), static_cast<int>(sample[step]),
+                static_cast<int>(sample[0]));
+        alignas(16) int32_t index[4];
+        _mm_store_si128(reinterpret_cast<__m128i*>(index), _mm_srli_epi32(LumaSSE2(pixels), 4));
+        sub[0][index[0]]++; sub[1][index[1]]++; sub[2][index[2]]++; sub[3][index[3]]++;
+    }
+
+    for (int bin = 0; bin < LUMINANCE_HISTOGRAM_BINS; bin++)
+        bins[bin] += sub[0][bin] + sub[1][bin] + sub[2][bin] + sub[3][bin];
+    return i;
+}
+#endif
+
+#ifdef AUTO_INVERT_AVX2
+// HistogramRowSSE2() eight samples at a time, gathered when they are apart
+TARGET_AVX2 int HistogramRowAVX2(const uint32_t* row, int i, int count, int step, uint32_t bins[LUMINANCE_HISTOGRAM_BINS]) {
+    uint32_t sub[4][LUMINANCE_HISTOGRAM_BINS] = {};
+
+    __m256i offsets = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(step));
+    __m256i byteMask = _mm256_set1_epi32(0xFF);
+    for (; i + 8 <= count; i += 8) {
+        const uint32_t* sample = row + static_cast<size_t>(i) * step;
+        __m256i pixels = step == 1 ? _mm256_loadu_si256(reinterpret_cast<const __m256i*>(sample)) :
+            _mm256_i32gather_epi32(reinterpret_cast<const int*>(sample), offsets, 4);
+        __m256i blue = _mm256_and_si256(pixels, byteMask);
+        __m256i green = _mm256_and_si256(_mm256_srli_epi32(pixels, 8), byteMask);
+        __m256i red = _mm256_and_si256(_mm256_srli_epi32(pixels, 16), byteMask);
+        __m256i sum = _mm256_add_epi32(
+            _mm256_add_epi32(_mm256_mullo_epi16(blue, _mm256_set1_epi32(29)), _mm256_mullo_epi16(green, _mm256_set1_epi32(150))),
+            _mm256_add_epi32(_mm256_mullo_epi16(red, _mm256_set1_epi32(77)), _mm256_set1_epi32(128)));
+        alignas(32) int32_t index[8];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(index), _mm256_srli_epi32(sum, 12));
+        sub[0][index[0]]++; sub[1][index[1]]++; sub[2][index[2]]++; sub[3][index[3]]++;
+        sub[0][index[4]]++; sub[1][index[5]]++; sub[2][index[6]]++; sub[3][index[7]]++;
+    }
+
+    for (int bin = 0; bin < LUMINANCE_HISTOGRAM_BINS; bin++)
+        bins[bin] += sub[0][bin] + sub[1][bin] + sub[2][bin] + sub[3][bin];
+    return i;
+}
+#endif
+
+}
+
+// Thinned histogram, one sampled row at a time
+void ComputeLuminanceHistogram(PixelKernel kernel, const uint32_t* pixels, int width, int height, int step, LuminanceHistogram& histogram) {
+    memset(&histogram, 0, sizeof(histogram));
+    if (width <= 0 || height <= 0)
+        return;
+
+    if (!IsPixelKernelAvailable(kernel) || kernel == PIXEL_KERNEL_LUT)
+        kernel = PIXEL_KERNEL_SCALAR;
+    step = step < 1 ? 1 : step;
+    int count = (width + step - 1) / step;
+    for (int y = 0; y < height; y += step) {
+        const uint32_t* row = pixels + static_cast<size_t>(y) * width;
+        int i = 0;
+#ifdef AUTO_INVERT_AVX2
+        if (kernel == PIXEL_KERNEL_AVX2)
+            i = HistogramRowAVX2(row, i, count, step, histogram.bins);
+#endif
+#ifdef AUTO_INVERT_SSE2
+        if (kernel == PIXEL_KERNEL_SSE2 || kernel == PIXEL_KERNEL_AVX2)
+            i = HistogramRowSSE2(row, i, count, step, histogram.bins);
+#endif
+        HistogramRowScalar(row, i, count, step, histogram.bins);
+        histogram.samples += static_cast<uint32_t>(count);
+    }
+}
+
+// Smallest power of two that thins the image enough
+int LuminanceSampleStep(int width, int height) {
+    int step = 1;
+    while (static_cast<int64_t>((width + step - 1) / step) * ((height + step - 1) / step) > AUTO_INVERT_TARGET_SAMPLES)
+        step *= 2;
+    return step;
+}
+
+AutoInvertDetector::AutoInvertDetector() : brightShare(0.0f), decided(false), bright(false), disagreeing(0), samplesTaken(0), flips(0) {
+    memset(&histogram, 0, sizeof(histogram));
+}
+
+// Forget the verdict
+void AutoInvertDetector::Reset() {
+    decided = false;
+    bright = false;
+    disagreeing = 0;
+}
+
+// Sample one frame and apply the hysteresis
+bool AutoInvertDetector::Update(PixelKernel kernel, const uint32_t* pixels, int width, int height) {
+    ComputeLuminanceHistogram(kernel, pixels, width, height, LuminanceSampleStep(width, height), histogram);
+    samplesTaken++;
+    if (histogram.samples == 0)
+        return false;
+
+    uint32_t brightSamples = 0;
+    for (int bin = AUTO_INVERT_BRIGHT_BIN; bin < LUMINANCE_HISTOGRAM_BINS; bin++)
+        brightSamples += histogram.bins[bin];
+    brightShare = static_cast<float>(brightSamples) / static_cast<float>(histogram.samples);
+
+    if (!decided) {
+        decided = true;
+        bright = brightShare >= 0.5f;
+        disagreeing = 0;
+        return true;
+    }
+
+    // Inside the band, or agreeing with the verdict, any run against it ends
+    bool against = bright ? brightShare < AUTO_INVERT_DARK_SHARE : brightShare > AUTO_INVERT_BRIGHT_SHARE;
+    if (!against) {
+        disagreeing = 0;
+        return false;
+    }
+    if (++disagreeing < AUTO_INVERT_HOLD_SAMPLES)
+        return false;
+    bright = !bright;
+    disagreeing = 0;
+    flips++;
+    return true;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include "PixelImage.h"
+#include "PixelKernels.h"
+
+// Bins of a luminance histogram, 16 levels of PixelLuma() each
+#define LUMINANCE_HISTOGRAM_BINS 16
+
+// Samples a frame is thinned to: plenty to tell a light page from a dark one, few enough that a
+// 4K frame touches about half a megabyte
+#define AUTO_INVERT_TARGET_SAMPLES 8192
+
+// First bin counted as bright, luminance 160 and up: page backgrounds and light widgets, not
+// mid-grey
+#define AUTO_INVERT_BRIGHT_BIN 10
+
+// Hysteresis on the share of bright samples: contents turn bright above the first and dark
+// below the second, and keep their verdict in between
+#define AUTO_INVERT_BRIGHT_SHARE 0.6f
+#define AUTO_INVERT_DARK_SHARE 0.4f
+
+// Consecutive samples a new verdict needs before it is taken, so a flash or a menu passing over
+// the region does not flip it
+#define AUTO_INVERT_HOLD_SAMPLES 4
+
+struct LuminanceHistogram {
+    uint32_t bins[LUMINANCE_HISTOGRAM_BINS];
+    uint32_t samples;
+};
+
+// Histogram of the luminance of every 'step'-th pixel of every 'step'-th row, from the top left.
+// The vector kernels compute the bins of four (SSE2) or eight (AVX2) samples at a time and count
+// them into four interleaved histograms; they count exactly what the scalar one does (LUT runs
+// the scalar code).
+void ComputeLuminanceHistogram(PixelKernel kernel, const uint32_t* pixels, int width, int height, int step, LuminanceHistogram& histogram);
+
+// Power-of-two step that thins a width x height image to at most AUTO_INVERT_TARGET_SAMPLES
+int LuminanceSampleStep(int width, int height);
+
+// Decides whether a region's contents are bright, so the auto-invert mode can invert a light
+// page and leave a dark one alone. Each Update() takes a thinned histogram of one frame and
+// compares its share of bright samples with the hysteresis band; a verdict changes only after
+// AUTO_INVERT_HOLD_SAMPLES samples in a row agree. The first sample after Reset() decides at once.
+class AutoInvertDetector {
+private:
+    LuminanceHistogram histogram; // Of the last sample
+    float brightShare;            // Of the last sample
+    bool decided;
+    bool bright;
+    int disagreeing;              // Consecutive samples against the verdict
+    uint64_t samplesTaken;
+    uint64_t flips;               // Verdict changes, not counting the first
+
+public:
+    AutoInvertDetector();
+
+    // Forget the verdict, e.g. when the mode is turned on
+    void Reset();
+
+    // Sample one frame. Returns true when the verdict is new: the first after Reset(), or a
+    // change, which the caller applies as the inversion state.
+    bool Update(PixelKernel kernel, const uint32_t* pixels, int width, int height);
+
+    bool IsDecided() const { return decided; }
+    bool IsBright() const { return bright; }
+    float GetBrightShare() const { return brightShare; }
+    const LuminanceHistogram& GetHistogram() const { return histogram; }
+    uint64_t GetSamplesTaken() const { return samplesTaken; }
+    uint64_t GetFlips() const { return flips; }
+};
@@ -0,0 +1,372 @@
+#include "Binarize.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BINARIZE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+// As in PixelKernels.cpp: compiled for every x86 build, used when the CPU supports it
+#if defined(BINARIZE_SSE2) && (defined(__GNUC__) || defined(__clang__) || defined(_MSC_VER))
+#define BINARIZE_AVX2 1
+#include <immintrin.h>
+#if defined(__GNUC__) || defined(__clang__)
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_AVX2
+#endif
+#endif
+
+namespace {
+
+// Rows are shared out in horizontal strips. A strip starts by summing the window's rows above
+// its first row, so strips are kept at least this tall for that lead-in to stay small
+const int minStripRows = 128;
+
+// A strip's state, kept per thread so a frame allocates nothing. The column sums cover the
+// rows of the current window; the row sums are their prefix sums along the row, with a zero in
+// front. Sums wrap around in 32 bits, which leaves the difference of two prefixes exact as long
+// as a window's own sum fits (BINARIZE_WINDOW_MAX).
+struct StripScratch {
+    std::vector<uint8_t> luma; // Ring of window + 1 rows: the window and the row leaving it
+    std::vector<uint8_t> zeros; // Stands in for rows outside the image
+    std::vector<uint32_t> columnSums;
+    std::vector<uint32_t> columnSquares;
+    std::vector<uint32_t> rowSums;
+    std::vector<uint32_t> rowSquares;
+};
+
+#ifdef BINARIZE_AVX2
+// LumaRow() 32 pixels at a time; returns the pixel it stopped at
+TARGET_AVX2 int LumaRowAVX2(const uint32_t* row, int count, uint8_t* luma) {
+    __m256i blueRedWeights = _mm256_set1_epi32(29 | (77 << 16)), greenWeights = _mm256_set1_epi32(150);
+    __m256i blueRedMask = _mm256_set1_epi32(0x00FF00FF), greenMask = _mm256_set1_epi32(0xFF), round = _mm256_set1_epi32(128);
+    // The packs work within 128-bit lanes; this puts the four groups of four back in order
+    __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+    int i = 0;
+    for (; i + 32 <= count; i += 32) {
+        __m256i lumas[4];
+        for (int part = 0; part < 4; part++) {
+            __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + i + 8 * part));
+            __m256i weighted = _mm256_add_epi32(_mm256_madd_epi16(_mm256_and_si256(pixels, blueRedMask), blueRedWeights),
+                _mm256_madd_epi16(_mm256_and_si256(_mm256_srli_epi32(pixels, 8), greenMask), greenWeights));
+            lumas[part] = _mm256_srli_epi32(_mm256_add_epi32(weighted, round), 8);
+        }
+        __m256i packed = _mm256_packus_epi16(_mm256_packs_epi32(lumas[0], lumas[1]), _mm256_packs_epi32(lumas[2], lumas[3]));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(luma + i), _mm256_permutevar8x32_epi32(packed, order));
+    }
+    return i;
+}
+#endif
+
+// Luminance of a row, as PixelLuma() computes it
+void LumaRow(PixelKernel kernel, const uint32_t* row, int count, uint8_t* luma) {
+    int i = 0;
+#ifdef BINARIZE_AVX2
+    if (kernel == PIXEL_KERNEL_AVX2)
+        i = LumaRowAVX2(row, count, luma);
+#endif
+#ifdef BINARIZE_SSE2
+    // Blue and red are weighted in one multiply-add, green in another, sixteen pixels at a time
+    __m128i blueRedWeights = _mm_set1_epi32(29 | (77 << 16)), greenWeights = _mm_set1_epi32(150);
+    __m128i blueRedMask = _mm_set1_epi32(0x00FF00FF), greenMask = _mm_set1_epi32(0xFF), round = _mm_set1_epi32(128);
+    for (; kernel != PIXEL_KERNEL_SCALAR && i + 16 <= count; i += 16) {
+        __m128i lumas[4];
+        for (int part = 0; part < 4; part++) {
+            __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i + 4 * part));
+            __m128i weighted = _mm_add_epi32(_mm_madd_epi16(_mm_and_si128(pixels, blueRedMask), blueRedWeights),
+                _mm_madd_epi16(_mm_and_si128(_mm_srli_epi32(pixels, 8), greenMask), greenWeights));
+            lumas[part] = _mm_srli_epi32(_mm_add_epi32(weighted, round), 8);
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(luma + i),
+            _mm_packus_epi16(_mm_packs_epi32(lumas[0], lumas[1]), _mm_packs_epi32(lumas[2], lumas[3])));
+    }
+#endif
+    for (; i < count; i++) {
+        uint32_t blue = row[i] & 0xFF, green = (row[i] >> 8) & 0xFF, red = (row[i] >> 16) & 0xFF;
+        luma[i] = static_cast<uint8_t>((29 * blue + 150 * green + 77 * red + 128) >> 8);
+    }
+}
+
+// Move the column sums down a row, adding the row entering the window and subtracting the one
+// leaving it (a row of zeros at the image edges), and take the prefix sums of the result along
+// the row. 'sums' and 'squares' point past the zero in front. The vector versions return the
+// column they stopped at.
+#ifdef BINARIZE_SSE2
+int SlideRowSSE2(const uint8_t* entering, const uint8_t* leaving, int count, uint32_t* columnSums, uint32_t* columnSquares,
+    uint32_t* sums, uint32_t* squares) {
+    // Entering and leaving luminances are paired up so one multiply-add gives their difference
+    // and another the difference of their squares. Shift-and-add then gives the prefix sums
+    // within four lanes, and the carry holds the total of the row so far in every lane.
+    __m128i zero = _mm_setzero_si128(), plusMinus = _mm_set1_epi32(1 | (0xFFFF << 16));
+    __m128i sumCarry = zero, squareCarry = zero;
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i pairs = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(entering + i)),
+            _mm_loadl_epi64(reinterpret_cast<const __m128i*>(leaving + i)));
+        for (int part = 0; part < 8; part += 4) {
+            __m128i pair = part == 0 ? _mm_unpacklo_epi8(pairs, zero) : _mm_unpackhi_epi8(pairs, zero);
+            __m128i values = _mm_add_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(columnSums + i + part)),
+                _mm_madd_epi16(pair, plusMinus));
+            __m128i valueSquares = _mm_add_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(columnSquares + i + part)),
+                _mm_madd_epi16(pair, _mm_mullo_epi16(pair, plusMinus)));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(columnSums + i + part), values);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(columnSquares + i + part), valueSquares);
+
+            values = _mm_add_epi32(values, _mm_slli_si128(values, 4));
+            values = _mm_add_epi32(values, _mm_slli_si128(values, 8));
+            values = _mm_add_epi32(values, sumCarry);
+            sumCarry = _mm_shuffle_epi32(values, _MM_SHUFFLE(3, 3, 3, 3));
+            valueSquares = _mm_add_epi32(valueSquares, _mm_slli_si128(valueSquares, 4));
+            valueSquares = _mm_add_epi32(valueSquares, _mm_slli_si128(valueSquares, 8));
+            valueSquares = _mm_add_epi32(valueSquares, squareCarry);
+            squareCarry = _mm_shuffle_epi32(valueSquares, _MM_SHUFFLE(3, 3, 3, 3));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(sums + i + part), values);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(squares + i + part), valueSquares);
+        }
+    }
+    return i;
+}
+#endif
+
+#ifdef BINARIZE_AVX2
+// The last element of the lower lane in each element of the upper one, zeros in the lower
+TARGET_AVX2 inline __m256i LowerLaneTotal(__m256i prefix) {
+    __m256i totals = _mm256_shuffle_epi32(prefix, _MM_SHUFFLE(3, 3, 3, 3));
+    return _mm256_permute2x128_si256(totals, totals, 0x08);
+}
+
+// SlideRowSSE2() eight columns at a time, with the lower lane's total carried into the upper one
+TARGET_AVX2 int SlideRowAVX2(const uint8_t* entering, const uint8_t* leaving, int count, uint32_t* columnSums,
+    uint32_t* columnSquares, uint32_t* sums, uint32_t* squares) {
+    __m256i plusMinus = _mm256_set1_epi32(1 | (0xFFFF << 16)), last = _mm256_set1_epi32(7);
+    __m256i sumCarry = _mm256_setzero_si256(), squareCarry = _mm256_setzero_si256();
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i pair = _mm256_cvtepu8_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(entering + i)),
+            _mm_loadl_epi64(reinterpret_cast<const __m128i*>(leaving + i))));
+        __m256i values = _mm256_add_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(columnSums + i)),
+            _mm256_madd_epi16(pair, plusMinus));
+        __m256i valueSquares = _mm256_add_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(columnSquares + i)),
+            _mm256_madd_epi16(pair, _mm256_mullo_epi16(pair, plusMinus)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(columnSums + i), values);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(columnSquares + i), valueSquares);
+
+        values = _mm256_add_epi32(values, _mm256_slli_si256(values, 4));
+        values = _mm256_add_epi32(values, _mm256_slli_si256(values, 8));
+        values = _mm256_add_epi32(_mm256_add_epi32(values, LowerLaneTotal(values)), sumCarry);
+        sumCarry = _mm256_permutevar8x32_epi32(values, last);
+        valueSquares = _mm256_add_epi32(valueSquares, _mm256_slli_si256(valueSquares, 4));
+        valueSquares = _mm256_add_epi32(valueSquares, _mm256_slli_si256(valueSquares, 8));
+        valueSquares = _mm256_add_epi32(_mm256_add_epi32(valueSquares, LowerLaneTotal(valueSquares)), squareCarry);
+        squareCarry = _mm256_permutevar8x32_epi32(valueSquares, last);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(sums + i), values);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(squares + i), valueSquares);
+    }
+    return i;
+}
+#endif
+
+void SlideRow(PixelKernel kernel, const uint8_t* entering, const uint8_t* leaving, int count, uint32_t* columnSums,
+    uint32_t* columnSquares, uint32_t* sums, uint32_t* squares) {
+    int i = 0;
+#ifdef BINARIZE_AVX2
+    if (kernel == PIXEL_KERNEL_AVX2)
+        i = SlideRowAVX2(entering, leaving, count, columnSums, columnSquares, sums, squares);
+#endif
+#ifdef BINARIZE_SSE2
+    if (kernel == PIXEL_KERNEL_SSE2)
+        i = SlideRowSSE2(entering, leaving, count, columnSums, columnSquares, sums, squares);
+#endif
+    uint32_t sum = sums[i - 1], square = squares[i - 1];
+    for (; i < count; i++) {
+        uint32_t in = entering[i], out = leaving[i];
+        columnSums[i] += in - out;
+        columnSquares[i] += in * in - out * out;
+        sum += columnSums[i];
+        square += columnSquares[i];
+        sums[i] = sum;
+        squares[i] = square;
+    }
+}
+
+// One output row: the prefix sums of its windows' columns, and its luminance and pixels
+struct ThresholdRow {
+    const uint32_t* sums;
+    const uint32_t* squares;
+    const uint8_t* luma;
+    const uint32_t* in;
+    uint32_t* out;
+};
+
+// Sum over the window's columns from 'left' to before 'right'
+inline int32_t WindowSum(const uint32_t* prefix, int left, int right) {
+    return static_cast<int32_t>(prefix[right] - prefix[left]);
+}
+
+// Threshold column i of a row, with the window from 'left' to before 'right'
+inline void ThresholdPixel(const ThresholdRow& row, int i, int left, int right, int rows) {
+    bool white = SauvolaWhite(row.luma[i], WindowSum(row.sums, left, right), WindowSum(row.squares, left, right),
+        rows * (right - left));
+    row.out[i] = (row.in[i] & 0xFF000000u) | (white ? 0x00FFFFFFu : 0u);
+}
+
+#ifdef BINARIZE_SSE2
+inline __m128i WindowSums(const uint32_t* prefix, int left, int right) {
+    return _mm_sub_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(prefix + right)),
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(prefix + left)));
+}
+
+// Columns i .. end - 1, whose windows are all 'count' pixels, four at a time; returns the
+// first column left. row.out + i must be 16-byte aligned: the output is streamed past the
+// cache, as nothing reads it back before the frame is shown.
+int ThresholdRowSSE2(const ThresholdRow& row, int i, int end, int half, int count) {
+    __m128 scale = _mm_set1_ps(1.0f / static_cast<float>(count));
+    __m128 darken = _mm_set1_ps(1.0f - BINARIZE_SAUVOLA_K);
+    __m128 contrast = _mm_set1_ps(BINARIZE_SAUVOLA_K / BINARIZE_SAUVOLA_R);
+    __m128i alphaMask = _mm_set1_epi32(static_cast<int>(0xFF000000u));
+    __m128i zero = _mm_setzero_si128();
+    for (; i + 4 <= end; i += 4) {
+        int packed;
+        memcpy(&packed, row.luma + i, sizeof(packed));
+        __m128 luma = _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(packed), zero), zero));
+        __m128i sums = WindowSums(row.sums, i - half, i + half + 1);
+        __m128i squares = WindowSums(row.squares, i - half, i + half + 1);
+
+        // SauvolaWhite(), operation for operation
+        __m128 mean = _mm_mul_ps(_mm_cvtepi32_ps(sums), scale);
+        __m128 variance = _mm_sub_ps(_mm_mul_ps(_mm_cvtepi32_ps(squares), scale), _mm_mul_ps(mean, mean));
+        __m128 above = _mm_sub_ps(luma, _mm_mul_ps(mean, darken));
+        __m128 slope = _mm_mul_ps(mean, contrast);
+        __m128 white = _mm_and_ps(_mm_cmpgt_ps(above, _mm_setzero_ps()),
+            _mm_cmpgt_ps(_mm_mul_ps(above, above), _mm_mul_ps(_mm_mul_ps(slope, slope), variance)));
+
+        __m128i alpha = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row.in + i)), alphaMask);
+        _mm_stream_si128(reinterpret_cast<__m128i*>(row.out + i), _mm_or_si128(alpha, _mm_andnot_si128(alphaMask, _mm_castps_si128(white))));
+    }
+    return i;
+}
+#endif
+
+#ifdef BINARIZE_AVX2
+TARGET_AVX2 inline __m256i WindowSumsAVX2(const uint32_t* prefix, int left, int right) {
+    return _mm256_sub_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(prefix + right)),
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(prefix + left)));
+}
+
+// ThresholdRowSSE2() eight columns at a time; row.out + i must be 32-byte aligned
+TARGET_AVX2 int ThresholdRowAVX2(const ThresholdRow& row, int i, int end, int half, int count) {
+    __m256 scale = _mm256_set1_ps(1.0f / static_cast<float>(count));
+    __m256 darken = _mm256_set1_ps(1.0f - BINARIZE_SAUVOLA_K);
+    __m256 contrast = _mm256_set1_ps(BINARIZE_SAUVOLA_K / BINARIZE_SAUVOLA_R);
+    __m256i alphaMask = _mm256_set1_epi32(static_cast<int>(0xFF000000u));
+    for (; i + 8 <= end; i += 8) {
+        __m256 luma = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(row.luma + i))));
+        __m256i sums = WindowSumsAVX2(row.sums, i - half, i + half + 1);
+        __m256i squares = WindowSumsAVX2(row.squares, i - half, i + half + 1);
+
+        __m256 mean = _mm256_mul_ps(_mm256_cvtepi32_ps(sums), scale);
+        __m256 variance = _mm256_sub_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(squares), scale), _mm256_mul_ps(mean, mean));
+        __m256 above = _mm256_sub_ps(luma, _mm256_mul_ps(mean, darken));
+        __m256 slope = _mm256_mul_ps(mean, contrast);
+        __m256 white = _mm256_and_ps(_mm256_cmp_ps(above, _mm256_setzero_ps(), _CMP_GT_OQ),
+            _mm256_cmp_ps(_mm256_mul_ps(above, above), _mm256_mul_ps(_mm256_mul_ps(slope, slope), variance), _CMP_GT_OQ));
+
+        __m256i alpha = _mm256_and_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(row.in + i)), alphaMask);
+        _mm256_stream_si256(reinterpret_cast<__m256i*>(row.out + i),
+            _mm256_or_si256(alpha, _mm256_andnot_si256(alphaMask, _mm256_castps_si256(white))));
+    }
+    return i;
+}
+#endif
+
+// Threshold rows y0 .. y1 - 1
+void BinarizeStrip(PixelKernel kernel, const uint32_t* src, uint32_t* dst, int width, int height, int half, int y0, int y1,
+    StripScratch& scratch) {
+    int ringRows = 2 * half + 2;
+    scratch.luma.resize(static_cast<size_t>(ringRows) * width);
+    scratch.columnSums.assign(width, 0u);
+    scratch.columnSquares.assign(width, 0u);
+    scratch.rowSums.resize(width + 1);
+    scratch.rowSquares.resize(width + 1);
+    scratch.zeros.assign(width, 0);
+    scratch.rowSums[0] = scratch.rowSquares[0] = 0;
+    auto lumaRow = [&](int y) { return scratch.luma.data() + static_cast<size_t>(y % ringRows) * width; };
+
+    // The window of the row above the strip, which the first step slides down
+    for (int y = (std::max)(y0 - half - 1, 0); y < (std::min)(y0 + half, height); y++) {
+        LumaRow(kernel, src + static_cast<size_t>(y) * width, width, lumaRow(y));
+        SlideRow(kernel, lumaRow(y), scratch.zeros.data(), width, scratch.columnSums.data(), scratch.columnSquares.data(),
+            scratch.rowSums.data() + 1, scratch.rowSquares.data() + 1);
+    }
+
+    // Columns whose windows lie inside the image, so all have 2 * half + 1 columns
+    int innerBegin = (std::min)(half, width), innerEnd = (std::max)(width - half, innerBegin);
+    for (int y = y0; y < y1; y++) {
+        int entering = y + half, leaving = y - half - 1;
+        if (entering < height)
+            LumaRow(kernel, src + static_cast<size_t>(entering) * width, width, lumaRow(entering));
+        SlideRow(kernel, entering < height ? lumaRow(entering) : scratch.zeros.data(), leaving >= 0 ? lumaRow(leaving) : scratch.zeros.data(),
+            width, scratch.columnSums.data(), scratch.columnSquares.data(), scratch.rowSums.data() + 1, scratch.rowSquares.data() + 1);
+
+        ThresholdRow row;
+        row.sums = scratch.rowSums.data();
+        row.squares = scratch.rowSquares.data();
+        row.luma = lumaRow(y);
+        row.in = src + static_cast<size_t>(y) * width;
+        row.out = dst + static_cast<size_t>(y) * width;
+        int rows = (std::min)(y + half + 1, height) - (std::max)(y - half, 0);
+
+        int i = 0;
+        for (; i < innerBegin; i++)
+            ThresholdPixel(row, i, 0, (std::min)(i + half + 1, width), rows);
+        for (; kernel != PIXEL_KERNEL_SCALAR && i < innerEnd && (reinterpret_cast<uintptr_t>(row.out + i) & 31) != 0; i++)
+            ThresholdPixel(row, i, i - half, i + half + 1, rows);
+#ifdef BINARIZE_AVX2
+        if (kernel == PIXEL_KERNEL_AVX2)
+            i = ThresholdRowAVX2(row, i, innerEnd, half, rows * (2 * half + 1));
+#endif
+#ifdef BINARIZE_SSE2
+        if (kernel == PIXEL_KERNEL_SSE2 || kernel == PIXEL_KERNEL_AVX2)
+            i = ThresholdRowSSE2(row, i, innerEnd, half, rows * (2 * half + 1));
+#endif
+        for (; i < width; i++)
+            ThresholdPixel(row, i, (std::max)(i - half, 0), (std::min)(i + half + 1, width), rows);
+    }
+
+#ifdef BINARIZE_SSE2
+    // Make the streamed rows visible before the strip is reported done
+    if (kernel != PIXEL_KERNEL_SCALAR)
+        _mm_sfence();
+#endif
+}
+
+}
+
+// Sauvola thresholding, strip by strip
+void BinarizeImage(PixelKernel kernel, const uint32_t* src, uint32_t* dst, int width, int height, int window, WorkerPool* pool) {
+    if (width <= 0 || height <= 0)
+        return;
+
+    if (!IsPixelKernelAvailable(kernel) || kernel == PIXEL_KERNEL_LUT)
+        kernel = PIXEL_KERNEL_SCALAR;
+    window = (std::min)((std::max)(window | 1, BINARIZE_WINDOW_MIN), BINARIZE_WINDOW_MAX);
+    int half = window / 2;
+
+    // One strip per thread, as long as strips stay tall enough
+    int strips = pool != NULL ? (std::max)((std::min)(pool->GetThreads(), height / minStripRows), 1) : 1;
+    auto runStrip = [=](int strip) {
+        thread_local StripScratch scratch;
+        BinarizeStrip(kernel, src, dst, width, height, half, static_cast<int>(static_cast<int64_t>(height) * strip / strips),
+            static_cast<int>(static_cast<int64_t>(height) * (strip + 1) / strips), scratch);
+    };
+
+    if (strips > 1) {
+        pool->Run(strips, runStrip);
+    } else {
+        runStrip(0);
+    }
+}
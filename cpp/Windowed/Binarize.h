@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include "ColorEffects.h"
+#include "PixelImage.h"
+#include "PixelKernels.h"
+#include "WorkerPool.h"
+
+// Sauvola's sensitivity to the local contrast: higher values turn more of a low-contrast window
+// black. 0.2 keeps thin, light-grey text without filling in flat backgrounds.
+#define BINARIZE_SAUVOLA_K 0.2f
+
+// Dynamic range of the standard deviation in Sauvola's threshold, for 8-bit luminance
+#define BINARIZE_SAUVOLA_R 128.0f
+
+// Whether a pixel of luminance 'luma' is white under Sauvola's threshold for a window of 'count'
+// pixels whose luminances add up to 'sum' and their squares to 'squares': the threshold is
+// mean * (1 + k * (deviation / R - 1)), compared squared so no square root is needed. Exposed so
+// checks can apply the exact rule BinarizeImage() does.
+inline bool SauvolaWhite(int luma, int32_t sum, int32_t squares, int count) {
+    float scale = 1.0f / static_cast<float>(count);
+    float mean = static_cast<float>(sum) * scale;
+    float variance = static_cast<float>(squares) * scale - mean * mean;
+    float above = static_cast<float>(luma) - mean * (1.0f - BINARIZE_SAUVOLA_K);
+    float slope = mean * (BINARIZE_SAUVOLA_K / BINARIZE_SAUVOLA_R);
+    return above > 0.0f && above * above > slope * slope * variance;
+}
+
+// Local adaptive thresholding of 32-bit BGRA pixels to pure black and white (Sauvola et al.,
+// 2000): each pixel is compared with a threshold from the mean and standard deviation of the
+// luminance in the 'window' x 'window' square around it, clipped at the image edges, so dark
+// text stays black on light backgrounds of any brightness, and grey text on grey does too.
+//
+// The window sums come from integral images of the luminance and its square, kept rolling
+// rather than whole: the image is cut into full-width strips, one per pool thread, and a strip
+// keeps only the difference between the integral image's rows at the bottom and top of the
+// current window. That difference is the sums down each column of the window, slid a row at a
+// time, and its prefix sums along the row are built with SIMD; a window sum is then the
+// difference of two prefixes. The cost is the same at any window size, and a strip's state is
+// a few rows instead of a 64 MB table at 4K, which a frame could not afford to write and read
+// back. Pixels are evaluated four (SSE2) or eight (AVX2) at a time, and the vector code repeats
+// SauvolaWhite() operation for operation, so every kernel gives the same result (LUT runs the
+// scalar code); their output is streamed past the cache. With a 'pool' the strips run on its
+// threads, with NULL on the calling one. 'window' is made odd and clamped to
+// BINARIZE_WINDOW_MIN..MAX. Alpha is passed through. src and dst must not overlap.
+//
+// A full-screen 4K frame has to fit a 60 Hz frame, 16 ms, on a pool of two threads or more.
+// One thread takes about 20 ms with AVX2, most of it moving the frame through memory, so a
+// single-core machine gets the two threads' share of the work: 32 ms. The binarize bench mode
+// checks this by default.
+void BinarizeImage(PixelKernel kernel, const uint32_t* src, uint32_t* dst, int width, int height, int window, WorkerPool* pool);
@@ -0,0 +1,117 @@
+#include "BlueNoise.h"
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+namespace {
+
+const int size = BLUE_NOISE_SIZE;
+const int area = size * size;
+
+// Ones in a binary pattern over the tile, with the Gaussian-weighted density of ones around
+// every position (wrapping at the edges). Toggling a position updates the density everywhere
+// from a precomputed kernel.
+class DensityField {
+private:
+    std::vector<float> kernel; // Weight by wrapped offset, indexed like the tile
+    std::vector<float> density;
+    std::vector<uint8_t> ones;
+
+public:
+    DensityField() : kernel(area), density(area, 0.0f), ones(area, 0) {
+        const float sigma = 1.5f;
+        for (int y = 0; y < size; y++) {
+            for (int x = 0; x < size; x++) {
+                int dx = x <= size / 2 ? x : size - x;
+                int dy = y <= size / 2 ? y : size - y;
+                kernel[y * size + x] = std::exp(-static_cast<float>(dx * dx + dy * dy) / (2.0f * sigma * sigma));
+            }
+        }
+    }
+
+    bool IsOne(int position) const { return ones[position] != 0; }
+
+    void Toggle(int position) {
+        float sign = ones[position] ? -1.0f : 1.0f;
+        ones[position] = !ones[position];
+        int px = position % size, py = position / size;
+        for (int y = 0; y < size; y++) {
+            const float* row = &kernel[((y - py) & (size - 1)) * size];
+            float* target = &density[y * size];
+            for (int x = 0; x < size; x++)
+                target[x] += sign * row[(x - px) & (size - 1)];
+        }
+    }
+
+    // The one in the densest cluster, or the zero in the largest void; the first on ties
+    int Tightest(bool one) const {
+        int found = -1;
+        for (int i = 0; i < area; i++) {
+            if (IsOne(i) == one && (found < 0 || (one ? density[i] > density[found] : density[i] < density[found])))
+                found = i;
+        }
+        return found;
+    }
+};
+
+}
+
+// Void and cluster (Ulichney 1993): rank the positions so every prefix of the ranking is as
+// evenly spread as possible
+void GenerateBlueNoise(float* thresholds) {
+    std::vector<int> rank(area);
+
+    // A random tenth of the positions, relaxed until moving the tightest one into the largest
+    // void no longer changes anything
+    DensityField initial;
+    std::mt19937 random(64);
+    int initialOnes = 0;
+    while (initialOnes < area / 10) {
+        int position = static_cast<int>(random() % area);
+        if (!initial.IsOne(position)) {
+            initial.Toggle(position);
+            initialOnes++;
+        }
+    }
+    for (int iteration = 0; iteration < area; iteration++) {
+        int cluster = initial.Tightest(true);
+        initial.Toggle(cluster);
+        int gap = initial.Tightest(false);
+        if (gap == cluster) {
+            initial.Toggle(cluster);
+            break;
+        }
+        initial.Toggle(gap);
+    }
+
+    // Lower ranks: take the initial ones away, tightest first
+    DensityField field = initial;
+    for (int remaining = initialOnes - 1; remaining >= 0; remaining--) {
+        int cluster = field.Tightest(true);
+        field.Toggle(cluster);
+        rank[cluster] = remaining;
+    }
+
+    // Higher ranks: fill the largest void until the tile is full. Past half full this is also
+    // the tightest cluster of the remaining zeros.
+    field = initial;
+    for (int filled = initialOnes; filled < area; filled++) {
+        int gap = field.Tightest(false);
+        field.Toggle(gap);
+        rank[gap] = filled;
+    }
+
+    for (int i = 0; i < area; i++)
+        thresholds[i] = (static_cast<float>(rank[i]) + 0.5f) / static_cast<float>(area);
+}
+
+// Generated on first use
+const float* BlueNoiseThresholds() {
+    static const std::vector<float> tile = [] {
+        std::vector<float> thresholds(area);
+        GenerateBlueNoise(thresholds.data());
+        return thresholds;
+    }();
+    return tile.data();
+}
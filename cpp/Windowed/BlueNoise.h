@@ -0,0 +1,18 @@
+#pragma once
+
+// Side of the square blue-noise threshold tile; a power of two, so positions wrap with a mask
+#define BLUE_NOISE_SIZE 64
+
+// Dither thresholds in (0, 1), one per pixel of a BLUE_NOISE_SIZE x BLUE_NOISE_SIZE tile that
+// repeats across the image, row by row. Every threshold occurs once, and neighbouring ones are
+// far apart: the pattern has little low-frequency content, so dithering with it reads as fine
+// grain instead of blotches. 16 KB, small enough to stay in the L1 cache while a frame is
+// dithered.
+//
+// Generated on first use with the void-and-cluster method (under 100 ms, deterministic);
+// thread-safe.
+const float* BlueNoiseThresholds();
+
+// Generate the tile into 'thresholds' (BLUE_NOISE_SIZE * BLUE_NOISE_SIZE entries). Exposed for
+// the benchmark; use BlueNoiseThresholds().
+void GenerateBlueNoise(float* thresholds);
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+// Time source for code that must run both in real time and against simulated time
+class Clock {
+public:
+    virtual ~Clock() {}
+
+    // Nanoseconds since an arbitrary origin; never decreases
+    virtual int64_t NowNs() = 0;
+
+    // Block until NowNs() >= timeNs
+    virtual void SleepUntilNs(int64_t timeNs) = 0;
+};
+
+// Wall-clock time from std::chrono::steady_clock
+class SteadyClock : public Clock {
+private:
+    std::chrono::steady_clock::time_point origin;
+
+public:
+    SteadyClock() : origin(std::chrono::steady_clock::now()) {}
+
+    int64_t NowNs() override {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - origin).count();
+    }
+
+    void SleepUntilNs(int64_t timeNs) override {
+        std::this_thread::sleep_until(origin + std::chrono::nanoseconds(timeNs));
+    }
+};
+
+// Simulated time that only moves when told to, so runs are deterministic and take no real time
+class VirtualClock : public Clock {
+private:
+    int64_t now;
+
+public:
+    VirtualClock() : now(0) {}
+
+    int64_t NowNs() override { return now; }
+
+    void SleepUntilNs(int64_t timeNs) override {
+        if (timeNs > now)
+            now = timeNs;
+    }
+
+    // Charge simulated time for work done
+    void AdvanceNs(int64_t durationNs) { now += durationNs; }
+};
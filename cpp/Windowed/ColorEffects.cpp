@@ -0,0 +1,341 @@
+#include "ColorEffects.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// Brightness of each white level: 100%, 80%, 60%, 40%
+const float GrayLevelScales[NUM_GRAY_LEVELS] = { 1.0f, 0.8f, 0.6f, 0.4f };
+
+const float SharpenStrengths[NUM_SHARPEN_LEVELS] = { 0.0f, 0.5f, 1.0f, 1.5f, 2.0f };
+
+namespace {
+
+// Linear map from RGB to cone (LMS) responses used by Vienot et al. (1999), as a column-vector
+// matrix. Applied to the gamma-encoded values the magnifier works on, like most daltonization
+// filters.
+const double rgbToLms[3][3] = {
+    { 17.8824, 43.5161, 4.11935 },
+    { 3.45565, 27.1554, 3.86714 },
+    { 0.0299566, 0.184309, 1.46709 },
+};
+
+// How much of the error a dichromat cannot see is moved into each channel. For protan and
+// deutan (Fidaner et al. 2005) red differences show up as changes in green and blue; tritan
+// mirrors it, moving blue differences into red and green.
+const double errorShift[2][3][3] = {
+    {
+        { 0.0, 0.0, 0.0 },
+        { 0.7, 1.0, 0.0 },
+        { 0.7, 0.0, 1.0 },
+    },
+    {
+        { 1.0, 0.0, 0.7 },
+        { 0.0, 1.0, 0.7 },
+        { 0.0, 0.0, 0.0 },
+    },
+};
+
+// Spacing of the color temperature table
+const int temperatureStep = 50;
+const int temperatureEntries = (COLOR_TEMPERATURE_MAX - COLOR_TEMPERATURE_MIN) / temperatureStep + 1;
+
+// Linear sRGB of the black body at 'kelvin', at a luminance of 1
+void PlanckianLinearRgb(double kelvin, double rgb[3]) {
+    double x, y;
+    PlanckianChromaticity(kelvin, x, y);
+    double X = x / y, Y = 1.0, Z = (1.0 - x - y) / y;
+    rgb[0] = 3.2406 * X - 1.5372 * Y - 0.4986 * Z;
+    rgb[1] = -0.9689 * X + 1.8758 * Y + 0.0415 * Z;
+    rgb[2] = 0.0557 * X - 0.2040 * Y + 1.0570 * Z;
+}
+
+// The black body's light relative to the neutral one, which the screen shows as white, scaled
+// so no channel clips. Below about 1900 K blue falls outside the sRGB gamut and goes negative;
+// the caller clamps, after interpolating, so the table stays smooth.
+void ComputeLinearTemperatureGains(double kelvin, double gains[3]) {
+    double rgb[3], neutral[3];
+    PlanckianLinearRgb(kelvin, rgb);
+    PlanckianLinearRgb(COLOR_TEMPERATURE_NEUTRAL, neutral);
+
+    double largest = 0.0;
+    for (int channel = 0; channel < 3; channel++) {
+        gains[channel] = rgb[channel] / neutral[channel];
+        largest = (std::max)(largest, gains[channel]);
+    }
+    for (int channel = 0; channel < 3; channel++)
+        gains[channel] /= largest;
+}
+
+// Missing cone of a vision mode: 0 (L) for protan, 1 (M) for deutan, 2 (S) for tritan
+int MissingCone(VisionMode mode) {
+    return (mode - VISION_SIMULATE_PROTAN) % 3;
+}
+
+void Multiply(const double a[3][3], const double b[3][3], double result[3][3]) {
+    for (int row = 0; row < 3; row++) {
+        for (int column = 0; column < 3; column++)
+            result[row][column] = a[row][0] * b[0][column] + a[row][1] * b[1][column] + a[row][2] * b[2][column];
+    }
+}
+
+void Invert(const double m[3][3], double result[3][3]) {
+    double determinant = m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1]) -
+        m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0]) +
+        m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+    for (int row = 0; row < 3; row++) {
+        for (int column = 0; column < 3; column++) {
+            // Cofactor of the transposed position
+            int r0 = (column + 1) % 3, r1 = (column + 2) % 3, c0 = (row + 1) % 3, c1 = (row + 2) % 3;
+            result[row][column] = (m[r0][c0] * m[r1][c1] - m[r0][c1] * m[r1][c0]) / determinant;
+        }
+    }
+}
+
+}
+
+const char* VisionModeName(int mode) {
+    static const char* const names[VISION_MODE_COUNT] = {
+        "Normal", "Protan sim.", "Deutan sim.", "Tritan sim.", "Protan fix", "Deutan fix", "Tritan fix"
+    };
+    return mode >= 0 && mode < VISION_MODE_COUNT ? names[mode] : names[VISION_NORMAL];
+}
+
+const char* PrivacyEffectName(int effect) {
+    static const char* const names[PRIVACY_EFFECT_COUNT] = { "", "Blur", "Pixelate" };
+    return effect >= 0 && effect < PRIVACY_EFFECT_COUNT ? names[effect] : names[PRIVACY_NONE];
+}
+
+// Weights of the remaining cones that keep white and one primary unchanged: blue for protan and
+// deutan, which Vienot et al. chose because dichromats see both the same as everyone else, and red
+// for tritan
+void DichromatProjection(VisionMode mode, double& a, double& b) {
+    int missing = MissingCone(mode);
+    int first = missing == 0 ? 1 : 0, second = missing == 2 ? 1 : 2;
+    int anchorPrimary = missing == 2 ? 0 : 2;
+
+    double white[3], anchor[3];
+    for (int cone = 0; cone < 3; cone++) {
+        white[cone] = rgbToLms[cone][0] + rgbToLms[cone][1] + rgbToLms[cone][2];
+        anchor[cone] = rgbToLms[cone][anchorPrimary];
+    }
+
+    // a * white[first] + b * white[second] = white[missing], likewise for the anchor
+    double determinant = white[first] * anchor[second] - white[second] * anchor[first];
+    a = (white[missing] * anchor[second] - white[second] * anchor[missing]) / determinant;
+    b = (white[first] * anchor[missing] - white[missing] * anchor[first]) / determinant;
+}
+
+// Chromaticity of a black body
+void PlanckianChromaticity(double kelvin, double& x, double& y) {
+    double t = kelvin, t2 = t * t, t3 = t2 * t;
+    if (t <= 4000.0)
+        x = -0.2661239e9 / t3 - 0.2343589e6 / t2 + 0.8776956e3 / t + 0.179910;
+    else
+        x = -3.0258469e9 / t3 + 2.1070379e6 / t2 + 0.2226347e3 / t + 0.240390;
+
+    double x2 = x * x, x3 = x2 * x;
+    if (t <= 2222.0)
+        y = -1.1063814 * x3 - 1.34811020 * x2 + 2.18555832 * x - 0.20219683;
+    else if (t <= 4000.0)
+        y = -0.9549476 * x3 - 1.37418593 * x2 + 2.09137015 * x - 0.16748867;
+    else
+        y = 3.0817580 * x3 - 5.87338670 * x2 + 3.75112997 * x - 0.37001483;
+}
+
+// Gains of light converted to gains of the gamma-encoded values the matrix scales
+void ComputeColorTemperatureGains(double kelvin, double gains[3]) {
+    ComputeLinearTemperatureGains(kelvin, gains);
+    for (int channel = 0; channel < 3; channel++)
+        gains[channel] = std::pow((std::max)(gains[channel], 0.0), 1.0 / 2.2);
+}
+
+// Gains for a color temperature, interpolated from the table. The table holds gains of light,
+// which vary smoothly; encoded gains are steep near 0 and would not interpolate as well.
+void ColorTemperatureGains(int kelvin, float gains[3]) {
+    struct Table {
+        float gains[temperatureEntries][3];
+
+        Table() {
+            for (int entry = 0; entry < temperatureEntries; entry++) {
+                double computed[3];
+                ComputeLinearTemperatureGains(COLOR_TEMPERATURE_MIN + entry * temperatureStep, computed);
+                for (int channel = 0; channel < 3; channel++)
+                    gains[entry][channel] = static_cast<float>(computed[channel]);
+            }
+        }
+    };
+    static const Table table;
+
+    kelvin = (std::min)((std::max)(kelvin, COLOR_TEMPERATURE_MIN), COLOR_TEMPERATURE_MAX);
+    int entry = (kelvin - COLOR_TEMPERATURE_MIN) / temperatureStep;
+    int next = (std::min)(entry + 1, temperatureEntries - 1);
+    float t = static_cast<float>((kelvin - COLOR_TEMPERATURE_MIN) % temperatureStep) / temperatureStep;
+    for (int channel = 0; channel < 3; channel++) {
+        float gain = table.gains[entry][channel] + (table.gains[next][channel] - table.gains[entry][channel]) * t;
+        gains[channel] = std::pow((std::max)(gain, 0.0f), 1.0f / 2.2f);
+    }
+}
+
+// Build a vision effect matrix for a severity in 0..1
+void ComputeVisionMatrix(VisionMode mode, double severity, ColorMatrix& matrix) {
+    double result[3][3] = { { 1.0, 0.0, 0.0 }, { 0.0, 1.0, 0.0 }, { 0.0, 0.0, 1.0 } };
+
+    if (mode > VISION_NORMAL && mode < VISION_MODE_COUNT) {
+        // Simulation: into LMS, replace the missing cone, back to RGB
+        double projection[3][3] = { { 1.0, 0.0, 0.0 }, { 0.0, 1.0, 0.0 }, { 0.0, 0.0, 1.0 } };
+        int missing = MissingCone(mode);
+        double a, b;
+        DichromatProjection(mode, a, b);
+        projection[missing][missing] = 0.0;
+        projection[missing][missing == 0 ? 1 : 0] = a;
+        projection[missing][missing == 2 ? 1 : 2] = b;
+
+        double lmsToRgb[3][3], projected[3][3], simulation[3][3];
+        Invert(rgbToLms, lmsToRgb);
+        Multiply(projection, rgbToLms, projected);
+        Multiply(lmsToRgb, projected, simulation);
+
+        // Anomalous trichromacy as a blend towards the dichromat's view
+        for (int row = 0; row < 3; row++) {
+            for (int column = 0; column < 3; column++)
+                simulation[row][column] = result[row][column] + severity * (simulation[row][column] - result[row][column]);
+        }
+
+        if (mode >= VISION_CORRECT_PROTAN) {
+            // Correction: add the shifted difference between the original and what is seen
+            double lost[3][3], shifted[3][3];
+            for (int row = 0; row < 3; row++) {
+                for (int column = 0; column < 3; column++)
+                    lost[row][column] = (row == column ? 1.0 : 0.0) - simulation[row][column];
+            }
+            Multiply(errorShift[missing == 2 ? 1 : 0], lost, shifted);
+            for (int row = 0; row < 3; row++) {
+                for (int column = 0; column < 3; column++)
+                    result[row][column] += shifted[row][column];
+            }
+        } else {
+            memcpy(result, simulation, sizeof(result));
+        }
+    }
+
+    // Column vectors above, row vectors in a ColorMatrix
+    memset(&matrix, 0, sizeof(ColorMatrix));
+    for (int row = 0; row < 3; row++) {
+        for (int column = 0; column < 3; column++)
+            matrix.transform[row][column] = static_cast<float>(result[column][row]);
+    }
+    matrix.transform[3][3] = 1.0f;
+    matrix.transform[4][4] = 1.0f;
+}
+
+// Matrix of a vision effect at a severity step
+const ColorMatrix& VisionMatrix(int mode, int severity) {
+    struct Table {
+        ColorMatrix matrices[VISION_MODE_COUNT][NUM_VISION_SEVERITIES];
+
+        Table() {
+            for (int m = 0; m < VISION_MODE_COUNT; m++) {
+                for (int step = 0; step < NUM_VISION_SEVERITIES; step++)
+                    ComputeVisionMatrix(static_cast<VisionMode>(m), static_cast<double>(step) / (NUM_VISION_SEVERITIES - 1), matrices[m][step]);
+            }
+        }
+    };
+    static const Table table;
+
+    if (mode < 0 || mode >= VISION_MODE_COUNT || severity < 0 || severity >= NUM_VISION_SEVERITIES)
+        return table.matrices[VISION_NORMAL][0];
+    return table.matrices[mode][severity];
+}
+
+// Build the matrix for the given settings
+void CalculateColorMatrix(const ColorEffectSettings& settings, ColorMatrix& matrix) {
+    // Initialize identity matrix
+    memset(&matrix, 0, sizeof(ColorMatrix));
+    matrix.transform[0][0] = 1.0f; // Red
+    matrix.transform[1][1] = 1.0f; // Green
+    matrix.transform[2][2] = 1.0f; // Blue
+    matrix.transform[3][3] = 1.0f; // Alpha
+    matrix.transform[4][4] = 1.0f; // Translation
+
+    // A privacy effect hides the contents: every color maps to mid gray
+    if (settings.privacyEffect != PRIVACY_NONE) {
+        for (int channel = 0; channel < 3; channel++) {
+            matrix.transform[channel][channel] = 0.0f;
+            matrix.transform[4][channel] = 0.5f;
+        }
+        return;
+    }
+
+    // Apply grayscale conversion if enabled
+    if (settings.grayscaleEnabled || settings.binarizeEnabled) {
+        // Luminance weights for RGB to grayscale conversion
+        float rWeight = 0.299f;
+        float gWeight = 0.587f;
+        float bWeight = 0.114f;
+
+        // Set all RGB channels to use the same luminance calculation
+        matrix.transform[0][0] = rWeight; matrix.transform[0][1] = rWeight; matrix.transform[0][2] = rWeight;
+        matrix.transform[1][0] = gWeight; matrix.transform[1][1] = gWeight; matrix.transform[1][2] = gWeight;
+        matrix.transform[2][0] = bWeight; matrix.transform[2][1] = bWeight; matrix.transform[2][2] = bWeight;
+    }
+
+    // Apply inversion if enabled, unless SmartInvertImage() does it tile by tile
+    if (settings.inversionEnabled && !settings.smartInvert) {
+        // Invert RGB channels
+        for (int row = 0; row < 3; row++) {
+            for (int column = 0; column < 3; column++)
+                matrix.transform[row][column] *= -1.0f;
+        }
+
+        // Add inversion offset
+        matrix.transform[4][0] = 1.0f; // Red offset
+        matrix.transform[4][1] = 1.0f; // Green offset
+        matrix.transform[4][2] = 1.0f; // Blue offset
+    }
+
+    // Apply gray level scaling (brightness reduction)
+    int level = (settings.grayLevel >= 0 && settings.grayLevel < NUM_GRAY_LEVELS) ? settings.grayLevel : 0;
+    float scale = GrayLevelScales[level];
+
+    if (scale != 1.0f) {
+        // Scale RGB channels
+        for (int row = 0; row < 3; row++) {
+            for (int column = 0; column < 3; column++)
+                matrix.transform[row][column] *= scale;
+        }
+
+        // Scale translation components if inversion is enabled
+        if (settings.inversionEnabled) {
+            matrix.transform[4][0] *= scale;
+            matrix.transform[4][1] *= scale;
+            matrix.transform[4][2] *= scale;
+        }
+    }
+
+    // Apply the vision effect ahead of the rest: pixel * vision * matrix. It has no offsets, so
+    // only the color rows change.
+    if (settings.visionMode != VISION_NORMAL) {
+        const ColorMatrix& vision = VisionMatrix(settings.visionMode, settings.visionSeverity);
+        float product[3][3];
+        for (int row = 0; row < 3; row++) {
+            for (int column = 0; column < 3; column++) {
+                product[row][column] = vision.transform[row][0] * matrix.transform[0][column] +
+                    vision.transform[row][1] * matrix.transform[1][column] + vision.transform[row][2] * matrix.transform[2][column];
+            }
+        }
+        for (int row = 0; row < 3; row++) {
+            for (int column = 0; column < 3; column++)
+                matrix.transform[row][column] = product[row][column];
+        }
+    }
+
+    // Apply the color temperature to the result, offsets included: matrix * gains
+    if (settings.colorTemperature != COLOR_TEMPERATURE_NEUTRAL) {
+        float gains[3];
+        ColorTemperatureGains(settings.colorTemperature, gains);
+        for (int row = 0; row < 5; row++) {
+            for (int column = 0; column < 3; column++)
+                matrix.transform[row][column] *= gains[column];
+        }
+    }
+}
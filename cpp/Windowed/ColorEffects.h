@@ -0,0 +1,142 @@
+#pragma once
+
+#define NUM_GRAY_LEVELS 4
+
+// Strength steps of the sharpening stage; level 0 is off
+#define NUM_SHARPEN_LEVELS 5
+
+// Severity steps of the vision effects: 0%, 10%, ... 100%
+#define NUM_VISION_SEVERITIES 11
+
+// White point color temperature in Kelvin. Neutral leaves colors as they are; lower is warmer
+// (less blue), like a night light, higher is cooler.
+#define COLOR_TEMPERATURE_NEUTRAL 6500
+#define COLOR_TEMPERATURE_MIN 1700
+#define COLOR_TEMPERATURE_MAX 10000
+
+// Sizes of the privacy effects, in pixels: the blur radius (the box is 2 * radius + 1 wide) and
+// the side of a pixelation block
+#define PRIVACY_BLUR_RADIUS_DEFAULT 24
+#define PRIVACY_BLUR_RADIUS_MAX 256
+#define PRIVACY_PIXELATE_BLOCK_DEFAULT 16
+#define PRIVACY_PIXELATE_BLOCK_MIN 2
+#define PRIVACY_PIXELATE_BLOCK_MAX 256
+
+// Side of the square window the binarization threshold is computed over, in pixels; odd. The
+// largest keeps a window's sum of squared luminances within 31 bits.
+#define BINARIZE_WINDOW_DEFAULT 31
+#define BINARIZE_WINDOW_MIN 3
+#define BINARIZE_WINDOW_MAX 127
+
+// Color vision deficiency effects. Simulation shows how someone with the deficiency sees the
+// screen; correction (daltonization) moves the color differences they cannot see into ones they
+// can. Protan and deutan follow Vienot, Brettel and Mollon (1999); tritan uses the same
+// single-plane projection, through white and red, which only approximates Brettel's two
+// half-planes.
+enum VisionMode {
+    VISION_NORMAL,
+    VISION_SIMULATE_PROTAN,
+    VISION_SIMULATE_DEUTAN,
+    VISION_SIMULATE_TRITAN,
+    VISION_CORRECT_PROTAN,
+    VISION_CORRECT_DEUTAN,
+    VISION_CORRECT_TRITAN,
+    VISION_MODE_COUNT
+};
+
+// Effects that hide a region's contents, e.g. a panel with credentials during a screen share,
+// instead of filtering its colors. They replace the color effects while on: the CPU path blurs
+// or pixelates the captured image (PrivacyEffects.h). The magnifier, which can only apply a color
+// matrix, covers the region with flat gray until the first blurred frame is ready.
+enum PrivacyEffect {
+    PRIVACY_NONE,
+    PRIVACY_BLUR,
+    PRIVACY_PIXELATE,
+    PRIVACY_EFFECT_COUNT
+};
+
+// Color transformation in the layout of the Magnification API's MAGCOLOREFFECT: a pixel is
+// the row vector [R G B A 1] with channels in 0..1, the result is pixel * transform, and
+// row 4 holds the per-channel offsets
+struct ColorMatrix {
+    float transform[5][5];
+};
+
+// Color effect state of one filter window
+struct ColorEffectSettings {
+    bool inversionEnabled;
+    bool grayscaleEnabled;
+    int grayLevel; // Index into GrayLevelScales
+    int visionMode; // VisionMode
+    int visionSeverity; // 0..NUM_VISION_SEVERITIES - 1, in tenths
+    int colorTemperature; // Kelvin, COLOR_TEMPERATURE_MIN..COLOR_TEMPERATURE_MAX
+    int sharpenLevel; // Index into SharpenStrengths; not part of the matrix, applied by the CPU path
+    int privacyEffect; // PrivacyEffect; overrides all of the above while on
+    int blurRadius; // 0..PRIVACY_BLUR_RADIUS_MAX
+    int pixelateBlock; // PRIVACY_PIXELATE_BLOCK_MIN..PRIVACY_PIXELATE_BLOCK_MAX
+    bool binarizeEnabled; // Black and white by local threshold (BinarizeImage), ahead of the matrix
+    int binarizeWindow; // BINARIZE_WINDOW_MIN..BINARIZE_WINDOW_MAX, odd
+    bool autoInvert; // inversionEnabled follows the brightness of the contents (AutoInvertDetector)
+    bool smartInvert; // inversionEnabled spares photos and dark content (SmartInvertImage), on the CPU path
+
+    ColorEffectSettings()
+        : inversionEnabled(false), grayscaleEnabled(false), grayLevel(0), visionMode(VISION_NORMAL),
+          visionSeverity(NUM_VISION_SEVERITIES - 1), colorTemperature(COLOR_TEMPERATURE_NEUTRAL), sharpenLevel(0),
+          privacyEffect(PRIVACY_NONE), blurRadius(PRIVACY_BLUR_RADIUS_DEFAULT), pixelateBlock(PRIVACY_PIXELATE_BLOCK_DEFAULT),
+          binarizeEnabled(false), binarizeWindow(BINARIZE_WINDOW_DEFAULT), autoInvert(false),
+          smartInvert(false) {}
+
+    bool operator==(const ColorEffectSettings& other) const {
+        return inversionEnabled == other.inversionEnabled && grayscaleEnabled == other.grayscaleEnabled && grayLevel == other.grayLevel &&
+            visionMode == other.visionMode && visionSeverity == other.visionSeverity && colorTemperature == other.colorTemperature &&
+            sharpenLevel == other.sharpenLevel && privacyEffect == other.privacyEffect && blurRadius == other.blurRadius &&
+            pixelateBlock == other.pixelateBlock && binarizeEnabled == other.binarizeEnabled && binarizeWindow == other.binarizeWindow &&
+            autoInvert == other.autoInvert && smartInvert == other.smartInvert;
+    }
+    bool operator!=(const ColorEffectSettings& other) const { return !(*this == other); }
+};
+
+// Brightness of each white level: 100%, 80%, 60%, 40%
+extern const float GrayLevelScales[NUM_GRAY_LEVELS];
+
+// Unsharp mask amount of each sharpening level (SharpenImage): off, 50%, 100%, 150%, 200%
+extern const float SharpenStrengths[NUM_SHARPEN_LEVELS];
+
+// Short name for titles and reports, e.g. "Protan sim."
+const char* VisionModeName(int mode);
+
+// Short name for titles and reports: "Blur", "Pixelate", or "" for none
+const char* PrivacyEffectName(int effect);
+
+// Matrix of a vision effect at a severity step, from a table built on first use, so switching
+// modes costs a lookup. Out-of-range arguments give the identity. Thread-safe.
+const ColorMatrix& VisionMatrix(int mode, int severity);
+
+// Build a vision effect matrix for any severity in 0..1 (what the table holds at each step)
+void ComputeVisionMatrix(VisionMode mode, double severity, ColorMatrix& matrix);
+
+// Cone response the dichromat of a simulation mode lacks, as the weights of the two remaining
+// cones that replace it in LMS space: L = a*M + b*S for protan, M = a*L + b*S for deutan,
+// S = a*L + b*M for tritan. Exposed so the weights can be checked against published values.
+void DichromatProjection(VisionMode mode, double& a, double& b);
+
+// Chromaticity (CIE 1931 xy) of a black body at 'kelvin', from the cubic approximation of the
+// Planckian locus by Kim et al. (2002); valid from 1667 K to 25000 K
+void PlanckianChromaticity(double kelvin, double& x, double& y);
+
+// Gains of the red, green and blue output channels that shift the white point to a color
+// temperature, for gamma-encoded values and scaled so the largest is 1. Interpolated from a
+// table built on first use in 50 K steps, so a drag across temperatures does no allocation and
+// none of the black-body math. Clamps to COLOR_TEMPERATURE_MIN..MAX. Thread-safe.
+void ColorTemperatureGains(int kelvin, float gains[3]);
+
+// Gains computed directly for any temperature in range (what the table holds at each step)
+void ComputeColorTemperatureGains(double kelvin, double gains[3]);
+
+// Build the matrix for the given settings. The vision effect applies first, to the screen's
+// colors, then grayscale, inversion and the white level, and the color temperature last, to
+// the light that reaches the eye. With a privacy effect on, the flat gray that covers the region.
+// Binarization implies grayscale: the CPU path thresholds the image before the matrix, which
+// leaves black and white as they are. With smart inversion on, inversion is left out: the CPU path inverts the
+// text before the matrix.
+void CalculateColorMatrix(const ColorEffectSettings& settings, ColorMatrix& matrix);
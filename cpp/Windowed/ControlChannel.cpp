@@ -0,0 +1,360 @@
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+#endif
+
+#include "ControlChannel.h"
+#include <cstring>
+
+namespace {
+
+const intptr_t invalidHandle = -1;
+const int pollIntervalMs = 200; // How often blocked threads check for Stop()
+
+#ifdef _WIN32
+std::string PipePath(const std::string& name) {
+    return "\\\\.\\pipe\\" + name;
+}
+
+HANDLE CreatePipeInstance(const std::string& name, bool first) {
+    return CreateNamedPipeA(PipePath(name).c_str(),
+        PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED | (first ? FILE_FLAG_FIRST_PIPE_INSTANCE : 0),
+        PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+        PIPE_UNLIMITED_INSTANCES, 64 * 1024, 64 * 1024, 0, NULL);
+}
+#endif
+
+// Read what is available, waiting up to timeoutMs. Returns the byte count, 0 on timeout,
+// or -1 once the other end has closed the connection.
+int ReadSome(intptr_t connection, uint8_t* buffer, size_t size, int timeoutMs) {
+#ifdef _WIN32
+    HANDLE handle = reinterpret_cast<HANDLE>(connection);
+    OVERLAPPED overlapped = {};
+    overlapped.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    DWORD transferred = 0;
+    int result = -1;
+    if (ReadFile(handle, buffer, static_cast<DWORD>(size), &transferred, &overlapped)) {
+        result = transferred > 0 ? static_cast<int>(transferred) : -1;
+    } else if (GetLastError() == ERROR_IO_PENDING) {
+        if (WaitForSingleObject(overlapped.hEvent, static_cast<DWORD>(timeoutMs)) == WAIT_TIMEOUT) {
+            // Cancel, but keep anything that arrived in the meantime
+            CancelIoEx(handle, &overlapped);
+            if (GetOverlappedResult(handle, &overlapped, &transferred, TRUE))
+                result = static_cast<int>(transferred);
+            else
+                result = GetLastError() == ERROR_OPERATION_ABORTED ? 0 : -1;
+        } else if (GetOverlappedResult(handle, &overlapped, &transferred, FALSE) && transferred > 0) {
+            result = static_cast<int>(transferred);
+        }
+    }
+    CloseHandle(overlapped.hEvent);
+    return result;
+#else
+    pollfd descriptor = { static_cast<int>(connection), POLLIN, 0 };
+    int ready = poll(&descriptor, 1, timeoutMs);
+    if (ready == 0 || (ready < 0 && errno == EINTR))
+        return 0;
+    if (ready < 0)
+        return -1;
+
+    ssize_t received = recv(static_cast<int>(connection), buffer, size, 0);
+    if (received < 0 && errno == EINTR)
+        return 0;
+    return received > 0 ? static_cast<int>(received) : -1;
+#endif
+}
+
+bool WriteAll(intptr_t connection, const uint8_t* data, size_t size) {
+    while (size > 0) {
+#ifdef _WIN32
+        HANDLE handle = reinterpret_cast<HANDLE>(connection);
+        OVERLAPPED overlapped = {};
+        overlapped.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+        DWORD written = 0;
+        BOOL done = WriteFile(handle, data, static_cast<DWORD>(size), &written, &overlapped);
+        if (!done && GetLastError() == ERROR_IO_PENDING)
+            done = GetOverlappedResult(handle, &overlapped, &written, TRUE);
+        CloseHandle(overlapped.hEvent);
+        if (!done)
+            return false;
+#else
+        ssize_t written = send(static_cast<int>(connection), data, size, MSG_NOSIGNAL);
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written <= 0)
+            return false;
+#endif
+        data += written;
+        size -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+void CloseConnection(intptr_t connection) {
+    if (connection == invalidHandle)
+        return;
+#ifdef _WIN32
+    CloseHandle(reinterpret_cast<HANDLE>(connection));
+#else
+    close(static_cast<int>(connection));
+#endif
+}
+
+}
+
+ControlServer::ControlServer(ControlBatchHandler batchHandler)
+    : handler(batchHandler), stopping(false), listenHandle(invalidHandle) {
+}
+
+ControlServer::~ControlServer() {
+    Stop();
+}
+
+// Start listening on a socket path or pipe name
+bool ControlServer::Start(const std::string& name) {
+    Stop();
+    endpoint = name;
+    stopping = false;
+
+#ifdef _WIN32
+    // The first instance fails if another process already serves this name
+    HANDLE pipe = CreatePipeInstance(name, true);
+    if (pipe == INVALID_HANDLE_VALUE)
+        return false;
+    listenHandle = reinterpret_cast<intptr_t>(pipe);
+#else
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (name.empty() || name.size() >= sizeof(address.sun_path))
+        return false;
+    memcpy(address.sun_path, name.c_str(), name.size());
+
+    // Replace a socket left behind by a process that did not shut down cleanly, but nothing else:
+    // not a file, and not the socket of an instance that is still running (it accepts the probe)
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return false;
+    struct stat existing;
+    if (stat(name.c_str(), &existing) == 0 && S_ISSOCK(existing.st_mode)) {
+        bool stale = connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 && errno == ECONNREFUSED;
+        close(fd);
+        if (!stale)
+            return false;
+        unlink(name.c_str());
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0)
+            return false;
+    }
+    if (bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        chmod(name.c_str(), S_IRUSR | S_IWUSR) != 0 || listen(fd, 16) != 0) {
+        close(fd);
+        return false;
+    }
+    listenHandle = fd;
+#endif
+
+    listener = std::thread(&ControlServer::Listen, this);
+    return true;
+}
+
+void ControlServer::Stop() {
+    stopping = true;
+    if (listener.joinable())
+        listener.join();
+
+    {
+        std::lock_guard<std::mutex> guard(connectionsLock);
+        for (const std::unique_ptr<Connection>& connection : connections)
+            connection->thread.join();
+        connections.clear();
+    }
+
+    if (listenHandle != invalidHandle) {
+        CloseConnection(listenHandle);
+        listenHandle = invalidHandle;
+#ifndef _WIN32
+        unlink(endpoint.c_str());
+#endif
+    }
+}
+
+// Accept connections until Stop(), giving each its own thread
+void ControlServer::Listen() {
+    while (!stopping) {
+        intptr_t connection = invalidHandle;
+#ifdef _WIN32
+        HANDLE pipe = reinterpret_cast<HANDLE>(listenHandle);
+        OVERLAPPED overlapped = {};
+        overlapped.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+        BOOL connected = ConnectNamedPipe(pipe, &overlapped);
+        DWORD error = GetLastError();
+        if (!connected && error == ERROR_PIPE_CONNECTED) {
+            connected = TRUE;
+        } else if (!connected && error == ERROR_IO_PENDING) {
+            while (!stopping && WaitForSingleObject(overlapped.hEvent, pollIntervalMs) == WAIT_TIMEOUT) {
+            }
+            if (stopping)
+                CancelIoEx(pipe, &overlapped);
+            DWORD transferred;
+            connected = GetOverlappedResult(pipe, &overlapped, &transferred, TRUE) && !stopping;
+        }
+        CloseHandle(overlapped.hEvent);
+        if (!connected) {
+            DisconnectNamedPipe(pipe);
+            continue;
+        }
+
+        // The connected instance goes to its thread; a fresh one waits for the next client
+        HANDLE next = CreatePipeInstance(endpoint, false);
+        connection = listenHandle;
+        listenHandle = next == INVALID_HANDLE_VALUE ? invalidHandle : reinterpret_cast<intptr_t>(next);
+#else
+        pollfd descriptor = { static_cast<int>(listenHandle), POLLIN, 0 };
+        if (poll(&descriptor, 1, pollIntervalMs) <= 0)
+            continue;
+        int fd = accept(static_cast<int>(listenHandle), NULL, NULL);
+        if (fd < 0)
+            continue;
+        connection = fd;
+#endif
+
+        {
+            // Join the threads of clients that have gone, so a long-running server holds only
+            // the live ones
+            std::lock_guard<std::mutex> guard(connectionsLock);
+            for (size_t i = 0; i < connections.size();) {
+                if (connections[i]->done.load()) {
+                    connections[i]->thread.join();
+                    connections[i] = std::move(connections.back());
+                    connections.pop_back();
+                } else {
+                    i++;
+                }
+            }
+            connections.emplace_back(new Connection());
+            connections.back()->thread = std::thread(&ControlServer::Serve, this, connection, connections.back().get());
+        }
+#ifdef _WIN32
+        if (listenHandle == invalidHandle)
+            break;
+#endif
+    }
+}
+
+// Answer one client until it disconnects, sends garbage or the server stops
+void ControlServer::Serve(intptr_t handle, Connection* connection) {
+    ControlDecoder decoder;
+    uint8_t buffer[16 * 1024];
+    std::vector<ControlRequest> requests;
+    std::vector<ControlResponse> responses;
+    std::vector<uint8_t> output;
+
+    while (!stopping) {
+        int received = ReadSome(handle, buffer, sizeof(buffer), pollIntervalMs);
+        if (received < 0)
+            break;
+        if (received == 0)
+            continue;
+        decoder.Append(buffer, static_cast<size_t>(received));
+
+        // Everything that has arrived is one batch
+        requests.clear();
+        ControlRequest request;
+        ControlDecoder::Result result;
+        while ((result = decoder.Next(request)) == ControlDecoder::MESSAGE)
+            requests.push_back(request);
+
+        if (!requests.empty()) {
+            responses.clear();
+            handler(requests, responses);
+            output.clear();
+            for (const ControlResponse& response : responses)
+                EncodeControlMessage(response, output);
+            if (!WriteAll(handle, output.data(), output.size()))
+                break;
+        }
+        if (result == ControlDecoder::MALFORMED)
+            break;
+    }
+    CloseConnection(handle);
+    connection->done.store(true);
+}
+
+ControlClient::ControlClient() : connection(invalidHandle) {
+}
+
+ControlClient::~ControlClient() {
+    Close();
+}
+
+bool ControlClient::Connect(const std::string& name) {
+    Close();
+    decoder = ControlDecoder();
+
+#ifdef _WIN32
+    std::string path = PipePath(name);
+    for (int attempt = 0; attempt < 2; attempt++) {
+        HANDLE pipe = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, FILE_FLAG_OVERLAPPED, NULL);
+        if (pipe != INVALID_HANDLE_VALUE) {
+            connection = reinterpret_cast<intptr_t>(pipe);
+            return true;
+        }
+        // Every instance is taken until the server creates the next one
+        if (GetLastError() != ERROR_PIPE_BUSY || !WaitNamedPipeA(path.c_str(), 2000))
+            return false;
+    }
+    return false;
+#else
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (name.empty() || name.size() >= sizeof(address.sun_path))
+        return false;
+    memcpy(address.sun_path, name.c_str(), name.size());
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return false;
+    if (connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        close(fd);
+        return false;
+    }
+    connection = fd;
+    return true;
+#endif
+}
+
+void ControlClient::Close() {
+    CloseConnection(connection);
+    connection = invalidHandle;
+}
+
+bool ControlClient::Send(const std::vector<uint8_t>& data) {
+    return connection != invalidHandle && WriteAll(connection, data.data(), data.size());
+}
+
+// Wait for data and decode every complete response
+bool ControlClient::Receive(std::vector<ControlResponse>& responses, int timeoutMs) {
+    if (connection == invalidHandle)
+        return false;
+
+    uint8_t buffer[16 * 1024];
+    int received = ReadSome(connection, buffer, sizeof(buffer), timeoutMs);
+    if (received < 0)
+        return false;
+    decoder.Append(buffer, static_cast<size_t>(received));
+
+    ControlResponse response;
+    ControlDecoder::Result result;
+    while ((result = decoder.Next(response)) == ControlDecoder::MESSAGE)
+        responses.push_back(response);
+    return result != ControlDecoder::MALFORMED;
+}
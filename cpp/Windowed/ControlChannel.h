@@ -0,0 +1,72 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "ControlProtocol.h"
+
+// Executes one batch: every request that arrived together on a connection, in order, with one
+// response per request. May be called from several connection threads at once.
+typedef std::function<void(const std::vector<ControlRequest>& requests, std::vector<ControlResponse>& responses)> ControlBatchHandler;
+
+// Local endpoint for scripted control: a Unix domain socket, or on Windows a named pipe
+// (\\.\pipe\<name>) that rejects remote clients. Each connection is served by its own thread,
+// which reads whatever requests have arrived, hands them to the handler as one batch and
+// writes all the responses back in one go.
+class ControlServer {
+private:
+    // Thread serving one client; 'done' is set as it exits, so the listener can reap it
+    struct Connection {
+        std::thread thread;
+        std::atomic<bool> done;
+
+        Connection() : done(false) {}
+    };
+
+    ControlBatchHandler handler;
+    std::string endpoint;
+    std::atomic<bool> stopping;
+    std::thread listener;
+    std::mutex connectionsLock;
+    std::vector<std::unique_ptr<Connection>> connections;
+    intptr_t listenHandle;
+
+    void Listen();
+    void Serve(intptr_t handle, Connection* connection);
+
+public:
+    explicit ControlServer(ControlBatchHandler batchHandler);
+    ~ControlServer();
+
+    // Start listening. 'name' is a socket path, or on Windows the pipe name.
+    bool Start(const std::string& name);
+    void Stop();
+
+    bool IsRunning() const { return listener.joinable(); }
+};
+
+// Client side of the control channel, used by scripts' helpers and the load test
+class ControlClient {
+private:
+    intptr_t connection;
+    ControlDecoder decoder;
+
+public:
+    ControlClient();
+    ~ControlClient();
+
+    bool Connect(const std::string& name);
+    void Close();
+
+    // Send encoded requests (see EncodeControlMessage)
+    bool Send(const std::vector<uint8_t>& data);
+
+    // Wait up to timeoutMs for data and append every complete response to 'responses'.
+    // Returns false if the connection was closed or the stream is malformed.
+    bool Receive(std::vector<ControlResponse>& responses, int timeoutMs);
+};
@@ -0,0 +1,186 @@
+#include "ControlProtocol.h"
+#include <cstring>
+#include "SavedRectanglesManager.h"
+
+namespace {
+
+void WriteUint32(uint8_t* out, uint32_t value) {
+    out[0] = static_cast<uint8_t>(value);
+    out[1] = static_cast<uint8_t>(value >> 8);
+    out[2] = static_cast<uint8_t>(value >> 16);
+    out[3] = static_cast<uint8_t>(value >> 24);
+}
+
+uint32_t ReadUint32(const uint8_t* in) {
+    return static_cast<uint32_t>(in[0]) | (static_cast<uint32_t>(in[1]) << 8) |
+        (static_cast<uint32_t>(in[2]) << 16) | (static_cast<uint32_t>(in[3]) << 24);
+}
+
+}
+
+bool PutUint8(ControlMessage& message, uint8_t value) {
+    if (message.length + 1 > CONTROL_MAX_PAYLOAD)
+        return false;
+    message.payload[message.length++] = value;
+    return true;
+}
+
+bool PutInt32(ControlMessage& message, int32_t value) {
+    if (message.length + 4 > CONTROL_MAX_PAYLOAD)
+        return false;
+    WriteUint32(message.payload + message.length, static_cast<uint32_t>(value));
+    message.length += 4;
+    return true;
+}
+
+int32_t GetInt32(const ControlMessage& message, size_t offset) {
+    return static_cast<int32_t>(ReadUint32(message.payload + offset));
+}
+
+void PutState(ControlMessage& message, const ControlState& state) {
+    PutUint8(message, state.flags);
+    PutUint8(message, state.grayLevel);
+    PutUint8(message, 0);
+    PutUint8(message, 0);
+    PutInt32(message, state.left);
+    PutInt32(message, state.top);
+    PutInt32(message, state.right);
+    PutInt32(message, state.bottom);
+}
+
+bool GetState(const ControlMessage& message, ControlState& state) {
+    if (message.length < 20)
+        return false;
+    state.flags = message.payload[0];
+    state.grayLevel = message.payload[1];
+    state.left = GetInt32(message, 4);
+    state.top = GetInt32(message, 8);
+    state.right = GetInt32(message, 12);
+    state.bottom = GetInt32(message, 16);
+    return true;
+}
+
+// Append the wire form of a message
+void EncodeControlMessage(const ControlMessage& message, std::vector<uint8_t>& out) {
+    size_t start = out.size();
+    out.resize(start + CONTROL_HEADER_SIZE + message.length);
+    WriteUint32(&out[start], message.sequence);
+    out[start + 4] = message.code;
+    out[start + 5] = message.length;
+    out[start + 6] = 0;
+    out[start + 7] = 0;
+    if (message.length > 0)
+        memcpy(&out[start + CONTROL_HEADER_SIZE], message.payload, message.length);
+}
+
+void ControlDecoder::Append(const uint8_t* data, size_t size) {
+    // Drop consumed bytes before growing, so a long-lived connection does not accumulate them
+    if (readPosition > 0 && readPosition == buffer.size()) {
+        buffer.clear();
+        readPosition = 0;
+    } else if (readPosition > 4096) {
+        buffer.erase(buffer.begin(), buffer.begin() + readPosition);
+        readPosition = 0;
+    }
+    buffer.insert(buffer.end(), data, data + size);
+}
+
+// Take the next complete message
+ControlDecoder::Result ControlDecoder::Next(ControlMessage& message) {
+    size_t available = buffer.size() - readPosition;
+    if (available < CONTROL_HEADER_SIZE)
+        return NEED_MORE;
+
+    const uint8_t* header = &buffer[readPosition];
+    uint8_t length = header[5];
+    if (length > CONTROL_MAX_PAYLOAD || header[6] != 0 || header[7] != 0)
+        return MALFORMED;
+    if (available < static_cast<size_t>(CONTROL_HEADER_SIZE + length))
+        return NEED_MORE;
+
+    message.sequence = ReadUint32(header);
+    message.code = header[4];
+    message.length = length;
+    memcpy(message.payload, header + CONTROL_HEADER_SIZE, length);
+    readPosition += CONTROL_HEADER_SIZE + length;
+    return MESSAGE;
+}
+
+// Validate a request and run it against the target
+void ExecuteControlRequest(ControlTarget& target, const ControlRequest& request, ControlResponse& response) {
+    response = ControlResponse(request.sequence, CONTROL_OK);
+
+    ControlStatus status = CONTROL_BAD_ARGUMENT;
+    switch (request.code) {
+    case CONTROL_PING:
+        status = CONTROL_OK;
+        break;
+    case CONTROL_LOAD_SLOT:
+        if (request.length == 1 && request.payload[0] < NUM_SAVED_RECTS)
+            status = target.LoadSlot(request.payload[0]);
+        break;
+    case CONTROL_SAVE_SLOT:
+        // Slot 0 is reserved for cycling
+        if (request.length == 1 && request.payload[0] >= 1 && request.payload[0] < NUM_SAVED_RECTS)
+            status = target.SaveSlot(request.payload[0]);
+        break;
+    case CONTROL_TOGGLE_INVERT:
+        status = target.ApplyEffect(EFFECT_ACTION_TOGGLE_INVERT);
+        break;
+    case CONTROL_TOGGLE_GRAYSCALE:
+        status = target.ApplyEffect(EFFECT_ACTION_TOGGLE_GRAYSCALE);
+        break;
+    case CONTROL_CYCLE_WHITE_LEVEL:
+        status = target.ApplyEffect(EFFECT_ACTION_CYCLE_WHITE_LEVEL);
+        break;
+    case CONTROL_SET_EFFECTS:
+        if (request.length == 2 && (request.payload[0] & ~(CONTROL_STATE_INVERTED | CONTROL_STATE_GRAYSCALE)) == 0 &&
+            request.payload[1] < NUM_GRAY_LEVELS) {
+            // Only the effects the payload names; vision, privacy and the rest stay as they are
+            ColorEffectSettings settings;
+            target.GetEffects(settings);
+            settings.inversionEnabled = (request.payload[0] & CONTROL_STATE_INVERTED) != 0;
+            settings.grayscaleEnabled = (request.payload[0] & CONTROL_STATE_GRAYSCALE) != 0;
+            settings.grayLevel = request.payload[1];
+            status = target.SetEffects(settings);
+        }
+        break;
+    case CONTROL_MOVE_REGION:
+        if (request.length == 16) {
+            RECT windowRect;
+            windowRect.left = GetInt32(request, 0);
+            windowRect.top = GetInt32(request, 4);
+            windowRect.right = GetInt32(request, 8);
+            windowRect.bottom = GetInt32(request, 12);
+            if (windowRect.right > windowRect.left && windowRect.bottom > windowRect.top)
+                status = target.MoveRegion(windowRect);
+        }
+        break;
+    case CONTROL_SET_TEMPERATURE:
+        if (request.length == 4) {
+            int32_t kelvin = GetInt32(request, 0);
+            if (kelvin >= COLOR_TEMPERATURE_MIN && kelvin <= COLOR_TEMPERATURE_MAX)
+                status = target.SetTemperature(kelvin);
+        }
+        break;
+    case CONTROL_SET_SHARPEN:
+        if (request.length == 1 && request.payload[0] < NUM_SHARPEN_LEVELS) {
+            ColorEffectSettings settings;
+            target.GetEffects(settings);
+            settings.sharpenLevel = request.payload[0];
+            status = target.SetEffects(settings);
+        }
+        break;
+    case CONTROL_GET_STATE: {
+        ControlState state = {};
+        target.GetState(state);
+        PutState(response, state);
+        status = CONTROL_OK;
+        break;
+    }
+    default:
+        status = CONTROL_UNKNOWN_COMMAND;
+        break;
+    }
+    response.code = static_cast<uint8_t>(status);
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "Platform.h"
+#include "ColorEffects.h"
+#include "EffectController.h"
+
+// Binary protocol of the local control channel (see ControlChannel.h). Both directions are a
+// stream of messages: an 8-byte little-endian header followed by up to CONTROL_MAX_PAYLOAD bytes.
+//
+//   request:  u32 sequence, u8 opcode, u8 payload length, u16 reserved (0), payload
+//   response: u32 sequence of the request, u8 status, u8 payload length, u16 reserved (0), payload
+//
+// Clients may send any number of requests without waiting for answers. Responses come back in
+// request order, and requests that arrive together are executed as one batch.
+
+#define CONTROL_HEADER_SIZE 8
+#define CONTROL_MAX_PAYLOAD 32
+
+enum ControlOpcode {
+    CONTROL_PING = 0,
+    CONTROL_LOAD_SLOT = 1,         // u8 slot 1-9, as the 1-9 keys; 0 loads the next saved slot, as the 0 key
+    CONTROL_SAVE_SLOT = 2,         // u8 slot 1-9, as Ctrl+1-9
+    CONTROL_TOGGLE_INVERT = 3,
+    CONTROL_TOGGLE_GRAYSCALE = 4,
+    CONTROL_CYCLE_WHITE_LEVEL = 5,
+    CONTROL_SET_EFFECTS = 6,       // u8 CONTROL_STATE_* flags, u8 gray level; other effects are kept
+    CONTROL_MOVE_REGION = 7,       // i32 left, top, right, bottom: window rectangle in screen pixels
+    CONTROL_GET_STATE = 8,         // Answered with a ControlState payload
+    CONTROL_SET_TEMPERATURE = 9,   // i32 Kelvin, COLOR_TEMPERATURE_MIN..MAX; queued like a toggle
+    CONTROL_SET_SHARPEN = 10,      // u8 level 0..NUM_SHARPEN_LEVELS - 1, index into SharpenStrengths
+    CONTROL_OPCODE_COUNT
+};
+
+enum ControlStatus {
+    CONTROL_OK = 0,
+    CONTROL_UNKNOWN_COMMAND = 1,
+    CONTROL_BAD_ARGUMENT = 2,
+    CONTROL_FAILED = 3             // Valid but not possible now, e.g. loading an empty slot
+};
+
+// ControlState flags
+#define CONTROL_STATE_INVERTED 0x01
+#define CONTROL_STATE_GRAYSCALE 0x02
+#define CONTROL_STATE_PINNED 0x04
+
+struct ControlMessage {
+    uint32_t sequence;
+    uint8_t code; // ControlOpcode in requests, ControlStatus in responses
+    uint8_t length;
+    uint8_t payload[CONTROL_MAX_PAYLOAD];
+
+    ControlMessage() : sequence(0), code(0), length(0) {}
+    ControlMessage(uint32_t messageSequence, uint8_t messageCode) : sequence(messageSequence), code(messageCode), length(0) {}
+};
+
+typedef ControlMessage ControlRequest;
+typedef ControlMessage ControlResponse;
+
+// Filter window state, the payload of a CONTROL_GET_STATE response (20 bytes)
+struct ControlState {
+    uint8_t flags;     // CONTROL_STATE_*
+    uint8_t grayLevel;
+    int32_t left;      // Window rectangle in screen pixels
+    int32_t top;
+    int32_t right;
+    int32_t bottom;
+};
+
+// Payload builders and readers. Put* return false if the payload would not fit.
+bool PutUint8(ControlMessage& message, uint8_t value);
+bool PutInt32(ControlMessage& message, int32_t value);
+int32_t GetInt32(const ControlMessage& message, size_t offset);
+
+void PutState(ControlMessage& message, const ControlState& state);
+bool GetState(const ControlMessage& message, ControlState& state);
+
+// Append the wire form of a message to 'out'
+void EncodeControlMessage(const ControlMessage& message, std::vector<uint8_t>& out);
+
+// Splits a byte stream into messages
+class ControlDecoder {
+private:
+    std::vector<uint8_t> buffer;
+    size_t readPosition;
+
+public:
+    enum Result {
+        NEED_MORE,
+        MESSAGE,
+        MALFORMED // Reserved bits set or payload too long: the stream cannot be trusted further
+    };
+
+    ControlDecoder() : readPosition(0) {}
+
+    void Append(const uint8_t* data, size_t size);
+
+    // Take the next complete message, if any
+    Result Next(ControlMessage& message);
+};
+
+// What control commands act on: the filter window, or a headless model of it. Arguments have
+// been validated by ExecuteControlRequest().
+class ControlTarget {
+public:
+    virtual ~ControlTarget() {}
+
+    virtual ControlStatus LoadSlot(int slot) = 0;
+    virtual ControlStatus SaveSlot(int slot) = 0;
+    virtual ControlStatus ApplyEffect(EffectAction action) = 0;
+    virtual ControlStatus SetEffects(const ColorEffectSettings& settings) = 0;
+    virtual void GetEffects(ColorEffectSettings& settings) = 0; // Including changes queued earlier in the batch
+    virtual ControlStatus MoveRegion(const RECT& windowRect) = 0;
+    virtual ControlStatus SetTemperature(int kelvin) = 0;
+    virtual void GetState(ControlState& state) = 0;
+};
+
+// Validate a request, run it against the target and fill in the response
+void ExecuteControlRequest(ControlTarget& target, const ControlRequest& request, ControlResponse& response);
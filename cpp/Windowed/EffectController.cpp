@@ -0,0 +1,140 @@
+#include "EffectController.h"
+#include <algorithm>
+
+// Action bound to a key pressed with the given modifiers
+EffectAction EffectActionForKey(const ShortcutConfig& shortcuts, UINT key, UINT modifiers) {
+    KeyChord pressed = { key, modifiers };
+    if (pressed == shortcuts.toggleInvert)
+        return EFFECT_ACTION_TOGGLE_INVERT;
+    if (pressed == shortcuts.toggleGrayscale)
+        return EFFECT_ACTION_TOGGLE_GRAYSCALE;
+    if (pressed == shortcuts.cycleWhiteLevel)
+        return EFFECT_ACTION_CYCLE_WHITE_LEVEL;
+    if (pressed == shortcuts.cycleVisionMode)
+        return EFFECT_ACTION_CYCLE_VISION_MODE;
+    if (pressed == shortcuts.cycleVisionSeverity)
+        return EFFECT_ACTION_CYCLE_VISION_SEVERITY;
+    if (pressed == shortcuts.warmer)
+        return EFFECT_ACTION_WARMER;
+    if (pressed == shortcuts.cooler)
+        return EFFECT_ACTION_COOLER;
+    if (pressed == shortcuts.cyclePrivacyEffect)
+        return EFFECT_ACTION_CYCLE_PRIVACY_EFFECT;
+    if (pressed == shortcuts.toggleBinarize)
+        return EFFECT_ACTION_TOGGLE_BINARIZE;
+    if (pressed == shortcuts.cycleBinarizeWindow)
+        return EFFECT_ACTION_CYCLE_BINARIZE_WINDOW;
+    if (pressed == shortcuts.toggleAutoInvert)
+        return EFFECT_ACTION_TOGGLE_AUTO_INVERT;
+    if (pressed == shortcuts.toggleSmartInvert)
+        return EFFECT_ACTION_TOGGLE_SMART_INVERT;
+    if (pressed == shortcuts.cycleSharpen)
+        return EFFECT_ACTION_CYCLE_SHARPEN;
+    return EFFECT_ACTION_NONE;
+}
+
+EffectController::EffectController() : generation(0), hasPending(false), queuedCommands(0), matrixBuilds(0) {
+    CalculateColorMatrix(settings, matrix);
+}
+
+// Replace the settings and rebuild the matrix
+void EffectController::SetSettings(const ColorEffectSettings& newSettings) {
+    hasPending = false;
+    if (newSettings == settings)
+        return;
+    settings = newSettings;
+    CalculateColorMatrix(settings, matrix);
+    matrixBuilds++;
+    generation++;
+}
+
+// Apply a shortcut action at once
+bool EffectController::Apply(EffectAction action) {
+    if (!Queue(action))
+        return false;
+    SetSettings(pending);
+    return true;
+}
+
+// Fold a shortcut action into the pending settings
+bool EffectController::Queue(EffectAction action) {
+    ColorEffectSettings changed = hasPending ? pending : settings;
+    switch (action) {
+    case EFFECT_ACTION_TOGGLE_INVERT:
+        changed.inversionEnabled = !changed.inversionEnabled;
+        break;
+    case EFFECT_ACTION_TOGGLE_GRAYSCALE:
+        changed.grayscaleEnabled = !changed.grayscaleEnabled;
+        break;
+    case EFFECT_ACTION_CYCLE_WHITE_LEVEL:
+        changed.grayLevel = (changed.grayLevel + 1) % NUM_GRAY_LEVELS;
+        break;
+    case EFFECT_ACTION_CYCLE_VISION_MODE:
+        changed.visionMode = (changed.visionMode + 1) % VISION_MODE_COUNT;
+        break;
+    case EFFECT_ACTION_CYCLE_VISION_SEVERITY:
+        // Down from full strength in 10% steps, then back to full
+        changed.visionSeverity = changed.visionSeverity > 1 ? changed.visionSeverity - 1 : NUM_VISION_SEVERITIES - 1;
+        break;
+    case EFFECT_ACTION_WARMER:
+        changed.colorTemperature = (std::max)(changed.colorTemperature - EFFECT_TEMPERATURE_STEP, COLOR_TEMPERATURE_MIN);
+        break;
+    case EFFECT_ACTION_COOLER:
+        changed.colorTemperature = (std::min)(changed.colorTemperature + EFFECT_TEMPERATURE_STEP, COLOR_TEMPERATURE_MAX);
+        break;
+    case EFFECT_ACTION_CYCLE_PRIVACY_EFFECT:
+        changed.privacyEffect = (changed.privacyEffect + 1) % PRIVACY_EFFECT_COUNT;
+        break;
+    case EFFECT_ACTION_TOGGLE_BINARIZE:
+        changed.binarizeEnabled = !changed.binarizeEnabled;
+        break;
+    case EFFECT_ACTION_CYCLE_BINARIZE_WINDOW:
+        changed.binarizeWindow = changed.binarizeWindow >= BINARIZE_WINDOW_MAX ? EFFECT_BINARIZE_WINDOW_FIRST :
+            (std::min)((std::max)(changed.binarizeWindow * 2 + 1, EFFECT_BINARIZE_WINDOW_FIRST), BINARIZE_WINDOW_MAX);
+        break;
+    case EFFECT_ACTION_TOGGLE_AUTO_INVERT:
+        changed.autoInvert = !changed.autoInvert;
+        break;
+    case EFFECT_ACTION_TOGGLE_SMART_INVERT:
+        changed.smartInvert = !changed.smartInvert;
+        break;
+    case EFFECT_ACTION_CYCLE_SHARPEN:
+        changed.sharpenLevel = (changed.sharpenLevel + 1) % NUM_SHARPEN_LEVELS;
+        break;
+    default:
+        return false;
+    }
+    pending = changed;
+    hasPending = true;
+    queuedCommands++;
+    return true;
+}
+
+// Fold a color temperature into the pending settings
+void EffectController::QueueTemperature(int kelvin) {
+    if (!hasPending)
+        pending = settings;
+    pending.colorTemperature = (std::min)((std::max)(kelvin, COLOR_TEMPERATURE_MIN), COLOR_TEMPERATURE_MAX);
+    hasPending = true;
+    queuedCommands++;
+}
+
+// Fold an inversion state into the pending settings
+void EffectController::QueueInversion(bool enabled) {
+    if (!hasPending)
+        pending = settings;
+    pending.inversionEnabled = enabled;
+    hasPending = true;
+    queuedCommands++;
+}
+
+// Apply the queued changes
+bool EffectController::Flush() {
+    if (!hasPending)
+        return false;
+    hasPending = false;
+    if (pending == settings)
+        return false;
+    SetSettings(pending);
+    return true;
+}
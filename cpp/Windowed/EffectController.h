@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstdint>
+#include "ColorEffects.h"
+#include "ShortcutConfig.h"
+
+// Color effect changes bound to keyboard shortcuts
+enum EffectAction {
+    EFFECT_ACTION_NONE,
+    EFFECT_ACTION_TOGGLE_INVERT,
+    EFFECT_ACTION_TOGGLE_GRAYSCALE,
+    EFFECT_ACTION_CYCLE_WHITE_LEVEL,
+    EFFECT_ACTION_CYCLE_VISION_MODE,
+    EFFECT_ACTION_CYCLE_VISION_SEVERITY,
+    EFFECT_ACTION_WARMER,  // Color temperature down by EFFECT_TEMPERATURE_STEP
+    EFFECT_ACTION_COOLER,  // Color temperature up by EFFECT_TEMPERATURE_STEP
+    EFFECT_ACTION_CYCLE_PRIVACY_EFFECT,
+    EFFECT_ACTION_TOGGLE_BINARIZE,
+    EFFECT_ACTION_CYCLE_BINARIZE_WINDOW, // Window doubles from EFFECT_BINARIZE_WINDOW_FIRST up to the maximum, then wraps
+    EFFECT_ACTION_TOGGLE_AUTO_INVERT,
+    EFFECT_ACTION_TOGGLE_SMART_INVERT,
+    EFFECT_ACTION_CYCLE_SHARPEN // Through SharpenStrengths, wrapping back to off
+};
+
+// Kelvin per press of the warmer/cooler shortcuts
+#define EFFECT_TEMPERATURE_STEP 500
+
+// Smallest binarization window the cycle shortcut visits: 15, 31, 63, 127 pixels
+#define EFFECT_BINARIZE_WINDOW_FIRST 15
+
+// Action bound to a key pressed with the given MOD_* modifiers, or EFFECT_ACTION_NONE
+EffectAction EffectActionForKey(const ShortcutConfig& shortcuts, UINT key, UINT modifiers);
+
+// Color effect state of a filter window and the matrix it produces. This is the part of the
+// keypress-to-effect path that does not need a window: HostWndProc() feeds it key presses and
+// hands the matrix to the magnifier, the latency harness hands it to a FramePipeline.
+//
+// Changes can be applied at once or queued. Queued changes fold into one pending state, so a
+// burst of key presses between two frames costs one matrix rebuild when Flush() runs, and
+// presses that cancel out (invert twice) cost none.
+class EffectController {
+private:
+    ColorEffectSettings settings;
+    ColorMatrix matrix;
+    uint64_t generation; // Incremented on every change, so a frame can tell which state it shows
+
+    ColorEffectSettings pending; // Settings once the queued changes are applied
+    bool hasPending;
+    uint64_t queuedCommands;  // Changes queued since construction
+    uint64_t matrixBuilds;    // Matrix rebuilds since construction
+
+public:
+    EffectController();
+
+    const ColorEffectSettings& GetSettings() const { return settings; }
+    const ColorMatrix& GetMatrix() const { return matrix; }
+    uint64_t GetGeneration() const { return generation; }
+
+    // Settings as the next Flush() will leave them: the current ones with queued changes applied
+    const ColorEffectSettings& GetPendingSettings() const { return hasPending ? pending : settings; }
+
+    // Replace the settings at once, e.g. with those of a saved rectangle. Discards queued changes.
+    // Settings equal to the current ones leave the matrix and generation as they are.
+    void SetSettings(const ColorEffectSettings& newSettings);
+
+    // Apply a shortcut action at once; returns false for EFFECT_ACTION_NONE
+    bool Apply(EffectAction action);
+
+    // Queue a shortcut action for the next Flush(); returns false for EFFECT_ACTION_NONE
+    bool Queue(EffectAction action);
+
+    // Queue a color temperature for the next Flush(), clamped to the supported range. A drag
+    // sends many of these between two frames; only the last one costs a matrix rebuild.
+    void QueueTemperature(int kelvin);
+
+    // Queue the inversion state for the next Flush(), as the auto-invert mode decides it. Unlike
+    // EFFECT_ACTION_TOGGLE_INVERT this sets the state, so a verdict repeated before the frame
+    // does not undo itself.
+    void QueueInversion(bool enabled);
+
+    bool HasPending() const { return hasPending; }
+
+    // Apply the queued changes. Returns true if the settings changed, so the matrix was rebuilt
+    // and has to be handed on; false if nothing was queued or the changes cancelled out.
+    bool Flush();
+
+    uint64_t GetQueuedCommands() const { return queuedCommands; }
+    uint64_t GetMatrixBuilds() const { return matrixBuilds; }
+};
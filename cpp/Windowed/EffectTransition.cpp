@@ -0,0 +1,61 @@
+#include "EffectTransition.h"
+
+EffectTransition::EffectTransition()
+    : current(), from(), delta(), target(), changed(), changedCount(0), startMs(0), durationMs(0), lastProgress(0.0f),
+      active(false), stepCount(0), entriesWritten(0) {
+    CalculateColorMatrix(ColorEffectSettings(), current);
+    target = current;
+}
+
+// Record the endpoints and the entries that move between them
+void EffectTransition::Start(const ColorMatrix& to, int64_t nowMs, int64_t duration) {
+    from = current;
+    target = to;
+    changedCount = 0;
+    for (int i = 0; i < 25; i++) {
+        int row = i / 5, column = i % 5;
+        delta.transform[row][column] = to.transform[row][column] - from.transform[row][column];
+        if (to.transform[row][column] != from.transform[row][column])
+            changed[changedCount++] = static_cast<uint8_t>(i);
+    }
+
+    startMs = nowMs;
+    durationMs = duration;
+    lastProgress = 0.0f;
+    active = changedCount > 0;
+    if (active && duration <= 0) {
+        current = target;
+        active = false;
+        stepCount++;
+        entriesWritten += changedCount;
+    }
+}
+
+// Blend the changed entries for the time elapsed
+bool EffectTransition::Step(int64_t nowMs) {
+    if (!active)
+        return false;
+
+    if (nowMs - startMs >= durationMs) {
+        for (int i = 0; i < changedCount; i++)
+            current.transform[changed[i] / 5][changed[i] % 5] = target.transform[changed[i] / 5][changed[i] % 5];
+        active = false;
+        stepCount++;
+        entriesWritten += changedCount;
+        return true;
+    }
+
+    float t = nowMs > startMs ? static_cast<float>(nowMs - startMs) / static_cast<float>(durationMs) : 0.0f;
+    float progress = t * t * (3.0f - 2.0f * t); // Smoothstep: no sudden change at either end
+    if (progress == lastProgress)
+        return false;
+    lastProgress = progress;
+
+    for (int i = 0; i < changedCount; i++) {
+        int row = changed[i] / 5, column = changed[i] % 5;
+        current.transform[row][column] = from.transform[row][column] + delta.transform[row][column] * progress;
+    }
+    stepCount++;
+    entriesWritten += changedCount;
+    return true;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include "ColorEffects.h"
+
+// Fades the magnifier's color matrix from what it shows to a new effect state over a number of
+// frames, instead of snapping (e.g. a full-region flash from identity to inverted).
+//
+// Both endpoints come ready-made (EffectController keeps the matrix of the current settings), so
+// Start() only records the start, the difference and which of the 25 entries differ at all; a
+// frame's Step() then blends just those entries along a smoothstep curve. Starting again mid-way
+// fades on from the blend on screen, so reversing a toggle never jumps.
+class EffectTransition {
+private:
+    ColorMatrix current; // What the magnifier shows, or will once handed on
+    ColorMatrix from;
+    ColorMatrix delta;   // Target minus 'from'
+    ColorMatrix target;
+    uint8_t changed[25]; // Row * 5 + column of the entries that differ between the endpoints
+    int changedCount;
+    int64_t startMs;
+    int64_t durationMs;
+    float lastProgress;  // Eased progress of the last step
+    bool active;
+    uint64_t stepCount;      // Steps that changed the matrix, since construction
+    uint64_t entriesWritten; // Matrix entries those steps wrote
+
+public:
+    EffectTransition(); // Shows the identity, as the magnifier does before any effect is set
+
+    // Fade from what is shown towards 'to', starting at 'nowMs'. A duration of 0 or less, or
+    // a target equal to what is shown, takes effect at once.
+    void Start(const ColorMatrix& to, int64_t nowMs, int64_t durationMs);
+
+    bool IsActive() const { return active; }
+
+    // Blend for 'nowMs'. Returns true if the matrix changed and has to be handed on; the step at
+    // or after the end writes the target exactly and ends the transition.
+    bool Step(int64_t nowMs);
+
+    const ColorMatrix& GetMatrix() const { return current; }
+    int GetChangedCount() const { return changedCount; }
+    uint64_t GetStepCount() const { return stepCount; }
+    uint64_t GetEntriesWritten() const { return entriesWritten; }
+};
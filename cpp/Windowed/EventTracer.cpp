@@ -0,0 +1,164 @@
+#include "EventTracer.h"
+#include <cstdio>
+#include <fstream>
+
+namespace {
+
+// Source of EventTracer::generation; 0 is never handed out
+std::atomic<uint64_t> nextGeneration(1);
+
+// Buffer the calling thread last used, and the tracer generation it was last used in
+thread_local uint64_t currentGeneration = 0;
+thread_local void* currentBuffer = NULL;
+
+int64_t SteadyNs(std::chrono::steady_clock::time_point time) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+}
+
+void WriteJsonString(std::ostream& out, const char* text) {
+    out << '"';
+    for (const char* c = text; *c != '\0'; c++) {
+        if (*c == '"' || *c == '\\')
+            out << '\\';
+        out << *c;
+    }
+    out << '"';
+}
+
+}
+
+EventTracer::EventTracer()
+    : generation(nextGeneration.fetch_add(1, std::memory_order_relaxed)), enabled(false),
+      originNs(SteadyNs(std::chrono::steady_clock::now())) {
+}
+
+EventTracer::ThreadBuffer* EventTracer::CurrentThreadBuffer() {
+    uint64_t current = generation.load(std::memory_order_acquire);
+    if (currentGeneration == current)
+        return static_cast<ThreadBuffer*>(currentBuffer);
+
+    // First event on this thread, the thread last recorded into another tracer, or the tracer
+    // was restarted: find its buffer or register one. Buffers outlive their threads so events
+    // from finished threads can still be written; a new thread given a finished one's id
+    // carries on its track.
+    std::lock_guard<std::mutex> guard(lock);
+    std::thread::id self = std::this_thread::get_id();
+    ThreadBuffer* buffer = NULL;
+    for (const std::unique_ptr<ThreadBuffer>& candidate : buffers) {
+        if (candidate->owner == self) {
+            buffer = candidate.get();
+            break;
+        }
+    }
+    if (buffer == NULL) {
+        buffers.emplace_back(new ThreadBuffer(static_cast<int>(buffers.size()) + 1, self, current));
+        buffer = buffers.back().get();
+    } else if (buffer->generation.load(std::memory_order_relaxed) != current) {
+        // Events from before Start(); this thread is the ring's only writer, so nothing can
+        // publish an old count over the reset
+        buffer->written.store(0, std::memory_order_relaxed);
+        buffer->generation.store(current, std::memory_order_release);
+    }
+    currentGeneration = current;
+    currentBuffer = buffer;
+    return buffer;
+}
+
+// Discard previously recorded events and start recording
+void EventTracer::Start() {
+    // Each thread drops its own events when it next records; the writer skips rings that
+    // have not caught up
+    originNs.store(SteadyNs(std::chrono::steady_clock::now()), std::memory_order_relaxed);
+    generation.store(nextGeneration.fetch_add(1, std::memory_order_relaxed), std::memory_order_release);
+    enabled.store(true, std::memory_order_release);
+}
+
+// Stop recording; the events stay available for writing
+void EventTracer::Stop() {
+    enabled.store(false, std::memory_order_release);
+}
+
+// Name shown for the calling thread's track
+void EventTracer::SetThreadName(const char* name) {
+    CurrentThreadBuffer()->threadName = name;
+}
+
+void EventTracer::Record(const char* name, const char* category, std::chrono::steady_clock::time_point start,
+    std::chrono::steady_clock::time_point end, const char* argName, int64_t argValue) {
+    if (!IsEnabled())
+        return;
+
+    ThreadBuffer* buffer = CurrentThreadBuffer();
+    uint64_t index = buffer->written.load(std::memory_order_relaxed);
+    TraceEvent& event = buffer->events[index % TRACE_BUFFER_EVENTS];
+    event.name = name;
+    event.category = category;
+    event.argName = argName;
+    event.argValue = argValue;
+    event.startNs = SteadyNs(start) - originNs.load(std::memory_order_relaxed);
+    event.durationNs = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+
+    // Publish the event to WriteChromeTrace
+    buffer->written.store(index + 1, std::memory_order_release);
+}
+
+// Write the recorded events; returns how many were written
+size_t EventTracer::WriteChromeTrace(std::ostream& out) const {
+    std::lock_guard<std::mutex> guard(lock);
+    uint64_t current = generation.load(std::memory_order_acquire);
+    size_t count = 0;
+    char number[64];
+
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    bool first = true;
+    for (const std::unique_ptr<ThreadBuffer>& buffer : buffers) {
+        if (buffer->threadName != NULL) {
+            out << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->threadId
+                << ",\"args\":{\"name\":";
+            WriteJsonString(out, buffer->threadName);
+            out << "}}";
+            first = false;
+        }
+
+        // A thread that has not recorded since Start() still holds the previous trace
+        if (buffer->generation.load(std::memory_order_acquire) != current)
+            continue;
+
+        uint64_t written = buffer->written.load(std::memory_order_acquire);
+        uint64_t oldest = written > TRACE_BUFFER_EVENTS ? written - TRACE_BUFFER_EVENTS : 0;
+        for (uint64_t i = oldest; i < written; i++) {
+            const TraceEvent& event = buffer->events[i % TRACE_BUFFER_EVENTS];
+            out << (first ? "" : ",\n") << "{\"name\":";
+            WriteJsonString(out, event.name);
+            out << ",\"cat\":";
+            WriteJsonString(out, event.category);
+
+            // Chrome trace timestamps are microseconds
+            snprintf(number, sizeof(number), ",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f",
+                event.startNs / 1000.0, event.durationNs / 1000.0);
+            out << number << ",\"pid\":1,\"tid\":" << buffer->threadId;
+
+            if (event.argName != NULL) {
+                out << ",\"args\":{";
+                WriteJsonString(out, event.argName);
+                out << ":" << event.argValue << "}";
+            }
+            out << "}";
+            first = false;
+            count++;
+        }
+    }
+    out << "\n]}\n";
+    return count;
+}
+
+bool EventTracer::WriteChromeTraceFile(const char* path, size_t* eventCount) const {
+    std::ofstream file(path, std::ios::trunc);
+    if (!file.is_open())
+        return false;
+
+    size_t count = WriteChromeTrace(file);
+    if (eventCount != NULL)
+        *eventCount = count;
+    return file.good();
+}
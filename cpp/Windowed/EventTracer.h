@@ -0,0 +1,103 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+#define TRACE_BUFFER_EVENTS 65536 // Per thread; the oldest events are overwritten when full
+
+// One completed scope. Names, categories and argument names must be string literals:
+// only the pointers are stored.
+struct TraceEvent {
+    const char* name;
+    const char* category;
+    const char* argName; // NULL if the event has no argument
+    int64_t argValue;
+    int64_t startNs;     // Since the trace was started
+    int64_t durationNs;
+};
+
+// Records scoped events into per-thread ring buffers and writes them as Chrome Trace Event
+// JSON (chrome://tracing, ui.perfetto.dev). Each buffer has a single writer, so recording
+// takes no lock; when tracing is off a scope costs one relaxed atomic load.
+class EventTracer {
+private:
+    struct ThreadBuffer {
+        int threadId;
+        std::thread::id owner;
+        const char* threadName;
+        std::unique_ptr<TraceEvent[]> events;
+        std::atomic<uint64_t> written; // Total events recorded; the ring holds the newest
+        std::atomic<uint64_t> generation; // Tracer generation the events belong to
+
+        ThreadBuffer(int id, std::thread::id thread, uint64_t current)
+            : threadId(id), owner(thread), threadName(NULL), events(new TraceEvent[TRACE_BUFFER_EVENTS]), written(0),
+              generation(current) {}
+    };
+
+    // Unique per tracer, unlike its address, and renewed by each Start(). Only the thread
+    // owning a buffer resets it, once it sees the new generation.
+    std::atomic<uint64_t> generation;
+    std::atomic<bool> enabled;
+    std::atomic<int64_t> originNs; // steady_clock time of Start()
+    mutable std::mutex lock; // Guards the buffer list, not the buffers' contents
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+
+    ThreadBuffer* CurrentThreadBuffer();
+
+public:
+    EventTracer();
+
+    // Discard previously recorded events and start recording
+    void Start();
+
+    // Stop recording; the events stay available for writing
+    void Stop();
+
+    bool IsEnabled() const { return enabled.load(std::memory_order_relaxed); }
+
+    // Name shown for the calling thread's track
+    void SetThreadName(const char* name);
+
+    void Record(const char* name, const char* category, std::chrono::steady_clock::time_point start,
+        std::chrono::steady_clock::time_point end, const char* argName = NULL, int64_t argValue = 0);
+
+    // Write the recorded events; returns how many were written. Call after Stop() so
+    // no thread is still recording.
+    size_t WriteChromeTrace(std::ostream& out) const;
+    bool WriteChromeTraceFile(const char* path, size_t* eventCount) const;
+};
+
+// Traces the enclosing scope as one complete ("X") event
+class TraceScope {
+private:
+    EventTracer& tracer;
+    const char* name;
+    const char* category;
+    const char* argName;
+    int64_t argValue;
+    bool active;
+    std::chrono::steady_clock::time_point start;
+
+public:
+    TraceScope(EventTracer& owner, const char* eventName, const char* eventCategory,
+        const char* eventArgName = NULL, int64_t eventArgValue = 0)
+        : tracer(owner), name(eventName), category(eventCategory), argName(eventArgName),
+        argValue(eventArgValue), active(owner.IsEnabled()) {
+        if (active)
+            start = std::chrono::steady_clock::now();
+    }
+
+    ~TraceScope() {
+        if (active)
+            tracer.Record(name, category, start, std::chrono::steady_clock::now(), argName, argValue);
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+};
@@ -0,0 +1,39 @@
+#include "FileWatcher.h"
+
+FileWatcher::FileWatcher(const std::string& filePath, std::chrono::milliseconds settle)
+    : path(filePath), settleTime(settle), exists(false), changePending(false) {
+    Reset();
+}
+
+bool FileWatcher::ReadWriteTime(std::filesystem::file_time_type& writeTime) const {
+    std::error_code error;
+    writeTime = std::filesystem::last_write_time(path, error);
+    return !error;
+}
+
+// Record the file's current state as already handled
+void FileWatcher::Reset() {
+    exists = ReadWriteTime(lastSeen);
+    changePending = false;
+}
+
+// Returns true once per settled change
+bool FileWatcher::Poll(std::chrono::steady_clock::time_point now) {
+    std::filesystem::file_time_type writeTime;
+    bool nowExists = ReadWriteTime(writeTime);
+
+    // Every observed modification restarts the settle period
+    if (nowExists != exists || (nowExists && writeTime != lastSeen)) {
+        exists = nowExists;
+        lastSeen = writeTime;
+        lastChange = now;
+        changePending = true;
+        return false;
+    }
+
+    if (changePending && now - lastChange >= settleTime) {
+        changePending = false;
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <string>
+#include <chrono>
+#include <filesystem>
+
+// Polls a file's last-write time and reports a change once the file has stopped
+// changing for a settle period, so a burst of saves results in a single reload
+class FileWatcher {
+private:
+    std::string path;
+    std::chrono::milliseconds settleTime;
+    std::filesystem::file_time_type lastSeen;
+    bool exists;
+    bool changePending;
+    std::chrono::steady_clock::time_point lastChange;
+
+    bool ReadWriteTime(std::filesystem::file_time_type& writeTime) const;
+
+public:
+    FileWatcher(const std::string& filePath, std::chrono::milliseconds settle);
+
+    // Record the file's current state as already handled
+    void Reset();
+
+    // Returns true once per settled change
+    bool Poll(std::chrono::steady_clock::time_point now);
+};
@@ -0,0 +1,90 @@
+#include "FramePipeline.h"
+
+// Screen rectangle the magnifier should show for a host window
+RECT ComputeMagnifierSource(const RECT& windowRect, const RECT& clientRect, const WindowFrameMetrics& metrics, float magnification) {
+    // Keeps the window's own edge out of the captured area
+    const LONG fudge = 4;
+
+    RECT sourceRect;
+    sourceRect.left = windowRect.left + clientRect.left + metrics.borderWidth + fudge;
+    sourceRect.top = windowRect.top + clientRect.top + metrics.titleBarHeight + metrics.borderHeight + fudge;
+
+    // Calculate the width and height based on the window size
+    LONG width = static_cast<LONG>((windowRect.right - windowRect.left) / magnification);
+    LONG height = static_cast<LONG>((windowRect.bottom - windowRect.top) / magnification);
+
+    sourceRect.right = sourceRect.left + width;
+    sourceRect.bottom = sourceRect.top + height;
+    return sourceRect;
+}
+
+// Whether the settings need a stage the magnifier cannot do
+bool NeedsCpuRender(const ColorEffectSettings& settings) {
+    return settings.privacyEffect != PRIVACY_NONE || settings.sharpenLevel > 0 || settings.binarizeEnabled || (settings.smartInvert && settings.inversionEnabled);
+}
+
+FramePipeline::FramePipeline(FrameSource& frameSource, PixelKernel pixelKernel)
+    : source(frameSource), kernel(pixelKernel), sourceRect(frameSource.GetBounds()), dither(false), toneCurveEnabled(false),
+      sharpenStrength(0.0f), privacyEffect(PRIVACY_NONE), privacySize(0), binarizeWindow(0), smartInvert(false), pool(NULL), framesRendered(0) {
+    CalculateColorMatrix(ColorEffectSettings(), matrix);
+}
+
+// Tone curve applied after the matrix in the same pass
+void FramePipeline::SetToneCurve(const ToneCurve* curve) {
+    toneCurveEnabled = curve != NULL;
+    if (curve != NULL)
+        toneCurve = *curve;
+}
+
+// The sharpening, privacy, binarization and smart inversion stages for the settings
+void FramePipeline::SetEffects(const ColorEffectSettings& settings) {
+    int level = settings.sharpenLevel < 0 ? 0 : (settings.sharpenLevel >= NUM_SHARPEN_LEVELS ? NUM_SHARPEN_LEVELS - 1 : settings.sharpenLevel);
+    SetSharpenStrength(SharpenStrengths[level]);
+    SetPrivacyEffect(static_cast<PrivacyEffect>(settings.privacyEffect),
+        settings.privacyEffect == PRIVACY_BLUR ? settings.blurRadius : settings.pixelateBlock);
+    SetBinarization(settings.binarizeEnabled ? settings.binarizeWindow : 0);
+    SetSmartInvert(settings.smartInvert && settings.inversionEnabled);
+}
+
+// One timer tick: capture the source rectangle and filter it into the output image
+bool FramePipeline::RenderFrame() {
+    if (!source.Capture(sourceRect, captured))
+        return false;
+
+    output.Resize(captured.width, captured.height);
+    if (privacyEffect != PRIVACY_NONE) {
+        if (privacyEffect == PRIVACY_BLUR)
+            BoxBlurImage(captured.pixels.data(), output.pixels.data(), captured.width, captured.height, privacySize, pool);
+        else
+            PixelateImage(captured.pixels.data(), output.pixels.data(), captured.width, captured.height, privacySize, pool);
+        framesRendered++;
+        return true;
+    }
+
+    const PixelImage* input = &captured;
+    if (binarizeWindow > 0) {
+        binarized.Resize(captured.width, captured.height);
+        BinarizeImage(kernel, captured.pixels.data(), binarized.pixels.data(), captured.width, captured.height, binarizeWindow, pool);
+        input = &binarized;
+    }
+    if (smartInvert) {
+        smartInverted.Resize(input->width, input->height);
+        SmartInvertImage(kernel, input->pixels.data(), smartInverted.pixels.data(), input->width, input->height, pool);
+        input = &smartInverted;
+    }
+
+    if (toneCurveEnabled)
+        ApplyColorMatrixAndCurve(kernel, matrix, toneCurve, input->pixels.data(), output.pixels.data(), input->width, input->height, dither);
+    else if (dither)
+        ApplyColorMatrixDithered(kernel, matrix, input->pixels.data(), output.pixels.data(), input->width, input->height);
+    else
+        ApplyColorMatrix(kernel, matrix, input->pixels.data(), output.pixels.data(), input->pixels.size());
+
+    if (sharpenStrength > 0.0f) {
+        filtered.Resize(output.width, output.height);
+        SharpenImage(kernel, output.pixels.data(), filtered.pixels.data(), output.width, output.height, sharpenStrength, pool);
+        output.pixels.swap(filtered.pixels);
+    }
+    framesRendered++;
+    return true;
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstdint>
+#include "Binarize.h"
+#include "ColorEffects.h"
+#include "FrameSource.h"
+#include "PixelKernels.h"
+#include "PrivacyEffects.h"
+#include "Sharpen.h"
+#include "SmartInvert.h"
+
+// Sizes of the host window's non-client elements (GetSystemMetrics on Windows)
+struct WindowFrameMetrics {
+    LONG titleBarHeight;
+    LONG borderWidth;
+    LONG borderHeight;
+};
+
+// Screen rectangle the magnifier should show for a host window: its client area, offset past
+// the frame, at the given magnification. This is the per-frame calculation of UpdateMagWindow().
+RECT ComputeMagnifierSource(const RECT& windowRect, const RECT& clientRect, const WindowFrameMetrics& metrics, float magnification);
+
+// Whether the settings need a stage the magnifier's color matrix cannot express, so the window
+// has to capture and filter its frames with a FramePipeline instead: a privacy effect's blur or
+// pixelation, sharpening, binarization, and smart inversion while inverted.
+bool NeedsCpuRender(const ColorEffectSettings& settings);
+
+// CPU version of the work UpdateMagWindow() has the magnifier do each timer tick: capture the
+// source rectangle and apply the color matrix. Used headless with a SyntheticFrameSource so
+// frame costs can be measured off Windows, and by the window for the stages the magnifier lacks
+// (NeedsCpuRender), with a capture of the screen as the source.
+class FramePipeline {
+private:
+    FrameSource& source;
+    PixelKernel kernel;
+    ColorMatrix matrix;
+    RECT sourceRect;
+    PixelImage captured;
+    PixelImage output;
+    bool dither;
+    ToneCurve toneCurve;
+    bool toneCurveEnabled;
+    float sharpenStrength;
+    PrivacyEffect privacyEffect;
+    int privacySize;
+    int binarizeWindow;
+    PixelImage binarized;
+    bool smartInvert;
+    PixelImage smartInverted;
+    WorkerPool* pool;
+    PixelImage filtered;
+    uint64_t framesRendered;
+
+public:
+    FramePipeline(FrameSource& frameSource, PixelKernel pixelKernel);
+
+    // Equivalent of MagSetColorEffect
+    void SetColorMatrix(const ColorMatrix& newMatrix) { matrix = newMatrix; }
+
+    // Equivalent of MagSetWindowSource
+    void SetSource(const RECT& rect) { sourceRect = rect; }
+
+    // Round against blue noise instead of to nearest (ApplyColorMatrixDithered); off by default.
+    // The window turns it on with /dither at white levels below 100%.
+    void SetDither(bool enabled) { dither = enabled; }
+
+    // Tone curve applied after the matrix in the same pass (ApplyColorMatrixAndCurve); NULL for
+    // none, the default. The magnifier has no equivalent; the window uses the curve loaded with
+    // /tone-curve=. The curve is copied.
+    void SetToneCurve(const ToneCurve* curve);
+
+    // Unsharp mask after the color stage (SharpenImage), e.g. SharpenStrengths[settings.sharpenLevel];
+    // 0, the default, skips it
+    void SetSharpenStrength(float strength) { sharpenStrength = strength; }
+
+    // Blur or pixelate the captured image instead of the color, curve and sharpening stages;
+    // 'size' is the blur radius or the block size (BoxBlurImage, PixelateImage). PRIVACY_NONE,
+    // the default, turns it off.
+    void SetPrivacyEffect(PrivacyEffect effect, int size) { privacyEffect = effect; privacySize = size; }
+
+    // Threshold the captured image to black and white before the color stage (BinarizeImage),
+    // with a 'window'-pixel square; 0, the default, turns it off
+    void SetBinarization(int window) { binarizeWindow = window; }
+
+    // Invert only the tiles of text on a light background before the color stage, after any
+    // binarization (SmartInvertImage); the color matrix should then leave inversion out, as
+    // CalculateColorMatrix() does for smartInvert. Off by default.
+    void SetSmartInvert(bool enabled) { smartInvert = enabled; }
+
+    // The sharpening, privacy, binarization and smart inversion stages for the settings. The color matrix is set
+    // on its own, since a window hands on the steps of a transition rather than the final matrix.
+    void SetEffects(const ColorEffectSettings& settings);
+
+    // Threads for the spatial stages; NULL, the default, runs them on the rendering thread
+    void SetWorkerPool(WorkerPool* workerPool) { pool = workerPool; }
+
+    // One timer tick: capture the source rectangle and filter it into the output image
+    bool RenderFrame();
+
+    const PixelImage& GetOutput() const { return output; }
+
+    // Unfiltered contents of the last frame
+    const PixelImage& GetCaptured() const { return captured; }
+    uint64_t GetFramesRendered() const { return framesRendered; }
+};
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "Platform.h"
+#include "PixelImage.h"
+
+// Supplies the unfiltered screen contents for one frame. On Windows the magnifier control
+// captures the screen itself; this is the seam for headless and CPU-rendered pipelines.
+class FrameSource {
+public:
+    virtual ~FrameSource() {}
+
+    // Bounds of the whole desktop in screen coordinates
+    virtual RECT GetBounds() const = 0;
+
+    // Capture 'region' (screen coordinates) of the current frame into 'frame', resizing it to
+    // the region. Parts outside the desktop are black. Each call advances to the next frame.
+    virtual bool Capture(const RECT& region, PixelImage& frame) = 0;
+};
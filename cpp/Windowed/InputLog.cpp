@@ -0,0 +1,414 @@
+#include "InputLog.h"
+#include <cstring>
+#include <iterator>
+
+namespace {
+
+const char magic[4] = { 'S', 'F', 'I', 'L' };
+const size_t writeBlockSize = 16 * 1024;
+
+// Effect bindings of a version 2 SHORTCUTS record, in wire order after their count. Bindings
+// added later go at the end: readers keep the ones they know and skip the rest.
+KeyChord ShortcutConfig::* const effectChords[] = {
+    &ShortcutConfig::cycleVisionMode,
+    &ShortcutConfig::cycleVisionSeverity,
+    &ShortcutConfig::warmer,
+    &ShortcutConfig::cooler,
+    &ShortcutConfig::cyclePrivacyEffect,
+    &ShortcutConfig::toggleBinarize,
+    &ShortcutConfig::cycleBinarizeWindow,
+    &ShortcutConfig::toggleAutoInvert,
+    &ShortcutConfig::toggleSmartInvert,
+    &ShortcutConfig::cycleSharpen,
+};
+const size_t effectChordCount = sizeof(effectChords) / sizeof(effectChords[0]);
+
+void PutVarint(std::vector<uint8_t>& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+void PutSigned(std::vector<uint8_t>& out, int64_t value) {
+    PutVarint(out, (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+}
+
+void PutRect(std::vector<uint8_t>& out, const RECT& rect) {
+    PutSigned(out, rect.left);
+    PutSigned(out, rect.top);
+    PutSigned(out, rect.right);
+    PutSigned(out, rect.bottom);
+}
+
+void PutChord(std::vector<uint8_t>& out, const KeyChord& chord) {
+    PutVarint(out, chord.key);
+    PutVarint(out, chord.modifiers);
+}
+
+void PutEffects(std::vector<uint8_t>& out, const InputLogEffects& effects) {
+    out.push_back(effects.flags);
+    out.push_back(effects.visionMode);
+    out.push_back(effects.visionSeverity);
+    PutSigned(out, effects.colorTemperature);
+    out.push_back(effects.sharpenLevel);
+    out.push_back(effects.privacyEffect);
+    PutSigned(out, effects.blurRadius);
+    PutSigned(out, effects.pixelateBlock);
+    PutSigned(out, effects.binarizeWindow);
+}
+
+// Bounds-checked reader over the log bytes; once a read fails every later one does too
+class Reader {
+private:
+    const uint8_t* data;
+    size_t size;
+    size_t position;
+    bool failed;
+
+public:
+    Reader(const uint8_t* logData, size_t logSize) : data(logData), size(logSize), position(0), failed(false) {}
+
+    bool AtEnd() const { return position >= size; }
+    bool Failed() const { return failed; }
+    size_t Position() const { return position; }
+
+    uint8_t Byte() {
+        if (position >= size) {
+            failed = true;
+            return 0;
+        }
+        return data[position++];
+    }
+
+    uint64_t Varint() {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            uint8_t byte = Byte();
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0)
+                return value;
+        }
+        failed = true;
+        return 0;
+    }
+
+    int64_t Signed() {
+        uint64_t value = Varint();
+        return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+    }
+
+    LONG Long() { return static_cast<LONG>(Signed()); }
+    UINT Uint() { return static_cast<UINT>(Varint()); }
+
+    void Rect(RECT& rect) {
+        rect.left = Long();
+        rect.top = Long();
+        rect.right = Long();
+        rect.bottom = Long();
+    }
+
+    void Chord(KeyChord& chord) {
+        chord.key = Uint();
+        chord.modifiers = Uint();
+    }
+
+    void Effects(InputLogEffects& effects) {
+        effects.flags = Byte();
+        effects.visionMode = Byte();
+        effects.visionSeverity = Byte();
+        effects.colorTemperature = static_cast<int>(Signed());
+        effects.sharpenLevel = Byte();
+        effects.privacyEffect = Byte();
+        effects.blurRadius = static_cast<int>(Signed());
+        effects.pixelateBlock = static_cast<int>(Signed());
+        effects.binarizeWindow = static_cast<int>(Signed());
+    }
+};
+
+}
+
+void InputLogEffects::Capture(const ColorEffectSettings& settings) {
+    flags = static_cast<uint8_t>((settings.binarizeEnabled ? INPUT_EFFECT_BINARIZE : 0) |
+        (settings.autoInvert ? INPUT_EFFECT_AUTO_INVERT : 0) | (settings.smartInvert ? INPUT_EFFECT_SMART_INVERT : 0));
+    visionMode = static_cast<uint8_t>(settings.visionMode);
+    visionSeverity = static_cast<uint8_t>(settings.visionSeverity);
+    colorTemperature = settings.colorTemperature;
+    sharpenLevel = static_cast<uint8_t>(settings.sharpenLevel);
+    privacyEffect = static_cast<uint8_t>(settings.privacyEffect);
+    blurRadius = settings.blurRadius;
+    pixelateBlock = settings.pixelateBlock;
+    binarizeWindow = settings.binarizeWindow;
+}
+
+void InputLogEffects::ApplyTo(ColorEffectSettings& settings) const {
+    settings.binarizeEnabled = (flags & INPUT_EFFECT_BINARIZE) != 0;
+    settings.autoInvert = (flags & INPUT_EFFECT_AUTO_INVERT) != 0;
+    settings.smartInvert = (flags & INPUT_EFFECT_SMART_INVERT) != 0;
+    settings.visionMode = visionMode;
+    settings.visionSeverity = visionSeverity;
+    settings.colorTemperature = colorTemperature;
+    settings.sharpenLevel = sharpenLevel;
+    settings.privacyEffect = privacyEffect;
+    settings.blurRadius = blurRadius;
+    settings.pixelateBlock = pixelateBlock;
+    settings.binarizeWindow = binarizeWindow;
+}
+
+const char* InputLogRecordName(InputLogRecordType type) {
+    switch (type) {
+    case INPUT_LOG_CLICK: return "click";
+    case INPUT_LOG_KEY: return "key";
+    case INPUT_LOG_SYSKEY: return "syskey";
+    case INPUT_LOG_HOTKEY: return "hotkey";
+    case INPUT_LOG_MAXIMIZE: return "maximize";
+    case INPUT_LOG_FRAME: return "frame";
+    case INPUT_LOG_CONTROL: return "control";
+    case INPUT_LOG_MOVED: return "moved";
+    case INPUT_LOG_SLOT: return "slot";
+    case INPUT_LOG_SHORTCUTS: return "shortcuts";
+    case INPUT_LOG_STATE: return "state";
+    }
+    return "unknown";
+}
+
+void EncodeInputLogHeader(const InputLogHeader& header, std::vector<uint8_t>& out) {
+    out.insert(out.end(), magic, magic + sizeof(magic));
+    out.push_back(INPUT_LOG_VERSION);
+    out.insert(out.end(), 3, 0);
+    PutSigned(out, header.frame.titleBarHeight);
+    PutSigned(out, header.frame.borderWidth);
+    PutSigned(out, header.frame.borderHeight);
+    PutSigned(out, header.screenWidth);
+    PutSigned(out, header.screenHeight);
+}
+
+void EncodeInputLogRecord(const InputLogRecord& record, int64_t& previousTimeUs, std::vector<uint8_t>& out) {
+    // Out-of-order times (e.g. a caller mixing clocks) are clamped rather than wrapped
+    int64_t deltaUs = record.timeUs > previousTimeUs ? record.timeUs - previousTimeUs : 0;
+    previousTimeUs += deltaUs;
+
+    out.push_back(static_cast<uint8_t>(record.type));
+    PutVarint(out, static_cast<uint64_t>(deltaUs));
+
+    switch (record.type) {
+    case INPUT_LOG_CLICK:
+        PutSigned(out, record.point.x);
+        PutSigned(out, record.point.y);
+        break;
+    case INPUT_LOG_KEY:
+    case INPUT_LOG_SYSKEY:
+        PutVarint(out, record.key);
+        PutVarint(out, record.modifiers);
+        break;
+    case INPUT_LOG_HOTKEY:
+        PutVarint(out, record.key);
+        break;
+    case INPUT_LOG_MAXIMIZE:
+    case INPUT_LOG_FRAME:
+        break;
+    case INPUT_LOG_CONTROL:
+        out.push_back(record.control.code);
+        out.push_back(record.control.length);
+        out.insert(out.end(), record.control.payload, record.control.payload + record.control.length);
+        break;
+    case INPUT_LOG_MOVED:
+        PutRect(out, record.windowRect);
+        break;
+    case INPUT_LOG_SLOT:
+        out.push_back(record.slot.slot);
+        out.push_back(static_cast<uint8_t>((record.slot.isValid ? 1 : 0) | (record.slot.inversionEnabled ? 2 : 0) |
+            (record.slot.grayscaleEnabled ? 4 : 0)));
+        out.push_back(record.slot.grayLevel);
+        PutRect(out, record.slot.windowRect);
+        PutEffects(out, record.slot.effects);
+        break;
+    case INPUT_LOG_SHORTCUTS:
+        PutChord(out, record.shortcuts.toggleInvert);
+        PutChord(out, record.shortcuts.toggleGrayscale);
+        PutChord(out, record.shortcuts.cycleWhiteLevel);
+        PutChord(out, record.shortcuts.toggleMetricsOverlay);
+        PutChord(out, record.shortcuts.toggleTrace);
+        PutVarint(out, record.shortcuts.escapeKey);
+        PutChord(out, record.shortcuts.globalHotkey);
+        PutVarint(out, effectChordCount);
+        for (KeyChord ShortcutConfig::* chord : effectChords)
+            PutChord(out, record.shortcuts.*chord);
+        break;
+    case INPUT_LOG_STATE:
+        out.push_back(record.state.selection);
+        out.push_back(record.state.flags);
+        out.push_back(record.state.grayLevel);
+        out.push_back(record.state.cycleSlot);
+        PutRect(out, record.state.windowRect);
+        PutEffects(out, record.state.effects);
+        break;
+    }
+}
+
+bool DecodeInputLog(const uint8_t* data, size_t size, InputLogHeader& header, std::vector<InputLogRecord>& records, std::string& error) {
+    if (size < 8 || memcmp(data, magic, sizeof(magic)) != 0) {
+        error = "not an input log";
+        return false;
+    }
+    if (data[4] < INPUT_LOG_VERSION_MIN || data[4] > INPUT_LOG_VERSION) {
+        error = "unsupported input log version " + std::to_string(data[4]);
+        return false;
+    }
+
+    Reader reader(data + 8, size - 8);
+    header.version = data[4];
+    bool hasEffects = header.version >= 2;
+    header.frame.titleBarHeight = reader.Long();
+    header.frame.borderWidth = reader.Long();
+    header.frame.borderHeight = reader.Long();
+    header.screenWidth = reader.Long();
+    header.screenHeight = reader.Long();
+    if (reader.Failed()) {
+        error = "truncated header";
+        return false;
+    }
+
+    int64_t timeUs = 0;
+    while (!reader.AtEnd()) {
+        size_t start = reader.Position();
+        InputLogRecord record;
+        uint8_t type = reader.Byte();
+        timeUs += static_cast<int64_t>(reader.Varint());
+        record.type = static_cast<InputLogRecordType>(type);
+        record.timeUs = timeUs;
+
+        switch (record.type) {
+        case INPUT_LOG_CLICK:
+            record.point.x = reader.Long();
+            record.point.y = reader.Long();
+            break;
+        case INPUT_LOG_KEY:
+        case INPUT_LOG_SYSKEY:
+            record.key = reader.Uint();
+            record.modifiers = reader.Uint();
+            break;
+        case INPUT_LOG_HOTKEY:
+            record.key = reader.Uint();
+            break;
+        case INPUT_LOG_MAXIMIZE:
+        case INPUT_LOG_FRAME:
+            break;
+        case INPUT_LOG_CONTROL:
+            record.control.code = reader.Byte();
+            record.control.length = reader.Byte();
+            if (record.control.length > CONTROL_MAX_PAYLOAD) {
+                error = "control payload too long at offset " + std::to_string(8 + start);
+                return false;
+            }
+            for (uint8_t i = 0; i < record.control.length; i++)
+                record.control.payload[i] = reader.Byte();
+            break;
+        case INPUT_LOG_MOVED:
+            reader.Rect(record.windowRect);
+            break;
+        case INPUT_LOG_SLOT: {
+            record.slot.slot = reader.Byte();
+            uint8_t flags = reader.Byte();
+            record.slot.isValid = (flags & 1) != 0;
+            record.slot.inversionEnabled = (flags & 2) != 0;
+            record.slot.grayscaleEnabled = (flags & 4) != 0;
+            record.slot.grayLevel = reader.Byte();
+            reader.Rect(record.slot.windowRect);
+            if (hasEffects)
+                reader.Effects(record.slot.effects);
+            break;
+        }
+        case INPUT_LOG_SHORTCUTS:
+            reader.Chord(record.shortcuts.toggleInvert);
+            reader.Chord(record.shortcuts.toggleGrayscale);
+            reader.Chord(record.shortcuts.cycleWhiteLevel);
+            reader.Chord(record.shortcuts.toggleMetricsOverlay);
+            reader.Chord(record.shortcuts.toggleTrace);
+            record.shortcuts.escapeKey = reader.Uint();
+            reader.Chord(record.shortcuts.globalHotkey);
+            if (hasEffects) {
+                uint64_t count = reader.Varint();
+                for (uint64_t i = 0; i < count && !reader.Failed(); i++) {
+                    KeyChord chord;
+                    reader.Chord(chord);
+                    if (i < effectChordCount)
+                        record.shortcuts.*effectChords[i] = chord;
+                }
+            }
+            break;
+        case INPUT_LOG_STATE:
+            record.state.selection = reader.Byte();
+            record.state.flags = reader.Byte();
+            record.state.grayLevel = reader.Byte();
+            record.state.cycleSlot = reader.Byte();
+            reader.Rect(record.state.windowRect);
+            if (hasEffects)
+                reader.Effects(record.state.effects);
+            break;
+        default:
+            error = "unknown record type " + std::to_string(type) + " at offset " + std::to_string(8 + start);
+            return false;
+        }
+
+        if (reader.Failed()) {
+            error = "truncated record at offset " + std::to_string(8 + start);
+            return false;
+        }
+        records.push_back(record);
+    }
+    return true;
+}
+
+bool ReadInputLogFile(const char* path, InputLogHeader& header, std::vector<InputLogRecord>& records, std::string& error) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        error = std::string("could not open ") + path;
+        return false;
+    }
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    return DecodeInputLog(data.data(), data.size(), header, records, error);
+}
+
+InputLogWriter::InputLogWriter() : previousTimeUs(0) {
+}
+
+InputLogWriter::~InputLogWriter() {
+    Close();
+}
+
+bool InputLogWriter::Open(const char* path, const InputLogHeader& header) {
+    Close();
+    file.open(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open())
+        return false;
+
+    previousTimeUs = 0;
+    buffer.clear();
+    EncodeInputLogHeader(header, buffer);
+    FlushBuffer();
+    return true;
+}
+
+void InputLogWriter::Write(const InputLogRecord& record) {
+    if (!file.is_open())
+        return;
+    EncodeInputLogRecord(record, previousTimeUs, buffer);
+    if (buffer.size() >= writeBlockSize)
+        FlushBuffer();
+}
+
+void InputLogWriter::FlushBuffer() {
+    if (!buffer.empty())
+        file.write(reinterpret_cast<const char*>(buffer.data()), static_cast<std::streamsize>(buffer.size()));
+    buffer.clear();
+}
+
+void InputLogWriter::Close() {
+    if (!file.is_open())
+        return;
+    FlushBuffer();
+    file.close();
+}
@@ -0,0 +1,207 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "Platform.h"
+#include "ControlProtocol.h"
+#include "FramePipeline.h"
+#include "ShortcutConfig.h"
+
+// Binary log of the input a filter window handled and the states it went through, written by
+// the application with /record=<path> and replayed headlessly by screenfilter_bench --replay.
+//
+//   file:    "SFIL", u8 version, 3 reserved bytes (0), varint caption height, border width,
+//            border height, screen width, screen height, then records until the end of the file
+//   record:  u8 type, varint microseconds since the previous record, type-specific fields
+//
+// Fields are unsigned LEB128 varints; signed ones are zigzag-encoded first. A frame tick is two
+// bytes, so an hour of idle recording stays under half a megabyte.
+//
+// The window writes each input as it arrives, followed by the saved rectangles it read from
+// file while handling it and, if the input changed anything, the state it left the window in.
+//
+// Version 2 adds the effects beyond inversion, grayscale and the white level to SLOT and STATE
+// records, and their key bindings to SHORTCUTS. Version 1 logs are still read; their records
+// carry the default effects and bindings.
+
+#define INPUT_LOG_VERSION 2
+#define INPUT_LOG_VERSION_MIN 1
+
+enum InputLogRecordType {
+    // Input, in the order the window handled it
+    INPUT_LOG_CLICK = 1,     // i32 x, y: left button down during selection, screen pixels
+    INPUT_LOG_KEY = 2,       // u32 virtual key, u32 MOD_* held: WM_KEYDOWN
+    INPUT_LOG_SYSKEY = 3,    // u32 virtual key, u32 MOD_* held: WM_SYSKEYDOWN
+    INPUT_LOG_HOTKEY = 4,    // u32 hotkey id
+    INPUT_LOG_MAXIMIZE = 5,  // Maximize command from the title bar or system menu
+    INPUT_LOG_FRAME = 6,     // Frame timer tick
+    INPUT_LOG_CONTROL = 7,   // u8 opcode, u8 payload length, payload: control channel request
+
+    // Context
+    INPUT_LOG_MOVED = 8,     // i32 left, top, right, bottom: the window was moved or sized by the user
+    INPUT_LOG_SLOT = 9,      // u8 slot, u8 flags, u8 gray level, i32 left, top, right, bottom, InputLogEffects
+    INPUT_LOG_SHORTCUTS = 10, // Key bindings, at the start and after every reload; since version 2
+                              // followed by a count and the effect bindings (see InputLog.cpp)
+    INPUT_LOG_STATE = 11     // InputLogState after the preceding input
+};
+
+// InputLogState flags
+#define INPUT_STATE_FULL_SCREEN 0x01
+#define INPUT_STATE_PINNED 0x02
+#define INPUT_STATE_INVERTED 0x04
+#define INPUT_STATE_GRAYSCALE 0x08
+#define INPUT_STATE_EFFECTS_APPLIED 0x10
+
+// InputLogEffects flags
+#define INPUT_EFFECT_BINARIZE 0x01
+#define INPUT_EFFECT_AUTO_INVERT 0x02
+#define INPUT_EFFECT_SMART_INVERT 0x04
+
+// The ColorEffectSettings besides inversion, grayscale and the white level (version 2):
+// u8 flags, u8 vision mode, u8 vision severity, varint temperature, u8 sharpen level,
+// u8 privacy effect, varint blur radius, varint pixelate block, varint binarize window
+struct InputLogEffects {
+    uint8_t flags; // INPUT_EFFECT_*
+    uint8_t visionMode;
+    uint8_t visionSeverity;
+    int colorTemperature;
+    uint8_t sharpenLevel;
+    uint8_t privacyEffect;
+    int blurRadius;
+    int pixelateBlock;
+    int binarizeWindow;
+
+    InputLogEffects() { Capture(ColorEffectSettings()); }
+
+    void Capture(const ColorEffectSettings& settings);
+
+    // Set these fields of 'settings'; inversion, grayscale and the white level are left alone
+    void ApplyTo(ColorEffectSettings& settings) const;
+
+    bool operator==(const InputLogEffects& other) const {
+        return flags == other.flags && visionMode == other.visionMode && visionSeverity == other.visionSeverity &&
+            colorTemperature == other.colorTemperature && sharpenLevel == other.sharpenLevel &&
+            privacyEffect == other.privacyEffect && blurRadius == other.blurRadius &&
+            pixelateBlock == other.pixelateBlock && binarizeWindow == other.binarizeWindow;
+    }
+    bool operator!=(const InputLogEffects& other) const { return !(*this == other); }
+};
+
+// Selection and effect state of the window
+struct InputLogState {
+    uint8_t selection;  // SelectionState: 0 none, 1 first point clicked, 2 complete
+    uint8_t flags;      // INPUT_STATE_*
+    uint8_t grayLevel;
+    uint8_t cycleSlot;  // Slot the 0 key loaded last
+    RECT windowRect;    // Screen pixels, including the frame
+    InputLogEffects effects;
+
+    // The fields version 1 records
+    bool SameVersion1State(const InputLogState& other) const {
+        return selection == other.selection && flags == other.flags && grayLevel == other.grayLevel &&
+            cycleSlot == other.cycleSlot && windowRect.left == other.windowRect.left &&
+            windowRect.top == other.windowRect.top && windowRect.right == other.windowRect.right &&
+            windowRect.bottom == other.windowRect.bottom;
+    }
+
+    bool operator==(const InputLogState& other) const { return SameVersion1State(other) && effects == other.effects; }
+    bool operator!=(const InputLogState& other) const { return !(*this == other); }
+};
+
+// A saved rectangle as the window would load it: the window rectangle is already resolved
+// against the monitor layout of the recording machine
+struct InputLogSlot {
+    uint8_t slot;
+    bool isValid;
+    bool inversionEnabled;
+    bool grayscaleEnabled;
+    uint8_t grayLevel;
+    RECT windowRect;
+    InputLogEffects effects;
+
+    bool operator==(const InputLogSlot& other) const {
+        return slot == other.slot && isValid == other.isValid && inversionEnabled == other.inversionEnabled &&
+            grayscaleEnabled == other.grayscaleEnabled && grayLevel == other.grayLevel &&
+            windowRect.left == other.windowRect.left && windowRect.top == other.windowRect.top &&
+            windowRect.right == other.windowRect.right && windowRect.bottom == other.windowRect.bottom &&
+            effects == other.effects;
+    }
+    bool operator!=(const InputLogSlot& other) const { return !(*this == other); }
+};
+
+// Machine properties the window's geometry depends on
+struct InputLogHeader {
+    uint8_t version;    // Of the log read; logs are always written as INPUT_LOG_VERSION
+    WindowFrameMetrics frame;
+    LONG screenWidth;   // SM_CXSCREEN, SM_CYSCREEN: the full-screen window covers these
+    LONG screenHeight;
+
+    InputLogHeader() : version(INPUT_LOG_VERSION), frame(), screenWidth(0), screenHeight(0) {}
+};
+
+// One record; only the fields of its type are meaningful
+struct InputLogRecord {
+    InputLogRecordType type;
+    int64_t timeUs;          // Since the recording started
+    POINT point;             // CLICK
+    UINT key;                // KEY, SYSKEY; the hotkey id for HOTKEY
+    UINT modifiers;          // KEY, SYSKEY
+    ControlRequest control;  // CONTROL; the sequence number is not recorded
+    RECT windowRect;         // MOVED
+    InputLogSlot slot;       // SLOT
+    ShortcutConfig shortcuts; // SHORTCUTS
+    InputLogState state;     // STATE
+
+    InputLogRecord() : type(INPUT_LOG_FRAME), timeUs(0), point(), key(0), modifiers(0), control(), windowRect(), slot(), state() {}
+    InputLogRecord(InputLogRecordType recordType, int64_t recordTimeUs) : InputLogRecord() {
+        type = recordType;
+        timeUs = recordTimeUs;
+    }
+};
+
+// True for the record types that are input to the window rather than context
+inline bool IsInputLogEvent(InputLogRecordType type) {
+    return type >= INPUT_LOG_CLICK && type <= INPUT_LOG_CONTROL;
+}
+
+// Short lower-case name of a record type ("click", "frame", ...)
+const char* InputLogRecordName(InputLogRecordType type);
+
+// Append the wire form of the file header or of a record. Records are delta-encoded against
+// the time of the previous one, which the caller keeps (starting at 0).
+void EncodeInputLogHeader(const InputLogHeader& header, std::vector<uint8_t>& out);
+void EncodeInputLogRecord(const InputLogRecord& record, int64_t& previousTimeUs, std::vector<uint8_t>& out);
+
+// Parse a whole log. Returns false with a description of the first problem if the data is not
+// a log of a supported version or ends inside a record; records up to that point are kept.
+bool DecodeInputLog(const uint8_t* data, size_t size, InputLogHeader& header, std::vector<InputLogRecord>& records, std::string& error);
+
+// Read and parse a log file
+bool ReadInputLogFile(const char* path, InputLogHeader& header, std::vector<InputLogRecord>& records, std::string& error);
+
+// Appends records to a log file. Records are buffered and written in blocks, so recording
+// costs no system call per input; Close() writes the rest.
+class InputLogWriter {
+private:
+    std::ofstream file;
+    std::vector<uint8_t> buffer;
+    int64_t previousTimeUs;
+
+    void FlushBuffer();
+
+public:
+    InputLogWriter();
+    ~InputLogWriter();
+
+    // Create or truncate the file and write the header
+    bool Open(const char* path, const InputLogHeader& header);
+
+    bool IsOpen() const { return file.is_open(); }
+
+    void Write(const InputLogRecord& record);
+
+    void Close();
+};
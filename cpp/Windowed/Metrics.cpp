@@ -0,0 +1,132 @@
+#include "Metrics.h"
+#include <sstream>
+#include <cstdio>
+
+// Each thread gets a shard on first use, assigned round-robin
+size_t MetricCounter::ShardIndex() {
+    static std::atomic<size_t> nextShard(0);
+    thread_local size_t shard = nextShard.fetch_add(1, std::memory_order_relaxed) % METRIC_SHARDS;
+    return shard;
+}
+
+uint64_t MetricCounter::Value() const {
+    uint64_t total = 0;
+    for (const Shard& shard : shards)
+        total += shard.value.load(std::memory_order_relaxed);
+    return total;
+}
+
+MetricHistogram::MetricHistogram(const std::vector<double>& upperBounds)
+    : bounds(upperBounds), buckets(new std::atomic<uint64_t>[upperBounds.size() + 1]), sum(0.0) {
+    for (size_t i = 0; i <= bounds.size(); i++)
+        buckets[i].store(0, std::memory_order_relaxed);
+}
+
+void MetricHistogram::Observe(double seconds) {
+    // Few buckets: a linear scan beats a binary search here
+    size_t index = 0;
+    while (index < bounds.size() && seconds > bounds[index])
+        index++;
+    buckets[index].fetch_add(1, std::memory_order_relaxed);
+    count.Increment();
+
+    double current = sum.load(std::memory_order_relaxed);
+    while (!sum.compare_exchange_weak(current, current + seconds, std::memory_order_relaxed)) {
+    }
+}
+
+MetricsRegistry::Entry* MetricsRegistry::Find(const std::string& name) {
+    for (const std::unique_ptr<Entry>& entry : entries) {
+        if (entry->name == name)
+            return entry.get();
+    }
+    return NULL;
+}
+
+// The entry for 'name', added if new. A name taken by another type gets a fresh entry that is
+// kept out of the export, so the caller still has a metric to update.
+MetricsRegistry::Entry* MetricsRegistry::Register(const std::string& name, const std::string& help, MetricType type) {
+    Entry* entry = Find(name);
+    if (entry != NULL && entry->type == type)
+        return entry;
+
+    std::vector<std::unique_ptr<Entry>>& owner = entry == NULL ? entries : unexported;
+    owner.emplace_back(new Entry());
+    entry = owner.back().get();
+    entry->name = name;
+    entry->help = help;
+    entry->type = type;
+    return entry;
+}
+
+MetricCounter& MetricsRegistry::Counter(const std::string& name, const std::string& help) {
+    std::lock_guard<std::mutex> guard(lock);
+    Entry* entry = Register(name, help, METRIC_COUNTER);
+    if (!entry->counter)
+        entry->counter.reset(new MetricCounter());
+    return *entry->counter;
+}
+
+MetricGauge& MetricsRegistry::Gauge(const std::string& name, const std::string& help) {
+    std::lock_guard<std::mutex> guard(lock);
+    Entry* entry = Register(name, help, METRIC_GAUGE);
+    if (!entry->gauge)
+        entry->gauge.reset(new MetricGauge());
+    return *entry->gauge;
+}
+
+MetricHistogram& MetricsRegistry::Histogram(const std::string& name, const std::string& help, const std::vector<double>& upperBounds) {
+    std::lock_guard<std::mutex> guard(lock);
+    Entry* entry = Register(name, help, METRIC_HISTOGRAM);
+    if (!entry->histogram)
+        entry->histogram.reset(new MetricHistogram(upperBounds));
+    return *entry->histogram;
+}
+
+// Prometheus text exposition format
+void MetricsRegistry::WritePrometheus(std::ostream& out) const {
+    std::lock_guard<std::mutex> guard(lock);
+    char number[64];
+
+    for (const std::unique_ptr<Entry>& entry : entries) {
+        out << "# HELP " << entry->name << " " << entry->help << "\n";
+        switch (entry->type) {
+        case METRIC_COUNTER:
+            out << "# TYPE " << entry->name << " counter\n";
+            out << entry->name << " " << entry->counter->Value() << "\n";
+            break;
+        case METRIC_GAUGE:
+            snprintf(number, sizeof(number), "%.9g", entry->gauge->Value());
+            out << "# TYPE " << entry->name << " gauge\n";
+            out << entry->name << " " << number << "\n";
+            break;
+        case METRIC_HISTOGRAM: {
+            const MetricHistogram& histogram = *entry->histogram;
+            out << "# TYPE " << entry->name << " histogram\n";
+            uint64_t cumulative = 0;
+            for (size_t i = 0; i < histogram.GetBounds().size(); i++) {
+                cumulative += histogram.BucketCount(i);
+                snprintf(number, sizeof(number), "%g", histogram.GetBounds()[i]);
+                out << entry->name << "_bucket{le=\"" << number << "\"} " << cumulative << "\n";
+            }
+            cumulative += histogram.BucketCount(histogram.GetBounds().size());
+            out << entry->name << "_bucket{le=\"+Inf\"} " << cumulative << "\n";
+            snprintf(number, sizeof(number), "%.9g", histogram.Sum());
+            out << entry->name << "_sum " << number << "\n";
+            out << entry->name << "_count " << histogram.Count() << "\n";
+            break;
+        }
+        }
+    }
+}
+
+std::string MetricsRegistry::FormatPrometheus() const {
+    std::ostringstream out;
+    WritePrometheus(out);
+    return out.str();
+}
+
+// Default latency buckets: 50us .. 1s
+std::vector<double> DefaultLatencyBuckets() {
+    return { 0.00005, 0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 1.0 };
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#define METRIC_SHARDS 8
+
+// Counter split across cache-line-sized shards so threads incrementing it do not contend.
+// Increment is a single relaxed atomic add; reads sum the shards.
+class MetricCounter {
+private:
+    struct alignas(64) Shard {
+        std::atomic<uint64_t> value;
+        Shard() : value(0) {}
+    };
+    Shard shards[METRIC_SHARDS];
+
+    static size_t ShardIndex();
+
+public:
+    void Increment(uint64_t amount = 1) {
+        shards[ShardIndex()].value.fetch_add(amount, std::memory_order_relaxed);
+    }
+
+    uint64_t Value() const;
+};
+
+// Last-written value
+class MetricGauge {
+private:
+    std::atomic<double> value;
+
+public:
+    MetricGauge() : value(0.0) {}
+
+    void Set(double newValue) { value.store(newValue, std::memory_order_relaxed); }
+    double Value() const { return value.load(std::memory_order_relaxed); }
+};
+
+// Distribution over fixed bucket upper bounds, in seconds
+class MetricHistogram {
+private:
+    std::vector<double> bounds;
+    std::unique_ptr<std::atomic<uint64_t>[]> buckets; // One per bound plus +Inf
+    MetricCounter count;
+    std::atomic<double> sum;
+
+public:
+    explicit MetricHistogram(const std::vector<double>& upperBounds);
+
+    void Observe(double seconds);
+
+    const std::vector<double>& GetBounds() const { return bounds; }
+    uint64_t BucketCount(size_t index) const { return buckets[index].load(std::memory_order_relaxed); }
+    uint64_t Count() const { return count.Value(); }
+    double Sum() const { return sum.load(std::memory_order_relaxed); }
+};
+
+// Owns every metric. Registration takes a lock and belongs in startup code;
+// the returned references stay valid for the registry's lifetime and are lock-free to update.
+// Asking for a name already registered as another type returns a metric that is never exported.
+class MetricsRegistry {
+private:
+    enum MetricType { METRIC_COUNTER, METRIC_GAUGE, METRIC_HISTOGRAM };
+
+    struct Entry {
+        std::string name;
+        std::string help;
+        MetricType type;
+        std::unique_ptr<MetricCounter> counter;
+        std::unique_ptr<MetricGauge> gauge;
+        std::unique_ptr<MetricHistogram> histogram;
+    };
+
+    mutable std::mutex lock;
+    std::vector<std::unique_ptr<Entry>> entries;
+    std::vector<std::unique_ptr<Entry>> unexported; // Names already taken by another type
+
+    Entry* Find(const std::string& name);
+    Entry* Register(const std::string& name, const std::string& help, MetricType type);
+
+public:
+    MetricCounter& Counter(const std::string& name, const std::string& help);
+    MetricGauge& Gauge(const std::string& name, const std::string& help);
+    MetricHistogram& Histogram(const std::string& name, const std::string& help, const std::vector<double>& upperBounds);
+
+    // Prometheus text exposition format
+    void WritePrometheus(std::ostream& out) const;
+    std::string FormatPrometheus() const;
+};
+
+// Default latency buckets: 50us .. 1s
+std::vector<double> DefaultLatencyBuckets();
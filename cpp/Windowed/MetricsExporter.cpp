@@ -0,0 +1,172 @@
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "ws2_32.lib")
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#define INVALID_SOCKET (-1)
+#define closesocket close
+#endif
+
+#include "MetricsExporter.h"
+#include <filesystem>
+#include <fstream>
+
+MetricsExporter::MetricsExporter(const MetricsRegistry& source)
+    : registry(source), port(0), interval(1000), stopping(false), listenSocket(INVALID_SOCKET) {
+}
+
+MetricsExporter::~MetricsExporter() {
+    Stop();
+}
+
+// Start exporting. An empty path or port 0 disables that output.
+bool MetricsExporter::Start(const std::string& path, int tcpPort, std::chrono::milliseconds fileInterval) {
+    Stop();
+
+    filePath = path;
+    port = tcpPort;
+    interval = fileInterval;
+    stopping = false;
+
+    if (filePath.empty() && port == 0)
+        return false;
+    if (port != 0 && !OpenListenSocket())
+        return false;
+
+    worker = std::thread(&MetricsExporter::Run, this);
+    return true;
+}
+
+void MetricsExporter::Stop() {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    wake.notify_all();
+    if (worker.joinable())
+        worker.join();
+    CloseListenSocket();
+}
+
+// Write the file once, replacing the previous contents atomically
+bool MetricsExporter::WriteFile() const {
+    if (filePath.empty())
+        return false;
+
+    std::string tempPath = filePath + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::trunc);
+        if (!file.is_open())
+            return false;
+        registry.WritePrometheus(file);
+    }
+
+    std::error_code error;
+    std::filesystem::rename(tempPath, filePath, error);
+    return !error;
+}
+
+bool MetricsExporter::OpenListenSocket() {
+#ifdef _WIN32
+    WSADATA wsaData;
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
+        return false;
+#endif
+
+    intptr_t sock = static_cast<intptr_t>(socket(AF_INET, SOCK_STREAM, IPPROTO_TCP));
+    if (sock == static_cast<intptr_t>(INVALID_SOCKET))
+        return false;
+
+    // Loopback only: metrics are for local tooling
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(static_cast<unsigned short>(port));
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if (bind(sock, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(sock, 4) != 0) {
+        closesocket(sock);
+        return false;
+    }
+
+    listenSocket = sock;
+    return true;
+}
+
+void MetricsExporter::CloseListenSocket() {
+    if (listenSocket == static_cast<intptr_t>(INVALID_SOCKET))
+        return;
+    closesocket(listenSocket);
+    listenSocket = INVALID_SOCKET;
+#ifdef _WIN32
+    WSACleanup();
+#endif
+}
+
+void MetricsExporter::ServeOneConnection() {
+    intptr_t client = static_cast<intptr_t>(accept(listenSocket, NULL, NULL));
+    if (client == static_cast<intptr_t>(INVALID_SOCKET))
+        return;
+
+    // The request itself is irrelevant; every path returns the metrics. A client that connects
+    // and sends nothing gets them after the wait, rather than holding the thread (and Stop()).
+    fd_set readSet;
+    FD_ZERO(&readSet);
+    FD_SET(client, &readSet);
+    timeval timeout = { 0, 200000 };
+    if (select(static_cast<int>(client + 1), &readSet, NULL, NULL, &timeout) > 0) {
+        char request[1024];
+        recv(client, request, sizeof(request), 0);
+    }
+
+    std::string body = registry.FormatPrometheus();
+    std::string response = "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: "
+        + std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n" + body;
+
+    size_t sent = 0;
+    while (sent < response.size()) {
+        int result = send(client, response.data() + sent, static_cast<int>(response.size() - sent), 0);
+        if (result <= 0)
+            break;
+        sent += static_cast<size_t>(result);
+    }
+    closesocket(client);
+}
+
+void MetricsExporter::Run() {
+    std::chrono::steady_clock::time_point nextWrite = std::chrono::steady_clock::now();
+
+    for (;;) {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            if (stopping)
+                break;
+        }
+
+        if (!filePath.empty() && std::chrono::steady_clock::now() >= nextWrite) {
+            WriteFile();
+            nextWrite += interval;
+        }
+
+        if (listenSocket != static_cast<intptr_t>(INVALID_SOCKET)) {
+            // Wake at least every 200 ms to notice Stop() and file deadlines
+            fd_set readSet;
+            FD_ZERO(&readSet);
+            FD_SET(listenSocket, &readSet);
+            timeval timeout = { 0, 200000 };
+            if (select(static_cast<int>(listenSocket + 1), &readSet, NULL, NULL, &timeout) > 0)
+                ServeOneConnection();
+        } else {
+            std::unique_lock<std::mutex> guard(lock);
+            wake.wait_until(guard, nextWrite, [this] { return stopping; });
+        }
+    }
+
+    // Leave a final snapshot behind
+    if (!filePath.empty())
+        WriteFile();
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "Metrics.h"
+
+// Publishes a registry in Prometheus text format from a background thread, to a file
+// rewritten periodically and/or to a loopback TCP port answering each connection with
+// a minimal HTTP response (so both curl and a Prometheus scraper can read it)
+class MetricsExporter {
+private:
+    const MetricsRegistry& registry;
+    std::string filePath;
+    int port;
+    std::chrono::milliseconds interval;
+
+    std::thread worker;
+    std::mutex lock;
+    std::condition_variable wake;
+    bool stopping;
+    intptr_t listenSocket;
+
+    bool OpenListenSocket();
+    void CloseListenSocket();
+    void ServeOneConnection();
+    void Run();
+
+public:
+    explicit MetricsExporter(const MetricsRegistry& source);
+    ~MetricsExporter();
+
+    // Start exporting. An empty path or port 0 disables that output.
+    bool Start(const std::string& path, int tcpPort, std::chrono::milliseconds fileInterval);
+    void Stop();
+
+    // Write the file once, replacing the previous contents atomically
+    bool WriteFile() const;
+};
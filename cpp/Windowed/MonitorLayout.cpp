@@ -0,0 +1,169 @@
+#include "MonitorLayout.h"
+#include <algorithm>
+#include <cmath>
+
+// Replace the layout and rebuild the index
+void MonitorLayout::SetMonitors(const std::vector<MonitorDesc>& newMonitors) {
+    monitors = newMonitors;
+    BuildIndex();
+}
+
+// Build the slab index over the x axis
+void MonitorLayout::BuildIndex() {
+    slabEdges.clear();
+    slabStart.clear();
+    slabMonitors.clear();
+
+    for (const MonitorDesc& monitor : monitors) {
+        slabEdges.push_back(monitor.bounds.left);
+        slabEdges.push_back(monitor.bounds.right);
+    }
+    std::sort(slabEdges.begin(), slabEdges.end());
+    slabEdges.erase(std::unique(slabEdges.begin(), slabEdges.end()), slabEdges.end());
+
+    if (slabEdges.size() < 2) {
+        slabEdges.clear();
+        return;
+    }
+
+    // Monitors in each slab are kept sorted by top edge
+    std::vector<int> byTop(monitors.size());
+    for (size_t i = 0; i < monitors.size(); i++)
+        byTop[i] = static_cast<int>(i);
+    std::sort(byTop.begin(), byTop.end(), [this](int a, int b) {
+        return monitors[a].bounds.top < monitors[b].bounds.top;
+    });
+
+    for (size_t slab = 0; slab + 1 < slabEdges.size(); slab++) {
+        slabStart.push_back(slabMonitors.size());
+        for (int index : byTop) {
+            const RECT& bounds = monitors[index].bounds;
+            if (bounds.left <= slabEdges[slab] && bounds.right >= slabEdges[slab + 1])
+                slabMonitors.push_back(index);
+        }
+    }
+    slabStart.push_back(slabMonitors.size());
+}
+
+#ifdef _WIN32
+// Re-enumerate the monitors attached to the desktop
+bool MonitorLayout::Refresh() {
+    std::vector<MonitorDesc> found;
+
+    EnumDisplayMonitors(NULL, NULL, [](HMONITOR hMonitor, HDC, LPRECT, LPARAM data) -> BOOL {
+        MONITORINFOEXA info;
+        info.cbSize = sizeof(info);
+        if (GetMonitorInfoA(hMonitor, &info)) {
+            MonitorDesc desc;
+            desc.deviceName = info.szDevice;
+            desc.bounds = info.rcMonitor;
+            desc.isPrimary = (info.dwFlags & MONITORINFOF_PRIMARY) != 0;
+            reinterpret_cast<std::vector<MonitorDesc>*>(data)->push_back(desc);
+        }
+        return TRUE;
+    }, reinterpret_cast<LPARAM>(&found));
+
+    if (found.empty())
+        return false;
+
+    SetMonitors(found);
+    return true;
+}
+#endif
+
+// Index of the monitor containing the point, or -1
+int MonitorLayout::MonitorFromPoint(LONG x, LONG y) const {
+    if (slabEdges.empty() || x < slabEdges.front() || x >= slabEdges.back())
+        return -1;
+
+    size_t slab = static_cast<size_t>(std::upper_bound(slabEdges.begin(), slabEdges.end(), x) - slabEdges.begin()) - 1;
+    for (size_t i = slabStart[slab]; i < slabStart[slab + 1]; i++) {
+        const RECT& bounds = monitors[slabMonitors[i]].bounds;
+        if (y < bounds.top)
+            break;
+        if (y < bounds.bottom)
+            return slabMonitors[i];
+    }
+    return -1;
+}
+
+// Index of the monitor containing or closest to the point, or -1 if there are none
+int MonitorLayout::NearestMonitor(LONG x, LONG y) const {
+    int index = MonitorFromPoint(x, y);
+    if (index >= 0)
+        return index;
+
+    long long bestDistance = -1;
+    for (size_t i = 0; i < monitors.size(); i++) {
+        const RECT& bounds = monitors[i].bounds;
+        long long dx = (x < bounds.left) ? bounds.left - x : (x >= bounds.right ? x - bounds.right + 1 : 0);
+        long long dy = (y < bounds.top) ? bounds.top - y : (y >= bounds.bottom ? y - bounds.bottom + 1 : 0);
+        long long distance = dx * dx + dy * dy;
+        if (bestDistance < 0 || distance < bestDistance) {
+            bestDistance = distance;
+            index = static_cast<int>(i);
+        }
+    }
+    return index;
+}
+
+// Index of the monitor with the given device name, or -1
+int MonitorLayout::FindByName(const std::string& deviceName) const {
+    for (size_t i = 0; i < monitors.size(); i++) {
+        if (monitors[i].deviceName == deviceName)
+            return static_cast<int>(i);
+    }
+    return -1;
+}
+
+// Index of the primary monitor, or -1 if there are none
+int MonitorLayout::PrimaryMonitor() const {
+    for (size_t i = 0; i < monitors.size(); i++) {
+        if (monitors[i].isPrimary)
+            return static_cast<int>(i);
+    }
+    return monitors.empty() ? -1 : 0;
+}
+
+// Express a screen rectangle relative to the monitor holding its centre
+bool MonitorLayout::Normalize(const RECT& rect, NormalizedRect& result) const {
+    int index = NearestMonitor((rect.left + rect.right) / 2, (rect.top + rect.bottom) / 2);
+    if (index < 0)
+        return false;
+
+    const MonitorDesc& monitor = monitors[index];
+    double width = static_cast<double>(monitor.bounds.right - monitor.bounds.left);
+    double height = static_cast<double>(monitor.bounds.bottom - monitor.bounds.top);
+    if (width <= 0.0 || height <= 0.0)
+        return false;
+
+    result.monitor = monitor.deviceName;
+    result.left = (rect.left - monitor.bounds.left) / width;
+    result.top = (rect.top - monitor.bounds.top) / height;
+    result.right = (rect.right - monitor.bounds.left) / width;
+    result.bottom = (rect.bottom - monitor.bounds.top) / height;
+    return true;
+}
+
+// Map a normalized rectangle back to screen pixels
+bool MonitorLayout::Resolve(const NormalizedRect& normalized, const RECT* fallbackRect, RECT& result) const {
+    int index = FindByName(normalized.monitor);
+    if (index < 0 && fallbackRect != NULL)
+        index = NearestMonitor((fallbackRect->left + fallbackRect->right) / 2, (fallbackRect->top + fallbackRect->bottom) / 2);
+    if (index < 0)
+        index = PrimaryMonitor();
+    if (index < 0)
+        return false;
+
+    // Clamp to the monitor so a rectangle saved partly off-screen lands fully visible
+    const RECT& bounds = monitors[index].bounds;
+    double width = static_cast<double>(bounds.right - bounds.left);
+    double height = static_cast<double>(bounds.bottom - bounds.top);
+    auto clamp01 = [](double value) { return value < 0.0 ? 0.0 : (value > 1.0 ? 1.0 : value); };
+
+    result.left = bounds.left + static_cast<LONG>(std::lround(clamp01(normalized.left) * width));
+    result.top = bounds.top + static_cast<LONG>(std::lround(clamp01(normalized.top) * height));
+    result.right = bounds.left + static_cast<LONG>(std::lround(clamp01(normalized.right) * width));
+    result.bottom = bounds.top + static_cast<LONG>(std::lround(clamp01(normalized.bottom) * height));
+    return result.right > result.left && result.bottom > result.top;
+}
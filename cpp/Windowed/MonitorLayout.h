@@ -0,0 +1,76 @@
+#pragma once
+
+#include "Platform.h"
+#include <string>
+#include <vector>
+
+// Single display in the current desktop layout
+struct MonitorDesc {
+    std::string deviceName; // e.g. \\.\DISPLAY1
+    RECT bounds;            // Virtual-screen pixels
+    bool isPrimary;
+
+    MonitorDesc() : isPrimary(false) {
+        memset(&bounds, 0, sizeof(RECT));
+    }
+};
+
+// Rectangle stored as a monitor identity plus fractions of that monitor's bounds,
+// so it survives docking, resolution and DPI changes
+struct NormalizedRect {
+    std::string monitor;
+    double left;
+    double top;
+    double right;
+    double bottom;
+
+    NormalizedRect() : left(0.0), top(0.0), right(0.0), bottom(0.0) {}
+};
+
+// Monitor layout with an interval index for point lookups
+class MonitorLayout {
+private:
+    std::vector<MonitorDesc> monitors;
+
+    // Interval index: the x axis is cut into slabs at every monitor's left/right edge,
+    // and each slab lists the monitors spanning it. slabEdges has one more entry than
+    // there are slabs; slab i covers [slabEdges[i], slabEdges[i + 1]) and its monitors
+    // are slabMonitors[slabStart[i] .. slabStart[i + 1]).
+    std::vector<LONG> slabEdges;
+    std::vector<size_t> slabStart;
+    std::vector<int> slabMonitors;
+
+    void BuildIndex();
+
+public:
+    MonitorLayout() {}
+
+    // Replace the layout and rebuild the index
+    void SetMonitors(const std::vector<MonitorDesc>& newMonitors);
+
+#ifdef _WIN32
+    // Re-enumerate the monitors attached to the desktop
+    bool Refresh();
+#endif
+
+    const std::vector<MonitorDesc>& GetMonitors() const { return monitors; }
+
+    // Index of the monitor containing the point, or -1
+    int MonitorFromPoint(LONG x, LONG y) const;
+
+    // Index of the monitor containing or closest to the point, or -1 if there are none
+    int NearestMonitor(LONG x, LONG y) const;
+
+    // Index of the monitor with the given device name, or -1
+    int FindByName(const std::string& deviceName) const;
+
+    // Index of the primary monitor, or -1 if there are none
+    int PrimaryMonitor() const;
+
+    // Express a screen rectangle relative to the monitor holding its centre
+    bool Normalize(const RECT& rect, NormalizedRect& result) const;
+
+    // Map a normalized rectangle back to screen pixels. If its monitor is gone, the rectangle
+    // is placed on the monitor nearest to fallbackRect (if given) or on the primary monitor.
+    bool Resolve(const NormalizedRect& normalized, const RECT* fallbackRect, RECT& result) const;
+};
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// 32-bit BGRA image, the pixel layout of a 32bpp DIB and of the pixel kernels
+struct PixelImage {
+    int width;
+    int height;
+    std::vector<uint32_t> pixels;
+
+    PixelImage() : width(0), height(0) {}
+    PixelImage(int w, int h) : width(w), height(h), pixels(static_cast<size_t>(w) * h, 0xFF000000u) {}
+
+    // Resize without clearing when the size is unchanged
+    void Resize(int w, int h) {
+        width = w;
+        height = h;
+        pixels.resize(static_cast<size_t>(w) * h, 0xFF000000u);
+    }
+
+    uint32_t& At(int x, int y) { return pixels[static_cast<size_t>(y) * width + x]; }
+    uint32_t At(int x, int y) const { return pixels[static_cast<size_t>(y) * width + x]; }
+};
+
+// Luminance of a BGRA pixel in 0..255 (BT.601 weights in 8-bit fixed point)
+inline int PixelLuma(uint32_t pixel) {
+    return static_cast<int>((29 * (pixel & 0xFF) + 150 * ((pixel >> 8) & 0xFF) + 77 * ((pixel >> 16) & 0xFF) + 128) >> 8);
+}
@@ -0,0 +1,429 @@
+#include "PixelKernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include "BlueNoise.h"
+#include "ToneCurve.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PIXEL_KERNELS_SSE2 1
+#include <emmintrin.h>
+#endif
+
+// The AVX2 kernel is compiled for every x86 build and only used when the CPU supports it
+#if defined(PIXEL_KERNELS_SSE2) && (defined(__GNUC__) || defined(__clang__) || defined(_MSC_VER))
+#define PIXEL_KERNELS_AVX2 1
+#include <immintrin.h>
+#if defined(__GNUC__) || defined(__clang__)
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#include <intrin.h>
+#define TARGET_AVX2
+#endif
+#endif
+
+namespace {
+
+// The matrix rearranged for 8-bit channels: out = r * red + g * green + b * blue + offset,
+// per output channel, with the offset scaled to 0..255
+struct KernelCoefficients {
+    float red[3];   // Contribution of the input red channel to output R, G, B
+    float green[3];
+    float blue[3];
+    float offset[3];
+};
+
+KernelCoefficients PrepareCoefficients(const ColorMatrix& matrix) {
+    KernelCoefficients coefficients;
+    for (int channel = 0; channel < 3; channel++) {
+        coefficients.red[channel] = matrix.transform[0][channel];
+        coefficients.green[channel] = matrix.transform[1][channel];
+        coefficients.blue[channel] = matrix.transform[2][channel];
+        coefficients.offset[channel] = matrix.transform[4][channel] * 255.0f;
+    }
+    return coefficients;
+}
+
+// Thresholds for a row of a dithered image repeat every BLUE_NOISE_SIZE pixels
+const size_t thresholdMask = BLUE_NOISE_SIZE - 1;
+
+// Round up from 'threshold': 0.5 rounds to nearest, a dither threshold spreads the fractions
+inline uint32_t ToChannel(float value, float threshold) {
+    if (value <= 0.0f)
+        return 0;
+    if (value >= 255.0f)
+        return 255;
+    return static_cast<uint32_t>(value + threshold);
+}
+
+// Curve entries per output level
+const float curveScale = (TONE_CURVE_SIZE - 1) / 255.0f;
+
+// The curve entry nearest to an unrounded matrix output; 'channelCurve' is one channel of a
+// ToneCurve
+inline float CurveLevel(const float* channelCurve, float value) {
+    value = (std::min)((std::max)(value, 0.0f), 255.0f);
+    return channelCurve[static_cast<int>(value * curveScale + 0.5f)];
+}
+
+// Kernels process one row when dithering; 'thresholds' is that row of the blue-noise tile and
+// 'x' the position of src[0] in the row. With Curve, 'curve' holds ToneCurve::levels and each
+// channel goes through it before rounding.
+template <bool Dither, bool Curve>
+void ApplyScalar(const KernelCoefficients& k, const uint32_t* src, uint32_t* dst, size_t count, const float* thresholds, size_t x, const float* curve) {
+    for (size_t i = 0; i < count; i++) {
+        uint32_t pixel = src[i];
+        float b = static_cast<float>(pixel & 0xFF);
+        float g = static_cast<float>((pixel >> 8) & 0xFF);
+        float r = static_cast<float>((pixel >> 16) & 0xFF);
+        float threshold = Dither ? thresholds[(x + i) & thresholdMask] : 0.5f;
+
+        // Grouped like the vector kernels so every kernel rounds identically
+        float valueR = (r * k.red[0] + g * k.green[0]) + (b * k.blue[0] + k.offset[0]);
+        float valueG = (r * k.red[1] + g * k.green[1]) + (b * k.blue[1] + k.offset[1]);
+        float valueB = (r * k.red[2] + g * k.green[2]) + (b * k.blue[2] + k.offset[2]);
+        if (Curve) {
+            valueR = CurveLevel(curve, valueR);
+            valueG = CurveLevel(curve + TONE_CURVE_SIZE, valueG);
+            valueB = CurveLevel(curve + 2 * TONE_CURVE_SIZE, valueB);
+        }
+        uint32_t outR = ToChannel(valueR, threshold);
+        uint32_t outG = ToChannel(valueG, threshold);
+        uint32_t outB = ToChannel(valueB, threshold);
+        dst[i] = (pixel & 0xFF000000u) | (outR << 16) | (outG << 8) | outB;
+    }
+}
+
+#ifdef PIXEL_KERNELS_SSE2
+// Four pixels per iteration, one channel per register, same rounding as the scalar kernel.
+// SSE2 has no gather, so curve entries are looked up one lane at a time.
+template <bool Dither, bool Curve>
+void ApplySSE2(const KernelCoefficients& k, const uint32_t* src, uint32_t* dst, size_t count, const float* thresholds, const float* curve) {
+    const __m128i byteMask = _mm_set1_epi32(0xFF);
+    const __m128i alphaMask = _mm_set1_epi32(static_cast<int>(0xFF000000u));
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 max = _mm_set1_ps(255.0f);
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 scale = _mm_set1_ps(curveScale);
+
+    __m128 red[3], green[3], blue[3], offset[3];
+    for (int channel = 0; channel < 3; channel++) {
+        red[channel] = _mm_set1_ps(k.red[channel]);
+        green[channel] = _mm_set1_ps(k.green[channel]);
+        blue[channel] = _mm_set1_ps(k.blue[channel]);
+        offset[channel] = _mm_set1_ps(k.offset[channel]);
+    }
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        __m128 b = _mm_cvtepi32_ps(_mm_and_si128(pixels, byteMask));
+        __m128 g = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(pixels, 8), byteMask));
+        __m128 r = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(pixels, 16), byteMask));
+
+        // Four consecutive thresholds: a row of the tile is a multiple of four long
+        __m128 threshold = Dither ? _mm_loadu_ps(thresholds + (i & thresholdMask)) : half;
+        __m128i out[3];
+        for (int channel = 0; channel < 3; channel++) {
+            __m128 value = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r, red[channel]), _mm_mul_ps(g, green[channel])),
+                _mm_add_ps(_mm_mul_ps(b, blue[channel]), offset[channel]));
+            value = _mm_min_ps(_mm_max_ps(value, zero), max);
+            if (Curve) {
+                alignas(16) int32_t index[4];
+                _mm_store_si128(reinterpret_cast<__m128i*>(index), _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(value, scale), half)));
+                const float* channelCurve = curve + channel * TONE_CURVE_SIZE;
+                value = _mm_setr_ps(channelCurve[index[0]], channelCurve[index[1]], channelCurve[index[2]], channelCurve[index[3]]);
+            }
+            out[channel] = _mm_cvttps_epi32(_mm_add_ps(value, threshold));
+        }
+
+        __m128i result = _mm_or_si128(_mm_and_si128(pixels, alphaMask),
+            _mm_or_si128(_mm_slli_epi32(out[0], 16), _mm_or_si128(_mm_slli_epi32(out[1], 8), out[2])));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), result);
+    }
+
+    ApplyScalar<Dither, Curve>(k, src + i, dst + i, count - i, thresholds, i, curve);
+}
+#endif
+
+#ifdef PIXEL_KERNELS_AVX2
+bool CpuSupportsAVX2() {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_cpu_supports("avx2");
+#else
+    // AVX2 flag, plus OS support for saving the YMM registers
+    int info[4];
+    __cpuid(info, 1);
+    bool osSavesYmm = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 0x6) == 0x6;
+    __cpuidex(info, 7, 0);
+    return osSavesYmm && (info[1] & (1 << 5)) != 0;
+#endif
+}
+
+// The SSE2 kernel widened to eight pixels per iteration, with gathers for the curve
+template <bool Dither, bool Curve>
+TARGET_AVX2 void ApplyAVX2(const KernelCoefficients& k, const uint32_t* src, uint32_t* dst, size_t count, const float* thresholds, const float* curve) {
+    const __m256i byteMask = _mm256_set1_epi32(0xFF);
+    const __m256i alphaMask = _mm256_set1_epi32(static_cast<int>(0xFF000000u));
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 max = _mm256_set1_ps(255.0f);
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256 scale = _mm256_set1_ps(curveScale);
+
+    __m256 red[3], green[3], blue[3], offset[3];
+    for (int channel = 0; channel < 3; channel++) {
+        red[channel] = _mm256_set1_ps(k.red[channel]);
+        green[channel] = _mm256_set1_ps(k.green[channel]);
+        blue[channel] = _mm256_set1_ps(k.blue[channel]);
+        offset[channel] = _mm256_set1_ps(k.offset[channel]);
+    }
+
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        __m256 b = _mm256_cvtepi32_ps(_mm256_and_si256(pixels, byteMask));
+        __m256 g = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(pixels, 8), byteMask));
+        __m256 r = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(pixels, 16), byteMask));
+
+        // Separate multiplies and adds (no FMA) to round exactly like the other kernels
+        __m256 threshold = Dither ? _mm256_loadu_ps(thresholds + (i & thresholdMask)) : half;
+        __m256i out[3];
+        for (int channel = 0; channel < 3; channel++) {
+            __m256 value = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(r, red[channel]), _mm256_mul_ps(g, green[channel])),
+                _mm256_add_ps(_mm256_mul_ps(b, blue[channel]), offset[channel]));
+            value = _mm256_min_ps(_mm256_max_ps(value, zero), max);
+            if (Curve) {
+                __m256i index = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(value, scale), half));
+                value = _mm256_i32gather_ps(curve + channel * TONE_CURVE_SIZE, index, 4);
+            }
+            out[channel] = _mm256_cvttps_epi32(_mm256_add_ps(value, threshold));
+        }
+
+        __m256i result = _mm256_or_si256(_mm256_and_si256(pixels, alphaMask),
+            _mm256_or_si256(_mm256_slli_epi32(out[0], 16), _mm256_or_si256(_mm256_slli_epi32(out[1], 8), out[2])));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), result);
+    }
+
+    ApplyScalar<Dither, Curve>(k, src + i, dst + i, count - i, thresholds, i, curve);
+}
+#endif
+
+// Each input channel's contribution to each output channel, for all 256 levels, in 16.16
+// fixed point. Integer adds replace the multiplies; rounding each table entry can move a
+// result that lands within 1/65536 of a rounding boundary by one level.
+#define LUT_FRACTION_BITS 16
+
+struct LutTables {
+    int32_t red[3][256];
+    int32_t green[3][256];
+    int32_t blue[3][256];
+    int32_t offset[3];
+};
+
+void PrepareLUT(const KernelCoefficients& k, bool dither, LutTables& tables) {
+    const double unit = static_cast<double>(1 << LUT_FRACTION_BITS);
+    for (int channel = 0; channel < 3; channel++) {
+        for (int level = 0; level < 256; level++) {
+            tables.red[channel][level] = static_cast<int32_t>(std::lround(level * static_cast<double>(k.red[channel]) * unit));
+            tables.green[channel][level] = static_cast<int32_t>(std::lround(level * static_cast<double>(k.green[channel]) * unit));
+            tables.blue[channel][level] = static_cast<int32_t>(std::lround(level * static_cast<double>(k.blue[channel]) * unit));
+        }
+        // Folds in the +0.5 for rounding; a dithered row adds its thresholds instead
+        tables.offset[channel] = static_cast<int32_t>(std::lround((k.offset[channel] + (dither ? 0.0 : 0.5)) * unit));
+    }
+}
+
+template <bool Dither>
+void ApplyLUT(const LutTables& tables, const uint32_t* src, uint32_t* dst, size_t count, const float* thresholds) {
+    const int32_t maxValue = 255 << LUT_FRACTION_BITS;
+    int32_t fixedThresholds[BLUE_NOISE_SIZE];
+    if (Dither) {
+        for (int x = 0; x < BLUE_NOISE_SIZE; x++)
+            fixedThresholds[x] = static_cast<int32_t>(thresholds[x] * (1 << LUT_FRACTION_BITS));
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        uint32_t pixel = src[i];
+        uint32_t b = pixel & 0xFF;
+        uint32_t g = (pixel >> 8) & 0xFF;
+        uint32_t r = (pixel >> 16) & 0xFF;
+        int32_t threshold = Dither ? fixedThresholds[i & thresholdMask] : 0;
+
+        uint32_t out[3];
+        for (int channel = 0; channel < 3; channel++) {
+            int32_t value = tables.red[channel][r] + tables.green[channel][g] + tables.blue[channel][b] + tables.offset[channel];
+            out[channel] = value <= 0 ? 0 : (value >= maxValue ? 255 : static_cast<uint32_t>(value + threshold) >> LUT_FRACTION_BITS);
+        }
+        dst[i] = (pixel & 0xFF000000u) | (out[0] << 16) | (out[1] << 8) | out[2];
+    }
+}
+
+// A run of pixels through the matrix and the curve; one row when dithering
+template <bool Dither>
+void ApplyWithCurve(PixelKernel kernel, const KernelCoefficients& k, const uint32_t* src, uint32_t* dst, size_t count, const float* thresholds, const float* curve) {
+    switch (kernel) {
+#ifdef PIXEL_KERNELS_SSE2
+    case PIXEL_KERNEL_SSE2:
+        ApplySSE2<Dither, true>(k, src, dst, count, thresholds, curve);
+        return;
+#endif
+#ifdef PIXEL_KERNELS_AVX2
+    case PIXEL_KERNEL_AVX2:
+        ApplyAVX2<Dither, true>(k, src, dst, count, thresholds, curve);
+        return;
+#endif
+    default:
+        ApplyScalar<Dither, true>(k, src, dst, count, thresholds, 0, curve);
+        return;
+    }
+}
+
+}
+
+// Short name used by benchmarks, e.g. "sse2"
+const char* PixelKernelName(PixelKernel kernel) {
+    switch (kernel) {
+    case PIXEL_KERNEL_SCALAR: return "scalar";
+    case PIXEL_KERNEL_SSE2: return "sse2";
+    case PIXEL_KERNEL_AVX2: return "avx2";
+    case PIXEL_KERNEL_LUT: return "lut";
+    default: return "unknown";
+    }
+}
+
+bool IsPixelKernelAvailable(PixelKernel kernel) {
+    switch (kernel) {
+    case PIXEL_KERNEL_SCALAR:
+    case PIXEL_KERNEL_LUT:
+        return true;
+    case PIXEL_KERNEL_SSE2:
+#ifdef PIXEL_KERNELS_SSE2
+        return true;
+#else
+        return false;
+#endif
+    case PIXEL_KERNEL_AVX2:
+#ifdef PIXEL_KERNELS_AVX2
+        {
+            static const bool supported = CpuSupportsAVX2();
+            return supported;
+        }
+#else
+        return false;
+#endif
+    default:
+        return false;
+    }
+}
+
+// Fastest kernel this machine can run that matches the floating-point results exactly
+PixelKernel BestPixelKernel() {
+    if (IsPixelKernelAvailable(PIXEL_KERNEL_AVX2))
+        return PIXEL_KERNEL_AVX2;
+    if (IsPixelKernelAvailable(PIXEL_KERNEL_SSE2))
+        return PIXEL_KERNEL_SSE2;
+    return PIXEL_KERNEL_SCALAR;
+}
+
+// Apply a color matrix to 32-bit BGRA pixels
+void ApplyColorMatrix(PixelKernel kernel, const ColorMatrix& matrix, const uint32_t* src, uint32_t* dst, size_t count) {
+    KernelCoefficients coefficients = PrepareCoefficients(matrix);
+
+    switch (kernel) {
+#ifdef PIXEL_KERNELS_SSE2
+    case PIXEL_KERNEL_SSE2:
+        ApplySSE2<false, false>(coefficients, src, dst, count, NULL, NULL);
+        return;
+#endif
+#ifdef PIXEL_KERNELS_AVX2
+    case PIXEL_KERNEL_AVX2:
+        if (IsPixelKernelAvailable(PIXEL_KERNEL_AVX2)) {
+            ApplyAVX2<false, false>(coefficients, src, dst, count, NULL, NULL);
+            return;
+        }
+        break;
+#endif
+    case PIXEL_KERNEL_LUT: {
+        LutTables tables;
+        PrepareLUT(coefficients, false, tables);
+        ApplyLUT<false>(tables, src, dst, count, NULL);
+        return;
+    }
+    default:
+        break;
+    }
+
+    ApplyScalar<false, false>(coefficients, src, dst, count, NULL, 0, NULL);
+}
+
+// Apply a color matrix to a 32-bit BGRA image, rounding against blue-noise thresholds
+void ApplyColorMatrixDithered(PixelKernel kernel, const ColorMatrix& matrix, const uint32_t* src, uint32_t* dst, int width, int height) {
+    KernelCoefficients coefficients = PrepareCoefficients(matrix);
+    const float* tile = BlueNoiseThresholds();
+    if (!IsPixelKernelAvailable(kernel))
+        kernel = PIXEL_KERNEL_SCALAR;
+
+    LutTables tables;
+    if (kernel == PIXEL_KERNEL_LUT)
+        PrepareLUT(coefficients, true, tables);
+
+    for (int y = 0; y < height; y++) {
+        const float* thresholds = tile + (y & thresholdMask) * BLUE_NOISE_SIZE;
+        size_t offset = static_cast<size_t>(y) * width;
+        switch (kernel) {
+#ifdef PIXEL_KERNELS_SSE2
+        case PIXEL_KERNEL_SSE2:
+            ApplySSE2<true, false>(coefficients, src + offset, dst + offset, width, thresholds, NULL);
+            break;
+#endif
+#ifdef PIXEL_KERNELS_AVX2
+        case PIXEL_KERNEL_AVX2:
+            ApplyAVX2<true, false>(coefficients, src + offset, dst + offset, width, thresholds, NULL);
+            break;
+#endif
+        case PIXEL_KERNEL_LUT:
+            ApplyLUT<true>(tables, src + offset, dst + offset, width, thresholds);
+            break;
+        default:
+            ApplyScalar<true, false>(coefficients, src + offset, dst + offset, width, thresholds, 0, NULL);
+            break;
+        }
+    }
+}
+
+// Apply a color matrix and then a tone curve in one pass
+void ApplyColorMatrixAndCurve(PixelKernel kernel, const ColorMatrix& matrix, const ToneCurve& curve, const uint32_t* src, uint32_t* dst, int width, int height, bool dither) {
+    KernelCoefficients coefficients = PrepareCoefficients(matrix);
+    const float* levels = curve.levels.data();
+
+    // The LUT kernel's fixed-point sums would need converting back to index the curve
+    if (!IsPixelKernelAvailable(kernel) || kernel == PIXEL_KERNEL_LUT)
+        kernel = PIXEL_KERNEL_SCALAR;
+
+    if (!dither) {
+        ApplyWithCurve<false>(kernel, coefficients, src, dst, static_cast<size_t>(width) * height, NULL, levels);
+        return;
+    }
+
+    const float* tile = BlueNoiseThresholds();
+    for (int y = 0; y < height; y++) {
+        size_t offset = static_cast<size_t>(y) * width;
+        ApplyWithCurve<true>(kernel, coefficients, src + offset, dst + offset, width, tile + (y & thresholdMask) * BLUE_NOISE_SIZE, levels);
+    }
+}
+
+// Apply a tone curve alone to 32-bit BGRA pixels
+void ApplyToneCurve(const ToneCurve& curve, const uint32_t* src, uint32_t* dst, size_t count) {
+    // 8-bit input only reaches 256 of the entries: reduce the curve to byte tables
+    uint8_t tables[3][256];
+    for (int channel = 0; channel < 3; channel++) {
+        for (int level = 0; level < 256; level++)
+            tables[channel][level] = static_cast<uint8_t>(ToChannel(CurveLevel(curve.Channel(channel), static_cast<float>(level)), 0.5f));
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        uint32_t pixel = src[i];
+        dst[i] = (pixel & 0xFF000000u) | (static_cast<uint32_t>(tables[0][(pixel >> 16) & 0xFF]) << 16) |
+            (static_cast<uint32_t>(tables[1][(pixel >> 8) & 0xFF]) << 8) | tables[2][pixel & 0xFF];
+    }
+}
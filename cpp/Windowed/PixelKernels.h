@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "ColorEffects.h"
+#include "ToneCurve.h"
+
+// Implementations of ApplyColorMatrix. Not every kernel is available in every build or on every CPU.
+enum PixelKernel {
+    PIXEL_KERNEL_SCALAR,
+    PIXEL_KERNEL_SSE2,
+    PIXEL_KERNEL_AVX2,
+    PIXEL_KERNEL_LUT,  // Fixed-point per-channel tables; may differ from the others by one level
+    PIXEL_KERNEL_COUNT
+};
+
+// Short name used by benchmarks, e.g. "sse2"
+const char* PixelKernelName(PixelKernel kernel);
+
+bool IsPixelKernelAvailable(PixelKernel kernel);
+
+// Fastest kernel this machine can run that matches the floating-point results exactly
+PixelKernel BestPixelKernel();
+
+// Apply a color matrix to 32-bit BGRA pixels (the layout of a 32bpp DIB), the CPU equivalent
+// of what the magnifier does on the GPU. Results are rounded to nearest and clamped; alpha is
+// passed through. src and dst may be the same buffer. Falls back to the scalar kernel if the
+// requested one is not available. Check kernels against the reference with
+// screenfilter_bench --conformance before relying on them.
+void ApplyColorMatrix(PixelKernel kernel, const ColorMatrix& matrix, const uint32_t* src, uint32_t* dst, size_t count);
+
+// ApplyColorMatrix over a width x height image, rounding each channel up from the pixel's
+// blue-noise threshold (BlueNoise.h) instead of from 0.5. A darkened white level stretches a
+// few output levels over wide gradients; dithering spreads the rounding error into fine grain
+// so the steps between levels stop showing as bands. Averaged over an area the output matches
+// the unrounded value. The vector kernels produce the same pixels as the scalar one; LUT may
+// differ by one level.
+void ApplyColorMatrixDithered(PixelKernel kernel, const ColorMatrix& matrix, const uint32_t* src, uint32_t* dst, int width, int height);
+
+// ApplyColorMatrix followed by a per-channel tone curve, in the same pass over the pixels. Each
+// channel's unrounded matrix output picks the nearest of the curve's TONE_CURVE_SIZE entries, so
+// steep parts of the curve do not magnify 8-bit rounding, and the image is read and written
+// once. Dithers like ApplyColorMatrixDithered when 'dither' is set. The vector kernels produce
+// the same pixels as the scalar one; LUT runs the scalar kernel. Only AVX2 can gather, so only
+// it is faster than two passes (screenfilter_bench --filter=tone_curve); the others look the
+// entries up one at a time and trade some speed for the precision.
+void ApplyColorMatrixAndCurve(PixelKernel kernel, const ColorMatrix& matrix, const ToneCurve& curve, const uint32_t* src, uint32_t* dst, int width, int height, bool dither);
+
+// A tone curve alone, on 8-bit pixels: the second pass when the matrix and the curve are applied
+// separately. Alpha is passed through; src and dst may be the same buffer.
+void ApplyToneCurve(const ToneCurve& curve, const uint32_t* src, uint32_t* dst, size_t count);
@@ -0,0 +1,251 @@
+#include "PrivacyEffects.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PRIVACY_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// The vertical pass keeps one running sum per channel of a strip of 512 columns: 8 KB, which
+// stays in L1 while the strip walks down the image, and rows of 2 KB, long enough for the
+// prefetcher. A 4K frame has 8 strips to share out.
+const int stripWidth = 512;
+
+// Rows per task of the horizontal pass and of the copy at radius 0
+const int rowsPerTask = 16;
+
+// Bytes of one image row, from column x0
+inline const uint8_t* RowBytes(const uint32_t* image, int width, int y, int x0) {
+    return reinterpret_cast<const uint8_t*>(image + static_cast<size_t>(y) * width + x0);
+}
+
+// Average of a running sum over the box, rounded to 8 bits
+inline uint8_t BoxAverage(int32_t sum, float scale) {
+    return static_cast<uint8_t>(static_cast<int>(static_cast<float>(sum) * scale + 0.5f));
+}
+
+// Vertical pass over columns x0 .. x0 + count - 1: walks down the strip, adding the row
+// entering the box and subtracting the one leaving it. The loops run over bytes, so the
+// compiler vectorizes them.
+void BlurColumns(const uint32_t* src, uint32_t* dst, int width, int height, int radius, int x0, int count) {
+    int32_t sums[stripWidth * 4];
+    int values = count * 4;
+    float scale = 1.0f / static_cast<float>(2 * radius + 1);
+
+    // Box around row 0: rows -radius .. -1 repeat it
+    const uint8_t* first = RowBytes(src, width, 0, x0);
+    for (int i = 0; i < values; i++)
+        sums[i] = (radius + 1) * first[i];
+    for (int y = 1; y <= radius; y++) {
+        const uint8_t* row = RowBytes(src, width, (std::min)(y, height - 1), x0);
+        for (int i = 0; i < values; i++)
+            sums[i] += row[i];
+    }
+
+    for (int y = 0; y < height; y++) {
+        uint8_t* out = reinterpret_cast<uint8_t*>(dst + static_cast<size_t>(y) * width + x0);
+        const uint8_t* entering = RowBytes(src, width, (std::min)(y + radius + 1, height - 1), x0);
+        const uint8_t* leaving = RowBytes(src, width, (std::max)(y - radius, 0), x0);
+        for (int i = 0; i < values; i++) {
+            out[i] = BoxAverage(sums[i], scale);
+            sums[i] += entering[i] - leaving[i];
+        }
+    }
+}
+
+// Box around pixel 0 of a row: pixels -radius .. -1 repeat it
+void FirstRowSums(const uint32_t* line, int width, int radius, int32_t sums[4]) {
+    for (int channel = 0; channel < 4; channel++)
+        sums[channel] = (radius + 1) * static_cast<int32_t>((line[0] >> (8 * channel)) & 0xFF);
+    for (int x = 1; x <= radius; x++) {
+        uint32_t pixel = line[(std::min)(x, width - 1)];
+        for (int channel = 0; channel < 4; channel++)
+            sums[channel] += static_cast<int32_t>((pixel >> (8 * channel)) & 0xFF);
+    }
+}
+
+#ifdef PRIVACY_SSE2
+// The four channels of a pixel as 32-bit lanes
+inline __m128i UnpackPixel(uint32_t pixel) {
+    __m128i zero = _mm_setzero_si128();
+    return _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(static_cast<int>(pixel)), zero), zero);
+}
+
+// The channel differences of one pixel, 16-bit lanes 0-3 (high = false) or 4-7, as 32-bit lanes
+inline __m128i WidenDifference(__m128i differences, bool high) {
+    __m128i doubled = high ? _mm_unpackhi_epi16(differences, differences) : _mm_unpacklo_epi16(differences, differences);
+    return _mm_srai_epi32(doubled, 16);
+}
+
+// Average of the running sums of a pixel's channels, rounded as BoxAverage() does
+inline __m128i BoxAverages(__m128i sums, __m128 scale) {
+    return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(sums), scale), _mm_set1_ps(0.5f)));
+}
+
+// Horizontal pass over one row of dst, in place ('line' holds a copy of the row); alpha comes
+// from src. The running sum is along the row, so the channels share one vector instead. Away
+// from the edges, four pixels enter and leave the box per step: their differences are taken in
+// 16 bits from whole-vector loads, which saves most of the per-pixel unpacking.
+void BlurRow(const uint32_t* src, uint32_t* dst, int width, int radius, uint32_t* line) {
+    memcpy(line, dst, width * sizeof(uint32_t));
+    int32_t first[4];
+    FirstRowSums(line, width, radius, first);
+    __m128i sums = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first));
+    __m128 scale = _mm_set1_ps(1.0f / static_cast<float>(2 * radius + 1));
+    __m128i zero = _mm_setzero_si128();
+    __m128i alphaMask = _mm_set1_epi32(static_cast<int>(0xFF000000u));
+
+    auto step = [&](int x) {
+        __m128i average = BoxAverages(sums, scale);
+        average = _mm_packus_epi16(_mm_packs_epi32(average, average), average);
+        dst[x] = (src[x] & 0xFF000000u) | (static_cast<uint32_t>(_mm_cvtsi128_si32(average)) & 0x00FFFFFFu);
+
+        __m128i entering = UnpackPixel(line[(std::min)(x + radius + 1, width - 1)]);
+        __m128i leaving = UnpackPixel(line[(std::max)(x - radius, 0)]);
+        sums = _mm_add_epi32(sums, _mm_sub_epi32(entering, leaving));
+    };
+
+    int x = 0;
+    for (; x < width && x < radius; x++)
+        step(x);
+    for (; x + radius + 5 <= width; x += 4) {
+        __m128i entering = _mm_loadu_si128(reinterpret_cast<const __m128i*>(line + x + radius + 1));
+        __m128i leaving = _mm_loadu_si128(reinterpret_cast<const __m128i*>(line + x - radius));
+        __m128i low = _mm_sub_epi16(_mm_unpacklo_epi8(entering, zero), _mm_unpacklo_epi8(leaving, zero));
+        __m128i high = _mm_sub_epi16(_mm_unpackhi_epi8(entering, zero), _mm_unpackhi_epi8(leaving, zero));
+
+        __m128i sums1 = _mm_add_epi32(sums, WidenDifference(low, false));
+        __m128i sums2 = _mm_add_epi32(sums1, WidenDifference(low, true));
+        __m128i sums3 = _mm_add_epi32(sums2, WidenDifference(high, false));
+        __m128i averages = _mm_packus_epi16(_mm_packs_epi32(BoxAverages(sums, scale), BoxAverages(sums1, scale)),
+            _mm_packs_epi32(BoxAverages(sums2, scale), BoxAverages(sums3, scale)));
+        sums = _mm_add_epi32(sums3, WidenDifference(high, true));
+
+        __m128i alpha = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x)), alphaMask);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), _mm_or_si128(_mm_andnot_si128(alphaMask, averages), alpha));
+    }
+    for (; x < width; x++)
+        step(x);
+}
+#else
+// Horizontal pass over one row of dst, in place ('line' holds a copy of the row); alpha comes
+// from src
+void BlurRow(const uint32_t* src, uint32_t* dst, int width, int radius, uint32_t* line) {
+    memcpy(line, dst, width * sizeof(uint32_t));
+    float scale = 1.0f / static_cast<float>(2 * radius + 1);
+    int32_t sums[4];
+    FirstRowSums(line, width, radius, sums);
+
+    for (int x = 0; x < width; x++) {
+        dst[x] = (src[x] & 0xFF000000u) | BoxAverage(sums[0], scale) | (BoxAverage(sums[1], scale) << 8) |
+            (BoxAverage(sums[2], scale) << 16);
+
+        uint32_t entering = line[(std::min)(x + radius + 1, width - 1)];
+        uint32_t leaving = line[(std::max)(x - radius, 0)];
+        for (int channel = 0; channel < 4; channel++) {
+            int shift = 8 * channel;
+            sums[channel] += static_cast<int32_t>((entering >> shift) & 0xFF) - static_cast<int32_t>((leaving >> shift) & 0xFF);
+        }
+    }
+}
+#endif
+
+// One row of blocks: sum each block's pixels, then fill it with their average
+void PixelateBlockRow(const uint32_t* src, uint32_t* dst, int width, int height, int block, int y0, std::vector<uint32_t>& sums) {
+    int rows = (std::min)(block, height - y0);
+    int blocks = (width + block - 1) / block;
+    sums.assign(static_cast<size_t>(blocks) * 3, 0);
+
+    for (int y = y0; y < y0 + rows; y++) {
+        const uint32_t* row = src + static_cast<size_t>(y) * width;
+        for (int b = 0; b < blocks; b++) {
+            uint32_t blue = 0, green = 0, red = 0;
+            for (int x = b * block; x < (std::min)((b + 1) * block, width); x++) {
+                blue += row[x] & 0xFF;
+                green += (row[x] >> 8) & 0xFF;
+                red += (row[x] >> 16) & 0xFF;
+            }
+            sums[b * 3] += blue;
+            sums[b * 3 + 1] += green;
+            sums[b * 3 + 2] += red;
+        }
+    }
+
+    // Reuse the sums for the block colors
+    for (int b = 0; b < blocks; b++) {
+        uint32_t pixels = static_cast<uint32_t>((std::min)(block, width - b * block) * rows);
+        uint32_t color = 0;
+        for (int channel = 0; channel < 3; channel++)
+            color |= ((sums[b * 3 + channel] + pixels / 2) / pixels) << (8 * channel);
+        sums[b * 3] = color;
+    }
+
+    for (int y = y0; y < y0 + rows; y++) {
+        const uint32_t* in = src + static_cast<size_t>(y) * width;
+        uint32_t* out = dst + static_cast<size_t>(y) * width;
+        for (int b = 0; b < blocks; b++) {
+            uint32_t color = sums[b * 3];
+            for (int x = b * block; x < (std::min)((b + 1) * block, width); x++)
+                out[x] = (in[x] & 0xFF000000u) | color;
+        }
+    }
+}
+
+// work(0) .. work(tasks - 1) on the pool, or here without one
+void RunTasks(WorkerPool* pool, int tasks, const std::function<void(int)>& work) {
+    if (pool != NULL) {
+        pool->Run(tasks, work);
+    } else {
+        for (int task = 0; task < tasks; task++)
+            work(task);
+    }
+}
+
+}
+
+// Box blur as a vertical and a horizontal pass of running sums
+void BoxBlurImage(const uint32_t* src, uint32_t* dst, int width, int height, int radius, WorkerPool* pool) {
+    if (width <= 0 || height <= 0)
+        return;
+
+    radius = (std::min)((std::max)(radius, 0), PRIVACY_BLUR_RADIUS_MAX);
+    int rowTasks = (height + rowsPerTask - 1) / rowsPerTask;
+    if (radius == 0) {
+        RunTasks(pool, rowTasks, [=](int task) {
+            int y0 = task * rowsPerTask;
+            int rows = (std::min)(rowsPerTask, height - y0);
+            memcpy(dst + static_cast<size_t>(y0) * width, src + static_cast<size_t>(y0) * width, static_cast<size_t>(rows) * width * sizeof(uint32_t));
+        });
+        return;
+    }
+
+    int strips = (width + stripWidth - 1) / stripWidth;
+    RunTasks(pool, strips, [=](int strip) {
+        int x0 = strip * stripWidth;
+        BlurColumns(src, dst, width, height, radius, x0, (std::min)(stripWidth, width - x0));
+    });
+    RunTasks(pool, rowTasks, [=](int task) {
+        std::vector<uint32_t> line(width);
+        for (int y = task * rowsPerTask; y < (std::min)((task + 1) * rowsPerTask, height); y++) {
+            size_t offset = static_cast<size_t>(y) * width;
+            BlurRow(src + offset, dst + offset, width, radius, line.data());
+        }
+    });
+}
+
+// Pixelation, one row of blocks per task
+void PixelateImage(const uint32_t* src, uint32_t* dst, int width, int height, int block, WorkerPool* pool) {
+    if (width <= 0 || height <= 0)
+        return;
+
+    block = (std::min)((std::max)(block, PRIVACY_PIXELATE_BLOCK_MIN), PRIVACY_PIXELATE_BLOCK_MAX);
+    RunTasks(pool, (height + block - 1) / block, [=](int task) {
+        std::vector<uint32_t> sums;
+        PixelateBlockRow(src, dst, width, height, block, task * block, sums);
+    });
+}
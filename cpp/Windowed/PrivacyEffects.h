@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstdint>
+#include "ColorEffects.h"
+#include "WorkerPool.h"
+
+// Box blur of 32-bit BGRA pixels: each channel becomes the average of the (2 * radius + 1)^2
+// pixels around it, with pixels past the image edges repeating the edge. Done as a vertical
+// then a horizontal pass of running sums, each rounded to 8 bits, so a pixel costs the same at
+// any radius. The vertical pass runs in column strips, the horizontal one in groups of rows;
+// with a 'pool' they run on its threads, with NULL on the calling one, and give the same result
+// either way. Radius 0 copies; radii above PRIVACY_BLUR_RADIUS_MAX are clamped. Alpha is passed
+// through. src and dst must not overlap.
+void BoxBlurImage(const uint32_t* src, uint32_t* dst, int width, int height, int radius, WorkerPool* pool);
+
+// Pixelation of 32-bit BGRA pixels: the image is cut into 'block' x 'block' squares from the top
+// left, and each takes the rounded average of its pixels (partial squares at the right and
+// bottom edges of the pixels they have). Each row of blocks is one task for the 'pool', as in
+// BoxBlurImage(). 'block' is clamped to PRIVACY_PIXELATE_BLOCK_MIN..MAX. Alpha is passed through.
+// src and dst must not overlap.
+void PixelateImage(const uint32_t* src, uint32_t* dst, int width, int height, int block, WorkerPool* pool);
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+
+// Lets an update run at most once per interval. A request inside the interval is remembered,
+// and TakeDue() reports it once the interval is over, so the last request is never lost.
+class RateLimiter {
+private:
+    int64_t interval;
+    int64_t lastRun;
+    bool hasRun;
+    bool pending;
+
+public:
+    explicit RateLimiter(int64_t minInterval) : interval(minInterval), lastRun(0), hasRun(false), pending(false) {}
+
+    // An update is wanted at time 'now': true if it may run now, false if it is deferred
+    bool Request(int64_t now) {
+        if (hasRun && now - lastRun < interval) {
+            pending = true;
+            return false;
+        }
+        lastRun = now;
+        hasRun = true;
+        pending = false;
+        return true;
+    }
+
+    // True once for a deferred update whose interval has passed; the caller then runs it
+    bool TakeDue(int64_t now) {
+        if (!pending || now - lastRun < interval)
+            return false;
+        lastRun = now;
+        pending = false;
+        return true;
+    }
+
+    bool IsPending() const { return pending; }
+
+    // Drop a deferred update, e.g. because something else replaced what it would have shown
+    void Cancel() { pending = false; }
+};
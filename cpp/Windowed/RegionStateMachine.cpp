@@ -0,0 +1,229 @@
+#include "RegionStateMachine.h"
+#include <algorithm>
+
+namespace {
+
+struct RegionTransition {
+    RegionAction action;
+    SelectionState next;
+};
+
+const RegionTransition ignored = { REGION_ACTION_NONE, SELECTION_NONE };
+
+// [selection][event]; an ignored event leaves the state as it is
+const RegionTransition transitions[3][REGION_EVENT_COUNT] = {
+    // SELECTION_NONE
+    {
+        { REGION_ACTION_SHOW, SELECTION_NONE },
+        { REGION_ACTION_FIRST_POINT, SELECTION_FIRST_POINT },
+        { REGION_ACTION_LOAD, SELECTION_COMPLETE },
+        ignored,
+        ignored,
+        ignored,
+        { REGION_ACTION_ENABLE_THEME, SELECTION_NONE },
+    },
+    // SELECTION_FIRST_POINT
+    {
+        ignored,
+        { REGION_ACTION_SELECT, SELECTION_COMPLETE },
+        { REGION_ACTION_LOAD, SELECTION_COMPLETE },
+        ignored,
+        ignored,
+        ignored,
+        { REGION_ACTION_ENABLE_THEME, SELECTION_FIRST_POINT },
+    },
+    // SELECTION_COMPLETE
+    {
+        ignored,
+        ignored,
+        { REGION_ACTION_LOAD, SELECTION_COMPLETE },
+        { REGION_ACTION_FULL_SCREEN, SELECTION_COMPLETE },
+        { REGION_ACTION_PARTIAL_SCREEN, SELECTION_COMPLETE },
+        { REGION_ACTION_TOGGLE_PIN, SELECTION_COMPLETE },
+        { REGION_ACTION_ENABLE_THEME, SELECTION_COMPLETE },
+    },
+};
+
+// The smallest area a two-click selection produces, in pixels
+const LONG minimumSelectionSize = 100;
+
+bool SameRect(const RECT& a, const RECT& b) {
+    return a.left == b.left && a.top == b.top && a.right == b.right && a.bottom == b.bottom;
+}
+
+}
+
+RegionStateMachine::RegionStateMachine(RegionPlatform& regionPlatform)
+    : platform(regionPlatform), state(), sideEffects() {
+    // As SetupScreenFilter() creates the window: hidden, sizable, topmost and almost transparent
+    state.selection = SELECTION_NONE;
+    state.applied.style = REGION_STYLE_RESTORED;
+    state.applied.exStyle = REGION_EX_TOPMOST | REGION_EX_LAYERED;
+}
+
+RegionAction RegionStateMachine::Dispatch(const RegionEvent& event) {
+    const RegionTransition& transition = transitions[state.selection][event.type];
+    if (transition.action == REGION_ACTION_NONE)
+        return REGION_ACTION_NONE;
+
+    WindowFrameMetrics frame;
+    switch (transition.action) {
+    case REGION_ACTION_FIRST_POINT:
+        state.firstPoint = event.point;
+        break;
+    case REGION_ACTION_SELECT: {
+        RECT& selected = state.selectedRect;
+        selected.left = (std::min)(state.firstPoint.x, event.point.x);
+        selected.top = (std::min)(state.firstPoint.y, event.point.y);
+        selected.right = (std::max)(state.firstPoint.x, event.point.x);
+        selected.bottom = (std::max)(state.firstPoint.y, event.point.y);
+        if (selected.right - selected.left < minimumSelectionSize)
+            selected.right = selected.left + minimumSelectionSize;
+        if (selected.bottom - selected.top < minimumSelectionSize)
+            selected.bottom = selected.top + minimumSelectionSize;
+
+        // The window goes around the selected client area
+        frame = platform.GetFrameMetrics();
+        state.hostWindowRect.left = selected.left - frame.borderWidth;
+        state.hostWindowRect.top = selected.top - frame.titleBarHeight - frame.borderHeight;
+        state.hostWindowRect.right = selected.right + frame.borderWidth;
+        state.hostWindowRect.bottom = selected.bottom + frame.borderHeight;
+        break;
+    }
+    case REGION_ACTION_LOAD:
+        frame = platform.GetFrameMetrics();
+        state.hostWindowRect = event.windowRect;
+        state.selectedRect.left = event.windowRect.left + frame.borderWidth;
+        state.selectedRect.top = event.windowRect.top + frame.titleBarHeight + frame.borderHeight;
+        state.selectedRect.right = event.windowRect.right - frame.borderWidth;
+        state.selectedRect.bottom = event.windowRect.bottom - frame.borderHeight;
+        state.fullScreen = false;
+        break;
+    case REGION_ACTION_FULL_SCREEN:
+        if (state.fullScreen)
+            return REGION_ACTION_NONE;
+        // Leaving full screen returns to where the window is now, wherever the user dragged it
+        platform.GetWindowRect(state.hostWindowRect);
+        state.fullScreen = true;
+        break;
+    case REGION_ACTION_PARTIAL_SCREEN:
+        if (!state.fullScreen)
+            return REGION_ACTION_NONE;
+        state.fullScreen = false;
+        break;
+    case REGION_ACTION_TOGGLE_PIN:
+        state.pinned = !state.pinned;
+        break;
+    case REGION_ACTION_ENABLE_THEME:
+        state.themeEnabled = true;
+        break;
+    default:
+        break;
+    }
+    state.selection = static_cast<uint8_t>(transition.next);
+
+    Present(transition.action == REGION_ACTION_SELECT || transition.action == REGION_ACTION_LOAD);
+    return transition.action;
+}
+
+// Presentation the current state calls for
+RegionPresentation RegionStateMachine::Desired() {
+    RegionPresentation desired = state.applied;
+    desired.visible = true;
+
+    if (state.selection != SELECTION_COMPLETE) {
+        // Maximized and almost transparent, so the user sees what to select
+        desired.maximized = true;
+        desired.style = REGION_STYLE_RESTORED;
+        desired.exStyle = REGION_EX_TOPMOST | REGION_EX_LAYERED;
+        desired.opaque = false;
+    } else if (state.fullScreen) {
+        // Transparent to the mouse whether pinned or not
+        desired.maximized = false;
+        desired.style = REGION_STYLE_FULL_SCREEN;
+        desired.exStyle = REGION_EX_TOPMOST | REGION_EX_LAYERED | REGION_EX_TRANSPARENT;
+        desired.opaque = true;
+        platform.GetFullScreenRect(desired.windowRect);
+    } else {
+        desired.maximized = false;
+        desired.style = REGION_STYLE_RESTORED;
+        desired.exStyle = static_cast<uint8_t>(REGION_EX_TOPMOST | REGION_EX_LAYERED | (state.pinned ? REGION_EX_TRANSPARENT : 0));
+        desired.opaque = true;
+        desired.windowRect = state.hostWindowRect;
+    }
+
+    desired.themed = state.themeEnabled && desired.style == REGION_STYLE_RESTORED;
+    return desired;
+}
+
+// Make the platform calls that bring the window from the applied presentation to the desired one.
+// The window is only moved back to the region's rectangle if the event placed it there; other
+// events leave a window the user dragged where it is.
+void RegionStateMachine::Present(bool placeWindow) {
+    RegionPresentation desired = Desired();
+    RegionPresentation& applied = state.applied;
+
+    bool showChanged = false;
+    if (desired.maximized ? !applied.visible || !applied.maximized : applied.maximized) {
+        platform.SetShowState(desired.maximized);
+        sideEffects[REGION_EFFECT_SHOW_STATE]++;
+        applied.maximized = desired.maximized;
+        applied.visible = true;
+        showChanged = true;
+    }
+
+    bool styleChanged = false;
+    if (desired.style != applied.style) {
+        platform.SetStyle(static_cast<RegionStyle>(desired.style));
+        sideEffects[REGION_EFFECT_STYLE]++;
+        applied.style = desired.style;
+        applied.themed = false; // Dark mode has to be reapplied after a style change
+        styleChanged = true;
+    }
+
+    if (desired.exStyle != applied.exStyle) {
+        platform.SetExStyle(desired.exStyle);
+        sideEffects[REGION_EFFECT_EX_STYLE]++;
+        applied.exStyle = desired.exStyle;
+    }
+
+    if (!desired.maximized) {
+        bool move = !applied.visible || showChanged || styleChanged;
+        if (!move && placeWindow) {
+            // Compared with where the window is, since the user may have moved it since
+            RECT current;
+            platform.GetWindowRect(current);
+            move = !SameRect(current, desired.windowRect);
+        }
+        if (move) {
+            platform.SetPosition(desired.windowRect, styleChanged);
+            sideEffects[REGION_EFFECT_POSITION]++;
+            applied.visible = true;
+        }
+        applied.windowRect = desired.windowRect;
+    }
+
+    if (desired.opaque != applied.opaque) {
+        platform.SetOpaque(desired.opaque);
+        sideEffects[REGION_EFFECT_OPACITY]++;
+        applied.opaque = desired.opaque;
+    }
+
+    if (desired.themed && !applied.themed) {
+        platform.ApplyTheme();
+        sideEffects[REGION_EFFECT_THEME]++;
+        applied.themed = true;
+    }
+}
+
+bool RegionStateMachine::SyncEffects(uint64_t generation) {
+    if (state.selection != SELECTION_COMPLETE || (state.effectsApplied && state.effectsGeneration == generation))
+        return false;
+
+    sideEffects[REGION_EFFECT_COLOR_EFFECT]++;
+    if (!platform.ApplyColorEffect())
+        return false;
+    state.effectsApplied = true;
+    state.effectsGeneration = generation;
+    return true;
+}
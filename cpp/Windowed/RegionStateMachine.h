@@ -0,0 +1,154 @@
+#pragma once
+
+#include <cstdint>
+#include "Platform.h"
+#include "FramePipeline.h"
+
+// Rectangle selection states
+enum SelectionState {
+    SELECTION_NONE,
+    SELECTION_FIRST_POINT,
+    SELECTION_COMPLETE
+};
+
+// What can happen to a filter window's region
+enum RegionEventType {
+    REGION_SHOW,          // Show the window for selection
+    REGION_CLICK,         // A point of the two-click selection
+    REGION_LOAD,          // Move to a window rectangle: saved slot, session region or control command
+    REGION_MAXIMIZE,      // Go full screen
+    REGION_RESTORE,       // Leave full screen
+    REGION_TOGGLE_PIN,    // Click-through on or off
+    REGION_ENABLE_THEME,  // Dark mode may be applied from now on
+    REGION_EVENT_COUNT
+};
+
+// What a transition did; REGION_ACTION_NONE if the current state ignores the event
+enum RegionAction {
+    REGION_ACTION_NONE,
+    REGION_ACTION_SHOW,
+    REGION_ACTION_FIRST_POINT,
+    REGION_ACTION_SELECT,
+    REGION_ACTION_LOAD,
+    REGION_ACTION_FULL_SCREEN,
+    REGION_ACTION_PARTIAL_SCREEN,
+    REGION_ACTION_TOGGLE_PIN,
+    REGION_ACTION_ENABLE_THEME
+};
+
+struct RegionEvent {
+    RegionEventType type;
+    POINT point;     // REGION_CLICK, screen pixels
+    RECT windowRect; // REGION_LOAD
+
+    explicit RegionEvent(RegionEventType eventType) : type(eventType), point(), windowRect() {}
+    static RegionEvent Click(POINT clickPoint) {
+        RegionEvent event(REGION_CLICK);
+        event.point = clickPoint;
+        return event;
+    }
+    static RegionEvent Load(const RECT& rect) {
+        RegionEvent event(REGION_LOAD);
+        event.windowRect = rect;
+        return event;
+    }
+};
+
+// Window styles the filter switches between
+enum RegionStyle {
+    REGION_STYLE_RESTORED,   // Sizable frame, as created
+    REGION_STYLE_FULL_SCREEN // Caption and system menu only, placed outside the display
+};
+
+// Extended window styles (WS_EX_*)
+#define REGION_EX_TOPMOST 0x01
+#define REGION_EX_LAYERED 0x02
+#define REGION_EX_TRANSPARENT 0x04
+
+// The platform state of the window, as far as the region decides it
+struct RegionPresentation {
+    bool visible;
+    bool maximized;    // Shown maximized for selection; the window rectangle is then not managed
+    uint8_t style;     // RegionStyle
+    uint8_t exStyle;   // REGION_EX_*
+    bool opaque;       // Layered alpha 255, rather than almost transparent for selection
+    bool themed;       // Dark mode applied since the last style change
+    RECT windowRect;   // Unless maximized
+};
+
+// Calls for every side effect
+enum RegionSideEffect {
+    REGION_EFFECT_SHOW_STATE,   // ShowWindow
+    REGION_EFFECT_STYLE,        // SetWindowLong(GWL_STYLE)
+    REGION_EFFECT_EX_STYLE,     // SetWindowLong(GWL_EXSTYLE)
+    REGION_EFFECT_POSITION,     // SetWindowPos
+    REGION_EFFECT_THEME,        // Dark mode DWM attributes
+    REGION_EFFECT_OPACITY,      // SetLayeredWindowAttributes
+    REGION_EFFECT_COLOR_EFFECT, // MagSetColorEffect
+    REGION_SIDE_EFFECT_COUNT
+};
+
+// Carries out side effects: the window in the application, counters in the replay
+class RegionPlatform {
+public:
+    virtual ~RegionPlatform() {}
+
+    virtual WindowFrameMetrics GetFrameMetrics() = 0;
+    virtual void GetFullScreenRect(RECT& windowRect) = 0;
+    virtual void GetWindowRect(RECT& windowRect) = 0; // Where the window is now; the user may have moved it
+
+    virtual void SetShowState(bool maximized) = 0;
+    virtual void SetStyle(RegionStyle style) = 0;
+    virtual void SetExStyle(uint8_t exStyle) = 0;
+    virtual void SetPosition(const RECT& windowRect, bool frameChanged) = 0; // Also shows the window
+    virtual void ApplyTheme() = 0;
+    virtual void SetOpaque(bool opaque) = 0;
+    virtual bool ApplyColorEffect() = 0; // The current effect matrix; false if the magnifier refused it
+};
+
+// Selection, full screen, pin and effect state of a filter window
+struct RegionState {
+    uint8_t selection;           // SelectionState
+    bool fullScreen;
+    bool pinned;                 // Click-through
+    bool themeEnabled;
+    bool effectsApplied;         // The magnifier has accepted a color effect
+    uint64_t effectsGeneration;  // EffectController generation the magnifier shows
+    POINT firstPoint;
+    RECT selectedRect;           // Client area chosen by selection
+    RECT hostWindowRect;         // Window rectangle when not full screen
+    RegionPresentation applied;  // What the platform has been told
+};
+
+// Table-driven state machine for a filter window's region. Each event looks up an action and
+// the next selection state; the machine then derives the presentation the new state needs and
+// makes only the platform calls whose result differs from what was applied before, so loading
+// the slot the window is already at, or leaving full screen when not in it, costs nothing.
+// Nothing is allocated.
+class RegionStateMachine {
+private:
+    RegionPlatform& platform;
+    RegionState state;
+    uint64_t sideEffects[REGION_SIDE_EFFECT_COUNT];
+
+    RegionPresentation Desired();
+    void Present(bool placeWindow);
+
+public:
+    explicit RegionStateMachine(RegionPlatform& regionPlatform);
+
+    const RegionState& GetState() const { return state; }
+    bool IsSelectionComplete() const { return state.selection == SELECTION_COMPLETE; }
+
+    // Run an event and bring the window in line with the resulting state
+    RegionAction Dispatch(const RegionEvent& event);
+
+    // Hand the effect matrix to the magnifier if it shows an older generation. Effects wait
+    // for the selection to complete. Returns true if the matrix was applied.
+    bool SyncEffects(uint64_t generation);
+
+    // Take over a state recorded elsewhere (e.g. by the replay) as what is applied
+    void SetState(const RegionState& recorded) { state = recorded; }
+
+    uint64_t GetSideEffectCount(RegionSideEffect effect) const { return sideEffects[effect]; }
+};
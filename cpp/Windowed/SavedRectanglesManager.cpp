@@ -1,159 +1,287 @@
-#include "SavedRectanglesManager.h"
-
-const char* SavedRectanglesManager::RECTS_FILE = "saved_rects.txt";
-
-SavedRectanglesManager::SavedRectanglesManager() {
-    // Initialize all entries as invalid
-}
-
-// Parse a single line from the file
-bool SavedRectanglesManager::ParseLine(const std::string& line, int& slot, SavedRectEntry& entry) {
-    if (line.empty() || line[0] == '#' || line[0] == ';')
-        return false;
-
-    size_t equalPos = line.find('=');
-    if (equalPos == std::string::npos)
-        return false;
-
-    std::string slotStr = line.substr(0, equalPos);
-    std::string dataStr = line.substr(equalPos + 1);
-
-    // Trim whitespace
-    slotStr.erase(0, slotStr.find_first_not_of(" \t"));
-    slotStr.erase(slotStr.find_last_not_of(" \t") + 1);
-    dataStr.erase(0, dataStr.find_first_not_of(" \t"));
-    dataStr.erase(dataStr.find_last_not_of(" \t") + 1);
-
-    // Parse slot number
-    char* endPtr;
-    slot = static_cast<int>(strtol(slotStr.c_str(), &endPtr, 10));
-    if (*endPtr != '\0' || slot < 0 || slot >= NUM_SAVED_RECTS)
-        return false;
-
-    // Parse comma-separated values
-    std::vector<std::string> items;
-    std::stringstream ss(dataStr);
-    std::string item;
-    while (std::getline(ss, item, ',')) {
-        items.push_back(item);
-    }
-
-    if (items.size() < 4)
-        return false;
-
-    // Parse rectangle coordinates
-    entry.rect.left = static_cast<LONG>(strtol(items[0].c_str(), &endPtr, 10));
-    if (*endPtr != '\0') return false;
-    entry.rect.top = static_cast<LONG>(strtol(items[1].c_str(), &endPtr, 10));
-    if (*endPtr != '\0') return false;
-    entry.rect.right = static_cast<LONG>(strtol(items[2].c_str(), &endPtr, 10));
-    if (*endPtr != '\0') return false;
-    entry.rect.bottom = static_cast<LONG>(strtol(items[3].c_str(), &endPtr, 10));
-    if (*endPtr != '\0') return false;
-
-    // Parse color settings (with backward compatibility)
-    if (items.size() >= 7) {
-        entry.inversionEnabled = (strtol(items[4].c_str(), &endPtr, 10) != 0);
-        if (*endPtr != '\0') return false;
-        entry.grayscaleEnabled = (strtol(items[5].c_str(), &endPtr, 10) != 0);
-        if (*endPtr != '\0') return false;
-        entry.grayLevel = static_cast<int>(strtol(items[6].c_str(), &endPtr, 10));
-        if (*endPtr != '\0' || entry.grayLevel < 0 || entry.grayLevel > 3) return false;
-    } else {
-        // Default values for old format
-        entry.inversionEnabled = true;
-        entry.grayscaleEnabled = false;
-        entry.grayLevel = 0;
-    }
-
-    entry.isValid = true;
-    return true;
-}
-
-// Load all rectangles from file
-bool SavedRectanglesManager::Load() {
-    std::ifstream file(RECTS_FILE);
-    if (!file.is_open())
-        return false;
-
-    std::string line;
-    while (std::getline(file, line)) {
-        int slot;
-        SavedRectEntry entry;
-        if (ParseLine(line, slot, entry)) {
-            entries[slot] = entry;
-        }
-    }
-
-    file.close();
-    return true;
-}
-
-// Save all rectangles to file
-bool SavedRectanglesManager::Save() {
-    std::ofstream file(RECTS_FILE);
-    if (!file.is_open())
-        return false;
-
-    file << "# Saved Rectangle Configurations with Color Settings\n";
-    file << "# Format: SlotNumber=Left,Top,Right,Bottom,Invert,Grayscale,GrayLevel\n";
-    file << "# Slots 1-9 available. Use 0 to cycle, 1-9 to load, Ctrl+1-9 to save.\n";
-    file << "# Invert: 1=enabled, 0=disabled\n";
-    file << "# Grayscale: 1=enabled, 0=disabled\n";
-    file << "# GrayLevel: 0=100%, 1=80%, 2=60%, 3=40%\n\n";
-
-    for (int i = 0; i < NUM_SAVED_RECTS; i++) {
-        if (entries[i].isValid) {
-            file << i << "="
-                 << entries[i].rect.left << ","
-                 << entries[i].rect.top << ","
-                 << entries[i].rect.right << ","
-                 << entries[i].rect.bottom << ","
-                 << (entries[i].inversionEnabled ? 1 : 0) << ","
-                 << (entries[i].grayscaleEnabled ? 1 : 0) << ","
-                 << entries[i].grayLevel << "\n";
-        }
-    }
-
-    file.close();
-    return true;
-}
-
-// Get a specific entry
-const SavedRectEntry& SavedRectanglesManager::GetEntry(int slot) const {
-    static SavedRectEntry invalid;
-    if (slot < 0 || slot >= NUM_SAVED_RECTS)
-        return invalid;
-    return entries[slot];
-}
-
-// Set a specific entry
-void SavedRectanglesManager::SetEntry(int slot, const SavedRectEntry& entry) {
-    if (slot >= 0 && slot < NUM_SAVED_RECTS) {
-        entries[slot] = entry;
-    }
-}
-
-// Check if a slot is valid
-bool SavedRectanglesManager::IsValid(int slot) const {
-    if (slot < 0 || slot >= NUM_SAVED_RECTS)
-        return false;
-    return entries[slot].isValid;
-}
-
-// Save current state to file, preserving entries from other instances
-bool SavedRectanglesManager::SavePreservingExisting() {
-    // Load current file state
-    SavedRectanglesManager fileState;
-    fileState.Load();
-
-    // Merge our valid entries into the file state
-    for (int i = 0; i < NUM_SAVED_RECTS; i++) {
-        if (entries[i].isValid) {
-            fileState.SetEntry(i, entries[i]);
-        }
-    }
-
-    // Save the merged state
-    return fileState.Save();
+#include "SavedRectanglesManager.h"
+
+const char* SavedRectanglesManager::RECTS_FILE = "saved_rects.txt";
+
+SavedRectanglesManager::SavedRectanglesManager() {
+    // Initialize all entries as invalid
+}
+
+// Parse a single line from the file
+bool SavedRectanglesManager::ParseLine(const std::string& line, int& slot, SavedRectEntry& entry) {
+    if (line.empty() || line[0] == '#' || line[0] == ';')
+        return false;
+
+    size_t equalPos = line.find('=');
+    if (equalPos == std::string::npos)
+        return false;
+
+    std::string slotStr = line.substr(0, equalPos);
+    std::string dataStr = line.substr(equalPos + 1);
+
+    // Trim whitespace
+    slotStr.erase(0, slotStr.find_first_not_of(" \t"));
+    slotStr.erase(slotStr.find_last_not_of(" \t") + 1);
+    dataStr.erase(0, dataStr.find_first_not_of(" \t"));
+    dataStr.erase(dataStr.find_last_not_of(" \t") + 1);
+
+    // Parse slot number
+    char* endPtr;
+    slot = static_cast<int>(strtol(slotStr.c_str(), &endPtr, 10));
+    if (*endPtr != '\0' || slot < 0 || slot >= NUM_SAVED_RECTS)
+        return false;
+
+    return ParseEntry(dataStr, entry);
+}
+
+// Parse the comma-separated data of an entry
+bool SavedRectanglesManager::ParseEntry(const std::string& dataStr, SavedRectEntry& entry) {
+    char* endPtr;
+
+    // Parse comma-separated values
+    std::vector<std::string> items;
+    std::stringstream ss(dataStr);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        items.push_back(item);
+    }
+
+    if (items.size() < 4)
+        return false;
+
+    // Parse rectangle coordinates
+    entry.rect.left = static_cast<LONG>(strtol(items[0].c_str(), &endPtr, 10));
+    if (*endPtr != '\0') return false;
+    entry.rect.top = static_cast<LONG>(strtol(items[1].c_str(), &endPtr, 10));
+    if (*endPtr != '\0') return false;
+    entry.rect.right = static_cast<LONG>(strtol(items[2].c_str(), &endPtr, 10));
+    if (*endPtr != '\0') return false;
+    entry.rect.bottom = static_cast<LONG>(strtol(items[3].c_str(), &endPtr, 10));
+    if (*endPtr != '\0') return false;
+
+    // Parse color settings (with backward compatibility)
+    if (items.size() >= 7) {
+        entry.inversionEnabled = (strtol(items[4].c_str(), &endPtr, 10) != 0);
+        if (*endPtr != '\0') return false;
+        entry.grayscaleEnabled = (strtol(items[5].c_str(), &endPtr, 10) != 0);
+        if (*endPtr != '\0') return false;
+        entry.grayLevel = static_cast<int>(strtol(items[6].c_str(), &endPtr, 10));
+        if (*endPtr != '\0' || entry.grayLevel < 0 || entry.grayLevel > 3) return false;
+    } else {
+        // Default values for old format
+        entry.inversionEnabled = true;
+        entry.grayscaleEnabled = false;
+        entry.grayLevel = 0;
+    }
+
+    // Parse monitor-relative placement (absent in files from older versions)
+    if (items.size() >= 12) {
+        entry.placement.monitor = items[7];
+        entry.placement.left = strtod(items[8].c_str(), &endPtr);
+        if (*endPtr != '\0') return false;
+        entry.placement.top = strtod(items[9].c_str(), &endPtr);
+        if (*endPtr != '\0') return false;
+        entry.placement.right = strtod(items[10].c_str(), &endPtr);
+        if (*endPtr != '\0') return false;
+        entry.placement.bottom = strtod(items[11].c_str(), &endPtr);
+        if (*endPtr != '\0') return false;
+        entry.hasPlacement = !entry.placement.monitor.empty();
+    }
+
+    // Parse the vision effect (absent in files from older versions)
+    if (items.size() >= 14) {
+        entry.visionMode = static_cast<int>(strtol(items[12].c_str(), &endPtr, 10));
+        if (*endPtr != '\0' || entry.visionMode < 0 || entry.visionMode >= VISION_MODE_COUNT) return false;
+        entry.visionSeverity = static_cast<int>(strtol(items[13].c_str(), &endPtr, 10));
+        if (*endPtr != '\0' || entry.visionSeverity < 0 || entry.visionSeverity >= NUM_VISION_SEVERITIES) return false;
+    }
+
+    // Parse the color temperature (absent in files from older versions)
+    if (items.size() >= 15) {
+        entry.colorTemperature = static_cast<int>(strtol(items[14].c_str(), &endPtr, 10));
+        if (*endPtr != '\0' || entry.colorTemperature < COLOR_TEMPERATURE_MIN || entry.colorTemperature > COLOR_TEMPERATURE_MAX) return false;
+    }
+
+    // Parse the sharpening level (absent in files from older versions)
+    if (items.size() >= 16) {
+        entry.sharpenLevel = static_cast<int>(strtol(items[15].c_str(), &endPtr, 10));
+        if (*endPtr != '\0' || entry.sharpenLevel < 0 || entry.sharpenLevel >= NUM_SHARPEN_LEVELS) return false;
+    }
+
+    // Parse the privacy effect and its sizes (absent in files from older versions)
+    if (items.size() >= 19) {
+        entry.privacyEffect = static_cast<int>(strtol(items[16].c_str(), &endPtr, 10));
+        if (*endPtr != '\0' || entry.privacyEffect < 0 || entry.privacyEffect >= PRIVACY_EFFECT_COUNT) return false;
+        entry.blurRadius = static_cast<int>(strtol(items[17].c_str(), &endPtr, 10));
+        if (*endPtr != '\0' || entry.blurRadius < 0 || entry.blurRadius > PRIVACY_BLUR_RADIUS_MAX) return false;
+        entry.pixelateBlock = static_cast<int>(strtol(items[18].c_str(), &endPtr, 10));
+        if (*endPtr != '\0' || entry.pixelateBlock < PRIVACY_PIXELATE_BLOCK_MIN || entry.pixelateBlock > PRIVACY_PIXELATE_BLOCK_MAX) return false;
+    }
+
+    // Parse the binarization and its window (absent in files from older versions)
+    if (items.size() >= 21) {
+        entry.binarizeEnabled = (strtol(items[19].c_str(), &endPtr, 10) != 0);
+        if (*endPtr != '\0') return false;
+        entry.binarizeWindow = static_cast<int>(strtol(items[20].c_str(), &endPtr, 10));
+        if (*endPtr != '\0' || entry.binarizeWindow < BINARIZE_WINDOW_MIN || entry.binarizeWindow > BINARIZE_WINDOW_MAX ||
+            entry.binarizeWindow % 2 == 0) return false;
+    }
+
+    // Parse the auto-invert mode (absent in files from older versions)
+    if (items.size() >= 22) {
+        entry.autoInvert = (strtol(items[21].c_str(), &endPtr, 10) != 0);
+        if (*endPtr != '\0') return false;
+    }
+
+    // Parse the smart inversion (absent in files from older versions)
+    if (items.size() >= 23) {
+        entry.smartInvert = (strtol(items[22].c_str(), &endPtr, 10) != 0);
+        if (*endPtr != '\0') return false;
+    }
+
+    entry.isValid = true;
+    return true;
+}
+
+// Load all rectangles from file
+bool SavedRectanglesManager::Load() {
+    std::ifstream file(RECTS_FILE);
+    if (!file.is_open())
+        return false;
+
+    std::string line;
+    while (std::getline(file, line)) {
+        int slot;
+        SavedRectEntry entry;
+        if (ParseLine(line, slot, entry)) {
+            entries[slot] = entry;
+        }
+    }
+
+    file.close();
+    return true;
+}
+
+// Save all rectangles to file
+bool SavedRectanglesManager::Save() {
+    std::ofstream file(RECTS_FILE);
+    if (!file.is_open())
+        return false;
+
+    file << "# Saved Rectangle Configurations with Color Settings\n";
+    file << "# Format: SlotNumber=Left,Top,Right,Bottom,Invert,Grayscale,GrayLevel[,Monitor,NLeft,NTop,NRight,NBottom\n";
+    file << "#         [,VisionMode,VisionSeverity[,Temperature[,Sharpen[,Privacy,BlurRadius,PixelateBlock[,Binarize,BinarizeWindow[,AutoInvert[,SmartInvert]]]]]]]]\n";
+    file << "# Slots 1-9 available. Use 0 to cycle, 1-9 to load, Ctrl+1-9 to save.\n";
+    file << "# Invert: 1=enabled, 0=disabled\n";
+    file << "# Grayscale: 1=enabled, 0=disabled\n";
+    file << "# GrayLevel: 0=100%, 1=80%, 2=60%, 3=40%\n";
+    file << "# Monitor, NLeft..NBottom: client area as fractions of that monitor, used in preference\n";
+    file << "# to Left..Bottom so the rectangle follows docking and resolution changes; empty if unknown\n";
+    file << "# VisionMode: 0=normal, 1-3=simulate protan/deutan/tritan, 4-6=correct protan/deutan/tritan\n";
+    file << "# VisionSeverity: 0-10, in steps of 10%\n";
+    file << "# Temperature: white point in Kelvin, 1700-10000, 6500=neutral\n";
+    file << "# Sharpen: 0=off, 1-4=50%-200% (applied by the CPU path only)\n";
+    file << "# Privacy: 0=off, 1=blur, 2=pixelate (applied by the CPU path, flat gray until its first frame)\n";
+    file << "# BlurRadius: 0-256 pixels; PixelateBlock: 2-256 pixels\n";
+    file << "# Binarize: 1=enabled, 0=disabled (applied by the CPU path only)\n";
+    file << "# BinarizeWindow: 3-127 pixels, odd\n";
+    file << "# AutoInvert: 1=invert while the contents are bright, 0=disabled\n";
+    file << "# SmartInvert: 1=invert text on light backgrounds only, 0=disabled (the magnifier inverts everything)\n\n";
+
+    for (int i = 0; i < NUM_SAVED_RECTS; i++) {
+        if (entries[i].isValid) {
+            file << i << "=";
+            WriteEntry(file, entries[i]);
+            file << "\n";
+        }
+    }
+
+    file.close();
+    return true;
+}
+
+// Write the comma-separated data of an entry
+void SavedRectanglesManager::WriteEntry(std::ostream& out, const SavedRectEntry& entry) {
+    out << entry.rect.left << ","
+        << entry.rect.top << ","
+        << entry.rect.right << ","
+        << entry.rect.bottom << ","
+        << (entry.inversionEnabled ? 1 : 0) << ","
+        << (entry.grayscaleEnabled ? 1 : 0) << ","
+        << entry.grayLevel;
+
+    // Fields after the placement need its columns, even if empty, and each needs those before it
+    bool hasSmartInvert = entry.smartInvert;
+    bool hasAutoInvert = entry.autoInvert || hasSmartInvert;
+    bool hasBinarize = entry.binarizeEnabled || entry.binarizeWindow != BINARIZE_WINDOW_DEFAULT || hasAutoInvert;
+    bool hasPrivacy = entry.privacyEffect != PRIVACY_NONE || entry.blurRadius != PRIVACY_BLUR_RADIUS_DEFAULT ||
+        entry.pixelateBlock != PRIVACY_PIXELATE_BLOCK_DEFAULT || hasBinarize;
+    bool hasSharpen = entry.sharpenLevel != 0 || hasPrivacy;
+    bool hasTemperature = entry.colorTemperature != COLOR_TEMPERATURE_NEUTRAL || hasSharpen;
+    bool hasVision = entry.visionMode != VISION_NORMAL || entry.visionSeverity != NUM_VISION_SEVERITIES - 1 || hasTemperature;
+    if (!entry.hasPlacement && hasVision)
+        out << ",,,,,";
+    if (entry.hasPlacement) {
+        std::ios_base::fmtflags flags = out.flags();
+        std::streamsize precision = out.precision(6);
+        out << std::fixed << "," << entry.placement.monitor << ","
+            << entry.placement.left << ","
+            << entry.placement.top << ","
+            << entry.placement.right << ","
+            << entry.placement.bottom;
+        out.flags(flags);
+        out.precision(precision);
+    }
+    if (hasVision)
+        out << "," << entry.visionMode << "," << entry.visionSeverity;
+    if (hasTemperature)
+        out << "," << entry.colorTemperature;
+    if (hasSharpen)
+        out << "," << entry.sharpenLevel;
+    if (hasPrivacy)
+        out << "," << entry.privacyEffect << "," << entry.blurRadius << "," << entry.pixelateBlock;
+    if (hasBinarize)
+        out << "," << (entry.binarizeEnabled ? 1 : 0) << "," << entry.binarizeWindow;
+    if (hasAutoInvert)
+        out << "," << (entry.autoInvert ? 1 : 0);
+    if (hasSmartInvert)
+        out << "," << (entry.smartInvert ? 1 : 0);
+}
+
+// Get a specific entry
+const SavedRectEntry& SavedRectanglesManager::GetEntry(int slot) const {
+    static SavedRectEntry invalid;
+    if (slot < 0 || slot >= NUM_SAVED_RECTS)
+        return invalid;
+    return entries[slot];
+}
+
+// Set a specific entry
+void SavedRectanglesManager::SetEntry(int slot, const SavedRectEntry& entry) {
+    if (slot >= 0 && slot < NUM_SAVED_RECTS) {
+        entries[slot] = entry;
+    }
+}
+
+// Check if a slot is valid
+bool SavedRectanglesManager::IsValid(int slot) const {
+    if (slot < 0 || slot >= NUM_SAVED_RECTS)
+        return false;
+    return entries[slot].isValid;
+}
+
+// Save current state to file, preserving entries from other instances
+bool SavedRectanglesManager::SavePreservingExisting() {
+    // Load current file state
+    SavedRectanglesManager fileState;
+    fileState.Load();
+
+    // Merge our valid entries into the file state
+    for (int i = 0; i < NUM_SAVED_RECTS; i++) {
+        if (entries[i].isValid) {
+            fileState.SetEntry(i, entries[i]);
+        }
+    }
+
+    // Save the merged state
+    return fileState.Save();
 }
\ No newline at end of file
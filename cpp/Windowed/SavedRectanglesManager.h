@@ -1,10 +1,12 @@
 #pragma once
 
-#include <windows.h>
+#include "Platform.h"
 #include <string>
 #include <vector>
 #include <fstream>
 #include <sstream>
+#include "ColorEffects.h"
+#include "MonitorLayout.h"
 
 #define NUM_SAVED_RECTS 10
 
@@ -14,9 +16,29 @@ struct SavedRectEntry {
     bool inversionEnabled;
     bool grayscaleEnabled;
     int grayLevel;
+    int visionMode;     // VisionMode
+    int visionSeverity; // Step, 0..NUM_VISION_SEVERITIES - 1
+    int colorTemperature; // Kelvin
+    int sharpenLevel;     // Index into SharpenStrengths
+    int privacyEffect;    // PrivacyEffect
+    int blurRadius;       // Pixels
+    int pixelateBlock;    // Pixels
+    bool binarizeEnabled;
+    int binarizeWindow;   // Pixels, odd
+    bool autoInvert;
+    bool smartInvert;
     bool isValid;
 
-    SavedRectEntry() : inversionEnabled(false), grayscaleEnabled(false), grayLevel(0), isValid(false) {
+    // Client area relative to its monitor; preferred over rect when present
+    NormalizedRect placement;
+    bool hasPlacement;
+
+    SavedRectEntry()
+        : inversionEnabled(false), grayscaleEnabled(false), grayLevel(0), visionMode(VISION_NORMAL),
+          visionSeverity(NUM_VISION_SEVERITIES - 1), colorTemperature(COLOR_TEMPERATURE_NEUTRAL), sharpenLevel(0),
+          privacyEffect(PRIVACY_NONE), blurRadius(PRIVACY_BLUR_RADIUS_DEFAULT), pixelateBlock(PRIVACY_PIXELATE_BLOCK_DEFAULT),
+          binarizeEnabled(false), binarizeWindow(BINARIZE_WINDOW_DEFAULT), autoInvert(false), smartInvert(false),
+          isValid(false), hasPlacement(false) {
         memset(&rect, 0, sizeof(RECT));
     }
 };
@@ -33,6 +55,10 @@ private:
 public:
     SavedRectanglesManager();
 
+    // Parse/write the comma-separated data of an entry (the part after "Slot=")
+    static bool ParseEntry(const std::string& data, SavedRectEntry& entry);
+    static void WriteEntry(std::ostream& out, const SavedRectEntry& entry);
+
     // Load all rectangles from file
     bool Load();
 
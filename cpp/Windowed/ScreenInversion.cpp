@@ -12,7 +12,7 @@
 * - Window resizes to selected rectangle size
 * - Color inversion is applied by default, with configurable keyboard controls
 * - Dark mode title bar and theming
-* - Configurable shortcuts via shortcuts.txt file
+* - Configurable shortcuts via shortcuts.txt file, reloaded live when edited
 * - Rectangle save/load: 0-9 to load saved rects, Ctrl+0-9 to save current rect
 *
 * Requirements: To compile, link to Magnification.lib. The sample must be run with
@@ -42,6 +42,31 @@
 #include <map>
 #include <vector>
 #include "SavedRectanglesManager.h"
+#include "MonitorLayout.h"
+#include "ShortcutConfig.h"
+#include "FileWatcher.h"
+#include "SessionSnapshot.h"
+#include "StartupProfiler.h"
+#include "Metrics.h"
+#include "MetricsExporter.h"
+#include "EventTracer.h"
+#include "ColorEffects.h"
+#include "FramePipeline.h"
+#include "WorkerPool.h"
+#include "EffectController.h"
+#include "EffectTransition.h"
+#include "AutoInvert.h"
+#include "RateLimiter.h"
+#include "ControlChannel.h"
+#include "InputLog.h"
+#include "RegionStateMachine.h"
+#include "TimerWheel.h"
+#include <thread>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <deque>
+#include <algorithm>
 
 // Link required libraries
 #pragma comment(lib, "dwmapi.lib")
@@ -55,60 +80,107 @@
 #define DWMWA_USE_IMMERSIVE_DARK_MODE 20
 #endif
 
-// Rectangle selection states
-enum SelectionState {
-    SELECTION_NONE,
-    SELECTION_FIRST_POINT,
-    SELECTION_COMPLETE
-};
-
-// Configurable shortcuts structure
-struct ShortcutConfig {
-    UINT toggleInvertKey = 'I';
-    UINT toggleGrayscaleKey = 'C';
-    UINT cycleWhiteLevelKey = 'W';
-    UINT escapeKey = VK_ESCAPE;
-    UINT globalHotkeyModifiers = MOD_CONTROL | MOD_SHIFT;
-    UINT globalHotkeyKey = 'P';
-
-    // File path for config
-    static const char* CONFIG_FILE;
-};
-
-const char* ShortcutConfig::CONFIG_FILE = "shortcuts.txt";
-
-
 // Global variables and strings.
 HINSTANCE           hInst;
 const TCHAR         WindowClassName[] = TEXT("ScreenFilterWindow");
 const TCHAR         WindowTitle[] = TEXT("Screen Filter - Click two points to select area (0=cycle saved, 1-9=load saved)");
 const UINT          timerInterval = 16; // close to the refresh rate @60hz
+const UINT          configWatchInterval = 500; // how often shortcuts.txt is checked for edits
+const UINT          sessionSnapshotInterval = 30000; // how often the session snapshot is refreshed
 HWND                hwndMag;
 HWND                hwndHost;
 RECT                magWindowRectClient;
 RECT                magWindowRectWindow;
-RECT                hostWindowRect;
-
-// Rectangle selection variables
-SelectionState      selectionState = SELECTION_NONE;
-POINT               firstPoint;
-POINT               secondPoint;
-RECT                selectedRect;
 
 // Color effect state variables
-BOOL                inversionEnabled = FALSE;
-BOOL                grayscaleEnabled = FALSE;
-int                 grayLevel = 0; // 0-3, representing 4 levels: 100%, 80%, 60%, 40%
-BOOL                colorEffectsApplied = FALSE;
-BOOL                isPinned = FALSE; // Toggle for click-through behavior
+EffectController    effects; // Inversion, grayscale and white level, and the matrix they produce
+EffectTransition    effectTransition; // Fades the magnifier from one effect state to the next
+UINT                effectTransitionDuration = 200; // In ms, set with /transition-ms=<ms>; 0 switches at once
 HWND                previousForegroundWindow = NULL; // Track previous focus for unpinning
 
+// Auto-invert: the source is sampled a few times a second while the mode is on, since reading
+// the screen back costs more than a frame's other work
+AutoInvertDetector  autoInvert;
+const UINT          autoInvertSampleInterval = 100;
+ULONGLONG           autoInvertSampleTime = 0;
+PixelImage          autoInvertSample;
+
 // Shortcut configuration and saved rectangles
 ShortcutConfig      shortcuts;
+FileWatcher         shortcutConfigWatcher(ShortcutConfig::CONFIG_FILE, std::chrono::milliseconds(300));
 SavedRectanglesManager savedRects;
+MonitorLayout       monitorLayout;
 int                 currentCycleSlot = 1; // Start cycling from slot 1
 
+// Session restore state
+SessionSnapshot     session;
+int                 sessionRegionId = -1; // Region id claimed by this instance
+HANDLE              sessionRegionMutex = NULL;
+std::string         lastWrittenSessionRegion; // Avoids rewriting an unchanged snapshot
+BOOL                sessionRegionClosed = FALSE; // User closed the window: forget the region
+BOOL                benchmarkStartup = FALSE; // Report time to first filtered frame, then exit
+BOOL                firstFilteredFrameReported = FALSE;
+BOOL                restoredFromSession = FALSE;
+
+// Startup instrumentation and work deferred until after the first frame
+StartupProfiler     startupProfiler;
+std::vector<ConfigError> startupConfigErrors;
+BOOL                deferredInitDone = FALSE;
+BOOL                startupBenchmarkWritten = FALSE;
+
+// Runtime metrics, exported with /metrics-file=<path> and/or /metrics-port=<port>
+MetricsRegistry     metrics;
+MetricsExporter     metricsExporter(metrics);
+std::string         metricsFilePath;
+int                 metricsPort = 0;
+MetricCounter&      framesRendered = metrics.Counter("screenfilter_frames_total", "Frame timer ticks that updated the magnifier source");
+MetricCounter&      colorEffectCalls = metrics.Counter("screenfilter_color_effect_calls_total", "MagSetColorEffect calls");
+MetricCounter&      transitionFrames = metrics.Counter("screenfilter_effect_transition_frames_total", "Frames that handed on a step of an effect transition");
+MetricCounter&      titleUpdates = metrics.Counter("screenfilter_title_updates_total", "Host window title changes");
+MetricCounter&      profileLoads = metrics.Counter("screenfilter_profile_loads_total", "Saved rectangle file loads");
+MetricCounter&      configReloads = metrics.Counter("screenfilter_config_reloads_total", "Shortcut configuration reloads after an edit");
+MetricCounter&      hotkeyToggles = metrics.Counter("screenfilter_hotkey_toggles_total", "Pin toggles through the global hotkey");
+MetricCounter&      effectToggles = metrics.Counter("screenfilter_effect_toggles_total", "Color effect changes from keyboard shortcuts");
+MetricGauge&        regionWidth = metrics.Gauge("screenfilter_region_width_pixels", "Width of the filtered area");
+MetricGauge&        regionHeight = metrics.Gauge("screenfilter_region_height_pixels", "Height of the filtered area");
+MetricGauge&        pinnedGauge = metrics.Gauge("screenfilter_pinned", "1 while the window is click-through");
+MetricHistogram&    frameUpdateSeconds = metrics.Histogram("screenfilter_frame_update_seconds", "Time spent in the frame timer callback", DefaultLatencyBuckets());
+MetricHistogram&    applyEffectsSeconds = metrics.Histogram("screenfilter_apply_color_effects_seconds", "Time spent applying the color effect matrix", DefaultLatencyBuckets());
+
+// Debug overlay: key rates appended to the title, recomputed about once a second
+BOOL                metricsOverlayEnabled = FALSE;
+const UINT          metricsOverlayInterval = 1000;
+ULONGLONG           overlaySampleTime = 0;
+uint64_t            overlayLastFrames = 0;
+uint64_t            overlayLastEffectCalls = 0;
+uint64_t            overlayLastTitleUpdates = 0;
+double              overlayFrameRate = 0.0;
+double              overlayEffectRate = 0.0;
+double              overlayTitleRate = 0.0;
+std::basic_string<TCHAR> lastStatusTitle; // Title last written by UpdateTitle()
+
+// Status title rewrites are limited so key autorepeat does not flood the UI thread
+const UINT          titleUpdateInterval = 100;
+RateLimiter         titleLimiter(titleUpdateInterval);
+
+// Title resets and periodic checks, fired by the frame timer rather than OS timers of their own
+TimerWheel          timers(timerInterval);
+TimerHandle         titleResetTimer = 0; // Reset of the temporary message shown; a newer message supersedes it
+
+// Event tracing, toggled with the trace shortcut or started at launch with /trace
+EventTracer         tracer;
+const char          traceFilePath[] = "trace.json";
+
 #define HOTKEY_TOGGLE_PIN 1 // Hotkey ID for global shortcut
+#define WM_CONTROL_BATCH (WM_APP + 1) // Wakes the UI thread to run the queued control batches
+
+// Requests from one read of a control connection, executed together on the UI thread
+struct ControlBatch
+{
+    std::vector<ControlRequest> requests;
+    std::vector<ControlResponse> responses;
+    std::promise<void> done;
+};
 
 // Forward declarations.
 ATOM                RegisterHostWindowClass(HINSTANCE hInstance);
@@ -118,19 +190,142 @@ void CALLBACK       UpdateMagWindow(HWND hwnd, UINT uMsg, UINT_PTR idEvent, DWOR
 void                GoFullScreen();
 void                GoPartialScreen();
 void                HandleRectangleSelection(POINT clickPoint);
-void                ResizeToSelectedRectangle();
 void                ApplyColorEffects();
+BOOL                CaptureSourceSample(const RECT& sourceRect, PixelImage& sample);
+BOOL                UsesCpuRender(const ColorEffectSettings& settings);
+BOOL                DithersWhiteLevel(const ColorEffectSettings& settings);
+void                SetCpuRender(BOOL active);
+BOOL                RenderCpuFrame(const RECT& sourceRect);
+void                ShowCpuFrame(BOOL show);
+void                PaintCpuFrame(HDC dc);
+void                UpdateAutoInvert(const RECT& sourceRect);
+BOOL                SetMagnifierColorEffect();
+void                UpdateTitle();
+void                WriteStatusTitle();
+void                SetHostTitle(LPCTSTR text);
+void                SampleMetricsOverlay();
+void                ToggleTracing();
+size_t              WriteTraceFile();
+const char*         MessageName(UINT message);
+std::string         GetArgumentValue(LPCSTR commandLine, LPCSTR name);
 void                CalculateColorMatrix(MAGCOLOREFFECT* matrix);
-void                LoadShortcutConfig();
-void                SaveDefaultShortcutConfig();
+void                ApplyEntryEffects(const SavedRectEntry& entry);
+ColorEffectSettings GetEntryEffects(const SavedRectEntry& entry);
+void                LoadShortcutConfig(std::vector<ConfigError>& errors);
+void                ReloadShortcutConfig();
+void                CheckShortcutConfig(void* context);
+void                ShowConfigErrors(const std::vector<ConfigError>& errors);
+void                RestoreTitle();
+void                ShowTemporaryTitle(LPCTSTR message, UINT durationMs);
+UINT                GetCurrentModifiers();
+BOOL                MatchesChord(const KeyChord& chord, WPARAM key);
+BOOL                HandleEffectShortcut(WPARAM key);
 void                ApplyDarkModeToWindow(HWND hwnd);
 void                LoadSavedRectangles();
 void                SaveSavedRectangles();
-void                LoadRectangle(int slot);
+BOOL                LoadRectangle(int slot);
 void                SaveCurrentRectangle(int slot);
-void                CycleToNextSavedRectangle();
+BOOL                CycleToNextSavedRectangle();
 void                ApplyLoadedRectangle(const RECT& rect);
-BOOL                isFullScreen = FALSE;
+BOOL                ResolveSavedRectangle(const SavedRectEntry& entry, RECT& windowRect);
+void                WindowRectToClientRect(const RECT& windowRect, RECT& clientRect);
+void                ClientRectToWindowRect(const RECT& clientRect, RECT& windowRect);
+BOOL                CaptureCurrentEntry(SavedRectEntry& entry);
+BOOL                ClaimSessionRegion(SessionRegion& claimed, BOOL* moreUnclaimed);
+BOOL                TryClaimRegionId(int id);
+BOOL                IsRegionIdClaimed(int id);
+void                LaunchAnotherInstance(LPCSTR arguments);
+BOOL                RestoreSessionRegion(const SessionRegion& region);
+void                WriteSessionSnapshot(BOOL force);
+void                SessionSnapshotTimer(void* context);
+void                ReportFirstFilteredFrame();
+void                LoadStartupFiles();
+void                RunDeferredInitialization();
+void                WriteStartupBenchmark();
+void                SetProfilerOriginToProcessStart();
+void                HandleControlBatch(const std::vector<ControlRequest>& requests, std::vector<ControlResponse>& responses);
+void                ExecuteControlBatches();
+void                ExecuteControlBatch(ControlBatch& batch);
+void                FailControlBatches();
+void                StartInputRecording();
+void                RecordInput(const InputLogRecord& record);
+void                RecordKeyInput(InputLogRecordType type, WPARAM key);
+void                RecordInputState();
+void                RecordSavedRectangles();
+
+// Carries out the window calls of the region state machine
+class WindowRegionPlatform : public RegionPlatform
+{
+public:
+    WindowFrameMetrics GetFrameMetrics() override;
+    void GetFullScreenRect(RECT& windowRect) override;
+    void GetWindowRect(RECT& windowRect) override;
+    void SetShowState(bool maximized) override;
+    void SetStyle(RegionStyle style) override;
+    void SetExStyle(uint8_t exStyle) override;
+    void SetPosition(const RECT& windowRect, bool frameChanged) override;
+    void ApplyTheme() override;
+    void SetOpaque(bool opaque) override;
+    bool ApplyColorEffect() override;
+};
+
+// Selection, full screen, pin and effect state of the window (see RegionStateMachine.h)
+WindowRegionPlatform windowRegionPlatform;
+RegionStateMachine  windowRegion(windowRegionPlatform);
+
+// Screen contents under the host window for the CPU render path. The host window is layered,
+// and a blit from the screen without CAPTUREBLT leaves layered windows out, so the capture shows
+// what is under the filter rather than its output. The bitmap is kept from frame to frame.
+class ScreenFrameSource : public FrameSource
+{
+private:
+    HDC memory;
+    HBITMAP bitmap;
+    HGDIOBJ previousBitmap;
+    void* bits;
+    int bitmapWidth;
+    int bitmapHeight;
+
+public:
+    ScreenFrameSource() : memory(NULL), bitmap(NULL), previousBitmap(NULL), bits(NULL), bitmapWidth(0), bitmapHeight(0) {}
+    ~ScreenFrameSource() { Release(); }
+
+    RECT GetBounds() const override;
+    bool Capture(const RECT& region, PixelImage& frame) override;
+
+    // Frees the bitmap until the next capture
+    void Release();
+};
+
+// CPU render path, for the effects the magnifier's color matrix cannot express (UsesCpuRender).
+// While it is active each frame filters a capture of the screen and WM_PAINT draws the result into
+// the host window, with the magnifier control hidden. The magnifier stays up until a CPU frame is
+// ready, and comes back when a capture fails, so a privacy effect's flat gray covers the region
+// meanwhile. Created on first use.
+ScreenFrameSource   screenSource;
+std::unique_ptr<WorkerPool> cpuRenderWorkers;
+std::unique_ptr<FramePipeline> cpuRenderPipeline;
+BOOL                cpuRenderActive = FALSE;
+BOOL                cpuFrameShown = FALSE; // The host window shows the last CPU frame and the magnifier is hidden
+BOOL                ditherWhiteLevels = FALSE; // Set with /dither: white levels below 100% go through the CPU path, dithered
+ToneCurve           toneCurve; // Loaded with /tone-curve=<file.cube>: every frame goes through the CPU path, curved after the matrix
+BOOL                toneCurveLoaded = FALSE;
+std::string         toneCurveError; // Why the /tone-curve= file was not loaded, shown once the window is up
+MetricCounter&      cpuFrames = metrics.Counter("screenfilter_cpu_frames_total", "Frames filtered on the CPU instead of by the magnifier");
+
+// Local control channel for scripts, enabled with /control=<socket or pipe name>
+std::string         controlEndpoint;
+ControlServer       controlServer(HandleControlBatch);
+std::mutex          controlBatchLock;
+std::deque<std::shared_ptr<ControlBatch>> controlBatches; // Posted by connection threads, run on the UI thread
+MetricCounter&      controlCommands = metrics.Counter("screenfilter_control_commands_total", "Commands received on the control channel");
+
+// Input recording for headless replay (screenfilter_bench --replay), enabled with /record=<path>
+std::string         inputRecordPath;
+InputLogWriter      inputRecorder;
+std::chrono::steady_clock::time_point inputRecordStart;
+InputLogState       lastRecordedState; // Written after an input only when it differs
+InputLogSlot        lastRecordedSlots[NUM_SAVED_RECTS];
 
 //
 // FUNCTION: WinMain()
@@ -139,21 +334,103 @@ BOOL                isFullScreen = FALSE;
 //
 int APIENTRY WinMain(_In_ HINSTANCE hInstance,
     _In_opt_ HINSTANCE /*hPrevInstance*/,
-    _In_ LPSTR     /*lpCmdLine*/,
+    _In_ LPSTR     lpCmdLine,
     _In_ int       nCmdShow)
 {
     // Intentionally ignore nCmdShow as we need to start fullscreen 
     // to capture initial points to define rectangle. 
     (void)nCmdShow; 
 
-    if (FALSE == MagInitialize())
+    // /restore-only is passed to instances launched to restore further session regions
+    BOOL restoreOnly = (strstr(lpCmdLine, "/restore-only") != NULL);
+    benchmarkStartup = (strstr(lpCmdLine, "/benchmark-startup") != NULL);
+    ditherWhiteLevels = (strstr(lpCmdLine, "/dither") != NULL);
+    metricsFilePath = GetArgumentValue(lpCmdLine, "/metrics-file=");
+    metricsPort = atoi(GetArgumentValue(lpCmdLine, "/metrics-port=").c_str());
+    controlEndpoint = GetArgumentValue(lpCmdLine, "/control=");
+    inputRecordPath = GetArgumentValue(lpCmdLine, "/record=");
+    std::string transitionArgument = GetArgumentValue(lpCmdLine, "/transition-ms=");
+    if (!transitionArgument.empty())
+    {
+        effectTransitionDuration = static_cast<UINT>(atoi(transitionArgument.c_str()));
+    }
+
+    // Sizes the privacy effects start with; saved rectangles bring their own
+    std::string blurArgument = GetArgumentValue(lpCmdLine, "/blur-radius=");
+    std::string pixelateArgument = GetArgumentValue(lpCmdLine, "/pixelate-block=");
+    if (!blurArgument.empty() || !pixelateArgument.empty())
+    {
+        ColorEffectSettings startSettings = effects.GetSettings();
+        if (!blurArgument.empty())
+        {
+            int radius = atoi(blurArgument.c_str());
+            startSettings.blurRadius = radius < 0 ? 0 : (radius > PRIVACY_BLUR_RADIUS_MAX ? PRIVACY_BLUR_RADIUS_MAX : radius);
+        }
+        if (!pixelateArgument.empty())
+        {
+            int block = atoi(pixelateArgument.c_str());
+            startSettings.pixelateBlock = block < PRIVACY_PIXELATE_BLOCK_MIN ? PRIVACY_PIXELATE_BLOCK_MIN :
+                (block > PRIVACY_PIXELATE_BLOCK_MAX ? PRIVACY_PIXELATE_BLOCK_MAX : block);
+        }
+        effects.SetSettings(startSettings);
+    }
+    std::string toneCurvePath = GetArgumentValue(lpCmdLine, "/tone-curve=");
+    if (!toneCurvePath.empty())
+    {
+        toneCurveLoaded = LoadToneCurveFile(toneCurvePath.c_str(), toneCurve, toneCurveError);
+    }
+    if (strstr(lpCmdLine, "/trace") != NULL)
+    {
+        tracer.Start();
+    }
+    tracer.SetThreadName("main");
+    SetProfilerOriginToProcessStart();
+
+    // Config, saved rectangle and session parsing run alongside magnifier and window setup
+    std::thread backgroundInit(LoadStartupFiles);
+
+    BOOL initialized;
+    {
+        StartupPhase phase(startupProfiler, "MagInitialize");
+        initialized = MagInitialize();
+    }
+
+    BOOL created = FALSE;
+    if (initialized)
+    {
+        StartupPhase phase(startupProfiler, "SetupScreenFilter");
+        created = SetupScreenFilter(hInstance);
+    }
+
+    {
+        StartupPhase phase(startupProfiler, "WaitForBackgroundInit");
+        backgroundInit.join();
+    }
+
+    if (FALSE == initialized)
+    {
+        return 0;
+    }
+    if (FALSE == created)
+    {
+        MagUninitialize();
+        return 0;
+    }
+
+    // Claim a region left over from the last session, if any, so it can skip the selection phase
+    BOOL moreUnclaimed = FALSE;
+    SessionRegion restoredRegion;
+    BOOL hasRestoredRegion = ClaimSessionRegion(restoredRegion, &moreUnclaimed);
+    if (!hasRestoredRegion && restoreOnly)
     {
+        MagUninitialize();
         return 0;
     }
 
-    // Check if any other instance is already in selection mode (maximized)
+    // Check if any other instance is already in selection mode (maximized).
+    // A restored region never enters selection mode, so it does not need to wait.
     HWND existingWindow = NULL;
-    do {
+    if (!hasRestoredRegion) do {
         existingWindow = FindWindowEx(NULL, existingWindow, WindowClassName, NULL);
         if (existingWindow && IsZoomed(existingWindow))
         {
@@ -163,27 +440,31 @@ int APIENTRY WinMain(_In_ HINSTANCE hInstance,
         }   
     } while (existingWindow != NULL);
 
-    // Load shortcut configuration and saved rectangles
-    LoadShortcutConfig();
-    LoadSavedRectangles();
-
-    if (FALSE == SetupScreenFilter(hInstance))
+    BOOL restored;
     {
-        return 0;
+        StartupPhase phase(startupProfiler, "ShowFirstWindow");
+        restored = hasRestoredRegion && RestoreSessionRegion(restoredRegion);
+        if (!restored)
+        {
+            // Show maximized instead of using nCmdShow. The window is almost fully transparent
+            // during selection, so dark mode theming waits for the deferred initialization.
+            windowRegion.Dispatch(RegionEvent(REGION_SHOW));
+            UpdateWindow(hwndHost);
+        }
     }
 
-    // Apply dark mode theming
-    ApplyDarkModeToWindow(hwndHost);
-
-    // Show maximized instead of using nCmdShow
-    ShowWindow(hwndHost, SW_MAXIMIZE);
-    UpdateWindow(hwndHost);
+    // Restored straight into its final window; hand the remaining regions to another instance
+    if (restored && moreUnclaimed && !benchmarkStartup)
+    {
+        LaunchAnotherInstance("/restore-only");
+    }
 
-    // Register global hotkey using configured values
-    RegisterHotKey(hwndHost, HOTKEY_TOGGLE_PIN,
-        shortcuts.globalHotkeyModifiers, shortcuts.globalHotkeyKey);
+    if (!inputRecordPath.empty())
+    {
+        StartInputRecording();
+    }
 
-    // Create a timer to update the control.
+    // Create a timer to update the control. Everything else waits for its first tick.
     UINT_PTR timerId = SetTimer(hwndHost, 0, timerInterval, UpdateMagWindow);
 
     // Main message loop.
@@ -196,10 +477,131 @@ int APIENTRY WinMain(_In_ HINSTANCE hInstance,
 
     // Shut down.
     KillTimer(NULL, timerId);
+    controlServer.Stop();
+    inputRecorder.Close();
+    metricsExporter.Stop();
+    if (sessionRegionMutex != NULL)
+    {
+        CloseHandle(sessionRegionMutex);
+    }
     MagUninitialize();
     return (int)msg.wParam;
 }
 
+//
+// FUNCTION: GetArgumentValue()
+//
+// PURPOSE: Returns the text following a "/name=" command line switch, up to the next space.
+//          The value may be quoted to include spaces. Empty if the switch is absent.
+//
+std::string GetArgumentValue(LPCSTR commandLine, LPCSTR name)
+{
+    LPCSTR start = strstr(commandLine, name);
+    if (start == NULL)
+        return "";
+    start += strlen(name);
+
+    char terminator = ' ';
+    if (*start == '"')
+    {
+        terminator = '"';
+        start++;
+    }
+
+    LPCSTR end = strchr(start, terminator);
+    return end != NULL ? std::string(start, end) : std::string(start);
+}
+
+//
+// FUNCTION: SetProfilerOriginToProcessStart()
+//
+// PURPOSE: Measures startup phases from process creation rather than from entering WinMain.
+//
+void SetProfilerOriginToProcessStart()
+{
+    FILETIME creationTime, exitTime, kernelTime, userTime, now;
+    if (!GetProcessTimes(GetCurrentProcess(), &creationTime, &exitTime, &kernelTime, &userTime))
+        return;
+    GetSystemTimePreciseAsFileTime(&now);
+
+    // FILETIME counts 100ns intervals
+    ULONGLONG start = (static_cast<ULONGLONG>(creationTime.dwHighDateTime) << 32) | creationTime.dwLowDateTime;
+    ULONGLONG end = (static_cast<ULONGLONG>(now.dwHighDateTime) << 32) | now.dwLowDateTime;
+    if (end > start)
+    {
+        startupProfiler.SetOrigin(std::chrono::steady_clock::now() - std::chrono::microseconds((end - start) / 10));
+    }
+}
+
+//
+// FUNCTION: LoadStartupFiles()
+//
+// PURPOSE: Parses the configuration, saved rectangle and session files. Runs on a background
+//          thread during startup; WinMain joins it before any of the results are used.
+//
+void LoadStartupFiles()
+{
+    tracer.SetThreadName("startup files");
+    {
+        StartupPhase phase(startupProfiler, "LoadShortcutConfig", true);
+        LoadShortcutConfig(startupConfigErrors);
+    }
+    {
+        StartupPhase phase(startupProfiler, "LoadSavedRectangles", true);
+        LoadSavedRectangles();
+    }
+    {
+        StartupPhase phase(startupProfiler, "LoadSession", true);
+        TraceScope scope(tracer, "SessionSnapshot::Load", "io");
+        session.Load();
+    }
+}
+
+//
+// FUNCTION: RunDeferredInitialization()
+//
+// PURPOSE: Finishes startup work not needed for the first visible frame. Called on the first timer tick.
+//
+void RunDeferredInitialization()
+{
+    StartupPhase phase(startupProfiler, "DeferredInitialization");
+    deferredInitDone = TRUE;
+
+    // Apply dark mode theming, now and after every later style change
+    windowRegion.Dispatch(RegionEvent(REGION_ENABLE_THEME));
+
+    // Register global hotkey using configured values
+    RegisterHotKey(hwndHost, HOTKEY_TOGGLE_PIN,
+        shortcuts.globalHotkey.modifiers, shortcuts.globalHotkey.key);
+
+    if (!startupConfigErrors.empty())
+    {
+        ShowConfigErrors(startupConfigErrors);
+    }
+    else if (!toneCurveError.empty())
+    {
+        TCHAR message[256];
+        _stprintf_s(message, 256, TEXT("Screen Filter - tone curve: %hs"), toneCurveError.c_str());
+        ShowTemporaryTitle(message, 5000);
+    }
+
+    // Pick up edits to the shortcut configuration without a restart
+    timers.Schedule(GetTickCount64(), configWatchInterval, CheckShortcutConfig, NULL);
+
+    // Keep the session snapshot current in case the process does not exit cleanly
+    timers.Schedule(GetTickCount64(), sessionSnapshotInterval, SessionSnapshotTimer, NULL);
+
+    if (!metricsFilePath.empty() || metricsPort != 0)
+    {
+        metricsExporter.Start(metricsFilePath, metricsPort, std::chrono::milliseconds(metricsOverlayInterval));
+    }
+
+    if (!controlEndpoint.empty())
+    {
+        controlServer.Start(controlEndpoint);
+    }
+}
+
 //
 // FUNCTION: LoadSavedRectangles()
 //
@@ -207,7 +609,10 @@ int APIENTRY WinMain(_In_ HINSTANCE hInstance,
 //
 void LoadSavedRectangles()
 {
+    TraceScope scope(tracer, "SavedRectanglesManager::Load", "io");
+    profileLoads.Increment();
     savedRects.Load();
+    RecordSavedRectangles();
 }
 
 //
@@ -217,52 +622,52 @@ void LoadSavedRectangles()
 //
 void SaveSavedRectangles()
 {
+    TraceScope scope(tracer, "SavedRectanglesManager::SavePreservingExisting", "io");
     savedRects.SavePreservingExisting();
 }
 
 //
 // FUNCTION: LoadRectangle()
 //
-// PURPOSE: Loads a saved rectangle from the specified slot.
+// PURPOSE: Loads a saved rectangle from the specified slot. Returns FALSE if the slot is empty
+//          or its rectangle cannot be placed on the current monitors.
 //
-void LoadRectangle(int slot)
+BOOL LoadRectangle(int slot)
 {
     // Reload from file first to get latest saves from other instances
-    savedRects.Load();
+    LoadSavedRectangles();
 
     if (!savedRects.IsValid(slot))
     {
         // Show a brief message that the slot is empty
         TCHAR message[256];
         _stprintf_s(message, 256, TEXT("Screen Filter - Slot %d is empty"), slot);
-        SetWindowText(hwndHost, message);
-
-        // Reset title after 2 seconds
-        SetTimer(hwndHost, 999, 2000, [](HWND hwnd, UINT, UINT_PTR, DWORD) {
-            SetWindowText(hwnd, WindowTitle);
-            KillTimer(hwnd, 999);
-            });
-        return;
+        ShowTemporaryTitle(message, 2000);
+        return FALSE;
     }
 
     // Get the saved entry and restore color settings
     const SavedRectEntry& entry = savedRects.GetEntry(slot);
-    inversionEnabled = entry.inversionEnabled;
-    grayscaleEnabled = entry.grayscaleEnabled;
-    grayLevel = entry.grayLevel;
+    RECT windowRect;
+    if (!ResolveSavedRectangle(entry, windowRect))
+        return FALSE;
 
-    ApplyLoadedRectangle(entry.rect);
+    ApplyEntryEffects(entry);
+
+    ApplyLoadedRectangle(windowRect);
+    return TRUE;
 }
 
 //
 // FUNCTION: CycleToNextSavedRectangle()
 //
-// PURPOSE: Cycles through all saved rectangles, skipping empty slots.
+// PURPOSE: Cycles through all saved rectangles, skipping empty slots. Returns FALSE if none
+//          could be loaded.
 //
-void CycleToNextSavedRectangle()
+BOOL CycleToNextSavedRectangle()
 {
     // Reload from file first to get latest saves from other instances
-    savedRects.Load();
+    LoadSavedRectangles();
 
     int attempts = 0;
 
@@ -276,37 +681,26 @@ void CycleToNextSavedRectangle()
     } while (!savedRects.IsValid(currentCycleSlot) && attempts < NUM_SAVED_RECTS);
 
     // If we found a valid slot, load it
-    if (savedRects.IsValid(currentCycleSlot)) {
+    RECT windowRect;
+    if (savedRects.IsValid(currentCycleSlot) && ResolveSavedRectangle(savedRects.GetEntry(currentCycleSlot), windowRect)) {
         // Get the saved entry and restore color settings
         const SavedRectEntry& entry = savedRects.GetEntry(currentCycleSlot);
-        inversionEnabled = entry.inversionEnabled;
-        grayscaleEnabled = entry.grayscaleEnabled;
-        grayLevel = entry.grayLevel;
+        ApplyEntryEffects(entry);
 
-        ApplyLoadedRectangle(entry.rect);
+        ApplyLoadedRectangle(windowRect);
 
         // Show which slot was loaded
         TCHAR message[256];
         _stprintf_s(message, 256, TEXT("Screen Filter - Loaded Slot %d (Press 0 to cycle)"), currentCycleSlot);
-        SetWindowText(hwndHost, message);
-
-        // Reset title after 2 seconds
-        SetTimer(hwndHost, 997, 2000, [](HWND hwnd, UINT, UINT_PTR, DWORD) {
-            ApplyColorEffects(); // This will restore the proper title
-            KillTimer(hwnd, 997);
-            });
+        ShowTemporaryTitle(message, 2000);
+        return TRUE;
     }
     else {
         // No saved rectangles found
         TCHAR message[256];
         _stprintf_s(message, 256, TEXT("Screen Filter - No saved rectangles found (Use Ctrl+1-9 to save)"));
-        SetWindowText(hwndHost, message);
-
-        // Reset title after 2 seconds
-        SetTimer(hwndHost, 996, 2000, [](HWND hwnd, UINT, UINT_PTR, DWORD) {
-            SetWindowText(hwnd, WindowTitle);
-            KillTimer(hwnd, 996);
-            });
+        ShowTemporaryTitle(message, 2000);
+        return FALSE;
     }
 }
 
@@ -318,20 +712,12 @@ void CycleToNextSavedRectangle()
 void SaveCurrentRectangle(int slot)
 {
     // Slot 0 is reserved for cycling - cannot save to it
-    if (slot <= 0 || slot >= NUM_SAVED_RECTS || selectionState != SELECTION_COMPLETE)
+    if (slot <= 0 || slot >= NUM_SAVED_RECTS || !windowRegion.IsSelectionComplete())
         return;
 
-    // Get the current window position and size, not the original selected rectangle
-    RECT currentRect;
-    GetWindowRect(hwndHost, &currentRect);
-
     // Create entry with current settings
     SavedRectEntry entry;
-    entry.rect = currentRect;
-    entry.inversionEnabled = inversionEnabled;
-    entry.grayscaleEnabled = grayscaleEnabled;
-    entry.grayLevel = grayLevel;
-    entry.isValid = true;
+    CaptureCurrentEntry(entry);
 
     // Save the entry
     savedRects.SetEntry(slot, entry);
@@ -341,207 +727,569 @@ void SaveCurrentRectangle(int slot)
     // Show confirmation message
     TCHAR message[256];
     _stprintf_s(message, 256, TEXT("Screen Filter - Rectangle saved to slot %d"), slot);
-    SetWindowText(hwndHost, message);
-
-    // Reset title after 2 seconds
-    SetTimer(hwndHost, 998, 2000, [](HWND hwnd, UINT, UINT_PTR, DWORD) {
-        ApplyColorEffects(); // This will restore the proper title
-        KillTimer(hwnd, 998);
-        });
+    ShowTemporaryTitle(message, 2000);
 }
 
 //
-// FUNCTION: ApplyLoadedRectangle()
+// FUNCTION: CaptureCurrentEntry()
 //
-// PURPOSE: Applies a loaded rectangle, completing the selection process.
+// PURPOSE: Fills an entry with the current window position and color settings.
 //
-void ApplyLoadedRectangle(const RECT& rect)
+BOOL CaptureCurrentEntry(SavedRectEntry& entry)
 {
-    // The loaded rectangle is a full window rectangle (including borders and title bar)
-    // We need to convert it back to the client area coordinates for selectedRect
-    LONG titleBarHeight = GetSystemMetrics(SM_CYCAPTION);
-    LONG borderWidth = GetSystemMetrics(SM_CXSIZEFRAME);
-    LONG borderHeight = GetSystemMetrics(SM_CYSIZEFRAME);
-    
-    // Convert window bounds back to client area bounds
-    selectedRect.left = rect.left + borderWidth;
-    selectedRect.top = rect.top + titleBarHeight + borderHeight;
-    selectedRect.right = rect.right - borderWidth;
-    selectedRect.bottom = rect.bottom - borderHeight;
-    
-    selectionState = SELECTION_COMPLETE;
-
-    // Apply the window position directly since rect already contains the proper window bounds
-    int width = rect.right - rect.left;
-    int height = rect.bottom - rect.top;
-    
-    ShowWindow(hwndHost, SW_RESTORE);
-    hostWindowRect = rect;
-    SetWindowLong(hwndHost, GWL_STYLE, RESTOREDWINDOWSTYLES);
-    SetWindowPos(hwndHost, HWND_TOPMOST, rect.left, rect.top, width, height, SWP_SHOWWINDOW | SWP_NOACTIVATE | SWP_FRAMECHANGED);
-    ApplyDarkModeToWindow(hwndHost);
-    SetWindowLong(hwndHost, GWL_EXSTYLE, GetWindowLong(hwndHost, GWL_EXSTYLE) | WS_EX_LAYERED);
-    SetLayeredWindowAttributes(hwndHost, 0, 255, LWA_ALPHA);
-    ApplyColorEffects();
+    if (!windowRegion.IsSelectionComplete())
+        return FALSE;
 
-    // Update title to show that a rectangle was loaded
-    TCHAR instructionText[256];
-    _stprintf_s(instructionText, 256,
-        TEXT("Screen Filter - Area Loaded (%c=Invert, %c=Grayscale, %c=White Level, Ctrl+1-9=Save)"),
-        shortcuts.toggleInvertKey, shortcuts.toggleGrayscaleKey, shortcuts.cycleWhiteLevelKey);
-    SetWindowText(hwndHost, instructionText);
+    // Get the current window position and size, not the original selected rectangle
+    RECT currentRect;
+    GetWindowRect(hwndHost, &currentRect);
+
+    entry.rect = currentRect;
+    entry.inversionEnabled = effects.GetSettings().inversionEnabled;
+    entry.grayscaleEnabled = effects.GetSettings().grayscaleEnabled;
+    entry.grayLevel = effects.GetSettings().grayLevel;
+    entry.visionMode = effects.GetSettings().visionMode;
+    entry.visionSeverity = effects.GetSettings().visionSeverity;
+    entry.colorTemperature = effects.GetSettings().colorTemperature;
+    entry.sharpenLevel = effects.GetSettings().sharpenLevel;
+    entry.privacyEffect = effects.GetSettings().privacyEffect;
+    entry.blurRadius = effects.GetSettings().blurRadius;
+    entry.pixelateBlock = effects.GetSettings().pixelateBlock;
+    entry.binarizeEnabled = effects.GetSettings().binarizeEnabled;
+    entry.binarizeWindow = effects.GetSettings().binarizeWindow;
+    entry.autoInvert = effects.GetSettings().autoInvert;
+    entry.smartInvert = effects.GetSettings().smartInvert;
+    entry.isValid = true;
+
+    // Also store the client area relative to its monitor so the entry survives layout changes
+    RECT clientRect;
+    WindowRectToClientRect(currentRect, clientRect);
+    monitorLayout.Refresh();
+    entry.hasPlacement = monitorLayout.Normalize(clientRect, entry.placement);
+    return TRUE;
 }
 
 //
-// FUNCTION: LoadShortcutConfig()
+// FUNCTION: ClaimSessionRegion()
 //
-// PURPOSE: Loads shortcut configuration from file, creates default if not found.
+// PURPOSE: Claims the first session region not owned by a running instance. Returns FALSE and
+//          claims a free region id for a new selection if every saved region is already open.
 //
-void LoadShortcutConfig()
+BOOL ClaimSessionRegion(SessionRegion& claimed, BOOL* moreUnclaimed)
 {
-    std::ifstream configFile(ShortcutConfig::CONFIG_FILE);
+    BOOL found = FALSE;
+    *moreUnclaimed = FALSE;
 
-    if (!configFile.is_open())
+    for (const SessionRegion& region : session.GetRegions())
     {
-        // File doesn't exist, create default configuration
-        SaveDefaultShortcutConfig();
-        return;
+        if (!found && TryClaimRegionId(region.id))
+        {
+            claimed = region;
+            found = TRUE;
+        }
+        else if (found && !IsRegionIdClaimed(region.id))
+        {
+            *moreUnclaimed = TRUE;
+            break;
+        }
     }
 
-    std::string line;
-    std::map<std::string, std::string> configMap;
-
-    // Parse the config file
-    while (std::getline(configFile, line))
+    if (!found)
     {
-        // Skip comments and empty lines
-        if (line.empty() || line[0] == '#' || line[0] == ';')
-            continue;
-
-        size_t equalPos = line.find('=');
-        if (equalPos != std::string::npos)
+        // New region: take the lowest id not owned by another instance or the saved session
+        for (int id = 0; id < MAX_SESSION_REGIONS; id++)
         {
-            std::string key = line.substr(0, equalPos);
-            std::string value = line.substr(equalPos + 1);
+            if (session.Find(id) == NULL && TryClaimRegionId(id))
+                break;
+        }
+    }
+    return found;
+}
 
-            // Trim whitespace
-            key.erase(0, key.find_first_not_of(" \t"));
-            key.erase(key.find_last_not_of(" \t") + 1);
-            value.erase(0, value.find_first_not_of(" \t"));
-            value.erase(value.find_last_not_of(" \t") + 1);
+//
+// FUNCTION: TryClaimRegionId()
+//
+// PURPOSE: Claims a session region id with a named mutex held until exit.
+//
+BOOL TryClaimRegionId(int id)
+{
+    char mutexName[64];
+    sprintf_s(mutexName, sizeof(mutexName), "Local\\ScreenFilterRegion%d", id);
 
-            configMap[key] = value;
-        }
+    HANDLE mutex = CreateMutexA(NULL, FALSE, mutexName);
+    if (mutex == NULL)
+        return FALSE;
+    if (GetLastError() == ERROR_ALREADY_EXISTS)
+    {
+        CloseHandle(mutex);
+        return FALSE;
     }
 
-    // Apply configuration values
-    if (configMap.find("ToggleInvertKey") != configMap.end())
-        shortcuts.toggleInvertKey = configMap["ToggleInvertKey"][0];
+    sessionRegionMutex = mutex;
+    sessionRegionId = id;
+    return TRUE;
+}
+
+//
+// FUNCTION: IsRegionIdClaimed()
+//
+// PURPOSE: Checks whether a running instance owns a session region id.
+//
+BOOL IsRegionIdClaimed(int id)
+{
+    char mutexName[64];
+    sprintf_s(mutexName, sizeof(mutexName), "Local\\ScreenFilterRegion%d", id);
 
-    if (configMap.find("ToggleGrayscaleKey") != configMap.end())
-        shortcuts.toggleGrayscaleKey = configMap["ToggleGrayscaleKey"][0];
+    HANDLE mutex = OpenMutexA(SYNCHRONIZE, FALSE, mutexName);
+    if (mutex == NULL)
+        return FALSE;
+    CloseHandle(mutex);
+    return TRUE;
+}
 
-    if (configMap.find("CycleWhiteLevelKey") != configMap.end())
-        shortcuts.cycleWhiteLevelKey = configMap["CycleWhiteLevelKey"][0];
+//
+// FUNCTION: LaunchAnotherInstance()
+//
+// PURPOSE: Starts another copy of this executable with the given arguments.
+//
+void LaunchAnotherInstance(LPCSTR arguments)
+{
+    char exePath[MAX_PATH];
+    if (GetModuleFileNameA(NULL, exePath, MAX_PATH) == 0)
+        return;
 
-    if (configMap.find("GlobalHotkeyKey") != configMap.end())
-        shortcuts.globalHotkeyKey = configMap["GlobalHotkeyKey"][0];
+    char commandLine[MAX_PATH + 64];
+    sprintf_s(commandLine, sizeof(commandLine), "\"%s\" %s", exePath, arguments);
 
-    // Parse modifier keys
-    if (configMap.find("GlobalHotkeyModifiers") != configMap.end())
+    STARTUPINFOA startupInfo = {};
+    startupInfo.cb = sizeof(startupInfo);
+    PROCESS_INFORMATION processInfo = {};
+    if (CreateProcessA(NULL, commandLine, NULL, NULL, FALSE, 0, NULL, NULL, &startupInfo, &processInfo))
     {
-        std::string modStr = configMap["GlobalHotkeyModifiers"];
-        shortcuts.globalHotkeyModifiers = 0;
+        CloseHandle(processInfo.hThread);
+        CloseHandle(processInfo.hProcess);
+    }
+}
+
+//
+// FUNCTION: RestoreSessionRegion()
+//
+// PURPOSE: Puts the window straight into a region from the last session, skipping selection.
+//
+BOOL RestoreSessionRegion(const SessionRegion& region)
+{
+    RECT windowRect;
+    if (!ResolveSavedRectangle(region.entry, windowRect))
+        return FALSE;
+
+    ApplyEntryEffects(region.entry);
+
+    ApplyLoadedRectangle(windowRect);
+    restoredFromSession = TRUE;
 
-        if (modStr.find("CTRL") != std::string::npos)
-            shortcuts.globalHotkeyModifiers |= MOD_CONTROL;
-        if (modStr.find("SHIFT") != std::string::npos)
-            shortcuts.globalHotkeyModifiers |= MOD_SHIFT;
-        if (modStr.find("ALT") != std::string::npos)
-            shortcuts.globalHotkeyModifiers |= MOD_ALT;
-        if (modStr.find("WIN") != std::string::npos)
-            shortcuts.globalHotkeyModifiers |= MOD_WIN;
+    if (region.isPinned)
+    {
+        // Click-through without taking focus from whatever the user is doing
+        windowRegion.Dispatch(RegionEvent(REGION_TOGGLE_PIN));
+        UpdateTitle();
     }
 
-    configFile.close();
+    // Nothing has changed since the snapshot was written
+    std::ostringstream written;
+    SavedRectanglesManager::WriteEntry(written, region.entry);
+    lastWrittenSessionRegion = std::to_string(region.isPinned ? 1 : 0) + "," + written.str();
+    return TRUE;
 }
 
 //
-// FUNCTION: SaveDefaultShortcutConfig()
+// FUNCTION: WriteSessionSnapshot()
 //
-// PURPOSE: Creates a default shortcut configuration file.
+// PURPOSE: Writes this instance's region to the session snapshot if it changed since the last write.
 //
-void SaveDefaultShortcutConfig()
+void WriteSessionSnapshot(BOOL force)
 {
-    std::ofstream configFile(ShortcutConfig::CONFIG_FILE);
+    SessionRegion region;
+    region.id = sessionRegionId;
+    region.isPinned = windowRegion.GetState().pinned;
+    if (sessionRegionId < 0 || benchmarkStartup || !CaptureCurrentEntry(region.entry))
+        return;
 
-    if (!configFile.is_open())
+    std::ostringstream current;
+    SavedRectanglesManager::WriteEntry(current, region.entry);
+    std::string serialized = std::to_string(region.isPinned ? 1 : 0) + "," + current.str();
+    if (!force && serialized == lastWrittenSessionRegion)
         return;
 
-    configFile << "# Screen Filter Shortcut Configuration\n";
-    configFile << "# Edit these values to customize keyboard shortcuts\n";
-    configFile << "# Use single characters for keys (case sensitive)\n\n";
+    TraceScope scope(tracer, "SessionSnapshot::SaveRegion", "io");
+    if (session.SaveRegionPreservingExisting(region))
+    {
+        lastWrittenSessionRegion = serialized;
+    }
+}
 
-    configFile << "# Toggle color inversion on/off\n";
-    configFile << "ToggleInvertKey=I\n\n";
+//
+// FUNCTION: SessionSnapshotTimer()
+//
+// PURPOSE: Refreshes the session snapshot. Called from the timer wheel; schedules the next refresh.
+//
+void SessionSnapshotTimer(void* /*context*/)
+{
+    WriteSessionSnapshot(FALSE);
+    timers.Schedule(GetTickCount64(), sessionSnapshotInterval, SessionSnapshotTimer, NULL);
+}
 
-    configFile << "# Toggle between grayscale and color\n";
-    configFile << "ToggleGrayscaleKey=C\n\n";
+//
+// FUNCTION: ReportFirstFilteredFrame()
+//
+// PURPOSE: Records the time from process start to the first frame drawn with color effects applied.
+//
+void ReportFirstFilteredFrame()
+{
+    firstFilteredFrameReported = TRUE;
+    startupProfiler.Mark("FirstFilteredFrame");
 
-    configFile << "# Cycle through white/brightness levels\n";
-    configFile << "CycleWhiteLevelKey=W\n\n";
+    char report[128];
+    sprintf_s(report, sizeof(report), "first_filtered_frame_ms=%.1f restored=%d\n",
+        startupProfiler.ElapsedMs(), restoredFromSession ? 1 : 0);
+    OutputDebugStringA(report);
+}
 
-    configFile << "# Global hotkey to toggle pin/click-through mode\n";
-    configFile << "GlobalHotkeyKey=P\n";
-    configFile << "# Modifier keys: CTRL, SHIFT, ALT, WIN (combine with +)\n";
-    configFile << "GlobalHotkeyModifiers=CTRL+SHIFT\n\n";
+//
+// FUNCTION: WriteStartupBenchmark()
+//
+// PURPOSE: With /benchmark-startup, appends per-phase timings and the time to the first filtered
+//          frame to startup_benchmark.txt, then exits.
+//
+void WriteStartupBenchmark()
+{
+    startupBenchmarkWritten = TRUE;
 
-    configFile << "# Note: Restart the application after changing these settings\n";
-    configFile << "# Rectangle Save/Load: 0=cycle through saved, 1-9=load saved, Ctrl+1-9=save current (Ctrl+0 disabled)\n";
+    std::ofstream benchmarkFile("startup_benchmark.txt", std::ios::app);
+    benchmarkFile << "# run restored=" << (restoredFromSession ? 1 : 0) << "\n";
+    startupProfiler.Write(benchmarkFile);
+    benchmarkFile.close();
 
-    configFile.close();
+    PostQuitMessage(0);
 }
 
 //
-// FUNCTION: ApplyDarkModeToWindow()
+// FUNCTION: ResolveSavedRectangle()
 //
-// PURPOSE: Applies dark mode theming to the window title bar and frame.
+// PURPOSE: Computes the window bounds for a saved entry against the current monitor layout.
 //
-void ApplyDarkModeToWindow(HWND hwnd)
+BOOL ResolveSavedRectangle(const SavedRectEntry& entry, RECT& windowRect)
 {
-    // Enable dark mode for the title bar
-    BOOL darkMode = TRUE;
-    DwmSetWindowAttribute(hwnd, DWMWA_USE_IMMERSIVE_DARK_MODE, &darkMode, sizeof(darkMode));
+    if (!entry.hasPlacement)
+    {
+        // Saved by an older version: only raw screen pixels are available
+        windowRect = entry.rect;
+        return TRUE;
+    }
 
-    // Set dark title bar color (optional, requires Windows 11 22000+)
-    COLORREF darkTitleBar = RGB(32, 32, 32);
-    DwmSetWindowAttribute(hwnd, DWMWA_CAPTION_COLOR, &darkTitleBar, sizeof(darkTitleBar));
+    // The raw rectangle picks the nearest monitor if the saved one has been disconnected
+    RECT savedClientRect;
+    WindowRectToClientRect(entry.rect, savedClientRect);
 
-    // Set dark border color
-    COLORREF darkBorder = RGB(64, 64, 64);
-    DwmSetWindowAttribute(hwnd, DWMWA_BORDER_COLOR, &darkBorder, sizeof(darkBorder));
+    RECT clientRect;
+    monitorLayout.Refresh();
+    if (!monitorLayout.Resolve(entry.placement, &savedClientRect, clientRect))
+        return FALSE;
+
+    ClientRectToWindowRect(clientRect, windowRect);
+    return TRUE;
 }
 
 //
-// FUNCTION: HostWndProc()
+// FUNCTION: WindowRectToClientRect()
 //
-// PURPOSE: Window procedure for the window that hosts the screen filter control.
+// PURPOSE: Converts host window bounds (including borders and title bar) to client area bounds.
 //
-LRESULT CALLBACK HostWndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
+void WindowRectToClientRect(const RECT& windowRect, RECT& clientRect)
 {
-    switch (message)
-    {
-    case WM_NCHITTEST:
-    {
-        // After selection is complete, make client area transparent to clicks
-        if (selectionState == SELECTION_COMPLETE)
-        {
-            LRESULT hitTest = DefWindowProc(hWnd, message, wParam, lParam);
+    LONG titleBarHeight = GetSystemMetrics(SM_CYCAPTION);
+    LONG borderWidth = GetSystemMetrics(SM_CXSIZEFRAME);
+    LONG borderHeight = GetSystemMetrics(SM_CYSIZEFRAME);
 
-            // Only make the client area transparent, keep frame elements interactive
-            if (hitTest == HTCLIENT)
-            {
-                return HTTRANSPARENT;
+    clientRect.left = windowRect.left + borderWidth;
+    clientRect.top = windowRect.top + titleBarHeight + borderHeight;
+    clientRect.right = windowRect.right - borderWidth;
+    clientRect.bottom = windowRect.bottom - borderHeight;
+}
+
+//
+// FUNCTION: ClientRectToWindowRect()
+//
+// PURPOSE: Converts client area bounds to the host window bounds needed to achieve them.
+//
+void ClientRectToWindowRect(const RECT& clientRect, RECT& windowRect)
+{
+    LONG titleBarHeight = GetSystemMetrics(SM_CYCAPTION);
+    LONG borderWidth = GetSystemMetrics(SM_CXSIZEFRAME);
+    LONG borderHeight = GetSystemMetrics(SM_CYSIZEFRAME);
+
+    windowRect.left = clientRect.left - borderWidth;
+    windowRect.top = clientRect.top - titleBarHeight - borderHeight;
+    windowRect.right = clientRect.right + borderWidth;
+    windowRect.bottom = clientRect.bottom + borderHeight;
+}
+
+//
+// FUNCTION: ApplyLoadedRectangle()
+//
+// PURPOSE: Applies a loaded rectangle, completing the selection process.
+//
+void ApplyLoadedRectangle(const RECT& rect)
+{
+    // The loaded rectangle is a full window rectangle (including borders and title bar).
+    // Only the window calls that change something are made, e.g. none for the current position.
+    windowRegion.Dispatch(RegionEvent::Load(rect));
+    ApplyColorEffects();
+
+    // Update title to show that a rectangle was loaded
+    TCHAR instructionText[256];
+    _stprintf_s(instructionText, 256,
+        TEXT("Screen Filter - Area Loaded (%hs=Invert, %hs=Grayscale, %hs=White Level, Ctrl+1-9=Save)"),
+        FormatKeyChord(shortcuts.toggleInvert).c_str(), FormatKeyChord(shortcuts.toggleGrayscale).c_str(),
+        FormatKeyChord(shortcuts.cycleWhiteLevel).c_str());
+    SetHostTitle(instructionText);
+}
+
+//
+// FUNCTION: LoadShortcutConfig()
+//
+// PURPOSE: Loads shortcut configuration from file, creates default if not found.
+//
+void LoadShortcutConfig(std::vector<ConfigError>& errors)
+{
+    TraceScope scope(tracer, "LoadShortcutConfig", "io");
+    if (!LoadShortcutConfigFile(ShortcutConfig::CONFIG_FILE, shortcuts, errors))
+    {
+        // File doesn't exist, create default configuration
+        SaveDefaultShortcutConfigFile(ShortcutConfig::CONFIG_FILE);
+    }
+
+    // Whatever is on disk now has been applied
+    shortcutConfigWatcher.Reset();
+}
+
+//
+// FUNCTION: CheckShortcutConfig()
+//
+// PURPOSE: Reloads the shortcut configuration once an edit to the file has settled. Called from the
+//          timer wheel; schedules the next check.
+//
+void CheckShortcutConfig(void* /*context*/)
+{
+    if (shortcutConfigWatcher.Poll(std::chrono::steady_clock::now()))
+    {
+        ReloadShortcutConfig();
+    }
+    timers.Schedule(GetTickCount64(), configWatchInterval, CheckShortcutConfig, NULL);
+}
+
+//
+// FUNCTION: ReloadShortcutConfig()
+//
+// PURPOSE: Re-reads the shortcut configuration and applies only what changed.
+//
+void ReloadShortcutConfig()
+{
+    // Settings missing from the file fall back to their defaults; invalid ones keep the current binding
+    TraceScope scope(tracer, "ReloadShortcutConfig", "io");
+    ShortcutConfig updated;
+    std::vector<ConfigError> errors;
+    if (!ReloadShortcutConfigFile(ShortcutConfig::CONFIG_FILE, shortcuts, updated, errors))
+    {
+        // Deleted or locked mid-save; keep the current settings
+        return;
+    }
+
+    configReloads.Increment();
+    int changes = DiffShortcutConfig(shortcuts, updated);
+
+    // Only touch the global hotkey registration when it actually changed
+    if (changes & SHORTCUT_CHANGE_GLOBAL_HOTKEY)
+    {
+        UnregisterHotKey(hwndHost, HOTKEY_TOGGLE_PIN);
+        if (!RegisterHotKey(hwndHost, HOTKEY_TOGGLE_PIN, updated.globalHotkey.modifiers, updated.globalHotkey.key))
+        {
+            errors.push_back({ 0, FormatKeyChord(updated.globalHotkey) + " is already in use by another application" });
+            updated.globalHotkey = shortcuts.globalHotkey;
+            RegisterHotKey(hwndHost, HOTKEY_TOGGLE_PIN, shortcuts.globalHotkey.modifiers, shortcuts.globalHotkey.key);
+        }
+    }
+
+    shortcuts = updated;
+
+    if (inputRecorder.IsOpen())
+    {
+        InputLogRecord record(INPUT_LOG_SHORTCUTS, 0);
+        record.shortcuts = shortcuts;
+        RecordInput(record);
+    }
+
+    if (!errors.empty())
+    {
+        ShowConfigErrors(errors);
+    }
+    else if (changes != SHORTCUT_CHANGE_NONE)
+    {
+        // The title lists the key bindings
+        RestoreTitle();
+    }
+}
+
+//
+// FUNCTION: ShowConfigErrors()
+//
+// PURPOSE: Shows the first shortcut configuration error in the title bar for a few seconds.
+//
+void ShowConfigErrors(const std::vector<ConfigError>& errors)
+{
+    if (errors.empty())
+        return;
+
+    const ConfigError& first = errors.front();
+    std::string location = first.line > 0 ? " line " + std::to_string(first.line) : "";
+    std::string more = errors.size() > 1 ? " (+" + std::to_string(errors.size() - 1) + " more)" : "";
+
+    TCHAR message[256];
+    _stprintf_s(message, 256, TEXT("Screen Filter - %hs%hs: %hs%hs"),
+        ShortcutConfig::CONFIG_FILE, location.c_str(), first.message.c_str(), more.c_str());
+    ShowTemporaryTitle(message, 5000);
+}
+
+//
+// FUNCTION: RestoreTitle()
+//
+// PURPOSE: Restores the normal title for the current selection state after a temporary message.
+//
+void RestoreTitle()
+{
+    if (windowRegion.IsSelectionComplete())
+    {
+        UpdateTitle(); // Restore the status title
+    }
+    else if (windowRegion.GetState().selection == SELECTION_NONE)
+    {
+        SetHostTitle(WindowTitle);
+    }
+}
+
+//
+// FUNCTION: ShowTemporaryTitle()
+//
+// PURPOSE: Shows a message in the title bar, restoring the normal title after the given time.
+//          Replaces any earlier message still showing, along with its pending reset.
+//
+void ShowTemporaryTitle(LPCTSTR message, UINT durationMs)
+{
+    SetHostTitle(message);
+    timers.Reschedule(titleResetTimer, GetTickCount64(), durationMs, [](void*) { RestoreTitle(); }, NULL);
+}
+
+//
+// FUNCTION: ApplyDarkModeToWindow()
+//
+// PURPOSE: Applies dark mode theming to the window title bar and frame.
+//
+void ApplyDarkModeToWindow(HWND hwnd)
+{
+    // Enable dark mode for the title bar
+    BOOL darkMode = TRUE;
+    DwmSetWindowAttribute(hwnd, DWMWA_USE_IMMERSIVE_DARK_MODE, &darkMode, sizeof(darkMode));
+
+    // Set dark title bar color (optional, requires Windows 11 22000+)
+    COLORREF darkTitleBar = RGB(32, 32, 32);
+    DwmSetWindowAttribute(hwnd, DWMWA_CAPTION_COLOR, &darkTitleBar, sizeof(darkTitleBar));
+
+    // Set dark border color
+    COLORREF darkBorder = RGB(64, 64, 64);
+    DwmSetWindowAttribute(hwnd, DWMWA_BORDER_COLOR, &darkBorder, sizeof(darkBorder));
+}
+
+//
+// FUNCTION: GetCurrentModifiers()
+//
+// PURPOSE: Returns the MOD_* flags for the modifier keys currently held down.
+//
+UINT GetCurrentModifiers()
+{
+    UINT modifiers = 0;
+    if (GetKeyState(VK_CONTROL) & 0x8000)
+        modifiers |= MOD_CONTROL;
+    if (GetKeyState(VK_SHIFT) & 0x8000)
+        modifiers |= MOD_SHIFT;
+    if (GetKeyState(VK_MENU) & 0x8000)
+        modifiers |= MOD_ALT;
+    if ((GetKeyState(VK_LWIN) | GetKeyState(VK_RWIN)) & 0x8000)
+        modifiers |= MOD_WIN;
+    return modifiers;
+}
+
+//
+// FUNCTION: MatchesChord()
+//
+// PURPOSE: Checks whether a key press, with the modifiers currently held, matches a configured chord.
+//
+BOOL MatchesChord(const KeyChord& chord, WPARAM key)
+{
+    return key == chord.key && GetCurrentModifiers() == chord.modifiers;
+}
+
+//
+// FUNCTION: HandleEffectShortcut()
+//
+// PURPOSE: Applies the color effect bound to a key press. Returns FALSE if no shortcut matches.
+//
+BOOL HandleEffectShortcut(WPARAM key)
+{
+    // Applied by the next frame, together with any other presses before it
+    if (effects.Queue(EffectActionForKey(shortcuts, static_cast<UINT>(key), GetCurrentModifiers())))
+    {
+        effectToggles.Increment();
+        return TRUE;
+    }
+
+    if (MatchesChord(shortcuts.toggleMetricsOverlay, key))
+    {
+        metricsOverlayEnabled = !metricsOverlayEnabled;
+        SampleMetricsOverlay();
+        UpdateTitle();
+        return TRUE;
+    }
+
+    if (MatchesChord(shortcuts.toggleTrace, key))
+    {
+        ToggleTracing();
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+//
+// FUNCTION: HostWndProc()
+//
+// PURPOSE: Window procedure for the window that hosts the screen filter control.
+//
+LRESULT CALLBACK HostWndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
+{
+    TraceScope scope(tracer, MessageName(message), "message", "msg", message);
+
+    switch (message)
+    {
+    case WM_NCHITTEST:
+    {
+        // After selection is complete, make client area transparent to clicks
+        if (windowRegion.IsSelectionComplete())
+        {
+            LRESULT hitTest = DefWindowProc(hWnd, message, wParam, lParam);
+
+            // Only make the client area transparent, keep frame elements interactive
+            if (hitTest == HTCLIENT)
+            {
+                return HTTRANSPARENT;
             }
 
             return hitTest;
@@ -555,7 +1303,7 @@ LRESULT CALLBACK HostWndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lPar
 
     case WM_LBUTTONDOWN:
     {
-        if (selectionState != SELECTION_COMPLETE)
+        if (!windowRegion.IsSelectionComplete())
         {
             POINT clickPoint;
             clickPoint.x = GET_X_LPARAM(lParam);
@@ -564,22 +1312,30 @@ LRESULT CALLBACK HostWndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lPar
             // Convert to screen coordinates
             ClientToScreen(hWnd, &clickPoint);
 
+            if (inputRecorder.IsOpen())
+            {
+                InputLogRecord record(INPUT_LOG_CLICK, 0);
+                record.point = clickPoint;
+                RecordInput(record);
+            }
+
             HandleRectangleSelection(clickPoint);
+            RecordInputState();
         }
     }
     break;
 
     case WM_KEYDOWN:
     {
+        RecordKeyInput(INPUT_LOG_KEY, wParam);
+
         // Check for Ctrl key state
         BOOL ctrlPressed = GetKeyState(VK_CONTROL) & 0x8000;
 
         if (wParam == shortcuts.escapeKey)
         {
-            if (isFullScreen)
-            {
-                GoPartialScreen();
-            }
+            // Nothing to do unless full screen
+            GoPartialScreen();
         }
         // Cycle through saved rects
         else if (wParam == '0') {
@@ -590,43 +1346,42 @@ LRESULT CALLBACK HostWndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lPar
         {
             int slot = static_cast<int>(wParam) - '0';
 
-            if (ctrlPressed && selectionState == SELECTION_COMPLETE)
+            if (ctrlPressed && windowRegion.IsSelectionComplete())
             {
                 // Save current rectangle to slot
                 SaveCurrentRectangle(slot);
             }
-            else if (!ctrlPressed && (selectionState == SELECTION_NONE || selectionState == SELECTION_COMPLETE))
+            else if (!ctrlPressed && windowRegion.GetState().selection != SELECTION_FIRST_POINT)
             {
                 // Load rectangle from slot
                 LoadRectangle(slot);
             }
         }
-        else if (selectionState == SELECTION_COMPLETE)
+        else if (windowRegion.IsSelectionComplete())
         {
             // Use configurable shortcuts after selection is complete
-            if (wParam == shortcuts.toggleInvertKey)
-            {
-                inversionEnabled = !inversionEnabled;
-                ApplyColorEffects();
-            }
-            else if (wParam == shortcuts.toggleGrayscaleKey)
-            {
-                grayscaleEnabled = !grayscaleEnabled;
-                ApplyColorEffects();
-            }
-            else if (wParam == shortcuts.cycleWhiteLevelKey)
-            {
-                grayLevel = (grayLevel + 1) % 4;
-                ApplyColorEffects();
-            }
+            HandleEffectShortcut(wParam);
         }
+
+        RecordInputState();
     }
     break;
 
+    case WM_SYSKEYDOWN:
+        RecordKeyInput(INPUT_LOG_SYSKEY, wParam);
+
+        // Chords including Alt arrive as system keys; anything else keeps default handling (e.g. Alt+F4)
+        if (!windowRegion.IsSelectionComplete() || !HandleEffectShortcut(wParam))
+        {
+            return DefWindowProc(hWnd, message, wParam, lParam);
+        }
+        RecordInputState();
+        break;
+
     case WM_SETFOCUS:
         // Track the previous foreground window when we gain focus
         // (This will be used to restore focus when pinning)
-        if (!isPinned) {
+        if (!windowRegion.GetState().pinned) {
             HWND currentForeground = GetForegroundWindow();
             if (currentForeground != hWnd) {
                 previousForegroundWindow = currentForeground;
@@ -635,22 +1390,22 @@ LRESULT CALLBACK HostWndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lPar
         return DefWindowProc(hWnd, message, wParam, lParam);
 
     case WM_HOTKEY:
-        if (wParam == HOTKEY_TOGGLE_PIN && selectionState == SELECTION_COMPLETE)
+        if (inputRecorder.IsOpen())
         {
-            // Toggle pin state
-            isPinned = !isPinned;
+            InputLogRecord record(INPUT_LOG_HOTKEY, 0);
+            record.key = static_cast<UINT>(wParam);
+            RecordInput(record);
+        }
 
-            // Update the window's extended style based on pin state
-            LONG exStyle = GetWindowLong(hWnd, GWL_EXSTYLE);
+        // Toggle pin state; WS_EX_TRANSPARENT makes the window click-through while pinned
+        if (wParam == HOTKEY_TOGGLE_PIN && windowRegion.Dispatch(RegionEvent(REGION_TOGGLE_PIN)) != REGION_ACTION_NONE)
+        {
+            BOOL isPinned = windowRegion.GetState().pinned;
             if (isPinned)
             {
                 // Store current foreground window before pinning
                 previousForegroundWindow = GetForegroundWindow();
 
-                // Add WS_EX_TRANSPARENT when pinned - window becomes click-through
-                exStyle |= WS_EX_TRANSPARENT;
-                SetWindowLong(hWnd, GWL_EXSTYLE, exStyle);
-
                 // Find window underneath mouse cursor and give it focus
                 POINT cursorPos;
                 GetCursorPos(&cursorPos);
@@ -674,23 +1429,26 @@ LRESULT CALLBACK HostWndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lPar
             }
             else
             {
-                // Remove WS_EX_TRANSPARENT when unpinned - window becomes interactive
-                exStyle &= ~WS_EX_TRANSPARENT;
-                SetWindowLong(hWnd, GWL_EXSTYLE, exStyle);
-
                 // Restore focus to our window when unpinning
                 SetForegroundWindow(hWnd);
             }
 
+            pinnedGauge.Set(isPinned ? 1.0 : 0.0);
+            hotkeyToggles.Increment();
+
             // Update window title to show current pin state
-            ApplyColorEffects(); // This will update the title
+            UpdateTitle();
+            RecordInputState();
         }
         break;
 
     case WM_SYSCOMMAND:
-        if (GET_SC_WPARAM(wParam) == SC_MAXIMIZE)
+        // The window is already maximized during selection
+        if (GET_SC_WPARAM(wParam) == SC_MAXIMIZE && windowRegion.IsSelectionComplete())
         {
+            RecordInput(InputLogRecord(INPUT_LOG_MAXIMIZE, 0));
             GoFullScreen();
+            RecordInputState();
         }
         else
         {
@@ -698,9 +1456,41 @@ LRESULT CALLBACK HostWndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lPar
         }
         break;
 
+    case WM_CLOSE:
+        // Closing the window deliberately removes the region from the next session
+        sessionRegionClosed = TRUE;
+        if (sessionRegionId >= 0 && !benchmarkStartup)
+        {
+            TraceScope scope(tracer, "SessionSnapshot::RemoveRegion", "io");
+            session.RemoveRegionPreservingExisting(sessionRegionId);
+        }
+        return DefWindowProc(hWnd, message, wParam, lParam);
+
+    case WM_ENDSESSION:
+        // Logging off or shutting down: keep the region for the next session
+        if (wParam)
+        {
+            WriteSessionSnapshot(TRUE);
+        }
+        break;
+
     case WM_DESTROY:
+        if (!sessionRegionClosed)
+        {
+            WriteSessionSnapshot(FALSE);
+        }
+
+        // Keep a trace that was still running
+        if (tracer.IsEnabled())
+        {
+            WriteTraceFile();
+        }
+
         // Unregister the global hotkey
         UnregisterHotKey(hwndHost, HOTKEY_TOGGLE_PIN);
+
+        // Scripts waiting on the window get their answer now rather than at the timeout
+        FailControlBatches();
         PostQuitMessage(0);
         break;
 
@@ -716,6 +1506,30 @@ LRESULT CALLBACK HostWndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lPar
         }
         break;
 
+    case WM_CONTROL_BATCH:
+        ExecuteControlBatches();
+        break;
+
+    case WM_PAINT:
+    {
+        PAINTSTRUCT paint;
+        HDC dc = BeginPaint(hWnd, &paint);
+        if (cpuFrameShown)
+        {
+            PaintCpuFrame(dc);
+        }
+        EndPaint(hWnd, &paint);
+    }
+    break;
+
+    case WM_ERASEBKGND:
+        // The CPU output covers the client area; erasing first would flicker
+        if (cpuFrameShown)
+        {
+            return 1;
+        }
+        return DefWindowProc(hWnd, message, wParam, lParam);
+
     case WM_WINDOWPOSCHANGED:
         if (hwndMag != NULL)
         {
@@ -764,13 +1578,11 @@ ATOM RegisterHostWindowClass(HINSTANCE hInstance)
 BOOL SetupScreenFilter(HINSTANCE hinst)
 {
     // Set bounds of host window to full screen initially
-    int width = GetSystemMetrics(SM_CXSCREEN);
-    int height = GetSystemMetrics(SM_CYSCREEN);
-
+    RECT hostWindowRect;
     hostWindowRect.top = 0;
-    hostWindowRect.bottom = height;
+    hostWindowRect.bottom = GetSystemMetrics(SM_CYSCREEN);
     hostWindowRect.left = 0;
-    hostWindowRect.right = width;
+    hostWindowRect.right = GetSystemMetrics(SM_CXSCREEN);
 
     // Create the host window.
     RegisterHostWindowClass(hinst);
@@ -821,222 +1633,594 @@ BOOL SetupScreenFilter(HINSTANCE hinst)
 //
 // FUNCTION: HandleRectangleSelection()
 //
-// PURPOSE: Handles the two-point rectangle selection process.
+// PURPOSE: Handles the two-point rectangle selection process. The second point resizes the
+//          window to the selected rectangle (see RegionStateMachine).
 //
 void HandleRectangleSelection(POINT clickPoint)
 {
-    switch (selectionState)
+    switch (windowRegion.Dispatch(RegionEvent::Click(clickPoint)))
     {
-    case SELECTION_NONE:
-        firstPoint = clickPoint;
-        selectionState = SELECTION_FIRST_POINT;
-        SetWindowText(hwndHost, TEXT("Screen Filter - Click second point"));
+    case REGION_ACTION_FIRST_POINT:
+        SetHostTitle(TEXT("Screen Filter - Click second point"));
         break;
 
-    case SELECTION_FIRST_POINT:
-        secondPoint = clickPoint;
-        selectionState = SELECTION_COMPLETE;
-
-        // Calculate the selected rectangle
-        selectedRect.left = min(firstPoint.x, secondPoint.x);
-        selectedRect.top = min(firstPoint.y, secondPoint.y);
-        selectedRect.right = max(firstPoint.x, secondPoint.x);
-        selectedRect.bottom = max(firstPoint.y, secondPoint.y);
-
-        // Ensure minimum size
-        if ((selectedRect.right - selectedRect.left) < 100)
-            selectedRect.right = selectedRect.left + 100;
-        if ((selectedRect.bottom - selectedRect.top) < 100)
-            selectedRect.bottom = selectedRect.top + 100;
-
-        ResizeToSelectedRectangle();
+    case REGION_ACTION_SELECT:
+    {
+        // Apply initial color effects (start with inversion enabled by default)
+        ColorEffectSettings initialSettings = effects.GetSettings();
+        initialSettings.inversionEnabled = true;
+        effects.SetSettings(initialSettings);
         ApplyColorEffects();
 
         // Create shortcut instruction text with current key bindings
         TCHAR instructionText[256];
         _stprintf_s(instructionText, 256,
-            TEXT("Screen Filter - Area Selected (%c=Invert, %c=Grayscale, %c=White Level, Ctrl+1-9=Save)"),
-            shortcuts.toggleInvertKey, shortcuts.toggleGrayscaleKey, shortcuts.cycleWhiteLevelKey);
-        SetWindowText(hwndHost, instructionText);
+            TEXT("Screen Filter - Area Selected (%hs=Invert, %hs=Grayscale, %hs=White Level, Ctrl+1-9=Save)"),
+            FormatKeyChord(shortcuts.toggleInvert).c_str(), FormatKeyChord(shortcuts.toggleGrayscale).c_str(),
+            FormatKeyChord(shortcuts.cycleWhiteLevel).c_str());
+        SetHostTitle(instructionText);
+        break;
+    }
+
+    default:
         break;
     }
 }
 
 //
-// FUNCTION: ResizeToSelectedRectangle()
+// FUNCTION: CalculateColorMatrix()
 //
-// PURPOSE: Resizes the application window to match the selected rectangle.
+// PURPOSE: Copies the color transformation matrix the magnifier should show now: the one for the
+//          current settings (see EffectController.cpp), or a step of the transition towards it.
 //
-void ResizeToSelectedRectangle()
+void CalculateColorMatrix(MAGCOLOREFFECT* matrix)
 {
-    if (selectionState != SELECTION_COMPLETE)
-        return;
-
-    // Calculate the desired client area size (the actual magnified content area)
-    int clientWidth = selectedRect.right - selectedRect.left;
-    int clientHeight = selectedRect.bottom - selectedRect.top;
-
-    // Get the window frame dimensions
-    LONG titleBarHeight = GetSystemMetrics(SM_CYCAPTION);
-    LONG borderWidth = GetSystemMetrics(SM_CXSIZEFRAME);
-    LONG borderHeight = GetSystemMetrics(SM_CYSIZEFRAME);
-
-    // Calculate the total window size needed to achieve the desired client area
-    int windowWidth = clientWidth + (2 * borderWidth);
-    int windowHeight = clientHeight + titleBarHeight + (2 * borderHeight);
-
-    // Calculate window position so that the CLIENT area matches the selected rectangle
-    int windowX = selectedRect.left - borderWidth;
-    int windowY = selectedRect.top - titleBarHeight - borderHeight;
-
-    // First, ensure the window is in normal (not maximized) state
-    ShowWindow(hwndHost, SW_RESTORE);
-
-    // Update host window rect for future reference (store the actual window bounds)
-    hostWindowRect.left = windowX;
-    hostWindowRect.top = windowY;
-    hostWindowRect.right = windowX + windowWidth;
-    hostWindowRect.bottom = windowY + windowHeight;
-
-    // Remove the maximized state and set normal window styles
-    SetWindowLong(hwndHost, GWL_STYLE, RESTOREDWINDOWSTYLES);
-
-    // Resize and reposition the window
-    SetWindowPos(hwndHost, HWND_TOPMOST,
-        windowX, windowY, windowWidth, windowHeight,
-        SWP_SHOWWINDOW | SWP_NOACTIVATE | SWP_FRAMECHANGED);
-
-    // Reapply dark mode after style changes
-    ApplyDarkModeToWindow(hwndHost);
-
-    // Apply initial color effects (start with inversion enabled by default)
-    inversionEnabled = TRUE;
-    ApplyColorEffects();
-
-    // Make the window layered and the client area click-through
-    SetWindowLong(hwndHost, GWL_EXSTYLE,
-        GetWindowLong(hwndHost, GWL_EXSTYLE) | WS_EX_LAYERED);
+    static_assert(sizeof(MAGCOLOREFFECT) == sizeof(ColorMatrix), "ColorMatrix must match MAGCOLOREFFECT");
 
-    // Make the window opaque now that rectangle is selected
-    SetLayeredWindowAttributes(hwndHost, 0, 255, LWA_ALPHA);
+    memcpy(matrix, &effectTransition.GetMatrix(), sizeof(MAGCOLOREFFECT));
 }
 
 //
-// FUNCTION: CalculateColorMatrix()
+// FUNCTION: ApplyEntryEffects()
 //
-// PURPOSE: Calculates the color transformation matrix based on current settings.
+// PURPOSE: Takes over the color effect settings stored with a saved rectangle or session region.
+//          The caller applies them to the magnifier.
 //
-void CalculateColorMatrix(MAGCOLOREFFECT* matrix)
+void ApplyEntryEffects(const SavedRectEntry& entry)
 {
-    // Initialize identity matrix
-    memset(matrix, 0, sizeof(MAGCOLOREFFECT));
-    matrix->transform[0][0] = 1.0f; // Red
-    matrix->transform[1][1] = 1.0f; // Green  
-    matrix->transform[2][2] = 1.0f; // Blue
-    matrix->transform[3][3] = 1.0f; // Alpha
-    matrix->transform[4][4] = 1.0f; // Translation
-
-    // Apply grayscale conversion if enabled
-    if (grayscaleEnabled)
-    {
-        // Luminance weights for RGB to grayscale conversion
-        float rWeight = 0.299f;
-        float gWeight = 0.587f;
-        float bWeight = 0.114f;
+    effects.SetSettings(GetEntryEffects(entry));
+}
 
-        // Set all RGB channels to use the same luminance calculation
-        matrix->transform[0][0] = rWeight; matrix->transform[0][1] = rWeight; matrix->transform[0][2] = rWeight;
-        matrix->transform[1][0] = gWeight; matrix->transform[1][1] = gWeight; matrix->transform[1][2] = gWeight;
-        matrix->transform[2][0] = bWeight; matrix->transform[2][1] = bWeight; matrix->transform[2][2] = bWeight;
-    }
+//
+// FUNCTION: GetEntryEffects()
+//
+// PURPOSE: The color effect settings stored with a saved rectangle or session region.
+//
+ColorEffectSettings GetEntryEffects(const SavedRectEntry& entry)
+{
+    ColorEffectSettings settings;
+    settings.inversionEnabled = entry.inversionEnabled;
+    settings.grayscaleEnabled = entry.grayscaleEnabled;
+    settings.grayLevel = entry.grayLevel;
+    settings.visionMode = entry.visionMode;
+    settings.visionSeverity = entry.visionSeverity;
+    settings.colorTemperature = entry.colorTemperature;
+    settings.sharpenLevel = entry.sharpenLevel;
+    settings.privacyEffect = entry.privacyEffect;
+    settings.blurRadius = entry.blurRadius;
+    settings.pixelateBlock = entry.pixelateBlock;
+    settings.binarizeEnabled = entry.binarizeEnabled;
+    settings.binarizeWindow = entry.binarizeWindow;
+    settings.autoInvert = entry.autoInvert;
+    settings.smartInvert = entry.smartInvert;
+    return settings;
+}
 
-    // Apply inversion if enabled
-    if (inversionEnabled)
-    {
-        // Invert RGB channels
-        matrix->transform[0][0] *= -1.0f; matrix->transform[0][1] *= -1.0f; matrix->transform[0][2] *= -1.0f;
-        matrix->transform[1][0] *= -1.0f; matrix->transform[1][1] *= -1.0f; matrix->transform[1][2] *= -1.0f;
-        matrix->transform[2][0] *= -1.0f; matrix->transform[2][1] *= -1.0f; matrix->transform[2][2] *= -1.0f;
+//
+// FUNCTION: ApplyColorEffects()
+//
+// PURPOSE: Applies the current color effect settings to the magnifier, unless it already shows
+//          them or the selection is not complete yet.
+//
+void ApplyColorEffects()
+{
+    windowRegion.SyncEffects(effects.GetGeneration());
+}
 
-        // Add inversion offset
-        matrix->transform[4][0] = 1.0f; // Red offset
-        matrix->transform[4][1] = 1.0f; // Green offset
-        matrix->transform[4][2] = 1.0f; // Blue offset
+//
+// FUNCTION: UpdateTitle()
+//
+// PURPOSE: Shows the current settings and key bindings in the title bar, followed by
+//          the metrics overlay when it is enabled. Within titleUpdateInterval of the last
+//          rewrite, the update is left to the frame timer.
+//
+void UpdateTitle()
+{
+    if (titleLimiter.Request(GetTickCount64()))
+    {
+        WriteStatusTitle();
     }
+}
 
-    // Apply gray level scaling (brightness reduction)
-    float grayLevels[] = { 1.0f, 0.8f, 0.6f, 0.4f }; // 100%, 80%, 60%, 40%
-    float scale = grayLevels[grayLevel];
+//
+// FUNCTION: WriteStatusTitle()
+//
+// PURPOSE: Formats and sets the status title now (see UpdateTitle()).
+//
+void WriteStatusTitle()
+{
+    TCHAR titleText[320];
 
-    if (scale != 1.0f)
+    if (windowRegion.GetState().pinned)
     {
-        // Scale RGB channels
-        matrix->transform[0][0] *= scale; matrix->transform[0][1] *= scale; matrix->transform[0][2] *= scale;
-        matrix->transform[1][0] *= scale; matrix->transform[1][1] *= scale; matrix->transform[1][2] *= scale;
-        matrix->transform[2][0] *= scale; matrix->transform[2][1] *= scale; matrix->transform[2][2] *= scale;
-
-        // Scale translation components if inversion is enabled
-        if (inversionEnabled)
+        // When pinned, show unpin instructions using configured hotkey
+        _stprintf_s(titleText, 320, TEXT("Filter - %hs to unpin window"),
+            FormatKeyChord(shortcuts.globalHotkey).c_str());
+    }
+    else
+    {
+        // When not pinned, show normal color/inversion status
+        const ColorEffectSettings& settings = effects.GetSettings();
+        char modeText[64] = "";
+        if (settings.visionMode != VISION_NORMAL)
+        {
+            sprintf_s(modeText, sizeof(modeText), "%s %d%% ", VisionModeName(settings.visionMode),
+                settings.visionSeverity * 100 / (NUM_VISION_SEVERITIES - 1));
+        }
+        if (settings.colorTemperature != COLOR_TEMPERATURE_NEUTRAL)
+        {
+            size_t length = strlen(modeText);
+            sprintf_s(modeText + length, sizeof(modeText) - length, "%dK ", settings.colorTemperature);
+        }
+        if (settings.sharpenLevel > 0)
+        {
+            size_t length = strlen(modeText);
+            sprintf_s(modeText + length, sizeof(modeText) - length, "Sharp %.0f%% ", SharpenStrengths[settings.sharpenLevel] * 100.0f);
+        }
+        if (settings.privacyEffect != PRIVACY_NONE)
+        {
+            size_t length = strlen(modeText);
+            sprintf_s(modeText + length, sizeof(modeText) - length, "%s %dpx ", PrivacyEffectName(settings.privacyEffect),
+                settings.privacyEffect == PRIVACY_BLUR ? settings.blurRadius : settings.pixelateBlock);
+        }
+        if (settings.binarizeEnabled)
         {
-            matrix->transform[4][0] *= scale;
-            matrix->transform[4][1] *= scale;
-            matrix->transform[4][2] *= scale;
+            size_t length = strlen(modeText);
+            sprintf_s(modeText + length, sizeof(modeText) - length, "Binary %dpx ", settings.binarizeWindow);
         }
+        if (settings.autoInvert)
+        {
+            size_t length = strlen(modeText);
+            sprintf_s(modeText + length, sizeof(modeText) - length, "Auto ");
+        }
+        if (settings.smartInvert)
+        {
+            size_t length = strlen(modeText);
+            sprintf_s(modeText + length, sizeof(modeText) - length, "Smart ");
+        }
+        _stprintf_s(titleText, 320, TEXT("Filter - %s%s%hsGray:%.0f%% (%hs=Invert, %hs=Colour, %hs=White level, %hs=Vision, Ctrl+1-9=Save)"),
+            settings.inversionEnabled ? TEXT("Inverted ") : TEXT(""),
+            settings.grayscaleEnabled ? TEXT("Grayscale ") : TEXT("Color "),
+            modeText,
+            GrayLevelScales[settings.grayLevel] * 100.0f,
+            FormatKeyChord(shortcuts.toggleInvert).c_str(), FormatKeyChord(shortcuts.toggleGrayscale).c_str(),
+            FormatKeyChord(shortcuts.cycleWhiteLevel).c_str(), FormatKeyChord(shortcuts.cycleVisionMode).c_str());
+    }
+
+    if (metricsOverlayEnabled)
+    {
+        // The overlay goes first so it survives a narrow title bar truncating the text
+        TCHAR overlayText[384];
+        _stprintf_s(overlayText, 384, TEXT("[%.0f fps, %.1f effects/s, %.1f titles/s] %s"),
+            overlayFrameRate, overlayEffectRate, overlayTitleRate, titleText);
+        lastStatusTitle = overlayText;
     }
+    else
+    {
+        lastStatusTitle = titleText;
+    }
+
+    SetHostTitle(lastStatusTitle.c_str());
 }
 
 //
-// FUNCTION: ApplyColorEffects()
+// FUNCTION: SetHostTitle()
 //
-// PURPOSE: Applies the current color effect settings to the magnifier.
+// PURPOSE: Sets the host window title. All title changes go through here so they are counted.
 //
-void ApplyColorEffects()
+void SetHostTitle(LPCTSTR text)
 {
-    MAGCOLOREFFECT matrix;
-    CalculateColorMatrix(&matrix);
+    TraceScope scope(tracer, "SetWindowText", "title");
+    titleUpdates.Increment();
+    SetWindowText(hwndHost, text);
 
-    BOOL ret = MagSetColorEffect(hwndMag, &matrix);
-    if (ret)
+    // A message replacing the status must not be overwritten by a deferred status update
+    if (lastStatusTitle != text)
     {
-        colorEffectsApplied = TRUE;
+        titleLimiter.Cancel();
+    }
+}
 
-        // Update window title to show current settings with current key bindings
-        TCHAR titleText[256];
+//
+// FUNCTION: SampleMetricsOverlay()
+//
+// PURPOSE: Recomputes the rates shown by the metrics overlay from the counters.
+//
+void SampleMetricsOverlay()
+{
+    ULONGLONG now = GetTickCount64();
+    uint64_t frames = framesRendered.Value();
+    uint64_t effectCalls = colorEffectCalls.Value();
+    uint64_t titles = titleUpdates.Value();
 
-        if (isPinned)
+    if (overlaySampleTime != 0 && now > overlaySampleTime)
+    {
+        double seconds = (now - overlaySampleTime) / 1000.0;
+        overlayFrameRate = (frames - overlayLastFrames) / seconds;
+        overlayEffectRate = (effectCalls - overlayLastEffectCalls) / seconds;
+        overlayTitleRate = (titles - overlayLastTitleUpdates) / seconds;
+    }
+
+    overlaySampleTime = now;
+    overlayLastFrames = frames;
+    overlayLastEffectCalls = effectCalls;
+    overlayLastTitleUpdates = titles;
+}
+
+//
+// FUNCTION: ToggleTracing()
+//
+// PURPOSE: Starts event tracing, or stops it and writes the trace file.
+//
+void ToggleTracing()
+{
+    TCHAR message[256];
+    if (tracer.IsEnabled())
+    {
+        size_t eventCount = WriteTraceFile();
+        _stprintf_s(message, 256, TEXT("Screen Filter - Trace of %zu events written to %hs"), eventCount, traceFilePath);
+    }
+    else
+    {
+        tracer.Start();
+        _stprintf_s(message, 256, TEXT("Screen Filter - Tracing started (%hs to stop)"),
+            FormatKeyChord(shortcuts.toggleTrace).c_str());
+    }
+    ShowTemporaryTitle(message, 3000);
+}
+
+//
+// FUNCTION: WriteTraceFile()
+//
+// PURPOSE: Stops tracing and writes the recorded events as Chrome Trace Event JSON,
+//          which chrome://tracing and ui.perfetto.dev can open. Returns the number of events.
+//
+size_t WriteTraceFile()
+{
+    tracer.Stop();
+
+    size_t eventCount = 0;
+    tracer.WriteChromeTraceFile(traceFilePath, &eventCount);
+    return eventCount;
+}
+
+//
+// FUNCTION: MessageName()
+//
+// PURPOSE: Names a window message for trace events. Returns a string literal.
+//
+const char* MessageName(UINT message)
+{
+    switch (message)
+    {
+    case WM_NCHITTEST: return "WM_NCHITTEST";
+    case WM_LBUTTONDOWN: return "WM_LBUTTONDOWN";
+    case WM_KEYDOWN: return "WM_KEYDOWN";
+    case WM_SYSKEYDOWN: return "WM_SYSKEYDOWN";
+    case WM_SETFOCUS: return "WM_SETFOCUS";
+    case WM_HOTKEY: return "WM_HOTKEY";
+    case WM_SYSCOMMAND: return "WM_SYSCOMMAND";
+    case WM_CLOSE: return "WM_CLOSE";
+    case WM_ENDSESSION: return "WM_ENDSESSION";
+    case WM_DESTROY: return "WM_DESTROY";
+    case WM_SIZE: return "WM_SIZE";
+    case WM_WINDOWPOSCHANGED: return "WM_WINDOWPOSCHANGED";
+    case WM_CONTROL_BATCH: return "WM_CONTROL_BATCH";
+    case WM_WINDOWPOSCHANGING: return "WM_WINDOWPOSCHANGING";
+    case WM_MOUSEMOVE: return "WM_MOUSEMOVE";
+    case WM_SETCURSOR: return "WM_SETCURSOR";
+    case WM_PAINT: return "WM_PAINT";
+    case WM_ERASEBKGND: return "WM_ERASEBKGND";
+    case WM_NCPAINT: return "WM_NCPAINT";
+    case WM_NCACTIVATE: return "WM_NCACTIVATE";
+    case WM_ACTIVATE: return "WM_ACTIVATE";
+    case WM_KEYUP: return "WM_KEYUP";
+    case WM_CHAR: return "WM_CHAR";
+    case WM_TIMER: return "WM_TIMER";
+    case WM_SETTEXT: return "WM_SETTEXT";
+    case WM_GETTEXT: return "WM_GETTEXT";
+    default: return "HostWndProc"; // The "msg" argument carries the number
+    }
+}
+
+//
+// FUNCTION: CaptureSourceSample()
+//
+// PURPOSE: Reads the source rectangle off the screen, shrunk to about AUTO_INVERT_TARGET_SAMPLES
+//          pixels. The host window is always layered, and a blit from the screen without
+//          CAPTUREBLT leaves layered windows out, so the sample shows what is under the filter
+//          rather than its output.
+//
+BOOL CaptureSourceSample(const RECT& sourceRect, PixelImage& sample)
+{
+    int sourceWidth = sourceRect.right - sourceRect.left;
+    int sourceHeight = sourceRect.bottom - sourceRect.top;
+    if (sourceWidth <= 0 || sourceHeight <= 0)
+        return FALSE;
+    int step = LuminanceSampleStep(sourceWidth, sourceHeight);
+    int width = (sourceWidth + step - 1) / step;
+    int height = (sourceHeight + step - 1) / step;
+
+    BITMAPINFO info = {};
+    info.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+    info.bmiHeader.biWidth = width;
+    info.bmiHeader.biHeight = -height; // Top-down, as PixelImage
+    info.bmiHeader.biPlanes = 1;
+    info.bmiHeader.biBitCount = 32;
+    info.bmiHeader.biCompression = BI_RGB;
+
+    HDC screen = GetDC(NULL);
+    HDC memory = CreateCompatibleDC(screen);
+    void* bits = NULL;
+    HBITMAP bitmap = CreateDIBSection(memory, &info, DIB_RGB_COLORS, &bits, NULL, 0);
+    BOOL captured = FALSE;
+    if (bitmap != NULL)
+    {
+        HGDIOBJ previous = SelectObject(memory, bitmap);
+
+        // Nearest pixel rather than an average, like the histogram's own thinning
+        SetStretchBltMode(memory, COLORONCOLOR);
+        captured = StretchBlt(memory, 0, 0, width, height, screen, sourceRect.left, sourceRect.top, sourceWidth, sourceHeight, SRCCOPY);
+        if (captured)
         {
-            // When pinned, show unpin instructions using configured hotkey
-            TCHAR hotkeyText[64] = TEXT("");
-
-            // Build the hotkey string based on configured modifiers
-            if (shortcuts.globalHotkeyModifiers & MOD_CONTROL)
-                _tcscat_s(hotkeyText, 64, TEXT("Ctrl+"));
-            if (shortcuts.globalHotkeyModifiers & MOD_SHIFT)
-                _tcscat_s(hotkeyText, 64, TEXT("Shift+"));
-            if (shortcuts.globalHotkeyModifiers & MOD_ALT)
-                _tcscat_s(hotkeyText, 64, TEXT("Alt+"));
-            if (shortcuts.globalHotkeyModifiers & MOD_WIN)
-                _tcscat_s(hotkeyText, 64, TEXT("Win+"));
-
-            // Add the key
-            TCHAR keyText[8];
-            _stprintf_s(keyText, 8, TEXT("%c"), shortcuts.globalHotkeyKey);
-            _tcscat_s(hotkeyText, 64, keyText);
-
-            _stprintf_s(titleText, 256, TEXT("Filter - %s to unpin window"), hotkeyText);
+            GdiFlush();
+            sample.Resize(width, height);
+            memcpy(sample.pixels.data(), bits, sample.pixels.size() * sizeof(uint32_t));
         }
-        else
+        SelectObject(memory, previous);
+        DeleteObject(bitmap);
+    }
+    DeleteDC(memory);
+    ReleaseDC(NULL, screen);
+    return captured;
+}
+
+//
+// FUNCTION: ScreenFrameSource::GetBounds()
+//
+// PURPOSE: The virtual screen, spanning all monitors.
+//
+RECT ScreenFrameSource::GetBounds() const
+{
+    RECT bounds;
+    bounds.left = GetSystemMetrics(SM_XVIRTUALSCREEN);
+    bounds.top = GetSystemMetrics(SM_YVIRTUALSCREEN);
+    bounds.right = bounds.left + GetSystemMetrics(SM_CXVIRTUALSCREEN);
+    bounds.bottom = bounds.top + GetSystemMetrics(SM_CYVIRTUALSCREEN);
+    return bounds;
+}
+
+//
+// FUNCTION: ScreenFrameSource::Capture()
+//
+// PURPOSE: Copies 'region' of the screen into 'frame'. The bitmap is recreated only when the
+//          region changes size, e.g. while the window is resized.
+//
+bool ScreenFrameSource::Capture(const RECT& region, PixelImage& frame)
+{
+    int width = region.right - region.left;
+    int height = region.bottom - region.top;
+    if (width <= 0 || height <= 0)
+        return false;
+
+    HDC screen = GetDC(NULL);
+    if (bitmap == NULL || width != bitmapWidth || height != bitmapHeight)
+    {
+        Release();
+        BITMAPINFO info = {};
+        info.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+        info.bmiHeader.biWidth = width;
+        info.bmiHeader.biHeight = -height; // Top-down, as PixelImage
+        info.bmiHeader.biPlanes = 1;
+        info.bmiHeader.biBitCount = 32;
+        info.bmiHeader.biCompression = BI_RGB;
+
+        memory = CreateCompatibleDC(screen);
+        bitmap = CreateDIBSection(memory, &info, DIB_RGB_COLORS, &bits, NULL, 0);
+        if (bitmap == NULL)
         {
-            // When not pinned, show normal color/inversion status
-            float grayLevels[] = { 1.0f, 0.8f, 0.6f, 0.4f };
-            _stprintf_s(titleText, 256, TEXT("Filter - %s%s Gray:%.0f%% (%c=Invert, %c=Colour, %c=White level, Ctrl+1-9=Save)"),
-                inversionEnabled ? TEXT("Inverted ") : TEXT(""),
-                grayscaleEnabled ? TEXT("Grayscale ") : TEXT("Color "),
-                grayLevels[grayLevel] * 100.0f,
-                shortcuts.toggleInvertKey, shortcuts.toggleGrayscaleKey, shortcuts.cycleWhiteLevelKey);
+            Release();
+            ReleaseDC(NULL, screen);
+            return false;
         }
+        previousBitmap = SelectObject(memory, bitmap);
+        bitmapWidth = width;
+        bitmapHeight = height;
+    }
+
+    BOOL captured;
+    {
+        TraceScope scope(tracer, "BitBlt", "frame");
+        captured = BitBlt(memory, 0, 0, width, height, screen, region.left, region.top, SRCCOPY);
+    }
+    ReleaseDC(NULL, screen);
+    if (!captured)
+        return false;
+
+    GdiFlush();
+    frame.Resize(width, height);
+    memcpy(frame.pixels.data(), bits, frame.pixels.size() * sizeof(uint32_t));
+    return true;
+}
+
+//
+// FUNCTION: ScreenFrameSource::Release()
+//
+// PURPOSE: Frees the capture bitmap; the next capture creates it again.
+//
+void ScreenFrameSource::Release()
+{
+    if (memory != NULL && previousBitmap != NULL)
+    {
+        SelectObject(memory, previousBitmap);
+    }
+    if (bitmap != NULL)
+    {
+        DeleteObject(bitmap);
+    }
+    if (memory != NULL)
+    {
+        DeleteDC(memory);
+    }
+    memory = NULL;
+    bitmap = NULL;
+    previousBitmap = NULL;
+    bits = NULL;
+    bitmapWidth = 0;
+    bitmapHeight = 0;
+}
+
+//
+// FUNCTION: UsesCpuRender()
+//
+// PURPOSE: Whether the window shows the settings through the CPU render path rather than the
+//          magnifier: for the stages the magnifier lacks, privacy effects included, a tone
+//          curve, and dithering (DithersWhiteLevel()).
+//
+BOOL UsesCpuRender(const ColorEffectSettings& settings)
+{
+    return NeedsCpuRender(settings) || toneCurveLoaded || DithersWhiteLevel(settings);
+}
+
+//
+// FUNCTION: DithersWhiteLevel()
+//
+// PURPOSE: Whether the color stage rounds against blue noise: with /dither, at white levels
+//          below 100%, where scaling leaves too few output levels and gradients band.
+//
+BOOL DithersWhiteLevel(const ColorEffectSettings& settings)
+{
+    return ditherWhiteLevels && settings.grayLevel > 0;
+}
 
-        SetWindowText(hwndHost, titleText);
+//
+// FUNCTION: SetCpuRender()
+//
+// PURPOSE: Switches between the magnifier and the CPU render path. The magnifier stays up until
+//          ShowCpuFrame() has a frame to show instead.
+//
+void SetCpuRender(BOOL active)
+{
+    if (active == cpuRenderActive)
+        return;
+    cpuRenderActive = active;
+
+    if (active && !cpuRenderPipeline)
+    {
+        cpuRenderWorkers.reset(new WorkerPool(0));
+        cpuRenderPipeline.reset(new FramePipeline(screenSource, BestPixelKernel()));
+        cpuRenderPipeline->SetWorkerPool(cpuRenderWorkers.get());
+        cpuRenderPipeline->SetToneCurve(toneCurveLoaded ? &toneCurve : NULL);
+    }
+    if (!active)
+    {
+        screenSource.Release();
+    }
+}
+
+//
+// FUNCTION: ShowCpuFrame()
+//
+// PURPOSE: Shows the last CPU frame in the host window, or the magnifier control when there is
+//          none for the current settings. The magnifier is hidden while the CPU frame is shown,
+//          since it would paint over it.
+//
+void ShowCpuFrame(BOOL show)
+{
+    if (show == cpuFrameShown)
+        return;
+    cpuFrameShown = show;
+    ShowWindow(hwndMag, show ? SW_HIDE : SW_SHOW);
+}
+
+//
+// FUNCTION: RenderCpuFrame()
+//
+// PURPOSE: Captures the source rectangle and filters it with the matrix the magnifier would show
+//          now, a step of any transition included, and the stages it cannot do. The following
+//          WM_PAINT draws the result.
+//
+BOOL RenderCpuFrame(const RECT& sourceRect)
+{
+    TraceScope scope(tracer, "RenderCpuFrame", "frame");
+    cpuRenderPipeline->SetColorMatrix(effectTransition.GetMatrix());
+    cpuRenderPipeline->SetEffects(effects.GetSettings());
+    cpuRenderPipeline->SetDither(DithersWhiteLevel(effects.GetSettings()) != FALSE);
+    cpuRenderPipeline->SetSource(sourceRect);
+    if (!cpuRenderPipeline->RenderFrame())
+        return FALSE;
+    cpuFrames.Increment();
+    return TRUE;
+}
+
+//
+// FUNCTION: PaintCpuFrame()
+//
+// PURPOSE: Draws the last CPU-rendered frame at the top left of the client area, where the
+//          magnifier control would show it.
+//
+void PaintCpuFrame(HDC dc)
+{
+    TraceScope scope(tracer, "SetDIBitsToDevice", "frame");
+    const PixelImage& output = cpuRenderPipeline->GetOutput();
+    if (output.width == 0 || output.height == 0)
+        return;
+
+    BITMAPINFO info = {};
+    info.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+    info.bmiHeader.biWidth = output.width;
+    info.bmiHeader.biHeight = -output.height; // Top-down, as PixelImage
+    info.bmiHeader.biPlanes = 1;
+    info.bmiHeader.biBitCount = 32;
+    info.bmiHeader.biCompression = BI_RGB;
+    SetDIBitsToDevice(dc, 0, 0, output.width, output.height, 0, 0, 0, output.height, output.pixels.data(), &info, DIB_RGB_COLORS);
+}
+
+//
+// FUNCTION: UpdateAutoInvert()
+//
+// PURPOSE: While the auto-invert mode is on, samples the source every autoInvertSampleInterval
+//          ms and queues the inversion state when the detector reaches a new verdict. The
+//          following Flush() applies it, and the effect transition fades it in.
+//
+void UpdateAutoInvert(const RECT& sourceRect)
+{
+    if (!effects.GetSettings().autoInvert)
+    {
+        autoInvert.Reset();
+        return;
+    }
+
+    ULONGLONG now = GetTickCount64();
+    if (autoInvert.IsDecided() && now - autoInvertSampleTime < autoInvertSampleInterval)
+        return;
+    autoInvertSampleTime = now;
+
+    TraceScope scope(tracer, "AutoInvert", "effects");
+    if (CaptureSourceSample(sourceRect, autoInvertSample) &&
+        autoInvert.Update(BestPixelKernel(), autoInvertSample.pixels.data(), autoInvertSample.width, autoInvertSample.height))
+    {
+        effects.QueueInversion(autoInvert.IsBright());
     }
 }
 
@@ -1047,38 +2231,104 @@ void ApplyColorEffects()
 //
 void CALLBACK UpdateMagWindow(HWND /*hwnd*/, UINT /*uMsg*/, UINT_PTR /*idEvent*/, DWORD /*dwTime*/)
 {
-    RECT sourceRect;
+    TraceScope scope(tracer, "UpdateMagWindow", "frame");
+    std::chrono::steady_clock::time_point frameStart = std::chrono::steady_clock::now();
+    RecordInput(InputLogRecord(INPUT_LOG_FRAME, 0));
 
     // Always use the current window position to determine what to show
     GetWindowRect(hwndHost, &magWindowRectWindow);
     GetClientRect(hwndHost, &magWindowRectClient);
 
     // Get styles for adjustments
-    LONG titleBarHeight = GetSystemMetrics(SM_CYCAPTION);
-    LONG borderWidth = GetSystemMetrics(SM_CXSIZEFRAME);
-    LONG borderHeight = GetSystemMetrics(SM_CYSIZEFRAME);
+    WindowFrameMetrics frameMetrics = windowRegionPlatform.GetFrameMetrics();
 
-    int fudge = 4;
+    // Shared with the headless FramePipeline
+    RECT sourceRect = ComputeMagnifierSource(magWindowRectWindow, magWindowRectClient, frameMetrics, MAGFACTOR);
 
-    sourceRect.left = magWindowRectWindow.left + magWindowRectClient.left + borderWidth + fudge;
-    sourceRect.top = magWindowRectWindow.top + magWindowRectClient.top + titleBarHeight + borderHeight + fudge;
-
-    // Calculate the width and height based on client area size
-    int width = (int)((magWindowRectWindow.right - magWindowRectWindow.left) / MAGFACTOR);
-    int height = (int)((magWindowRectWindow.bottom - magWindowRectWindow.top) / MAGFACTOR);
+    // Effect key presses since the last frame are applied together, once, with the auto-invert
+    // verdict if there is a new one
+    UpdateAutoInvert(sourceRect);
+    if (effects.Flush())
+    {
+        ApplyColorEffects();
+    }
 
-    sourceRect.right = sourceRect.left + width;
-    sourceRect.bottom = sourceRect.top + height;
+    // The next step of a fade between effect states; only the entries that differ are blended
+    if (effectTransition.Step(GetTickCount64()))
+    {
+        TraceScope transitionScope(tracer, "EffectTransition", "effects");
+        SetMagnifierColorEffect();
+        transitionFrames.Increment();
+    }
 
-    // Set the source rectangle for the magnifier control.
-    MagSetWindowSource(hwndMag, sourceRect);
+    // Effects the magnifier cannot show are filtered on the CPU. Until a frame is ready, or when
+    // the capture fails, the magnifier shows what its matrix can: for a privacy effect, flat gray.
+    SetCpuRender(windowRegion.GetState().effectsApplied && UsesCpuRender(effects.GetSettings()));
+    BOOL cpuFrameReady = cpuRenderActive && RenderCpuFrame(sourceRect);
+    if (!cpuFrameReady)
+    {
+        // Set the source rectangle for the magnifier control.
+        TraceScope sourceScope(tracer, "MagSetWindowSource", "frame");
+        MagSetWindowSource(hwndMag, sourceRect);
+    }
+    ShowCpuFrame(cpuFrameReady);
 
     // Reclaim topmost status, to prevent unmagnified menus from remaining in view. 
-    SetWindowPos(hwndHost, HWND_TOPMOST, 0, 0, 0, 0,
-        SWP_NOACTIVATE | SWP_NOMOVE | SWP_NOSIZE);
+    {
+        TraceScope topmostScope(tracer, "SetWindowPos(HWND_TOPMOST)", "frame");
+        SetWindowPos(hwndHost, HWND_TOPMOST, 0, 0, 0, 0,
+            SWP_NOACTIVATE | SWP_NOMOVE | SWP_NOSIZE);
+    }
 
     // Force redraw.
-    InvalidateRect(hwndMag, NULL, TRUE);
+    {
+        TraceScope redrawScope(tracer, "InvalidateRect", "frame");
+        InvalidateRect(cpuFrameShown ? hwndHost : hwndMag, NULL, !cpuFrameShown);
+    }
+
+    framesRendered.Increment();
+    regionWidth.Set(magWindowRectClient.right - magWindowRectClient.left);
+    regionHeight.Set(magWindowRectClient.bottom - magWindowRectClient.top);
+
+    if (metricsOverlayEnabled && GetTickCount64() - overlaySampleTime >= metricsOverlayInterval)
+    {
+        SampleMetricsOverlay();
+
+        // Leave temporary messages (slot saved, config errors) until they time out
+        TCHAR currentTitle[256];
+        GetWindowText(hwndHost, currentTitle, 256);
+        if (windowRegion.IsSelectionComplete() && lastStatusTitle == currentTitle)
+        {
+            UpdateTitle();
+        }
+    }
+
+    // Title resets and periodic checks due by now
+    timers.Advance(GetTickCount64());
+
+    if (titleLimiter.TakeDue(GetTickCount64()))
+    {
+        WriteStatusTitle();
+    }
+
+    if (!firstFilteredFrameReported && windowRegion.GetState().effectsApplied)
+    {
+        ReportFirstFilteredFrame();
+    }
+
+    if (!deferredInitDone)
+    {
+        RunDeferredInitialization();
+    }
+
+    if (benchmarkStartup && firstFilteredFrameReported && !startupBenchmarkWritten)
+    {
+        WriteStartupBenchmark();
+    }
+
+    RecordInputState();
+
+    frameUpdateSeconds.Observe(std::chrono::duration<double>(std::chrono::steady_clock::now() - frameStart).count());
 }
 
 //
@@ -1088,52 +2338,514 @@ void CALLBACK UpdateMagWindow(HWND /*hwnd*/, UINT /*uMsg*/, UINT_PTR /*idEvent*/
 //
 void GoFullScreen()
 {
-    isFullScreen = TRUE;
-
-    // The window must be styled as layered for proper rendering. 
-    // It is styled as transparent so that it does not capture mouse clicks.
-    SetWindowLong(hwndHost, GWL_EXSTYLE, WS_EX_TOPMOST | WS_EX_LAYERED | WS_EX_TRANSPARENT);
+    windowRegion.Dispatch(RegionEvent(REGION_MAXIMIZE));
+}
 
-    // Give the window a system menu so it can be closed on the taskbar.
-    SetWindowLong(hwndHost, GWL_STYLE, WS_CAPTION | WS_SYSMENU);
+//
+// FUNCTION: GoPartialScreen()
+//
+// PURPOSE: Makes the host window resizable and focusable again after GoFullScreen().
+//
+void GoPartialScreen()
+{
+    windowRegion.Dispatch(RegionEvent(REGION_RESTORE));
+}
 
-    // Calculate the span of the display area.
-    HDC hDC = GetDC(NULL);
-    int xSpan = GetSystemMetrics(SM_CXSCREEN);
-    int ySpan = GetSystemMetrics(SM_CYSCREEN);
-    ReleaseDC(NULL, hDC);
+//
+// FUNCTION: WindowRegionPlatform::GetFrameMetrics()
+//
+// PURPOSE: Returns the sizes of the host window's frame and title bar.
+//
+WindowFrameMetrics WindowRegionPlatform::GetFrameMetrics()
+{
+    WindowFrameMetrics frameMetrics;
+    frameMetrics.titleBarHeight = GetSystemMetrics(SM_CYCAPTION);
+    frameMetrics.borderWidth = GetSystemMetrics(SM_CXSIZEFRAME);
+    frameMetrics.borderHeight = GetSystemMetrics(SM_CYSIZEFRAME);
+    return frameMetrics;
+}
 
+//
+// FUNCTION: WindowRegionPlatform::GetFullScreenRect()
+//
+// PURPOSE: Computes the window bounds that place the non-client elements outside the display.
+//
+void WindowRegionPlatform::GetFullScreenRect(RECT& windowRect)
+{
     // Calculate the size of system elements.
     int xBorder = GetSystemMetrics(SM_CXFRAME);
     int yCaption = GetSystemMetrics(SM_CYCAPTION);
     int yBorder = GetSystemMetrics(SM_CYFRAME);
 
-    // Calculate the window origin and span for full-screen mode.
-    int xOrigin = -xBorder;
-    int yOrigin = -yBorder - yCaption;
-    xSpan += 2 * xBorder;
-    ySpan += 2 * yBorder + yCaption;
+    windowRect.left = -xBorder;
+    windowRect.top = -yBorder - yCaption;
+    windowRect.right = GetSystemMetrics(SM_CXSCREEN) + xBorder;
+    windowRect.bottom = GetSystemMetrics(SM_CYSCREEN) + yBorder;
+}
 
-    SetWindowPos(hwndHost, HWND_TOPMOST, xOrigin, yOrigin, xSpan, ySpan,
-        SWP_SHOWWINDOW | SWP_NOZORDER | SWP_NOACTIVATE);
+//
+// FUNCTION: WindowRegionPlatform::GetWindowRect()
+//
+// PURPOSE: Returns the current host window bounds.
+//
+void WindowRegionPlatform::GetWindowRect(RECT& windowRect)
+{
+    ::GetWindowRect(hwndHost, &windowRect);
 }
 
 //
-// FUNCTION: GoPartialScreen()
+// FUNCTION: WindowRegionPlatform::SetShowState()
 //
-// PURPOSE: Makes the host window resizable and focusable.
+// PURPOSE: Maximizes the host window for selection, or restores it.
 //
-void GoPartialScreen()
+void WindowRegionPlatform::SetShowState(bool maximized)
 {
-    isFullScreen = FALSE;
+    ShowWindow(hwndHost, maximized ? SW_MAXIMIZE : SW_RESTORE);
+}
+
+//
+// FUNCTION: WindowRegionPlatform::SetStyle()
+//
+// PURPOSE: Switches between the sizable frame and the full-screen style. Full screen keeps a
+//          system menu so the window can be closed on the taskbar.
+//
+void WindowRegionPlatform::SetStyle(RegionStyle style)
+{
+    SetWindowLong(hwndHost, GWL_STYLE, style == REGION_STYLE_FULL_SCREEN ? WS_CAPTION | WS_SYSMENU : RESTOREDWINDOWSTYLES);
+}
 
-    SetWindowLong(hwndHost, GWL_EXSTYLE, WS_EX_TOPMOST | WS_EX_LAYERED);
-    SetWindowLong(hwndHost, GWL_STYLE, RESTOREDWINDOWSTYLES);
+//
+// FUNCTION: WindowRegionPlatform::SetExStyle()
+//
+// PURPOSE: Sets the topmost, layered and click-through extended styles, keeping any others.
+//
+void WindowRegionPlatform::SetExStyle(uint8_t exStyle)
+{
+    LONG style = GetWindowLong(hwndHost, GWL_EXSTYLE) & ~(WS_EX_TOPMOST | WS_EX_LAYERED | WS_EX_TRANSPARENT);
+    if (exStyle & REGION_EX_TOPMOST)
+        style |= WS_EX_TOPMOST;
+    if (exStyle & REGION_EX_LAYERED)
+        style |= WS_EX_LAYERED;
+    if (exStyle & REGION_EX_TRANSPARENT)
+        style |= WS_EX_TRANSPARENT;
+    SetWindowLong(hwndHost, GWL_EXSTYLE, style);
+}
+
+//
+// FUNCTION: WindowRegionPlatform::SetPosition()
+//
+// PURPOSE: Moves, sizes and shows the host window without activating it.
+//
+void WindowRegionPlatform::SetPosition(const RECT& windowRect, bool frameChanged)
+{
     SetWindowPos(hwndHost, HWND_TOPMOST,
-        hostWindowRect.left, hostWindowRect.top,
-        hostWindowRect.right, hostWindowRect.bottom,
-        SWP_SHOWWINDOW | SWP_NOZORDER | SWP_NOACTIVATE);
+        windowRect.left, windowRect.top,
+        windowRect.right - windowRect.left, windowRect.bottom - windowRect.top,
+        SWP_SHOWWINDOW | SWP_NOACTIVATE | (frameChanged ? SWP_FRAMECHANGED : 0));
+}
 
-    // Reapply dark mode after style changes
+//
+// FUNCTION: WindowRegionPlatform::ApplyTheme()
+//
+// PURPOSE: Applies dark mode to the host window's frame.
+//
+void WindowRegionPlatform::ApplyTheme()
+{
     ApplyDarkModeToWindow(hwndHost);
-}
\ No newline at end of file
+}
+
+//
+// FUNCTION: WindowRegionPlatform::SetOpaque()
+//
+// PURPOSE: Makes the host window opaque, or almost fully transparent for selection.
+//
+void WindowRegionPlatform::SetOpaque(bool opaque)
+{
+    SetLayeredWindowAttributes(hwndHost, 0, opaque ? 255 : 1, LWA_ALPHA);
+}
+
+//
+// FUNCTION: WindowRegionPlatform::ApplyColorEffect()
+//
+// PURPOSE: Hands the current color effect matrix to the magnifier and updates the title. Unless
+//          transitions are off, the change fades in over the following frames instead.
+//
+bool WindowRegionPlatform::ApplyColorEffect()
+{
+    TraceScope scope(tracer, "ApplyColorEffects", "effects");
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    // A region restored from the last session starts with its effect; other changes fade, except
+    // a privacy effect, which has to cover the region at once, and a switch between the magnifier
+    // and the CPU path, which changes what the matrix leaves to the CPU stages
+    BOOL fade = (windowRegion.GetState().effectsApplied || !restoredFromSession) && effects.GetSettings().privacyEffect == PRIVACY_NONE &&
+        UsesCpuRender(effects.GetSettings()) == cpuRenderActive;
+    effectTransition.Start(effects.GetMatrix(), GetTickCount64(), fade ? effectTransitionDuration : 0);
+    BOOL ret = effectTransition.IsActive() || SetMagnifierColorEffect();
+    applyEffectsSeconds.Observe(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+
+    if (!ret)
+        return false;
+    UpdateTitle();
+    return true;
+}
+
+//
+// FUNCTION: SetMagnifierColorEffect()
+//
+// PURPOSE: Hands the matrix the magnifier should show now to it.
+//
+BOOL SetMagnifierColorEffect()
+{
+    MAGCOLOREFFECT matrix;
+    CalculateColorMatrix(&matrix);
+
+    colorEffectCalls.Increment();
+    TraceScope scope(tracer, "MagSetColorEffect", "effects");
+    return MagSetColorEffect(hwndMag, &matrix);
+}
+
+//
+// CLASS: WindowControlTarget
+//
+// PURPOSE: Runs control channel commands against this window, through the same functions
+//          as the keyboard shortcuts. Only used on the UI thread.
+//
+class WindowControlTarget : public ControlTarget
+{
+public:
+    ControlStatus LoadSlot(int slot) override
+    {
+        // Slot 0 cycles like the 0 key
+        BOOL loaded = slot == 0 ? CycleToNextSavedRectangle() : LoadRectangle(slot);
+        return loaded ? CONTROL_OK : CONTROL_FAILED;
+    }
+
+    ControlStatus SaveSlot(int slot) override
+    {
+        if (!windowRegion.IsSelectionComplete())
+            return CONTROL_FAILED;
+        SaveCurrentRectangle(slot);
+        return CONTROL_OK;
+    }
+
+    ControlStatus ApplyEffect(EffectAction action) override
+    {
+        // Coalesced with key presses and applied by the next frame
+        effects.Queue(action);
+        effectToggles.Increment();
+        return CONTROL_OK;
+    }
+
+    ControlStatus SetEffects(const ColorEffectSettings& settings) override
+    {
+        effects.SetSettings(settings);
+        ApplyColorEffects();
+        return CONTROL_OK;
+    }
+
+    void GetEffects(ColorEffectSettings& settings) override
+    {
+        settings = effects.GetPendingSettings();
+    }
+
+    ControlStatus MoveRegion(const RECT& windowRect) override
+    {
+        ApplyLoadedRectangle(windowRect);
+        return CONTROL_OK;
+    }
+
+    ControlStatus SetTemperature(int kelvin) override
+    {
+        // A client dragging a slider sends many of these per frame; the frame applies the last
+        effects.QueueTemperature(kelvin);
+        effectToggles.Increment();
+        return CONTROL_OK;
+    }
+
+    void GetState(ControlState& state) override
+    {
+        const ColorEffectSettings& settings = effects.GetSettings();
+        state.flags = (settings.inversionEnabled ? CONTROL_STATE_INVERTED : 0) |
+            (settings.grayscaleEnabled ? CONTROL_STATE_GRAYSCALE : 0) | (windowRegion.GetState().pinned ? CONTROL_STATE_PINNED : 0);
+        state.grayLevel = static_cast<uint8_t>(settings.grayLevel);
+
+        RECT windowRect;
+        GetWindowRect(hwndHost, &windowRect);
+        state.left = windowRect.left;
+        state.top = windowRect.top;
+        state.right = windowRect.right;
+        state.bottom = windowRect.bottom;
+    }
+};
+
+//
+// FUNCTION: HandleControlBatch()
+//
+// PURPOSE: Called on a control connection's thread. Queues the batch for the UI thread, which
+//          owns the window, and waits for the responses. Requests not answered within five
+//          seconds (e.g. during shutdown) are reported as failed. The queue, not the posted
+//          message, owns the batch, so a message the window never sees does not leak it.
+//
+void HandleControlBatch(const std::vector<ControlRequest>& requests, std::vector<ControlResponse>& responses)
+{
+    std::shared_ptr<ControlBatch> batch = std::make_shared<ControlBatch>();
+    batch->requests = requests;
+    std::future<void> done = batch->done.get_future();
+
+    {
+        std::lock_guard<std::mutex> lock(controlBatchLock);
+        controlBatches.push_back(batch);
+    }
+
+    if (PostMessage(hwndHost, WM_CONTROL_BATCH, 0, 0) &&
+        done.wait_for(std::chrono::seconds(5)) == std::future_status::ready)
+    {
+        responses = batch->responses;
+        return;
+    }
+
+    // Not run in time; take it back unless the UI thread already has it
+    BOOL running;
+    {
+        std::lock_guard<std::mutex> lock(controlBatchLock);
+        std::deque<std::shared_ptr<ControlBatch>>::iterator queued = std::find(controlBatches.begin(), controlBatches.end(), batch);
+        running = queued == controlBatches.end();
+        if (!running)
+        {
+            controlBatches.erase(queued);
+        }
+    }
+    if (running)
+    {
+        // Answered or failed while we gave up; whichever it was is complete
+        done.wait();
+        responses = batch->responses;
+        return;
+    }
+
+    responses.clear();
+    for (const ControlRequest& request : requests)
+    {
+        responses.push_back(ControlResponse(request.sequence, CONTROL_FAILED));
+    }
+}
+
+//
+// FUNCTION: ExecuteControlBatches()
+//
+// PURPOSE: Runs the control batches queued by connection threads, oldest first.
+//
+void ExecuteControlBatches()
+{
+    for (;;)
+    {
+        std::shared_ptr<ControlBatch> batch;
+        {
+            std::lock_guard<std::mutex> lock(controlBatchLock);
+            if (controlBatches.empty())
+            {
+                return;
+            }
+            batch = controlBatches.front();
+            controlBatches.pop_front();
+        }
+        ExecuteControlBatch(*batch);
+    }
+}
+
+//
+// FUNCTION: FailControlBatches()
+//
+// PURPOSE: Answers every queued control batch with failures. Called as the window is destroyed,
+//          after which no WM_CONTROL_BATCH will be handled.
+//
+void FailControlBatches()
+{
+    std::deque<std::shared_ptr<ControlBatch>> pending;
+    {
+        std::lock_guard<std::mutex> lock(controlBatchLock);
+        pending.swap(controlBatches);
+    }
+    for (const std::shared_ptr<ControlBatch>& batch : pending)
+    {
+        batch->responses.clear();
+        for (const ControlRequest& request : batch->requests)
+        {
+            batch->responses.push_back(ControlResponse(request.sequence, CONTROL_FAILED));
+        }
+        batch->done.set_value();
+    }
+}
+
+//
+// FUNCTION: ExecuteControlBatch()
+//
+// PURPOSE: Runs a batch of control commands on the UI thread. Effect toggles in the batch are
+//          coalesced like key presses, so a script flipping effects pays for one update per frame.
+//
+void ExecuteControlBatch(ControlBatch& batch)
+{
+    TraceScope scope(tracer, "ExecuteControlBatch", "control", "commands", static_cast<int64_t>(batch.requests.size()));
+    WindowControlTarget target;
+
+    batch.responses.resize(batch.requests.size());
+    for (size_t i = 0; i < batch.requests.size(); i++)
+    {
+        if (inputRecorder.IsOpen())
+        {
+            InputLogRecord record(INPUT_LOG_CONTROL, 0);
+            record.control = batch.requests[i];
+            RecordInput(record);
+        }
+
+        ExecuteControlRequest(target, batch.requests[i], batch.responses[i]);
+        controlCommands.Increment();
+        RecordInputState();
+    }
+    batch.done.set_value();
+}
+
+//
+// FUNCTION: StartInputRecording()
+//
+// PURPOSE: Opens the /record log and writes what the window starts from: the key bindings,
+//          the saved rectangles and the current state. Inputs are appended as they arrive.
+//
+void StartInputRecording()
+{
+    InputLogHeader header;
+    header.frame.titleBarHeight = GetSystemMetrics(SM_CYCAPTION);
+    header.frame.borderWidth = GetSystemMetrics(SM_CXSIZEFRAME);
+    header.frame.borderHeight = GetSystemMetrics(SM_CYSIZEFRAME);
+    header.screenWidth = GetSystemMetrics(SM_CXSCREEN);
+    header.screenHeight = GetSystemMetrics(SM_CYSCREEN);
+    if (!inputRecorder.Open(inputRecordPath.c_str(), header))
+    {
+        return;
+    }
+    inputRecordStart = std::chrono::steady_clock::now();
+
+    InputLogRecord record(INPUT_LOG_SHORTCUTS, 0);
+    record.shortcuts = shortcuts;
+    RecordInput(record);
+
+    // Every slot differs from an all-invalid table only where something is saved
+    for (int slot = 0; slot < NUM_SAVED_RECTS; slot++)
+    {
+        lastRecordedSlots[slot] = InputLogSlot();
+        lastRecordedSlots[slot].slot = static_cast<uint8_t>(slot);
+    }
+    RecordSavedRectangles();
+
+    // Force the initial state out
+    lastRecordedState.selection = 0xFF;
+    RecordInputState();
+}
+
+//
+// FUNCTION: RecordInput()
+//
+// PURPOSE: Appends a record to the /record log, if one is open. Inputs are preceded by the
+//          window rectangle when the user has moved or sized the window since the last one.
+//
+void RecordInput(const InputLogRecord& record)
+{
+    if (!inputRecorder.IsOpen())
+        return;
+
+    InputLogRecord timed = record;
+    timed.timeUs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - inputRecordStart).count();
+
+    if (IsInputLogEvent(record.type))
+    {
+        RECT windowRect;
+        GetWindowRect(hwndHost, &windowRect);
+        if (!EqualRect(&windowRect, &lastRecordedState.windowRect))
+        {
+            InputLogRecord moved(INPUT_LOG_MOVED, timed.timeUs);
+            moved.windowRect = windowRect;
+            inputRecorder.Write(moved);
+            lastRecordedState.windowRect = windowRect;
+        }
+    }
+    inputRecorder.Write(timed);
+}
+
+//
+// FUNCTION: RecordKeyInput()
+//
+// PURPOSE: Records a key press with the modifiers held.
+//
+void RecordKeyInput(InputLogRecordType type, WPARAM key)
+{
+    if (!inputRecorder.IsOpen())
+        return;
+
+    InputLogRecord record(type, 0);
+    record.key = static_cast<UINT>(key);
+    record.modifiers = GetCurrentModifiers();
+    RecordInput(record);
+}
+
+//
+// FUNCTION: RecordInputState()
+//
+// PURPOSE: Records the selection and effect state after an input, if the input changed it.
+//
+void RecordInputState()
+{
+    if (!inputRecorder.IsOpen())
+        return;
+
+    const ColorEffectSettings& settings = effects.GetSettings();
+    InputLogRecord record(INPUT_LOG_STATE, 0);
+    const RegionState& region = windowRegion.GetState();
+    record.state.selection = region.selection;
+    record.state.flags = static_cast<uint8_t>((region.fullScreen ? INPUT_STATE_FULL_SCREEN : 0) |
+        (region.pinned ? INPUT_STATE_PINNED : 0) | (settings.inversionEnabled ? INPUT_STATE_INVERTED : 0) |
+        (settings.grayscaleEnabled ? INPUT_STATE_GRAYSCALE : 0) | (region.effectsApplied ? INPUT_STATE_EFFECTS_APPLIED : 0));
+    record.state.grayLevel = static_cast<uint8_t>(settings.grayLevel);
+    record.state.cycleSlot = static_cast<uint8_t>(currentCycleSlot);
+    GetWindowRect(hwndHost, &record.state.windowRect);
+    record.state.effects.Capture(settings);
+
+    if (record.state != lastRecordedState)
+    {
+        RecordInput(record);
+        lastRecordedState = record.state;
+    }
+}
+
+//
+// FUNCTION: RecordSavedRectangles()
+//
+// PURPOSE: Records the saved rectangles that differ from what the log last showed, after a
+//          file read. Rectangles are resolved against the current monitors, as loading does.
+//
+void RecordSavedRectangles()
+{
+    if (!inputRecorder.IsOpen())
+        return;
+
+    for (int slot = 0; slot < NUM_SAVED_RECTS; slot++)
+    {
+        const SavedRectEntry& entry = savedRects.GetEntry(slot);
+        InputLogRecord record(INPUT_LOG_SLOT, 0);
+        record.slot.slot = static_cast<uint8_t>(slot);
+        record.slot.isValid = entry.isValid && ResolveSavedRectangle(entry, record.slot.windowRect);
+        if (record.slot.isValid)
+        {
+            record.slot.inversionEnabled = entry.inversionEnabled;
+            record.slot.grayscaleEnabled = entry.grayscaleEnabled;
+            record.slot.grayLevel = static_cast<uint8_t>(entry.grayLevel);
+            record.slot.effects.Capture(GetEntryEffects(entry));
+        }
+
+        if (record.slot != lastRecordedSlots[slot])
+        {
+            RecordInput(record);
+            lastRecordedSlots[slot] = record.slot;
+        }
+    }
+}
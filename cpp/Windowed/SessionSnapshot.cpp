@@ -0,0 +1,106 @@
+#include "SessionSnapshot.h"
+#include <algorithm>
+
+const char* SessionSnapshot::SESSION_FILE = "session.txt";
+
+// Parse a single line from the file
+bool SessionSnapshot::ParseLine(const std::string& line, SessionRegion& region) {
+    if (line.empty() || line[0] == '#' || line[0] == ';')
+        return false;
+
+    size_t equalPos = line.find('=');
+    size_t commaPos = line.find(',', equalPos);
+    if (equalPos == std::string::npos || commaPos == std::string::npos)
+        return false;
+
+    char* endPtr;
+    std::string idStr = line.substr(0, equalPos);
+    region.id = static_cast<int>(strtol(idStr.c_str(), &endPtr, 10));
+    if (*endPtr != '\0' || region.id < 0 || region.id >= MAX_SESSION_REGIONS)
+        return false;
+
+    std::string pinnedStr = line.substr(equalPos + 1, commaPos - equalPos - 1);
+    region.isPinned = (strtol(pinnedStr.c_str(), &endPtr, 10) != 0);
+    if (*endPtr != '\0')
+        return false;
+
+    return SavedRectanglesManager::ParseEntry(line.substr(commaPos + 1), region.entry);
+}
+
+// Load all regions from file
+bool SessionSnapshot::Load() {
+    regions.clear();
+
+    std::ifstream file(SESSION_FILE);
+    if (!file.is_open())
+        return false;
+
+    std::string line;
+    while (std::getline(file, line)) {
+        SessionRegion region;
+        if (ParseLine(line, region)) {
+            Set(region);
+        }
+    }
+
+    file.close();
+    return true;
+}
+
+// Save all regions to file
+bool SessionSnapshot::Save() {
+    std::ofstream file(SESSION_FILE);
+    if (!file.is_open())
+        return false;
+
+    file << "# Screen Filter session, restored at launch. Written automatically; close a region's window to forget it.\n";
+    file << "# Format: RegionId=Pinned,Left,Top,Right,Bottom,Invert,Grayscale,GrayLevel[,Monitor,NLeft,NTop,NRight,NBottom]\n\n";
+
+    for (const SessionRegion& region : regions) {
+        file << region.id << "=" << (region.isPinned ? 1 : 0) << ",";
+        SavedRectanglesManager::WriteEntry(file, region.entry);
+        file << "\n";
+    }
+
+    file.close();
+    return true;
+}
+
+// Region with the given id, or NULL
+const SessionRegion* SessionSnapshot::Find(int id) const {
+    for (const SessionRegion& region : regions) {
+        if (region.id == id)
+            return &region;
+    }
+    return NULL;
+}
+
+// Add or replace a region, keeping regions ordered by id
+void SessionSnapshot::Set(const SessionRegion& region) {
+    Remove(region.id);
+    auto position = std::lower_bound(regions.begin(), regions.end(), region,
+        [](const SessionRegion& a, const SessionRegion& b) { return a.id < b.id; });
+    regions.insert(position, region);
+}
+
+// Remove a region if present
+void SessionSnapshot::Remove(int id) {
+    regions.erase(std::remove_if(regions.begin(), regions.end(),
+        [id](const SessionRegion& region) { return region.id == id; }), regions.end());
+}
+
+// Re-read the file, replace one region and write it back
+bool SessionSnapshot::SaveRegionPreservingExisting(const SessionRegion& region) {
+    Load();
+    Set(region);
+    return Save();
+}
+
+// Re-read the file, drop one region and write it back
+bool SessionSnapshot::RemoveRegionPreservingExisting(int id) {
+    Load();
+    if (Find(id) == NULL)
+        return true;
+    Remove(id);
+    return Save();
+}
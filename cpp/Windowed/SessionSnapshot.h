@@ -0,0 +1,53 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "SavedRectanglesManager.h"
+
+#define MAX_SESSION_REGIONS 16
+
+// One filter region as it was when the session was last written
+struct SessionRegion {
+    int id;               // Claimed by one running instance at a time
+    bool isPinned;
+    SavedRectEntry entry; // Position and color effect state
+
+    SessionRegion() : id(-1), isPinned(false) {}
+};
+
+// Snapshot of every open filter region, restored at launch so the selection phase can be skipped.
+// Each running instance owns one region id and rewrites only its own line.
+class SessionSnapshot {
+private:
+    static const char* SESSION_FILE;
+    std::vector<SessionRegion> regions;
+
+    // Parse a single line from the file
+    bool ParseLine(const std::string& line, SessionRegion& region);
+
+public:
+    SessionSnapshot() {}
+
+    // Load all regions from file
+    bool Load();
+
+    // Save all regions to file
+    bool Save();
+
+    const std::vector<SessionRegion>& GetRegions() const { return regions; }
+
+    // Region with the given id, or NULL
+    const SessionRegion* Find(int id) const;
+
+    // Add or replace a region
+    void Set(const SessionRegion& region);
+
+    // Remove a region if present
+    void Remove(int id);
+
+    // Re-read the file, replace one region and write it back, preserving other instances' regions
+    bool SaveRegionPreservingExisting(const SessionRegion& region);
+
+    // Re-read the file, drop one region and write it back
+    bool RemoveRegionPreservingExisting(int id);
+};
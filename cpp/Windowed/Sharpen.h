@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdint>
+#include "PixelKernels.h"
+#include "WorkerPool.h"
+
+// Strongest unsharp mask SharpenImage applies; larger strengths are clamped
+#define SHARPEN_MAX_STRENGTH 2.0f
+
+// Unsharp mask on 32-bit BGRA pixels: dst = src + strength * (src - blur), with blur a 3x3
+// binomial filter ([1 2 1] / 4 across, then down) and the result clamped. Each pass is two
+// rounds of averaging neighbours, rounded up, then down so there is no bias, which keeps the
+// blur in bytes. Anti-aliased strokes that inversion leaves thin and grey gain
+// contrast against their background, so text reads crisper. Pixels past the image edges repeat
+// the edge; alpha is passed through.
+//
+// The blur was a 5x5 binomial at first; 3x3 is a deliberate trade. It sharpens a one-pixel
+// radius rather than two, which is what thin strokes need, and keeps 1080p within the 6 ms
+// --sharpen budget (about +3 ms on one core, where 5x5 took up to 7.5 ms). 4K still costs
+// about 16 ms on one core, a whole 60 Hz frame, so it relies on the pool's threads.
+//
+// The image is split into tiles that each read a one-pixel halo around them, so tiles are
+// independent: with a 'pool' they run on its threads, with NULL on the calling one. Integer
+// arithmetic throughout, so the result does not depend on the kernel (LUT runs the scalar code)
+// or on the tiling. src and dst must not overlap.
+void SharpenImage(PixelKernel kernel, const uint32_t* src, uint32_t* dst, int width, int height, float strength, WorkerPool* pool);
@@ -0,0 +1,478 @@
+#include "ShortcutConfig.h"
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+
+const char* ShortcutConfig::CONFIG_FILE = "shortcuts.txt";
+
+namespace {
+
+// Named keys. The first name listed for a key is the one used when formatting.
+struct NamedKey {
+    const char* name;
+    UINT key;
+};
+
+const NamedKey namedKeys[] = {
+    { "Escape", VK_ESCAPE }, { "Esc", VK_ESCAPE },
+    { "Space", VK_SPACE },
+    { "Tab", VK_TAB },
+    { "Enter", VK_RETURN }, { "Return", VK_RETURN },
+    { "Backspace", VK_BACK },
+    { "Insert", VK_INSERT }, { "Ins", VK_INSERT },
+    { "Delete", VK_DELETE }, { "Del", VK_DELETE },
+    { "Home", VK_HOME },
+    { "End", VK_END },
+    { "PageUp", VK_PRIOR }, { "PgUp", VK_PRIOR },
+    { "PageDown", VK_NEXT }, { "PgDn", VK_NEXT },
+    { "Left", VK_LEFT },
+    { "Right", VK_RIGHT },
+    { "Up", VK_UP },
+    { "Down", VK_DOWN },
+    { "Pause", VK_PAUSE },
+    { "NumpadMultiply", VK_MULTIPLY },
+    { "NumpadAdd", VK_ADD },
+    { "NumpadSubtract", VK_SUBTRACT },
+    { "NumpadDecimal", VK_DECIMAL },
+    { "NumpadDivide", VK_DIVIDE },
+    { "Plus", VK_OEM_PLUS },
+    { "Minus", VK_OEM_MINUS },
+    { "Comma", VK_OEM_COMMA },
+    { "Period", VK_OEM_PERIOD },
+};
+
+// Types of value a setting accepts
+enum SettingType {
+    SETTING_CHORD,     // Full chord, e.g. Ctrl+F5
+    SETTING_KEY,       // Key only; modifiers come from a separate setting
+    SETTING_MODIFIERS  // Modifiers only
+};
+
+// Schema entry mapping a setting name to the chord it configures
+struct SettingSchema {
+    const char* name;
+    SettingType type;
+    KeyChord ShortcutConfig::*field;
+    bool isGlobal;
+};
+
+const SettingSchema schema[] = {
+    { "ToggleInvertKey", SETTING_CHORD, &ShortcutConfig::toggleInvert, false },
+    { "ToggleGrayscaleKey", SETTING_CHORD, &ShortcutConfig::toggleGrayscale, false },
+    { "CycleWhiteLevelKey", SETTING_CHORD, &ShortcutConfig::cycleWhiteLevel, false },
+    { "CycleVisionModeKey", SETTING_CHORD, &ShortcutConfig::cycleVisionMode, false },
+    { "CycleVisionSeverityKey", SETTING_CHORD, &ShortcutConfig::cycleVisionSeverity, false },
+    { "WarmerKey", SETTING_CHORD, &ShortcutConfig::warmer, false },
+    { "CoolerKey", SETTING_CHORD, &ShortcutConfig::cooler, false },
+    { "CyclePrivacyEffectKey", SETTING_CHORD, &ShortcutConfig::cyclePrivacyEffect, false },
+    { "ToggleBinarizeKey", SETTING_CHORD, &ShortcutConfig::toggleBinarize, false },
+    { "CycleBinarizeWindowKey", SETTING_CHORD, &ShortcutConfig::cycleBinarizeWindow, false },
+    { "ToggleAutoInvertKey", SETTING_CHORD, &ShortcutConfig::toggleAutoInvert, false },
+    { "ToggleSmartInvertKey", SETTING_CHORD, &ShortcutConfig::toggleSmartInvert, false },
+    { "CycleSharpenKey", SETTING_CHORD, &ShortcutConfig::cycleSharpen, false },
+    { "ToggleMetricsOverlayKey", SETTING_CHORD, &ShortcutConfig::toggleMetricsOverlay, false },
+    { "ToggleTraceKey", SETTING_CHORD, &ShortcutConfig::toggleTrace, false },
+    { "GlobalHotkey", SETTING_CHORD, &ShortcutConfig::globalHotkey, true },
+    { "GlobalHotkeyKey", SETTING_KEY, &ShortcutConfig::globalHotkey, true },
+    { "GlobalHotkeyModifiers", SETTING_MODIFIERS, &ShortcutConfig::globalHotkey, true },
+};
+
+std::string Trim(const std::string& text) {
+    size_t first = text.find_first_not_of(" \t\r");
+    if (first == std::string::npos)
+        return "";
+    size_t last = text.find_last_not_of(" \t\r");
+    return text.substr(first, last - first + 1);
+}
+
+std::string ToUpper(std::string text) {
+    std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return static_cast<char>(toupper(c)); });
+    return text;
+}
+
+// Split on '+', treating a trailing '+' as the key itself ("Ctrl++")
+std::vector<std::string> SplitChord(const std::string& text) {
+    std::vector<std::string> parts;
+    std::string current;
+    for (size_t i = 0; i < text.size(); i++) {
+        if (text[i] == '+' && !current.empty()) {
+            parts.push_back(Trim(current));
+            current.clear();
+        } else {
+            current += text[i];
+        }
+    }
+    parts.push_back(Trim(current));
+    return parts;
+}
+
+bool ParseModifierName(const std::string& name, UINT& modifier) {
+    std::string upper = ToUpper(name);
+    if (upper == "CTRL" || upper == "CONTROL") modifier = MOD_CONTROL;
+    else if (upper == "SHIFT") modifier = MOD_SHIFT;
+    else if (upper == "ALT") modifier = MOD_ALT;
+    else if (upper == "WIN") modifier = MOD_WIN;
+    else return false;
+    return true;
+}
+
+// Digits, Ctrl+digits and Escape are handled before configurable shortcuts
+bool IsReservedLocalChord(const KeyChord& chord) {
+    if (chord.key >= '0' && chord.key <= '9' && (chord.modifiers == 0 || chord.modifiers == MOD_CONTROL))
+        return true;
+    return chord.key == VK_ESCAPE && chord.modifiers == 0;
+}
+
+} // namespace
+
+// Parse a key name to a virtual-key code
+bool ParseKeyName(const std::string& name, UINT& key) {
+    if (name.empty())
+        return false;
+
+    // Letters are case-insensitive; digits map to themselves
+    if (name.size() == 1) {
+        unsigned char c = static_cast<unsigned char>(name[0]);
+        if (isalpha(c)) { key = static_cast<UINT>(toupper(c)); return true; }
+        if (isdigit(c)) { key = c; return true; }
+        if (c == '+') { key = VK_OEM_PLUS; return true; }
+        if (c == '-') { key = VK_OEM_MINUS; return true; }
+        if (c == ',') { key = VK_OEM_COMMA; return true; }
+        if (c == '.') { key = VK_OEM_PERIOD; return true; }
+        return false;
+    }
+
+    std::string upper = ToUpper(name);
+
+    // Function keys F1-F24
+    if (upper[0] == 'F' && upper.size() <= 3 && isdigit(static_cast<unsigned char>(upper[1]))) {
+        int number = atoi(upper.c_str() + 1);
+        if (upper.find_first_not_of("0123456789", 1) == std::string::npos && number >= 1 && number <= 24) {
+            key = VK_F1 + (number - 1);
+            return true;
+        }
+        return false;
+    }
+
+    // Numpad0-Numpad9
+    if (upper.size() == 7 && upper.compare(0, 6, "NUMPAD") == 0 && isdigit(static_cast<unsigned char>(upper[6]))) {
+        key = VK_NUMPAD0 + (upper[6] - '0');
+        return true;
+    }
+
+    for (const NamedKey& named : namedKeys) {
+        if (upper == ToUpper(named.name)) {
+            key = named.key;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Parse modifiers joined with '+'
+bool ParseModifiers(const std::string& text, UINT& modifiers, std::string& error) {
+    modifiers = 0;
+    std::string trimmed = Trim(text);
+    if (trimmed.empty() || ToUpper(trimmed) == "NONE")
+        return true;
+
+    for (const std::string& part : SplitChord(trimmed)) {
+        UINT modifier;
+        if (!ParseModifierName(part, modifier)) {
+            error = "Unknown modifier '" + part + "' (expected CTRL, SHIFT, ALT or WIN)";
+            return false;
+        }
+        modifiers |= modifier;
+    }
+    return true;
+}
+
+// Parse a chord such as "Ctrl+Shift+F5" or a bare key
+bool ParseKeyChord(const std::string& text, KeyChord& chord, std::string& error) {
+    std::vector<std::string> parts = SplitChord(Trim(text));
+    if (parts.back().empty()) {
+        error = "Missing key";
+        return false;
+    }
+
+    KeyChord parsed = { 0, 0 };
+    for (size_t i = 0; i + 1 < parts.size(); i++) {
+        UINT modifier;
+        if (!ParseModifierName(parts[i], modifier)) {
+            error = "Unknown modifier '" + parts[i] + "' (expected Ctrl, Shift, Alt or Win)";
+            return false;
+        }
+        parsed.modifiers |= modifier;
+    }
+
+    if (!ParseKeyName(parts.back(), parsed.key)) {
+        error = "Unknown key '" + parts.back() + "'";
+        return false;
+    }
+
+    chord = parsed;
+    return true;
+}
+
+// Human-readable form of a chord
+std::string FormatKeyChord(const KeyChord& chord) {
+    std::string text;
+    if (chord.modifiers & MOD_CONTROL) text += "Ctrl+";
+    if (chord.modifiers & MOD_SHIFT) text += "Shift+";
+    if (chord.modifiers & MOD_ALT) text += "Alt+";
+    if (chord.modifiers & MOD_WIN) text += "Win+";
+
+    if ((chord.key >= 'A' && chord.key <= 'Z') || (chord.key >= '0' && chord.key <= '9'))
+        return text + static_cast<char>(chord.key);
+    if (chord.key >= VK_F1 && chord.key <= VK_F24)
+        return text + "F" + std::to_string(chord.key - VK_F1 + 1);
+    if (chord.key >= VK_NUMPAD0 && chord.key <= VK_NUMPAD0 + 9)
+        return text + "Numpad" + std::to_string(chord.key - VK_NUMPAD0);
+    for (const NamedKey& named : namedKeys) {
+        if (named.key == chord.key)
+            return text + named.name;
+    }
+
+    char hex[8];
+    snprintf(hex, sizeof(hex), "0x%02X", chord.key);
+    return text + hex;
+}
+
+// Parse config text against the schema
+void ParseShortcutConfig(std::istream& input, ShortcutConfig& config, std::vector<ConfigError>& errors) {
+    const ShortcutConfig previous = config;
+    ParseShortcutConfig(input, config, previous, errors);
+}
+
+// Parse config text against the schema, falling back to 'fallback' for settings that fail validation
+void ParseShortcutConfig(std::istream& input, ShortcutConfig& config, const ShortcutConfig& fallback,
+    std::vector<ConfigError>& errors) {
+    std::vector<int> seenOnLine(sizeof(schema) / sizeof(schema[0]), 0);
+
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(input, line)) {
+        lineNumber++;
+
+        // Skip comments and empty lines
+        std::string trimmed = Trim(line);
+        if (trimmed.empty() || trimmed[0] == '#' || trimmed[0] == ';')
+            continue;
+
+        size_t equalPos = trimmed.find('=');
+        if (equalPos == std::string::npos) {
+            errors.push_back({ lineNumber, "Expected Name=Value" });
+            continue;
+        }
+
+        std::string name = Trim(trimmed.substr(0, equalPos));
+        std::string value = Trim(trimmed.substr(equalPos + 1));
+
+        size_t index = 0;
+        while (index < seenOnLine.size() && name != schema[index].name)
+            index++;
+        if (index == seenOnLine.size()) {
+            errors.push_back({ lineNumber, "Unknown setting '" + name + "'" });
+            continue;
+        }
+        if (seenOnLine[index] != 0) {
+            errors.push_back({ lineNumber, name + " is already set on line " + std::to_string(seenOnLine[index]) });
+            continue;
+        }
+        seenOnLine[index] = lineNumber;
+
+        const SettingSchema& setting = schema[index];
+        KeyChord& target = config.*setting.field;
+        const KeyChord& kept = fallback.*setting.field;
+        std::string error;
+
+        switch (setting.type) {
+        case SETTING_CHORD: {
+            KeyChord chord;
+            if (!ParseKeyChord(value, chord, error)) {
+                errors.push_back({ lineNumber, name + ": " + error });
+                target = kept;
+            } else if (!setting.isGlobal && IsReservedLocalChord(chord)) {
+                errors.push_back({ lineNumber, name + ": " + FormatKeyChord(chord) + " is reserved for saved rectangles or Escape" });
+                target = kept;
+            } else {
+                target = chord;
+            }
+            break;
+        }
+        case SETTING_KEY: {
+            UINT key;
+            if (!ParseKeyName(value, key)) {
+                errors.push_back({ lineNumber, name + ": Unknown key '" + value + "'" });
+                target.key = kept.key;
+            } else {
+                target.key = key;
+            }
+            break;
+        }
+        case SETTING_MODIFIERS: {
+            UINT modifiers;
+            if (!ParseModifiers(value, modifiers, error)) {
+                errors.push_back({ lineNumber, name + ": " + error });
+                target.modifiers = kept.modifiers;
+            } else {
+                target.modifiers = modifiers;
+            }
+            break;
+        }
+        }
+    }
+
+    // A global hotkey without modifiers would swallow the key in every application
+    if (config.globalHotkey.modifiers == 0) {
+        errors.push_back({ 0, "The global hotkey needs at least one modifier" });
+        config.globalHotkey = fallback.globalHotkey;
+    }
+
+    // Two actions on the same chord would make one of them unreachable; the registered global
+    // hotkey never reaches the window, so it counts as taken too
+    KeyChord ShortcutConfig::* const boundKeys[] = {
+        &ShortcutConfig::toggleInvert, &ShortcutConfig::toggleGrayscale, &ShortcutConfig::cycleWhiteLevel,
+        &ShortcutConfig::cycleVisionMode, &ShortcutConfig::cycleVisionSeverity, &ShortcutConfig::warmer, &ShortcutConfig::cooler,
+        &ShortcutConfig::cyclePrivacyEffect, &ShortcutConfig::toggleBinarize, &ShortcutConfig::cycleBinarizeWindow,
+        &ShortcutConfig::toggleAutoInvert, &ShortcutConfig::toggleSmartInvert, &ShortcutConfig::cycleSharpen,
+        &ShortcutConfig::toggleMetricsOverlay, &ShortcutConfig::toggleTrace, &ShortcutConfig::globalHotkey
+    };
+    const size_t boundCount = sizeof(boundKeys) / sizeof(boundKeys[0]);
+    for (size_t i = 0; i < boundCount; i++) {
+        for (size_t j = i + 1; j < boundCount; j++) {
+            if (config.*boundKeys[i] == config.*boundKeys[j]) {
+                errors.push_back({ 0, FormatKeyChord(config.*boundKeys[j]) + " is bound to more than one action" });
+                config.*boundKeys[i] = fallback.*boundKeys[i];
+                config.*boundKeys[j] = fallback.*boundKeys[j];
+            }
+        }
+    }
+
+    // The window checks the escape key before any shortcut, whatever else is held; chords with
+    // Alt arrive as system keys and miss that check
+    for (size_t i = 0; i + 1 < boundCount; i++) {
+        const KeyChord& chord = config.*boundKeys[i];
+        if (chord.key == config.escapeKey && (chord.modifiers & MOD_ALT) == 0) {
+            errors.push_back({ 0, FormatKeyChord(chord) + " is taken by the escape key" });
+            config.*boundKeys[i] = fallback.*boundKeys[i];
+        }
+    }
+}
+
+// Load a config file; returns false if the file could not be opened
+bool LoadShortcutConfigFile(const char* path, ShortcutConfig& config, std::vector<ConfigError>& errors) {
+    std::ifstream configFile(path);
+    if (!configFile.is_open())
+        return false;
+
+    ParseShortcutConfig(configFile, config, errors);
+    return true;
+}
+
+// Reload a config file over the defaults; settings that fail validation keep their value in 'current'
+bool ReloadShortcutConfigFile(const char* path, const ShortcutConfig& current, ShortcutConfig& updated,
+    std::vector<ConfigError>& errors) {
+    std::ifstream configFile(path);
+    if (!configFile.is_open())
+        return false;
+
+    updated = ShortcutConfig();
+    ParseShortcutConfig(configFile, updated, current, errors);
+    return true;
+}
+
+// Write the default config file with documentation comments
+bool SaveDefaultShortcutConfigFile(const char* path) {
+    std::ofstream configFile(path);
+
+    if (!configFile.is_open())
+        return false;
+
+    ShortcutConfig defaults;
+
+    configFile << "# Screen Filter Shortcut Configuration\n";
+    configFile << "# Edit these values to customize keyboard shortcuts\n";
+    configFile << "# Keys: letters, F1-F24, Space, Tab, Enter, Insert, Delete, Home, End, PageUp, PageDown,\n";
+    configFile << "#       Left, Right, Up, Down, Numpad0-Numpad9, Plus, Minus, Comma, Period\n";
+    configFile << "# Chords combine modifiers and a key with +, e.g. Ctrl+Shift+F5\n\n";
+
+    configFile << "# Toggle color inversion on/off\n";
+    configFile << "ToggleInvertKey=" << FormatKeyChord(defaults.toggleInvert) << "\n\n";
+
+    configFile << "# Toggle between grayscale and color\n";
+    configFile << "ToggleGrayscaleKey=" << FormatKeyChord(defaults.toggleGrayscale) << "\n\n";
+
+    configFile << "# Cycle through white/brightness levels\n";
+    configFile << "CycleWhiteLevelKey=" << FormatKeyChord(defaults.cycleWhiteLevel) << "\n\n";
+
+    configFile << "# Cycle through color vision deficiency simulation and correction modes\n";
+    configFile << "CycleVisionModeKey=" << FormatKeyChord(defaults.cycleVisionMode) << "\n\n";
+
+    configFile << "# Lower the strength of the vision mode in 10% steps, wrapping back to 100%\n";
+    configFile << "CycleVisionSeverityKey=" << FormatKeyChord(defaults.cycleVisionSeverity) << "\n\n";
+
+    configFile << "# Lower/raise the color temperature by 500 K (6500 K is neutral)\n";
+    configFile << "WarmerKey=" << FormatKeyChord(defaults.warmer) << "\n";
+    configFile << "CoolerKey=" << FormatKeyChord(defaults.cooler) << "\n\n";
+
+    configFile << "# Hide the region's contents: off, blurred, pixelated\n";
+    configFile << "CyclePrivacyEffectKey=" << FormatKeyChord(defaults.cyclePrivacyEffect) << "\n\n";
+
+    configFile << "# Threshold the region to black and white text; cycle the size of the area each threshold comes from\n";
+    configFile << "ToggleBinarizeKey=" << FormatKeyChord(defaults.toggleBinarize) << "\n";
+    configFile << "CycleBinarizeWindowKey=" << FormatKeyChord(defaults.cycleBinarizeWindow) << "\n\n";
+
+    configFile << "# Invert automatically while the contents are bright, e.g. an app switching between light and dark pages\n";
+    configFile << "ToggleAutoInvertKey=" << FormatKeyChord(defaults.toggleAutoInvert) << "\n\n";
+
+    configFile << "# Invert only text on light backgrounds, leaving photos, video and dark panels as they are\n";
+    configFile << "ToggleSmartInvertKey=" << FormatKeyChord(defaults.toggleSmartInvert) << "\n\n";
+
+    configFile << "# Sharpen text and edges: off, 50%, 100%, 150%, 200%\n";
+    configFile << "CycleSharpenKey=" << FormatKeyChord(defaults.cycleSharpen) << "\n\n";
+
+    configFile << "# Show frame, color effect and title update rates in the title bar\n";
+    configFile << "ToggleMetricsOverlayKey=" << FormatKeyChord(defaults.toggleMetricsOverlay) << "\n\n";
+
+    configFile << "# Start/stop event tracing; stopping writes trace.json for chrome://tracing or Perfetto\n";
+    configFile << "ToggleTraceKey=" << FormatKeyChord(defaults.toggleTrace) << "\n\n";
+
+    configFile << "# Global hotkey to toggle pin/click-through mode\n";
+    configFile << "GlobalHotkeyKey=" << FormatKeyChord({ defaults.globalHotkey.key, 0 }) << "\n";
+    configFile << "# Modifier keys: CTRL, SHIFT, ALT, WIN (combine with +)\n";
+    configFile << "GlobalHotkeyModifiers=CTRL+SHIFT\n\n";
+
+    configFile << "# Changes are picked up automatically while the application is running\n";
+    configFile << "# Rectangle Save/Load: 0=cycle through saved, 1-9=load saved, Ctrl+1-9=save current (Ctrl+0 disabled)\n";
+
+    configFile.close();
+    return true;
+}
+
+// Combination of ShortcutChange flags describing how 'after' differs from 'before'
+int DiffShortcutConfig(const ShortcutConfig& before, const ShortcutConfig& after) {
+    int changes = SHORTCUT_CHANGE_NONE;
+    if (before.toggleInvert != after.toggleInvert ||
+        before.toggleGrayscale != after.toggleGrayscale ||
+        before.cycleWhiteLevel != after.cycleWhiteLevel ||
+        before.cycleVisionMode != after.cycleVisionMode ||
+        before.cycleVisionSeverity != after.cycleVisionSeverity ||
+        before.warmer != after.warmer ||
+        before.cooler != after.cooler ||
+        before.cyclePrivacyEffect != after.cyclePrivacyEffect ||
+        before.toggleBinarize != after.toggleBinarize ||
+        before.cycleBinarizeWindow != after.cycleBinarizeWindow ||
+        before.toggleAutoInvert != after.toggleAutoInvert ||
+        before.toggleSmartInvert != after.toggleSmartInvert ||
+        before.cycleSharpen != after.cycleSharpen ||
+        before.toggleMetricsOverlay != after.toggleMetricsOverlay ||
+        before.toggleTrace != after.toggleTrace ||
+        before.escapeKey != after.escapeKey)
+        changes |= SHORTCUT_CHANGE_LOCAL_KEYS;
+    if (before.globalHotkey != after.globalHotkey)
+        changes |= SHORTCUT_CHANGE_GLOBAL_HOTKEY;
+    return changes;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "Platform.h"
+#include <string>
+#include <vector>
+#include <istream>
+
+// A virtual key plus the modifiers that must be held with it
+struct KeyChord {
+    UINT key;       // Virtual-key code
+    UINT modifiers; // MOD_CONTROL | MOD_SHIFT | MOD_ALT | MOD_WIN
+
+    bool operator==(const KeyChord& other) const { return key == other.key && modifiers == other.modifiers; }
+    bool operator!=(const KeyChord& other) const { return !(*this == other); }
+};
+
+// Configurable shortcuts structure
+struct ShortcutConfig {
+    KeyChord toggleInvert = { 'I', 0 };
+    KeyChord toggleGrayscale = { 'C', 0 };
+    KeyChord cycleWhiteLevel = { 'W', 0 };
+    KeyChord cycleVisionMode = { 'V', 0 };
+    KeyChord cycleVisionSeverity = { 'V', MOD_SHIFT };
+    KeyChord warmer = { 'K', 0 };
+    KeyChord cooler = { 'K', MOD_SHIFT };
+    KeyChord cyclePrivacyEffect = { 'B', 0 };
+    KeyChord toggleBinarize = { 'H', 0 };
+    KeyChord cycleBinarizeWindow = { 'H', MOD_SHIFT };
+    KeyChord toggleAutoInvert = { 'A', 0 };
+    KeyChord toggleSmartInvert = { 'A', MOD_SHIFT };
+    KeyChord cycleSharpen = { 'S', 0 };
+    KeyChord toggleMetricsOverlay = { 'M', 0 };
+    KeyChord toggleTrace = { 'T', 0 };
+    UINT escapeKey = VK_ESCAPE;
+    KeyChord globalHotkey = { 'P', MOD_CONTROL | MOD_SHIFT };
+
+    // File path for config
+    static const char* CONFIG_FILE;
+};
+
+// Fields that differ between two configurations, so a reload only touches what changed
+enum ShortcutChange {
+    SHORTCUT_CHANGE_NONE = 0,
+    SHORTCUT_CHANGE_LOCAL_KEYS = 1,   // Window-local keys: only the title text needs refreshing
+    SHORTCUT_CHANGE_GLOBAL_HOTKEY = 2 // Needs the hotkey re-registered
+};
+
+// Problem found while validating a config file
+struct ConfigError {
+    int line; // 1-based, 0 for whole-file problems
+    std::string message;
+};
+
+// Parse a key name ("P", "F5", "PageUp", "Numpad3", ...) to a virtual-key code
+bool ParseKeyName(const std::string& name, UINT& key);
+
+// Parse modifiers joined with '+' ("Ctrl+Shift")
+bool ParseModifiers(const std::string& text, UINT& modifiers, std::string& error);
+
+// Parse a chord such as "Ctrl+Shift+F5" or a bare key
+bool ParseKeyChord(const std::string& text, KeyChord& chord, std::string& error);
+
+// Human-readable form of a chord, e.g. "Ctrl+Shift+P"
+std::string FormatKeyChord(const KeyChord& chord);
+
+// Parse config text against the schema. Valid settings are applied on top of 'config';
+// settings that fail validation keep their previous value and are reported in 'errors'.
+void ParseShortcutConfig(std::istream& input, ShortcutConfig& config, std::vector<ConfigError>& errors);
+
+// As above, but settings that fail validation take their value from 'fallback' instead
+void ParseShortcutConfig(std::istream& input, ShortcutConfig& config, const ShortcutConfig& fallback,
+    std::vector<ConfigError>& errors);
+
+// Load a config file; returns false if the file could not be opened
+bool LoadShortcutConfigFile(const char* path, ShortcutConfig& config, std::vector<ConfigError>& errors);
+
+// Reload a config file: settings missing from it fall back to their defaults, settings that fail
+// validation keep the binding in 'current'. Returns false if the file could not be opened.
+bool ReloadShortcutConfigFile(const char* path, const ShortcutConfig& current, ShortcutConfig& updated,
+    std::vector<ConfigError>& errors);
+
+// Write the default config file with documentation comments
+bool SaveDefaultShortcutConfigFile(const char* path);
+
+// Combination of ShortcutChange flags describing how 'after' differs from 'before'
+int DiffShortcutConfig(const ShortcutConfig& before, const ShortcutConfig& after);
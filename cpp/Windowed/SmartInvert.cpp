@@ -0,0 +1,372 @@
+#include "SmartInvert.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SMART_INVERT_SSE2 1
+#include <emmintrin.h>
+#endif
+
+// As in PixelKernels.cpp: compiled for every x86 build, used when the CPU supports it
+#if defined(SMART_INVERT_SSE2) && (defined(__GNUC__) || defined(__clang__) || defined(_MSC_VER))
+#define SMART_INVERT_AVX2 1
+#include <immintrin.h>
+#if defined(__GNUC__) || defined(__clang__)
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_AVX2
+#endif
+#endif
+
+namespace {
+
+// Weight of an inverted pixel; blends are in 1/256ths
+const int fullWeight = 256;
+
+// Positions between two tile centers are measured in half pixels, 2 * SMART_INVERT_TILE of them
+const int blendShift = 6;
+static_assert(2 * SMART_INVERT_TILE == 1 << blendShift, "blendShift must match the tile size");
+
+// Pixels [begin, columns) of each row of a tile into 'stats'
+void AccumulateTileScalar(const uint32_t* tile, int width, int begin, int columns, int rows, TileStatistics& stats) {
+    for (int row = 0; row < rows; row++) {
+        const uint32_t* pixels = tile + static_cast<size_t>(row) * width;
+        for (int i = begin; i < columns; i++) {
+            int blue = pixels[i] & 0xFF;
+            int green = (pixels[i] >> 8) & 0xFF;
+            int red = (pixels[i] >> 16) & 0xFF;
+            int luma = PixelLuma(pixels[i]);
+            stats.lumaSum += luma;
+            stats.lumaSquares += luma * luma;
+            stats.saturationSum += (std::max)((std::max)(blue, green), red) - (std::min)((std::min)(blue, green), red);
+            stats.midtones += luma >= SMART_INVERT_MIDTONE_LOW && luma < SMART_INVERT_MIDTONE_HIGH;
+        }
+    }
+}
+
+// One pixel of a fade: (src * (256 - weight) + (255 - src) * weight + 128) / 256 per channel
+inline uint32_t BlendPixel(uint32_t pixel, int weight) {
+    uint32_t result = pixel & 0xFF000000u;
+    for (int shift = 0; shift < 24; shift += 8) {
+        int value = (pixel >> shift) & 0xFF;
+        result |= static_cast<uint32_t>((value * (fullWeight - weight) + (255 - value) * weight + 128) >> 8) << shift;
+    }
+    return result;
+}
+
+// Pixels [i, count) of a fade whose weight goes from 'left' to 'right' across the span between two
+// tile centers; pixel k is 'phase' + 2 * k half pixels past the left center
+void BlendSpanScalar(const uint32_t* src, uint32_t* dst, int i, int count, int left, int right, int phase) {
+    for (; i < count; i++) {
+        int position = phase + 2 * i;
+        dst[i] = BlendPixel(src[i], ((left << blendShift) + (right - left) * position + (1 << (blendShift - 1))) >> blendShift);
+    }
+}
+
+#ifdef SMART_INVERT_SSE2
+// Sum of the four lanes
+inline uint32_t SumLanes(__m128i lanes) {
+    uint32_t values[4];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(values), lanes);
+    return values[0] + values[1] + values[2] + values[3];
+}
+
+// AccumulateTileScalar() four pixels at a time, in 32-bit lanes: luminance as in PixelLuma(),
+// whose products fit in 16 bits, and its square, which does too. Returns the first column left.
+int AccumulateTileSSE2(const uint32_t* tile, int width, int begin, int columns, int rows, TileStatistics& stats) {
+    int end = begin + ((columns - begin) & ~3);
+    if (end == begin)
+        return begin;
+
+    __m128i byteMask = _mm_set1_epi32(0xFF);
+    __m128i lumaSum = _mm_setzero_si128();
+    __m128i lumaSquares = _mm_setzero_si128();
+    __m128i saturationSum = _mm_setzero_si128();
+    __m128i midtones = _mm_setzero_si128();
+    for (int row = 0; row < rows; row++) {
+        const uint32_t* pixels = tile + static_cast<size_t>(row) * width;
+        for (int i = begin; i < end; i += 4) {
+            __m128i pixel = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + i));
+            __m128i blue = _mm_and_si128(pixel, byteMask);
+            __m128i green = _mm_and_si128(_mm_srli_epi32(pixel, 8), byteMask);
+            __m128i red = _mm_and_si128(_mm_srli_epi32(pixel, 16), byteMask);
+            __m128i luma = _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(_mm_mullo_epi16(blue, _mm_set1_epi32(29)),
+                _mm_mullo_epi16(green, _mm_set1_epi32(150))), _mm_add_epi32(_mm_mullo_epi16(red, _mm_set1_epi32(77)),
+                _mm_set1_epi32(128))), 8);
+            lumaSum = _mm_add_epi32(lumaSum, luma);
+            lumaSquares = _mm_add_epi32(lumaSquares, _mm_mullo_epi16(luma, luma));
+            __m128i high = _mm_max_epi16(_mm_max_epi16(blue, green), red);
+            __m128i low = _mm_min_epi16(_mm_min_epi16(blue, green), red);
+            saturationSum = _mm_add_epi32(saturationSum, _mm_sub_epi32(high, low));
+            __m128i midtone = _mm_and_si128(_mm_cmpgt_epi32(luma, _mm_set1_epi32(SMART_INVERT_MIDTONE_LOW - 1)),
+                _mm_cmplt_epi32(luma, _mm_set1_epi32(SMART_INVERT_MIDTONE_HIGH)));
+            midtones = _mm_sub_epi32(midtones, midtone);
+        }
+    }
+
+    stats.lumaSum += SumLanes(lumaSum);
+    stats.lumaSquares += SumLanes(lumaSquares);
+    stats.saturationSum += SumLanes(saturationSum);
+    stats.midtones += SumLanes(midtones);
+    return end;
+}
+
+// BlendSpanScalar() four pixels at a time, as two pairs of pixels in 16-bit lanes. The weight
+// sums and the blend products stay within 16 bits unsigned, so the lanes wrap nowhere.
+int BlendSpanSSE2(const uint32_t* src, uint32_t* dst, int i, int count, int left, int right, int phase) {
+    __m128i zero = _mm_setzero_si128();
+    __m128i base = _mm_set1_epi16(static_cast<short>((left << blendShift) + (1 << (blendShift - 1))));
+    __m128i slope = _mm_set1_epi16(static_cast<short>(right - left));
+    __m128i alphaMask = _mm_set1_epi32(static_cast<int>(0xFF000000u));
+    for (; i + 4 <= count; i += 4) {
+        // Each pixel's position in all four of its channel lanes
+        __m128i position = _mm_set1_epi16(static_cast<short>(phase + 2 * i));
+        __m128i positionLow = _mm_add_epi16(position, _mm_setr_epi16(0, 0, 0, 0, 2, 2, 2, 2));
+        __m128i positionHigh = _mm_add_epi16(position, _mm_setr_epi16(4, 4, 4, 4, 6, 6, 6, 6));
+        __m128i weightLow = _mm_srli_epi16(_mm_add_epi16(base, _mm_mullo_epi16(slope, positionLow)), blendShift);
+        __m128i weightHigh = _mm_srli_epi16(_mm_add_epi16(base, _mm_mullo_epi16(slope, positionHigh)), blendShift);
+
+        __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        __m128i low = _mm_unpacklo_epi8(pixels, zero);
+        __m128i high = _mm_unpackhi_epi8(pixels, zero);
+        low = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(low, _mm_sub_epi16(_mm_set1_epi16(fullWeight), weightLow)),
+            _mm_mullo_epi16(_mm_sub_epi16(_mm_set1_epi16(255), low), weightLow)), _mm_set1_epi16(128)), 8);
+        high = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(high, _mm_sub_epi16(_mm_set1_epi16(fullWeight), weightHigh)),
+            _mm_mullo_epi16(_mm_sub_epi16(_mm_set1_epi16(255), high), weightHigh)), _mm_set1_epi16(128)), 8);
+        __m128i blended = _mm_or_si128(_mm_andnot_si128(alphaMask, _mm_packus_epi16(low, high)), _mm_and_si128(pixels, alphaMask));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), blended);
+    }
+    return i;
+}
+#endif
+
+#ifdef SMART_INVERT_AVX2
+// Sum of the eight lanes
+TARGET_AVX2 inline uint32_t SumLanesAVX2(__m256i lanes) {
+    return SumLanes(_mm_add_epi32(_mm256_castsi256_si128(lanes), _mm256_extracti128_si256(lanes, 1)));
+}
+
+// AccumulateTileSSE2() eight pixels at a time
+TARGET_AVX2 int AccumulateTileAVX2(const uint32_t* tile, int width, int begin, int columns, int rows, TileStatistics& stats) {
+    int end = begin + ((columns - begin) & ~7);
+    if (end == begin)
+        return begin;
+
+    __m256i byteMask = _mm256_set1_epi32(0xFF);
+    __m256i lumaSum = _mm256_setzero_si256();
+    __m256i lumaSquares = _mm256_setzero_si256();
+    __m256i saturationSum = _mm256_setzero_si256();
+    __m256i midtones = _mm256_setzero_si256();
+    for (int row = 0; row < rows; row++) {
+        const uint32_t* pixels = tile + static_cast<size_t>(row) * width;
+        for (int i = begin; i < end; i += 8) {
+            __m256i pixel = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pixels + i));
+            __m256i blue = _mm256_and_si256(pixel, byteMask);
+            __m256i green = _mm256_and_si256(_mm256_srli_epi32(pixel, 8), byteMask);
+            __m256i red = _mm256_and_si256(_mm256_srli_epi32(pixel, 16), byteMask);
+            __m256i luma = _mm256_srli_epi32(_mm256_add_epi32(_mm256_add_epi32(_mm256_mullo_epi16(blue, _mm256_set1_epi32(29)),
+                _mm256_mullo_epi16(green, _mm256_set1_epi32(150))), _mm256_add_epi32(_mm256_mullo_epi16(red, _mm256_set1_epi32(77)),
+                _mm256_set1_epi32(128))), 8);
+            lumaSum = _mm256_add_epi32(lumaSum, luma);
+            lumaSquares = _mm256_add_epi32(lumaSquares, _mm256_mullo_epi16(luma, luma));
+            __m256i high = _mm256_max_epi16(_mm256_max_epi16(blue, green), red);
+            __m256i low = _mm256_min_epi16(_mm256_min_epi16(blue, green), red);
+            saturationSum = _mm256_add_epi32(saturationSum, _mm256_sub_epi32(high, low));
+            __m256i midtone = _mm256_andnot_si256(_mm256_cmpgt_epi32(luma, _mm256_set1_epi32(SMART_INVERT_MIDTONE_HIGH - 1)),
+                _mm256_cmpgt_epi32(luma, _mm256_set1_epi32(SMART_INVERT_MIDTONE_LOW - 1)));
+            midtones = _mm256_sub_epi32(midtones, midtone);
+        }
+    }
+
+    stats.lumaSum += SumLanesAVX2(lumaSum);
+    stats.lumaSquares += SumLanesAVX2(lumaSquares);
+    stats.saturationSum += SumLanesAVX2(saturationSum);
+    stats.midtones += SumLanesAVX2(midtones);
+    return end;
+}
+
+// BlendSpanSSE2() eight pixels at a time. Unpacking works within each 128-bit half, so the
+// low registers hold pixels 0, 1, 4 and 5 and the high ones 2, 3, 6 and 7.
+TARGET_AVX2 int BlendSpanAVX2(const uint32_t* src, uint32_t* dst, int i, int count, int left, int right, int phase) {
+    __m256i zero = _mm256_setzero_si256();
+    __m256i base = _mm256_set1_epi16(static_cast<short>((left << blendShift) + (1 << (blendShift - 1))));
+    __m256i slope = _mm256_set1_epi16(static_cast<short>(right - left));
+    __m256i alphaMask = _mm256_set1_epi32(static_cast<int>(0xFF000000u));
+    for (; i + 8 <= count; i += 8) {
+        __m256i position = _mm256_set1_epi16(static_cast<short>(phase + 2 * i));
+        __m256i positionLow = _mm256_add_epi16(position, _mm256_setr_epi16(0, 0, 0, 0, 2, 2, 2, 2, 8, 8, 8, 8, 10, 10, 10, 10));
+        __m256i positionHigh = _mm256_add_epi16(position, _mm256_setr_epi16(4, 4, 4, 4, 6, 6, 6, 6, 12, 12, 12, 12, 14, 14, 14, 14));
+        __m256i weightLow = _mm256_srli_epi16(_mm256_add_epi16(base, _mm256_mullo_epi16(slope, positionLow)), blendShift);
+        __m256i weightHigh = _mm256_srli_epi16(_mm256_add_epi16(base, _mm256_mullo_epi16(slope, positionHigh)), blendShift);
+
+        __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        __m256i low = _mm256_unpacklo_epi8(pixels, zero);
+        __m256i high = _mm256_unpackhi_epi8(pixels, zero);
+        low = _mm256_srli_epi16(_mm256_add_epi16(_mm256_add_epi16(
+            _mm256_mullo_epi16(low, _mm256_sub_epi16(_mm256_set1_epi16(fullWeight), weightLow)),
+            _mm256_mullo_epi16(_mm256_sub_epi16(_mm256_set1_epi16(255), low), weightLow)), _mm256_set1_epi16(128)), 8);
+        high = _mm256_srli_epi16(_mm256_add_epi16(_mm256_add_epi16(
+            _mm256_mullo_epi16(high, _mm256_sub_epi16(_mm256_set1_epi16(fullWeight), weightHigh)),
+            _mm256_mullo_epi16(_mm256_sub_epi16(_mm256_set1_epi16(255), high), weightHigh)), _mm256_set1_epi16(128)), 8);
+        __m256i blended = _mm256_or_si256(_mm256_andnot_si256(alphaMask, _mm256_packus_epi16(low, high)),
+            _mm256_and_si256(pixels, alphaMask));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), blended);
+    }
+    return i;
+}
+#endif
+
+// One span of a row: copied or inverted when the weight does not change across it, faded otherwise
+void BlendSpan(PixelKernel kernel, const uint32_t* src, uint32_t* dst, int count, int left, int right, int phase) {
+    if (left == right && left == 0) {
+        if (src != dst)
+            memcpy(dst, src, count * sizeof(uint32_t));
+        return;
+    }
+    if (left == right && left == fullWeight) {
+        for (int i = 0; i < count; i++)
+            dst[i] = src[i] ^ 0x00FFFFFFu;
+        return;
+    }
+
+    int i = 0;
+#ifdef SMART_INVERT_AVX2
+    if (kernel == PIXEL_KERNEL_AVX2)
+        i = BlendSpanAVX2(src, dst, i, count, left, right, phase);
+#endif
+#ifdef SMART_INVERT_SSE2
+    if (kernel == PIXEL_KERNEL_SSE2 || kernel == PIXEL_KERNEL_AVX2)
+        i = BlendSpanSSE2(src, dst, i, count, left, right, phase);
+#endif
+    BlendSpanScalar(src, dst, i, count, left, right, phase);
+}
+
+// One row of the image. The tile weights are first interpolated down to the row, then across
+// it: up to the first tile center and past the last the nearest weight holds, and between two
+// centers the span fades from one to the next.
+void SmartInvertRow(PixelKernel kernel, const uint32_t* src, uint32_t* dst, int width, int y, const std::vector<uint8_t>& classes,
+    int tilesAcross, int tilesDown, std::vector<int>& weights) {
+    const int half = SMART_INVERT_TILE / 2;
+    int position = 2 * y + 1 - SMART_INVERT_TILE;
+    int above = position < 0 ? 0 : (std::min)(position >> blendShift, tilesDown - 1);
+    int below = (std::min)(above + 1, tilesDown - 1);
+    int along = position < 0 || above == below ? 0 : position - (above << blendShift);
+    for (int i = 0; i < tilesAcross; i++) {
+        int top = classes[static_cast<size_t>(above) * tilesAcross + i] == TILE_TEXT ? fullWeight : 0;
+        int bottom = classes[static_cast<size_t>(below) * tilesAcross + i] == TILE_TEXT ? fullWeight : 0;
+        weights[i] = ((top << blendShift) + (bottom - top) * along + (1 << (blendShift - 1))) >> blendShift;
+    }
+
+    BlendSpan(kernel, src, dst, (std::min)(half, width), weights[0], weights[0], 0);
+    for (int i = 0; i + 1 < tilesAcross; i++) {
+        int start = i * SMART_INVERT_TILE + half;
+        if (start >= width)
+            break;
+        BlendSpan(kernel, src + start, dst + start, (std::min)(SMART_INVERT_TILE, width - start), weights[i], weights[i + 1], 1);
+    }
+    int last = (tilesAcross - 1) * SMART_INVERT_TILE + half;
+    if (last < width)
+        BlendSpan(kernel, src + last, dst + last, width - last, weights[tilesAcross - 1], weights[tilesAcross - 1], 0);
+}
+
+// Call work(0) .. work(tasks - 1) on the pool, or on this thread without one
+void RunTasks(WorkerPool* pool, int tasks, const std::function<void(int)>& work) {
+    if (pool != NULL) {
+        pool->Run(tasks, work);
+    } else {
+        for (int task = 0; task < tasks; task++)
+            work(task);
+    }
+}
+
+}
+
+const char* TileClassName(int tileClass) {
+    static const char* const names[TILE_CLASS_COUNT] = { "text", "image", "dark" };
+    return tileClass >= 0 && tileClass < TILE_CLASS_COUNT ? names[tileClass] : "";
+}
+
+// Statistics of one tile
+void ComputeTileStatistics(PixelKernel kernel, const uint32_t* pixels, int width, int x0, int y0, int columns, int rows, TileStatistics& stats) {
+    memset(&stats, 0, sizeof(stats));
+    if (columns <= 0 || rows <= 0)
+        return;
+
+    if (!IsPixelKernelAvailable(kernel) || kernel == PIXEL_KERNEL_LUT)
+        kernel = PIXEL_KERNEL_SCALAR;
+    const uint32_t* tile = pixels + static_cast<size_t>(y0) * width + x0;
+    int begin = 0;
+#ifdef SMART_INVERT_AVX2
+    if (kernel == PIXEL_KERNEL_AVX2)
+        begin = AccumulateTileAVX2(tile, width, begin, columns, rows, stats);
+#endif
+#ifdef SMART_INVERT_SSE2
+    if (kernel == PIXEL_KERNEL_SSE2 || kernel == PIXEL_KERNEL_AVX2)
+        begin = AccumulateTileSSE2(tile, width, begin, columns, rows, stats);
+#endif
+    AccumulateTileScalar(tile, width, begin, columns, rows, stats);
+    stats.pixels = static_cast<uint32_t>(columns * rows);
+}
+
+// Class of a tile from its statistics
+TileClass ClassifyTile(const TileStatistics& stats) {
+    uint64_t count = stats.pixels;
+    if (count == 0 || stats.lumaSum < SMART_INVERT_LIGHT_MEAN * count)
+        return TILE_DARK;
+    if (stats.saturationSum > SMART_INVERT_MAX_SATURATION * count)
+        return TILE_IMAGE;
+
+    // count^2 times the variance, so nothing is divided
+    uint64_t spread = count * stats.lumaSquares - static_cast<uint64_t>(stats.lumaSum) * stats.lumaSum;
+    if (spread < SMART_INVERT_FLAT_VARIANCE * count * count)
+        return TILE_TEXT;
+    return static_cast<uint64_t>(stats.midtones) * 100 > SMART_INVERT_MIDTONE_PERCENT * count ? TILE_IMAGE : TILE_TEXT;
+}
+
+// Class of every tile, one row of tiles per task
+void ClassifyTiles(PixelKernel kernel, const uint32_t* pixels, int width, int height, std::vector<uint8_t>& classes, WorkerPool* pool) {
+    int tilesAcross = (width + SMART_INVERT_TILE - 1) / SMART_INVERT_TILE;
+    int tilesDown = (height + SMART_INVERT_TILE - 1) / SMART_INVERT_TILE;
+    classes.resize(static_cast<size_t>(tilesAcross) * tilesDown);
+    if (width <= 0 || height <= 0)
+        return;
+
+    uint8_t* classOut = classes.data();
+    RunTasks(pool, tilesDown, [=](int tileRow) {
+        int y0 = tileRow * SMART_INVERT_TILE;
+        int rows = (std::min)(SMART_INVERT_TILE, height - y0);
+        for (int i = 0; i < tilesAcross; i++) {
+            int x0 = i * SMART_INVERT_TILE;
+            TileStatistics stats;
+            ComputeTileStatistics(kernel, pixels, width, x0, y0, (std::min)(SMART_INVERT_TILE, width - x0), rows, stats);
+            classOut[static_cast<size_t>(tileRow) * tilesAcross + i] = static_cast<uint8_t>(ClassifyTile(stats));
+        }
+    });
+}
+
+// Classify every tile, then invert by the interpolated weights, one row of tiles per task
+void SmartInvertImage(PixelKernel kernel, const uint32_t* src, uint32_t* dst, int width, int height, WorkerPool* pool) {
+    if (width <= 0 || height <= 0)
+        return;
+
+    if (!IsPixelKernelAvailable(kernel) || kernel == PIXEL_KERNEL_LUT)
+        kernel = PIXEL_KERNEL_SCALAR;
+
+    // All of src is classified before any of dst is written, so the two may be the same buffer
+    thread_local std::vector<uint8_t> classes;
+    ClassifyTiles(kernel, src, width, height, classes, pool);
+
+    int tilesAcross = (width + SMART_INVERT_TILE - 1) / SMART_INVERT_TILE;
+    int tilesDown = (height + SMART_INVERT_TILE - 1) / SMART_INVERT_TILE;
+    const std::vector<uint8_t>& tileClasses = classes;
+    RunTasks(pool, tilesDown, [=, &tileClasses](int tileRow) {
+        thread_local std::vector<int> weights;
+        weights.resize(tilesAcross);
+        int last = (std::min)((tileRow + 1) * SMART_INVERT_TILE, height);
+        for (int y = tileRow * SMART_INVERT_TILE; y < last; y++) {
+            size_t offset = static_cast<size_t>(y) * width;
+            SmartInvertRow(kernel, src + offset, dst + offset, width, y, tileClasses, tilesAcross, tilesDown, weights);
+        }
+    });
+}
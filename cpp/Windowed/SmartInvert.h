@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "PixelImage.h"
+#include "PixelKernels.h"
+#include "WorkerPool.h"
+
+// Side of the square tiles the smart inversion classifies, in pixels: a couple of lines of
+// text, small enough to follow the edges of a photo or a dark panel
+#define SMART_INVERT_TILE 32
+
+// Mean luminance from which a tile is light; darker tiles, e.g. dark-mode widgets, are left alone
+#define SMART_INVERT_LIGHT_MEAN 128
+
+// Mean saturation (largest channel minus smallest) above which a tile holds the colors of a
+// photo or a video rather than text, which is mostly gray page with a little colored ink
+#define SMART_INVERT_MAX_SATURATION 24
+
+// Luminance range of the mid-tones, and the percentage of them that marks continuous tone: text
+// is page and ink with anti-aliased edges between, a photo mostly shades in between
+#define SMART_INVERT_MIDTONE_LOW 64
+#define SMART_INVERT_MIDTONE_HIGH 192
+#define SMART_INVERT_MIDTONE_PERCENT 30
+
+// Luminance variance below which a tile is flat: a page margin or a light panel, inverted like
+// the text around it however many mid-tones it has
+#define SMART_INVERT_FLAT_VARIANCE 144
+
+// What a tile holds, as far as the smart inversion is concerned
+enum TileClass {
+    TILE_TEXT,  // Light, gray and two-toned or flat: inverted
+    TILE_IMAGE, // Colorful or continuous tone: left alone
+    TILE_DARK,  // Dark already: left alone
+    TILE_CLASS_COUNT
+};
+
+// Short name for reports: "text", "image" or "dark"
+const char* TileClassName(int tileClass);
+
+// Sums over the pixels of one tile
+struct TileStatistics {
+    uint32_t pixels;
+    uint32_t lumaSum;       // PixelLuma()
+    uint32_t lumaSquares;
+    uint32_t saturationSum; // Largest channel minus smallest
+    uint32_t midtones;      // Pixels with luminance in SMART_INVERT_MIDTONE_LOW..HIGH - 1
+};
+
+// Statistics of the 'columns' x 'rows' pixels from (x0, y0) of a width-wide image, at most
+// SMART_INVERT_TILE square. The vector kernels take four (SSE2) or eight (AVX2) pixels at a time
+// and sum exactly what the scalar one does (LUT runs the scalar code).
+void ComputeTileStatistics(PixelKernel kernel, const uint32_t* pixels, int width, int x0, int y0, int columns, int rows, TileStatistics& stats);
+
+// Class of a tile from its statistics, in integer arithmetic: dark below SMART_INVERT_LIGHT_MEAN,
+// then image if colorful, text if flat, and image if mostly mid-tones
+TileClass ClassifyTile(const TileStatistics& stats);
+
+// Class of every SMART_INVERT_TILE square of a width x height image, the last row and column of
+// tiles cut at the edges, row by row into 'classes' (TileClass values). With a 'pool' the rows
+// of tiles run on its threads, with NULL on the calling one.
+void ClassifyTiles(PixelKernel kernel, const uint32_t* pixels, int width, int height, std::vector<uint8_t>& classes, WorkerPool* pool);
+
+// Inversion of the text tiles of 32-bit BGRA pixels only (ClassifyTiles), so photos, video and
+// content that is dark already keep their colors. Each tile's weight, 1 to invert and 0 not to,
+// is interpolated bilinearly between the tile centers, so where the class changes the image
+// fades from inverted to not over one tile instead of showing a seam; inside runs of one class
+// pixels are copied or inverted outright. The fades are computed in 16-bit fixed point, the same
+// for every kernel. Alpha is passed through. src and dst may be the same buffer.
+void SmartInvertImage(PixelKernel kernel, const uint32_t* src, uint32_t* dst, int width, int height, WorkerPool* pool);
@@ -0,0 +1,50 @@
+#include "StartupProfiler.h"
+#include <cstdio>
+
+StartupProfiler::StartupProfiler() : origin(std::chrono::steady_clock::now()) {
+}
+
+// Move the origin back to account for time spent before main code ran
+void StartupProfiler::SetOrigin(std::chrono::steady_clock::time_point newOrigin) {
+    std::lock_guard<std::mutex> guard(lock);
+    origin = newOrigin;
+}
+
+// Milliseconds since the origin
+double StartupProfiler::ElapsedMs(std::chrono::steady_clock::time_point when) const {
+    std::lock_guard<std::mutex> guard(lock);
+    return std::chrono::duration<double, std::milli>(when - origin).count();
+}
+
+// Record a finished phase
+void StartupProfiler::Record(const char* name, std::chrono::steady_clock::time_point start,
+    std::chrono::steady_clock::time_point end, bool background) {
+    std::lock_guard<std::mutex> guard(lock);
+    Phase phase;
+    phase.name = name;
+    phase.startMs = std::chrono::duration<double, std::milli>(start - origin).count();
+    phase.durationMs = std::chrono::duration<double, std::milli>(end - start).count();
+    phase.background = background;
+    phases.push_back(phase);
+}
+
+// Record a zero-length milestone
+void StartupProfiler::Mark(const char* name) {
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    Record(name, now, now, false);
+}
+
+std::vector<StartupProfiler::Phase> StartupProfiler::GetPhases() const {
+    std::lock_guard<std::mutex> guard(lock);
+    return phases;
+}
+
+// One line per phase
+void StartupProfiler::Write(std::ostream& out) const {
+    for (const Phase& phase : GetPhases()) {
+        char line[256];
+        snprintf(line, sizeof(line), "phase=%s start_ms=%.2f duration_ms=%.2f thread=%s\n",
+            phase.name.c_str(), phase.startMs, phase.durationMs, phase.background ? "background" : "main");
+        out << line;
+    }
+}
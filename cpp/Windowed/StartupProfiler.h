@@ -0,0 +1,66 @@
+#pragma once
+
+#include <chrono>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Records how long each startup phase takes, on whichever thread runs it.
+// Times are milliseconds since the origin, normally the moment the process was created.
+class StartupProfiler {
+public:
+    struct Phase {
+        std::string name;
+        double startMs;
+        double durationMs;
+        bool background; // Ran on the background initializer thread
+    };
+
+private:
+    mutable std::mutex lock;
+    std::chrono::steady_clock::time_point origin;
+    std::vector<Phase> phases;
+
+public:
+    StartupProfiler();
+
+    // Move the origin back to account for time spent before main code ran
+    void SetOrigin(std::chrono::steady_clock::time_point newOrigin);
+
+    // Milliseconds since the origin
+    double ElapsedMs(std::chrono::steady_clock::time_point when) const;
+    double ElapsedMs() const { return ElapsedMs(std::chrono::steady_clock::now()); }
+
+    // Record a finished phase
+    void Record(const char* name, std::chrono::steady_clock::time_point start,
+        std::chrono::steady_clock::time_point end, bool background);
+
+    // Record a zero-length milestone, such as the first filtered frame
+    void Mark(const char* name);
+
+    std::vector<Phase> GetPhases() const;
+
+    // One "phase=<name> start_ms=<t> duration_ms=<d> thread=<main|background>" line per phase
+    void Write(std::ostream& out) const;
+};
+
+// Times the enclosing scope as one startup phase
+class StartupPhase {
+private:
+    StartupProfiler& profiler;
+    const char* name;
+    bool background;
+    std::chrono::steady_clock::time_point start;
+
+public:
+    StartupPhase(StartupProfiler& owner, const char* phaseName, bool onBackgroundThread = false)
+        : profiler(owner), name(phaseName), background(onBackgroundThread), start(std::chrono::steady_clock::now()) {}
+
+    ~StartupPhase() {
+        profiler.Record(name, start, std::chrono::steady_clock::now(), background);
+    }
+
+    StartupPhase(const StartupPhase&) = delete;
+    StartupPhase& operator=(const StartupPhase&) = delete;
+};
@@ -0,0 +1,204 @@
+#include "SyntheticDesktop.h"
+#include <algorithm>
+
+namespace {
+
+const char* const scenarioNames[SCENARIO_COUNT] = {
+    "static_document", "smooth_scroll", "jump_scroll", "blinking_cursor", "video", "window_drag", "flash", "mixed", "theme_switch"
+};
+
+// Text metrics in pixels, the same at every resolution
+const int LINE_HEIGHT = 20;
+const int CHAR_WIDTH = 9;
+const int MARGIN = 40;
+
+const uint32_t PAGE_COLOR = 0xFFF8F6F0u;   // Off-white
+const uint32_t INK_COLOR = 0xFF1E1E1Eu;
+const uint32_t TITLE_BAR_COLOR = 0xFF202020u;
+const uint32_t WINDOW_COLOR = 0xFFE8E8E8u;
+const uint32_t BORDER_COLOR = 0xFF404040u;
+
+uint32_t Hash(uint32_t a, uint32_t b, uint32_t c) {
+    uint32_t h = a * 0x9E3779B1u ^ (b + 0x7F4A7C15u) * 0x85EBCA77u ^ (c + 0x165667B1u) * 0xC2B2AE3Du;
+    h ^= h >> 16;
+    h *= 0x7FEB352Du;
+    h ^= h >> 15;
+    h *= 0x846CA68Bu;
+    h ^= h >> 16;
+    return h;
+}
+
+// Position along a back-and-forth path of length 'range'
+int PingPong(uint64_t step, int range) {
+    if (range <= 0)
+        return 0;
+    int phase = static_cast<int>(step % (2 * static_cast<uint64_t>(range)));
+    return phase < range ? phase : 2 * range - phase;
+}
+
+RECT MakeRect(int left, int top, int width, int height) {
+    RECT rect = { left, top, left + width, top + height };
+    return rect;
+}
+
+// Fill the part of 'rect' on screen row y, within the rendered region
+void FillSpan(uint32_t* row, const RECT& region, int y, const RECT& rect, uint32_t color) {
+    if (y < rect.top || y >= rect.bottom)
+        return;
+    int left = (std::max<int>)(rect.left, region.left);
+    int right = (std::min<int>)(rect.right, region.right);
+    for (int x = left; x < right; x++)
+        row[x - region.left] = color;
+}
+
+}
+
+// Short name such as "smooth_scroll"
+const char* SyntheticScenarioName(SyntheticScenario scenario) {
+    return (scenario >= 0 && scenario < SCENARIO_COUNT) ? scenarioNames[scenario] : "unknown";
+}
+
+bool ParseSyntheticScenario(const std::string& name, SyntheticScenario& scenario) {
+    for (int i = 0; i < SCENARIO_COUNT; i++) {
+        if (name == scenarioNames[i]) {
+            scenario = static_cast<SyntheticScenario>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+SyntheticDesktop::SyntheticDesktop(int desktopWidth, int desktopHeight, SyntheticScenario desktopScenario, uint32_t randomSeed)
+    : width(desktopWidth), height(desktopHeight), scenario(desktopScenario), seed(randomSeed) {
+}
+
+SyntheticDesktop::FrameLayout SyntheticDesktop::LayoutFor(uint64_t frameIndex) const {
+    bool mixed = scenario == SCENARIO_MIXED;
+    FrameLayout layout = {};
+
+    if (scenario == SCENARIO_SMOOTH_SCROLL || mixed)
+        layout.scrollOffset = static_cast<int>((frameIndex * 2) % 1000000);
+    else if (scenario == SCENARIO_JUMP_SCROLL)
+        layout.scrollOffset = static_cast<int>((frameIndex / 30) * 3 * LINE_HEIGHT % 1000000);
+
+    // Mixed flashes less often so the other content is visible most of the time
+    if (scenario == SCENARIO_FLASH)
+        layout.flash = frameIndex % 60 < 2;
+    else if (mixed)
+        layout.flash = frameIndex % 240 < 2;
+
+    if (scenario == SCENARIO_THEME_SWITCH)
+        layout.dark = frameIndex % 240 >= 120;
+
+    if (scenario == SCENARIO_BLINKING_CURSOR || mixed) {
+        layout.cursorVisible = (frameIndex / 30) % 2 == 0;
+        layout.cursor = MakeRect(MARGIN + 12 * CHAR_WIDTH, 5 * LINE_HEIGHT + 2, 2, LINE_HEIGHT - 4);
+    }
+
+    if (scenario == SCENARIO_VIDEO || mixed) {
+        layout.hasVideo = true;
+        layout.video = MakeRect(width * 55 / 100, height * 15 / 100, width * 35 / 100, height * 35 / 100);
+    }
+
+    if (scenario == SCENARIO_WINDOW_DRAG || mixed) {
+        int windowWidth = (std::max)(width / 5, 64);
+        int windowHeight = (std::max)(height / 4, 48);
+        layout.hasWindow = true;
+        layout.window = MakeRect(PingPong(frameIndex * 8, width - windowWidth), PingPong(frameIndex * 5, height - windowHeight),
+            windowWidth, windowHeight);
+    }
+    return layout;
+}
+
+// Render 'region' of frame 'frameIndex'; pixels outside the desktop are black
+void SyntheticDesktop::Render(uint64_t frameIndex, const RECT& region, PixelImage& frame) const {
+    int regionWidth = (std::max<int>)(region.right - region.left, 0);
+    int regionHeight = (std::max<int>)(region.bottom - region.top, 0);
+    frame.Resize(regionWidth, regionHeight);
+
+    FrameLayout layout = LayoutFor(frameIndex);
+    uint32_t pageColor = layout.dark ? INK_COLOR : PAGE_COLOR;
+    uint32_t inkColor = layout.dark ? PAGE_COLOR : INK_COLOR;
+    uint32_t frame32 = static_cast<uint32_t>(frameIndex);
+
+    for (int y = region.top; y < region.bottom; y++) {
+        uint32_t* row = &frame.pixels[static_cast<size_t>(y - region.top) * regionWidth];
+
+        if (y < 0 || y >= height) {
+            std::fill(row, row + regionWidth, 0xFF000000u);
+            continue;
+        }
+        if (layout.flash) {
+            std::fill(row, row + regionWidth, 0xFFFFFFFFu);
+            continue;
+        }
+
+        // Document text: each line has its own length and each character cell a 3x5 glyph
+        int documentY = y + layout.scrollOffset;
+        uint32_t line = static_cast<uint32_t>(documentY / LINE_HEIGHT);
+        int cellY = documentY % LINE_HEIGHT;
+        int lineLength = 20 + static_cast<int>(Hash(seed, line, 0xFFFFFFFFu) % 140);
+        bool glyphRow = cellY >= 5 && cellY < 15;
+        int glyphY = (cellY - 5) / 2;
+
+        for (int x = region.left; x < region.right; x++) {
+            uint32_t color = pageColor;
+            int documentX = x - MARGIN;
+            if (x < 0 || x >= width) {
+                color = 0xFF000000u;
+            } else if (glyphRow && documentX >= 0) {
+                int column = documentX / CHAR_WIDTH;
+                int cellX = documentX % CHAR_WIDTH;
+                if (column < lineLength && cellX >= 1 && cellX < 7) {
+                    uint32_t glyph = Hash(seed, line, static_cast<uint32_t>(column));
+                    // One cell in six is a space
+                    if (glyph % 6 != 0 && ((glyph >> (glyphY * 3 + (cellX - 1) / 2)) & 1) != 0)
+                        color = inkColor;
+                }
+            }
+            row[x - region.left] = color;
+        }
+
+        if (layout.cursorVisible)
+            FillSpan(row, region, y, layout.cursor, INK_COLOR);
+
+        if (layout.hasVideo && y >= layout.video.top && y < layout.video.bottom) {
+            int left = (std::max<int>)(layout.video.left, region.left);
+            int right = (std::min<int>)(layout.video.right, region.right);
+            for (int x = left; x < right; x++) {
+                // Moving gradient plus per-frame noise, like decoded video
+                uint32_t noise = Hash(static_cast<uint32_t>(x), static_cast<uint32_t>(y), frame32) & 0x3F;
+                uint32_t r = (static_cast<uint32_t>(x) + frame32 * 3) & 0xFF;
+                uint32_t g = (static_cast<uint32_t>(y) + frame32 * 2) & 0xFF;
+                uint32_t b = 96 + noise;
+                row[x - region.left] = 0xFF000000u | (r << 16) | (g << 8) | b;
+            }
+        }
+
+        if (layout.hasWindow) {
+            const RECT& window = layout.window;
+            RECT titleBar = MakeRect(window.left, window.top, window.right - window.left, 24);
+            FillSpan(row, region, y, window, BORDER_COLOR);
+            RECT client = { window.left + 1, window.top + 1, window.right - 1, window.bottom - 1 };
+            FillSpan(row, region, y, client, WINDOW_COLOR);
+            FillSpan(row, region, y, titleBar, TITLE_BAR_COLOR);
+        }
+    }
+}
+
+// Render the whole desktop
+void SyntheticDesktop::Render(uint64_t frameIndex, PixelImage& frame) const {
+    RECT all = { 0, 0, width, height };
+    Render(frameIndex, all, frame);
+}
+
+RECT SyntheticFrameSource::GetBounds() const {
+    RECT bounds = { 0, 0, desktop.GetWidth(), desktop.GetHeight() };
+    return bounds;
+}
+
+bool SyntheticFrameSource::Capture(const RECT& region, PixelImage& frame) {
+    desktop.Render(frameIndex, region, frame);
+    frameIndex++;
+    return true;
+}
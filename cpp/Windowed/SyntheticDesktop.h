@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include "FrameSource.h"
+
+// Workloads the synthetic desktop can produce
+enum SyntheticScenario {
+    SCENARIO_STATIC_DOCUMENT, // A page of text that never changes
+    SCENARIO_SMOOTH_SCROLL,   // Text scrolling 2 pixels per frame
+    SCENARIO_JUMP_SCROLL,     // Text scrolling three lines at a time, twice a second
+    SCENARIO_BLINKING_CURSOR, // Static text with a caret toggling every 30 frames
+    SCENARIO_VIDEO,           // Static text with a rectangle whose every pixel changes each frame
+    SCENARIO_WINDOW_DRAG,     // A window moving across static text
+    SCENARIO_FLASH,           // Static text with a two-frame full-screen white flash every second
+    SCENARIO_MIXED,           // All of the above at once
+    SCENARIO_THEME_SWITCH,    // Static text whose page turns dark, with light text, for two seconds in four
+    SCENARIO_COUNT
+};
+
+// Short name such as "smooth_scroll"
+const char* SyntheticScenarioName(SyntheticScenario scenario);
+bool ParseSyntheticScenario(const std::string& name, SyntheticScenario& scenario);
+
+// Deterministic desktop contents: every pixel is a pure function of the scenario, seed,
+// frame index and position, so any frame or region renders identically on every machine.
+// Frames are nominally 1/60 s apart.
+class SyntheticDesktop {
+private:
+    int width;
+    int height;
+    SyntheticScenario scenario;
+    uint32_t seed;
+
+    // What is on screen in a given frame
+    struct FrameLayout {
+        int scrollOffset;
+        bool flash;
+        bool dark;
+        bool cursorVisible;
+        RECT cursor;
+        RECT video;
+        RECT window;
+        bool hasVideo;
+        bool hasWindow;
+    };
+
+    FrameLayout LayoutFor(uint64_t frameIndex) const;
+
+public:
+    SyntheticDesktop(int desktopWidth, int desktopHeight, SyntheticScenario desktopScenario, uint32_t randomSeed = 1);
+
+    int GetWidth() const { return width; }
+    int GetHeight() const { return height; }
+    SyntheticScenario GetScenario() const { return scenario; }
+
+    // Render 'region' of frame 'frameIndex'; pixels outside the desktop are black
+    void Render(uint64_t frameIndex, const RECT& region, PixelImage& frame) const;
+
+    // Render the whole desktop
+    void Render(uint64_t frameIndex, PixelImage& frame) const;
+};
+
+// Headless FrameSource that plays a synthetic desktop one frame per capture
+class SyntheticFrameSource : public FrameSource {
+private:
+    const SyntheticDesktop& desktop;
+    uint64_t frameIndex;
+
+public:
+    explicit SyntheticFrameSource(const SyntheticDesktop& source, uint64_t firstFrame = 0)
+        : desktop(source), frameIndex(firstFrame) {}
+
+    uint64_t GetFrameIndex() const { return frameIndex; }
+
+    RECT GetBounds() const override;
+    bool Capture(const RECT& region, PixelImage& frame) override;
+};
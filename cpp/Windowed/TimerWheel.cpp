@@ -0,0 +1,162 @@
+#include "TimerWheel.h"
+
+TimerWheel::TimerWheel(int64_t tickLengthMs, size_t capacity)
+    : tickMs(tickLengthMs > 0 ? tickLengthMs : 1), currentTick(0), freeList(none), pendingCount(0), firedCount(0),
+      cancelledCount(0), cascadedCount(0) {
+    pool.reserve(capacity);
+    for (int i = 0; i < levels * slotsPerLevel; i++) {
+        heads[i] = none;
+        tails[i] = none;
+    }
+}
+
+// Append a timer to the slot its distance from the current tick falls in
+void TimerWheel::Link(int32_t index) {
+    Timer& timer = pool[index];
+    uint64_t delta = timer.expiryTick - currentTick;
+
+    int level = 0;
+    uint64_t placedTick = timer.expiryTick;
+    while (level < levels - 1 && delta >= (1ull << (levelBits * (level + 1))))
+        level++;
+    if (delta >= (1ull << (levelBits * levels))) {
+        // Beyond the top level: park in its furthest slot and re-place when that cascades
+        placedTick = currentTick + (1ull << (levelBits * levels)) - 1;
+    }
+
+    int slot = level * slotsPerLevel + static_cast<int>((placedTick >> (levelBits * level)) & (slotsPerLevel - 1));
+    timer.slot = static_cast<int16_t>(slot);
+    timer.next = none;
+    timer.previous = tails[slot];
+    if (tails[slot] != none)
+        pool[tails[slot]].next = index;
+    else
+        heads[slot] = index;
+    tails[slot] = index;
+}
+
+void TimerWheel::Unlink(int32_t index) {
+    Timer& timer = pool[index];
+    if (timer.previous != none)
+        pool[timer.previous].next = timer.next;
+    else
+        heads[timer.slot] = timer.next;
+    if (timer.next != none)
+        pool[timer.next].previous = timer.previous;
+    else
+        tails[timer.slot] = timer.previous;
+    timer.slot = -1;
+}
+
+void TimerWheel::Release(int32_t index) {
+    Timer& timer = pool[index];
+    timer.generation++;
+    timer.next = freeList;
+    freeList = index;
+    pendingCount--;
+}
+
+int32_t TimerWheel::Lookup(TimerHandle handle) const {
+    if (handle == 0)
+        return none;
+    uint64_t index = (handle & 0xFFFFFFFFu) - 1;
+    if (index >= pool.size())
+        return none;
+    const Timer& timer = pool[index];
+    if (timer.slot < 0 || timer.generation != static_cast<uint32_t>(handle >> 32))
+        return none;
+    return static_cast<int32_t>(index);
+}
+
+TimerHandle TimerWheel::Schedule(int64_t nowMs, int64_t delayMs, Callback callback, void* context) {
+    // With nothing pending the wheel may not have been advanced for a while; catch up for free
+    uint64_t nowTick = nowMs > 0 ? static_cast<uint64_t>(nowMs / tickMs) : 0;
+    if (pendingCount == 0 && nowTick > currentTick)
+        currentTick = nowTick;
+
+    // Round up, so a timer never fires before its time
+    int64_t dueMs = nowMs + (delayMs > 0 ? delayMs : 0);
+    uint64_t expiryTick = dueMs > 0 ? static_cast<uint64_t>((dueMs + tickMs - 1) / tickMs) : 0;
+    if (expiryTick <= currentTick)
+        expiryTick = currentTick + 1;
+
+    int32_t index;
+    if (freeList != none) {
+        index = freeList;
+        freeList = pool[index].next;
+    } else {
+        index = static_cast<int32_t>(pool.size());
+        Timer timer = {};
+        timer.generation = 1;
+        pool.push_back(timer);
+    }
+
+    Timer& timer = pool[index];
+    timer.expiryTick = expiryTick;
+    timer.callback = callback;
+    timer.context = context;
+    Link(index);
+    pendingCount++;
+    return (static_cast<uint64_t>(timer.generation) << 32) | static_cast<uint64_t>(index + 1);
+}
+
+bool TimerWheel::Cancel(TimerHandle handle) {
+    int32_t index = Lookup(handle);
+    if (index == none)
+        return false;
+    Unlink(index);
+    Release(index);
+    cancelledCount++;
+    return true;
+}
+
+void TimerWheel::Reschedule(TimerHandle& handle, int64_t nowMs, int64_t delayMs, Callback callback, void* context) {
+    Cancel(handle);
+    handle = Schedule(nowMs, delayMs, callback, context);
+}
+
+// Move the timers of the current slot of a level down to where their distance now puts them
+void TimerWheel::Cascade(int level) {
+    int slot = level * slotsPerLevel + static_cast<int>((currentTick >> (levelBits * level)) & (slotsPerLevel - 1));
+    int32_t index = heads[slot];
+    heads[slot] = none;
+    tails[slot] = none;
+    while (index != none) {
+        int32_t next = pool[index].next;
+        Link(index);
+        cascadedCount++;
+        index = next;
+    }
+}
+
+size_t TimerWheel::Advance(int64_t nowMs) {
+    uint64_t nowTick = nowMs > 0 ? static_cast<uint64_t>(nowMs / tickMs) : 0;
+    size_t fired = 0;
+
+    while (currentTick < nowTick) {
+        if (pendingCount == 0) {
+            currentTick = nowTick;
+            break;
+        }
+        currentTick++;
+
+        // Higher levels first, so timers can cascade through several levels in one tick
+        for (int level = levels - 1; level > 0; level--) {
+            if ((currentTick & ((1ull << (levelBits * level)) - 1)) == 0)
+                Cascade(level);
+        }
+
+        int slot = static_cast<int>(currentTick & (slotsPerLevel - 1));
+        while (heads[slot] != none) {
+            int32_t index = heads[slot];
+            Callback callback = pool[index].callback;
+            void* context = pool[index].context;
+            Unlink(index);
+            Release(index);
+            firedCount++;
+            fired++;
+            callback(context);
+        }
+    }
+    return fired;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Refers to a scheduled timer; 0 refers to none. A handle stays safe to cancel after its timer
+// fired or was cancelled: the slot it named may be reused, but not under the same handle.
+typedef uint64_t TimerHandle;
+
+// In-process timers driven by a periodic tick, so any number of them cost no OS timer and no
+// wakeup of their own: everything due by a tick fires in that tick.
+//
+// Hierarchical timing wheel: four levels of 64 slots, each slot spanning 64 times the ticks of
+// the level below, cover 64^4 ticks (about 74 hours at 16 ms). A timer goes into the level its
+// distance fits, and moves down a level each time the level below wraps round to its slot, so
+// scheduling and cancelling are O(1) and a tick touches only the timers due in it plus those
+// cascading down. Timers live in a pool that is reused, so after warm-up nothing is allocated.
+//
+// Times are in milliseconds of the caller's clock. A timer never fires early; it fires on the
+// first Advance() at or after its due time, rounded up to the tick.
+class TimerWheel {
+public:
+    typedef void (*Callback)(void* context);
+
+private:
+    static const int levelBits = 6;
+    static const int slotsPerLevel = 1 << levelBits;
+    static const int levels = 4;
+    static const int32_t none = -1;
+
+    struct Timer {
+        uint64_t expiryTick;
+        Callback callback;
+        void* context;
+        int32_t next;
+        int32_t previous;
+        uint32_t generation; // Bumped whenever the node is released, so old handles stop matching
+        int16_t slot;        // Index into heads and tails, or -1 when not scheduled
+    };
+
+    int64_t tickMs;
+    uint64_t currentTick;  // Ticks up to here have fired
+    std::vector<Timer> pool;
+    int32_t freeList;
+    int32_t heads[levels * slotsPerLevel]; // Each slot's timers, in the order they were linked
+    int32_t tails[levels * slotsPerLevel];
+    size_t pendingCount;
+    uint64_t firedCount;
+    uint64_t cancelledCount;
+    uint64_t cascadedCount;
+
+    void Link(int32_t index);
+    void Unlink(int32_t index);
+    void Release(int32_t index);
+    int32_t Lookup(TimerHandle handle) const;
+    void Cascade(int level);
+
+public:
+    // 'tickLengthMs' is the period Advance() is called at, e.g. the frame interval
+    explicit TimerWheel(int64_t tickLengthMs, size_t capacity = 32);
+
+    // Run 'callback(context)' once, 'delayMs' after 'nowMs'
+    TimerHandle Schedule(int64_t nowMs, int64_t delayMs, Callback callback, void* context);
+
+    // Cancel a pending timer; false if it already fired or was cancelled
+    bool Cancel(TimerHandle handle);
+
+    // Schedule, superseding the timer 'handle' refers to, and point 'handle' at the new one.
+    // E.g. a title message cancels the reset the previous message scheduled.
+    void Reschedule(TimerHandle& handle, int64_t nowMs, int64_t delayMs, Callback callback, void* context);
+
+    bool IsPending(TimerHandle handle) const { return Lookup(handle) != none; }
+
+    // Fire every timer due by 'nowMs', in order of due tick. Callbacks may schedule and cancel
+    // timers; ones they schedule for now fire on the next call. Returns the number fired.
+    size_t Advance(int64_t nowMs);
+
+    size_t GetPendingCount() const { return pendingCount; }
+    uint64_t GetFiredCount() const { return firedCount; }
+    uint64_t GetCancelledCount() const { return cancelledCount; }
+
+    // Timers moved down a level; at most three moves each, unless scheduled beyond the top level
+    uint64_t GetCascadedCount() const { return cascadedCount; }
+};
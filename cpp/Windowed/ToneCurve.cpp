@@ -0,0 +1,173 @@
+#include "ToneCurve.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+namespace {
+
+const int maxFileEntries = 65536;
+
+// Linear interpolation of one channel of a .cube table at position 'x' (0..1 of its domain)
+double SampleTable(const std::vector<float>& table, int channel, int entries, double x) {
+    double position = (std::min)((std::max)(x, 0.0), 1.0) * (entries - 1);
+    int index = (std::min)(static_cast<int>(position), entries - 2);
+    double fraction = position - index;
+    return table[index * 3 + channel] * (1.0 - fraction) + table[(index + 1) * 3 + channel] * fraction;
+}
+
+}
+
+// The identity curve
+ToneCurve::ToneCurve() : levels(3 * TONE_CURVE_SIZE) {
+    for (int channel = 0; channel < 3; channel++) {
+        for (int i = 0; i < TONE_CURVE_SIZE; i++)
+            Channel(channel)[i] = static_cast<float>(255.0 * i / (TONE_CURVE_SIZE - 1));
+    }
+}
+
+// Output (0..1) of a curve for input 'x' (0..1)
+double EvaluateToneCurve(const ToneCurveParameters& parameters, double x) {
+    // Levels; a white point at or below the black point is a hard threshold
+    double range = static_cast<double>(parameters.whitePoint) - parameters.blackPoint;
+    double value = range > 0.0 ? (x - parameters.blackPoint) / range : (x >= parameters.blackPoint ? 1.0 : 0.0);
+    value = (std::min)((std::max)(value, 0.0), 1.0);
+
+    if (parameters.gamma > 0.0f && parameters.gamma != 1.0f)
+        value = std::pow(value, 1.0 / parameters.gamma);
+
+    // x^c / (x^c + (1 - x)^c): keeps 0, 0.5 and 1, with slope c at 0.5
+    if (parameters.contrast > 0.0f && parameters.contrast != 1.0f) {
+        double rising = std::pow(value, static_cast<double>(parameters.contrast));
+        double falling = std::pow(1.0 - value, static_cast<double>(parameters.contrast));
+        value = rising / (rising + falling);
+    }
+    return value;
+}
+
+// Tabulate a curve per channel
+void GenerateToneCurve(const ToneCurveParameters& red, const ToneCurveParameters& green, const ToneCurveParameters& blue, ToneCurve& curve) {
+    const ToneCurveParameters* channels[3] = { &red, &green, &blue };
+    for (int channel = 0; channel < 3; channel++) {
+        float* levels = curve.Channel(channel);
+        for (int i = 0; i < TONE_CURVE_SIZE; i++)
+            levels[i] = static_cast<float>(255.0 * EvaluateToneCurve(*channels[channel], static_cast<double>(i) / (TONE_CURVE_SIZE - 1)));
+    }
+}
+
+// Read a 1D LUT in the .cube format
+bool ParseToneCurve(std::istream& input, ToneCurve& curve, std::string& error) {
+    double domainMin[3] = { 0.0, 0.0, 0.0 };
+    double domainMax[3] = { 1.0, 1.0, 1.0 };
+    int entries = 0;
+    std::vector<float> table;
+
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(input, line)) {
+        lineNumber++;
+        size_t comment = line.find('#');
+        if (comment != std::string::npos)
+            line.erase(comment);
+
+        std::istringstream fields(line);
+        std::string keyword;
+        if (!(fields >> keyword))
+            continue;
+
+        std::string trailing;
+        if (keyword == "TITLE") {
+            continue;
+        } else if (keyword == "LUT_1D_SIZE") {
+            if (entries != 0) {
+                error = "Line " + std::to_string(lineNumber) + ": LUT_1D_SIZE is set twice";
+                return false;
+            }
+            if (!(fields >> entries) || (fields >> trailing) || entries < 2 || entries > maxFileEntries) {
+                error = "Line " + std::to_string(lineNumber) + ": LUT_1D_SIZE must be a number from 2 to " + std::to_string(maxFileEntries);
+                return false;
+            }
+            table.reserve(static_cast<size_t>(entries) * 3);
+        } else if (keyword == "LUT_3D_SIZE") {
+            error = "Line " + std::to_string(lineNumber) + ": 3D LUTs are not supported, only per-channel 1D curves";
+            return false;
+        } else if (keyword == "DOMAIN_MIN" || keyword == "DOMAIN_MAX") {
+            double* domain = keyword == "DOMAIN_MIN" ? domainMin : domainMax;
+            if (!(fields >> domain[0] >> domain[1] >> domain[2]) || (fields >> trailing)) {
+                error = "Line " + std::to_string(lineNumber) + ": " + keyword + " needs three numbers";
+                return false;
+            }
+        } else {
+            // A row of the table
+            std::istringstream values(line);
+            float rgb[3];
+            if (!(values >> rgb[0] >> rgb[1] >> rgb[2]) || (values >> trailing)) {
+                error = "Line " + std::to_string(lineNumber) + ": expected three numbers or a keyword";
+                return false;
+            }
+            if (entries == 0) {
+                error = "Line " + std::to_string(lineNumber) + ": LUT_1D_SIZE must come before the table";
+                return false;
+            }
+            if (table.size() == static_cast<size_t>(entries) * 3) {
+                error = "Line " + std::to_string(lineNumber) + ": more than " + std::to_string(entries) + " entries";
+                return false;
+            }
+            for (int channel = 0; channel < 3; channel++)
+                table.push_back((std::min)((std::max)(rgb[channel], 0.0f), 1.0f));
+        }
+    }
+
+    if (entries == 0) {
+        error = "No LUT_1D_SIZE line";
+        return false;
+    }
+    if (table.size() != static_cast<size_t>(entries) * 3) {
+        error = "Expected " + std::to_string(entries) + " entries, found " + std::to_string(table.size() / 3);
+        return false;
+    }
+    for (int channel = 0; channel < 3; channel++) {
+        if (!(domainMax[channel] > domainMin[channel])) {
+            error = "DOMAIN_MAX must be above DOMAIN_MIN";
+            return false;
+        }
+    }
+
+    for (int channel = 0; channel < 3; channel++) {
+        float* levels = curve.Channel(channel);
+        double scale = 1.0 / (domainMax[channel] - domainMin[channel]);
+        for (int i = 0; i < TONE_CURVE_SIZE; i++) {
+            double x = (static_cast<double>(i) / (TONE_CURVE_SIZE - 1) - domainMin[channel]) * scale;
+            levels[i] = static_cast<float>(255.0 * SampleTable(table, channel, entries, x));
+        }
+    }
+    return true;
+}
+
+// Load a .cube file
+bool LoadToneCurveFile(const char* path, ToneCurve& curve, std::string& error) {
+    std::ifstream curveFile(path);
+    if (!curveFile.is_open()) {
+        error = std::string("Cannot open ") + path;
+        return false;
+    }
+    return ParseToneCurve(curveFile, curve, error);
+}
+
+// Write 'curve' as a .cube file
+bool SaveToneCurveFile(const char* path, const ToneCurve& curve) {
+    std::ofstream curveFile(path);
+    if (!curveFile.is_open())
+        return false;
+
+    curveFile << "# Screen Filter tone curve: output of red, green and blue for evenly spaced inputs\n";
+    curveFile << "LUT_1D_SIZE " << TONE_CURVE_SIZE << "\n";
+    char row[64];
+    for (int i = 0; i < TONE_CURVE_SIZE; i++) {
+        snprintf(row, sizeof(row), "%.6f %.6f %.6f\n", curve.Channel(0)[i] / 255.0, curve.Channel(1)[i] / 255.0, curve.Channel(2)[i] / 255.0);
+        curveFile << row;
+    }
+    return curveFile.good();
+}
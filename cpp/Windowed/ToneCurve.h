@@ -0,0 +1,55 @@
+#pragma once
+
+#include <istream>
+#include <string>
+#include <vector>
+
+// Entries per channel of a tone curve: sixteen per 8-bit level, so a curve applied to the
+// unrounded matrix output keeps the precision the 8-bit levels would lose
+#define TONE_CURVE_SIZE 4096
+
+// Shape of a generated curve for one channel. Applied in order: levels, gamma, contrast.
+struct ToneCurveParameters {
+    float blackPoint; // Input (0..1) that becomes black; darker inputs clip
+    float whitePoint; // Input (0..1) that becomes white; brighter inputs clip
+    float gamma;      // Mid-tone exponent as in a levels dialog: above 1 brightens, below 1 darkens
+    float contrast;   // Slope of an S-curve at mid gray that keeps black and white: 1 is straight
+
+    ToneCurveParameters() : blackPoint(0.0f), whitePoint(1.0f), gamma(1.0f), contrast(1.0f) {}
+
+    bool IsIdentity() const { return blackPoint == 0.0f && whitePoint == 1.0f && gamma == 1.0f && contrast == 1.0f; }
+};
+
+// Output level (0..255, unrounded) of each channel for TONE_CURVE_SIZE evenly spaced inputs:
+// entry i of a channel is the output for input level 255 * i / (TONE_CURVE_SIZE - 1). A matrix
+// that cannot express curves (contrast, gamma, black and white points) is followed by one of
+// these in the pixel kernels; see ApplyColorMatrixAndCurve.
+struct ToneCurve {
+    std::vector<float> levels; // Red, then green, then blue
+
+    // The identity curve
+    ToneCurve();
+
+    const float* Channel(int channel) const { return levels.data() + channel * TONE_CURVE_SIZE; }
+    float* Channel(int channel) { return levels.data() + channel * TONE_CURVE_SIZE; }
+};
+
+// Output (0..1) of a curve with 'parameters' for input 'x' (0..1), in double precision. This is
+// what GenerateToneCurve tabulates.
+double EvaluateToneCurve(const ToneCurveParameters& parameters, double x);
+
+// Tabulate a curve per channel
+void GenerateToneCurve(const ToneCurveParameters& red, const ToneCurveParameters& green, const ToneCurveParameters& blue, ToneCurve& curve);
+
+// Read a 1D LUT in the .cube format used by grading tools: optional TITLE, DOMAIN_MIN and
+// DOMAIN_MAX lines, LUT_1D_SIZE N (2..65536), then N lines of "r g b" outputs in 0..1; '#'
+// starts a comment. The table is resampled to TONE_CURVE_SIZE entries with linear
+// interpolation. On failure 'curve' is unchanged and 'error' says what was wrong, with the
+// line number.
+bool ParseToneCurve(std::istream& input, ToneCurve& curve, std::string& error);
+
+// Load a .cube file; returns false with 'error' set if it could not be opened or parsed
+bool LoadToneCurveFile(const char* path, ToneCurve& curve, std::string& error);
+
+// Write 'curve' as a .cube file with TONE_CURVE_SIZE entries, readable by LoadToneCurveFile
+bool SaveToneCurveFile(const char* path, const ToneCurve& curve);
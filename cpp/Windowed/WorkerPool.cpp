@@ -0,0 +1,76 @@
+#include "WorkerPool.h"
+
+#include <algorithm>
+
+WorkerPool::WorkerPool(int threads)
+    : stopping(false), job(NULL), jobTasks(0), jobNumber(0), busyWorkers(0), nextTask(0) {
+    if (threads <= 0)
+        threads = (std::max)(1, static_cast<int>(std::thread::hardware_concurrency()));
+    for (int i = 1; i < threads; i++)
+        workers.push_back(std::thread(&WorkerPool::WorkerLoop, this));
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread& worker : workers)
+        worker.join();
+}
+
+void WorkerPool::RunTasks(const std::function<void(int)>& work, int tasks) {
+    for (int task = nextTask.fetch_add(1); task < tasks; task = nextTask.fetch_add(1))
+        work(task);
+}
+
+void WorkerPool::WorkerLoop() {
+    uint64_t joined = 0;
+    std::unique_lock<std::mutex> guard(lock);
+    for (;;) {
+        wake.wait(guard, [&] { return stopping || jobNumber != joined; });
+        if (stopping)
+            return;
+        joined = jobNumber;
+        const std::function<void(int)>& work = *job;
+        int tasks = jobTasks;
+
+        guard.unlock();
+        RunTasks(work, tasks);
+        guard.lock();
+
+        if (--busyWorkers == 0)
+            finished.notify_one();
+    }
+}
+
+// Call work(0) .. work(tasks - 1) in parallel
+void WorkerPool::Run(int tasks, const std::function<void(int)>& work) {
+    if (tasks <= 0)
+        return;
+
+    // Not worth waking anyone for
+    if (tasks == 1 || workers.empty()) {
+        for (int task = 0; task < tasks; task++)
+            work(task);
+        return;
+    }
+
+    std::lock_guard<std::mutex> running(runLock);
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        job = &work;
+        jobTasks = tasks;
+        nextTask.store(0);
+        busyWorkers = static_cast<int>(workers.size());
+        jobNumber++;
+    }
+    wake.notify_all();
+
+    RunTasks(work, tasks);
+
+    std::unique_lock<std::mutex> guard(lock);
+    finished.wait(guard, [&] { return busyWorkers == 0; });
+    job = NULL;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Threads kept waiting for per-frame image work, so splitting a frame into tiles does not pay
+// for starting threads every frame. Run() hands out task indices to the workers and the
+// calling thread until all are taken, then waits for the last one to finish.
+class WorkerPool {
+private:
+    std::vector<std::thread> workers;
+    std::mutex lock;
+    std::condition_variable wake;     // Workers wait here for a job
+    std::condition_variable finished; // Run() waits here for the workers
+    bool stopping;
+
+    const std::function<void(int)>* job;
+    int jobTasks;
+    uint64_t jobNumber;          // Incremented per Run(), so each worker joins each job once
+    int busyWorkers;
+    std::atomic<int> nextTask;
+    std::mutex runLock;          // One Run() at a time
+
+    void RunTasks(const std::function<void(int)>& work, int tasks);
+    void WorkerLoop();
+
+public:
+    // 'threads' includes the thread calling Run(); 0 uses one per hardware thread
+    explicit WorkerPool(int threads);
+    ~WorkerPool();
+
+    // Threads that take part in Run(), including the caller
+    int GetThreads() const { return static_cast<int>(workers.size()) + 1; }
+
+    // Call work(0) .. work(tasks - 1), in parallel and in no particular order, and return when
+    // all have returned. Tasks must not call Run().
+    void Run(int tasks, const std::function<void(int)>& work);
+};